@@ -91,6 +91,11 @@ bool Acrylic::requestPerformanceQoS(AcrylicPerformanceRequest __unused *request)
     return true;
 }
 
+bool Acrylic::getPerformanceStats(AcrylicPerformanceStats __unused *stats)
+{
+    return false;
+}
+
 bool Acrylic::setHDRToneMapCoefficients(uint32_t __unused *matrix[2], int __unused num_elements)
 {
     return true;
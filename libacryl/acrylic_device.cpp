@@ -20,6 +20,9 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <log/log.h>
 
@@ -65,14 +68,42 @@ AcrylicRedundantDevice::AcrylicRedundantDevice(const char *devpath)
     : mDevPath(devpath), mDevFd{-1, -1, -1}, mFdIdx(0)
 {
     mDevPath = devpath;
+
+    for (int i = 0; i < MAX_DEVICE_FD; i++) {
+        memset(&mStats[i], 0, sizeof(mStats[i]));
+        mStats[i].priority = -1;
+        mBusySince[i] = 0;
+    }
 }
 
 AcrylicRedundantDevice::~AcrylicRedundantDevice()
 {
+    for (auto &job : mJobs) {
+        if (job.second.fence >= 0)
+            ::close(job.second.fence);
+    }
+
     for (int i = 0; i < MAX_DEVICE_FD; i++)
         ::close(mDevFd[i]);
 }
 
+std::shared_ptr<AcrylicRedundantDevice> AcrylicRedundantDevice::getShared(const char *devpath)
+{
+    static std::mutex lock;
+    static std::map<std::string, std::weak_ptr<AcrylicRedundantDevice>> devices;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto &device = devices[devpath];
+    std::shared_ptr<AcrylicRedundantDevice> shared = device.lock();
+    if (!shared) {
+        shared = std::make_shared<AcrylicRedundantDevice>(devpath);
+        device = shared;
+    }
+
+    return shared;
+}
+
 bool AcrylicRedundantDevice::open()
 {
     if (mDevFd[0] >= 0)
@@ -97,12 +128,17 @@ bool AcrylicRedundantDevice::open()
     return true;
 }
 
+int AcrylicRedundantDevice::ioctl_fd(int fd, int cmd, void *arg)
+{
+    return ::ioctl(fd, cmd, arg);
+}
+
 int AcrylicRedundantDevice::ioctl_unique(int cmd, void *arg)
 {
     if (!open())
         return -1;
 
-    return ::ioctl(mDevFd[0], cmd, arg);
+    return ioctl_fd(mDevFd[0], cmd, arg);
 }
 
 int AcrylicRedundantDevice::ioctl_current(int cmd, void *arg)
@@ -110,7 +146,7 @@ int AcrylicRedundantDevice::ioctl_current(int cmd, void *arg)
     if (!open())
         return -1;
 
-    return ::ioctl(mDevFd[mFdIdx], cmd, arg);
+    return ioctl_fd(mDevFd[mFdIdx], cmd, arg);
 }
 
 int AcrylicRedundantDevice::ioctl_broadcast(int cmd, void *arg) {
@@ -118,10 +154,202 @@ int AcrylicRedundantDevice::ioctl_broadcast(int cmd, void *arg) {
         return -1;
 
     for (int i = 0; i < MAX_DEVICE_FD; i++) {
-        int ret = ::ioctl(mDevFd[i], cmd, arg);
+        int ret = ioctl_fd(mDevFd[i], cmd, arg);
         if (ret < 0)
             return ret;
     }
 
     return 0;
 }
+
+int AcrylicRedundantDevice::ioctl_context(int context, int cmd, void *arg)
+{
+    if ((context < 0) || (context >= MAX_DEVICE_FD)) {
+        ALOGE("Invalid context %d", context);
+        return -1;
+    }
+
+    if (!open())
+        return -1;
+
+    return ioctl_fd(mDevFd[context], cmd, arg);
+}
+
+static int64_t monotonic_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void AcrylicRedundantDevice::completeLocked(std::map<int, Job>::iterator job, int64_t now_ns)
+{
+    ContextStats &stats = mStats[job->second.context];
+
+    stats.inFlight--;
+    stats.pendingCost -= job->second.cost;
+    if (stats.inFlight == 0)
+        stats.busyNs += now_ns - mBusySince[job->second.context];
+
+    if (job->second.fence >= 0)
+        ::close(job->second.fence);
+
+    mJobs.erase(job);
+}
+
+void AcrylicRedundantDevice::retireSignaledLocked()
+{
+    struct pollfd fds[MAX_DEVICE_FD * 8];
+    int jobs[MAX_DEVICE_FD * 8];
+    nfds_t count = 0;
+
+    for (auto &job : mJobs) {
+        if (job.second.retired && (count < ARRSIZE(fds))) {
+            fds[count].fd = job.second.fence;
+            fds[count].events = POLLIN;
+            fds[count].revents = 0;
+            jobs[count++] = job.first;
+        }
+    }
+
+    if ((count == 0) || (::poll(fds, count, 0) <= 0))
+        return;
+
+    int64_t now_ns = monotonic_ns();
+
+    for (nfds_t i = 0; i < count; i++) {
+        if (fds[i].revents != 0)
+            completeLocked(mJobs.find(jobs[i]), now_ns);
+    }
+}
+
+int AcrylicRedundantDevice::pickContext(int priority)
+{
+    bool any = true;
+
+    for (int i = 0; i < MAX_DEVICE_FD; i++) {
+        if (mStats[i].priority == priority)
+            any = false;
+    }
+
+    // Ties go to the context after the last one chosen to spread the jobs
+    int best = -1;
+    for (int n = 0; n < MAX_DEVICE_FD; n++) {
+        int i = (mFdIdx + n) % MAX_DEVICE_FD;
+
+        if (!any && (mStats[i].priority != priority))
+            continue;
+
+        if ((best < 0) || (mStats[i].pendingCost < mStats[best].pendingCost) ||
+            ((mStats[i].pendingCost == mStats[best].pendingCost) &&
+             (mStats[i].inFlight < mStats[best].inFlight)))
+            best = i;
+    }
+
+    return best;
+}
+
+int AcrylicRedundantDevice::ioctl_dispatch(int cmd, void *arg, uint32_t cost, int priority,
+                                           int *job, int *context)
+{
+    if (!open())
+        return -1;
+
+    int id, ctx;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        retireSignaledLocked();
+
+        ctx = pickContext(priority);
+        id = mNextJob++;
+        if (mNextJob < 0)
+            mNextJob = 0;
+
+        // The job is accounted before the ioctl for the dispatches in parallel
+        ContextStats &stats = mStats[ctx];
+        if (stats.inFlight++ == 0)
+            mBusySince[ctx] = monotonic_ns();
+        else
+            stats.queuedJobs++;
+        stats.pendingCost += cost;
+        stats.jobs++;
+        stats.cost += cost;
+
+        mJobs[id] = {ctx, cost, -1, false, stats.inFlight > 1};
+        mFdIdx = (ctx + 1) % MAX_DEVICE_FD;
+    }
+
+    int ret = ioctl_fd(mDevFd[ctx], cmd, arg);
+
+    if (ret < 0) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mStats[ctx].jobs--;
+        mStats[ctx].cost -= cost;
+        if (mJobs[id].queued)
+            mStats[ctx].queuedJobs--;
+        completeLocked(mJobs.find(id), monotonic_ns());
+
+        return ret;
+    }
+
+    ALOGD_TEST("Dispatched job %d of cost %u and priority %d to devfd[%d]", id, cost, priority, ctx);
+
+    *job = id;
+    if (context)
+        *context = ctx;
+
+    return ret;
+}
+
+void AcrylicRedundantDevice::retire(int job, int fence)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mJobs.find(job);
+    if ((it == mJobs.end()) || it->second.retired) {
+        ALOGE("Retiring unknown job %d", job);
+        return;
+    }
+
+    if (fence >= 0) {
+        it->second.fence = ::dup(fence);
+        if (it->second.fence < 0)
+            ALOGERR("Failed to duplicate fence %d of job %d", fence, job);
+    }
+
+    if (it->second.fence < 0) {
+        completeLocked(it, monotonic_ns());
+        return;
+    }
+
+    it->second.retired = true;
+}
+
+void AcrylicRedundantDevice::setContextPriority(int context, int priority)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if ((context >= 0) && (context < MAX_DEVICE_FD))
+        mStats[context].priority = priority;
+}
+
+bool AcrylicRedundantDevice::getContextStats(int context, ContextStats &stats)
+{
+    if ((context < 0) || (context >= MAX_DEVICE_FD))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    retireSignaledLocked();
+
+    stats = mStats[context];
+    if (stats.inFlight > 0)
+        stats.busyNs += monotonic_ns() - mBusySince[context];
+
+    return true;
+}
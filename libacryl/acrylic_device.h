@@ -18,6 +18,10 @@
 #ifndef __HARDWARE_EXYNOS_ACRYLIC_DEVICE_H__
 #define __HARDWARE_EXYNOS_ACRYLIC_DEVICE_H__
 
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 
 class AcrylicDevice {
@@ -33,10 +37,36 @@ private:
 };
 
 #define MAX_DEVICE_FD 3
+/*
+ * AcrylicRedundantDevice - several contexts of the same device node
+ *
+ * A job submitted on a context waits for the jobs before it on the same
+ * context. ioctl_dispatch() tracks the jobs in flight on each context and
+ * their expected cost, and submits a new job to the context with the least
+ * cost in flight among the contexts of the priority of the job. A job stays
+ * in flight until retire() is called for it and its release fence signals.
+ */
 class AcrylicRedundantDevice {
 public:
+    struct ContextStats {
+        int priority;
+        unsigned int inFlight;
+        uint64_t pendingCost;
+        uint64_t jobs;
+        uint64_t cost;
+        /* Jobs submitted while the context had a job in flight */
+        uint64_t queuedJobs;
+        /* Time with a job in flight, up to when the completion was seen */
+        uint64_t busyNs;
+    };
+
     AcrylicRedundantDevice(const char *path);
-    ~AcrylicRedundantDevice();
+    virtual ~AcrylicRedundantDevice();
+    /*
+     * Returns the instance shared by all clients of @path in the process so
+     * that their jobs are balanced over the same contexts.
+     */
+    static std::shared_ptr<AcrylicRedundantDevice> getShared(const char *path);
     int ioctl_unique(int cmd, void *arg);
     int ioctl_current(int cmd, void *arg);
     int ioctl_broadcast(int cmd, void *arg);
@@ -48,12 +78,51 @@ public:
         return ret;
 
     }
+    int ioctl_context(int context, int cmd, void *arg);
+    /*
+     * Submits a job of @cost, in any unit the caller keeps consistent, to the
+     * least loaded context of @priority, or of all contexts if no context has
+     * @priority. Returns the result of ioctl. On success, *job is the handle
+     * to pass to retire() and *context, if given, is the context chosen.
+     */
+    int ioctl_dispatch(int cmd, void *arg, uint32_t cost, int priority, int *job,
+                       int *context = nullptr);
+    /*
+     * The job completes when @fence signals or immediately if @fence is
+     * negative. @fence is duplicated.
+     */
+    void retire(int job, int fence = -1);
+    /*
+     * Reserves the context for the jobs of @priority. The priority of the
+     * context in the driver is configured by the caller with ioctl_context().
+     */
+    void setContextPriority(int context, int priority);
+    bool getContextStats(int context, ContextStats &stats);
+protected:
+    virtual int ioctl_fd(int fd, int cmd, void *arg);
 private:
+    struct Job {
+        int context;
+        uint32_t cost;
+        int fence;
+        bool retired;
+        bool queued;
+    };
+
     bool open();
+    int pickContext(int priority);
+    void retireSignaledLocked();
+    void completeLocked(std::map<int, Job>::iterator job, int64_t now_ns);
 
     std:: string mDevPath;
     int mDevFd[MAX_DEVICE_FD];
     int mFdIdx;
+
+    std::mutex mMutex;
+    std::map<int, Job> mJobs;
+    int mNextJob = 0;
+    ContextStats mStats[MAX_DEVICE_FD];
+    int64_t mBusySince[MAX_DEVICE_FD];
 };
 
 #endif //__HARDWARE_EXYNOS_ACRYLIC_DEVICE_H__
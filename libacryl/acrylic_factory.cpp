@@ -23,6 +23,7 @@
 
 #include "acrylic_g2d.h"
 #include "acrylic_internal.h"
+#include "acrylic_software.h"
 #include "acrylic_capability.h"
 
 Acrylic *Acrylic::createInstance(const char *spec)
@@ -30,7 +31,9 @@ Acrylic *Acrylic::createInstance(const char *spec)
     Acrylic *compositor = nullptr;
 
     ALOGD_TEST("Creating a new Acrylic instance of '%s'", spec);
-    compositor = createAcrylicCompositorG2D(spec);
+    compositor = createAcrylicCompositorSoftware(spec);
+    if (!compositor)
+        compositor = createAcrylicCompositorG2D(spec);
     if (compositor) {
         ALOGI("%s compositor added", spec);
     }
@@ -18,8 +18,10 @@
 #define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
 
 #include "acrylic_g2d.h"
+#include "acrylic_g2d_qos.h"
 
 #include <alloca.h>
+#include <cutils/properties.h>
 #include <exynos_format.h> // hardware/smasung_slsi/exynos/include
 #include <hardware/hwcomposer2.h>
 #include <log/log.h>
@@ -557,6 +559,11 @@ AcrylicCompositorG2D::AcrylicCompositorG2D(const HW2DCapability &capability, boo
         ALOGERR("Failed to get G2D command version");
     ALOGI("G2D API Version %d", mVersion);
 
+    /* The performance and priority requests of this compositor are only issued on mDev */
+    if (property_get_bool("vendor.acryl.g2d.redundant_contexts", false))
+        mJobDev = AcrylicRedundantDevice::getShared(
+                (capability.maxLayerCount() > 2) ? "/dev/g2d" : "/dev/fimg2d");
+
     halfmt_to_g2dfmt_tbl = newcolormode ? __halfmt_to_g2dfmt : __halfmt_to_g2dfmt_legacy;
     len_halfmt_to_g2dfmt_tbl = newcolormode ? ARRSIZE(__halfmt_to_g2dfmt) : ARRSIZE(__halfmt_to_g2dfmt_legacy);
 
@@ -567,6 +574,8 @@ AcrylicCompositorG2D::AcrylicCompositorG2D(const HW2DCapability &capability, boo
 
 AcrylicCompositorG2D::~AcrylicCompositorG2D()
 {
+    G2DQoSGovernor::getInstance().detach(&mDev);
+
     delete [] mTask.source;
     delete [] mTask.commands.target;
     for (unsigned int i = 0; i < mMaxSourceCount; i++)
@@ -1024,11 +1033,46 @@ bool AcrylicCompositorG2D::reallocLayer(unsigned int layercount)
     return true;
 }
 
+uint32_t AcrylicCompositorG2D::getJobCost(void)
+{
+    // Pixels written to the target and read from the sources
+    hw2d_coord_t target = getCanvas().getImageDimension();
+    uint64_t cost = static_cast<uint64_t>(target.hori) * target.vert;
+
+    for (unsigned int i = 0; i < layerCount(); i++) {
+        hw2d_rect_t rect = getLayer(i)->getTargetRect();
+        cost += static_cast<uint64_t>(rect.size.hori) * rect.size.vert;
+    }
+
+    return static_cast<uint32_t>(std::min<uint64_t>(cost, UINT32_MAX));
+}
+
+int AcrylicCompositorG2D::submitG2D(int cmd, void *arg)
+{
+    mJob = -1;
+
+    if (!mJobDev || (mPriority >= 0))
+        return mDev.ioctl(cmd, arg);
+
+    return mJobDev->ioctl_dispatch(cmd, arg, getJobCost(), mPriority, &mJob);
+}
+
+void AcrylicCompositorG2D::retireG2D(void)
+{
+    if (mJob < 0)
+        return;
+
+    // The job is in flight until its release fence signals
+    mJobDev->retire(mJob, (mTask.num_release_fences > 0) ? mTask.release_fence[0] : -1);
+    mJob = -1;
+}
+
 int AcrylicCompositorG2D::ioctlG2D(void)
 {
     if (mVersion == 1) {
-        if (mDev.ioctl(G2D_IOC_PROCESS, &mTask) < 0)
+        if (submitG2D(G2D_IOC_PROCESS, &mTask) < 0)
             return -errno;
+        retireG2D();
     } else {
         struct g2d_compat_task task;
 
@@ -1041,7 +1085,7 @@ int AcrylicCompositorG2D::ioctlG2D(void)
         task.commands.extra = mTask.commands.extra;
         task.commands.num_extra_regs = mTask.commands.num_extra_regs;
 
-        if (mDev.ioctl(G2D_IOC_COMPAT_PROCESS, &task) < 0)
+        if (submitG2D(G2D_IOC_COMPAT_PROCESS, &task) < 0)
             return -errno;
 
         mTask.flags = task.flags;
@@ -1049,6 +1093,7 @@ int AcrylicCompositorG2D::ioctlG2D(void)
 
         for (unsigned int i = 0; i < mTask.num_release_fences; i++)
             mTask.release_fence[i] = task.release_fence[i];
+        retireG2D();
     }
 
     return 0;
@@ -1175,6 +1220,8 @@ bool AcrylicCompositorG2D::executeG2D(int fence[], unsigned int num_fences, bool
 
     debug_show_g2d_task(mTask);
 
+    int64_t submit_ns = G2DQoSGovernor::getInstance().beginTask();
+
     if (ioctlG2D() < 0) {
         ALOGERR("Failed to process a task");
         show_g2d_task(mTask);
@@ -1200,6 +1247,10 @@ bool AcrylicCompositorG2D::executeG2D(int fence[], unsigned int num_fences, bool
     for (unsigned int i = 0; i < num_fences; i++)
         fence[i] = mTask.release_fence[i];
 
+    // Every release fence of a task signals at its completion
+    G2DQoSGovernor::getInstance().endTask(&mDev, submit_ns, (num_fences > 0) ? fence[0] : -1,
+                                          !nonblocking);
+
     return true;
 }
 
@@ -1250,6 +1301,8 @@ bool AcrylicCompositorG2D::requestPerformanceQoS(AcrylicPerformanceRequest *requ
     memset(&data, 0, sizeof(data));
 
     if (!request || (request->getFrameCount() == 0)) {
+        G2DQoSGovernor::getInstance().cancelRequest(&mDev);
+
         if (mDev.ioctl(G2D_IOC_PERFORMANCE, &data) < 0) {
             ALOGERR("Failed to cancel performance request");
             return false;
@@ -1373,6 +1426,8 @@ bool AcrylicCompositorG2D::requestPerformanceQoS(AcrylicPerformanceRequest *requ
 
     data.num_frame = request->getFrameCount();
 
+    G2DQoSGovernor::getInstance().setRequest(&mDev, *request, data);
+
     if (mDev.ioctl(G2D_IOC_PERFORMANCE, &data) < 0) {
         ALOGERR("Failed to request performance");
         return false;
@@ -1381,6 +1436,13 @@ bool AcrylicCompositorG2D::requestPerformanceQoS(AcrylicPerformanceRequest *requ
     return true;
 }
 
+bool AcrylicCompositorG2D::getPerformanceStats(AcrylicPerformanceStats *stats)
+{
+    G2DQoSGovernor::getInstance().getStats(&mDev, *stats);
+
+    return true;
+}
+
 int AcrylicCompositorG2D::prioritize(int priority)
 {
     static int32_t g2d_priorities[] = {
@@ -133,8 +133,12 @@ public:
      */
     virtual int prioritize(int priority = -1);
     virtual bool requestPerformanceQoS(AcrylicPerformanceRequest *request);
+    virtual bool getPerformanceStats(AcrylicPerformanceStats *stats);
 private:
     int ioctlG2D(void);
+    int submitG2D(int cmd, void *arg);
+    void retireG2D(void);
+    uint32_t getJobCost(void);
     bool executeG2D(int fence[], unsigned int num_fences, bool nonblocking);
     bool prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index);
     bool prepareSource(AcrylicLayer &layer, struct g2d_layer &image, uint32_t cmd[], hw2d_coord_t target_size,
@@ -145,6 +149,14 @@ private:
     unsigned int updateFilterCoefficients(unsigned int layercount, g2d_reg regs[]);
 
     AcrylicDevice mDev;
+    /*
+     * Contexts of the node shared by all G2D compositors in the process. The
+     * jobs of default priority go to the least loaded one. A compositor with a
+     * priority configured by prioritize() runs its jobs on mDev. Only used
+     * when vendor.acryl.g2d.redundant_contexts is set.
+     */
+    std::shared_ptr<AcrylicRedundantDevice> mJobDev;
+    int mJob = -1;
     g2d_task	  mTask;
     G2DHdrWriter  mHdrWriter;
     unsigned int  mMaxSourceCount;
@@ -0,0 +1,431 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/properties.h>
+#include <linux/sync_file.h>
+#include <log/log.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "acrylic_internal.h"
+#include "acrylic_g2d_qos.h"
+
+// The correction factor is in Q10: 1024 requests the bandwidth of the model
+static const uint32_t QOS_FACTOR_ONE = 1024;
+static const uint32_t QOS_FACTOR_MIN = QOS_FACTOR_ONE / 4;
+static const uint32_t QOS_FACTOR_MAX = QOS_FACTOR_ONE * 4;
+// The request is sent again if the factor moved by 1/16 from the applied one
+static const uint32_t QOS_FACTOR_HYSTERESIS = QOS_FACTOR_ONE / 16;
+// Tasks are steered to complete at 90% of the deadline. Only tasks that
+// complete before 80% of the deadline lower the factor.
+static const int64_t QOS_SETPOINT_PERCENT = 90;
+static const int64_t QOS_SLACK_PERCENT = 80;
+static const size_t QOS_MAX_SCENES = 32;
+static const size_t QOS_MAX_PENDING_TASKS = 16;
+static const unsigned int QOS_MAX_FENCES = 8;
+
+static int64_t monotonic_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Returns 1 with the time the last fence in @fd signaled, 0 if @fd is still
+ * active and -1 if @fd is in error.
+ */
+static int fence_signal_time(int fd, int64_t *signal_ns)
+{
+    struct sync_fence_info fences[QOS_MAX_FENCES];
+    struct sync_file_info info;
+
+    memset(&info, 0, sizeof(info));
+    if (ioctl(fd, SYNC_IOC_FILE_INFO, &info) < 0)
+        return -1;
+
+    if (info.status <= 0)
+        return info.status < 0 ? -1 : 0;
+
+    if ((info.num_fences == 0) || (info.num_fences > QOS_MAX_FENCES)) {
+        *signal_ns = monotonic_ns();
+        return 1;
+    }
+
+    memset(fences, 0, sizeof(fences));
+    info.sync_fence_info = reinterpret_cast<uintptr_t>(fences);
+    if (ioctl(fd, SYNC_IOC_FILE_INFO, &info) < 0)
+        return -1;
+
+    *signal_ns = 0;
+    for (unsigned int i = 0; i < info.num_fences; i++)
+        *signal_ns = std::max(*signal_ns, static_cast<int64_t>(fences[i].timestamp_ns));
+
+    return 1;
+}
+
+static void hash_value(uint64_t &hash, uint64_t value)
+{
+    // FNV-1a over the bytes of value
+    for (int i = 0; i < 8; i++) {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 0x100000001B3ULL;
+    }
+}
+
+/*
+ * The signature of a scene is what decides the cost of its tasks: the
+ * formats, the sizes and the transforms of the layers and the target. The
+ * positions are left out so that moving a window keeps its factor.
+ */
+static uint64_t scene_signature(AcrylicPerformanceRequest &request)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (int i = 0; i < request.getFrameCount(); i++) {
+        AcrylicPerformanceRequestFrame *frame = request.getFrame(i);
+
+        hash_value(hash, frame->mFrameRate);
+        hash_value(hash, frame->mTargetPixFormat);
+        hash_value(hash, (static_cast<uint64_t>(frame->mTargetDimension.hori) << 32) |
+                         frame->mTargetDimension.vert);
+        hash_value(hash, frame->mHasBackgroundLayer);
+
+        for (int idx = 0; idx < frame->getLayerCount(); idx++) {
+            AcrylicPerformanceRequestLayer &layer = frame->mLayers[idx];
+
+            hash_value(hash, layer.mPixFormat);
+            hash_value(hash, (static_cast<uint64_t>(layer.mSourceRect.size.hori) << 32) |
+                             layer.mSourceRect.size.vert);
+            hash_value(hash, (static_cast<uint64_t>(layer.mTargetRect.size.hori) << 32) |
+                             layer.mTargetRect.size.vert);
+            hash_value(hash, (static_cast<uint64_t>(layer.mTransform) << 32) | layer.mAttribute);
+        }
+    }
+
+    // 0 stands for no request
+    return hash ? hash : 1;
+}
+
+static uint32_t scale_bandwidth(uint32_t bandwidth, uint32_t factor)
+{
+    uint64_t scaled = (static_cast<uint64_t>(bandwidth) * factor) >> 10;
+
+    return static_cast<uint32_t>(std::min<uint64_t>(scaled, UINT32_MAX));
+}
+
+static uint32_t total_bandwidth(const g2d_performance &data)
+{
+    uint64_t bandwidth = 0;
+
+    for (unsigned int i = 0; i < data.num_frame; i++)
+        bandwidth += data.frame[i].bandwidth_read + data.frame[i].bandwidth_write;
+
+    return static_cast<uint32_t>(std::min<uint64_t>(bandwidth, UINT32_MAX));
+}
+
+static void scale_request(g2d_performance &data, uint32_t factor)
+{
+    for (unsigned int i = 0; i < data.num_frame; i++) {
+        data.frame[i].bandwidth_read = scale_bandwidth(data.frame[i].bandwidth_read, factor);
+        data.frame[i].bandwidth_write = scale_bandwidth(data.frame[i].bandwidth_write, factor);
+    }
+}
+
+G2DQoSGovernor &G2DQoSGovernor::getInstance()
+{
+    static G2DQoSGovernor governor;
+
+    return governor;
+}
+
+G2DQoSGovernor::G2DQoSGovernor()
+{
+    mEnabled = property_get_bool("vendor.acryl.g2d.qos_governor", true);
+    mDeadlinePercent = std::clamp(property_get_int32("vendor.acryl.g2d.qos_deadline_percent", 75),
+                                  10, 100);
+    memset(&mModel, 0, sizeof(mModel));
+
+    ALOGD_TEST("G2D QoS governor %s, deadline %u%% of the frame period",
+               mEnabled ? "enabled" : "disabled", mDeadlinePercent);
+}
+
+G2DQoSGovernor::Scene &G2DQoSGovernor::findSceneLocked(uint64_t signature)
+{
+    auto it = mScenes.find(signature);
+
+    if (it == mScenes.end()) {
+        if (mScenes.size() >= QOS_MAX_SCENES) {
+            auto oldest = std::min_element(mScenes.begin(), mScenes.end(),
+                    [](const auto &a, const auto &b) { return a.second.lastUse < b.second.lastUse; });
+            mScenes.erase(oldest);
+        }
+        it = mScenes.emplace(signature, Scene{QOS_FACTOR_ONE, 0}).first;
+    }
+
+    it->second.lastUse = ++mSceneClock;
+
+    return it->second;
+}
+
+void G2DQoSGovernor::setRequest(AcrylicDevice *dev, AcrylicPerformanceRequest &request,
+                                g2d_performance &data)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    harvestLocked();
+
+    int frame_rate = 0;
+    for (int i = 0; i < request.getFrameCount(); i++)
+        frame_rate = std::max(frame_rate, request.getFrame(i)->mFrameRate);
+
+    mRequestCount++;
+    mOwner = dev;
+    mModel = data;
+    mSignature = scene_signature(request);
+    mDeadlineUSec = (frame_rate > 0) ? 1000000U / frame_rate * mDeadlinePercent / 100 : 0;
+    mAppliedFactor = mEnabled ? findSceneLocked(mSignature).factor : QOS_FACTOR_ONE;
+
+    scale_request(data, mAppliedFactor);
+
+    mModelBandwidth = total_bandwidth(mModel);
+    mRequestedBandwidth = total_bandwidth(data);
+
+    ALOGD_TEST("QoS request %#llx: deadline %u us, factor %u/1024, bandwidth %u -> %u KB/s",
+               static_cast<unsigned long long>(mSignature), mDeadlineUSec, mAppliedFactor,
+               mModelBandwidth, mRequestedBandwidth);
+}
+
+void G2DQoSGovernor::cancelRequest(AcrylicDevice *dev)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    harvestLocked();
+
+    if (mOwner != dev)
+        return;
+
+    mOwner = nullptr;
+    mSignature = 0;
+    mDeadlineUSec = 0;
+    mAppliedFactor = 0;
+    mModelBandwidth = 0;
+    mRequestedBandwidth = 0;
+}
+
+int64_t G2DQoSGovernor::beginTask()
+{
+    return monotonic_ns();
+}
+
+void G2DQoSGovernor::endTask(AcrylicDevice *dev, int64_t submit_ns, int release_fence,
+                             bool blocking)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mClients[dev];
+
+    Task task = {dev, mSignature, mDeadlineUSec, submit_ns, 0, -1};
+
+    if (release_fence >= 0) {
+        task.fence = dup(release_fence);
+        if (task.fence < 0) {
+            ALOGERR("Failed to duplicate release fence %d", release_fence);
+            return;
+        }
+
+        if (mPending.size() >= QOS_MAX_PENDING_TASKS) {
+            close(mPending.front().fence);
+            mPending.pop_front();
+        }
+
+        mPending.push_back(task);
+    } else if (blocking) {
+        task.completeNs = monotonic_ns();
+        completeLocked(task);
+    }
+
+    harvestLocked();
+}
+
+void G2DQoSGovernor::detach(AcrylicDevice *dev)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto it = mPending.begin(); it != mPending.end();) {
+        if (it->dev == dev) {
+            close(it->fence);
+            it = mPending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    mClients.erase(dev);
+
+    if (mOwner == dev) {
+        mOwner = nullptr;
+        mSignature = 0;
+        mDeadlineUSec = 0;
+    }
+}
+
+void G2DQoSGovernor::harvestLocked()
+{
+    std::vector<Task> completed;
+
+    for (auto it = mPending.begin(); it != mPending.end();) {
+        int64_t signal_ns;
+        int ret = fence_signal_time(it->fence, &signal_ns);
+
+        if (ret == 0) {
+            ++it;
+            continue;
+        }
+
+        if (ret > 0) {
+            it->completeNs = std::max(signal_ns, it->submitNs);
+            completed.push_back(*it);
+        }
+
+        close(it->fence);
+        it = mPending.erase(it);
+    }
+
+    std::sort(completed.begin(), completed.end(),
+              [](const Task &a, const Task &b) { return a.completeNs < b.completeNs; });
+
+    for (auto &task : completed)
+        completeLocked(task);
+
+    if (!mEnabled || !mOwner || !mSignature)
+        return;
+
+    auto it = mScenes.find(mSignature);
+    if ((it != mScenes.end()) &&
+        ((std::max(it->second.factor, mAppliedFactor) -
+          std::min(it->second.factor, mAppliedFactor)) >= QOS_FACTOR_HYSTERESIS))
+        applyLocked();
+}
+
+void G2DQoSGovernor::completeLocked(const Task &task)
+{
+    // The G2D runs one task at a time: a task starts when the one before completes
+    int64_t start_ns = std::min(std::max(task.submitNs, mLastCompleteNs), task.completeNs);
+    int64_t latency_usec = (task.completeNs - task.submitNs) / 1000;
+
+    mLastCompleteNs = std::max(mLastCompleteNs, task.completeNs);
+
+    auto client = mClients.find(task.dev);
+    if (client == mClients.end())
+        return;
+
+    ClientStats &stats = client->second;
+
+    stats.tasks++;
+    stats.queueUSec += (start_ns - task.submitNs) / 1000;
+    stats.execUSec += (task.completeNs - start_ns) / 1000;
+
+    if (!task.signature || !task.deadlineUSec)
+        return;
+
+    int64_t error_usec = latency_usec - task.deadlineUSec;
+
+    stats.errorUSec += error_usec;
+    stats.absErrorUSec += std::abs(error_usec);
+    if (error_usec > 0) {
+        stats.lateTasks++;
+        stats.maxLateUSec = std::max(stats.maxLateUSec,
+                                     static_cast<uint32_t>(std::min<int64_t>(error_usec, UINT32_MAX)));
+    }
+
+    if (mEnabled)
+        updateFactorLocked(task.signature, task.deadlineUSec, latency_usec);
+}
+
+void G2DQoSGovernor::updateFactorLocked(uint64_t signature, uint32_t deadline_usec,
+                                        int64_t latency_usec)
+{
+    Scene &scene = findSceneLocked(signature);
+    int64_t setpoint_usec = std::max<int64_t>(deadline_usec * QOS_SETPOINT_PERCENT / 100, 1);
+    int64_t factor = scene.factor;
+    // The factor that would have completed the task at the setpoint if the
+    // execution time scales with the inverse of the bandwidth
+    int64_t target = factor * latency_usec / setpoint_usec;
+
+    if (latency_usec > deadline_usec)
+        factor += (target - factor + 1) / 2;
+    else if (latency_usec * 100 < deadline_usec * QOS_SLACK_PERCENT)
+        factor -= (factor - target) / 8;
+
+    scene.factor = static_cast<uint32_t>(std::clamp<int64_t>(factor, QOS_FACTOR_MIN, QOS_FACTOR_MAX));
+}
+
+void G2DQoSGovernor::applyLocked()
+{
+    g2d_performance data = mModel;
+    uint32_t factor = findSceneLocked(mSignature).factor;
+
+    scale_request(data, factor);
+
+    if (mOwner->ioctl(G2D_IOC_PERFORMANCE, &data) < 0) {
+        // Keeps the request of the model until the next one
+        ALOGERR("Failed to correct performance request by %u/1024", factor);
+        mOwner = nullptr;
+        return;
+    }
+
+    ALOGD_TEST("QoS request %#llx: factor %u/1024 -> %u/1024",
+               static_cast<unsigned long long>(mSignature), mAppliedFactor, factor);
+
+    mAppliedFactor = factor;
+    mRequestedBandwidth = total_bandwidth(data);
+    mAdjustCount++;
+}
+
+void G2DQoSGovernor::getStats(AcrylicDevice *dev, AcrylicPerformanceStats &stats)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    harvestLocked();
+
+    memset(&stats, 0, sizeof(stats));
+
+    auto client = mClients.find(dev);
+    if (client != mClients.end()) {
+        stats.mTaskCount = client->second.tasks;
+        stats.mLateTaskCount = client->second.lateTasks;
+        stats.mQueueTimeUSec = client->second.queueUSec;
+        stats.mExecTimeUSec = client->second.execUSec;
+        stats.mErrorUSec = client->second.errorUSec;
+        stats.mAbsErrorUSec = client->second.absErrorUSec;
+        stats.mMaxLateUSec = client->second.maxLateUSec;
+    }
+
+    stats.mDeadlineUSec = mDeadlineUSec;
+    stats.mCorrection = mAppliedFactor;
+    stats.mModelBandwidth = mModelBandwidth;
+    stats.mRequestedBandwidth = mRequestedBandwidth;
+    stats.mRequestCount = mRequestCount;
+    stats.mAdjustCount = mAdjustCount;
+    stats.mSceneCount = static_cast<uint32_t>(mScenes.size());
+}
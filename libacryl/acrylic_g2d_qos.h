@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_ACRYLIC_G2D_QOS_H__
+#define __HARDWARE_EXYNOS_ACRYLIC_G2D_QOS_H__
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include <hardware/exynos/acryl.h>
+
+#include <uapi/g2d.h>
+
+#include "acrylic_device.h"
+
+/*
+ * G2DQoSGovernor - closed loop correction of the G2D performance request
+ *
+ * requestPerformanceQoS() estimates the bandwidth of a scene from its layer
+ * geometry. The governor measures how long the tasks of the scene really
+ * take, from the submission to the signal of the release fence, and learns
+ * a correction factor per scene signature that brings the completion of a
+ * task close to the deadline: a share of the frame period of the request.
+ * Late tasks raise the factor quickly and early tasks lower it slowly. If
+ * the factor of the requested scene moves far enough from the applied one,
+ * the request is sent again with the corrected bandwidth.
+ *
+ * All instances of AcrylicCompositorG2D share the governor because they
+ * share the hardware and HWC sends the request through one of them.
+ * The queue time of a task is the time it waited for the tasks completed
+ * before it, the rest is its execution time.
+ */
+class G2DQoSGovernor {
+public:
+    static G2DQoSGovernor &getInstance();
+
+    /*
+     * Called with the request from the static model before it is sent on
+     * dev. Scales the bandwidth in data by the factor learned for the scene.
+     */
+    void setRequest(AcrylicDevice *dev, AcrylicPerformanceRequest &request, g2d_performance &data);
+    /* Called when the request on dev is canceled */
+    void cancelRequest(AcrylicDevice *dev);
+    /* Returns the submission time to pass to endTask() */
+    int64_t beginTask();
+    /*
+     * Records a task submitted on dev. The task completes when release_fence
+     * signals, or has completed already if release_fence is negative and
+     * blocking is true. The fence is duplicated.
+     */
+    void endTask(AcrylicDevice *dev, int64_t submit_ns, int release_fence, bool blocking);
+    /* Drops all state about dev */
+    void detach(AcrylicDevice *dev);
+    void getStats(AcrylicDevice *dev, AcrylicPerformanceStats &stats);
+
+private:
+    struct Scene {
+        uint32_t factor;         // Q10 scale of the bandwidth
+        uint64_t lastUse;
+    };
+
+    struct Task {
+        AcrylicDevice *dev;
+        uint64_t signature;      // 0 without a request
+        uint32_t deadlineUSec;
+        int64_t submitNs;
+        int64_t completeNs;      // 0 until the fence signals
+        int fence;
+    };
+
+    struct ClientStats {
+        uint64_t tasks = 0;
+        uint64_t lateTasks = 0;
+        uint64_t queueUSec = 0;
+        uint64_t execUSec = 0;
+        int64_t errorUSec = 0;
+        uint64_t absErrorUSec = 0;
+        uint32_t maxLateUSec = 0;
+    };
+
+    G2DQoSGovernor();
+
+    void harvestLocked();
+    void completeLocked(const Task &task);
+    void updateFactorLocked(uint64_t signature, uint32_t deadline_usec, int64_t latency_usec);
+    void applyLocked();
+    Scene &findSceneLocked(uint64_t signature);
+
+    std::mutex mMutex;
+    bool mEnabled;
+    uint32_t mDeadlinePercent;
+
+    /* The request in effect and the device it was sent on */
+    AcrylicDevice *mOwner = nullptr;
+    g2d_performance mModel;
+    uint64_t mSignature = 0;
+    uint32_t mDeadlineUSec = 0;
+    uint32_t mAppliedFactor = 0;
+    uint32_t mModelBandwidth = 0;
+    uint32_t mRequestedBandwidth = 0;
+
+    std::unordered_map<uint64_t, Scene> mScenes;
+    uint64_t mSceneClock = 0;
+    std::deque<Task> mPending;
+    int64_t mLastCompleteNs = 0;
+
+    std::map<AcrylicDevice *, ClientStats> mClients;
+    uint64_t mRequestCount = 0;
+    uint64_t mAdjustCount = 0;
+};
+
+#endif /* __HARDWARE_EXYNOS_ACRYLIC_G2D_QOS_H__ */
@@ -0,0 +1,1266 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
+#include "acrylic_software.h"
+
+#include <exynos_format.h> // hardware/smasung_slsi/exynos/include
+#include <hardware/hwcomposer2.h>
+#include <linux/dma-buf.h>
+#include <log/log.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <system/graphics.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#define HAL_DATASPACE_LEGACY_TYPE_MASK  ((1 << HAL_DATASPACE_STANDARD_SHIFT) - 1)
+
+/* Even, so that the rows of 4:2:0 chroma never straddle two bands */
+static const int32_t BAND_ROWS = 16;
+static const int FENCE_TIMEOUT_MSEC = 3000;
+static const unsigned int MAX_DEFAULT_WORKERS = 4;
+static const unsigned int MAX_WORKERS = 16;
+
+enum {
+    SW_LAYOUT_RGBA8888,
+    SW_LAYOUT_BGRA8888,
+    SW_LAYOUT_RGBX8888,
+    SW_LAYOUT_RGB888,
+    SW_LAYOUT_RGB565,
+    SW_LAYOUT_RGBA1010102,
+    SW_LAYOUT_YUYV,         /* Y0 Cb Y1 Cr */
+    SW_LAYOUT_YVYU,         /* Y0 Cr Y1 Cb */
+    SW_LAYOUT_NV12,
+    SW_LAYOUT_NV21,
+    SW_LAYOUT_P010,         /* NV12 with 10 bits in the upper bits of 16 */
+    SW_LAYOUT_I420,         /* Y, Cb, Cr planes */
+    SW_LAYOUT_YV12,         /* Y, Cr, Cb planes */
+};
+
+static struct {
+    uint32_t fmt;
+    int layout;
+} __halfmt_to_sw_layout[] = {
+    {HAL_PIXEL_FORMAT_RGBA_8888,                  SW_LAYOUT_RGBA8888   },
+    {HAL_PIXEL_FORMAT_BGRA_8888,                  SW_LAYOUT_BGRA8888   },
+    {HAL_PIXEL_FORMAT_RGBX_8888,                  SW_LAYOUT_RGBX8888   },
+    {HAL_PIXEL_FORMAT_RGB_888,                    SW_LAYOUT_RGB888     },
+    {HAL_PIXEL_FORMAT_RGB_565,                    SW_LAYOUT_RGB565     },
+    {HAL_PIXEL_FORMAT_RGBA_1010102,               SW_LAYOUT_RGBA1010102},
+    {HAL_PIXEL_FORMAT_YCbCr_422_I,                SW_LAYOUT_YUYV       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_422_I,         SW_LAYOUT_YVYU       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,        SW_LAYOUT_NV12       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M,      SW_LAYOUT_NV12       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_PRIV, SW_LAYOUT_NV12       },
+    {HAL_PIXEL_FORMAT_YCrCb_420_SP,               SW_LAYOUT_NV21       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M,      SW_LAYOUT_NV21       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL, SW_LAYOUT_NV21       },
+    {HAL_PIXEL_FORMAT_YCBCR_P010,                 SW_LAYOUT_P010       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_P010_M,        SW_LAYOUT_P010       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P,         SW_LAYOUT_I420       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P_M,       SW_LAYOUT_I420       },
+    {HAL_PIXEL_FORMAT_EXYNOS_YV12_M,              SW_LAYOUT_YV12       },
+};
+
+static uint32_t __software_formats[] = {
+    HAL_PIXEL_FORMAT_RGBA_8888,
+    HAL_PIXEL_FORMAT_BGRA_8888,
+    HAL_PIXEL_FORMAT_RGBX_8888,
+    HAL_PIXEL_FORMAT_RGB_888,
+    HAL_PIXEL_FORMAT_RGB_565,
+    HAL_PIXEL_FORMAT_RGBA_1010102,
+    HAL_PIXEL_FORMAT_YCbCr_422_I,
+    HAL_PIXEL_FORMAT_EXYNOS_YCrCb_422_I,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_PRIV,
+    HAL_PIXEL_FORMAT_YCrCb_420_SP,
+    HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M,
+    HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL,
+    HAL_PIXEL_FORMAT_YCBCR_P010,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_P010_M,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P,
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P_M,
+    HAL_PIXEL_FORMAT_EXYNOS_YV12_M,
+};
+
+static int __software_dataspaces[] = {
+    HAL_DATASPACE_UNKNOWN,
+    HAL_DATASPACE_SRGB,
+    HAL_DATASPACE_JFIF,
+    HAL_DATASPACE_BT601_525,
+    HAL_DATASPACE_BT601_625,
+    HAL_DATASPACE_BT709,
+    HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_RANGE_LIMITED,
+    HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_RANGE_EXTENDED,
+    HAL_DATASPACE_STANDARD_BT601_625 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_BT601_625 | HAL_DATASPACE_RANGE_LIMITED,
+    HAL_DATASPACE_STANDARD_BT601_525 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_BT601_525 | HAL_DATASPACE_RANGE_LIMITED,
+    HAL_DATASPACE_STANDARD_BT2020 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_BT2020 | HAL_DATASPACE_RANGE_LIMITED,
+    HAL_DATASPACE_STANDARD_DCI_P3 | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_FILM | HAL_DATASPACE_RANGE_FULL,
+    HAL_DATASPACE_STANDARD_FILM | HAL_DATASPACE_RANGE_LIMITED,
+};
+
+static const stHW2DCapability __software_capability = {
+    .max_upsampling_num = {8, 8},
+    .max_downsampling_factor = {4, 4},
+    .max_upsizing_num = {8, 8},
+    .max_downsizing_factor = {4, 4},
+    .min_src_dimension = {1, 1},
+    .max_src_dimension = {8192, 8192},
+    .min_dst_dimension = {1, 1},
+    .max_dst_dimension = {8192, 8192},
+    .min_pix_align = {1, 1},
+    .rescaling_count = 0,
+    .compositing_mode = HW2DCapability::BLEND_NONE | HW2DCapability::BLEND_SRC_COPY |
+                        HW2DCapability::BLEND_SRC_OVER,
+    .transform_type = HW2DCapability::TRANSFORM_ALL,
+    .auxiliary_feature = HW2DCapability::FEATURE_PLANE_ALPHA | HW2DCapability::FEATURE_SOLIDCOLOR,
+    .num_formats = ARRSIZE(__software_formats),
+    .num_dataspaces = ARRSIZE(__software_dataspaces),
+    .max_layers = 16,
+    .pixformats = __software_formats,
+    .dataspaces = __software_dataspaces,
+    .base_align = 1,
+};
+
+static const HW2DCapability __software_hw2d_capability(__software_capability);
+
+static int halfmt_to_sw_layout(uint32_t fmt)
+{
+    for (size_t i = 0; i < ARRSIZE(__halfmt_to_sw_layout); i++) {
+        if (__halfmt_to_sw_layout[i].fmt == fmt)
+            return __halfmt_to_sw_layout[i].layout;
+    }
+
+    return -1;
+}
+
+static bool sw_layout_is_yuv(int layout)
+{
+    return layout >= SW_LAYOUT_YUYV;
+}
+
+/*
+ * YCbCr <-> RGB in 10 bits with the coefficients in Q14. The full range
+ * leaves the values as they are and the limited range maps Y to [64, 940]
+ * and Cb/Cr to [64, 960].
+ */
+struct YCbCrMatrix {
+    int32_t offset;
+    int32_t y, rv, gu, gv, bu;                  /* to RGB */
+    int32_t yr, yg, yb, ur, ug, ub, vr, vg, vb; /* from RGB */
+};
+
+static constexpr int32_t q14(double v)
+{
+    return static_cast<int32_t>(v * 16384 + ((v < 0) ? -0.5 : 0.5));
+}
+
+static constexpr YCbCrMatrix make_ycbcr_matrix(double kr, double kb, bool full)
+{
+    double kg = 1.0 - kr - kb;
+    double ys = full ? 1.0 : (1023.0 / 876.0);
+    double cs = full ? 1.0 : (1023.0 / 896.0);
+
+    return {
+        full ? 0 : 64,
+        q14(ys), q14(cs * 2 * (1 - kr)), q14(-cs * 2 * kb * (1 - kb) / kg),
+        q14(-cs * 2 * kr * (1 - kr) / kg), q14(cs * 2 * (1 - kb)),
+        q14(kr / ys), q14(kg / ys), q14(kb / ys),
+        q14(-kr / (2 * (1 - kb)) / cs), q14(-kg / (2 * (1 - kb)) / cs), q14(0.5 / cs),
+        q14(0.5 / cs), q14(-kg / (2 * (1 - kr)) / cs), q14(-kb / (2 * (1 - kr)) / cs),
+    };
+}
+
+enum { SW_CSC_601, SW_CSC_709, SW_CSC_2020, SW_CSC_STD_COUNT };
+
+static constexpr YCbCrMatrix __ycbcr_matrix[SW_CSC_STD_COUNT][2] = {
+    {make_ycbcr_matrix(0.299, 0.114, false), make_ycbcr_matrix(0.299, 0.114, true)},
+    {make_ycbcr_matrix(0.2126, 0.0722, false), make_ycbcr_matrix(0.2126, 0.0722, true)},
+    {make_ycbcr_matrix(0.2627, 0.0593, false), make_ycbcr_matrix(0.2627, 0.0593, true)},
+};
+
+/* The same defaults as haldataspace_to_v4l2() for what the dataspace does not tell */
+static const YCbCrMatrix &dataspace_to_matrix(int dataspace, int32_t width, int32_t height)
+{
+    int std = ((width * height) < (1280 * 720)) ? SW_CSC_601 : SW_CSC_709;
+    bool full = false;
+
+    if ((dataspace & HAL_DATASPACE_LEGACY_TYPE_MASK) != 0) {
+        switch (dataspace & HAL_DATASPACE_LEGACY_TYPE_MASK) {
+        case HAL_DATASPACE_JFIF:
+            std = SW_CSC_601;
+            full = true;
+            break;
+        case HAL_DATASPACE_BT601_525:
+        case HAL_DATASPACE_BT601_625:
+            std = SW_CSC_601;
+            break;
+        case HAL_DATASPACE_BT709:
+            std = SW_CSC_709;
+            break;
+        case HAL_DATASPACE_SRGB:
+            std = SW_CSC_709;
+            full = true;
+            break;
+        }
+        return __ycbcr_matrix[std][full];
+    }
+
+    switch (dataspace & HAL_DATASPACE_STANDARD_MASK) {
+    case HAL_DATASPACE_STANDARD_BT601_625:
+    case HAL_DATASPACE_STANDARD_BT601_625_UNADJUSTED:
+    case HAL_DATASPACE_STANDARD_BT601_525:
+    case HAL_DATASPACE_STANDARD_BT601_525_UNADJUSTED:
+        std = SW_CSC_601;
+        break;
+    case HAL_DATASPACE_STANDARD_BT709:
+    case HAL_DATASPACE_STANDARD_FILM:
+    case HAL_DATASPACE_STANDARD_DCI_P3:
+        std = SW_CSC_709;
+        break;
+    case HAL_DATASPACE_STANDARD_BT2020:
+    case HAL_DATASPACE_STANDARD_BT2020_CONSTANT_LUMINANCE:
+        std = SW_CSC_2020;
+        break;
+    }
+
+    int range = dataspace & HAL_DATASPACE_RANGE_MASK;
+    full = (range == HAL_DATASPACE_RANGE_FULL) || (range == HAL_DATASPACE_RANGE_EXTENDED);
+
+    return __ycbcr_matrix[std][full];
+}
+
+static inline uint16_t clamp10(int32_t v)
+{
+    return static_cast<uint16_t>(std::min(std::max(v, 0), 1023));
+}
+
+/* a * b / 1023 rounded to the nearest */
+static inline uint16_t mul10(uint32_t a, uint32_t b)
+{
+    uint32_t t = a * b + 512;
+    return static_cast<uint16_t>((t + (t >> 10)) >> 10);
+}
+
+static inline uint16_t expand8(uint32_t v)
+{
+    return static_cast<uint16_t>((v << 2) | (v >> 6));
+}
+
+static inline uint8_t reduce8(uint32_t v)
+{
+    return static_cast<uint8_t>((v * 255 + 511) / 1023);
+}
+
+/* The pixels of a canvas mapped for the CPU */
+struct AcrylicSoftwareImage {
+    int layout = -1;
+    int32_t width = 0;
+    int32_t height = 0;
+    uint8_t *plane[3] = {nullptr, nullptr, nullptr};
+    uint32_t stride[3] = {0, 0, 0};
+    const YCbCrMatrix *matrix = nullptr;
+
+    struct Mapping {
+        void *addr;
+        size_t len;
+        int fd;
+    };
+    std::vector<Mapping> mappings;
+    bool writable = false;
+
+    ~AcrylicSoftwareImage() { unmap(); }
+
+    bool map(AcrylicCanvas &canvas, bool write);
+    void unmap();
+};
+
+static void syncDmabuf(int fd, uint64_t flags)
+{
+    struct dma_buf_sync sync;
+
+    sync.flags = flags;
+    if (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0)
+        ALOGERR("Failed to sync dmabuf %d with flags %#llx", fd, static_cast<unsigned long long>(flags));
+}
+
+bool AcrylicSoftwareImage::map(AcrylicCanvas &canvas, bool write)
+{
+    layout = halfmt_to_sw_layout(canvas.getFormat());
+    if (layout < 0) {
+        ALOGE("Format %#x is not supported by the software compositor", canvas.getFormat());
+        return false;
+    }
+
+    if (canvas.isProtected() || canvas.isCompressed() || canvas.isCompressedWideblk()) {
+        ALOGE("Protected or compressed buffers are not accessible to the software compositor");
+        return false;
+    }
+
+    if ((canvas.getBufferType() != AcrylicCanvas::MT_DMABUF) &&
+            (canvas.getBufferType() != AcrylicCanvas::MT_USERPTR)) {
+        ALOGE("Buffer type %d is not supported by the software compositor", canvas.getBufferType());
+        return false;
+    }
+
+    hw2d_coord_t xy = canvas.getImageDimension();
+    width = xy.hori;
+    height = xy.vert;
+    writable = write;
+
+    uint8_t *buf[MAX_HW2D_PLANES] = {nullptr, };
+    size_t len[MAX_HW2D_PLANES] = {0, };
+    unsigned int bufcnt = canvas.getBufferCount();
+
+    for (unsigned int i = 0; i < bufcnt; i++) {
+        len[i] = canvas.getBufferLength(i);
+        if (canvas.getBufferType() == AcrylicCanvas::MT_USERPTR) {
+            buf[i] = static_cast<uint8_t *>(canvas.getUserptr(i));
+            continue;
+        }
+
+        int fd = canvas.getDmabuf(i);
+        size_t maplen = len[i] + canvas.getOffset(i);
+        void *addr = mmap(NULL, maplen, write ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                          MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ALOGERR("Failed to map buffer %u (fd %d, %zu bytes)", i, fd, maplen);
+            return false;
+        }
+
+        syncDmabuf(fd, DMA_BUF_SYNC_START | (write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ));
+
+        mappings.push_back({addr, maplen, fd});
+        buf[i] = static_cast<uint8_t *>(addr) + canvas.getOffset(i);
+    }
+
+    bool wide = (layout == SW_LAYOUT_P010);
+    int32_t cw = (width + 1) / 2;
+    int32_t ch = (height + 1) / 2;
+    size_t need[3] = {0, 0, 0};
+    int planes = 1;
+
+    switch (layout) {
+    case SW_LAYOUT_RGBA8888:
+    case SW_LAYOUT_BGRA8888:
+    case SW_LAYOUT_RGBX8888:
+    case SW_LAYOUT_RGBA1010102:
+        stride[0] = width * 4;
+        break;
+    case SW_LAYOUT_RGB888:
+        stride[0] = width * 3;
+        break;
+    case SW_LAYOUT_RGB565:
+    case SW_LAYOUT_YUYV:
+    case SW_LAYOUT_YVYU:
+        stride[0] = width * 2;
+        break;
+    case SW_LAYOUT_NV12:
+    case SW_LAYOUT_NV21:
+    case SW_LAYOUT_P010:
+        planes = 2;
+        stride[0] = width * (wide ? 2 : 1);
+        stride[1] = cw * 2 * (wide ? 2 : 1);
+        need[1] = static_cast<size_t>(stride[1]) * ch;
+        break;
+    case SW_LAYOUT_I420:
+    case SW_LAYOUT_YV12:
+        planes = 3;
+        stride[0] = width;
+        stride[1] = stride[2] = cw;
+        need[1] = need[2] = static_cast<size_t>(cw) * ch;
+        break;
+    }
+    need[0] = static_cast<size_t>(stride[0]) * height;
+
+    for (int i = 0; i < planes; i++) {
+        unsigned int idx = (bufcnt > 1) ? i : 0;
+        size_t offset = 0;
+
+        if (idx >= bufcnt) {
+            ALOGE("Format %#x needs %d buffers but %u are given", canvas.getFormat(), planes, bufcnt);
+            return false;
+        }
+
+        /* The planes of a single buffer follow each other */
+        if (bufcnt == 1) {
+            for (int j = 0; j < i; j++)
+                offset += need[j];
+        }
+
+        if (!buf[idx] || ((offset + need[i]) > len[idx])) {
+            ALOGE("Buffer %u of %zu bytes is too small for plane %d of %dx%d format %#x",
+                  idx, len[idx], i, width, height, canvas.getFormat());
+            return false;
+        }
+
+        plane[i] = buf[idx] + offset;
+    }
+
+    /* YV12 stores Cr before Cb */
+    if (layout == SW_LAYOUT_YV12)
+        std::swap(plane[1], plane[2]);
+
+    if (sw_layout_is_yuv(layout))
+        matrix = &dataspace_to_matrix(canvas.getDataspace(), width, height);
+
+    return true;
+}
+
+void AcrylicSoftwareImage::unmap()
+{
+    for (auto &m : mappings) {
+        syncDmabuf(m.fd, DMA_BUF_SYNC_END | (writable ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ));
+        munmap(m.addr, m.len);
+    }
+    mappings.clear();
+}
+
+enum { SW_BLEND_COPY, SW_BLEND_PREMULT, SW_BLEND_COVERAGE };
+
+/*
+ * Where every pixel of a target span samples one axis of the source: the
+ * two neighbours and the weight of the second one in 1/256.
+ */
+struct AcrylicSoftwareAxis {
+    std::vector<int32_t> idx0;
+    std::vector<int32_t> idx1;
+    std::vector<uint16_t> frac;
+
+    void build(int32_t count, int32_t length, bool reverse, bool nearest);
+    int32_t min(int32_t from, int32_t to) const { return std::min(idx0[from], idx0[to - 1]); }
+    int32_t max(int32_t from, int32_t to) const { return std::max(idx1[from], idx1[to - 1]); }
+};
+
+void AcrylicSoftwareAxis::build(int32_t count, int32_t length, bool reverse, bool nearest)
+{
+    idx0.resize(count);
+    idx1.resize(count);
+    frac.resize(count);
+
+    for (int32_t i = 0; i < count; i++) {
+        int32_t j = reverse ? (count - 1 - i) : i;
+        // the center of the target pixel in the source in 1/256 pixels
+        int64_t pos = ((2 * j + 1) * static_cast<int64_t>(length) * 256) / (2 * count) - 128;
+        if (nearest)
+            pos = (pos + 128) & ~static_cast<int64_t>(255);
+        int32_t p = static_cast<int32_t>(pos >> 8);
+
+        idx0[i] = std::min(std::max(p, 0), length - 1);
+        idx1[i] = std::min(std::max(p + 1, 0), length - 1);
+        frac[i] = static_cast<uint16_t>(pos & 255);
+    }
+}
+
+struct AcrylicSoftwareSource {
+    AcrylicSoftwareImage image;
+    bool solid = false;
+    uint16_t color[4] = {0, 0, 0, 0};
+    int blend = SW_BLEND_COPY;
+    uint16_t planeAlpha = 1023;
+
+    /* The crop in the source and the window in the target, clipped to the target */
+    int32_t cropX = 0, cropY = 0, cropW = 0, cropH = 0;
+    int32_t winLeft = 0, winTop = 0;
+    int32_t left = 0, top = 0, right = 0, bottom = 0;
+
+    /* Without rotation the target columns sample source columns, otherwise source rows */
+    bool rotate = false;
+    bool identity = false;
+    AcrylicSoftwareAxis cols;
+    AcrylicSoftwareAxis rows;
+};
+
+/* The part of a source that a band needs, in 10-bit RGBA with the blending mode applied */
+struct AcrylicSoftwareRegion {
+    int32_t x = 0, y = 0, w = 0, h = 0;
+    std::vector<uint16_t> pixels[4];
+};
+
+struct AcrylicSoftwareScratch {
+    std::vector<AcrylicSoftwareRegion> regions;
+    std::vector<uint16_t> span[4];
+    std::vector<uint16_t> accum[2][4];
+    std::vector<uint16_t> yuv[2][3];
+};
+
+/* Reads count pixels of row y from x as 10-bit R, G, B, A or Y, Cb, Cr */
+static void decodeRow(const AcrylicSoftwareImage &image, int32_t x, int32_t y, int32_t count,
+                      uint16_t *out[4])
+{
+    const uint8_t *row = image.plane[0] + static_cast<size_t>(y) * image.stride[0];
+    uint16_t *r = out[0], *g = out[1], *b = out[2], *a = out[3];
+
+    switch (image.layout) {
+    case SW_LAYOUT_RGBA8888:
+    case SW_LAYOUT_RGBX8888:
+    case SW_LAYOUT_BGRA8888: {
+        const uint8_t *p = row + x * 4;
+        bool bgr = (image.layout == SW_LAYOUT_BGRA8888);
+        bool opaque = (image.layout == SW_LAYOUT_RGBX8888);
+        for (int32_t i = 0; i < count; i++, p += 4) {
+            r[i] = expand8(p[bgr ? 2 : 0]);
+            g[i] = expand8(p[1]);
+            b[i] = expand8(p[bgr ? 0 : 2]);
+            a[i] = opaque ? 1023 : expand8(p[3]);
+        }
+        return;
+    }
+    case SW_LAYOUT_RGB888: {
+        const uint8_t *p = row + x * 3;
+        for (int32_t i = 0; i < count; i++, p += 3) {
+            r[i] = expand8(p[0]);
+            g[i] = expand8(p[1]);
+            b[i] = expand8(p[2]);
+            a[i] = 1023;
+        }
+        return;
+    }
+    case SW_LAYOUT_RGB565: {
+        const uint16_t *p = reinterpret_cast<const uint16_t *>(row) + x;
+        for (int32_t i = 0; i < count; i++) {
+            uint32_t v = p[i];
+            uint32_t r5 = v >> 11, g6 = (v >> 5) & 0x3F, b5 = v & 0x1F;
+            r[i] = static_cast<uint16_t>((r5 << 5) | r5);
+            g[i] = static_cast<uint16_t>((g6 << 4) | (g6 >> 2));
+            b[i] = static_cast<uint16_t>((b5 << 5) | b5);
+            a[i] = 1023;
+        }
+        return;
+    }
+    case SW_LAYOUT_RGBA1010102: {
+        const uint32_t *p = reinterpret_cast<const uint32_t *>(row) + x;
+        for (int32_t i = 0; i < count; i++) {
+            uint32_t v = p[i];
+            r[i] = v & 0x3FF;
+            g[i] = (v >> 10) & 0x3FF;
+            b[i] = (v >> 20) & 0x3FF;
+            a[i] = static_cast<uint16_t>((v >> 30) * 341);
+        }
+        return;
+    }
+    case SW_LAYOUT_YUYV:
+    case SW_LAYOUT_YVYU: {
+        int cb = (image.layout == SW_LAYOUT_YUYV) ? 1 : 3;
+        for (int32_t i = 0; i < count; i++) {
+            const uint8_t *p = row + ((x + i) & ~1) * 2;
+            r[i] = p[((x + i) & 1) * 2] << 2;
+            g[i] = p[cb] << 2;
+            b[i] = p[4 - cb] << 2;
+        }
+        break;
+    }
+    case SW_LAYOUT_NV12:
+    case SW_LAYOUT_NV21: {
+        const uint8_t *c = image.plane[1] + static_cast<size_t>(y / 2) * image.stride[1];
+        int cb = (image.layout == SW_LAYOUT_NV12) ? 0 : 1;
+        for (int32_t i = 0; i < count; i++) {
+            r[i] = row[x + i] << 2;
+            g[i] = c[((x + i) / 2) * 2 + cb] << 2;
+            b[i] = c[((x + i) / 2) * 2 + 1 - cb] << 2;
+        }
+        break;
+    }
+    case SW_LAYOUT_P010: {
+        const uint16_t *l = reinterpret_cast<const uint16_t *>(row);
+        const uint16_t *c = reinterpret_cast<const uint16_t *>(
+                image.plane[1] + static_cast<size_t>(y / 2) * image.stride[1]);
+        for (int32_t i = 0; i < count; i++) {
+            r[i] = l[x + i] >> 6;
+            g[i] = c[((x + i) / 2) * 2] >> 6;
+            b[i] = c[((x + i) / 2) * 2 + 1] >> 6;
+        }
+        break;
+    }
+    case SW_LAYOUT_I420:
+    case SW_LAYOUT_YV12: {
+        const uint8_t *u = image.plane[1] + static_cast<size_t>(y / 2) * image.stride[1];
+        const uint8_t *v = image.plane[2] + static_cast<size_t>(y / 2) * image.stride[2];
+        for (int32_t i = 0; i < count; i++) {
+            r[i] = row[x + i] << 2;
+            g[i] = u[(x + i) / 2] << 2;
+            b[i] = v[(x + i) / 2] << 2;
+        }
+        break;
+    }
+    }
+
+    /* Y, Cb and Cr are in r, g and b */
+    const YCbCrMatrix &m = *image.matrix;
+    for (int32_t i = 0; i < count; i++) {
+        int32_t yy = (r[i] - m.offset) * m.y;
+        int32_t cb = g[i] - 512;
+        int32_t cr = b[i] - 512;
+        r[i] = clamp10((yy + m.rv * cr + 8192) >> 14);
+        g[i] = clamp10((yy + m.gu * cb + m.gv * cr + 8192) >> 14);
+        b[i] = clamp10((yy + m.bu * cb + 8192) >> 14);
+        a[i] = 1023;
+    }
+}
+
+static void applyBlending(int blend, int32_t count, uint16_t *out[4])
+{
+    uint16_t *r = out[0], *g = out[1], *b = out[2], *a = out[3];
+
+    if (blend == SW_BLEND_COPY) {
+        std::fill(a, a + count, 1023);
+    } else if (blend == SW_BLEND_COVERAGE) {
+        for (int32_t i = 0; i < count; i++) {
+            r[i] = mul10(r[i], a[i]);
+            g[i] = mul10(g[i], a[i]);
+            b[i] = mul10(b[i], a[i]);
+        }
+    }
+}
+
+static void decodeRegion(const AcrylicSoftwareSource &source, AcrylicSoftwareRegion &region,
+                         int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    region.x = x;
+    region.y = y;
+    region.w = w;
+    region.h = h;
+    for (auto &pixels : region.pixels)
+        pixels.resize(static_cast<size_t>(w) * h);
+
+    for (int32_t j = 0; j < h; j++) {
+        uint16_t *out[4];
+        for (int c = 0; c < 4; c++)
+            out[c] = region.pixels[c].data() + static_cast<size_t>(j) * w;
+        decodeRow(source.image, source.cropX + x, source.cropY + y + j, w, out);
+        applyBlending(source.blend, w, out);
+    }
+}
+
+/* Samples the span [x0, x1) of target row y from the decoded region */
+static void sampleSpan(const AcrylicSoftwareSource &source, const AcrylicSoftwareRegion &region,
+                       int32_t y, int32_t x0, int32_t x1, uint16_t *out[4])
+{
+    int32_t count = x1 - x0;
+    int32_t jr = y - source.winTop;
+    int32_t jc = x0 - source.winLeft;
+
+    if (source.identity) {
+        size_t offset = static_cast<size_t>(jr - region.y) * region.w + (jc - region.x);
+        for (int c = 0; c < 4; c++)
+            memcpy(out[c], region.pixels[c].data() + offset, count * sizeof(uint16_t));
+        return;
+    }
+
+    const AcrylicSoftwareAxis &xs = source.rotate ? source.rows : source.cols;
+    const AcrylicSoftwareAxis &ys = source.rotate ? source.cols : source.rows;
+
+    for (int32_t i = 0; i < count; i++) {
+        int32_t xi = source.rotate ? jr : (jc + i);
+        int32_t yi = source.rotate ? (jc + i) : jr;
+        uint32_t fx = xs.frac[xi], fy = ys.frac[yi];
+        size_t row0 = static_cast<size_t>(ys.idx0[yi] - region.y) * region.w;
+        size_t row1 = static_cast<size_t>(ys.idx1[yi] - region.y) * region.w;
+        int32_t col0 = xs.idx0[xi] - region.x;
+        int32_t col1 = xs.idx1[xi] - region.x;
+
+        for (int c = 0; c < 4; c++) {
+            const uint16_t *p = region.pixels[c].data();
+            uint32_t top = p[row0 + col0] * (256 - fx) + p[row0 + col1] * fx;
+            uint32_t bottom = p[row1 + col0] * (256 - fx) + p[row1 + col1] * fx;
+            out[c][i] = static_cast<uint16_t>((top * (256 - fy) + bottom * fy + 32768) >> 16);
+        }
+    }
+}
+
+/* Writes count composited pixels to row y */
+static void encodeRow(const AcrylicSoftwareImage &image, int32_t y, int32_t count,
+                      uint16_t *in[4])
+{
+    uint8_t *row = image.plane[0] + static_cast<size_t>(y) * image.stride[0];
+    const uint16_t *r = in[0], *g = in[1], *b = in[2], *a = in[3];
+
+    switch (image.layout) {
+    case SW_LAYOUT_RGBA8888:
+    case SW_LAYOUT_RGBX8888:
+    case SW_LAYOUT_BGRA8888: {
+        bool bgr = (image.layout == SW_LAYOUT_BGRA8888);
+        bool opaque = (image.layout == SW_LAYOUT_RGBX8888);
+        for (int32_t i = 0; i < count; i++, row += 4) {
+            row[bgr ? 2 : 0] = reduce8(r[i]);
+            row[1] = reduce8(g[i]);
+            row[bgr ? 0 : 2] = reduce8(b[i]);
+            row[3] = opaque ? 255 : reduce8(a[i]);
+        }
+        break;
+    }
+    case SW_LAYOUT_RGB888:
+        for (int32_t i = 0; i < count; i++, row += 3) {
+            row[0] = reduce8(r[i]);
+            row[1] = reduce8(g[i]);
+            row[2] = reduce8(b[i]);
+        }
+        break;
+    case SW_LAYOUT_RGB565: {
+        uint16_t *p = reinterpret_cast<uint16_t *>(row);
+        for (int32_t i = 0; i < count; i++) {
+            uint32_t r5 = (r[i] * 31 + 511) / 1023;
+            uint32_t g6 = (g[i] * 63 + 511) / 1023;
+            uint32_t b5 = (b[i] * 31 + 511) / 1023;
+            p[i] = static_cast<uint16_t>((r5 << 11) | (g6 << 5) | b5);
+        }
+        break;
+    }
+    case SW_LAYOUT_RGBA1010102: {
+        uint32_t *p = reinterpret_cast<uint32_t *>(row);
+        for (int32_t i = 0; i < count; i++)
+            p[i] = r[i] | (g[i] << 10) | (b[i] << 20) | (((a[i] * 3u + 511) / 1023) << 30);
+        break;
+    }
+    }
+}
+
+static void rgbToYCbCr(const YCbCrMatrix &m, int32_t count, uint16_t *in[4], uint16_t *out[3])
+{
+    const uint16_t *r = in[0], *g = in[1], *b = in[2];
+
+    for (int32_t i = 0; i < count; i++) {
+        out[0][i] = clamp10(((m.yr * r[i] + m.yg * g[i] + m.yb * b[i] + 8192) >> 14) + m.offset);
+        out[1][i] = clamp10(((m.ur * r[i] + m.ug * g[i] + m.ub * b[i] + 8192) >> 14) + 512);
+        out[2][i] = clamp10(((m.vr * r[i] + m.vg * g[i] + m.vb * b[i] + 8192) >> 14) + 512);
+    }
+}
+
+/*
+ * Writes rows y and y + 1 (if rows is 2) of a YCbCr target. The chroma is the
+ * average of the 2x1 or 2x2 pixels it covers.
+ */
+static void encodeYCbCrRows(const AcrylicSoftwareImage &image, int32_t y, int32_t rows,
+                            int32_t count, std::vector<uint16_t> yuv[2][3])
+{
+    bool vsub = (image.layout != SW_LAYOUT_YUYV) && (image.layout != SW_LAYOUT_YVYU);
+    int32_t cw = (count + 1) / 2;
+
+    for (int32_t j = 0; j < rows; j++) {
+        const uint16_t *luma = yuv[j][0].data();
+        uint8_t *row = image.plane[0] + static_cast<size_t>(y + j) * image.stride[0];
+
+        if (image.layout == SW_LAYOUT_P010) {
+            uint16_t *p = reinterpret_cast<uint16_t *>(row);
+            for (int32_t i = 0; i < count; i++)
+                p[i] = luma[i] << 6;
+        } else if (vsub) {
+            for (int32_t i = 0; i < count; i++)
+                row[i] = static_cast<uint8_t>(std::min((luma[i] + 2) >> 2, 255));
+        }
+
+        if (vsub)
+            continue;
+
+        int cb = (image.layout == SW_LAYOUT_YUYV) ? 1 : 3;
+        for (int32_t i = 0; i < cw; i++) {
+            int32_t n = ((i * 2 + 1) < count) ? 2 : 1;
+            uint32_t u = yuv[j][1][i * 2] + ((n > 1) ? yuv[j][1][i * 2 + 1] : 0);
+            uint32_t v = yuv[j][2][i * 2] + ((n > 1) ? yuv[j][2][i * 2 + 1] : 0);
+            uint8_t *p = row + i * 4;
+            p[0] = static_cast<uint8_t>(std::min((luma[i * 2] + 2) >> 2, 255));
+            if (n > 1)
+                p[2] = static_cast<uint8_t>(std::min((luma[i * 2 + 1] + 2) >> 2, 255));
+            p[cb] = static_cast<uint8_t>(std::min((((u + n / 2) / n) + 2) >> 2, 255u));
+            p[4 - cb] = static_cast<uint8_t>(std::min((((v + n / 2) / n) + 2) >> 2, 255u));
+        }
+    }
+
+    if (!vsub)
+        return;
+
+    uint8_t *c0 = image.plane[1] + static_cast<size_t>(y / 2) * image.stride[1];
+    uint8_t *c1 = image.plane[2] ? (image.plane[2] + static_cast<size_t>(y / 2) * image.stride[2])
+                                 : nullptr;
+
+    for (int32_t i = 0; i < cw; i++) {
+        int32_t cols = ((i * 2 + 1) < count) ? 2 : 1;
+        uint32_t n = cols * rows;
+        uint32_t u = 0, v = 0;
+        for (int32_t j = 0; j < rows; j++) {
+            for (int32_t k = 0; k < cols; k++) {
+                u += yuv[j][1][i * 2 + k];
+                v += yuv[j][2][i * 2 + k];
+            }
+        }
+        u = (u + n / 2) / n;
+        v = (v + n / 2) / n;
+
+        switch (image.layout) {
+        case SW_LAYOUT_NV12:
+        case SW_LAYOUT_NV21: {
+            int cb = (image.layout == SW_LAYOUT_NV12) ? 0 : 1;
+            c0[i * 2 + cb] = static_cast<uint8_t>(std::min((u + 2) >> 2, 255u));
+            c0[i * 2 + 1 - cb] = static_cast<uint8_t>(std::min((v + 2) >> 2, 255u));
+            break;
+        }
+        case SW_LAYOUT_P010: {
+            uint16_t *p = reinterpret_cast<uint16_t *>(c0);
+            p[i * 2] = static_cast<uint16_t>(u << 6);
+            p[i * 2 + 1] = static_cast<uint16_t>(v << 6);
+            break;
+        }
+        default: /* I420 and YV12 with Cb in plane 1 */
+            c0[i] = static_cast<uint8_t>(std::min((u + 2) >> 2, 255u));
+            c1[i] = static_cast<uint8_t>(std::min((v + 2) >> 2, 255u));
+            break;
+        }
+    }
+}
+
+AcrylicSoftwareWorkers::AcrylicSoftwareWorkers(unsigned int count)
+{
+    for (unsigned int i = 1; i < count; i++)
+        mThreads.emplace_back(&AcrylicSoftwareWorkers::loop, this, i);
+}
+
+AcrylicSoftwareWorkers::~AcrylicSoftwareWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mStart.notify_all();
+
+    for (auto &thread : mThreads)
+        thread.join();
+}
+
+void AcrylicSoftwareWorkers::work(unsigned int worker)
+{
+    for (unsigned int i = mNextJob++; i < mNumJobs; i = mNextJob++)
+        (*mJob)(i, worker);
+}
+
+void AcrylicSoftwareWorkers::loop(unsigned int worker)
+{
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true) {
+        mStart.wait(lock, [&] { return mExit || (mGeneration != generation); });
+        if (mExit)
+            return;
+        generation = mGeneration;
+
+        lock.unlock();
+        work(worker);
+        lock.lock();
+
+        if (--mBusy == 0)
+            mDone.notify_one();
+    }
+}
+
+void AcrylicSoftwareWorkers::run(unsigned int num_jobs,
+                                 const std::function<void(unsigned int, unsigned int)> &job)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mJob = &job;
+    mNumJobs = num_jobs;
+    mNextJob = 0;
+    mBusy = static_cast<unsigned int>(mThreads.size());
+    mGeneration++;
+    lock.unlock();
+    mStart.notify_all();
+
+    work(0);
+
+    lock.lock();
+    mDone.wait(lock, [&] { return mBusy == 0; });
+    mJob = nullptr;
+}
+
+AcrylicCompositorSoftware::AcrylicCompositorSoftware(const HW2DCapability &capability,
+                                                     unsigned int num_workers)
+    : Acrylic(capability), mWorkers(num_workers)
+{
+    mScratch.resize(mWorkers.count());
+
+    ALOGD_TEST("Created a new software Acrylic with %u workers on %p", mWorkers.count(), this);
+}
+
+AcrylicCompositorSoftware::~AcrylicCompositorSoftware()
+{
+    ALOGD_TEST("Deleting software Acrylic on %p", this);
+}
+
+static bool waitFence(AcrylicCanvas &canvas)
+{
+    int fence = canvas.getFence();
+    if (fence < 0)
+        return true;
+
+    struct pollfd fds = {fence, POLLIN, 0};
+    int ret;
+
+    do {
+        ret = poll(&fds, 1, FENCE_TIMEOUT_MSEC);
+    } while ((ret < 0) && ((errno == EINTR) || (errno == EAGAIN)));
+
+    if (ret <= 0) {
+        if (ret == 0)
+            ALOGE("Timed out waiting for fence %d", fence);
+        else
+            ALOGERR("Failed to wait for fence %d", fence);
+        return false;
+    }
+
+    canvas.setFence(-1);
+
+    return true;
+}
+
+bool AcrylicCompositorSoftware::prepareSource(AcrylicLayer &layer, AcrylicSoftwareSource &source)
+{
+    uint32_t mode = layer.getCompositingMode();
+    if ((mode == HWC_BLENDING_PREMULT) || (mode == HWC2_BLEND_MODE_PREMULTIPLIED))
+        source.blend = SW_BLEND_PREMULT;
+    else if ((mode == HWC_BLENDING_COVERAGE) || (mode == HWC2_BLEND_MODE_COVERAGE))
+        source.blend = SW_BLEND_COVERAGE;
+    else
+        source.blend = SW_BLEND_COPY;
+
+    source.planeAlpha = expand8(layer.getPlaneAlpha());
+
+    hw2d_coord_t target = getCanvas().getImageDimension();
+    hw2d_rect_t window = layer.getTargetRect();
+    if (area_is_zero(window)) {
+        window.pos = {0, 0};
+        window.size = target;
+    }
+
+    source.winLeft = window.pos.hori;
+    source.winTop = window.pos.vert;
+    source.left = std::max<int32_t>(window.pos.hori, 0);
+    source.top = std::max<int32_t>(window.pos.vert, 0);
+    source.right = std::min<int32_t>(window.pos.hori + window.size.hori, target.hori);
+    source.bottom = std::min<int32_t>(window.pos.vert + window.size.vert, target.vert);
+
+    if (layer.isSolidColor()) {
+        uint32_t color = layer.getSolidColor();
+        uint16_t *out[4];
+
+        source.solid = true;
+        source.color[0] = expand8((color >> 16) & 0xFF);
+        source.color[1] = expand8((color >> 8) & 0xFF);
+        source.color[2] = expand8(color & 0xFF);
+        source.color[3] = expand8(color >> 24);
+        for (int c = 0; c < 4; c++)
+            out[c] = &source.color[c];
+        applyBlending(source.blend, 1, out);
+
+        return true;
+    }
+
+    if (!waitFence(layer) || !source.image.map(layer, false))
+        return false;
+
+    hw2d_rect_t crop = layer.getImageRect();
+    source.cropX = crop.pos.hori;
+    source.cropY = crop.pos.vert;
+    source.cropW = crop.size.hori;
+    source.cropH = crop.size.vert;
+
+    if ((source.cropX + source.cropW > source.image.width) ||
+            (source.cropY + source.cropH > source.image.height)) {
+        ALOGE("Crop %dx%d@(%d,%d) is out of the %dx%d image", source.cropW, source.cropH,
+              source.cropX, source.cropY, source.image.width, source.image.height);
+        return false;
+    }
+
+    /*
+     * HAL transforms flip first and then rotate clockwise, so a target pixel
+     * rotates back first: the source x is the target y and the source y is
+     * the reversed target x. Then the flips reverse the source axes.
+     */
+    uint32_t transform = layer.getTransform();
+    bool flipH = !!(transform & HAL_TRANSFORM_FLIP_H);
+    bool flipV = !!(transform & HAL_TRANSFORM_FLIP_V);
+    bool nearest = !!(layer.getCompositAttr() & AcrylicLayer::ATTR_NORESAMPLING);
+
+    source.rotate = !!(transform & HAL_TRANSFORM_ROT_90);
+    if (source.rotate) {
+        source.cols.build(window.size.hori, source.cropH, !flipV, nearest);
+        source.rows.build(window.size.vert, source.cropW, flipH, nearest);
+    } else {
+        source.cols.build(window.size.hori, source.cropW, flipH, nearest);
+        source.rows.build(window.size.vert, source.cropH, flipV, nearest);
+    }
+
+    source.identity = !source.rotate && !flipH && !flipV &&
+                      (window.size.hori == source.cropW) && (window.size.vert == source.cropH);
+
+    return true;
+}
+
+void AcrylicCompositorSoftware::compositeBand(unsigned int band, AcrylicSoftwareScratch &scratch)
+{
+    const AcrylicSoftwareImage &target = *mTarget;
+    int32_t width = target.width;
+    int32_t y0 = band * BAND_ROWS;
+    int32_t y1 = std::min(y0 + BAND_ROWS, target.height);
+
+    scratch.regions.resize(mSources.size());
+
+    /* Decodes the source pixels the band samples */
+    for (size_t k = 0; k < mSources.size(); k++) {
+        const AcrylicSoftwareSource &source = mSources[k];
+        int32_t top = std::max(y0, source.top);
+        int32_t bottom = std::min(y1, source.bottom);
+
+        if (source.solid || (top >= bottom) || (source.left >= source.right))
+            continue;
+
+        int32_t r0 = top - source.winTop, r1 = bottom - source.winTop;
+        int32_t c0 = source.left - source.winLeft, c1 = source.right - source.winLeft;
+        int32_t x0, x1, sy0, sy1;
+
+        if (source.rotate) {
+            x0 = source.rows.min(r0, r1);
+            x1 = source.rows.max(r0, r1);
+            sy0 = source.cols.min(c0, c1);
+            sy1 = source.cols.max(c0, c1);
+        } else {
+            x0 = source.cols.min(c0, c1);
+            x1 = source.cols.max(c0, c1);
+            sy0 = source.rows.min(r0, r1);
+            sy1 = source.rows.max(r0, r1);
+        }
+
+        decodeRegion(source, scratch.regions[k], x0, sy0, x1 - x0 + 1, sy1 - sy0 + 1);
+    }
+
+    bool ycbcr = sw_layout_is_yuv(target.layout);
+    bool vsub = ycbcr && (target.layout != SW_LAYOUT_YUYV) && (target.layout != SW_LAYOUT_YVYU);
+
+    for (int32_t y = y0; y < y1; y++) {
+        int pair = (y - y0) & 1;
+        uint16_t *accum[4], *span[4];
+
+        for (int c = 0; c < 4; c++) {
+            accum[c] = scratch.accum[pair][c].data();
+            span[c] = scratch.span[c].data();
+            std::fill(accum[c], accum[c] + width, mHasBackground ? mBackground[c] : 0);
+        }
+
+        for (size_t k = 0; k < mSources.size(); k++) {
+            const AcrylicSoftwareSource &source = mSources[k];
+            if ((y < source.top) || (y >= source.bottom) || (source.left >= source.right))
+                continue;
+
+            int32_t x0 = source.left;
+            int32_t count = source.right - source.left;
+
+            if (source.solid) {
+                for (int c = 0; c < 4; c++)
+                    std::fill(span[c], span[c] + count, source.color[c]);
+            } else {
+                sampleSpan(source, scratch.regions[k], y, source.left, source.right, span);
+            }
+
+            if (source.planeAlpha != 1023) {
+                for (int c = 0; c < 4; c++) {
+                    for (int32_t i = 0; i < count; i++)
+                        span[c][i] = mul10(span[c][i], source.planeAlpha);
+                }
+            }
+
+            /* The bottom layer is opaque like G2D_LAYERCMD_OPAQUE */
+            if ((k == 0) && !mHasBackground) {
+                for (int c = 0; c < 3; c++)
+                    memcpy(accum[c] + x0, span[c], count * sizeof(uint16_t));
+                std::fill(accum[3] + x0, accum[3] + x0 + count, 1023);
+                continue;
+            }
+
+            for (int c = 0; c < 4; c++) {
+                uint16_t *d = accum[c] + x0;
+                const uint16_t *s = span[c];
+                const uint16_t *sa = span[3];
+                for (int32_t i = 0; i < count; i++)
+                    d[i] = std::min<uint16_t>(s[i] + mul10(d[i], 1023 - sa[i]), 1023);
+            }
+        }
+
+        if (!ycbcr) {
+            encodeRow(target, y, width, accum);
+            continue;
+        }
+
+        uint16_t *yuv[3];
+        for (int c = 0; c < 3; c++)
+            yuv[c] = scratch.yuv[pair][c].data();
+        rgbToYCbCr(*target.matrix, width, accum, yuv);
+
+        if (!vsub)
+            encodeYCbCrRows(target, y, 1, width, scratch.yuv);
+        else if (pair || (y == y1 - 1))
+            encodeYCbCrRows(target, y - pair, pair + 1, width, scratch.yuv);
+    }
+}
+
+bool AcrylicCompositorSoftware::executeSoftware()
+{
+    ATRACE_CALL();
+
+    auto begin = std::chrono::steady_clock::now();
+
+    if (!validateAllLayers())
+        return false;
+
+    sortLayers();
+
+    AcrylicCanvas &canvas = getCanvas();
+    if (canvas.isOTF() || (layerCount() > getCapabilities().maxLayerCount())) {
+        ALOGE("Unsupported target for the software compositor");
+        return false;
+    }
+
+    mSources.clear();
+    mSources.resize(layerCount());
+    for (unsigned int i = 0; i < layerCount(); i++) {
+        if (!prepareSource(*getLayer(i), mSources[i])) {
+            ALOGE("Failed to configure source layer %u", i);
+            mSources.clear();
+            return false;
+        }
+    }
+
+    AcrylicSoftwareImage target;
+    if (!waitFence(canvas) || !target.map(canvas, true)) {
+        mSources.clear();
+        return false;
+    }
+
+    mHasBackground = hasBackgroundColor();
+    if (mHasBackground) {
+        uint16_t r, g, b, a;
+        getBackgroundColor(&r, &g, &b, &a);
+        mBackground[0] = expand8(r >> 8);
+        mBackground[1] = expand8(g >> 8);
+        mBackground[2] = expand8(b >> 8);
+        mBackground[3] = 1023;
+    }
+
+    for (auto &scratch : mScratch) {
+        for (int c = 0; c < 4; c++) {
+            scratch.span[c].resize(target.width);
+            scratch.accum[0][c].resize(target.width);
+            scratch.accum[1][c].resize(target.width);
+        }
+        for (int c = 0; c < 3; c++) {
+            scratch.yuv[0][c].resize(target.width);
+            scratch.yuv[1][c].resize(target.width);
+        }
+    }
+
+    mTarget = &target;
+    unsigned int bands = (target.height + BAND_ROWS - 1) / BAND_ROWS;
+    mWorkers.run(bands, [this](unsigned int band, unsigned int worker) {
+        compositeBand(band, mScratch[worker]);
+    });
+    mTarget = nullptr;
+    mSources.clear();
+
+    canvas.clearSettingModified();
+    for (unsigned int i = 0; i < layerCount(); i++)
+        getLayer(i)->clearSettingModified();
+
+    mLaptimeUSec = static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count());
+
+    return true;
+}
+
+bool AcrylicCompositorSoftware::execute(int fence[], unsigned int num_fences)
+{
+    if (!executeSoftware()) {
+        // Clearing all acquire fences because their buffers are expired.
+        // The clients should configure everything again to start new execution
+        for (unsigned int i = 0; i < layerCount(); i++)
+            getLayer(i)->setFence(-1);
+        getCanvas().setFence(-1);
+
+        return false;
+    }
+
+    // The images are ready when execute() returns
+    for (unsigned int i = 0; i < num_fences; i++)
+        fence[i] = -1;
+
+    return true;
+}
+
+bool AcrylicCompositorSoftware::execute(int *handle)
+{
+    if (!executeSoftware()) {
+        for (unsigned int i = 0; i < layerCount(); i++)
+            getLayer(i)->setFence(-1);
+        getCanvas().setFence(-1);
+
+        return false;
+    }
+
+    if (handle != NULL)
+        *handle = 1; /* dummy handle */
+
+    return true;
+}
+
+bool AcrylicCompositorSoftware::waitExecution(int __unused handle)
+{
+    return true;
+}
+
+Acrylic *createAcrylicCompositorSoftware(const char *spec)
+{
+    static const char name[] = "software_compositor";
+    size_t len = strlen(name);
+
+    if (strncmp(spec, name, len) != 0)
+        return nullptr;
+
+    unsigned int workers = std::min(std::max(std::thread::hardware_concurrency(), 1u),
+                                    MAX_DEFAULT_WORKERS);
+    if (spec[len] == ':') {
+        char *end;
+        unsigned long count = strtoul(spec + len + 1, &end, 10);
+        if ((*end != '\0') || (count == 0) || (count > MAX_WORKERS)) {
+            ALOGE("Invalid number of workers in '%s'", spec);
+            return nullptr;
+        }
+        workers = static_cast<unsigned int>(count);
+    } else if (spec[len] != '\0') {
+        return nullptr;
+    }
+
+    return new AcrylicCompositorSoftware(__software_hw2d_capability, workers);
+}
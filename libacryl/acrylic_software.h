@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_ACRYLIC_SOFTWARE_H__
+#define __HARDWARE_EXYNOS_ACRYLIC_SOFTWARE_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <hardware/exynos/acryl.h>
+
+#include "acrylic_internal.h"
+
+struct AcrylicSoftwareImage;
+struct AcrylicSoftwareSource;
+struct AcrylicSoftwareScratch;
+
+/*
+ * Threads that run the bands of a frame. The caller of run() is worker 0 and
+ * takes bands as well, so a single worker has no threads at all.
+ */
+class AcrylicSoftwareWorkers {
+public:
+    explicit AcrylicSoftwareWorkers(unsigned int count);
+    ~AcrylicSoftwareWorkers();
+
+    unsigned int count() const { return static_cast<unsigned int>(mThreads.size()) + 1; }
+    /* Calls job(index, worker) for every index below num_jobs and waits for all of them */
+    void run(unsigned int num_jobs, const std::function<void(unsigned int, unsigned int)> &job);
+
+private:
+    void loop(unsigned int worker);
+    void work(unsigned int worker);
+
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mDone;
+    std::vector<std::thread> mThreads;
+    const std::function<void(unsigned int, unsigned int)> *mJob = nullptr;
+    unsigned int mNumJobs = 0;
+    std::atomic<unsigned int> mNextJob{0};
+    unsigned int mBusy = 0;
+    uint64_t mGeneration = 0;
+    bool mExit = false;
+};
+
+/*
+ * AcrylicCompositorSoftware - reference compositor on the CPU
+ *
+ * It takes the same layers as AcrylicCompositorG2D and composites them the
+ * same way: the blending modes and the plane alpha, scaling, flip and
+ * rotation, solid color layers, the background color and the RGB and YCbCr
+ * formats up to 10 bits in acrylic_formats.cpp. All arithmetic is in 10-bit
+ * integers, so the result does not depend on the number of workers.
+ * The target is split into bands of rows that the workers composite
+ * independently, decoding only the source pixels the band needs.
+ *
+ * Execution is synchronous: the acquire fences are waited for and all release
+ * fences are -1. Protected and compressed buffers are not supported.
+ */
+class AcrylicCompositorSoftware: public Acrylic {
+public:
+    AcrylicCompositorSoftware(const HW2DCapability &capability, unsigned int num_workers);
+    virtual ~AcrylicCompositorSoftware();
+    virtual bool execute(int fence[], unsigned int num_fences);
+    virtual bool execute(int *handle = NULL);
+    virtual bool waitExecution(int handle);
+    virtual unsigned int getLaptimeUSec() { return mLaptimeUSec; }
+private:
+    bool executeSoftware();
+    bool prepareSource(AcrylicLayer &layer, AcrylicSoftwareSource &source);
+    void compositeBand(unsigned int band, AcrylicSoftwareScratch &scratch);
+
+    AcrylicSoftwareWorkers mWorkers;
+    std::vector<AcrylicSoftwareScratch> mScratch;
+    std::vector<AcrylicSoftwareSource> mSources;
+    AcrylicSoftwareImage *mTarget = nullptr;
+    uint16_t mBackground[4];
+    bool mHasBackground = false;
+    unsigned int mLaptimeUSec = 0;
+};
+
+/*
+ * Returns a new AcrylicCompositorSoftware if spec is "software_compositor",
+ * optionally followed by ":<workers>", or nullptr otherwise.
+ */
+Acrylic *createAcrylicCompositorSoftware(const char *spec);
+
+#endif /* __HARDWARE_EXYNOS_ACRYLIC_SOFTWARE_H__ */
@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <exynos_format.h>
+#include <hardware/exynos/acryl.h>
+#include <hardware/hwcomposer2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kWidth = 1080;
+constexpr int32_t kHeight = 2400;
+
+struct Format {
+    const char* name;
+    uint32_t fmt;
+    int dataspace;
+    // bytes per pixel of each buffer, in 1/4 bytes
+    std::vector<int> quarterBytes;
+};
+
+const std::vector<Format>& formats() {
+    static const std::vector<Format> sFormats = {
+            {"RGBA_8888", HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB, {16}},
+            {"RGB_565", HAL_PIXEL_FORMAT_RGB_565, HAL_DATASPACE_SRGB, {8}},
+            {"RGBA_1010102", HAL_PIXEL_FORMAT_RGBA_1010102, HAL_DATASPACE_SRGB, {16}},
+            {"YUYV", HAL_PIXEL_FORMAT_YCbCr_422_I, HAL_DATASPACE_BT709, {8}},
+            {"NV21", HAL_PIXEL_FORMAT_YCrCb_420_SP, HAL_DATASPACE_BT709, {6}},
+            {"NV12_M", HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M, HAL_DATASPACE_BT709, {4, 2}},
+            {"P010", HAL_PIXEL_FORMAT_YCBCR_P010, HAL_DATASPACE_BT709, {12}},
+            {"I420", HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P, HAL_DATASPACE_BT709, {6}},
+    };
+    return sFormats;
+}
+
+struct Image {
+    Image(const Format& format, int32_t width, int32_t height, uint32_t seed) {
+        for (int quarter : format.quarterBytes) {
+            buffers.emplace_back(static_cast<size_t>(width) * height * quarter / 4);
+            // Random content so that nothing short-circuits on flat colors
+            for (auto& byte : buffers.back()) {
+                seed = seed * 1103515245 + 12345;
+                byte = static_cast<uint8_t>(seed >> 16);
+            }
+        }
+    }
+
+    void* addr[MAX_HW2D_PLANES] = {};
+    size_t len[MAX_HW2D_PLANES] = {};
+    std::vector<std::vector<uint8_t>> buffers;
+
+    int bind() {
+        for (size_t i = 0; i < buffers.size(); i++) {
+            addr[i] = buffers[i].data();
+            len[i] = buffers[i].size();
+        }
+        return static_cast<int>(buffers.size());
+    }
+};
+
+struct LayerDesc {
+    const Format* format;
+    int32_t width;
+    int32_t height;
+    hwc_rect_t window;
+    uint32_t transform = 0;
+    uint32_t blend = HWC2_BLEND_MODE_PREMULTIPLIED;
+    uint8_t planeAlpha = 255;
+    // ARGB of a solid color layer instead of an image if not zero
+    uint32_t solidColor = 0;
+};
+
+/* A compositor with its layers and buffers set up for one scene */
+class Scene {
+public:
+    Scene(const std::vector<LayerDesc>& descs, unsigned int workers, const Format& target)
+          : mTarget(target, kWidth, kHeight, 0) {
+        std::string spec = "software_compositor:" + std::to_string(workers);
+        mAcrylic.reset(AcrylicFactory::createAcrylic(spec.c_str()));
+        if (!mAcrylic) return;
+
+        mAcrylic->setCanvasDimension(kWidth, kHeight);
+        mAcrylic->setCanvasImageType(target.fmt, target.dataspace);
+        int count = mTarget.bind();
+        mAcrylic->setCanvasBuffer(mTarget.addr, mTarget.len, count);
+
+        int z = 0;
+        for (const auto& desc : descs) {
+            std::unique_ptr<AcrylicLayer> layer(mAcrylic->createLayer());
+            hwc_rect_t crop = {0, 0, desc.width, desc.height};
+            hwc_rect_t window = desc.window;
+            layer->setImageDimension(desc.width, desc.height);
+            layer->setImageType(desc.format->fmt, desc.format->dataspace);
+            if (desc.solidColor) {
+                uint32_t c = desc.solidColor;
+                layer->setImageBuffer(c >> 24, (c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF);
+            } else {
+                mImages.push_back(
+                        std::make_unique<Image>(*desc.format, desc.width, desc.height, z + 1));
+                count = mImages.back()->bind();
+                layer->setImageBuffer(mImages.back()->addr, mImages.back()->len, count);
+            }
+            layer->setCompositArea(crop, window, desc.transform);
+            layer->setCompositMode(desc.blend, desc.planeAlpha, z++);
+            mLayers.push_back(std::move(layer));
+        }
+    }
+
+    bool ok() const { return mAcrylic != nullptr; }
+
+    bool run() {
+        int fences[AcrylicCompositorMaxFences];
+        return mAcrylic->execute(fences, mLayers.size() + 1);
+    }
+
+    unsigned int laptime() { return mAcrylic->getLaptimeUSec(); }
+    const std::vector<uint8_t>& output() const { return mTarget.buffers[0]; }
+
+private:
+    static constexpr unsigned int AcrylicCompositorMaxFences = 17;
+
+    Image mTarget;
+    std::unique_ptr<Acrylic> mAcrylic;
+    std::vector<std::unique_ptr<Image>> mImages;
+    // Destroyed before the compositor that created them
+    std::vector<std::unique_ptr<AcrylicLayer>> mLayers;
+};
+
+const Format& rgba() {
+    return formats()[0];
+}
+
+hwc_rect_t fullScreen() {
+    return {0, 0, kWidth, kHeight};
+}
+
+void setCounters(benchmark::State& state, Scene& scene, int64_t layerPixels) {
+    state.SetItemsProcessed(state.iterations() * kWidth * kHeight);
+    state.counters["layer_mpix_per_s"] =
+            benchmark::Counter(state.iterations() * layerPixels / 1e6, benchmark::Counter::kIsRate);
+    state.counters["laptime_us"] = scene.laptime();
+}
+
+// Full screen RGBA layers: the UI stack of a typical client composition
+void BM_Layers(benchmark::State& state) {
+    std::vector<LayerDesc> descs(state.range(0),
+                                 {&rgba(), kWidth, kHeight, fullScreen(),
+                                  0, HWC2_BLEND_MODE_PREMULTIPLIED, 255});
+    Scene scene(descs, state.range(1), rgba());
+    if (!scene.ok()) {
+        state.SkipWithError("no software compositor");
+        return;
+    }
+    for (auto _ : state) {
+        if (!scene.run()) state.SkipWithError("execute failed");
+    }
+    setCounters(state, scene, state.range(0) * kWidth * kHeight);
+}
+
+// One full screen layer of each format
+void BM_Formats(benchmark::State& state) {
+    const Format& format = formats()[state.range(0)];
+    Scene scene({{&format, kWidth, kHeight, fullScreen()}}, state.range(1), rgba());
+    if (!scene.ok()) {
+        state.SkipWithError("no software compositor");
+        return;
+    }
+    for (auto _ : state) {
+        if (!scene.run()) state.SkipWithError("execute failed");
+    }
+    state.SetLabel(format.name);
+    setCounters(state, scene, kWidth * kHeight);
+}
+
+// One full screen RGBA layer written to each format
+void BM_TargetFormats(benchmark::State& state) {
+    const Format& format = formats()[state.range(0)];
+    Scene scene({{&rgba(), kWidth, kHeight, fullScreen()}}, state.range(1), format);
+    if (!scene.ok()) {
+        state.SkipWithError("no software compositor");
+        return;
+    }
+    for (auto _ : state) {
+        if (!scene.run()) state.SkipWithError("execute failed");
+    }
+    state.SetLabel(format.name);
+    setCounters(state, scene, kWidth * kHeight);
+}
+
+// 1080p video rotated to the portrait screen under a translucent UI layer
+void BM_RotatedVideo(benchmark::State& state) {
+    const Format& nv21 = formats()[4];
+    int32_t videoHeight = kWidth * 1920 / 1080;
+    int32_t top = (kHeight - videoHeight) / 2;
+    Scene scene({{&nv21, 1920, 1080, {0, top, kWidth, top + videoHeight}, HAL_TRANSFORM_ROT_90,
+                  HWC2_BLEND_MODE_NONE},
+                 {&rgba(), kWidth, kHeight, fullScreen(), 0, HWC2_BLEND_MODE_PREMULTIPLIED, 192}},
+                state.range(0), rgba());
+    if (!scene.ok()) {
+        state.SkipWithError("no software compositor");
+        return;
+    }
+    for (auto _ : state) {
+        if (!scene.run()) state.SkipWithError("execute failed");
+    }
+    setCounters(state, scene, 1920 * 1080 + kWidth * kHeight);
+}
+
+// Half resolution layer scaled up to the screen
+void BM_Upscale(benchmark::State& state) {
+    Scene scene({{&rgba(), kWidth / 2, kHeight / 2, fullScreen()}}, state.range(0), rgba());
+    if (!scene.ok()) {
+        state.SkipWithError("no software compositor");
+        return;
+    }
+    for (auto _ : state) {
+        if (!scene.run()) state.SkipWithError("execute failed");
+    }
+    setCounters(state, scene, kWidth * kHeight);
+}
+
+void applyLayers(benchmark::internal::Benchmark* b) {
+    for (int workers : {1, 4}) {
+        for (int layers : {1, 2, 4, 8}) b->Args({layers, workers});
+    }
+}
+
+void applyFormats(benchmark::internal::Benchmark* b) {
+    for (int workers : {1, 4}) {
+        for (size_t i = 0; i < formats().size(); i++) b->Args({static_cast<int>(i), workers});
+    }
+}
+
+BENCHMARK(BM_Layers)->Apply(applyLayers)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_Formats)->Apply(applyFormats)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_TargetFormats)->Apply(applyFormats)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_RotatedVideo)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_Upscale)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/*
+ * The output must not depend on how the bands are shared out, and a known
+ * blend must give the expected pixel.
+ */
+bool verify() {
+    std::vector<LayerDesc> descs = {
+            {&formats()[5], 1920, 1080, {0, 300, kWidth, 1900}, HAL_TRANSFORM_ROT_270,
+             HWC2_BLEND_MODE_NONE},
+            {&formats()[2], 540, 1200, {100, 100, 900, 2300}, HAL_TRANSFORM_FLIP_H,
+             HWC2_BLEND_MODE_COVERAGE, 200},
+            {&rgba(), kWidth, kHeight, fullScreen(), 0, HWC2_BLEND_MODE_PREMULTIPLIED, 128},
+    };
+    Scene single(descs, 1, rgba());
+    Scene parallel(descs, 7, rgba());
+    if (!single.ok() || !parallel.ok() || !single.run() || !parallel.run()) {
+        fprintf(stderr, "failed to composite\n");
+        return false;
+    }
+    if (single.output() != parallel.output()) {
+        fprintf(stderr, "output depends on the number of workers\n");
+        return false;
+    }
+
+    // Premultiplied half transparent grey over opaque white at half plane alpha
+    Scene blend({{&rgba(), kWidth, kHeight, fullScreen(), 0, HWC2_BLEND_MODE_NONE, 128, 0xFFFFFFFF},
+                 {&rgba(), kWidth, kHeight, fullScreen(), 0, HWC2_BLEND_MODE_PREMULTIPLIED, 255,
+                  0x80404040}},
+                2, rgba());
+    if (!blend.ok() || !blend.run()) return false;
+    // 64 + 128 * (1 - 128 / 255) and the bottom layer is opaque
+    const uint8_t expected[4] = {128, 128, 128, 255};
+    const uint8_t* pixel = &blend.output()[(kHeight / 2 * kWidth + kWidth / 2) * 4];
+    if (memcmp(pixel, expected, sizeof(expected)) != 0) {
+        fprintf(stderr, "blended to %u,%u,%u,%u\n", pixel[0], pixel[1], pixel[2], pixel[3]);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (!verify()) return 1;
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
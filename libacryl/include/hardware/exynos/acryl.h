@@ -937,6 +937,7 @@ private:
 };
 
 class AcrylicPerformanceRequest;
+struct AcrylicPerformanceStats;
 
 /*
  * DEPRECATED:
@@ -1177,6 +1178,12 @@ public:
      * as required. They should be defined in acrylic_soc.h.
      */
     virtual bool requestPerformanceQoS(AcrylicPerformanceRequest *request);
+    /*
+     * Obtain the statistics of the tasks executed by this object against the
+     * performance QoS requested by requestPerformanceQoS(). Returns false if
+     * the implementation does not measure its tasks.
+     */
+    virtual bool getPerformanceStats(AcrylicPerformanceStats *stats);
     /*
      * Called when an AcrylicLayer is being destroyed
      */
@@ -1312,4 +1319,28 @@ private:
     AcrylicPerformanceRequestFrame *mFrames;
 };
 
+/*
+ * The times are sums over all tasks, in micro seconds. The error of a task is
+ * its completion time from the submission minus the deadline of the request.
+ * The bandwidths are the sums of the read and the write bandwidth of all
+ * frames in KB/s: the one from the layer geometry and the one requested after
+ * the correction learned from the past tasks of the same scene.
+ */
+struct AcrylicPerformanceStats {
+    uint64_t        mTaskCount;
+    uint64_t        mLateTaskCount;
+    uint64_t        mQueueTimeUSec;
+    uint64_t        mExecTimeUSec;
+    int64_t         mErrorUSec;
+    uint64_t        mAbsErrorUSec;
+    uint32_t        mMaxLateUSec;
+    uint32_t        mDeadlineUSec;
+    uint32_t        mCorrection;        /* Q10, 1024 is no correction */
+    uint32_t        mModelBandwidth;
+    uint32_t        mRequestedBandwidth;
+    uint32_t        mSceneCount;
+    uint64_t        mRequestCount;
+    uint64_t        mAdjustCount;
+};
+
 #endif /*__HARDWARE_EXYNOS_ACRYLIC_H__*/
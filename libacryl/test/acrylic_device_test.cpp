@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "acrylic_device.h"
+
+namespace {
+
+constexpr int kSubmit = 1;
+
+// What the mock driver returns for a job: the release fence
+struct MockTask {
+    int fence = -1;
+};
+
+/*
+ * A device whose jobs complete when the test says so. The release fence of
+ * a job is the read end of a pipe that becomes readable on completion.
+ */
+class MockDevice : public AcrylicRedundantDevice {
+public:
+    MockDevice() : AcrylicRedundantDevice("/dev/null") {}
+    ~MockDevice() {
+        for (auto &[fence, signal] : mSignals) {
+            close(fence);
+            close(signal);
+        }
+    }
+
+    void failNext() { mFailNext = true; }
+
+    // Submits a job and retires it on its release fence
+    int submit(uint32_t cost, int priority = -1) {
+        MockTask task;
+        int job, context;
+        if (ioctl_dispatch(kSubmit, &task, cost, priority, &job, &context) < 0) return -1;
+        retire(job, task.fence);
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFences.push_back(task.fence);
+        return context;
+    }
+
+    // Completes the n-th job submitted
+    void complete(size_t n) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ASSERT_LT(n, mFences.size());
+        char c = 0;
+        ASSERT_EQ(1, write(mSignals[mFences[n]], &c, 1));
+    }
+
+    ContextStats stats(int context) {
+        ContextStats s;
+        EXPECT_TRUE(getContextStats(context, s));
+        return s;
+    }
+
+protected:
+    int ioctl_fd(int, int cmd, void *arg) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mFailNext) {
+            mFailNext = false;
+            return -1;
+        }
+        if (cmd != kSubmit) return 0;
+        int fds[2];
+        if (pipe(fds) < 0) return -1;
+        mSignals[fds[0]] = fds[1];
+        static_cast<MockTask *>(arg)->fence = fds[0];
+        return 0;
+    }
+
+private:
+    std::mutex mMutex;
+    bool mFailNext = false;
+    std::map<int, int> mSignals;
+    std::vector<int> mFences;
+};
+
+TEST(AcrylicRedundantDeviceTest, SpreadsJobsOverIdleContexts) {
+    MockDevice dev;
+    int first = dev.submit(100);
+    int second = dev.submit(10);
+    int third = dev.submit(10);
+
+    EXPECT_NE(first, second);
+    EXPECT_NE(first, third);
+    EXPECT_NE(second, third);
+    for (int i = 0; i < MAX_DEVICE_FD; i++) EXPECT_EQ(0u, dev.stats(i).queuedJobs);
+}
+
+TEST(AcrylicRedundantDeviceTest, AvoidsContextWithLongJob) {
+    MockDevice dev;
+    int longContext = dev.submit(1000);
+    dev.submit(10);
+    dev.submit(10);
+
+    // The short jobs queue behind the short jobs rather than the long one
+    for (int i = 0; i < 4; i++) EXPECT_NE(longContext, dev.submit(10));
+    EXPECT_EQ(1u, dev.stats(longContext).inFlight);
+    EXPECT_EQ(1000u, dev.stats(longContext).pendingCost);
+}
+
+TEST(AcrylicRedundantDeviceTest, CompletedJobFreesContext) {
+    MockDevice dev;
+    int longContext = dev.submit(1000);
+    dev.submit(10);
+    dev.submit(10);
+
+    dev.complete(0);
+    EXPECT_EQ(0u, dev.stats(longContext).inFlight);
+    EXPECT_EQ(longContext, dev.submit(10));
+}
+
+TEST(AcrylicRedundantDeviceTest, RetireWithoutFenceCompletesNow) {
+    MockDevice dev;
+    MockTask task;
+    int job, context;
+
+    ASSERT_EQ(0, dev.ioctl_dispatch(kSubmit, &task, 50, -1, &job, &context));
+    EXPECT_EQ(1u, dev.stats(context).inFlight);
+    dev.retire(job);
+    EXPECT_EQ(0u, dev.stats(context).inFlight);
+    EXPECT_EQ(0u, dev.stats(context).pendingCost);
+    EXPECT_EQ(1u, dev.stats(context).jobs);
+    close(task.fence);
+}
+
+TEST(AcrylicRedundantDeviceTest, PriorityReservesContext) {
+    MockDevice dev;
+    dev.setContextPriority(2, 10);
+
+    // High priority jobs stay on their context even when it is the busiest
+    for (int i = 0; i < 3; i++) EXPECT_EQ(2, dev.submit(100, 10));
+    // Other jobs never take the reserved context
+    for (int i = 0; i < 6; i++) EXPECT_NE(2, dev.submit(1));
+    EXPECT_EQ(3u, dev.stats(2).jobs);
+    EXPECT_EQ(2u, dev.stats(2).queuedJobs);
+}
+
+TEST(AcrylicRedundantDeviceTest, UnknownPriorityUsesAllContexts) {
+    MockDevice dev;
+    dev.setContextPriority(0, 5);
+
+    std::vector<int> used(MAX_DEVICE_FD);
+    for (int i = 0; i < MAX_DEVICE_FD; i++) used[dev.submit(10, 7)]++;
+    for (int i = 0; i < MAX_DEVICE_FD; i++) EXPECT_EQ(1, used[i]);
+}
+
+TEST(AcrylicRedundantDeviceTest, FailedJobIsNotAccounted) {
+    MockDevice dev;
+    dev.failNext();
+    EXPECT_EQ(-1, dev.submit(100));
+
+    for (int i = 0; i < MAX_DEVICE_FD; i++) {
+        auto stats = dev.stats(i);
+        EXPECT_EQ(0u, stats.inFlight);
+        EXPECT_EQ(0u, stats.pendingCost);
+        EXPECT_EQ(0u, stats.jobs);
+    }
+}
+
+TEST(AcrylicRedundantDeviceTest, CountsBusyTime) {
+    MockDevice dev;
+    int context = dev.submit(10);
+    usleep(2000);
+    EXPECT_GE(dev.stats(context).busyNs, 2000000u);
+
+    dev.complete(0);
+    uint64_t busy = dev.stats(context).busyNs;
+    usleep(2000);
+    EXPECT_EQ(busy, dev.stats(context).busyNs);
+}
+
+TEST(AcrylicRedundantDeviceTest, ParallelDispatchStaysBalanced) {
+    MockDevice dev;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&dev] {
+            for (int i = 0; i < 30; i++) dev.submit(10);
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    for (int i = 0; i < MAX_DEVICE_FD; i++) {
+        EXPECT_EQ(40u, dev.stats(i).inFlight);
+        EXPECT_EQ(400u, dev.stats(i).pendingCost);
+    }
+}
+
+TEST(AcrylicRedundantDeviceTest, SharedPerNode) {
+    auto first = AcrylicRedundantDevice::getShared("/dev/null");
+    EXPECT_EQ(first, AcrylicRedundantDevice::getShared("/dev/null"));
+    EXPECT_NE(first, AcrylicRedundantDevice::getShared("/dev/zero"));
+
+    // The contexts are closed with the last client
+    std::weak_ptr<AcrylicRedundantDevice> weak = first;
+    first.reset();
+    EXPECT_TRUE(weak.expired());
+    EXPECT_NE(nullptr, AcrylicRedundantDevice::getShared("/dev/null"));
+}
+
+} // namespace
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <exynos_format.h>
+#include <gtest/gtest.h>
+#include <hardware/hwcomposer2.h>
+#include <system/graphics.h>
+
+#include <memory>
+#include <vector>
+
+#include "acrylic_software.h"
+
+namespace {
+
+/* A buffer of each plane, in user memory */
+struct Image {
+    explicit Image(std::vector<std::vector<uint8_t>> planes) : buffers(std::move(planes)) {}
+
+    int bind() {
+        for (size_t i = 0; i < buffers.size(); i++) {
+            addr[i] = buffers[i].data();
+            len[i] = buffers[i].size();
+        }
+        return static_cast<int>(buffers.size());
+    }
+
+    void *addr[MAX_HW2D_PLANES] = {};
+    size_t len[MAX_HW2D_PLANES] = {};
+    std::vector<std::vector<uint8_t>> buffers;
+};
+
+/*
+ * Composites small images on one worker, so that every target pixel is known.
+ * The layers are stacked in the order they are added.
+ */
+class AcrylicSoftwareTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mAcrylic.reset(createAcrylicCompositorSoftware("software_compositor:1"));
+        ASSERT_NE(nullptr, mAcrylic);
+    }
+
+    void TearDown() override {
+        mLayers.clear();
+        mAcrylic.reset();
+    }
+
+    void setTarget(int32_t width, int32_t height, uint32_t fmt, int dataspace,
+                   std::vector<size_t> sizes) {
+        std::vector<std::vector<uint8_t>> planes;
+        for (size_t size : sizes) planes.emplace_back(size, 0xA5);
+        mTarget = std::make_unique<Image>(std::move(planes));
+        int count = mTarget->bind();
+        ASSERT_TRUE(mAcrylic->setCanvasDimension(width, height));
+        ASSERT_TRUE(mAcrylic->setCanvasImageType(fmt, dataspace));
+        ASSERT_TRUE(mAcrylic->setCanvasBuffer(mTarget->addr, mTarget->len, count));
+    }
+
+    void setRGBATarget(int32_t width, int32_t height) {
+        setTarget(width, height, HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB,
+                  {static_cast<size_t>(width) * height * 4});
+    }
+
+    AcrylicLayer *addLayer(int32_t width, int32_t height, uint32_t fmt, int dataspace,
+                           std::vector<std::vector<uint8_t>> planes, hwc_rect_t window,
+                           uint32_t blend, uint8_t planeAlpha = 255, uint32_t transform = 0,
+                           uint32_t attr = 0) {
+        std::unique_ptr<AcrylicLayer> layer(mAcrylic->createLayer());
+        EXPECT_NE(nullptr, layer);
+        if (!layer) return nullptr;
+        hwc_rect_t crop = {0, 0, width, height};
+        mImages.push_back(std::make_unique<Image>(std::move(planes)));
+        int count = mImages.back()->bind();
+        EXPECT_TRUE(layer->setImageDimension(width, height));
+        EXPECT_TRUE(layer->setImageType(fmt, dataspace));
+        EXPECT_TRUE(layer->setImageBuffer(mImages.back()->addr, mImages.back()->len, count));
+        EXPECT_TRUE(layer->setCompositArea(crop, window, transform, attr));
+        EXPECT_TRUE(layer->setCompositMode(blend, planeAlpha, mLayers.size()));
+        mLayers.push_back(std::move(layer));
+        return mLayers.back().get();
+    }
+
+    AcrylicLayer *addColorLayer(uint32_t argb, hwc_rect_t window, uint32_t blend,
+                                uint8_t planeAlpha = 255) {
+        std::unique_ptr<AcrylicLayer> layer(mAcrylic->createLayer());
+        EXPECT_NE(nullptr, layer);
+        if (!layer) return nullptr;
+        hwc_rect_t crop = {0, 0, window.right - window.left, window.bottom - window.top};
+        EXPECT_TRUE(layer->setImageDimension(crop.right, crop.bottom));
+        EXPECT_TRUE(layer->setImageType(HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB));
+        EXPECT_TRUE(layer->setImageBuffer(argb >> 24, (argb >> 16) & 0xFF, (argb >> 8) & 0xFF,
+                                          argb & 0xFF));
+        EXPECT_TRUE(layer->setCompositArea(crop, window));
+        EXPECT_TRUE(layer->setCompositMode(blend, planeAlpha, mLayers.size()));
+        mLayers.push_back(std::move(layer));
+        return mLayers.back().get();
+    }
+
+    bool run() {
+        int fences[17];
+        return mAcrylic->execute(fences, mLayers.size() + 1);
+    }
+
+    const std::vector<uint8_t> &target(size_t plane = 0) const { return mTarget->buffers[plane]; }
+
+    std::vector<uint8_t> pixel(int32_t width, int32_t x, int32_t y) const {
+        auto begin = target().begin() + (y * width + x) * 4;
+        return std::vector<uint8_t>(begin, begin + 4);
+    }
+
+    std::unique_ptr<Acrylic> mAcrylic;
+    std::unique_ptr<Image> mTarget;
+    std::vector<std::unique_ptr<Image>> mImages;
+    // Destroyed before the compositor that created them
+    std::vector<std::unique_ptr<AcrylicLayer>> mLayers;
+};
+
+using Pixel = std::vector<uint8_t>;
+
+TEST_F(AcrylicSoftwareTest, CopiesOpaqueImage) {
+    setRGBATarget(2, 1);
+    // The alpha of the bottom layer is ignored without blending
+    addLayer(2, 1, HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB,
+             {{10, 20, 30, 0, 200, 150, 100, 128}}, {0, 0, 2, 1}, HWC2_BLEND_MODE_NONE);
+    ASSERT_TRUE(run());
+    EXPECT_EQ(Pixel({10, 20, 30, 255}), pixel(2, 0, 0));
+    EXPECT_EQ(Pixel({200, 150, 100, 255}), pixel(2, 1, 0));
+}
+
+TEST_F(AcrylicSoftwareTest, BlendsPremultiplied) {
+    setRGBATarget(2, 1);
+    addColorLayer(0xFFFFFFFF, {0, 0, 2, 1}, HWC2_BLEND_MODE_NONE, 128);
+    addColorLayer(0x80404040, {0, 0, 2, 1}, HWC2_BLEND_MODE_PREMULTIPLIED);
+    ASSERT_TRUE(run());
+    // 64 + 128 * (1 - 128 / 255) over the bottom layer at half plane alpha
+    EXPECT_EQ(Pixel({128, 128, 128, 255}), pixel(2, 0, 0));
+    EXPECT_EQ(Pixel({128, 128, 128, 255}), pixel(2, 1, 0));
+}
+
+TEST_F(AcrylicSoftwareTest, BlendsCoverage) {
+    setRGBATarget(2, 1);
+    addColorLayer(0xFF000000, {0, 0, 2, 1}, HWC2_BLEND_MODE_NONE);
+    // Red at half alpha and opaque green in the second pixel
+    addLayer(2, 1, HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB,
+             {{255, 0, 0, 128, 0, 255, 0, 255}}, {0, 0, 2, 1}, HWC2_BLEND_MODE_COVERAGE);
+    ASSERT_TRUE(run());
+    EXPECT_EQ(Pixel({128, 0, 0, 255}), pixel(2, 0, 0));
+    EXPECT_EQ(Pixel({0, 255, 0, 255}), pixel(2, 1, 0));
+}
+
+TEST_F(AcrylicSoftwareTest, FillsBackgroundOutsideLayers) {
+    setRGBATarget(3, 1);
+    mAcrylic->setDefaultColor(0, 0, 0xFFFF, 0xFFFF);
+    addColorLayer(0xFFFF0000, {1, 0, 2, 1}, HWC2_BLEND_MODE_NONE);
+    ASSERT_TRUE(run());
+    EXPECT_EQ(Pixel({0, 0, 255, 255}), pixel(3, 0, 0));
+    EXPECT_EQ(Pixel({255, 0, 0, 255}), pixel(3, 1, 0));
+    EXPECT_EQ(Pixel({0, 0, 255, 255}), pixel(3, 2, 0));
+}
+
+TEST_F(AcrylicSoftwareTest, ScalesBilinear) {
+    setRGBATarget(4, 1);
+    addLayer(2, 1, HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB,
+             {{0, 0, 0, 255, 255, 255, 255, 255}}, {0, 0, 4, 1}, HWC2_BLEND_MODE_NONE);
+    ASSERT_TRUE(run());
+    // The target pixel centers are at 1/4 and 3/4 between the source pixel centers
+    EXPECT_EQ(Pixel({0, 0, 0, 255}), pixel(4, 0, 0));
+    EXPECT_EQ(Pixel({64, 64, 64, 255}), pixel(4, 1, 0));
+    EXPECT_EQ(Pixel({191, 191, 191, 255}), pixel(4, 2, 0));
+    EXPECT_EQ(Pixel({255, 255, 255, 255}), pixel(4, 3, 0));
+}
+
+TEST_F(AcrylicSoftwareTest, ScalesNearestWithoutResampling) {
+    setRGBATarget(4, 1);
+    addLayer(2, 1, HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB,
+             {{0, 0, 0, 255, 255, 255, 255, 255}}, {0, 0, 4, 1}, HWC2_BLEND_MODE_NONE, 255, 0,
+             AcrylicLayer::ATTR_NORESAMPLING);
+    ASSERT_TRUE(run());
+    EXPECT_EQ(Pixel({0, 0, 0, 255}), pixel(4, 0, 0));
+    EXPECT_EQ(Pixel({0, 0, 0, 255}), pixel(4, 1, 0));
+    EXPECT_EQ(Pixel({255, 255, 255, 255}), pixel(4, 2, 0));
+    EXPECT_EQ(Pixel({255, 255, 255, 255}), pixel(4, 3, 0));
+}
+
+TEST_F(AcrylicSoftwareTest, ScalesDownByAveraging) {
+    setRGBATarget(2, 1);
+    addLayer(4, 1, HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB,
+             {{0, 0, 0, 255, 100, 100, 100, 255, 200, 200, 200, 255, 250, 250, 250, 255}},
+             {0, 0, 2, 1}, HWC2_BLEND_MODE_NONE);
+    ASSERT_TRUE(run());
+    EXPECT_EQ(Pixel({50, 50, 50, 255}), pixel(2, 0, 0));
+    EXPECT_EQ(Pixel({225, 225, 225, 255}), pixel(2, 1, 0));
+}
+
+TEST_F(AcrylicSoftwareTest, RotatesClockwise) {
+    setRGBATarget(1, 2);
+    addLayer(2, 1, HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB,
+             {{255, 0, 0, 255, 0, 0, 255, 255}}, {0, 0, 1, 2}, HWC2_BLEND_MODE_NONE, 255,
+             HAL_TRANSFORM_ROT_90);
+    ASSERT_TRUE(run());
+    // The left pixel goes to the top
+    EXPECT_EQ(Pixel({255, 0, 0, 255}), pixel(1, 0, 0));
+    EXPECT_EQ(Pixel({0, 0, 255, 255}), pixel(1, 0, 1));
+}
+
+TEST_F(AcrylicSoftwareTest, FlipsHorizontally) {
+    setRGBATarget(2, 1);
+    addLayer(2, 1, HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB,
+             {{255, 0, 0, 255, 0, 0, 255, 255}}, {0, 0, 2, 1}, HWC2_BLEND_MODE_NONE, 255,
+             HAL_TRANSFORM_FLIP_H);
+    ASSERT_TRUE(run());
+    EXPECT_EQ(Pixel({0, 0, 255, 255}), pixel(2, 0, 0));
+    EXPECT_EQ(Pixel({255, 0, 0, 255}), pixel(2, 1, 0));
+}
+
+TEST_F(AcrylicSoftwareTest, ConvertsNV12ToRGB) {
+    setRGBATarget(2, 2);
+    // Limited range BT.709: white in the top row, black in the bottom row
+    addLayer(2, 2, HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M, HAL_DATASPACE_BT709,
+             {{235, 235, 16, 16}, {128, 128}}, {0, 0, 2, 2}, HWC2_BLEND_MODE_NONE);
+    ASSERT_TRUE(run());
+    EXPECT_EQ(Pixel({255, 255, 255, 255}), pixel(2, 1, 0));
+    EXPECT_EQ(Pixel({0, 0, 0, 255}), pixel(2, 0, 1));
+}
+
+TEST_F(AcrylicSoftwareTest, ConvertsRGBToNV12) {
+    setTarget(2, 2, HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M, HAL_DATASPACE_BT709, {4, 2});
+    addColorLayer(0xFFFF0000, {0, 0, 2, 2}, HWC2_BLEND_MODE_NONE);
+    ASSERT_TRUE(run());
+    // Red in limited range BT.709
+    EXPECT_EQ(std::vector<uint8_t>({63, 63, 63, 63}), target(0));
+    EXPECT_EQ(std::vector<uint8_t>({102, 240}), target(1));
+}
+
+TEST_F(AcrylicSoftwareTest, ConvertsRGBToRGB565) {
+    setTarget(2, 1, HAL_PIXEL_FORMAT_RGB_565, HAL_DATASPACE_SRGB, {4});
+    addLayer(2, 1, HAL_PIXEL_FORMAT_RGBA_8888, HAL_DATASPACE_SRGB,
+             {{255, 0, 0, 255, 0, 255, 255, 255}}, {0, 0, 2, 1}, HWC2_BLEND_MODE_NONE);
+    ASSERT_TRUE(run());
+    // 0xF800 and 0x07FF in little endian
+    EXPECT_EQ(std::vector<uint8_t>({0x00, 0xF8, 0xFF, 0x07}), target());
+}
+
+} // namespace
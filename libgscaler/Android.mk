@@ -16,7 +16,7 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_PRELINK_MODULE := false
-LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libexynosscaler libexynosutils
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libexynosscaler libexynosutils libexynosv4l2
 LOCAL_HEADER_LIBRARIES := libcutils_headers libsystem_headers libhardware_headers google_hal_headers
 
 LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/include
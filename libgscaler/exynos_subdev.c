@@ -43,9 +43,9 @@
 #include <utils/Log.h>
 #include <string.h>
 
-#include "libgscaler_media.h"
+#include <exynos_v4l2_devcache.h>
 
-#define SUBDEV_MAX 191
+#include "libgscaler_media.h"
 
 static int __subdev_open(const char *filename, int oflag, va_list ap)
 {
@@ -74,128 +74,25 @@ int exynos_subdev_open(const char *filename, int oflag, ...)
 
 int exynos_subdev_get_node_num(const char *devname, int __UNUSED__ oflag, ...)
 {
-    bool found = false;
-    int ret = -1;
-    struct stat s;
-    FILE *stream_fd;
-    char filename[64], name[64];
-    int i = 0;
-
-    do {
-        if (i > (SUBDEV_MAX - 128))
-            break;
-
-        /* video device node */
-        snprintf(filename, sizeof(filename), "/dev/v4l-subdev%d", i);
-
-        /* if the node is video device */
-        if ((lstat(filename, &s) == 0) && S_ISCHR(s.st_mode) &&
-                ((int)((unsigned short)(s.st_rdev) >> 8) == 81)) {
-            ALOGD("try node: %s", filename);
-            /* open sysfs entry */
-            snprintf(filename, sizeof(filename), "/sys/class/video4linux/v4l-subdev%d/name", i);
-            if (S_ISLNK(s.st_mode)) {
-                ALOGE("symbolic link detected");
-                return -1;
-            }
-            stream_fd = fopen(filename, "r");
-            if (stream_fd == NULL) {
-                ALOGE("failed to open sysfs entry for subdev");
-                continue;   /* try next */
-            }
-
-            /* read sysfs entry for device name */
-	    char *p = fgets(name, sizeof(name), stream_fd);
-            fclose(stream_fd);
-
-            /* check read size */
-            if (p == NULL) {
-                ALOGE("failed to read sysfs entry for subdev");
-            } else {
-                /* matched */
-                if (strncmp(name, devname, strlen(devname)) == 0) {
-                    ALOGI("node found for device %s: /dev/v4l-subdev%d", devname, i);
-                    found = true;
-                    break;
-                }
-            }
-        }
-        i++;
-    } while (found == false);
-
-    if (found)
-        ret = i;
-    else
+    char filename[64];
+    int ret;
+
+    ret = exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_SUBDEV, devname, filename, sizeof(filename));
+    if (ret < 0)
         ALOGE("no subdev device found");
+    else
+        ALOGI("node found for device %s: %s", devname, filename);
 
     return ret;
 }
 
 int exynos_subdev_open_devname(const char *devname, int oflag, ...)
 {
-    bool found = false;
-    int fd = -1;
-    struct stat s;
-    va_list ap;
-    FILE *stream_fd;
-    char filename[64], name[64];
-    int i = 0;
-
-    do {
-        if (i > (SUBDEV_MAX - 128))
-            break;
-
-        /* video device node */
-        snprintf(filename, sizeof(filename), "/dev/v4l-subdev%d", i);
-
-        /* if the node is video device */
-        if ((lstat(filename, &s) == 0) && S_ISCHR(s.st_mode) &&
-                ((int)((unsigned short)(s.st_rdev) >> 8) == 81)) {
-            ALOGD("try node: %s", filename);
-            /* open sysfs entry */
-            snprintf(filename, sizeof(filename), "/sys/class/video4linux/v4l-subdev%d/name", i);
-            if (S_ISLNK(s.st_mode)) {
-                ALOGE("symbolic link detected");
-                return -1;
-            }
-            stream_fd = fopen(filename, "r");
-            if (stream_fd == NULL) {
-                ALOGE("failed to open sysfs entry for subdev");
-                continue;   /* try next */
-            }
-
-            /* read sysfs entry for device name */
-            char *p = fgets(name, sizeof(name), stream_fd);
-            fclose(stream_fd);
-
-            /* check read size */
-            if (p == NULL) {
-                ALOGE("failed to read sysfs entry for subdev");
-            } else {
-                /* matched */
-                if (strncmp(name, devname, strlen(devname)) == 0) {
-                    ALOGI("node found for device %s: /dev/v4l-subdev%d", devname, i);
-                    found = true;
-                    break;
-                }
-            }
-        }
-	i++;
-    } while (found == false);
-
-    if (found) {
-        snprintf(filename, sizeof(filename), "/dev/v4l-subdev%d", i);
-        va_start(ap, oflag);
-        fd = __subdev_open(filename, oflag, ap);
-        va_end(ap);
-
-        if (fd > 0)
-            ALOGI("open subdev device %s", filename);
-        else
-            ALOGE("failed to open subdev device %s", filename);
-    } else {
-        ALOGE("no subdev device found");
-    }
+    int fd;
+
+    fd = exynos_v4l2_devcache_open(EXYNOS_V4L2_DEV_SUBDEV, devname, oflag, NULL);
+    if (fd < 0)
+        ALOGE("failed to open subdev device %s", devname);
 
     return fd;
 }
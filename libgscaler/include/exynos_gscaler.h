@@ -346,6 +346,16 @@ int exynos_gsc_run_exclusive(
     exynos_mpp_img *src_img,
     exynos_mpp_img *dst_img);
 
+/*
+*api for running a batch of M2M jobs.
+The jobs on a SCALER are pipelined by libscaler. The jobs on a GSC are
+processed back to back. Returns the number of the failed jobs.
+*/
+int exynos_gsc_run_batch_exclusive(
+    void *handle,
+    exynos_sc_job *jobs,
+    unsigned int count);
+
 /*!
  * Create exclusive libgscaler blend handle.
  * Other module can't use dev_num of Gscaler.
@@ -26,6 +26,7 @@
  *   Create
  */
 
+#include <time.h>
 #include <linux/v4l2-subdev.h>
 
 #include "libgscaler_obj.h"
@@ -455,6 +456,66 @@ int exynos_gsc_run_exclusive(void *handle,
     return ret;
 }
 
+static int64_t exynos_gsc_monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+int exynos_gsc_run_batch_exclusive(void *handle,
+    exynos_sc_job *jobs, unsigned int count)
+{
+    Exynos_gsc_In();
+
+    int failed = 0;
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    if (gsc->gsc_id >= HW_SCAL0) {
+        failed = exynos_sc_run_batch_exclusive(gsc->scaler, jobs, count);
+        Exynos_gsc_Out();
+        return failed;
+    }
+
+    if (gsc->mode != GSC_M2M_MODE) {
+        ALOGE("%s::batch is only supported by M2M mode", __func__);
+        return -1;
+    }
+
+    /* The M2M path of GSC processes one frame at a time */
+    for (unsigned int i = 0; i < count; i++) {
+        exynos_mpp_img *src_img = &jobs[i].src;
+        exynos_mpp_img *dst_img = &jobs[i].dst;
+
+        jobs[i].result = -1;
+        jobs[i].submit_ns = exynos_gsc_monotonic_ns();
+        jobs[i].complete_ns = 0;
+        src_img->releaseFenceFd = -1;
+        dst_img->releaseFenceFd = -1;
+
+        if ((gsc->m_gsc_m2m_config(handle, src_img, dst_img) < 0) ||
+                (gsc->m_gsc_m2m_run(handle, src_img, dst_img) < 0) ||
+                (gsc->m_gsc_m2m_wait_frame_done(handle) < 0)) {
+            ALOGE("%s::job %u of the batch failed", __func__, i);
+            failed++;
+            continue;
+        }
+
+        jobs[i].complete_ns = exynos_gsc_monotonic_ns();
+        jobs[i].result = 0;
+    }
+
+    Exynos_gsc_Out();
+
+    return failed;
+}
+
 void *exynos_gsc_create_blend_exclusive(int dev_num, int mode, int out_mode,
                                                                 int allow_drm)
 {
@@ -33,6 +33,7 @@ LOCAL_SRC_FILES := \
 	libdrmresource/drm/resourcemanager.cpp \
 	libdrmresource/drm/drmdevice.cpp \
 	libdrmresource/drm/drmconnector.cpp \
+	libdrmresource/drm/drmconnectorstate.cpp \
 	libdrmresource/drm/drmcrtc.cpp \
 	libdrmresource/drm/drmencoder.cpp \
 	libdrmresource/drm/drmmode.cpp \
@@ -92,7 +93,8 @@ LOCAL_SHARED_LIBRARIES += android.hardware.graphics.composer3-V3-ndk \
                           libbinder_ndk \
                           libbase \
                           libpng \
-                          libprocessgroup
+                          libprocessgroup \
+                          libz
 
 LOCAL_HEADER_LIBRARIES := libhardware_legacy_headers \
 			  libbinder_headers google_hal_headers \
@@ -137,15 +139,23 @@ LOCAL_SRC_FILES := \
 	libdevice/ExynosLayer.cpp \
 	libdevice/HistogramDevice.cpp \
 	libdevice/DisplayTe2Manager.cpp \
+	libdevice/DisplayConfigIndex.cpp \
+	libdevice/DisplayTemperatureMonitor.cpp \
+	libdevice/ReadbackEngine.cpp \
+	libdevice/DamageTracker.cpp \
+	libdevice/AsyncLogSink.cpp \
+	libdevice/BufferDumper.cpp \
 	libmaindisplay/ExynosPrimaryDisplay.cpp \
 	libresource/ExynosMPP.cpp \
 	libresource/ExynosResourceManager.cpp \
+	libresource/ResourcePartition.cpp \
 	libexternaldisplay/ExynosExternalDisplay.cpp \
 	libvirtualdisplay/ExynosVirtualDisplay.cpp \
 	libdisplayinterface/ExynosDeviceInterface.cpp \
 	libdisplayinterface/ExynosDisplayInterface.cpp \
 	libdisplayinterface/ExynosDeviceDrmInterface.cpp \
 	libdisplayinterface/ExynosDisplayDrmInterface.cpp \
+	libdisplayinterface/DrmCommittedState.cpp \
 	libvrr/display/common/CommonDisplayContextProvider.cpp \
 	libvrr/display/exynos/ExynosDisplayContextProvider.cpp \
 	libvrr/Power/PowerStatsPresentProfileTokenGenerator.cpp \
@@ -205,6 +215,140 @@ LOCAL_MODULE_TAGS := optional
 include $(TOP)/hardware/google/graphics/common/BoardConfigCFlags.mk
 include $(BUILD_SHARED_LIBRARY)
 
+################################################################################
+# MPP partition through ExynosResourceManager, needs the composer stopped
+
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libexynosdisplay libacryl libui \
+	libdrm libdrmresource libvendorgraphicbuffer \
+	android.hardware.graphics.composer@2.4 \
+	android.hardware.graphics.allocator@2.0 \
+	android.hardware.graphics.mapper@2.0
+
+LOCAL_SHARED_LIBRARIES += android.hardware.graphics.composer3-V3-ndk \
+                          android.hardware.drm-V1-ndk \
+                          com.google.hardware.pixel.display-V12-ndk \
+                          android.frameworks.stats-V2-ndk \
+                          libpixelatoms_defs \
+                          pixelatoms-cpp \
+                          libbinder_ndk \
+                          libbase
+
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_HEADER_LIBRARIES := libhardware_legacy_headers libbinder_headers google_hal_headers
+LOCAL_HEADER_LIBRARIES += libgralloc_headers \
+			  android.hardware.graphics.common-V3-ndk_headers
+
+LOCAL_CFLAGS := -DHLOG_CODE=0
+LOCAL_CFLAGS += -DLOG_TAG=\"hwc-test\"
+LOCAL_CFLAGS += -DSOC_VERSION=$(soc_ver)
+LOCAL_CFLAGS += -Wno-unused-parameter
+
+LOCAL_C_INCLUDES += \
+	$(TOP)/hardware/google/graphics/common/include \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1 \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libdevice \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libmaindisplay \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libexternaldisplay \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libvirtualdisplay \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libhwchelper \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libresource \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1 \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libmaindisplay \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libexternaldisplay \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libvirtualdisplay \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libcolormanager \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libresource \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libdevice \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libdisplayinterface \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/include \
+	$(TOP)/hardware/google/graphics/$(soc_ver) \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libhwcService \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libdisplayinterface \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libdrmresource/include \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libvrr \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libvrr/interface
+
+LOCAL_SRC_FILES := \
+	libresource/test/ResourceManagerPartitionTest.cpp
+
+LOCAL_MODULE := libhwc2.1_resource_manager_partition_test
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_MODULE_TAGS := optional
+
+include $(TOP)/hardware/google/graphics/common/BoardConfigCFlags.mk
+include $(BUILD_NATIVE_TEST)
+
+################################################################################
+# Color setting updates of DisplaySceneInfo, without a display
+
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libexynosdisplay libacryl libui \
+	libdrm libdrmresource libvendorgraphicbuffer \
+	android.hardware.graphics.composer@2.4 \
+	android.hardware.graphics.allocator@2.0 \
+	android.hardware.graphics.mapper@2.0
+
+LOCAL_SHARED_LIBRARIES += android.hardware.graphics.composer3-V3-ndk \
+                          android.hardware.drm-V1-ndk \
+                          com.google.hardware.pixel.display-V12-ndk \
+                          android.frameworks.stats-V2-ndk \
+                          libpixelatoms_defs \
+                          pixelatoms-cpp \
+                          libbinder_ndk \
+                          libbase
+
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_HEADER_LIBRARIES := libhardware_legacy_headers libbinder_headers google_hal_headers
+LOCAL_HEADER_LIBRARIES += libgralloc_headers \
+			  android.hardware.graphics.common-V3-ndk_headers
+
+LOCAL_CFLAGS := -DHLOG_CODE=0
+LOCAL_CFLAGS += -DLOG_TAG=\"hwc-test\"
+LOCAL_CFLAGS += -DSOC_VERSION=$(soc_ver)
+LOCAL_CFLAGS += -Wno-unused-parameter
+
+LOCAL_C_INCLUDES += \
+	$(TOP)/hardware/google/graphics/common/include \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1 \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libdevice \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libmaindisplay \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libexternaldisplay \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libvirtualdisplay \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libhwchelper \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libresource \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1 \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libmaindisplay \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libexternaldisplay \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libvirtualdisplay \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libcolormanager \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libresource \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libdevice \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1/libdisplayinterface \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/include \
+	$(TOP)/hardware/google/graphics/$(soc_ver) \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libhwcService \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libdisplayinterface \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libdrmresource/include \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libvrr \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libvrr/interface
+
+LOCAL_SRC_FILES := \
+	test/DisplaySceneInfoTest.cpp
+
+LOCAL_MODULE := libhwc2.1_display_scene_info_test
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_MODULE_TAGS := optional
+
+include $(TOP)/hardware/google/graphics/common/BoardConfigCFlags.mk
+include $(BUILD_NATIVE_TEST)
+
 ################################################################################
 
 ifeq ($(BOARD_USES_HWC_SERVICES),true)
@@ -15,17 +15,33 @@
  */
 #include "DisplaySceneInfo.h"
 
+#include <inttypes.h>
+
 #include "ExynosLayer.h"
 
 LayerColorData& DisplaySceneInfo::getLayerColorDataInstance(uint32_t index) {
     size_t currentSize = displayScene.layer_data.size();
+    // layer_data may have been shrunk by the caller
+    if (layerDataSource.size() > currentSize) layerDataSource.resize(currentSize);
     if (index >= currentSize) {
         displayScene.layer_data.resize(currentSize + 1);
         colorSettingChanged = true;
     }
+    if (index >= layerDataSource.size()) layerDataSource.resize(index + 1);
     return displayScene.layer_data[index];
 }
 
+DisplaySceneInfo::LayerColorDataSource* DisplaySceneInfo::getLayerDataSource(
+        const LayerColorData& layerData) {
+    if (displayScene.layer_data.empty()) return nullptr;
+
+    const LayerColorData* first = &displayScene.layer_data.front();
+    if ((&layerData < first) || (&layerData > &displayScene.layer_data.back())) return nullptr;
+
+    size_t index = &layerData - first;
+    return index < layerDataSource.size() ? &layerDataSource[index] : nullptr;
+}
+
 int32_t DisplaySceneInfo::setLayerDataMappingInfo(ExynosMPPSource* layer, uint32_t index) {
     if (layerDataMappingInfo.count(layer) != 0) {
         ALOGE("layer mapping is already inserted (layer: %p, index:%d)", layer, index);
@@ -137,7 +153,11 @@ void DisplaySceneInfo::setLayerHdrDynamicMetadata(
 int32_t DisplaySceneInfo::setClientCompositionColorData(
         const ExynosCompositionInfo& clientCompositionInfo, LayerColorData& layerData,
         float dimSdrRatio) {
-    layerData.dim_ratio = 1.0f;
+    LayerColorDataSource* dataSource = getLayerDataSource(layerData);
+    if (dataSource) *dataSource = {&clientCompositionInfo, dimSdrRatio};
+
+    float dimRatio = 1.0f;
+    updateInfoSingleVal(layerData.dim_ratio, dimRatio);
     setLayerDataspace(layerData, static_cast<hwc::Dataspace>(clientCompositionInfo.mDataSpace));
     disableLayerHdrStaticMetadata(layerData);
     disableLayerHdrDynamicMetadata(layerData);
@@ -165,12 +185,27 @@ int32_t DisplaySceneInfo::setClientCompositionColorData(
 
 int32_t DisplaySceneInfo::setLayerColorData(LayerColorData& layerData, ExynosLayer* layer,
                                             float dimSdrRatio) {
-    layerData.is_solid_color_layer = layer->isDimLayer();
-    layerData.solid_color.r = layer->mColor.r;
-    layerData.solid_color.g = layer->mColor.g;
-    layerData.solid_color.b = layer->mColor.b;
-    layerData.solid_color.a = layer->mColor.a;
-    layerData.dim_ratio = layer->mPreprocessedInfo.sdrDimRatio;
+    /*
+     * The slot still holds the data of this layer from the previous frame
+     * and the layer reported no change: the matrices and the HDR metadata
+     * need not be built again.
+     */
+    LayerColorDataSource* dataSource = getLayerDataSource(layerData);
+    if (dataSource && (dataSource->source == layer) &&
+        (dataSource->dimSdrRatio == dimSdrRatio) && (layer->mColorDataChanged == 0)) {
+        updateStats.layersSkipped++;
+        return NO_ERROR;
+    }
+    updateStats.layersRebuilt++;
+
+    bool isSolidColorLayer = layer->isDimLayer();
+    updateInfoSingleVal(layerData.is_solid_color_layer, isSolidColorLayer);
+    Color solidColor{layer->mColor.r, layer->mColor.g, layer->mColor.b, layer->mColor.a};
+    if (!(layerData.solid_color == solidColor)) {
+        colorSettingChanged = true;
+        layerData.solid_color = solidColor;
+    }
+    updateInfoSingleVal(layerData.dim_ratio, layer->mPreprocessedInfo.sdrDimRatio);
     setLayerDataspace(layerData, static_cast<hwc::Dataspace>(layer->mDataSpace));
     if (layer->mIsHdrLayer && layer->getMetaParcel() != nullptr) {
         if (layer->getMetaParcel()->eType & VIDEO_INFO_TYPE_HDR_STATIC)
@@ -232,18 +267,64 @@ int32_t DisplaySceneInfo::setLayerColorData(LayerColorData& layerData, ExynosLay
         }
     }
 
+    if (dataSource) *dataSource = {layer, dimSdrRatio};
+    layer->clearColorDataChanged();
+
     return NO_ERROR;
 }
 
+template <typename T, typename M>
+static inline void updateField(T& dst, const M& src, bool& changed) {
+    if (!(dst == src)) {
+        changed = true;
+        dst = src;
+    }
+}
+
+/*
+ * The fields of the scene that the display module writes directly. The color
+ * data of the layers is compared by the setters instead.
+ */
+bool DisplaySceneInfo::updateSceneFields() {
+    bool changed = false;
+
+    updateField(sceneFields.dpuBitDepth, displayScene.dpu_bit_depth, changed);
+    updateField(sceneFields.colorMode, displayScene.color_mode, changed);
+    updateField(sceneFields.renderIntent, displayScene.render_intent, changed);
+    updateField(sceneFields.matrix, displayScene.matrix, changed);
+    updateField(sceneFields.forceHdr, displayScene.force_hdr, changed);
+    updateField(sceneFields.bm, displayScene.bm, changed);
+    updateField(sceneFields.dbv, displayScene.dbv, changed);
+    updateField(sceneFields.lhbmOn, displayScene.lhbm_on, changed);
+    updateField(sceneFields.refreshRate, displayScene.refresh_rate, changed);
+    updateField(sceneFields.operationRate, displayScene.operation_rate, changed);
+    updateField(sceneFields.temperature, displayScene.temperature, changed);
+    updateField(sceneFields.hdrLayerState, displayScene.hdr_layer_state, changed);
+
+    if (sceneFields.layers.size() != displayScene.layer_data.size()) {
+        changed = true;
+        sceneFields.layers.resize(displayScene.layer_data.size());
+    }
+    for (size_t i = 0; i < sceneFields.layers.size(); i++) {
+        updateField(sceneFields.layers[i].enabled, displayScene.layer_data[i].enabled, changed);
+        updateField(sceneFields.layers[i].isClientTarget,
+                    displayScene.layer_data[i].is_client_target, changed);
+    }
+
+    return changed;
+}
+
 bool DisplaySceneInfo::needDisplayColorSetting() {
-    /* TODO: Check if we can skip color setting */
-    /* For now, propage setting every frame */
-    return true;
+    bool fieldsChanged = updateSceneFields();
+    bool needed = forceColorSetting || colorSettingChanged ||
+            (prev_layerDataMappingInfo != layerDataMappingInfo) || fieldsChanged;
+
+    forceColorSetting = false;
 
-    if (colorSettingChanged) return true;
-    if (prev_layerDataMappingInfo != layerDataMappingInfo) return true;
+    updateStats.frames++;
+    if (!needed) updateStats.skippedFrames++;
 
-    return false;
+    return needed;
 }
 
 void DisplaySceneInfo::printDisplayScene() {
@@ -266,6 +347,11 @@ void DisplaySceneInfo::printDisplayScene() {
     for (auto layer : layerDataMappingInfo) {
         ALOGD("[layer: %p] [%d, %d]", layer.first, layer.second.dppIdx, layer.second.planeId);
     }
+
+    ALOGD("skipped frames: %" PRIu64 "/%" PRIu64 ", layers rebuilt: %" PRIu64
+          ", skipped: %" PRIu64,
+          updateStats.skippedFrames, updateStats.frames, updateStats.layersRebuilt,
+          updateStats.layersSkipped);
 }
 
 void DisplaySceneInfo::printLayerColorData(const LayerColorData& layerData) {
@@ -39,9 +39,26 @@ public:
         uint32_t planeId;
         static constexpr uint32_t kPlaneIdNone = std::numeric_limits<uint32_t>::max();
     };
+    // What the color data in a slot of DisplayScene::layer_data was built from
+    struct LayerColorDataSource {
+        const ExynosMPPSource* source = nullptr;
+        float dimSdrRatio = 1.0f;
+    };
+
+    struct UpdateStats {
+        // frames checked by needDisplayColorSetting()
+        uint64_t frames = 0;
+        // frames that did not need the color setting to be updated
+        uint64_t skippedFrames = 0;
+        // layers whose color data was rebuilt or found unchanged
+        uint64_t layersRebuilt = 0;
+        uint64_t layersSkipped = 0;
+    };
+
     bool colorSettingChanged = false;
     bool displaySettingDelivered = false;
     DisplayScene displayScene;
+    UpdateStats updateStats;
 
     /*
      * Index of LayerColorData in DisplayScene::layer_data
@@ -53,6 +70,38 @@ public:
     std::map<ExynosMPPSource*, LayerMappingInfo> layerDataMappingInfo;
     std::map<ExynosMPPSource*, LayerMappingInfo> prev_layerDataMappingInfo;
 
+    // One for each slot of DisplayScene::layer_data
+    std::vector<LayerColorDataSource> layerDataSource;
+
+    /*
+     * The scene fields that are written directly instead of through the
+     * setters, as of the last needDisplayColorSetting()
+     */
+    struct SceneFields {
+        // enabled and is_client_target of a slot of DisplayScene::layer_data
+        struct LayerFields {
+            bool enabled = false;
+            bool isClientTarget = false;
+        };
+
+        BitDepth dpuBitDepth = BitDepth::kTen;
+        hwc::ColorMode colorMode = hwc::ColorMode::NATIVE;
+        hwc::RenderIntent renderIntent = hwc::RenderIntent::COLORIMETRIC;
+        std::array<float, 16> matrix{};
+        bool forceHdr = false;
+        BrightnessMode bm = BrightnessMode::BM_NOMINAL;
+        uint32_t dbv = 0;
+        bool lhbmOn = false;
+        float refreshRate = 0.0f;
+        uint32_t operationRate = 0;
+        uint32_t temperature = 0;
+        HdrLayerState hdrLayerState = HdrLayerState::kHdrNone;
+        std::vector<LayerFields> layers;
+    };
+    SceneFields sceneFields;
+    // The next needDisplayColorSetting() returns true
+    bool forceColorSetting = true;
+
     void reset() {
         colorSettingChanged = false;
         prev_layerDataMappingInfo = layerDataMappingInfo;
@@ -63,8 +112,13 @@ public:
         colorSettingChanged = false;
         layerDataMappingInfo.clear();
         prev_layerDataMappingInfo.clear();
+        layerDataSource.clear();
+        forceColorSetting = true;
     }
 
+    // Called when the color setting failed to apply so that it is tried again
+    void invalidateColorSetting() { forceColorSetting = true; }
+
     template <typename T, typename M>
     void updateInfoSingleVal(T& dst, M& src) {
         if (src != dst) {
@@ -100,6 +154,7 @@ public:
     }
 
     LayerColorData& getLayerColorDataInstance(uint32_t index);
+    LayerColorDataSource* getLayerDataSource(const LayerColorData& layerData);
     int32_t setLayerDataMappingInfo(ExynosMPPSource* layer, uint32_t index);
     void setLayerDataspace(LayerColorData& layerColorData, hwc::Dataspace dataspace);
     void disableLayerHdrStaticMetadata(LayerColorData& layerColorData);
@@ -113,7 +168,13 @@ public:
     int32_t setLayerColorData(LayerColorData& layerData, ExynosLayer* layer, float dimSdrRatio);
     int32_t setClientCompositionColorData(const ExynosCompositionInfo& clientCompositionInfo,
                                           LayerColorData& layerData, float dimSdrRatio);
+    /*
+     * Returns false if the scene is the same as in the previous frame, in
+     * which case the color setting is not updated. Called once per frame.
+     */
     bool needDisplayColorSetting();
+    // Copies the directly written fields to sceneFields, returns true if any differed
+    bool updateSceneFields();
     void printDisplayScene();
     void printLayerColorData(const LayerColorData& layerData);
 };
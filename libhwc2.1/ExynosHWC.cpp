@@ -1296,6 +1296,11 @@ void exynos_boot_finished(ExynosHWCCtx *dev)
             ExynosExternalDisplayModule *display = (ExynosExternalDisplayModule*)dev->device->getDisplay(getDisplayId(HWC_DISPLAY_EXTERNAL, 0));
             if (display != nullptr) {
                 bool hpdStatus = false;
+                /*
+                 * No uevent reported this connection, the cached connector
+                 * state would be used without a new epoch.
+                 */
+                dev->device->mDeviceInterface->bumpHotplugEpoch();
                 display->checkHotplugEventUpdated(hpdStatus);
                 display->handleHotplugEvent(hpdStatus);
             }
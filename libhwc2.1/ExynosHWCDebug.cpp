@@ -22,20 +22,12 @@ int32_t saveErrorLog(const String8& errString, const ExynosDisplay* display) {
     if (display == nullptr) return -1;
     int32_t ret = NO_ERROR;
 
-    auto &fileWriter = display->mErrLogFileWriter;
-
-    if (!fileWriter.chooseOpenedFile()) {
-        return -1;
-    }
-
+    // The record carries the time
     String8 saveString;
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-
-    saveString.appendFormat("%s errFrameNumber %" PRIu64 ": %s\n", getLocalTimeStr(tv).c_str(),
-                            display->mErrorFrameCount, errString.c_str());
+    saveString.appendFormat("errFrameNumber %" PRIu64 ": %s\n", display->mErrorFrameCount,
+                            errString.c_str());
 
-    fileWriter.write(saveString);
-    fileWriter.flush();
+    display->mLogChannel->logText(hwclog::STREAM_ERROR,
+                                  std::string_view(saveString.c_str(), saveString.size()));
     return ret;
 }
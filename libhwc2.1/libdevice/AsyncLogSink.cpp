@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "hwc-log-sink"
+
+#include "AsyncLogSink.h"
+
+#include <log/log.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+
+namespace {
+
+constexpr uint32_t kDefaultMaxFileCount = 2;
+constexpr uint32_t kDefaultThresholdSizePerFile = 1024 * 1024;
+constexpr char kExtension[] = ".hwclog";
+
+int64_t realtimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+const hwclog::FileHeader kFileHeader = {
+        {'H', 'W', 'C', 'L', 'O', 'G', '\0', '\0'},
+        hwclog::kVersion,
+        sizeof(hwclog::RecordHeader),
+};
+
+} // namespace
+
+void RotatingLogFileWriter::setFileHeader(const void* header, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(header);
+    mFileHeader.assign(bytes, bytes + size);
+}
+
+FILE* RotatingLogFileWriter::openLogFile(const std::string& filename, const std::string& mode) {
+    for (const auto& dir : mLogDirs) {
+        auto fullpath = dir + "/" + filename;
+        FILE* file = fopen(fullpath.c_str(), mode.c_str());
+        if (file != nullptr) {
+            return startFile(file);
+        }
+        ALOGE("Fail to open file %s, error: %s", fullpath.c_str(), strerror(errno));
+    }
+    return nullptr;
+}
+
+FILE* RotatingLogFileWriter::startFile(FILE* file) {
+    // ftell() of a file opened for appending is 0 until the first write
+    fseek(file, 0, SEEK_END);
+    if (!mFileHeader.empty() && ftell(file) == 0) {
+        fwrite(mFileHeader.data(), 1, mFileHeader.size(), file);
+    }
+    return file;
+}
+
+std::optional<int64_t> RotatingLogFileWriter::getLastModifiedTimestamp(
+        const std::string& filename) {
+    struct stat fileStat;
+    for (const auto& dir : mLogDirs) {
+        auto fullpath = dir + "/" + filename;
+        if (stat(fullpath.c_str(), &fileStat) == 0) {
+            return fileStat.st_mtim.tv_sec * 1000000000LL + fileStat.st_mtim.tv_nsec;
+        }
+    }
+    return std::nullopt;
+}
+
+bool RotatingLogFileWriter::chooseOpenedFile() {
+    if (mLastFileIndex < 0) {
+        // HWC could be restarted, so choose to open new file or continue the last modified file
+        int32_t chosenIndex = 0;
+        int64_t lastModifTimestamp = 0;
+        for (uint32_t i = 0; i < mMaxFileCount; ++i) {
+            auto timestamp = getLastModifiedTimestamp(getFileName(i));
+            if (!timestamp.has_value()) {
+                chosenIndex = i;
+                break;
+            }
+            if (i == 0 || lastModifTimestamp < *timestamp) {
+                chosenIndex = i;
+                lastModifTimestamp = *timestamp;
+            }
+        }
+        auto filename = getFileName(chosenIndex);
+        mFile = openLogFile(filename, "ab");
+        if (mFile == nullptr) {
+            ALOGE("Unable to open log file for %s", filename.c_str());
+            return false;
+        }
+        mLastFileIndex = chosenIndex;
+    }
+
+    // Choose to use the same last file or move on to the next file
+    for (int i = 0; i < 2; ++i) {
+        if (mFile == nullptr) {
+            mFile = openLogFile(getFileName(mLastFileIndex), (i == 0) ? "ab" : "wb");
+        }
+        if (mFile != nullptr) {
+            auto fileSize = ftell(mFile);
+            // A file with the header only is empty
+            if (fileSize < mThresholdSizePerFile ||
+                fileSize <= static_cast<long>(mFileHeader.size()))
+                return true;
+            fclose(mFile);
+            mFile = nullptr;
+        }
+        mLastFileIndex = (mLastFileIndex + 1) % mMaxFileCount;
+    }
+    return false;
+}
+
+bool RotatingLogFileWriter::startNextFile() {
+    if (!chooseOpenedFile()) {
+        return false;
+    }
+    // A file with the header only is empty
+    if (ftell(mFile) <= static_cast<long>(mFileHeader.size())) {
+        return true;
+    }
+    fclose(mFile);
+    mLastFileIndex = (mLastFileIndex + 1) % mMaxFileCount;
+    mFile = openLogFile(getFileName(mLastFileIndex), "wb");
+    return mFile != nullptr;
+}
+
+AsyncLogSink::Channel::Channel(AsyncLogSink& sink, uint32_t ringSize)
+      : mSink(sink), mMask(ringSize - 1), mSlots(new Slot[ringSize]) {
+    for (uint32_t i = 0; i < ringSize; i++) {
+        mSlots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < hwclog::STREAM_MAX; i++) {
+        setRotation(static_cast<hwclog::Stream>(i), kDefaultMaxFileCount,
+                    kDefaultThresholdSizePerFile);
+    }
+}
+
+AsyncLogSink::Channel::~Channel() {
+    // What the writer has not taken yet goes out from the last owner
+    drain();
+}
+
+bool AsyncLogSink::Channel::log(hwclog::Stream stream, hwclog::RecordType type,
+                                const void* payload, size_t size, bool wait) {
+    return push(stream, type, 0, payload, size, wait);
+}
+
+bool AsyncLogSink::Channel::push(hwclog::Stream stream, hwclog::RecordType type, uint8_t flags,
+                                 const void* payload, size_t size, bool wait) {
+    if (stream >= hwclog::STREAM_MAX || size > hwclog::kMaxPayloadSize) {
+        return false;
+    }
+
+    // Vyukov's bounded queue: a slot is free for the position its seq holds
+    Slot* slot;
+    uint32_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    for (;;) {
+        slot = &mSlots[pos & mMask];
+        const int32_t diff =
+                static_cast<int32_t>(slot->seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full, the writer has not taken the record logged a ring ago
+            if (wait) {
+                const auto now = std::chrono::steady_clock::now();
+                if (!deadline) deadline = now + std::chrono::milliseconds(kMaxWaitMs);
+                const int64_t remainingMs =
+                        std::chrono::duration_cast<std::chrono::milliseconds>(*deadline - now)
+                                .count();
+                if (remainingMs > 0) {
+                    mWaits.fetch_add(1, std::memory_order_relaxed);
+                    if (mSink.waitCycle(remainingMs)) {
+                        pos = mEnqueuePos.load(std::memory_order_relaxed);
+                        continue;
+                    }
+                }
+            }
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            mPendingDrops[stream].fetch_add(1, std::memory_order_relaxed);
+            mSink.wake();
+            return false;
+        } else {
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    hwclog::RecordHeader header = {};
+    header.sync = hwclog::kRecordSync;
+    header.type = type;
+    header.stream = stream;
+    // Taken by the first record that makes it into the ring
+    if (mDumpStart[stream].load(std::memory_order_relaxed) &&
+        mDumpStart[stream].exchange(false, std::memory_order_acq_rel)) {
+        flags |= hwclog::FLAG_DUMP_START;
+    }
+    header.flags = flags;
+    header.size = static_cast<uint16_t>(size);
+    header.dropped = static_cast<uint16_t>(
+            std::min<uint32_t>(mPendingDrops[stream].exchange(0, std::memory_order_relaxed),
+                               UINT16_MAX));
+    header.seq = pos;
+    header.timeNs = realtimeNs();
+    memcpy(slot->data, &header, sizeof(header));
+    memcpy(slot->data + sizeof(header), payload, size);
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    mRecords.fetch_add(1, std::memory_order_relaxed);
+    mSink.wake();
+    return true;
+}
+
+void AsyncLogSink::Channel::logText(hwclog::Stream stream, std::string_view text, bool wait) {
+    while (!text.empty()) {
+        const size_t size = std::min(text.size(), hwclog::kMaxPayloadSize);
+        const uint8_t flags = (size < text.size()) ? hwclog::FLAG_CONTINUED : 0;
+        if (!push(stream, hwclog::TYPE_TEXT, flags, text.data(), size, wait)) {
+            return;
+        }
+        text.remove_prefix(size);
+    }
+}
+
+void AsyncLogSink::Channel::setRotation(hwclog::Stream stream, uint32_t maxFileCount,
+                                        uint32_t thresholdSizePerFile) {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    auto writer = std::make_unique<RotatingLogFileWriter>(maxFileCount, thresholdSizePerFile,
+                                                          kExtension);
+    writer->setPrefixName(mPrefixNames[stream]);
+    writer->setLogDirs(mLogDirs);
+    writer->setFileHeader(&kFileHeader, sizeof(kFileHeader));
+    mWriters[stream] = std::move(writer);
+    mRotateOnDumpStart[stream] = false;
+}
+
+void AsyncLogSink::Channel::setDumpRotation(hwclog::Stream stream, uint32_t maxFileCount) {
+    // The size never moves the stream to the next file, the start of a dump does
+    setRotation(stream, maxFileCount, UINT32_MAX);
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    mRotateOnDumpStart[stream] = true;
+}
+
+void AsyncLogSink::Channel::beginDump(hwclog::Stream stream) {
+    if (stream < hwclog::STREAM_MAX) {
+        mDumpStart[stream].store(true, std::memory_order_release);
+    }
+}
+
+void AsyncLogSink::Channel::setPrefixName(hwclog::Stream stream, const std::string& prefixName) {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    mPrefixNames[stream] = prefixName;
+    mWriters[stream]->setPrefixName(prefixName);
+}
+
+void AsyncLogSink::Channel::setLogDirs(const std::vector<std::string>& dirs) {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    mLogDirs = dirs;
+    for (auto& writer : mWriters) {
+        writer->setLogDirs(dirs);
+    }
+}
+
+AsyncLogSink::Stats AsyncLogSink::Channel::getStats() const {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    Stats stats = mWriterStats;
+    stats.records = mRecords.load(std::memory_order_relaxed);
+    stats.dropped = mDropped.load(std::memory_order_relaxed);
+    stats.waits = mWaits.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool AsyncLogSink::Channel::pop(hwclog::RecordHeader& header, uint8_t* payload) {
+    Slot& slot = mSlots[mDequeuePos & mMask];
+    if (slot.seq.load(std::memory_order_acquire) != mDequeuePos + 1) {
+        return false;
+    }
+
+    memcpy(&header, slot.data, sizeof(header));
+    memcpy(payload, slot.data + sizeof(header), header.size);
+    slot.seq.store(mDequeuePos + mMask + 1, std::memory_order_release);
+    mDequeuePos++;
+    return true;
+}
+
+void AsyncLogSink::Channel::drain() {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+
+    const uint32_t depth = mEnqueuePos.load(std::memory_order_relaxed) - mDequeuePos;
+    mWriterStats.maxDepth = std::max(mWriterStats.maxDepth, depth);
+
+    // The size of the files is checked once per stream and cycle
+    std::array<bool, hwclog::STREAM_MAX> checked = {};
+    std::array<bool, hwclog::STREAM_MAX> opened = {};
+    hwclog::RecordHeader header;
+    uint8_t payload[hwclog::kMaxPayloadSize];
+
+    while (pop(header, payload)) {
+        const uint8_t stream = header.stream;
+        if ((header.flags & hwclog::FLAG_DUMP_START) && mRotateOnDumpStart[stream]) {
+            opened[stream] = mWriters[stream]->startNextFile();
+            checked[stream] = true;
+        } else if (!checked[stream]) {
+            opened[stream] = mWriters[stream]->chooseOpenedFile();
+            checked[stream] = true;
+        }
+        if (!opened[stream]) {
+            mWriterStats.writeErrors++;
+            continue;
+        }
+        mWriters[stream]->write(&header, sizeof(header));
+        mWriters[stream]->write(payload, header.size);
+        mWriterStats.written++;
+        mWriterStats.writtenBytes += sizeof(header) + header.size;
+    }
+
+    for (uint32_t i = 0; i < hwclog::STREAM_MAX; i++) {
+        if (opened[i]) {
+            mWriters[i]->flush();
+            mWriterStats.flushes++;
+        }
+    }
+}
+
+AsyncLogSink& AsyncLogSink::getInstance() {
+    // Never destroyed, the displays log until the process exits
+    static AsyncLogSink* sink = new AsyncLogSink();
+    return *sink;
+}
+
+AsyncLogSink::AsyncLogSink() {}
+
+AsyncLogSink::~AsyncLogSink() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+std::shared_ptr<AsyncLogSink::Channel> AsyncLogSink::createChannel(uint32_t ringSize) {
+    if (ringSize == 0 || (ringSize & (ringSize - 1)) != 0) {
+        ALOGE("%s: ring size %u is not a power of two", __func__, ringSize);
+        ringSize = kRingSize;
+    }
+
+    std::shared_ptr<Channel> channel(new Channel(*this, ringSize));
+    std::lock_guard<std::mutex> lock(mMutex);
+    channel->setLogDirs(mLogDirs);
+    mChannels.push_back(channel);
+    if (!mThread.joinable()) {
+        ALOGI("Creating log writer thread");
+        mThread = std::thread(&AsyncLogSink::threadLoop, this);
+        pthread_setname_np(mThread.native_handle(), "HwcLogWriter");
+    }
+    return channel;
+}
+
+void AsyncLogSink::setLogDirs(const std::vector<std::string>& dirs) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLogDirs = dirs;
+    for (const auto& weak : mChannels) {
+        if (auto channel = weak.lock()) {
+            channel->setLogDirs(dirs);
+        }
+    }
+}
+
+void AsyncLogSink::wake() {
+    // Only the first record since the writer last looked wakes it up. A wakeup
+    // lost to the writer going to sleep is made up for by kWritePeriodMs.
+    if (!mPending.exchange(true, std::memory_order_acq_rel)) {
+        mCondition.notify_one();
+    }
+}
+
+bool AsyncLogSink::waitCycle(int64_t timeoutMs) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!mThread.joinable() || mExit) {
+        return false;
+    }
+    const uint64_t target = mCycles + 1;
+    mPending.store(true, std::memory_order_release);
+    mCondition.notify_one();
+    return mSyncCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                   [&] { return mExit || mCycles >= target; }) &&
+            !mExit;
+}
+
+void AsyncLogSink::sync() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!mThread.joinable()) {
+        return;
+    }
+    // A cycle under way may have passed the channels already
+    const uint64_t target = mCycles + 2;
+    while (!mExit && mCycles < target) {
+        mPending.store(true, std::memory_order_release);
+        mCondition.notify_one();
+        mSyncCondition.wait(lock);
+    }
+}
+
+void AsyncLogSink::threadLoop() {
+    std::vector<std::shared_ptr<Channel>> channels;
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (!mExit) {
+        mCondition.wait_for(lock, std::chrono::milliseconds(kWritePeriodMs), [this] {
+            return mExit || mPending.load(std::memory_order_acquire);
+        });
+        mPending.store(false, std::memory_order_release);
+
+        auto it = std::remove_if(mChannels.begin(), mChannels.end(),
+                                 [](const auto& weak) { return weak.expired(); });
+        mChannels.erase(it, mChannels.end());
+        for (const auto& weak : mChannels) {
+            if (auto channel = weak.lock()) {
+                channels.push_back(std::move(channel));
+            }
+        }
+
+        lock.unlock();
+        for (const auto& channel : channels) {
+            channel->drain();
+        }
+        // A display removed meanwhile drains the rest of its ring here
+        channels.clear();
+        lock.lock();
+
+        mCycles++;
+        mSyncCondition.notify_all();
+    }
+}
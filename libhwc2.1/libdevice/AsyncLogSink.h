@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _ASYNC_LOG_SINK_H_
+#define _ASYNC_LOG_SINK_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "HwcLogRecord.h"
+
+/*
+ * Log files of a display, rotated among maxFileCount files once one reaches
+ * thresholdSizePerFile bytes. Files are looked for in the log directories in
+ * order and a new or empty file starts with the file header if one is set.
+ */
+class RotatingLogFileWriter {
+public:
+    RotatingLogFileWriter(uint32_t maxFileCount, uint32_t thresholdSizePerFile,
+                          std::string extension = ".txt")
+          : mMaxFileCount(maxFileCount),
+            mThresholdSizePerFile(thresholdSizePerFile),
+            mPrefixName(""),
+            mExtension(extension),
+            mLastFileIndex(-1),
+            mFile(nullptr) {}
+
+    ~RotatingLogFileWriter() {
+        if (mFile) {
+            fclose(mFile);
+        }
+    }
+
+    bool chooseOpenedFile();
+    // Moves on to the next file unless the current one is still empty
+    bool startNextFile();
+    void write(const void* data, size_t size) {
+        if (mFile) {
+            fwrite(data, 1, size, mFile);
+        }
+    }
+    void flush() {
+        if (mFile) {
+            fflush(mFile);
+        }
+    }
+    void setPrefixName(const std::string& prefixName) { mPrefixName = prefixName; }
+    void setLogDirs(const std::vector<std::string>& dirs) { mLogDirs = dirs; }
+    void setFileHeader(const void* header, size_t size);
+
+private:
+    FILE* openLogFile(const std::string& filename, const std::string& mode);
+    std::optional<int64_t> getLastModifiedTimestamp(const std::string& filename);
+    std::string getFileName(int32_t index) const {
+        return mPrefixName + std::to_string(index) + mExtension;
+    }
+    FILE* startFile(FILE* file);
+
+    uint32_t mMaxFileCount;
+    uint32_t mThresholdSizePerFile;
+    std::string mPrefixName;
+    std::string mExtension;
+    int32_t mLastFileIndex;
+    FILE* mFile;
+    std::vector<std::string> mLogDirs;
+    std::vector<uint8_t> mFileHeader;
+};
+
+/*
+ * Writes the error, debug and fence logs of the displays from a background
+ * thread.
+ *
+ * Every display logs through a Channel, a bounded ring of hwclog records that
+ * any thread can fill without taking a lock or doing I/O. The writer thread
+ * moves the records of all channels to their RotatingLogFileWriter, which it
+ * also rotates and flushes. The records stay binary in the files and
+ * hwclog_decode formats them.
+ *
+ * The composition thread never waits for the writer. When a ring is full the
+ * record is dropped and counted. The next record of the stream carries the
+ * count of the records dropped before it, so the decoded file shows where they
+ * are missing. Cold paths that log more than a ring holds at once, like the
+ * fence dump, ask to wait for the writer instead.
+ */
+class AsyncLogSink {
+public:
+    // Records in the ring of a channel, a power of two
+    static constexpr uint32_t kRingSize = 256;
+    // The writer looks at the rings at least this often
+    static constexpr int64_t kWritePeriodMs = 100;
+    // A producer that waits for room drops the record after this long
+    static constexpr int64_t kMaxWaitMs = 500;
+
+    struct Stats {
+        // Records taken by the ring
+        uint64_t records = 0;
+        // Records dropped because the ring was full
+        uint64_t dropped = 0;
+        // Times a producer waited for the writer to make room
+        uint64_t waits = 0;
+        // Records written to the files, and their size
+        uint64_t written = 0;
+        uint64_t writtenBytes = 0;
+        // Records lost because no file could be opened
+        uint64_t writeErrors = 0;
+        uint64_t flushes = 0;
+        // Highest number of records found waiting in the ring
+        uint32_t maxDepth = 0;
+    };
+
+    class Channel {
+    public:
+        /*
+         * Logs a record of type. If the ring is full the record is dropped, or
+         * with wait set, logged once the writer has made room for it. Only
+         * cold paths may wait, never the composition thread.
+         */
+        bool log(hwclog::Stream stream, hwclog::RecordType type, const void* payload,
+                 size_t size, bool wait = false);
+        template <typename T>
+        bool log(hwclog::Stream stream, hwclog::RecordType type, const T& record,
+                 bool wait = false) {
+            static_assert(sizeof(T) <= hwclog::kMaxPayloadSize, "record is too large");
+            return log(stream, type, &record, sizeof(T), wait);
+        }
+        // Logs text in as many records as it takes
+        void logText(hwclog::Stream stream, std::string_view text, bool wait = false);
+        // The next record of the stream starts a dump
+        void beginDump(hwclog::Stream stream);
+
+        // Files of a stream, the writer checks their size once per cycle
+        void setRotation(hwclog::Stream stream, uint32_t maxFileCount,
+                         uint32_t thresholdSizePerFile);
+        // Files of a stream, every dump of it starting a new one
+        void setDumpRotation(hwclog::Stream stream, uint32_t maxFileCount);
+        void setPrefixName(hwclog::Stream stream, const std::string& prefixName);
+        Stats getStats() const;
+
+        ~Channel();
+
+    private:
+        friend class AsyncLogSink;
+
+        struct Slot {
+            std::atomic<uint32_t> seq;
+            alignas(8) uint8_t data[hwclog::kMaxRecordSize];
+        };
+
+        Channel(AsyncLogSink& sink, uint32_t ringSize);
+        bool push(hwclog::Stream stream, hwclog::RecordType type, uint8_t flags,
+                  const void* payload, size_t size, bool wait);
+        void setLogDirs(const std::vector<std::string>& dirs);
+        // Called by the writer only
+        bool pop(hwclog::RecordHeader& header, uint8_t* payload);
+        void drain();
+
+        AsyncLogSink& mSink;
+        const uint32_t mMask;
+        std::unique_ptr<Slot[]> mSlots;
+        alignas(64) std::atomic<uint32_t> mEnqueuePos = 0;
+        alignas(64) uint32_t mDequeuePos = 0;
+        // Drops of each stream not reported in a record yet
+        std::array<std::atomic<uint32_t>, hwclog::STREAM_MAX> mPendingDrops = {};
+        // beginDump() called, not taken by a record of the stream yet
+        std::array<std::atomic<bool>, hwclog::STREAM_MAX> mDumpStart = {};
+
+        std::atomic<uint64_t> mRecords = 0;
+        std::atomic<uint64_t> mDropped = 0;
+        std::atomic<uint64_t> mWaits = 0;
+
+        // Held by the writer while it drains the ring, guards the members below
+        mutable std::mutex mWriterMutex;
+        std::array<std::unique_ptr<RotatingLogFileWriter>, hwclog::STREAM_MAX> mWriters;
+        std::array<bool, hwclog::STREAM_MAX> mRotateOnDumpStart = {};
+        std::array<std::string, hwclog::STREAM_MAX> mPrefixNames;
+        std::vector<std::string> mLogDirs;
+        Stats mWriterStats;
+    };
+
+    static AsyncLogSink& getInstance();
+
+    AsyncLogSink();
+    ~AsyncLogSink();
+
+    // Adds a display, the writer thread starts with the first one
+    std::shared_ptr<Channel> createChannel(uint32_t ringSize = kRingSize);
+    // Directories of the log files, in the order they are tried
+    void setLogDirs(const std::vector<std::string>& dirs);
+    // Waits until the writer has written what was logged before the call
+    void sync();
+
+private:
+    void wake();
+    // Waits for the writer to go through the channels once more
+    bool waitCycle(int64_t timeoutMs);
+    void threadLoop();
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::condition_variable mSyncCondition;
+    std::vector<std::weak_ptr<Channel>> mChannels;
+    std::vector<std::string> mLogDirs;
+    std::thread mThread;
+    bool mExit = false;
+    uint64_t mCycles = 0;
+    std::atomic<bool> mPending = false;
+};
+
+#endif // _ASYNC_LOG_SINK_H_
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "AsyncLogSink.h"
+
+namespace {
+
+// Layers and windows of a busy frame
+constexpr int kLayers = 12;
+
+std::string& logDir() {
+    static std::string dir = [] {
+        char tmpl[] = "/data/local/tmp/hwclog_XXXXXX";
+        const char* dir = mkdtemp(tmpl);
+        return std::string(dir ? dir : "/tmp");
+    }();
+    return dir;
+}
+
+// Roughly the text dumpLocked() makes of a layer
+std::string layerText(int index) {
+    std::string text = "layer[" + std::to_string(index) + "] ";
+    text.append(420, 'x');
+    text.append("\n");
+    return text;
+}
+
+// What printDebugInfos() did: format, write and flush on the calling thread
+void BM_SyncWriter_DebugDump(benchmark::State& state) {
+    RotatingLogFileWriter writer(10, 1024 * 1024, ".txt");
+    writer.setLogDirs({logDir()});
+    writer.setPrefixName("sync_debug");
+    for (auto _ : state) {
+        if (!writer.chooseOpenedFile()) {
+            state.SkipWithError("no log file");
+            break;
+        }
+        for (int i = 0; i < kLayers * 2; i++) {
+            const std::string text = layerText(i);
+            writer.write(text.data(), text.size());
+        }
+        writer.flush();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// What it does now: copy records into the ring of the display
+void BM_AsyncSink_DebugDump(benchmark::State& state) {
+    AsyncLogSink sink;
+    sink.setLogDirs({logDir()});
+    auto channel = sink.createChannel();
+    channel->setPrefixName(hwclog::STREAM_DEBUG, "async_debug");
+    hwclog::LayerRecord layer = {};
+    hwclog::WinConfigRecord config = {};
+    for (auto _ : state) {
+        channel->logText(hwclog::STREAM_DEBUG, "errFrameNumber: 0 reason\n");
+        for (int i = 0; i < kLayers; i++) {
+            layer.index = i;
+            channel->log(hwclog::STREAM_DEBUG, hwclog::TYPE_LAYER, layer);
+            config.index = i;
+            channel->log(hwclog::STREAM_DEBUG, hwclog::TYPE_WIN_CONFIG, config);
+        }
+        // Keep the ring from overflowing so that the cost is that of a kept record
+        state.PauseTiming();
+        sink.sync();
+        state.ResumeTiming();
+    }
+    const auto stats = channel->getStats();
+    state.counters["dropped"] = stats.dropped;
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Producers racing for one ring, dropping what the writer cannot keep up with
+void BM_AsyncSink_Contended(benchmark::State& state) {
+    static AsyncLogSink sink;
+    static std::shared_ptr<AsyncLogSink::Channel> channel;
+    if (state.thread_index() == 0) {
+        sink.setLogDirs({logDir()});
+        channel = sink.createChannel();
+        channel->setPrefixName(hwclog::STREAM_FENCE, "async_fence");
+    }
+    hwclog::FenceTraceRecord trace = {};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(channel->log(hwclog::STREAM_FENCE, hwclog::TYPE_FENCE_TRACE, trace));
+    }
+    if (state.thread_index() == 0) {
+        const auto stats = channel->getStats();
+        state.counters["dropped"] = stats.dropped;
+        channel.reset();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_SyncWriter_DebugDump);
+BENCHMARK(BM_AsyncSink_DebugDump);
+BENCHMARK(BM_AsyncSink_Contended)->Threads(1)->Threads(4);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -974,20 +974,33 @@ int BrightnessController::queryBrightness(float brightness, bool *ghbm, uint32_t
 int BrightnessController::checkSysfsStatus(const std::string& file,
                                            const std::vector<std::string>& expectedValue,
                                            const nsecs_t timeoutNs) {
-    ATRACE_CALL();
-
     if (expectedValue.size() == 0) {
       return -EINVAL;
     }
 
-    char buf[16];
     UniqueFd fd = open(file.c_str(), O_RDONLY);
     if (fd.get() < 0) {
         ALOGE("%s failed to open sysfs %s: %s", __func__, file.c_str(), strerror(errno));
         return -ENOENT;
     }
 
-    int size = read(fd.get(), buf, sizeof(buf));
+    return checkSysfsStatus(fd.get(), file, expectedValue, timeoutNs);
+}
+
+int BrightnessController::checkSysfsStatus(int fd, const std::string& file,
+                                           const std::vector<std::string>& expectedValue,
+                                           const nsecs_t timeoutNs) {
+    ATRACE_CALL();
+
+    if (fd < 0 || expectedValue.size() == 0) {
+      return -EINVAL;
+    }
+
+    // The file may have been read before. Reading it from the start also
+    // re-arms the sysfs notification.
+    char buf[16];
+    lseek(fd, 0, SEEK_SET);
+    int size = read(fd, buf, sizeof(buf));
     if (size <= 0) {
         ALOGE("%s failed to read from %s: %s", __func__, file.c_str(), strerror(errno));
         return -EIO;
@@ -1006,7 +1019,7 @@ int BrightnessController::checkSysfsStatus(const std::string& file,
     int ret = -EINVAL;
 
     auto startTime = systemTime(SYSTEM_TIME_MONOTONIC);
-    pfd.fd = fd.get();
+    pfd.fd = fd;
     pfd.events = POLLPRI;
     while (true) {
         auto currentTime = systemTime(SYSTEM_TIME_MONOTONIC);
@@ -1026,8 +1039,8 @@ int BrightnessController::checkSysfsStatus(const std::string& file,
                 continue;
             }
 
-            lseek(fd.get(), 0, SEEK_SET);
-            size = read(fd.get(), buf, sizeof(buf));
+            lseek(fd, 0, SEEK_SET);
+            size = read(fd, buf, sizeof(buf));
             if (size > 0) {
                 val = std::string(buf, size - 1);
                 if (std::find(expectedValue.begin(), expectedValue.end(), val) !=
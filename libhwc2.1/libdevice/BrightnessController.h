@@ -131,6 +131,9 @@ public:
     }
     int checkSysfsStatus(const std::string& file, const std::vector<std::string>& expectedValue,
                          const nsecs_t timeoutNs);
+    // Same as above on a sysfs file kept open by the caller. @file is for logging.
+    int checkSysfsStatus(int fd, const std::string& file,
+                         const std::vector<std::string>& expectedValue, const nsecs_t timeoutNs);
     bool fileExists(const std::string& file) {
         struct stat sb;
         return stat(file.c_str(), &sb) == 0;
@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+#define LOG_TAG "hwc-buffer-dumper"
+
+#include "BufferDumper.h"
+
+#include <errno.h>
+#include <log/log.h>
+#include <png.h>
+#include <pthread.h>
+#include <string.h>
+#include <sync/sync.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <utils/Trace.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint32_t kBytesPerPixel = 4;
+// Words of each plane that recordChecksum() samples
+constexpr size_t kChecksumSamples = 4096;
+
+bool isRgb(BufferDumper::Layout layout) {
+    return layout != BufferDumper::Layout::OPAQUE;
+}
+
+const char* getExtensionOf(BufferDumper::Layout layout, BufferDumper::Compression compression) {
+    switch (compression) {
+        case BufferDumper::Compression::PNG:
+            if (isRgb(layout)) return ".png";
+            [[fallthrough]];
+        case BufferDumper::Compression::GZIP:
+            return ".raw.gz";
+        case BufferDumper::Compression::NONE:
+        default:
+            return ".raw";
+    }
+}
+
+// Contents of a buffer, mapped or copied
+class BufferView {
+public:
+    explicit BufferView(const BufferDumper::Buffer& buffer) {
+        if (!buffer.data.empty()) {
+            mChunks.emplace_back(buffer.data.data(), buffer.data.size());
+            return;
+        }
+        for (const auto& plane : buffer.planes) {
+            void* addr = mmap(0, plane.size, PROT_READ, MAP_SHARED, plane.fd.get(), 0);
+            if (addr == MAP_FAILED || addr == NULL) {
+                ALOGE("%s: failed to mmap fd %d of %s (%s)", __func__, plane.fd.get(),
+                      buffer.path.c_str(), strerror(errno));
+                mFailed = true;
+                continue;
+            }
+            mMapped.emplace_back(addr, plane.size);
+            mChunks.emplace_back(static_cast<const uint8_t*>(addr), plane.size);
+        }
+    }
+
+    ~BufferView() {
+        for (const auto& [addr, size] : mMapped) munmap(addr, size);
+    }
+
+    bool failed() const { return mFailed || mChunks.empty(); }
+    const std::vector<std::pair<const uint8_t*, size_t>>& chunks() const { return mChunks; }
+
+private:
+    std::vector<std::pair<void*, size_t>> mMapped;
+    std::vector<std::pair<const uint8_t*, size_t>> mChunks;
+    bool mFailed = false;
+};
+
+/*
+ * FNV-1a over evenly spaced words of the chunks. A buffer rendered again
+ * changes most of its pixels, so a sample is enough to notice it.
+ */
+uint64_t sampleChecksum(const std::vector<std::pair<const uint8_t*, size_t>>& chunks) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const auto& [data, size] : chunks) {
+        const size_t words = size / sizeof(uint64_t);
+        const size_t step = std::max<size_t>(words / kChecksumSamples, 1);
+        for (size_t i = 0; i < words; i += step) {
+            uint64_t word;
+            memcpy(&word, data + i * sizeof(uint64_t), sizeof(word));
+            hash = (hash ^ word) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+/*
+ * Calls emit() with the rows of the RGB buffer that downsampling keeps, with
+ * one of scale pixels of each. Returns false if the buffer is too small.
+ */
+template <typename Emit>
+bool forEachRow(const BufferDumper::Buffer& buffer, const uint8_t* base, size_t size,
+                uint32_t scale, Emit emit) {
+    const size_t strideBytes = static_cast<size_t>(buffer.stride) * kBytesPerPixel;
+    if (buffer.height == 0 || buffer.width > buffer.stride ||
+        strideBytes * (buffer.height - 1) + buffer.width * kBytesPerPixel > size) {
+        ALOGE("%s: %ux%u (stride %u) does not fit in %zu bytes of %s", __func__, buffer.width,
+              buffer.height, buffer.stride, size, buffer.path.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> row((buffer.width / scale) * kBytesPerPixel);
+    for (uint32_t y = 0; y + scale <= buffer.height; y += scale) {
+        const uint8_t* src = base + y * strideBytes;
+        if (scale == 1) {
+            emit(src);
+            continue;
+        }
+        for (uint32_t x = 0; x < buffer.width / scale; x++)
+            memcpy(&row[x * kBytesPerPixel], src + x * scale * kBytesPerPixel, kBytesPerPixel);
+        emit(row.data());
+    }
+    return true;
+}
+
+bool writePng(const BufferDumper::Buffer& buffer, const uint8_t* base, size_t size,
+              uint32_t scale, const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (fp == NULL) {
+        ALOGE("%s: failed to open file %s", __func__, path.c_str());
+        return false;
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png ? png_create_info_struct(png) : NULL;
+    if (info == NULL) {
+        ALOGE("%s: failed to create png structs", __func__);
+        png_destroy_write_struct(&png, NULL);
+        fclose(fp);
+        return false;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+        ALOGE("%s: failed to write %s", __func__, path.c_str());
+        png_destroy_write_struct(&png, &info);
+        fclose(fp);
+        return false;
+    }
+
+    png_init_io(png, fp);
+    // Speed over size, the worker has more frames to write
+    png_set_compression_level(png, 1);
+    png_set_filter(png, 0, PNG_FILTER_SUB);
+    const bool opaque = buffer.layout == BufferDumper::Layout::RGBX_8888;
+    png_set_IHDR(png, info, buffer.width / scale, buffer.height / scale, 8,
+                 opaque ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    if (opaque) png_set_filler(png, 0, PNG_FILLER_AFTER);
+    if (buffer.layout == BufferDumper::Layout::BGRA_8888) png_set_bgr(png);
+
+    bool ret = forEachRow(buffer, base, size, scale, [png](const uint8_t* row) {
+        png_write_row(png, const_cast<png_bytep>(row));
+    });
+    if (ret) png_write_end(png, NULL);
+
+    png_destroy_write_struct(&png, &info);
+    fclose(fp);
+    return ret;
+}
+
+// Writes the rows or chunks through write(), into a plain or a gzip file
+class RawFile {
+public:
+    RawFile(const std::string& path, bool gzip) : mGzip(gzip) {
+        if (gzip) {
+            // Level 1, as for the PNGs
+            mGzFile = gzopen(path.c_str(), "wb1");
+        } else {
+            mFile = fopen(path.c_str(), "wb");
+        }
+        if (!isOpen()) ALOGE("%s: failed to open file %s", __func__, path.c_str());
+    }
+
+    ~RawFile() {
+        if (mGzFile) gzclose(mGzFile);
+        if (mFile) fclose(mFile);
+    }
+
+    bool isOpen() const { return mGzip ? mGzFile != NULL : mFile != NULL; }
+
+    bool write(const uint8_t* data, size_t size) {
+        while (mGzip && size > 0) {
+            // gzwrite() takes an unsigned int
+            const unsigned int chunk = static_cast<unsigned int>(std::min<size_t>(size, 1 << 30));
+            if (gzwrite(mGzFile, data, chunk) != static_cast<int>(chunk)) return false;
+            data += chunk;
+            size -= chunk;
+        }
+        return mGzip || fwrite(data, 1, size, mFile) == size;
+    }
+
+private:
+    const bool mGzip;
+    gzFile mGzFile = NULL;
+    FILE* mFile = NULL;
+};
+
+size_t fileSize(const std::string& path) {
+    struct stat st;
+    return (stat(path.c_str(), &st) == 0) ? st.st_size : 0;
+}
+
+} // namespace
+
+size_t BufferDumper::Buffer::bytes() const {
+    size_t size = data.size();
+    for (const auto& plane : planes) size += plane.size;
+    return size;
+}
+
+size_t BufferDumper::Job::bytes() const {
+    size_t size = 0;
+    for (const auto& buffer : buffers) size += buffer.bytes();
+    for (const auto& [path, text] : texts) size += text.size();
+    return size;
+}
+
+BufferDumper& BufferDumper::getInstance() {
+    // Never destroyed, dumps may be pending when the process exits
+    static BufferDumper* dumper = new BufferDumper();
+    return *dumper;
+}
+
+bool BufferDumper::copyContents(Buffer& buffer) {
+    ATRACE_NAME(buffer.path.c_str());
+    if (!buffer.data.empty()) return true;
+
+    // Copied anyway on timeout, it may be what went wrong
+    if (buffer.acquireFence.get() >= 0 && sync_wait(buffer.acquireFence.get(), kFenceTimeoutMs))
+        ALOGE("%s: failed to wait fence %d of %s, errno=(%d, %s)", __func__,
+              buffer.acquireFence.get(), buffer.path.c_str(), errno, strerror(errno));
+
+    std::vector<uint8_t> data;
+    {
+        BufferView view(buffer);
+        if (view.failed()) return false;
+        data.reserve(buffer.bytes());
+        for (const auto& [chunk, size] : view.chunks()) data.insert(data.end(), chunk, chunk + size);
+    }
+
+    buffer.data = std::move(data);
+    buffer.planes.clear();
+    buffer.acquireFence.Set(-1);
+    buffer.releaseFence.Set(-1);
+    buffer.checksum.reset();
+    return true;
+}
+
+void BufferDumper::recordChecksum(Buffer& buffer) {
+    if (!buffer.data.empty()) return;
+    if (buffer.acquireFence.get() >= 0 && sync_wait(buffer.acquireFence.get(), 0)) return;
+
+    BufferView view(buffer);
+    if (!view.failed()) buffer.checksum = sampleChecksum(view.chunks());
+}
+
+BufferDumper::BufferDumper() {}
+
+BufferDumper::~BufferDumper() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void BufferDumper::setConfig(const Config& config) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mConfig = config;
+    mConfig.maxJobs = std::max<size_t>(mConfig.maxJobs, 1);
+    mConfig.downsample = std::max<uint32_t>(mConfig.downsample, 1);
+}
+
+BufferDumper::Config BufferDumper::getConfig() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mConfig;
+}
+
+std::string BufferDumper::getExtension(const Buffer& buffer) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return getExtensionOf(buffer.layout, mConfig.compression);
+}
+
+uint32_t BufferDumper::getDownsample(const Buffer& buffer) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return isRgb(buffer.layout) ? mConfig.downsample : 1;
+}
+
+bool BufferDumper::submit(Job&& job) {
+    ATRACE_CALL();
+    const size_t bytes = job.bytes();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.submitted++;
+        // A job larger than the budget still goes if nothing else is queued
+        if (mJobs.size() >= mConfig.maxJobs ||
+            (mQueuedBytes > 0 && mQueuedBytes + bytes > mConfig.byteBudget)) {
+            mStats.rejected++;
+            ALOGW("%s: dropping a dump of %zu bytes, %zu jobs and %zu bytes queued", __func__,
+                  bytes, mJobs.size(), mQueuedBytes);
+            return false;
+        }
+        mJobs.push_back(std::move(job));
+        mQueuedBytes += bytes;
+        mStats.maxQueuedBytes = std::max(mStats.maxQueuedBytes, mQueuedBytes);
+        if (!mThread.joinable()) {
+            ALOGI("Creating buffer dump thread");
+            mThread = std::thread(&BufferDumper::threadLoop, this);
+            pthread_setname_np(mThread.native_handle(), "HwcBufferDump");
+        }
+    }
+    mCondition.notify_one();
+    return true;
+}
+
+void BufferDumper::sync() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdleCondition.wait(lock, [this] { return mExit || (mJobs.empty() && !mBusy); });
+}
+
+BufferDumper::Stats BufferDumper::getStats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+void BufferDumper::threadLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] { return mExit || !mJobs.empty(); });
+        if (mExit) break;
+
+        Job job = std::move(mJobs.front());
+        mJobs.pop_front();
+        const Config config = mConfig;
+        mBusy = true;
+
+        lock.unlock();
+        processJob(job, config);
+        const size_t bytes = job.bytes();
+        // Closes the fds, which lets the buffers go
+        job = Job();
+        lock.lock();
+
+        mQueuedBytes -= bytes;
+        mBusy = false;
+        mStats.written++;
+        if (mJobs.empty()) mIdleCondition.notify_all();
+    }
+    mIdleCondition.notify_all();
+}
+
+void BufferDumper::processJob(const Job& job, const Config& config) {
+    ATRACE_CALL();
+    for (const auto& [path, text] : job.texts) {
+        FILE* fp = fopen(path.c_str(), "w");
+        if (fp == NULL) {
+            ALOGE("%s: failed to open file %s", __func__, path.c_str());
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStats.errors++;
+            continue;
+        }
+        fwrite(text.data(), 1, text.size(), fp);
+        fclose(fp);
+    }
+
+    for (const auto& buffer : job.buffers) {
+        const bool ret = writeBuffer(buffer, config);
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.buffers++;
+        if (!ret) mStats.errors++;
+    }
+}
+
+bool BufferDumper::waitFence(const android::UniqueFd& fence, const std::string& path) {
+    if (fence.get() < 0 || sync_wait(fence.get(), kFenceTimeoutMs) == 0) return true;
+
+    // The buffer is dumped anyway, it may be what went wrong
+    ALOGE("%s: failed to wait fence %d of %s, errno=(%d, %s)", __func__, fence.get(),
+          path.c_str(), errno, strerror(errno));
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.fenceTimeouts++;
+    return false;
+}
+
+void BufferDumper::checkContents(const Buffer& buffer, uint64_t checksum) {
+    // Copies cannot change
+    if (!buffer.data.empty()) return;
+
+    if (!buffer.checksum) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.unverified++;
+        return;
+    }
+    if (*buffer.checksum == checksum) return;
+
+    ALOGW("%s: %s changed since the frame was dumped", __func__, buffer.path.c_str());
+    if (!buffer.infoPath.empty()) {
+        FILE* fp = fopen(buffer.infoPath.c_str(), "a");
+        if (fp != NULL) {
+            fprintf(fp,
+                    "WARNING: the buffer was rendered again before it was written, "
+                    "its file holds a later frame than this dump describes\n");
+            fclose(fp);
+        }
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.stale++;
+}
+
+bool BufferDumper::writeBuffer(const Buffer& buffer, const Config& config) {
+    ATRACE_NAME(buffer.path.c_str());
+    waitFence(buffer.acquireFence, buffer.path);
+    waitFence(buffer.releaseFence, buffer.path);
+
+    BufferView view(buffer);
+    if (view.failed()) return false;
+    checkContents(buffer, sampleChecksum(view.chunks()));
+
+    const bool png = isRgb(buffer.layout) && config.compression == Compression::PNG;
+    const std::string path = buffer.path + getExtensionOf(buffer.layout, config.compression);
+    const uint32_t scale = isRgb(buffer.layout) ? config.downsample : 1;
+    const auto& [base, size] = view.chunks().front();
+
+    bool ret = true;
+    if (png) {
+        ret = writePng(buffer, base, size, scale, path);
+    } else {
+        RawFile file(path, config.compression != Compression::NONE);
+        if (!file.isOpen()) return false;
+        if (scale > 1) {
+            // The first plane only, RGB buffers have no other
+            bool written = true;
+            ret = forEachRow(buffer, base, size, scale, [&](const uint8_t* row) {
+                written = file.write(row, (buffer.width / scale) * kBytesPerPixel) && written;
+            }) && written;
+        } else {
+            for (const auto& [data, chunkSize] : view.chunks())
+                ret = file.write(data, chunkSize) && ret;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.bytesIn += buffer.bytes();
+    mStats.bytesOut += fileSize(path);
+    return ret;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BUFFER_DUMPER_H_
+#define _BUFFER_DUMPER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "autofd.h"
+
+/*
+ * Writes buffer dumps from a worker thread.
+ *
+ * The composition thread only takes a snapshot of a frame: it duplicates the
+ * dma-buf and fence fds of the buffers and formats the text files. The worker
+ * waits for the fences, maps the buffers and writes them, compressed and
+ * downsampled if configured.
+ *
+ * The duplicated fds keep the buffers alive until they are written, so the
+ * queued jobs are bounded both in number and in the bytes of buffer they hold.
+ * A job over either bound is dropped as a whole and counted.
+ *
+ * A duplicated fd keeps the memory of a buffer, not its contents. Buffers the
+ * caller reuses right after the frame are copied with copyContents() instead.
+ * For the others, recordChecksum() samples the contents at snapshot time and
+ * the worker flags the buffer in its info file if they changed before it was
+ * written.
+ */
+class BufferDumper {
+public:
+    enum class Compression {
+        NONE,
+        // .gz of the raw planes
+        GZIP,
+        // PNG for the uncompressed 8-bit RGB buffers, GZIP for the others
+        PNG,
+    };
+
+    struct Config {
+        size_t maxJobs = 4;
+        size_t byteBudget = 256 * 1024 * 1024;
+        Compression compression = Compression::NONE;
+        // Keeps one of downsample pixels and rows of the 8-bit RGB buffers
+        uint32_t downsample = 1;
+    };
+
+    // How the worker may look at the pixels, OPAQUE buffers are written as they are
+    enum class Layout { OPAQUE, RGBA_8888, RGBX_8888, BGRA_8888 };
+
+    struct Plane {
+        android::UniqueFd fd;
+        size_t size = 0;
+    };
+
+    struct Buffer {
+        // Without the extension, see getExtension()
+        std::string path;
+        Layout layout = Layout::OPAQUE;
+        // In pixels, for the RGB layouts
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t stride = 0;
+        // Duplicated dma-buf fds of the planes
+        std::vector<Plane> planes;
+        // Or a copy of the contents, for buffers reused as soon as they are read
+        std::vector<uint8_t> data;
+        android::UniqueFd acquireFence;
+        android::UniqueFd releaseFence;
+        // Sampled contents at snapshot time, see recordChecksum()
+        std::optional<uint64_t> checksum;
+        // Where the worker notes that the contents changed since the snapshot
+        std::string infoPath;
+
+        size_t bytes() const;
+    };
+
+    struct Job {
+        // Path and content of the text files
+        std::vector<std::pair<std::string, std::string>> texts;
+        std::vector<Buffer> buffers;
+
+        size_t bytes() const;
+    };
+
+    struct Stats {
+        uint64_t submitted = 0;
+        // Jobs dropped because the queue or the byte budget was full
+        uint64_t rejected = 0;
+        uint64_t written = 0;
+        uint64_t buffers = 0;
+        // Bytes read from the buffers and written to the files
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t fenceTimeouts = 0;
+        // Buffers written with other contents than at snapshot time
+        uint64_t stale = 0;
+        // Mapped buffers whose contents were not ready to be sampled at snapshot time
+        uint64_t unverified = 0;
+        uint64_t errors = 0;
+        size_t maxQueuedBytes = 0;
+    };
+
+    static BufferDumper& getInstance();
+
+    // Waits the acquire fence and copies the planes into data, dropping the fds
+    static bool copyContents(Buffer& buffer);
+    // Samples the contents if the acquire fence has signaled, without waiting
+    static void recordChecksum(Buffer& buffer);
+
+    BufferDumper();
+    ~BufferDumper();
+
+    void setConfig(const Config& config);
+    Config getConfig() const;
+    // ".raw", ".raw.gz" or ".png", depending on the config and the buffer layout
+    std::string getExtension(const Buffer& buffer) const;
+    // Factor the width and height of the written buffer are divided by
+    uint32_t getDownsample(const Buffer& buffer) const;
+
+    // Returns false if the job was dropped
+    bool submit(Job&& job);
+    // Waits until the jobs submitted so far are written
+    void sync();
+    Stats getStats() const;
+
+private:
+    static constexpr int kFenceTimeoutMs = 1000;
+
+    void threadLoop();
+    void processJob(const Job& job, const Config& config);
+    bool writeBuffer(const Buffer& buffer, const Config& config);
+    bool waitFence(const android::UniqueFd& fence, const std::string& path);
+    void checkContents(const Buffer& buffer, uint64_t checksum);
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::condition_variable mIdleCondition;
+    std::thread mThread;
+    bool mExit = false;
+    bool mBusy = false;
+
+    Config mConfig;
+    std::deque<Job> mJobs;
+    size_t mQueuedBytes = 0;
+    Stats mStats;
+};
+
+#endif // _BUFFER_DUMPER_H_
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "BufferDumper.h"
+
+namespace {
+
+// Full screen RGBA layers of a busy frame
+constexpr int kLayers = 4;
+constexpr uint32_t kWidth = 1080;
+constexpr uint32_t kHeight = 2400;
+constexpr size_t kBufferSize = kWidth * kHeight * 4;
+
+std::string& dumpDir() {
+    static std::string dir = [] {
+        char tmpl[] = "/data/local/tmp/hwcdump_XXXXXX";
+        const char* dir = mkdtemp(tmpl);
+        return std::string(dir ? dir : "/tmp");
+    }();
+    return dir;
+}
+
+// memfds standing in for the dma-bufs of the layers, with some gradient in them
+std::vector<android::UniqueFd>& layerFds() {
+    static std::vector<android::UniqueFd> fds = [] {
+        std::vector<android::UniqueFd> fds;
+        std::vector<uint8_t> pixels(kBufferSize);
+        for (size_t i = 0; i < pixels.size(); i++) pixels[i] = (i / 4) % kWidth;
+        for (int i = 0; i < kLayers; i++) {
+            android::UniqueFd fd(memfd_create("layer", 0));
+            if (fd.get() < 0 || write(fd.get(), pixels.data(), pixels.size()) < 0) abort();
+            fds.push_back(std::move(fd));
+        }
+        return fds;
+    }();
+    return fds;
+}
+
+BufferDumper::Job snapshot(int frame) {
+    BufferDumper::Job job;
+    job.texts.emplace_back(dumpDir() + "/" + std::to_string(frame) + "-display-info.txt",
+                           std::string(4096, 'x'));
+    for (int i = 0; i < kLayers; i++) {
+        BufferDumper::Buffer buffer;
+        buffer.path = dumpDir() + "/" + std::to_string(frame) + "-" + std::to_string(i) + "-src";
+        buffer.layout = BufferDumper::Layout::RGBA_8888;
+        buffer.width = kWidth;
+        buffer.height = kHeight;
+        buffer.stride = kWidth;
+        BufferDumper::Plane plane;
+        plane.fd.Set(dup(layerFds()[i].get()));
+        plane.size = kBufferSize;
+        buffer.planes.push_back(std::move(plane));
+        job.buffers.push_back(std::move(buffer));
+    }
+    return job;
+}
+
+// A frame with dumping off, only what the composition thread looks at
+void BM_DumpOff(benchmark::State& state) {
+    for (auto _ : state) {
+        for (int i = 0; i < kLayers; i++) benchmark::DoNotOptimize(layerFds()[i].get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// What dumpAllBuffers() did: map and write every layer on the composition thread
+void BM_SyncDump(benchmark::State& state) {
+    int frame = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < kLayers; i++) {
+            const std::string path = dumpDir() + "/sync-" + std::to_string(frame) + "-" +
+                    std::to_string(i) + ".raw";
+            FILE* fp = fopen(path.c_str(), "wb");
+            void* addr = mmap(0, kBufferSize, PROT_READ, MAP_SHARED, layerFds()[i].get(), 0);
+            if (fp == nullptr || addr == MAP_FAILED) {
+                state.SkipWithError("failed to dump");
+                break;
+            }
+            fwrite(addr, 1, kBufferSize, fp);
+            munmap(addr, kBufferSize);
+            fclose(fp);
+        }
+        frame = (frame + 1) % 8;
+    }
+    state.SetBytesProcessed(state.iterations() * kLayers * kBufferSize);
+}
+
+// What it does now: duplicate the fds and queue the frame
+void BM_AsyncDump_Submit(benchmark::State& state) {
+    BufferDumper dumper;
+    int frame = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(dumper.submit(snapshot(frame)));
+        // Keep the queue from filling so that the cost is that of a kept frame
+        state.PauseTiming();
+        dumper.sync();
+        state.ResumeTiming();
+        frame = (frame + 1) % 8;
+    }
+    state.counters["rejected"] = dumper.getStats().rejected;
+}
+
+// Frames the worker writes per second, for each Compression
+void BM_AsyncDump_Worker(benchmark::State& state) {
+    BufferDumper dumper;
+    BufferDumper::Config config;
+    config.compression = static_cast<BufferDumper::Compression>(state.range(0));
+    config.downsample = state.range(1);
+    dumper.setConfig(config);
+    int frame = 0;
+    for (auto _ : state) {
+        dumper.submit(snapshot(frame));
+        dumper.sync();
+        frame = (frame + 1) % 8;
+    }
+    const auto stats = dumper.getStats();
+    state.counters["ratio"] = stats.bytesIn ? double(stats.bytesOut) / stats.bytesIn : 0;
+    state.SetBytesProcessed(state.iterations() * kLayers * kBufferSize);
+}
+
+BENCHMARK(BM_DumpOff);
+BENCHMARK(BM_SyncDump)->Unit(benchmark::kMillisecond);
+// The writes of the paused syncs are not counted, bound the iterations instead
+BENCHMARK(BM_AsyncDump_Submit)->Iterations(32)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_AsyncDump_Worker)
+        ->Args({static_cast<int>(BufferDumper::Compression::NONE), 1})
+        ->Args({static_cast<int>(BufferDumper::Compression::GZIP), 1})
+        ->Args({static_cast<int>(BufferDumper::Compression::PNG), 1})
+        ->Args({static_cast<int>(BufferDumper::Compression::PNG), 2})
+        ->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DamageTracker.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr size_t kBitsPerWord = 64;
+/* Above this the runs of a row are merged before the pairwise search */
+constexpr size_t kMaxMergeRects = 64;
+
+int32_t roundUp(int32_t value, int32_t align) {
+    return ((value + align - 1) / align) * align;
+}
+
+DamageTracker::Rect bounds(const DamageTracker::Rect &a, const DamageTracker::Rect &b) {
+    return {std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right),
+            std::max(a.bottom, b.bottom)};
+}
+
+bool contains(const DamageTracker::Rect &outer, const DamageTracker::Rect &inner) {
+    return (outer.left <= inner.left) && (outer.top <= inner.top) &&
+            (outer.right >= inner.right) && (outer.bottom >= inner.bottom);
+}
+
+} // namespace
+
+void DamageTracker::configure(const Config &config) {
+    if ((config == mConfig) && !mTiles.empty()) return;
+
+    mConfig = config;
+    mConfig.alignX = std::max(mConfig.alignX, 1);
+    mConfig.alignY = std::max(mConfig.alignY, 1);
+    mConfig.tileWidth = roundUp(std::max(mConfig.tileWidth, 1), mConfig.alignX);
+    mConfig.tileHeight = roundUp(std::max(mConfig.tileHeight, 1), mConfig.alignY);
+    mConfig.maxRects = std::max(mConfig.maxRects, 1u);
+
+    mCols = std::max((mConfig.width + mConfig.tileWidth - 1) / mConfig.tileWidth, 1);
+    mRows = std::max((mConfig.height + mConfig.tileHeight - 1) / mConfig.tileHeight, 1);
+    mWordsPerRow = (mCols + kBitsPerWord - 1) / kBitsPerWord;
+    mTiles.assign(mWordsPerRow * mRows, 0);
+    mCarried.assign(mWordsPerRow * mRows, 0);
+    mFull = mCarriedFull = true;
+    mDamagedRows = mCarriedRows = RowRange();
+}
+
+void DamageTracker::clearRows(std::vector<uint64_t> &tiles, const RowRange &rows) const {
+    if (rows.empty()) return;
+    std::fill(tiles.begin() + rows.top * mWordsPerRow, tiles.begin() + rows.bottom * mWordsPerRow,
+              0);
+}
+
+void DamageTracker::copyRows(std::vector<uint64_t> &dst, const std::vector<uint64_t> &src,
+                             const RowRange &rows) const {
+    if (rows.empty()) return;
+    std::copy(src.begin() + rows.top * mWordsPerRow, src.begin() + rows.bottom * mWordsPerRow,
+              dst.begin() + rows.top * mWordsPerRow);
+}
+
+void DamageTracker::beginFrame() {
+    clearRows(mTiles, mDamagedRows);
+    copyRows(mTiles, mCarried, mCarriedRows);
+    mDamagedRows = mCarriedRows;
+    mFull = mCarriedFull;
+}
+
+void DamageTracker::setTiles(int32_t row, int32_t firstCol, int32_t lastCol) {
+    uint64_t *words = &mTiles[row * mWordsPerRow];
+    for (int32_t col = firstCol; col <= lastCol;) {
+        size_t word = col / kBitsPerWord;
+        size_t bit = col % kBitsPerWord;
+        size_t count = std::min<size_t>(kBitsPerWord - bit, lastCol - col + 1);
+        uint64_t mask = (count == kBitsPerWord) ? ~0ULL : (((1ULL << count) - 1) << bit);
+        words[word] |= mask;
+        col += count;
+    }
+}
+
+void DamageTracker::addDamage(const Rect &rect) {
+    int32_t left = std::max(rect.left, 0);
+    int32_t top = std::max(rect.top, 0);
+    int32_t right = std::min(rect.right, mConfig.width);
+    int32_t bottom = std::min(rect.bottom, mConfig.height);
+    if ((left >= right) || (top >= bottom) || mTiles.empty()) return;
+
+    int32_t firstCol = left / mConfig.tileWidth;
+    int32_t lastCol = (right - 1) / mConfig.tileWidth;
+    int32_t firstRow = top / mConfig.tileHeight;
+    int32_t lastRow = (bottom - 1) / mConfig.tileHeight;
+    for (int32_t row = firstRow; row <= lastRow; row++)
+        setTiles(row, firstCol, lastCol);
+
+    if (mDamagedRows.empty()) {
+        mDamagedRows = {firstRow, lastRow + 1};
+    } else {
+        mDamagedRows.top = std::min(mDamagedRows.top, firstRow);
+        mDamagedRows.bottom = std::max(mDamagedRows.bottom, lastRow + 1);
+    }
+}
+
+DamageTracker::Rect DamageTracker::tileRect(int32_t firstCol, int32_t firstRow, int32_t lastCol,
+                                            int32_t lastRow) const {
+    return {firstCol * mConfig.tileWidth, firstRow * mConfig.tileHeight,
+            std::min((lastCol + 1) * mConfig.tileWidth, mConfig.width),
+            std::min((lastRow + 1) * mConfig.tileHeight, mConfig.height)};
+}
+
+/*
+ * Exact cover in tile units: the runs of damaged tiles in every row, where a
+ * run with the same columns as one in the row above extends it.
+ */
+void DamageTracker::findRuns(std::vector<Rect> &outRects) const {
+    std::vector<Rect> open;
+    std::vector<Rect> next;
+    for (int32_t row = mDamagedRows.top; row < mDamagedRows.bottom; row++) {
+        const uint64_t *words = &mTiles[row * mWordsPerRow];
+        next.clear();
+        int32_t col = 0;
+        while (col < mCols) {
+            uint64_t word = words[col / kBitsPerWord] >> (col % kBitsPerWord);
+            if (word == 0) {
+                col = (col / kBitsPerWord + 1) * kBitsPerWord;
+                continue;
+            }
+            col += __builtin_ctzll(word);
+            if (col >= mCols) break;
+            int32_t first = col;
+            while ((col < mCols) && ((words[col / kBitsPerWord] >> (col % kBitsPerWord)) & 1))
+                col++;
+
+            Rect run = {first, row, col, row + 1};
+            auto it = std::find_if(open.begin(), open.end(), [&](const Rect &rect) {
+                return (rect.left == run.left) && (rect.right == run.right);
+            });
+            if (it != open.end()) {
+                run.top = it->top;
+                open.erase(it);
+            }
+            next.push_back(run);
+        }
+        outRects.insert(outRects.end(), open.begin(), open.end());
+        open.swap(next);
+    }
+    outRects.insert(outRects.end(), open.begin(), open.end());
+}
+
+/*
+ * Greedy cover with at most maxRects rects: keep merging the pair whose
+ * bounds add the least area. Each merged rect swallows the ones it contains.
+ */
+void DamageTracker::mergeRects(std::vector<Rect> &rects) const {
+    if (rects.size() > kMaxMergeRects) {
+        /* One span per row is always a cover, and far fewer candidates */
+        std::vector<Rect> rows;
+        for (const auto &rect : rects) {
+            for (int32_t row = rect.top; row < rect.bottom; row++) {
+                Rect span = {rect.left, row, rect.right, row + 1};
+                auto it = std::find_if(rows.begin(), rows.end(),
+                                       [row](const Rect &r) { return r.top == row; });
+                if (it == rows.end())
+                    rows.push_back(span);
+                else
+                    *it = bounds(*it, span);
+            }
+        }
+        std::sort(rows.begin(), rows.end(),
+                  [](const Rect &a, const Rect &b) { return a.top < b.top; });
+        rects.clear();
+        for (const auto &span : rows) {
+            if (!rects.empty() && (rects.back().bottom == span.top) &&
+                (rects.back().left == span.left) && (rects.back().right == span.right))
+                rects.back().bottom = span.bottom;
+            else
+                rects.push_back(span);
+        }
+    }
+
+    while (rects.size() > mConfig.maxRects) {
+        size_t bestA = 0, bestB = 1;
+        int64_t bestCost = INT64_MAX;
+        for (size_t a = 0; a < rects.size(); a++) {
+            for (size_t b = a + 1; b < rects.size(); b++) {
+                int64_t cost = bounds(rects[a], rects[b]).area() - rects[a].area() -
+                        rects[b].area();
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+        Rect merged = bounds(rects[bestA], rects[bestB]);
+        rects.erase(std::remove_if(rects.begin(), rects.end(),
+                                   [&](const Rect &rect) { return contains(merged, rect); }),
+                    rects.end());
+        rects.push_back(merged);
+    }
+}
+
+bool DamageTracker::compute(std::vector<Rect> &outRects) {
+    outRects.clear();
+    mFrameCount++;
+    if (mFull || mTiles.empty()) return false;
+    if (mDamagedRows.empty()) return true;
+
+    std::vector<Rect> tiles;
+    if (mConfig.maxRects == 1) {
+        /* The bounds of the damaged tiles are the smallest single cover */
+        Rect bound = {mCols, mRows, 0, 0};
+        for (int32_t row = mDamagedRows.top; row < mDamagedRows.bottom; row++) {
+            const uint64_t *words = &mTiles[row * mWordsPerRow];
+            for (size_t w = 0; w < mWordsPerRow; w++) {
+                if (words[w] == 0) continue;
+                int32_t first = w * kBitsPerWord + __builtin_ctzll(words[w]);
+                bound.left = std::min(bound.left, first);
+                bound.top = std::min(bound.top, row);
+                bound.bottom = row + 1;
+                break;
+            }
+            for (size_t w = mWordsPerRow; w > 0; w--) {
+                if (words[w - 1] == 0) continue;
+                int32_t last = (w - 1) * kBitsPerWord + (kBitsPerWord - 1) -
+                        __builtin_clzll(words[w - 1]);
+                bound.right = std::max(bound.right, last + 1);
+                break;
+            }
+        }
+        if (bound.right > 0) tiles.push_back(bound);
+    } else {
+        findRuns(tiles);
+        mergeRects(tiles);
+    }
+
+    int64_t area = 0;
+    for (const auto &tile : tiles) {
+        outRects.push_back(tileRect(tile.left, tile.top, tile.right - 1, tile.bottom - 1));
+        area += outRects.back().area();
+    }
+    if (!outRects.empty()) {
+        mPartialCount++;
+        mPartialPermille += area * 1000 / (static_cast<int64_t>(mConfig.width) * mConfig.height);
+    }
+    return true;
+}
+
+void DamageTracker::endFrame(bool presented) {
+    clearRows(mCarried, mCarriedRows);
+    if (presented) {
+        mCarriedRows = RowRange();
+        mCarriedFull = false;
+        return;
+    }
+    copyRows(mCarried, mTiles, mDamagedRows);
+    mCarriedRows = mDamagedRows;
+    mCarriedFull = mFull;
+    mCarriedCount++;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _DAMAGE_TRACKER_H_
+#define _DAMAGE_TRACKER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/*
+ * Damage of a display frame in a coarse tile bitmap.
+ *
+ * Every damage rect marks the tiles it touches. Tiles are the update
+ * alignment of the panel, or a multiple of it, so any rect built from whole
+ * tiles is a valid partial region. Only the rows that hold damage are
+ * cleared and scanned, so small tiles cost little for small updates.
+ * compute() turns the bitmap into at most maxRects rects that cover all
+ * damaged tiles with the smallest area it finds.
+ *
+ * The damage of a frame that did not reach the panel is carried into the
+ * next frame, otherwise the regions it updated would stay stale.
+ */
+class DamageTracker {
+public:
+    struct Rect {
+        int32_t left;
+        int32_t top;
+        int32_t right;
+        int32_t bottom;
+
+        int64_t area() const { return static_cast<int64_t>(right - left) * (bottom - top); }
+    };
+
+    struct Config {
+        int32_t width = 0;
+        int32_t height = 0;
+        /* Update alignment of the panel, for example the DSC slice size */
+        int32_t alignX = 1;
+        int32_t alignY = 1;
+        /* Rounded up to a multiple of the alignment, 0 for the alignment itself */
+        int32_t tileWidth = 0;
+        int32_t tileHeight = 0;
+        /* Partial regions the DPU can take in one commit */
+        uint32_t maxRects = 1;
+
+        bool operator==(const Config &other) const {
+            return width == other.width && height == other.height && alignX == other.alignX &&
+                    alignY == other.alignY && tileWidth == other.tileWidth &&
+                    tileHeight == other.tileHeight && maxRects == other.maxRects;
+        }
+    };
+
+    /* Resets all damage, including the carried one, if the config changed */
+    void configure(const Config &config);
+    const Config &getConfig() const { return mConfig; }
+
+    /* Starts the damage of a frame from what earlier frames carried over */
+    void beginFrame();
+    void addDamage(const Rect &rect);
+    void addFull() { mFull = true; }
+    bool isFull() const { return mFull; }
+    /*
+     * Covers the damage with at most maxRects aligned rects. Returns false if
+     * the whole panel has to be updated. outRects is empty if nothing is
+     * damaged.
+     */
+    bool compute(std::vector<Rect> &outRects);
+    /* Keeps the damage of the frame for the next one if it was not presented */
+    void endFrame(bool presented);
+    /* The next frame updates the whole panel */
+    void invalidate() { mCarriedFull = true; }
+
+    uint64_t getFrameCount() const { return mFrameCount; }
+    uint64_t getPartialCount() const { return mPartialCount; }
+    uint64_t getCarriedCount() const { return mCarriedCount; }
+    /* Sum of the updated area over all partial frames, in panel permille */
+    uint64_t getPartialPermille() const { return mPartialPermille; }
+
+private:
+    /* Rows [top, bottom) of a bitmap that may hold damage */
+    struct RowRange {
+        int32_t top = 0;
+        int32_t bottom = 0;
+
+        bool empty() const { return top >= bottom; }
+    };
+
+    void clearRows(std::vector<uint64_t> &tiles, const RowRange &rows) const;
+    void copyRows(std::vector<uint64_t> &dst, const std::vector<uint64_t> &src,
+                  const RowRange &rows) const;
+    void setTiles(int32_t row, int32_t firstCol, int32_t lastCol);
+    Rect tileRect(int32_t firstCol, int32_t firstRow, int32_t lastCol, int32_t lastRow) const;
+    void findRuns(std::vector<Rect> &outRects) const;
+    void mergeRects(std::vector<Rect> &rects) const;
+
+    Config mConfig;
+    int32_t mCols = 0;
+    int32_t mRows = 0;
+    size_t mWordsPerRow = 0;
+
+    /* One bit per tile, rows of mWordsPerRow words */
+    std::vector<uint64_t> mTiles;
+    std::vector<uint64_t> mCarried;
+    RowRange mDamagedRows;
+    RowRange mCarriedRows;
+    bool mFull = true;
+    bool mCarriedFull = true;
+
+    uint64_t mFrameCount = 0;
+    uint64_t mPartialCount = 0;
+    uint64_t mCarriedCount = 0;
+    uint64_t mPartialPermille = 0;
+};
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "DamageTracker.h"
+
+namespace {
+
+using Rect = DamageTracker::Rect;
+
+constexpr int32_t kWidth = 1080;
+constexpr int32_t kHeight = 2400;
+constexpr int kFrames = 600;
+// DSC slices of 540x40
+constexpr int32_t kAlignX = 540;
+constexpr int32_t kAlignY = 40;
+
+// The damage of one frame. full is a layer without surface damage.
+struct Frame {
+    std::vector<Rect> rects;
+    bool full = false;
+};
+using Trace = std::vector<Frame>;
+
+// Status bar clock once a second
+Trace makeClock() {
+    Trace trace(kFrames);
+    for (int i = 0; i < kFrames; i += 60) trace[i].rects.push_back({48, 24, 196, 88});
+    return trace;
+}
+
+// Blinking caret in a text field
+Trace makeCursor() {
+    Trace trace(kFrames);
+    for (int i = 0; i < kFrames; i += 30) trace[i].rects.push_back({412, 1180, 416, 1244});
+    return trace;
+}
+
+// Progress bar that grows every frame
+Trace makeProgressBar() {
+    Trace trace(kFrames);
+    for (int i = 0; i < kFrames; i++) {
+        int32_t x = 96 + (888 * i) / kFrames;
+        trace[i].rects.push_back({x, 1500, x + 2, 1516});
+    }
+    return trace;
+}
+
+// Clock in the top left corner and the navigation handle in the bottom right
+Trace makeOppositeCorners() {
+    Trace trace(kFrames);
+    for (int i = 0; i < kFrames; i++) {
+        if (i % 60 == 0) trace[i].rects.push_back({48, 24, 196, 88});
+        trace[i].rects.push_back({860, 2330, 1040, 2372});
+    }
+    return trace;
+}
+
+// Notification icons and a download indicator in the status bar
+Trace makeStatusIcons() {
+    Trace trace(kFrames);
+    for (int i = 0; i < kFrames; i++) {
+        trace[i].rects.push_back({860, 24, 1032, 88});
+        if (i % 4 == 0) trace[i].rects.push_back({240, 24, 300, 88});
+        if (i % 60 == 0) trace[i].rects.push_back({48, 24, 196, 88});
+    }
+    return trace;
+}
+
+// Scrolling list: the whole layer every frame
+Trace makeScroll() {
+    Trace trace(kFrames);
+    for (auto& frame : trace) frame.full = true;
+    return trace;
+}
+
+/*
+ * A trace recorded from the eDebugWindowUpdate logs, one frame per line:
+ * "l,t,r,b" rects separated by spaces, "full" for a layer without damage,
+ * an empty line for a frame without damage.
+ */
+Trace loadTrace(const char* path) {
+    Trace trace;
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        exit(1);
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        Frame frame;
+        char* save = nullptr;
+        for (char* token = strtok_r(line, " \t\n", &save); token;
+             token = strtok_r(nullptr, " \t\n", &save)) {
+            Rect rect;
+            if (strcmp(token, "full") == 0)
+                frame.full = true;
+            else if (sscanf(token, "%d,%d,%d,%d", &rect.left, &rect.top, &rect.right,
+                            &rect.bottom) == 4)
+                frame.rects.push_back(rect);
+        }
+        trace.push_back(frame);
+    }
+    fclose(file);
+    return trace;
+}
+
+struct NamedTrace {
+    const char* name;
+    Trace trace;
+};
+
+std::vector<NamedTrace>& traces() {
+    static std::vector<NamedTrace> sTraces = {
+            {"clock", makeClock()},
+            {"cursor", makeCursor()},
+            {"progress_bar", makeProgressBar()},
+            {"opposite_corners", makeOppositeCorners()},
+            {"status_icons", makeStatusIcons()},
+            {"scroll", makeScroll()},
+    };
+    return sTraces;
+}
+
+DamageTracker::Config makeConfig(uint32_t maxRects) {
+    DamageTracker::Config config;
+    config.width = kWidth;
+    config.height = kHeight;
+    config.alignX = kAlignX;
+    config.alignY = kAlignY;
+    config.tileWidth = 1;
+    config.tileHeight = 1;
+    config.maxRects = maxRects;
+    return config;
+}
+
+// Share of the panel that was sent, in percent
+void setAreaCounter(benchmark::State& state, int64_t area, int64_t frames) {
+    state.counters["area_pct"] =
+            frames ? (100.0 * area) / (static_cast<double>(kWidth) * kHeight * frames) : 0;
+}
+
+// What handleWindowUpdate() did before DamageTracker: the aligned bounds of all damage
+Rect mergeBounds(const Frame& frame) {
+    if (frame.full) return {0, 0, kWidth, kHeight};
+    Rect merged = {kWidth, kHeight, 0, 0};
+    for (const auto& rect : frame.rects) {
+        merged = {std::min(merged.left, rect.left), std::min(merged.top, rect.top),
+                  std::max(merged.right, rect.right), std::max(merged.bottom, rect.bottom)};
+    }
+    if (merged.right <= merged.left) return merged;
+    return {merged.left / kAlignX * kAlignX, merged.top / kAlignY * kAlignY,
+            std::min((merged.right + kAlignX - 1) / kAlignX * kAlignX, kWidth),
+            std::min((merged.bottom + kAlignY - 1) / kAlignY * kAlignY, kHeight)};
+}
+
+void BM_MergeBounds(benchmark::State& state) {
+    const Trace& trace = traces()[state.range(0)].trace;
+    int64_t area = 0, frames = 0;
+    for (auto _ : state) {
+        for (const auto& frame : trace) {
+            Rect merged = mergeBounds(frame);
+            benchmark::DoNotOptimize(merged);
+            if (merged.right > merged.left) area += merged.area();
+            frames++;
+        }
+    }
+    setAreaCounter(state, area, frames);
+    state.SetLabel(traces()[state.range(0)].name);
+    state.SetItemsProcessed(state.iterations() * trace.size());
+}
+
+void runTracker(benchmark::State& state, uint32_t maxRects) {
+    const Trace& trace = traces()[state.range(0)].trace;
+    DamageTracker tracker;
+    tracker.configure(makeConfig(maxRects));
+    std::vector<Rect> rects;
+    int64_t area = 0, frames = 0;
+    for (auto _ : state) {
+        for (const auto& frame : trace) {
+            tracker.beginFrame();
+            if (frame.full) tracker.addFull();
+            for (const auto& rect : frame.rects) tracker.addDamage(rect);
+            if (!tracker.compute(rects)) {
+                area += static_cast<int64_t>(kWidth) * kHeight;
+            } else {
+                for (const auto& rect : rects) area += rect.area();
+            }
+            tracker.endFrame(true);
+            frames++;
+        }
+    }
+    setAreaCounter(state, area, frames);
+    state.SetLabel(traces()[state.range(0)].name);
+    state.SetItemsProcessed(state.iterations() * trace.size());
+}
+
+void BM_Tracker_SingleRect(benchmark::State& state) {
+    runTracker(state, 1);
+}
+
+void BM_Tracker_FourRects(benchmark::State& state) {
+    runTracker(state, 4);
+}
+
+// Every other frame is dropped and carried into the next one
+void BM_Tracker_Carried(benchmark::State& state) {
+    const Trace& trace = traces()[state.range(0)].trace;
+    DamageTracker tracker;
+    tracker.configure(makeConfig(1));
+    std::vector<Rect> rects;
+    for (auto _ : state) {
+        bool presented = false;
+        for (const auto& frame : trace) {
+            tracker.beginFrame();
+            if (frame.full) tracker.addFull();
+            for (const auto& rect : frame.rects) tracker.addDamage(rect);
+            benchmark::DoNotOptimize(tracker.compute(rects));
+            tracker.endFrame(presented);
+            presented = !presented;
+        }
+    }
+    state.SetLabel(traces()[state.range(0)].name);
+    state.SetItemsProcessed(state.iterations() * trace.size());
+}
+
+void applyTraces(benchmark::internal::Benchmark* b) {
+    for (size_t i = 0; i < traces().size(); i++) b->Arg(i);
+}
+
+BENCHMARK(BM_MergeBounds)->Apply(applyTraces);
+BENCHMARK(BM_Tracker_SingleRect)->Apply(applyTraces);
+BENCHMARK(BM_Tracker_FourRects)->Apply(applyTraces);
+BENCHMARK(BM_Tracker_Carried)->Apply(applyTraces);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // DAMAGE_TRACE=<file> adds a recorded trace to the synthetic ones
+    if (const char* path = getenv("DAMAGE_TRACE")) traces().push_back({path, loadTrace(path)});
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
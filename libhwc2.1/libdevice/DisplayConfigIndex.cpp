@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DisplayConfigIndex.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+// Ids that may be missing from the slot table before find() falls back to a
+// binary search
+constexpr uint64_t kMaxSlotGap = 16;
+
+} // namespace
+
+void DisplayConfigIndex::build(std::vector<Record> records) {
+    clear();
+
+    std::sort(records.begin(), records.end(),
+              [](const Record& a, const Record& b) { return a.config < b.config; });
+    mRecords = std::move(records);
+
+    if (!mRecords.empty()) {
+        const uint64_t span =
+                static_cast<uint64_t>(mRecords.back().config) - mRecords.front().config + 1;
+        if (span <= 2 * mRecords.size() + kMaxSlotGap) {
+            mFirstConfig = mRecords.front().config;
+            mSlots.assign(span, -1);
+            for (uint32_t i = 0; i < mRecords.size(); i++)
+                mSlots[mRecords[i].config - mFirstConfig] = i;
+        }
+    }
+
+    for (uint32_t i = 0; i < mRecords.size(); i++) {
+        const Record& record = mRecords[i];
+        auto it = std::lower_bound(mResolutions.begin(), mResolutions.end(), record,
+                                   [](const Resolution& res, const Record& rec) {
+                                       return std::tie(res.width, res.height) <
+                                               std::tie(rec.width, rec.height);
+                                   });
+        if (it == mResolutions.end() || it->width != record.width ||
+            it->height != record.height) {
+            it = mResolutions.insert(it, Resolution{record.width, record.height, {}, {}});
+        }
+        it->byVsyncPeriod.push_back(i);
+    }
+
+    for (auto& resolution : mResolutions) {
+        // Records are visited in config id order, so the first config of a
+        // refresh rate is the lowest one
+        for (uint32_t i : resolution.byVsyncPeriod) {
+            const Record& record = mRecords[i];
+            auto it = std::lower_bound(resolution.byRefreshRate.begin(),
+                                       resolution.byRefreshRate.end(), record.refreshRate,
+                                       [](const std::pair<int32_t, uint32_t>& entry, int32_t rate) {
+                                           return entry.first < rate;
+                                       });
+            if (it == resolution.byRefreshRate.end() || it->first != record.refreshRate)
+                resolution.byRefreshRate.insert(it, {record.refreshRate, record.config});
+        }
+
+        std::stable_sort(resolution.byVsyncPeriod.begin(), resolution.byVsyncPeriod.end(),
+                         [this](uint32_t a, uint32_t b) {
+                             return mRecords[a].vsyncPeriod < mRecords[b].vsyncPeriod;
+                         });
+    }
+}
+
+void DisplayConfigIndex::clear() {
+    mRecords.clear();
+    mSlots.clear();
+    mFirstConfig = 0;
+    mResolutions.clear();
+}
+
+const DisplayConfigIndex::Record* DisplayConfigIndex::find(uint32_t config) const {
+    if (!mSlots.empty()) {
+        if (config < mFirstConfig || config - mFirstConfig >= mSlots.size()) return nullptr;
+        const int32_t slot = mSlots[config - mFirstConfig];
+        return slot < 0 ? nullptr : &mRecords[slot];
+    }
+
+    auto it = std::lower_bound(mRecords.begin(), mRecords.end(), config,
+                               [](const Record& record, uint32_t id) {
+                                   return record.config < id;
+                               });
+    if (it == mRecords.end() || it->config != config) return nullptr;
+    return &*it;
+}
+
+const DisplayConfigIndex::Resolution* DisplayConfigIndex::findResolution(uint32_t width,
+                                                                         uint32_t height) const {
+    const auto size = std::make_pair(width, height);
+    auto it = std::lower_bound(mResolutions.begin(), mResolutions.end(), size,
+                               [](const Resolution& res, const std::pair<uint32_t, uint32_t>& s) {
+                                   return std::make_pair(res.width, res.height) < s;
+                               });
+    if (it == mResolutions.end() || it->width != width || it->height != height) return nullptr;
+    return &*it;
+}
+
+std::optional<uint32_t> DisplayConfigIndex::lookupIn(const Resolution& resolution,
+                                                     int64_t minPeriod, int64_t maxPeriod,
+                                                     int32_t refreshRate) const {
+    auto it = std::lower_bound(resolution.byVsyncPeriod.begin(), resolution.byVsyncPeriod.end(),
+                               minPeriod, [this](uint32_t i, int64_t period) {
+                                   return mRecords[i].vsyncPeriod < period;
+                               });
+
+    std::optional<uint32_t> found;
+    for (; it != resolution.byVsyncPeriod.end(); ++it) {
+        const Record& record = mRecords[*it];
+        if (record.vsyncPeriod > maxPeriod) break;
+        if (refreshRate && record.refreshRate != refreshRate) continue;
+        if (!found || record.config < *found) found = record.config;
+    }
+    return found;
+}
+
+std::optional<uint32_t> DisplayConfigIndex::lookup(int32_t width, int32_t height,
+                                                   int64_t minPeriod, int64_t maxPeriod,
+                                                   int32_t refreshRate) const {
+    if (width < 0 || height < 0 || minPeriod > maxPeriod) return std::nullopt;
+
+    if (width && height) {
+        const Resolution* resolution = findResolution(width, height);
+        if (!resolution) return std::nullopt;
+        return lookupIn(*resolution, minPeriod, maxPeriod, refreshRate);
+    }
+
+    std::optional<uint32_t> found;
+    for (const auto& resolution : mResolutions) {
+        if ((width && resolution.width != static_cast<uint32_t>(width)) ||
+            (height && resolution.height != static_cast<uint32_t>(height)))
+            continue;
+        auto config = lookupIn(resolution, minPeriod, maxPeriod, refreshRate);
+        if (config && (!found || *config < *found)) found = config;
+    }
+    return found;
+}
+
+std::optional<uint32_t> DisplayConfigIndex::lookupFitting(int32_t width, int32_t height,
+                                                          int64_t minPeriod,
+                                                          int64_t maxPeriod) const {
+    if (width <= 0 || height <= 0 || minPeriod > maxPeriod) return std::nullopt;
+
+    std::optional<uint32_t> found;
+    for (const auto& resolution : mResolutions) {
+        // Resolutions are sorted by width
+        if (resolution.width > static_cast<uint32_t>(width)) break;
+        if (resolution.height > static_cast<uint32_t>(height)) continue;
+        auto config = lookupIn(resolution, minPeriod, maxPeriod, 0);
+        if (config && (!found || *config < *found)) found = config;
+    }
+    return found;
+}
+
+std::optional<uint32_t> DisplayConfigIndex::lookupRefreshRate(int32_t width, int32_t height,
+                                                              int32_t refreshRate) const {
+    if (width <= 0 || height <= 0) return std::nullopt;
+
+    const Resolution* resolution = findResolution(width, height);
+    if (!resolution) return std::nullopt;
+
+    auto it = std::lower_bound(resolution->byRefreshRate.begin(),
+                               resolution->byRefreshRate.end(), refreshRate,
+                               [](const std::pair<int32_t, uint32_t>& entry, int32_t rate) {
+                                   return entry.first < rate;
+                               });
+    if (it == resolution->byRefreshRate.end() || it->first != refreshRate) return std::nullopt;
+    return it->second;
+}
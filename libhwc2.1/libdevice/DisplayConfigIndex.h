@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _DISPLAY_CONFIG_INDEX_H_
+#define _DISPLAY_CONFIG_INDEX_H_
+
+#include <stdint.h>
+
+#include <optional>
+#include <vector>
+
+/*
+ * Lookup tables over the display configs of a display.
+ *
+ * Configs are grouped by resolution. Each group keeps its configs sorted by
+ * vsync period and the lowest config id of each refresh rate, so queries by
+ * resolution and vsync period do a binary search instead of a scan over every
+ * config. When several configs match, the lowest config id is returned, which
+ * is the config the scans over the config map used to find first.
+ *
+ * The index is a copy of the configs. It has to be rebuilt when they change.
+ */
+class DisplayConfigIndex {
+public:
+    struct Record {
+        uint32_t config;
+        uint32_t width;
+        uint32_t height;
+        uint32_t vsyncPeriod;
+        int32_t refreshRate;
+    };
+
+    // Configs is a map from config id to a type with width, height,
+    // vsyncPeriod and refreshRate, i.e. ExynosDisplay::mDisplayConfigs
+    template <typename Configs>
+    void build(const Configs& configs) {
+        std::vector<Record> records;
+        records.reserve(configs.size());
+        for (const auto& [config, mode] : configs) {
+            records.push_back({static_cast<uint32_t>(config), static_cast<uint32_t>(mode.width),
+                               static_cast<uint32_t>(mode.height),
+                               static_cast<uint32_t>(mode.vsyncPeriod),
+                               static_cast<int32_t>(mode.refreshRate)});
+        }
+        build(std::move(records));
+    }
+    void build(std::vector<Record> records);
+    void clear();
+
+    size_t size() const { return mRecords.size(); }
+    const Record* find(uint32_t config) const;
+
+    /*
+     * Returns the lowest config of @width x @height whose vsync period is in
+     * [@minPeriod, @maxPeriod]. Zero @width or @height matches any size, and
+     * a zero @refreshRate matches any refresh rate.
+     */
+    std::optional<uint32_t> lookup(int32_t width, int32_t height, int64_t minPeriod,
+                                   int64_t maxPeriod, int32_t refreshRate = 0) const;
+    // Same as lookup() for any resolution that fits in @width x @height
+    std::optional<uint32_t> lookupFitting(int32_t width, int32_t height, int64_t minPeriod,
+                                          int64_t maxPeriod) const;
+    // Returns the lowest config of @width x @height running at @refreshRate
+    std::optional<uint32_t> lookupRefreshRate(int32_t width, int32_t height,
+                                              int32_t refreshRate) const;
+
+private:
+    struct Resolution {
+        uint32_t width;
+        uint32_t height;
+        // Indexes of mRecords sorted by vsync period and config id
+        std::vector<uint32_t> byVsyncPeriod;
+        // Refresh rate and the lowest config running at it, sorted by refresh rate
+        std::vector<std::pair<int32_t, uint32_t>> byRefreshRate;
+    };
+
+    const Resolution* findResolution(uint32_t width, uint32_t height) const;
+    std::optional<uint32_t> lookupIn(const Resolution& resolution, int64_t minPeriod,
+                                     int64_t maxPeriod, int32_t refreshRate) const;
+
+    // Sorted by config id
+    std::vector<Record> mRecords;
+    // Index of mRecords by config id - mFirstConfig, or -1. DRM mode ids are
+    // allocated sequentially, so this stays small.
+    std::vector<int32_t> mSlots;
+    uint32_t mFirstConfig = 0;
+    // Sorted by width and height
+    std::vector<Resolution> mResolutions;
+};
+
+#endif // _DISPLAY_CONFIG_INDEX_H_
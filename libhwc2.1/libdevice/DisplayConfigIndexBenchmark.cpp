@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <climits>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include "DisplayConfigIndex.h"
+
+namespace {
+
+constexpr float nsecsPerSec = 1e9f;
+constexpr int64_t nsecsPerMs = 1000000;
+
+// The fields of displayConfigs_t used by the lookups
+struct Config {
+    uint32_t vsyncPeriod;
+    int32_t width;
+    int32_t height;
+    int32_t refreshRate;
+};
+using Configs = std::map<uint32_t, Config>;
+
+struct Mode {
+    int32_t width;
+    int32_t height;
+    int32_t fps;
+};
+
+/*
+ * Configs of a VRR panel: every resolution runs each frame rate on a 120Hz and
+ * a 240Hz TE. numResolutions of 1, 2 and 3 give 28, 56 and 84 configs.
+ */
+Configs makeVrrPanel(int numResolutions) {
+    static const Mode kResolutions[] = {{1344, 2992, 0}, {1008, 2244, 0}, {672, 1496, 0}};
+    static const int kFrameRates[] = {1, 5, 10, 24, 30, 48, 60, 72, 80, 90, 96, 120};
+
+    Configs configs;
+    uint32_t id = 0;
+    for (int r = 0; r < numResolutions; r++) {
+        for (int te : {120, 240}) {
+            for (int fps : kFrameRates) {
+                configs[id++] = {static_cast<uint32_t>(1e9 / te), kResolutions[r].width,
+                                 kResolutions[r].height, fps};
+            }
+            configs[id++] = {static_cast<uint32_t>(1e9 / te), kResolutions[r].width,
+                             kResolutions[r].height, te};
+        }
+        // NS modes
+        configs[id++] = {static_cast<uint32_t>(1e9 / 60), kResolutions[r].width,
+                         kResolutions[r].height, 60};
+        configs[id++] = {static_cast<uint32_t>(1e9 / 30), kResolutions[r].width,
+                         kResolutions[r].height, 30};
+    }
+    return configs;
+}
+
+// The scans ExynosDisplay used before DisplayConfigIndex
+int scanLookup(const Configs& configs, int32_t width, int32_t height, int32_t fps,
+               int32_t vsyncRate) {
+    const auto vsyncPeriod = nsecsPerSec / vsyncRate;
+    for (auto const& [config, mode] : configs) {
+        long delta = std::abs(vsyncPeriod - mode.vsyncPeriod);
+        if ((width == 0 || width == mode.width) && (height == 0 || height == mode.height) &&
+            (delta < nsecsPerMs) && (fps == mode.refreshRate))
+            return config;
+    }
+    return -1;
+}
+
+int scanLookupRelaxed(const Configs& configs, int32_t width, int32_t height, int32_t fps) {
+    const auto vsyncPeriod = nsecsPerSec / fps;
+    const auto vsyncPeriodMin = nsecsPerSec / (fps + 1);
+    const auto vsyncPeriodMax = nsecsPerSec / (fps - 1);
+    for (auto const& [config, mode] : configs) {
+        if (mode.width == width && mode.height == height && mode.vsyncPeriod == vsyncPeriod)
+            return config;
+    }
+    for (auto const& [config, mode] : configs) {
+        if (mode.width == width && mode.height == height && mode.vsyncPeriod >= vsyncPeriodMin &&
+            mode.vsyncPeriod <= vsyncPeriodMax)
+            return config;
+    }
+    for (auto const& [config, mode] : configs) {
+        if (mode.width <= width && mode.height <= height && mode.vsyncPeriod >= vsyncPeriodMin &&
+            mode.vsyncPeriod <= vsyncPeriodMax)
+            return config;
+    }
+    return -1;
+}
+
+uint32_t scanGetConfigId(const Configs& configs, int32_t refreshRate, int32_t width,
+                         int32_t height) {
+    for (auto entry : configs) {
+        if (entry.second.refreshRate == refreshRate && entry.second.width == width &&
+            entry.second.height == height)
+            return entry.first;
+    }
+    return UINT_MAX;
+}
+
+// The lookups as ExynosDisplay does them with DisplayConfigIndex
+int indexLookup(const DisplayConfigIndex& index, int32_t width, int32_t height, int32_t fps,
+                int32_t vsyncRate) {
+    const auto vsyncPeriod = nsecsPerSec / vsyncRate;
+    auto config = index.lookup(width, height,
+                               static_cast<int64_t>(floor(vsyncPeriod - nsecsPerMs)) + 1,
+                               static_cast<int64_t>(ceil(vsyncPeriod + nsecsPerMs)) - 1, fps);
+    return config ? static_cast<int>(*config) : -1;
+}
+
+int indexLookupRelaxed(const DisplayConfigIndex& index, int32_t width, int32_t height,
+                       int32_t fps) {
+    const auto vsyncPeriod = nsecsPerSec / fps;
+    const auto vsyncPeriodMin = static_cast<int64_t>(ceil(nsecsPerSec / (fps + 1)));
+    const auto vsyncPeriodMax = static_cast<int64_t>(floor(nsecsPerSec / (fps - 1)));
+    std::optional<uint32_t> config;
+    if (vsyncPeriod == floor(vsyncPeriod))
+        config = index.lookup(width, height, static_cast<int64_t>(vsyncPeriod),
+                              static_cast<int64_t>(vsyncPeriod));
+    if (!config) config = index.lookup(width, height, vsyncPeriodMin, vsyncPeriodMax);
+    if (!config) config = index.lookupFitting(width, height, vsyncPeriodMin, vsyncPeriodMax);
+    return config ? static_cast<int>(*config) : -1;
+}
+
+// Requests of setActiveConfig, boot config and external display paths
+std::vector<Mode> makeQueries() {
+    std::vector<Mode> queries;
+    for (int fps : {1, 10, 24, 30, 60, 90, 120, 240, 144}) {
+        queries.push_back({1344, 2992, fps});
+        queries.push_back({1008, 2244, fps});
+        queries.push_back({0, 0, fps});
+        queries.push_back({1920, 1080, fps});
+    }
+    return queries;
+}
+
+struct Panel {
+    explicit Panel(int numResolutions)
+          : configs(makeVrrPanel(numResolutions)), queries(makeQueries()) {
+        index.build(configs);
+    }
+
+    Configs configs;
+    DisplayConfigIndex index;
+    std::vector<Mode> queries;
+};
+
+void BM_Lookup_Scan(benchmark::State& state) {
+    Panel panel(state.range(0));
+    for (auto _ : state) {
+        for (const auto& q : panel.queries)
+            benchmark::DoNotOptimize(scanLookup(panel.configs, q.width, q.height, q.fps, q.fps));
+    }
+    state.SetItemsProcessed(state.iterations() * panel.queries.size());
+}
+
+void BM_Lookup_Index(benchmark::State& state) {
+    Panel panel(state.range(0));
+    for (auto _ : state) {
+        for (const auto& q : panel.queries)
+            benchmark::DoNotOptimize(indexLookup(panel.index, q.width, q.height, q.fps, q.fps));
+    }
+    state.SetItemsProcessed(state.iterations() * panel.queries.size());
+}
+
+void BM_LookupRelaxed_Scan(benchmark::State& state) {
+    Panel panel(state.range(0));
+    for (auto _ : state) {
+        for (const auto& q : panel.queries) {
+            if (!q.width || q.fps <= 1) continue;
+            benchmark::DoNotOptimize(scanLookupRelaxed(panel.configs, q.width, q.height, q.fps));
+        }
+    }
+}
+
+void BM_LookupRelaxed_Index(benchmark::State& state) {
+    Panel panel(state.range(0));
+    for (auto _ : state) {
+        for (const auto& q : panel.queries) {
+            if (!q.width || q.fps <= 1) continue;
+            benchmark::DoNotOptimize(indexLookupRelaxed(panel.index, q.width, q.height, q.fps));
+        }
+    }
+}
+
+void BM_GetConfigId_Scan(benchmark::State& state) {
+    Panel panel(state.range(0));
+    for (auto _ : state) {
+        for (const auto& q : panel.queries)
+            benchmark::DoNotOptimize(scanGetConfigId(panel.configs, q.fps, q.width, q.height));
+    }
+    state.SetItemsProcessed(state.iterations() * panel.queries.size());
+}
+
+void BM_GetConfigId_Index(benchmark::State& state) {
+    Panel panel(state.range(0));
+    for (auto _ : state) {
+        for (const auto& q : panel.queries)
+            benchmark::DoNotOptimize(panel.index.lookupRefreshRate(q.width, q.height, q.fps));
+    }
+    state.SetItemsProcessed(state.iterations() * panel.queries.size());
+}
+
+void BM_GetVsyncPeriod_Map(benchmark::State& state) {
+    Panel panel(state.range(0));
+    const uint32_t numConfigs = panel.configs.size();
+    uint32_t config = 0;
+    for (auto _ : state) {
+        const auto it = panel.configs.find(config++ % numConfigs);
+        benchmark::DoNotOptimize(it == panel.configs.end() ? 0 : it->second.vsyncPeriod);
+    }
+}
+
+void BM_GetVsyncPeriod_Index(benchmark::State& state) {
+    Panel panel(state.range(0));
+    const uint32_t numConfigs = panel.configs.size();
+    uint32_t config = 0;
+    for (auto _ : state) {
+        const auto record = panel.index.find(config++ % numConfigs);
+        benchmark::DoNotOptimize(record ? record->vsyncPeriod : 0);
+    }
+}
+
+void BM_Build(benchmark::State& state) {
+    const Configs configs = makeVrrPanel(state.range(0));
+    DisplayConfigIndex index;
+    for (auto _ : state) {
+        index.build(configs);
+        benchmark::DoNotOptimize(index.size());
+    }
+}
+
+BENCHMARK(BM_Lookup_Scan)->DenseRange(1, 3);
+BENCHMARK(BM_Lookup_Index)->DenseRange(1, 3);
+BENCHMARK(BM_LookupRelaxed_Scan)->DenseRange(1, 3);
+BENCHMARK(BM_LookupRelaxed_Index)->DenseRange(1, 3);
+BENCHMARK(BM_GetConfigId_Scan)->DenseRange(1, 3);
+BENCHMARK(BM_GetConfigId_Index)->DenseRange(1, 3);
+BENCHMARK(BM_GetVsyncPeriod_Map)->DenseRange(1, 3);
+BENCHMARK(BM_GetVsyncPeriod_Index)->DenseRange(1, 3);
+BENCHMARK(BM_Build)->DenseRange(1, 3);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
+#include "DisplayTemperatureMonitor.h"
+
+#include <fcntl.h>
+#include <log/log.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// A sample that moved less than this since the previous one doubles the
+// sampling period, and one that moved more than kFastDeltaMilliC halves it
+constexpr int32_t kSlowDeltaMilliC = 250;
+constexpr int32_t kFastDeltaMilliC = 1000;
+// Each sample moves the smoothed temperature by 1 / (1 << kSmoothingShift) of
+// its distance to the sample
+constexpr int32_t kSmoothingShift = 2;
+
+int32_t toPeriodMs(int64_t periodMs) {
+    return static_cast<int32_t>(std::clamp<int64_t>(periodMs, 1, INT32_MAX));
+}
+
+const char* toString(DisplayTemperatureMonitor::ScreenState state) {
+    switch (state) {
+        case DisplayTemperatureMonitor::ScreenState::OFF:
+            return "off";
+        case DisplayTemperatureMonitor::ScreenState::DOZE:
+            return "doze";
+        case DisplayTemperatureMonitor::ScreenState::ON:
+            return "on";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+DisplayTemperatureMonitor::DisplayTemperatureMonitor(const std::string& sysfsNode,
+                                                     int32_t intervalSec, Listener listener)
+      : mSysfsNode(sysfsNode),
+        mBasePeriodMs(toPeriodMs(static_cast<int64_t>(intervalSec) * 1000)),
+        mMinPeriodMs(toPeriodMs(mBasePeriodMs / 4)),
+        mMaxPeriodMs(toPeriodMs(static_cast<int64_t>(mBasePeriodMs) * 8)),
+        mListener(std::move(listener)),
+        mWakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+        mPeriodMs(mBasePeriodMs) {
+    if (mWakeFd.get() < 0) {
+        ALOGE("%s: failed to create eventfd: %s", __func__, strerror(errno));
+    }
+}
+
+DisplayTemperatureMonitor::~DisplayTemperatureMonitor() {
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+        thread = std::move(mThread);
+    }
+    wake();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void DisplayTemperatureMonitor::setScreenState(ScreenState state) {
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mScreenState == state) {
+        return;
+    }
+    mScreenState = state;
+
+    if (!mThread.joinable()) {
+        if (state != ScreenState::OFF && mWakeFd.get() >= 0) {
+            ALOGI("Creating monitor display temperature thread");
+            mThread = std::thread(&DisplayTemperatureMonitor::threadLoop, this);
+        }
+        return;
+    }
+    wake();
+}
+
+void DisplayTemperatureMonitor::wake() {
+    const uint64_t value = 1;
+    if (write(mWakeFd.get(), &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        ALOGE("%s: failed to wake the monitor thread: %s", __func__, strerror(errno));
+    }
+}
+
+int32_t DisplayTemperatureMonitor::readTemperature() {
+    ATRACE_CALL();
+    if (mNodeFd.get() < 0 && mNodeFd.Set(open(mSysfsNode.c_str(), O_RDONLY | O_CLOEXEC)) < 0) {
+        if (!mReadFailed) {
+            ALOGE("%s: Unable to open node '%s', error = %s", __func__, mSysfsNode.c_str(),
+                  strerror(errno));
+        }
+        mReadFailed = true;
+        mReadErrors++;
+        return kInvalidTemperature;
+    }
+
+    char buf[32];
+    const ssize_t len = TEMP_FAILURE_RETRY(pread(mNodeFd.get(), buf, sizeof(buf) - 1, 0));
+    char* end = buf;
+    long value = 0;
+    if (len > 0) {
+        buf[len] = '\0';
+        value = strtol(buf, &end, 10);
+    }
+    if (end == buf) {
+        if (!mReadFailed) {
+            ALOGE("%s: Unable to read node '%s', error = %s", __func__, mSysfsNode.c_str(),
+                  len < 0 ? strerror(errno) : "no value");
+        }
+        mReadFailed = true;
+        mReadErrors++;
+        // The node may have gone away, e.g. with the panel driver
+        mNodeFd.Close();
+        return kInvalidTemperature;
+    }
+
+    if (mReadFailed) {
+        ALOGI("%s: node '%s' is readable again", __func__, mSysfsNode.c_str());
+        mReadFailed = false;
+    }
+    mSamples++;
+    return static_cast<int32_t>(std::clamp<long>(value, INT32_MIN / 2, INT32_MAX / 2));
+}
+
+void DisplayTemperatureMonitor::publish(int32_t milliCelsius) {
+    if (mSmoothed == kInvalidTemperature) {
+        mSmoothed = milliCelsius;
+    } else {
+        mSmoothed += (milliCelsius - mSmoothed) / (1 << kSmoothingShift);
+    }
+
+    const int32_t temperature = (mSmoothed + (mSmoothed < 0 ? -500 : 500)) / 1000;
+    if (mTemperature.exchange(temperature, std::memory_order_relaxed) == temperature) {
+        return;
+    }
+    ALOGI("Display Temperature : %d°C", temperature);
+    if (mListener) {
+        mListener(temperature);
+    }
+}
+
+void DisplayTemperatureMonitor::adaptPeriod(int32_t previous, int32_t sample) {
+    if (previous == kInvalidTemperature) {
+        return;
+    }
+    const int32_t delta = std::abs(sample - previous);
+    const int32_t period = mPeriodMs.load(std::memory_order_relaxed);
+    if (delta > kFastDeltaMilliC) {
+        mPeriodMs.store(std::max(period / 2, mMinPeriodMs), std::memory_order_relaxed);
+    } else if (delta < kSlowDeltaMilliC) {
+        mPeriodMs.store(toPeriodMs(std::min(static_cast<int64_t>(period) * 2,
+                                            static_cast<int64_t>(mMaxPeriodMs))),
+                        std::memory_order_relaxed);
+    }
+}
+
+int DisplayTemperatureMonitor::getWaitTimeoutMs(ScreenState state) const {
+    if (state != ScreenState::ON) {
+        return -1;
+    }
+    // The sampling period only backs up missed notifications
+    if (mNotifySupported.load(std::memory_order_relaxed)) {
+        return mMaxPeriodMs;
+    }
+    return mPeriodMs.load(std::memory_order_relaxed);
+}
+
+void DisplayTemperatureMonitor::threadLoop() {
+    ScreenState lastState = ScreenState::OFF;
+    while (true) {
+        ScreenState state;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mExit) {
+                break;
+            }
+            state = mScreenState;
+        }
+
+        if (state != lastState) {
+            if (lastState == ScreenState::OFF) {
+                // Do not smooth over the time the screen was off
+                mSmoothed = kInvalidTemperature;
+                mLastSample = kInvalidTemperature;
+            }
+            if (state == ScreenState::ON) {
+                mPeriodMs.store(mBasePeriodMs, std::memory_order_relaxed);
+            }
+            lastState = state;
+        }
+
+        if (state != ScreenState::OFF) {
+            // Reading the node also rearms its POLLPRI notification
+            const int32_t sample = readTemperature();
+            if (sample != kInvalidTemperature) {
+                if (state == ScreenState::ON) {
+                    adaptPeriod(mLastSample, sample);
+                }
+                mLastSample = sample;
+                publish(sample);
+            }
+        }
+
+        struct pollfd fds[] = {
+                {.fd = mWakeFd.get(), .events = POLLIN, .revents = 0},
+                {.fd = mNodeFd.get(), .events = POLLPRI, .revents = 0},
+        };
+        const nfds_t nfds = (state != ScreenState::OFF && mNodeFd.get() >= 0) ? 2 : 1;
+        int timeoutMs = getWaitTimeoutMs(state);
+        if (state != ScreenState::OFF && mNodeFd.get() < 0) {
+            // Retry opening the node at the slowest rate
+            timeoutMs = mMaxPeriodMs;
+        }
+
+        const int ret = poll(fds, nfds, timeoutMs);
+        if (ret < 0) {
+            if (errno != EINTR) {
+                ALOGE("%s: poll failed: %s", __func__, strerror(errno));
+                return;
+            }
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            uint64_t value;
+            (void)read(mWakeFd.get(), &value, sizeof(value));
+        }
+        if (nfds > 1 && (fds[1].revents & (POLLPRI | POLLERR))) {
+            mNotifications++;
+            mNotifySupported.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+void DisplayTemperatureMonitor::dump(android::String8& result) const {
+    ScreenState state;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        state = mScreenState;
+    }
+    result.appendFormat("Temperature monitor: %s, screen %s, period %d ms (%d - %d ms), "
+                        "notifications %s\n",
+                        mSysfsNode.c_str(), toString(state),
+                        mPeriodMs.load(std::memory_order_relaxed), mMinPeriodMs, mMaxPeriodMs,
+                        mNotifySupported.load(std::memory_order_relaxed) ? "supported"
+                                                                          : "not seen");
+    result.appendFormat("\tsamples %u, notifications %u, read errors %u\n", mSamples.load(),
+                        mNotifications.load(), mReadErrors.load());
+}
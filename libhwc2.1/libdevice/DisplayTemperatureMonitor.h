@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _DISPLAY_TEMPERATURE_MONITOR_H_
+#define _DISPLAY_TEMPERATURE_MONITOR_H_
+
+#include <utils/String8.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "autofd.h"
+
+/*
+ * Samples the display temperature from a thermal sysfs node.
+ *
+ * The node is kept open and re-read with pread(). The sampling thread also
+ * waits for POLLPRI on it, so a thermal zone that notifies its changes is read
+ * as soon as the temperature moves. While the screen is on the sampling period
+ * adapts to the rate of change, between a quarter and eight times the
+ * configured interval. While the screen is dozing only notifications are
+ * followed, and nothing is sampled while it is off.
+ *
+ * Samples are smoothed and the result is published in whole degrees through an
+ * atomic, so readers never wait for the sampling thread.
+ */
+class DisplayTemperatureMonitor {
+public:
+    enum class ScreenState { OFF, DOZE, ON };
+
+    static constexpr int32_t kInvalidTemperature = INT32_MAX;
+
+    // Called from the sampling thread when the published temperature changes
+    using Listener = std::function<void(int32_t temperature)>;
+
+    DisplayTemperatureMonitor(const std::string& sysfsNode, int32_t intervalSec,
+                              Listener listener);
+    ~DisplayTemperatureMonitor();
+
+    // Starts the sampling thread the first time the screen leaves OFF
+    void setScreenState(ScreenState state);
+    // Smoothed temperature in degrees Celsius, or kInvalidTemperature
+    int32_t getTemperature() const { return mTemperature.load(std::memory_order_relaxed); }
+
+    void dump(android::String8& result) const;
+
+private:
+    friend class DisplayTemperatureMonitorTest;
+
+    void threadLoop();
+    // Returns the temperature in millidegrees Celsius, or kInvalidTemperature
+    int32_t readTemperature();
+    void publish(int32_t milliCelsius);
+    // Returns the timeout of the next wait in ms, -1 to wait for notifications only
+    int getWaitTimeoutMs(ScreenState state) const;
+    void adaptPeriod(int32_t previous, int32_t sample);
+    void wake();
+
+    const std::string mSysfsNode;
+    const int32_t mBasePeriodMs;
+    const int32_t mMinPeriodMs;
+    const int32_t mMaxPeriodMs;
+    const Listener mListener;
+
+    std::atomic<int32_t> mTemperature = kInvalidTemperature;
+
+    // Protects mScreenState, mExit and mThread
+    mutable std::mutex mMutex;
+    ScreenState mScreenState = ScreenState::OFF;
+    bool mExit = false;
+    std::thread mThread;
+    // Written to wake the sampling thread up
+    android::UniqueFd mWakeFd;
+
+    // Only accessed by the sampling thread
+    android::UniqueFd mNodeFd;
+    int32_t mSmoothed = kInvalidTemperature;
+    int32_t mLastSample = kInvalidTemperature;
+    bool mReadFailed = false;
+
+    // Sampling state for dump
+    std::atomic<int32_t> mPeriodMs;
+    std::atomic<bool> mNotifySupported = false;
+    std::atomic<uint32_t> mSamples = 0;
+    std::atomic<uint32_t> mNotifications = 0;
+    std::atomic<uint32_t> mReadErrors = 0;
+};
+
+#endif // _DISPLAY_TEMPERATURE_MONITOR_H_
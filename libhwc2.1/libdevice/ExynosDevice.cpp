@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 #include "BrightnessController.h"
+#include "BufferDumper.h"
 #include "ExynosDeviceDrmInterface.h"
 #include "ExynosDisplay.h"
 #include "ExynosExternalDisplayModule.h"
@@ -97,6 +98,9 @@ ExynosDevice::ExynosDevice(bool vrrApiSupported)
 
     hwcDebug = 0;
 
+    AsyncLogSink::getInstance().setLogDirs({ERROR_LOG_PATH0, ERROR_LOG_PATH1});
+    initBufferDumper();
+
     mInterfaceType = getDeviceInterfaceType();
     ALOGD("HWC2 : %s : interface type(%d)", __func__, mInterfaceType);
 
@@ -168,9 +172,9 @@ ExynosDevice::ExynosDevice(bool vrrApiSupported)
 
     for (auto it : mDisplays) {
         std::string displayName = std::string(it->mDisplayName.c_str());
-        it->mErrLogFileWriter.setPrefixName(displayName + "_hwc_error_log");
-        it->mDebugDumpFileWriter.setPrefixName(displayName + "_hwc_debug");
-        it->mFenceFileWriter.setPrefixName(displayName + "_hwc_fence_state");
+        it->mLogChannel->setPrefixName(hwclog::STREAM_ERROR, displayName + "_hwc_error_log");
+        it->mLogChannel->setPrefixName(hwclog::STREAM_DEBUG, displayName + "_hwc_debug");
+        it->mLogChannel->setPrefixName(hwclog::STREAM_FENCE, displayName + "_hwc_fence_state");
         String8 saveString;
         saveString.appendFormat("ExynosDisplay %s is initialized", it->mDisplayName.c_str());
         saveErrorLog(saveString, it);
@@ -445,6 +449,16 @@ void ExynosDevice::dump(String8 &result) {
             localTime->tm_hour, localTime->tm_min,
             localTime->tm_sec, updateTimeInfo.lastPresentTime.tv_usec/1000);
 
+    const BufferDumper::Stats dumpStats = BufferDumper::getInstance().getStats();
+    result.appendFormat("buffer dump: submitted(%" PRIu64 ") rejected(%" PRIu64
+                        ") written(%" PRIu64 ") buffers(%" PRIu64 ") bytes(%" PRIu64 " -> %" PRIu64
+                        ") fenceTimeouts(%" PRIu64 ") stale(%" PRIu64 ") unverified(%" PRIu64
+                        ") errors(%" PRIu64 ") maxQueued(%zu)\n",
+                        dumpStats.submitted, dumpStats.rejected, dumpStats.written,
+                        dumpStats.buffers, dumpStats.bytesIn, dumpStats.bytesOut,
+                        dumpStats.fenceTimeouts, dumpStats.stale, dumpStats.unverified,
+                        dumpStats.errors, dumpStats.maxQueuedBytes);
+
     result.appendFormat("\n");
     mResourceManager->dump(result);
 
@@ -817,7 +831,8 @@ void ExynosDevice::setHWCControl(uint32_t displayId, uint32_t ctrl, int32_t val)
             onRefreshDisplays();
             break;
         case HWC_CTL_CAPTURE_READBACK:
-            captureScreenWithReadback(displayId);
+            /* val is the number of consecutive frames to capture */
+            captureScreenWithReadback(displayId, val > 0 ? static_cast<uint32_t>(val) : 1);
             break;
         case HWC_CTL_DISPLAY_MODE:
             ALOGI("%s::HWC_CTL_DISPLAY_MODE mode=%d", __func__, val);
@@ -987,7 +1002,7 @@ void ExynosDevice::clearGeometryChanged()
     mGeometryChanged = 0;
 }
 
-bool ExynosDevice::canSkipValidate()
+bool ExynosDevice::canSkipValidate(ExynosDisplay *display)
 {
     /*
      * This should be called by presentDisplay()
@@ -1005,7 +1020,12 @@ bool ExynosDevice::canSkipValidate()
          * on only some displays.
          * All display's validateDisplay should be skipped or all display's validateDisplay
          * should not be skipped.
+         * Displays that own a partition of the MPPs don't share resources,
+         * so only the presenting display is checked.
          */
+        if ((display != nullptr) && mResourceManager->isPartitioned() &&
+            (mDisplays[i] != display))
+            continue;
         if (mDisplays[i]->mPlugState && mDisplays[i]->mPowerModeState.has_value() &&
             mDisplays[i]->mPowerModeState.value() != HWC2_POWER_MODE_OFF) {
             /*
@@ -1065,150 +1085,113 @@ void ExynosDevice::compareVsyncPeriod() {
     return;
 }
 
-ExynosDevice::captureReadbackClass::captureReadbackClass(
-        ExynosDevice *device) :
-    mDevice(device)
-{
-    if (device == nullptr)
-        return;
-}
-
-ExynosDevice::captureReadbackClass::~captureReadbackClass()
-{
-    VendorGraphicBufferMapper& gMapper(VendorGraphicBufferMapper::get());
-    if (mBuffer != nullptr)
-        gMapper.freeBuffer(mBuffer);
-
-    if (mDevice != nullptr)
-        mDevice->clearWaitingReadbackReqDone();
+void ExynosDevice::initBufferDumper() {
+    BufferDumper::Config config;
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.display.buffer_dump.compression", value, "none");
+    if (!strcmp(value, "gzip")) {
+        config.compression = BufferDumper::Compression::GZIP;
+    } else if (!strcmp(value, "png")) {
+        config.compression = BufferDumper::Compression::PNG;
+    }
+    config.downsample = std::max(property_get_int32("vendor.display.buffer_dump.downsample", 1), 1);
+    config.maxJobs = std::max(property_get_int32("vendor.display.buffer_dump.max_jobs", 4), 1);
+    config.byteBudget =
+            static_cast<size_t>(
+                    std::max(property_get_int32("vendor.display.buffer_dump.budget_mb", 256), 1))
+            << 20;
+    BufferDumper::getInstance().setConfig(config);
 }
 
+namespace {
 
-int32_t ExynosDevice::captureReadbackClass::allocBuffer(
-        uint32_t format, uint32_t w, uint32_t h)
-{
-    VendorGraphicBufferAllocator& gAllocator(VendorGraphicBufferAllocator::get());
-
-    uint32_t dstStride = 0;
-    uint64_t usage = static_cast<uint64_t>(GRALLOC1_CONSUMER_USAGE_HWCOMPOSER |
-            GRALLOC1_CONSUMER_USAGE_CPU_READ_OFTEN);
-
-    status_t error = NO_ERROR;
-    error = gAllocator.allocate(w, h, format, 1, usage, &mBuffer, &dstStride, "HWC");
-    if ((error != NO_ERROR) || (mBuffer == nullptr)) {
-        ALOGE("failed to allocate destination buffer(%dx%d): %d",
-                w, h, error);
-        return static_cast<int32_t>(error);
-    }
-    return NO_ERROR;
-}
+/*
+ * Copies the crop of each captured frame and has BufferDumper write it to
+ * WRITEBACK_CAPTURE_PATH, which lets the buffer go back to the engine sooner.
+ */
+class ReadbackFileWriter : public ReadbackEngine::Consumer {
+public:
+    void onFrame(const ReadbackEngine::Frame& frame) override;
+};
 
-void  ExynosDevice::captureReadbackClass::saveToFile(const String8 &fileName)
-{
-    if (mBuffer == nullptr) {
-        ALOGE("%s:: buffer is null", __func__);
-        return;
-    }
+void ReadbackFileWriter::onFrame(const ReadbackEngine::Frame& frame) {
+    ATRACE_CALL();
+    VendorGraphicBufferMeta gmeta(frame.buffer);
+    const uint32_t bpp = formatToBpp(gmeta.format) / 8;
+    const uint32_t cropWidth = frame.crop.right - frame.crop.left;
+    const uint32_t cropHeight = frame.crop.bottom - frame.crop.top;
 
     char filePath[MAX_DEV_NAME] = {0};
-    VendorGraphicBufferMeta gmeta(mBuffer);
-
+    time_t curTime = time(NULL);
+    struct tm *tm = localtime(&curTime);
     snprintf(filePath, MAX_DEV_NAME,
-            "%s/%s", WRITEBACK_CAPTURE_PATH, fileName.c_str());
-    FILE *fp = fopen(filePath, "w");
-    if (fp) {
-        uint32_t writeSize =
-            gmeta.stride * gmeta.vstride * formatToBpp(gmeta.format)/8;
-        void *writebackData = mmap(0, writeSize,
-                PROT_READ|PROT_WRITE, MAP_SHARED, gmeta.fd, 0);
-        if (writebackData != MAP_FAILED && writebackData != NULL) {
-            size_t result = fwrite(writebackData, writeSize, 1, fp);
-            munmap(writebackData, writeSize);
-            ALOGD("Success to write %zu data, size(%d)", result, writeSize);
-        } else {
-            ALOGE("Fail to mmap");
+             "%s/capture_format%d_%dx%d_%04d-%02d-%02d_%02d_%02d_%02d_%" PRIu64,
+             WRITEBACK_CAPTURE_PATH, frame.format, cropWidth, cropHeight, tm->tm_year + 1900,
+             tm->tm_mon + 1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec, frame.sequence);
+
+    BufferDumper::Buffer buffer;
+    buffer.path = filePath;
+    buffer.width = cropWidth;
+    buffer.height = cropHeight;
+    buffer.stride = cropWidth;
+    if (bpp == 4) {
+        switch (frame.format) {
+            case HAL_PIXEL_FORMAT_RGBA_8888:
+                buffer.layout = BufferDumper::Layout::RGBA_8888;
+                break;
+            case HAL_PIXEL_FORMAT_RGBX_8888:
+                buffer.layout = BufferDumper::Layout::RGBX_8888;
+                break;
+            case HAL_PIXEL_FORMAT_BGRA_8888:
+                buffer.layout = BufferDumper::Layout::BGRA_8888;
+                break;
+            default:
+                break;
         }
-        fclose(fp);
-    } else {
-        ALOGE("Fail to open %s", filePath);
     }
-}
 
-void ExynosDevice::signalReadbackDone()
-{
-    if (mIsWaitingReadbackReqDone) {
-        Mutex::Autolock lock(mCaptureMutex);
-        mCaptureCondition.signal();
+    const uint32_t mapSize = gmeta.stride * gmeta.vstride * bpp;
+    void *writebackData = mmap(0, mapSize, PROT_READ, MAP_SHARED, gmeta.fd, 0);
+    if (writebackData == MAP_FAILED || writebackData == NULL) {
+        ALOGE("Fail to mmap");
+        return;
     }
+    /* Only the rows of the crop are kept */
+    buffer.data.resize(static_cast<size_t>(cropWidth) * cropHeight * bpp);
+    const uint8_t *row = static_cast<const uint8_t *>(writebackData) +
+            (frame.crop.top * gmeta.stride + frame.crop.left) * bpp;
+    uint8_t *dst = buffer.data.data();
+    for (uint32_t y = 0; y < cropHeight; y++, row += gmeta.stride * bpp, dst += cropWidth * bpp)
+        memcpy(dst, row, cropWidth * bpp);
+    munmap(writebackData, mapSize);
+
+    BufferDumper::Job job;
+    job.buffers.push_back(std::move(buffer));
+    if (BufferDumper::getInstance().submit(std::move(job)))
+        ALOGD("Success to copy %u rows of frame %" PRIu64, cropHeight, frame.sequence);
+    else
+        ALOGE("Fail to queue frame %" PRIu64, frame.sequence);
 }
 
-void ExynosDevice::captureScreenWithReadback(uint32_t displayId) {
+} // namespace
+
+void ExynosDevice::captureScreenWithReadback(uint32_t displayId, uint32_t frameCount) {
     ExynosDisplay *display = getDisplay(displayId);
     if (display == nullptr) {
         ALOGE("There is no display(%d)", displayId);
         return;
     }
 
-    int32_t outFormat;
-    int32_t outDataspace;
-    int32_t ret = 0;
-    if ((ret = display->getReadbackBufferAttributes(
-                &outFormat, &outDataspace)) != HWC2_ERROR_NONE) {
-        ALOGE("getReadbackBufferAttributes fail, ret(%d)", ret);
-        return;
-    }
-
-    captureReadbackClass captureClass(this);
-    if ((ret = captureClass.allocBuffer(outFormat, display->mXres, display->mYres))
-            != NO_ERROR) {
-        return;
-    }
-
-    mIsWaitingReadbackReqDone = true;
-
-    if (display->setReadbackBuffer(captureClass.getBuffer(), -1, true) != HWC2_ERROR_NONE) {
-        ALOGE("setReadbackBuffer fail");
+    ReadbackEngine::Config config;
+    config.frameCount = frameCount;
+    int32_t ret = display->startReadbackCapture(config, std::make_shared<ReadbackFileWriter>());
+    if (ret != HWC2_ERROR_NONE) {
+        ALOGE("startReadbackCapture fail, ret(%d)", ret);
         return;
     }
 
-    /* Update screen */
+    /* Update screen, the frames are saved as they are captured */
     onRefresh(displayId);
-
-    /* Wait for handling readback */
-    uint32_t waitPeriod = display->mVsyncPeriod * 3;
-    {
-        Mutex::Autolock lock(mCaptureMutex);
-        status_t err = mCaptureCondition.waitRelative(
-                mCaptureMutex, us2ns(waitPeriod));
-        if (err == TIMED_OUT) {
-            ALOGE("timeout, readback is not requested");
-            return;
-        } else if (err != NO_ERROR) {
-            ALOGE("error waiting for readback request: %s (%d)", strerror(-err), err);
-            return;
-        } else {
-            ALOGD("readback request is done");
-        }
-    }
-
-    int32_t fence = -1;
-    if (display->getReadbackBufferFence(&fence) != HWC2_ERROR_NONE) {
-        ALOGE("getReadbackBufferFence fail");
-        return;
-    }
-    if (sync_wait(fence, 1000) < 0) {
-        ALOGE("sync wait error, fence(%d)", fence);
-    }
-    hwcFdClose(fence);
-
-    String8 fileName;
-    time_t curTime = time(NULL);
-    struct tm *tm = localtime(&curTime);
-    fileName.appendFormat("capture_format%d_%dx%d_%04d-%02d-%02d_%02d_%02d_%02d.raw",
-            outFormat, display->mXres, display->mYres,
-            tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
-            tm->tm_hour, tm->tm_min, tm->tm_sec);
-    captureClass.saveToFile(fileName);
 }
 
 int32_t ExynosDevice::setDisplayDeviceMode(int32_t display_id, int32_t mode)
@@ -308,7 +308,7 @@ class ExynosDevice {
         void setGeometryChanged(uint64_t changedBit) { mGeometryChanged|= changedBit;};
         void clearGeometryChanged();
         void setDynamicRecomposition(uint32_t displayId, unsigned int on);
-        bool canSkipValidate();
+        bool canSkipValidate(ExynosDisplay *display = nullptr);
         bool validateFences(ExynosDisplay *display);
         void compareVsyncPeriod();
         bool isDynamicRecompositionThreadAlive();
@@ -317,23 +317,8 @@ class ExynosDevice {
         int32_t setPanelGammaTableSource(int32_t display_id, int32_t type, int32_t source);
         void dump(String8 &result);
 
-        class captureReadbackClass {
-            public:
-                captureReadbackClass(ExynosDevice *device);
-                ~captureReadbackClass();
-                int32_t allocBuffer(uint32_t format, uint32_t w, uint32_t h);
-                buffer_handle_t& getBuffer() { return mBuffer; };
-                void saveToFile(const String8 &fileName);
-            private:
-                buffer_handle_t mBuffer = nullptr;
-                ExynosDevice* mDevice = nullptr;
-        };
-        void captureScreenWithReadback(uint32_t displayType);
-        void cleanupCaptureScreen(void *buffer);
-        void signalReadbackDone();
-        void clearWaitingReadbackReqDone() {
-            mIsWaitingReadbackReqDone = false;
-        };
+        /* Saves the next frameCount frames of the display to WRITEBACK_CAPTURE_PATH */
+        void captureScreenWithReadback(uint32_t displayId, uint32_t frameCount = 1);
 
         uint32_t getWindowPlaneNum();
         uint32_t getSpecialPlaneNum();
@@ -368,10 +353,9 @@ class ExynosDevice {
     protected:
         uint32_t mInterfaceType;
     private:
-        Mutex mCaptureMutex;
-        Condition mCaptureCondition;
-        std::atomic<bool> mIsWaitingReadbackReqDone = false;
         bool isCallbackRegisteredLocked(int32_t descriptor);
+        /* Applies the vendor.display.buffer_dump.* properties */
+        void initBufferDumper();
 
     public:
         void enterToTUI() { mIsInTUI = true; };
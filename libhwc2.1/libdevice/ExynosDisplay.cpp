@@ -34,10 +34,13 @@
 #include <utils/CallStack.h>
 
 #include <charconv>
+#include <cmath>
 #include <future>
 #include <map>
+#include <sstream>
 
 #include "BrightnessController.h"
+#include "BufferDumper.h"
 #include "DisplayTe2Manager.h"
 #include "ExynosExternalDisplay.h"
 #include "ExynosLayer.h"
@@ -975,6 +978,32 @@ void ExynosCompositionInfo::dump(String8& result) const {
     result.append("\n");
 }
 
+void ExynosCompositionInfo::dump(hwclog::CompositionInfoRecord& record) const {
+    record = {};
+    record.type = mType;
+    record.hasCompositionLayer = mHasCompositionLayer;
+    record.firstIndex = mFirstIndex;
+    record.lastIndex = mLastIndex;
+    record.dataSpace = mDataSpace;
+    record.windowIndex = mWindowIndex;
+    record.handle = reinterpret_cast<uintptr_t>(mTargetBuffer);
+    record.acquireFence = mAcquireFence;
+    record.releaseFence = mReleaseFence;
+    record.skipFlag = mSkipFlag;
+    record.compressionType = mCompressionInfo.type;
+    record.compressionModifier = mCompressionInfo.modifier;
+    if (mTargetBuffer != NULL) {
+        record.internalFormat = VendorGraphicBufferMeta::get_internal_format(mTargetBuffer);
+        record.afbc = isAFBCCompressed(mTargetBuffer);
+    }
+    if (mOtfMPP != NULL)
+        strlcpy(record.otfMPP, mOtfMPP->mName.c_str(), sizeof(record.otfMPP));
+    if (mM2mMPP != NULL) {
+        strlcpy(record.m2mMPP, mM2mMPP->mName.c_str(), sizeof(record.m2mMPP));
+        record.assignedSrcNum = mM2mMPP->mAssignedSources.size();
+    }
+}
+
 String8 ExynosCompositionInfo::getTypeStr()
 {
     switch(mType) {
@@ -1048,10 +1077,13 @@ ExynosDisplay::ExynosDisplay(uint32_t type, uint32_t index, ExynosDevice* device
         mVsyncAppliedTimeLine{false, 0, systemTime(SYSTEM_TIME_MONOTONIC)},
         mConfigRequestState(hwc_request_state_t::SET_CONFIG_STATE_DONE),
         mPowerHalHint(mDisplayId, mDisplayTraceName),
-        mErrLogFileWriter(2, ERR_LOG_SIZE),
-        mDebugDumpFileWriter(10, 1, ".dump"),
-        mFenceFileWriter(2, FENCE_ERR_LOG_SIZE),
+        mLogChannel(AsyncLogSink::getInstance().createChannel()),
         mOperationRateManager(nullptr) {
+    mLogChannel->setRotation(hwclog::STREAM_ERROR, 2, ERR_LOG_SIZE);
+    // One debug dump per file
+    mLogChannel->setDumpRotation(hwclog::STREAM_DEBUG, 10);
+    mLogChannel->setRotation(hwclog::STREAM_FENCE, 2, FENCE_ERR_LOG_SIZE);
+
     mDisplayControl.enableCompositionCrop = true;
     mDisplayControl.enableExynosCompositionOptimization = true;
     mDisplayControl.enableClientCompositionOptimization = true;
@@ -1060,8 +1092,16 @@ ExynosDisplay::ExynosDisplay(uint32_t type, uint32_t index, ExynosDevice* device
     mDisplayControl.earlyStartMPP = true;
     mDisplayControl.adjustDisplayFrame = false;
     mDisplayControl.cursorSupport = false;
+    mDisplayControl.preValidateAssignment =
+            property_get_bool("vendor.display.pre_validate_assignment", false);
+
+    DamageTracker::Config damageConfig;
+    damageConfig.alignX = property_get_int32("vendor.display.win_update.align_x", 1);
+    damageConfig.alignY = property_get_int32("vendor.display.win_update.align_y", 1);
+    mDamageTracker.configure(damageConfig);
 
     mDisplayConfigs.clear();
+    mDisplayConfigIndex.clear();
 
     mPowerModeState = std::nullopt;
 
@@ -2466,69 +2506,72 @@ void ExynosDisplay::printDebugInfos(String8 &reason) {
                         getLocalTimeStr(tv).c_str());
     ALOGD("%s", reason.c_str());
 
-    bool fileOpened = mDebugDumpFileWriter.chooseOpenedFile();
-    mDebugDumpFileWriter.write(reason);
+    // Only records are made here, the log writer thread does the file I/O
+    auto logText = [this](const String8 &text) {
+        mLogChannel->logText(hwclog::STREAM_DEBUG, std::string_view(text.c_str(), text.size()));
+    };
+    mLogChannel->beginDump(hwclog::STREAM_DEBUG);
+    logText(reason);
     mErrorFrameCount++;
 
     android::String8 result;
     result.appendFormat("Device mGeometryChanged(%" PRIx64 "), mGeometryChanged(%" PRIx64 "), mRenderingState(%d)\n",
             mDevice->mGeometryChanged, mGeometryChanged, mRenderingState);
     result.appendFormat("=======================  dump composition infos  ================================\n");
-    const ExynosCompositionInfo& clientCompInfo = mClientCompositionInfo;
-    const ExynosCompositionInfo& exynosCompInfo = mExynosCompositionInfo;
-    clientCompInfo.dump(result);
-    exynosCompInfo.dump(result);
+    logText(result);
+    for (const auto *compInfo : {&mClientCompositionInfo, &mExynosCompositionInfo}) {
+        hwclog::CompositionInfoRecord record;
+        compInfo->dump(record);
+        mLogChannel->log(hwclog::STREAM_DEBUG, hwclog::TYPE_COMPOSITION_INFO, record);
+        // logcat keeps the text
+        compInfo->dump(result);
+    }
     ALOGD("%s", result.c_str());
-    mDebugDumpFileWriter.write(result);
     result.clear();
 
     result.appendFormat("=======================  dump exynos layers (%zu)  ================================\n",
             mLayers.size());
     ALOGD("%s", result.c_str());
-    mDebugDumpFileWriter.write(result);
+    logText(result);
     result.clear();
     for (uint32_t i = 0; i < mLayers.size(); i++) {
         ExynosLayer *layer = mLayers[i];
         layer->printLayer();
-        if (fileOpened) {
-            layer->dump(result);
-            mDebugDumpFileWriter.write(result);
-            result.clear();
-        }
+        hwclog::LayerRecord record;
+        layer->dump(record);
+        record.index = i;
+        mLogChannel->log(hwclog::STREAM_DEBUG, hwclog::TYPE_LAYER, record);
     }
 
     if (mIgnoreLayers.size()) {
         result.appendFormat("=======================  dump ignore layers (%zu)  ================================\n",
                             mIgnoreLayers.size());
         ALOGD("%s", result.c_str());
-        mDebugDumpFileWriter.write(result);
+        logText(result);
         result.clear();
         for (uint32_t i = 0; i < mIgnoreLayers.size(); i++) {
             ExynosLayer *layer = mIgnoreLayers[i];
             layer->printLayer();
-            if (fileOpened) {
-                layer->dump(result);
-                mDebugDumpFileWriter.write(result);
-                result.clear();
-            }
+            hwclog::LayerRecord record;
+            layer->dump(record);
+            record.index = i;
+            record.ignored = 1;
+            mLogChannel->log(hwclog::STREAM_DEBUG, hwclog::TYPE_LAYER, record);
         }
     }
 
     result.appendFormat("=============================  dump win configs  ===================================\n");
     ALOGD("%s", result.c_str());
-    mDebugDumpFileWriter.write(result);
+    logText(result);
     result.clear();
     for (size_t i = 0; i < mDpuData.configs.size(); i++) {
         ALOGD("config[%zu]", i);
         printConfig(mDpuData.configs[i]);
-        if (fileOpened) {
-            result.appendFormat("config[%zu]\n", i);
-            dumpConfig(result, mDpuData.configs[i]);
-            mDebugDumpFileWriter.write(result);
-            result.clear();
-        }
+        hwclog::WinConfigRecord record;
+        dumpConfig(record, mDpuData.configs[i]);
+        record.index = i;
+        mLogChannel->log(hwclog::STREAM_DEBUG, hwclog::TYPE_WIN_CONFIG, record);
     }
-    mDebugDumpFileWriter.flush();
 }
 
 int32_t ExynosDisplay::validateWinConfigData()
@@ -2699,6 +2742,173 @@ int ExynosDisplay::checkConfigDstChanged(const exynos_dpu_data &lastConfigsData,
 /**
  * @return int
  */
+int32_t ExynosDisplay::testWinConfigData(ExynosLayer *&outRejected) {
+    ATRACE_CALL();
+    int32_t ret = NO_ERROR;
+    std::vector<exynos_win_config_data> configs(mDpuData.configs.size());
+    std::vector<ExynosLayer *> layers;
+
+    outRejected = nullptr;
+
+    /*
+     * Buffers of composition targets and m2mMPPs are not available before
+     * presentDisplay(), so the layers that are scanned out directly are checked
+     * with the client target, which the last target buffer stands in for. The
+     * kernel keeps the other planes of the CRTC disabled in the test.
+     */
+    int32_t targetIndex = -1;
+    exynos_win_config_data target;
+    if (configureTestClientTarget(target)) {
+        targetIndex = mClientCompositionInfo.mWindowIndex;
+        configs[targetIndex] = target;
+    }
+
+    for (uint32_t i = 0; i < mLayers.size(); i++) {
+        ExynosLayer *layer = mLayers[i];
+        if ((layer->mValidateCompositionType != HWC2_COMPOSITION_DEVICE) ||
+            (layer->mOtfMPP == nullptr) || (layer->mM2mMPP != nullptr))
+            continue;
+        if (!layer->isDimLayer() && (layer->mLayerBuffer == nullptr))
+            continue;
+
+        int32_t windowIndex = layer->mWindowIndex;
+        if ((windowIndex < 0) || (windowIndex >= (int32_t)configs.size())) {
+            DISPLAY_LOGE("%s:: %d layer has invalid windowIndex(%d)", __func__, i, windowIndex);
+            return -EINVAL;
+        }
+        if (configureHandle(*layer, -1, configs[windowIndex]) != NO_ERROR) {
+            outRejected = layer;
+            return -EINVAL;
+        }
+        layers.push_back(layer);
+    }
+
+    if (layers.empty())
+        return NO_ERROR;
+
+    if ((ret = testWinConfigs(configs)) != -EINVAL)
+        return ret;
+
+    if (layers.size() == 1) {
+        outRejected = layers[0];
+        return ret;
+    }
+
+    /* Find the layer that is rejected by itself */
+    for (auto layer : layers) {
+        std::vector<exynos_win_config_data> single(configs.size());
+        single[layer->mWindowIndex] = configs[layer->mWindowIndex];
+        if (targetIndex >= 0)
+            single[targetIndex] = target;
+        if (testWinConfigs(single) == -EINVAL) {
+            outRejected = layer;
+            return ret;
+        }
+    }
+
+    /* Layers are rejected together, release the layer having the largest source */
+    outRejected = *std::max_element(layers.begin(), layers.end(),
+                                    [&configs](ExynosLayer *a, ExynosLayer *b) {
+                                        auto &srcA = configs[a->mWindowIndex].src;
+                                        auto &srcB = configs[b->mWindowIndex].src;
+                                        return (uint64_t)srcA.w * srcA.h <
+                                                (uint64_t)srcB.w * srcB.h;
+                                    });
+    return ret;
+}
+
+bool ExynosDisplay::configureTestClientTarget(exynos_win_config_data &config) {
+    const ExynosCompositionInfo &info = mClientCompositionInfo;
+    int32_t windowIndex = info.mWindowIndex;
+    if (!info.mHasCompositionLayer || (info.mOtfMPP == nullptr) || (windowIndex < 0) ||
+        (windowIndex >= (int32_t)mDpuData.configs.size()))
+        return false;
+
+    config.assignedMPP = info.mOtfMPP;
+    config.dst = {0, 0, mXres, mYres, mXres, mYres};
+    config.blending = HWC2_BLEND_MODE_PREMULTIPLIED;
+    config.plane_alpha = 1;
+
+    /* Before the first target, a color fill keeps the plane enabled */
+    if (info.mTargetBuffer == nullptr) {
+        config.state = config.WIN_STATE_COLOR;
+        config.color = 0;
+        return true;
+    }
+
+    VendorGraphicBufferMeta gmeta(info.mTargetBuffer);
+    config.state = config.WIN_STATE_BUFFER;
+    config.buffer_id = gmeta.unique_id;
+    config.fd_idma[0] = gmeta.fd;
+    config.fd_idma[1] = gmeta.fd1;
+    config.fd_idma[2] = gmeta.fd2;
+    config.protection = (getDrmMode(gmeta.producer_usage) == SECURE_DRM) ? 1 : 0;
+    config.format = gmeta.format;
+    config.src = {0, 0, mXres, mYres, static_cast<uint32_t>(gmeta.stride),
+                  static_cast<uint32_t>(gmeta.vstride)};
+    config.compressionInfo = info.mCompressionInfo;
+    if (info.mCompressionInfo.type == COMP_TYPE_AFBC)
+        config.comp_src = DPP_COMP_SRC_GPU;
+    config.dataspace = info.mDataSpace;
+    return true;
+}
+
+int32_t ExynosDisplay::testWinConfigs(const std::vector<exynos_win_config_data> &configs) {
+    uint64_t signature = 0;
+    auto combine = [&signature](uint64_t value) {
+        signature ^= value + 0x9e3779b97f4a7c15ULL + (signature << 6) + (signature >> 2);
+    };
+
+    combine(mXres);
+    combine(mYres);
+    combine(mActiveConfig);
+    for (size_t i = 0; i < configs.size(); i++) {
+        const exynos_win_config_data &config = configs[i];
+        if (config.state == config.WIN_STATE_DISABLED)
+            continue;
+        combine(i);
+        combine(config.state);
+        combine(reinterpret_cast<uintptr_t>(config.assignedMPP));
+        combine(config.format);
+        combine(config.compressionInfo.type);
+        combine(config.compressionInfo.modifier);
+        combine(config.protection);
+        combine(config.transform);
+        combine(config.blending);
+        combine(config.dataspace);
+        combine(((uint64_t)config.src.x << 32) | config.src.y);
+        combine(((uint64_t)config.src.w << 32) | config.src.h);
+        combine(((uint64_t)config.src.f_w << 32) | config.src.f_h);
+        combine(((uint64_t)config.dst.x << 32) | config.dst.y);
+        combine(((uint64_t)config.dst.w << 32) | config.dst.h);
+    }
+
+    auto &results = mPreValidation.results;
+    auto it = mPreValidation.resultIndex.find(signature);
+    if (it != mPreValidation.resultIndex.end()) {
+        mPreValidation.hits++;
+        results.splice(results.begin(), results, it->second);
+        return it->second->second ? NO_ERROR : -EINVAL;
+    }
+    mPreValidation.misses++;
+
+    int32_t ret = mDisplayInterface->testWinConfigData(configs);
+    /* Other errors mean the configs could not be tested */
+    if ((ret != NO_ERROR) && (ret != -EINVAL))
+        return ret;
+
+    if (results.size() >= PreValidationInfo::kMaxResults) {
+        mPreValidation.resultIndex.erase(results.back().first);
+        results.pop_back();
+    }
+    results.emplace_front(signature, (ret == NO_ERROR));
+    mPreValidation.resultIndex[signature] = results.begin();
+
+    DISPLAY_LOGD(eDebugResourceManager, "%s:: signature(0x%" PRIx64 ") ret(%d)", __func__,
+                 signature, ret);
+    return ret;
+}
+
 int ExynosDisplay::deliverWinConfigData() {
 
     ATRACE_CALL();
@@ -3379,7 +3589,7 @@ int32_t ExynosDisplay::canSkipValidate() {
     if (mRenderingState == RENDERING_STATE_NONE)
         return SKIP_ERR_FIRST_FRAME;
 
-    if (mDevice->mGeometryChanged != 0) {
+    if (mResourceManager->getGeometryChanged(this) != 0) {
         /* validateDisplay() should be called */
         return SKIP_ERR_GEOMETRY_CHAGNED;
     } else {
@@ -3439,7 +3649,28 @@ bool ExynosDisplay::isFullScreenComposition() {
     return true;
 }
 
-void dumpBuffer(const String8& prefix, const exynos_image& image, std::ofstream& configFile) {
+BufferDumper::Layout getDumpLayout(const exynos_image& image) {
+    if (image.compressionInfo.type != COMP_TYPE_NONE) return BufferDumper::Layout::OPAQUE;
+    switch (image.format) {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+            return BufferDumper::Layout::RGBA_8888;
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+            return BufferDumper::Layout::RGBX_8888;
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+            return BufferDumper::Layout::BGRA_8888;
+        default:
+            return BufferDumper::Layout::OPAQUE;
+    }
+}
+
+/*
+ * Adds the buffer of image to the dump job. Only the fds are duplicated here,
+ * the fences are waited and the contents written by BufferDumper. Buffers the
+ * HWC reuses for the next frames (copy) are copied here instead, and the
+ * contents of the others are sampled so that a later frame can be told apart.
+ */
+void dumpBuffer(const String8& prefix, const exynos_image& image, BufferDumper::Job& job,
+                std::ostream& configFile, bool copy) {
     ATRACE_NAME(prefix.c_str());
     if (image.bufferHandle == nullptr) {
         ALOGE("%s: Buffer handle for %s is NULL", __func__, prefix.c_str());
@@ -3447,34 +3678,42 @@ void dumpBuffer(const String8& prefix, const exynos_image& image, std::ofstream&
     }
     ALOGI("%s: dumping buffer for %s", __func__, prefix.c_str());
 
-    bool failFenceSync = false;
-    String8 infoDump;
-    if (image.acquireFenceFd > 0 && sync_wait(image.acquireFenceFd, 1000) < 0) {
-        infoDump.appendFormat("Failed to sync acquire fence\n");
-        ALOGE("%s: Failed to wait acquire fence %d, errno=(%d, %s)", __func__, image.acquireFenceFd,
-              errno, strerror(errno));
-        failFenceSync = true;
-    }
-    if (image.releaseFenceFd > 0 && sync_wait(image.releaseFenceFd, 1000) < 0) {
-        infoDump.appendFormat("Failed to sync release fence\n");
-
-        ALOGE("%s: Failed to wait release fence %d, errno=(%d, %s)", __func__, image.releaseFenceFd,
-              errno, strerror(errno));
-        failFenceSync = true;
-    }
-
     VendorGraphicBufferMeta gmeta(image.bufferHandle);
-    String8 infoPath = String8::format("%s/%s-info.txt", kBufferDumpPath, prefix.c_str());
-    std::ofstream infoFile(infoPath.c_str());
-    if (!infoFile) {
-        ALOGE("%s: failed to open file %s", __func__, infoPath.c_str());
-        return;
-    }
+    BufferDumper::Buffer buffer;
+    buffer.path = String8::format("%s/%s-%s", kBufferDumpPath, prefix.c_str(),
+                                  getFormatStr(image.format, image.compressionInfo.type).c_str())
+                          .c_str();
+    buffer.layout = getDumpLayout(image);
+    buffer.width = gmeta.width;
+    buffer.height = gmeta.height;
+    buffer.stride = gmeta.stride;
+    // The fence errors are logged by the dumper, the buffers are dumped anyway
+    if (image.acquireFenceFd > 0) buffer.acquireFence.Set(dup(image.acquireFenceFd));
+    if (image.releaseFenceFd > 0) buffer.releaseFence.Set(dup(image.releaseFenceFd));
 
-    // TODO(b/261232489): Fix fence sync errors
-    // We currently ignore the fence errors and just dump the buffers
+    int bufferNumber = getBufferNumOfFormat(image.format, image.compressionInfo.type);
+    for (int i = 0; i < bufferNumber; ++i) {
+        if (gmeta.fds[i] <= 0) {
+            ALOGE("%s: gmeta.fds[%d]=%d is invalid", __func__, i, gmeta.fds[i]);
+            continue;
+        }
+        if (gmeta.sizes[i] <= 0) {
+            ALOGE("%s: gmeta.sizes[%d]=%d is invalid", __func__, i, gmeta.sizes[i]);
+            continue;
+        }
+        BufferDumper::Plane plane;
+        plane.fd.Set(dup(gmeta.fds[i]));
+        plane.size = gmeta.sizes[i];
+        if (plane.fd.get() < 0) {
+            ALOGE("%s: failed to dup fds[%d]:%d for %s", __func__, i, gmeta.fds[i],
+                  prefix.c_str());
+            continue;
+        }
+        buffer.planes.push_back(std::move(plane));
+    }
 
     // dump buffer info
+    String8 infoDump;
     dumpExynosImage(infoDump, image);
     infoDump.appendFormat("\nfd[%d, %d, %d] size[%d, %d, %d]\n", gmeta.fd, gmeta.fd1, gmeta.fd2,
                           gmeta.size, gmeta.size1, gmeta.size2);
@@ -3484,67 +3723,46 @@ void dumpBuffer(const String8& prefix, const exynos_image& image, std::ofstream&
                           gmeta.stride, gmeta.vstride);
     infoDump.appendFormat(" producer: 0x%" PRIx64 " consumer: 0x%" PRIx64 " flags: 0x%" PRIx32 "\n",
                           gmeta.producer_usage, gmeta.consumer_usage, gmeta.flags);
-    infoFile << infoDump << std::endl;
-
-    String8 bufferPath =
-            String8::format("%s/%s-%s.raw", kBufferDumpPath, prefix.c_str(),
-                            getFormatStr(image.format, image.compressionInfo.type).c_str());
-    std::ofstream bufferFile(bufferPath.c_str(), std::ios::binary);
-    if (!bufferFile) {
-        ALOGE("%s: failed to open file %s", __func__, bufferPath.c_str());
-        return;
+    buffer.infoPath = String8::format("%s/%s-info.txt", kBufferDumpPath, prefix.c_str()).c_str();
+    job.texts.emplace_back(buffer.infoPath, std::string(infoDump.c_str()) + "\n");
+
+    if (copy) {
+        if (!BufferDumper::copyContents(buffer))
+            ALOGE("%s: failed to copy the buffer of %s", __func__, prefix.c_str());
+    } else {
+        BufferDumper::recordChecksum(buffer);
     }
 
     // dump info that can be loaded by hwc-tester
+    const BufferDumper& dumper = BufferDumper::getInstance();
+    const uint32_t downsample = dumper.getDownsample(buffer);
     configFile << "buffers {\n";
     configFile << "    key: \"" << prefix << "\"\n";
     configFile << "    format: " << getFormatStr(image.format, image.compressionInfo.type) << "\n";
-    configFile << "    width: " << gmeta.width << "\n";
-    configFile << "    height: " << gmeta.height << "\n";
+    configFile << "    width: " << gmeta.width / downsample << "\n";
+    configFile << "    height: " << gmeta.height / downsample << "\n";
     auto usage = gmeta.producer_usage | gmeta.consumer_usage;
     configFile << "    usage: 0x" << std::hex << usage << std::dec << "\n";
-    configFile << "    filepath: \"" << bufferPath << "\"\n";
+    configFile << "    filepath: \"" << buffer.path << dumper.getExtension(buffer) << "\"\n";
     configFile << "}\n" << std::endl;
 
-    int bufferNumber = getBufferNumOfFormat(image.format, image.compressionInfo.type);
-    for (int i = 0; i < bufferNumber; ++i) {
-        if (gmeta.fds[i] <= 0) {
-            ALOGE("%s: gmeta.fds[%d]=%d is invalid", __func__, i, gmeta.fds[i]);
-            continue;
-        }
-        if (gmeta.sizes[i] <= 0) {
-            ALOGE("%s: gmeta.sizes[%d]=%d is invalid", __func__, i, gmeta.sizes[i]);
-            continue;
-        }
-        auto addr = mmap(0, gmeta.sizes[i], PROT_READ | PROT_WRITE, MAP_SHARED, gmeta.fds[i], 0);
-        if (addr != MAP_FAILED && addr != NULL) {
-            bufferFile.write(static_cast<char*>(addr), gmeta.sizes[i]);
-            munmap(addr, gmeta.sizes[i]);
-        } else {
-            ALOGE("%s: failed to mmap fds[%d]:%d for %s", __func__, i, gmeta.fds[i]);
-        }
-    }
+    job.buffers.push_back(std::move(buffer));
 }
 
 void ExynosDisplay::dumpAllBuffers() {
     ATRACE_CALL();
+    BufferDumper::Job job;
     // dump layers info
     String8 infoPath = String8::format("%s/%03d-display-info.txt", kBufferDumpPath, mBufferDumpNum);
-    std::ofstream infoFile(infoPath.c_str());
-    if (!infoFile) {
-        DISPLAY_LOGE("%s: failed to open file %s", __func__, infoPath.c_str());
-        ++mBufferDumpNum;
-        return;
-    }
     String8 displayDump;
     dumpLocked(displayDump);
-    infoFile << displayDump << std::endl;
+    job.texts.emplace_back(infoPath.c_str(), std::string(displayDump.c_str()) + "\n");
 
     // dump buffer contents & infos
     std::vector<String8> allLayerKeys;
     String8 testerConfigPath =
             String8::format("%s/%03d-hwc-tester-config.textproto", kBufferDumpPath, mBufferDumpNum);
-    std::ofstream configFile(testerConfigPath.c_str());
+    std::ostringstream configFile;
     configFile << std::string(15, '#')
                << " You can load this config file using hwc-tester to reproduce this frame "
                << std::string(15, '#') << std::endl;
@@ -3552,12 +3770,12 @@ void ExynosDisplay::dumpAllBuffers() {
         std::scoped_lock lock(mDRMutex);
         for (int i = 0; i < mLayers.size(); ++i) {
             String8 prefix = String8::format("%03d-%d-src", mBufferDumpNum, i);
-            dumpBuffer(prefix, mLayers[i]->mSrcImg, configFile);
+            dumpBuffer(prefix, mLayers[i]->mSrcImg, job, configFile, false);
             if (mLayers[i]->mM2mMPP != nullptr) {
                 String8 midPrefix = String8::format("%03d-%d-mid", mBufferDumpNum, i);
                 exynos_image image = mLayers[i]->mMidImg;
                 mLayers[i]->mM2mMPP->getDstImageInfo(&image);
-                dumpBuffer(midPrefix, image, configFile);
+                dumpBuffer(midPrefix, image, job, configFile, true);
             }
             configFile << "layers {\n";
             configFile << "    key: \"" << prefix << "\"\n";
@@ -3615,7 +3833,7 @@ void ExynosDisplay::dumpAllBuffers() {
         String8 prefix = String8::format("%03d-client-target", mBufferDumpNum);
         exynos_image src, dst;
         setCompositionTargetExynosImage(COMPOSITION_CLIENT, &src, &dst);
-        dumpBuffer(prefix, src, configFile);
+        dumpBuffer(prefix, src, job, configFile, true);
     }
 
     configFile << "timelines {\n";
@@ -3632,7 +3850,12 @@ void ExynosDisplay::dumpAllBuffers() {
         configFile << "    }\n";
     }
     configFile << "}" << std::endl;
+    job.texts.emplace_back(testerConfigPath.c_str(), configFile.str());
 
+    // The frame is written by the dumper thread, or dropped if it is behind
+    if (!BufferDumper::getInstance().submit(std::move(job))) {
+        DISPLAY_LOGW("%s: dump %03d dropped", __func__, mBufferDumpNum);
+    }
     ++mBufferDumpNum;
 }
 
@@ -3666,6 +3889,7 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
 
     int ret = HWC2_ERROR_NONE;
     String8 errString;
+    bool readbackCapture = false;
     thread_local bool setTaskProfileDone = false;
 
     if (setTaskProfileDone == false) {
@@ -3676,6 +3900,9 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
     }
 
     Mutex::Autolock lock(mDisplayMutex);
+    auto partitionLease = mResourceManager->acquirePartitionLease(this, false);
+    funcReturnCallback partitionFrameCallback(
+            [&]() { mResourceManager->finishPartitionFrame(this); });
 
     if (!mHpdStatus) {
         ALOGD("presentDisplay: drop frame: mHpdStatus == false");
@@ -3689,6 +3916,7 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
 
     if (!mHpdStatus || mDropFrameDuringResSwitch || mPauseDisplay || mDevice->isInTUI()) {
         closeFencesForSkipFrame(RENDERING_STATE_PRESENTED);
+        mDamageTracker.invalidate();
         *outRetireFence = -1;
         mRenderingState = RENDERING_STATE_PRESENTED;
         applyExpectedPresentTime();
@@ -3747,7 +3975,7 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
             goto err;
         }
 
-        if (mDevice->canSkipValidate() == false)
+        if (mDevice->canSkipValidate(this) == false)
             goto not_validated;
         else {
             for (size_t i=0; i < mLayers.size(); i++) {
@@ -3768,7 +3996,7 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
              * if there is no buffer update. (using ExynosMPP::canSkipProcessing())
              * Therefore performanceInfo should be calculated again if the buffer is updated.
              */
-            if ((ret = mDevice->mResourceManager->deliverPerformanceInfo()) != NO_ERROR) {
+            if ((ret = mDevice->mResourceManager->deliverPerformanceInfo(this)) != NO_ERROR) {
                 DISPLAY_LOGE("deliverPerformanceInfo() error (%d) in validateSkip case", ret);
             }
             startPostProcessing();
@@ -3792,6 +4020,7 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
         (mType != HWC_DISPLAY_VIRTUAL)) {
         ALOGI("%s:: layer size is 0", __func__);
         clearDisplay();
+        mDamageTracker.invalidate();
         *outRetireFence = -1;
         mLastRetireFence = fence_close(mLastRetireFence, this,
                 FENCE_TYPE_RETIRE, FENCE_IP_DPP);
@@ -3803,6 +4032,7 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
     if (!checkFrameValidation()) {
         ALOGW("%s: checkFrameValidation fail", __func__);
         clearDisplay();
+        mDamageTracker.invalidate();
         *outRetireFence = -1;
         mLastRetireFence = fence_close(mLastRetireFence, this,
                 FENCE_TYPE_RETIRE, FENCE_IP_DPP);
@@ -3881,6 +4111,8 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
 
     setDisplayWinConfigData();
 
+    readbackCapture = mReadbackEngine && mReadbackEngine->prepareCapture(mDpuData);
+
     if ((ret = deliverWinConfigData()) != NO_ERROR) {
         HWC_LOGE(this, "%s:: fail to deliver win_config (%d)", __func__, ret);
         if (mDpuData.retire_fence > 0)
@@ -3888,6 +4120,12 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
         mDpuData.retire_fence = -1;
     }
 
+    if (readbackCapture) {
+        mReadbackEngine->onCommitted(mDpuData, ret == NO_ERROR);
+    }
+    /* The damage of a frame that did not reach the panel goes with the next one */
+    mDamageTracker.endFrame(ret == NO_ERROR);
+
     setReleaseFences();
 
     if (mBufferDumpNum < mBufferDumpCount) {
@@ -4017,8 +4255,6 @@ not_validated:
 int32_t ExynosDisplay::presentPostProcessing()
 {
     setReadbackBufferInternal(NULL, -1, false);
-    if (mDpuData.enable_readback)
-        mDevice->signalReadbackDone();
     mDpuData.enable_readback = false;
 
     for (auto it : mIgnoreLayers) {
@@ -4935,6 +5171,11 @@ int32_t ExynosDisplay::validateDisplay(
             mDevice->dynamicRecompositionThreadCreate();
     }
 
+    /*
+     * Rebalances the MPP partition if needed and keeps the MPPs of this display
+     * in place until validation is done
+     */
+    auto partitionLease = mResourceManager->acquirePartitionLease(this, true);
     if ((ret = mResourceManager->assignResource(this)) != NO_ERROR) {
         validateError = true;
         HWC_LOGE(this, "%s:: assignResource() fail, display(%d), ret(%d)", __func__, mDisplayId, ret);
@@ -4968,7 +5209,7 @@ int32_t ExynosDisplay::validateDisplay(
      * if there is no buffer update. (using ExynosMPP::canSkipProcessing())
      * Therefore performanceInfo should be calculated again if only the buffer is updated.
      */
-    if ((ret = mDevice->mResourceManager->deliverPerformanceInfo()) != NO_ERROR) {
+    if ((ret = mDevice->mResourceManager->deliverPerformanceInfo(this)) != NO_ERROR) {
         HWC_LOGE(NULL,"%s:: deliverPerformanceInfo() error (%d)",
                 __func__, ret);
     }
@@ -5145,6 +5386,35 @@ void ExynosDisplay::dumpLocked(String8& result) {
     if (mDisplayTe2Manager) {
         mDisplayTe2Manager->dump(result);
     }
+    if (mReadbackEngine) {
+        mReadbackEngine->dump(result);
+    }
+    if (exynosHWCControl.windowUpdate == 1) {
+        uint64_t partialFrames = mDamageTracker.getPartialCount();
+        result.appendFormat("window update: frames %" PRIu64 ", partial %" PRIu64
+                            " (avg area %.1f%%), carried %" PRIu64 "\n",
+                            mDamageTracker.getFrameCount(), partialFrames,
+                            partialFrames ? mDamageTracker.getPartialPermille() / 10.0 /
+                                            partialFrames
+                                          : 0.0,
+                            mDamageTracker.getCarriedCount());
+    }
+    if (mDisplayInterface) {
+        mDisplayInterface->dump(result);
+    }
+    if (mDisplayControl.preValidateAssignment) {
+        result.appendFormat("pre-validation: hits %" PRIu64 ", misses %" PRIu64
+                            ", fallbacks %" PRIu64 ", cached results %zu\n",
+                            mPreValidation.hits, mPreValidation.misses, mPreValidation.fallbacks,
+                            mPreValidation.results.size());
+    }
+    const auto logStats = mLogChannel->getStats();
+    result.appendFormat("log records: %" PRIu64 ", dropped %" PRIu64 ", written %" PRIu64
+                        " (%" PRIu64 " bytes, %" PRIu64 " flushes), write errors %" PRIu64
+                        ", max depth %u, waits %" PRIu64 "\n",
+                        logStats.records, logStats.dropped, logStats.written,
+                        logStats.writtenBytes, logStats.flushes, logStats.writeErrors,
+                        logStats.maxDepth, logStats.waits);
 }
 
 void ExynosDisplay::dumpConfig(String8 &result, const exynos_win_config_data &c)
@@ -5172,6 +5442,37 @@ void ExynosDisplay::dumpConfig(String8 &result, const exynos_win_config_data &c)
     }
 }
 
+void ExynosDisplay::dumpConfig(hwclog::WinConfigRecord &record, const exynos_win_config_data &c)
+{
+    record = {};
+    record.state = c.state;
+    record.color = c.color;
+    for (size_t i = 0; i < 3; i++)
+        record.fd[i] = c.fd_idma[i];
+    record.acqFence = c.acq_fence;
+    record.relFence = c.rel_fence;
+    const uint32_t src[] = {c.src.f_w, c.src.f_h, static_cast<uint32_t>(c.src.x),
+                            static_cast<uint32_t>(c.src.y), c.src.w, c.src.h};
+    const uint32_t dst[] = {c.dst.f_w, c.dst.f_h, static_cast<uint32_t>(c.dst.x),
+                            static_cast<uint32_t>(c.dst.y), c.dst.w, c.dst.h};
+    memcpy(record.srcFrame, src, sizeof(src));
+    memcpy(record.dstFrame, dst, sizeof(dst));
+    record.format = c.format;
+    record.planeAlpha = c.plane_alpha;
+    record.transform = c.transform;
+    record.dataSpace = c.dataspace;
+    record.hdrEnable = c.hdr_enable;
+    record.blending = c.blending;
+    record.protection = c.protection;
+    record.compressionType = c.compressionInfo.type;
+    record.compressionModifier = c.compressionInfo.modifier;
+    record.compSrc = c.comp_src;
+    record.transparentArea = {c.transparent_area.x, c.transparent_area.y, c.transparent_area.w,
+                              c.transparent_area.h};
+    record.blockArea = {c.block_area.x, c.block_area.y, c.block_area.w, c.block_area.h};
+    record.opaqueArea = {c.opaque_area.x, c.opaque_area.y, c.opaque_area.w, c.opaque_area.h};
+}
+
 void ExynosDisplay::printConfig(exynos_win_config_data &c)
 {
     ALOGD("\tstate = %u", c.state);
@@ -5748,6 +6049,16 @@ int ExynosDisplay::handleWindowUpdate()
     mDpuData.win_update_region.y = 0;
     mDpuData.win_update_region.h = mYres;
 
+    DamageTracker::Config damageConfig = mDamageTracker.getConfig();
+    damageConfig.width = mXres;
+    damageConfig.height = mYres;
+    mDamageTracker.configure(damageConfig);
+    mDamageTracker.beginFrame();
+    /* Anything but a partial update refreshes the whole panel */
+    funcReturnCallback damageCallback([&]() {
+        if (!mDpuData.enable_win_update) mDamageTracker.addFull();
+    });
+
     if (exynosHWCControl.windowUpdate != 1) return 0;
 
     if (mGeometryChanged != 0) {
@@ -5768,18 +6079,23 @@ int ExynosDisplay::handleWindowUpdate()
     if (windowUpdateExceptions())
         return 0;
 
-    hwc_rect mergedRect = {(int)mXres, (int)mYres, 0, 0};
     hwc_rect damageRect = {(int)mXres, (int)mYres, 0, 0};
+    std::vector<hwc_rect_t> damageRects;
+    auto addDamage = [&](const hwc_rect_t &rect) {
+        mDamageTracker.addDamage({rect.left, rect.top, rect.right, rect.bottom});
+    };
 
     for (size_t i = 0; i < mLayers.size(); i++) {
         if (mLayers[i]->mExynosCompositionType == HWC2_COMPOSITION_DISPLAY_DECORATION) {
             continue;
         }
-        excp = getLayerRegion(mLayers[i], &damageRect, eDamageRegionByDamage);
+        damageRects.clear();
+        excp = getLayerRegion(mLayers[i], &damageRect, eDamageRegionByDamage, &damageRects);
         if (excp == eDamageRegionPartial) {
             DISPLAY_LOGD(eDebugWindowUpdate, "layer(%zu) partial : %d, %d, %d, %d", i,
                     damageRect.left, damageRect.top, damageRect.right, damageRect.bottom);
-            mergedRect = expand(mergedRect, damageRect);
+            /* Each rect on its own, the tiles between them stay clean */
+            for (const auto &rect : damageRects) addDamage(rect);
         }
         else if (excp == eDamageRegionSkip) {
             int32_t windowIndex = mLayers[i]->mWindowIndex;
@@ -5792,11 +6108,11 @@ int ExynosDisplay::handleWindowUpdate()
                 damageRect.bottom = mLayers[i]->mDisplayFrame.bottom;
                 DISPLAY_LOGD(eDebugWindowUpdate, "Skip layer (origin) : %d, %d, %d, %d",
                         damageRect.left, damageRect.top, damageRect.right, damageRect.bottom);
-                mergedRect = expand(mergedRect, damageRect);
+                addDamage(damageRect);
                 hwc_rect prevDst = {mLastDpuData.configs[i].dst.x, mLastDpuData.configs[i].dst.y,
                     mLastDpuData.configs[i].dst.x + (int)mLastDpuData.configs[i].dst.w,
                     mLastDpuData.configs[i].dst.y + (int)mLastDpuData.configs[i].dst.h};
-                mergedRect = expand(mergedRect, prevDst);
+                addDamage(prevDst);
             } else {
                 DISPLAY_LOGD(eDebugWindowUpdate, "layer(%zu) skip", i);
                 continue;
@@ -5809,7 +6125,7 @@ int ExynosDisplay::handleWindowUpdate()
             damageRect.bottom = mLayers[i]->mDisplayFrame.bottom;
             DISPLAY_LOGD(eDebugWindowUpdate, "Full layer update : %d, %d, %d, %d", mLayers[i]->mDisplayFrame.left,
                     mLayers[i]->mDisplayFrame.top, mLayers[i]->mDisplayFrame.right, mLayers[i]->mDisplayFrame.bottom);
-            mergedRect = expand(mergedRect, damageRect);
+            addDamage(damageRect);
         }
         else {
             DISPLAY_LOGD(eDebugWindowUpdate, "Partial canceled, Skip reason (layer %zu) : %d", i, excp);
@@ -5817,20 +6133,22 @@ int ExynosDisplay::handleWindowUpdate()
         }
     }
 
-    if (mergedRect.left == (int32_t)mXres && mergedRect.right == 0 &&
-        mergedRect.top == (int32_t)mYres && mergedRect.bottom == 0) {
+    /* The DPU takes a single partial region, so this is the aligned bounds of the damage */
+    std::vector<DamageTracker::Rect> updateRects;
+    if (!mDamageTracker.compute(updateRects)) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "Partial canceled, damage carried from a dropped frame");
+        return 0;
+    }
+
+    if (updateRects.empty()) {
         DISPLAY_LOGD(eDebugWindowUpdate, "Partial canceled, All layer skiped" );
         return 0;
     }
 
-    DISPLAY_LOGD(eDebugWindowUpdate, "Partial(origin) : %d, %d, %d, %d",
+    const DamageTracker::Rect &mergedRect = updateRects[0];
+    DISPLAY_LOGD(eDebugWindowUpdate, "Partial(aligned) : %d, %d, %d, %d",
             mergedRect.left, mergedRect.top, mergedRect.right, mergedRect.bottom);
 
-    if (mergedRect.left < 0) mergedRect.left = 0;
-    if (mergedRect.right > (int32_t)mXres) mergedRect.right = mXres;
-    if (mergedRect.top < 0) mergedRect.top = 0;
-    if (mergedRect.bottom > (int32_t)mYres) mergedRect.bottom = mYres;
-
     if (mergedRect.left == 0 && mergedRect.right == (int32_t)mXres &&
         mergedRect.top == 0 && mergedRect.bottom == (int32_t)mYres) {
         DISPLAY_LOGD(eDebugWindowUpdate, "Partial : Full size");
@@ -5845,15 +6163,16 @@ int ExynosDisplay::handleWindowUpdate()
 
     mDpuData.enable_win_update = true;
     mDpuData.win_update_region.x = mergedRect.left;
-    mDpuData.win_update_region.w = WIDTH(mergedRect);
+    mDpuData.win_update_region.w = mergedRect.right - mergedRect.left;
     mDpuData.win_update_region.y = mergedRect.top;
-    mDpuData.win_update_region.h = HEIGHT(mergedRect);
+    mDpuData.win_update_region.h = mergedRect.bottom - mergedRect.top;
 
     DISPLAY_LOGD(eDebugWindowUpdate, "window update end ------------------");
     return 0;
 }
 
-unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect *rect_area, uint32_t regionType) {
+unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect *rect_area, uint32_t regionType,
+                                           std::vector<hwc_rect_t> *outRects) {
 
     android::Vector <hwc_rect_t> hwcRects;
     size_t numRects = 0;
@@ -5885,6 +6204,7 @@ unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect *rect_ar
                 rect_area->left = INT_MAX;
                 rect_area->top = INT_MAX;
                 rect_area->right = rect_area->bottom = 0;
+                if (outRects) outRects->clear();
                 return eDamageRegionFull;
             }
 
@@ -5899,6 +6219,7 @@ unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect *rect_ar
             adjustRect(rect, INT_MAX, INT_MAX);
             /* Get sums of rects */
             *rect_area = expand(*rect_area, rect);
+            if (outRects) outRects->push_back(rect);
         }
         return eDamageRegionPartial;
         break;
@@ -6249,6 +6570,23 @@ int32_t ExynosDisplay::getReadbackBufferFence(int32_t* outFence)
     return NO_ERROR;
 }
 
+int32_t ExynosDisplay::startReadbackCapture(const ReadbackEngine::Config& config,
+                                            std::shared_ptr<ReadbackEngine::Consumer> consumer) {
+    {
+        Mutex::Autolock lock(mDisplayMutex);
+        if (mReadbackEngine == nullptr) {
+            mReadbackEngine = std::make_unique<ReadbackEngine>(this);
+        }
+    }
+    return mReadbackEngine->start(config, std::move(consumer));
+}
+
+void ExynosDisplay::stopReadbackCapture() {
+    if (mReadbackEngine) {
+        mReadbackEngine->stop();
+    }
+}
+
 int32_t ExynosDisplay::setReadbackBufferAcqFence(int32_t acqFence) {
     if (mDpuData.readback_info.acq_fence >= 0) {
         mDpuData.readback_info.acq_fence =
@@ -6538,15 +6876,17 @@ int ExynosDisplay::lookupDisplayConfigs(const int32_t &width,
     constexpr auto nsecsPerMs = std::chrono::nanoseconds(1ms).count();
     const auto vsyncPeriod = nsecsPerSec / vsyncRate;
 
-    for (auto const& [config, mode] : mDisplayConfigs) {
-        long delta = abs(vsyncPeriod - mode.vsyncPeriod);
-        if ((width == 0 || width == mode.width) && (height == 0 || height == mode.height) &&
-            (delta < nsecsPerMs) && (fps == mode.refreshRate)) {
-            ALOGD("%s: found display config for mode: %dx%d@%d:%d config=%d",
-                 __func__, width, height, fps, vsyncRate, config);
-            *outConfig = config;
-            return HWC2_ERROR_NONE;
-        }
+    // Any vsync period within 1ms of the requested one
+    const auto config =
+            mDisplayConfigIndex.lookup(width, height,
+                                       static_cast<int64_t>(floor(vsyncPeriod - nsecsPerMs)) + 1,
+                                       static_cast<int64_t>(ceil(vsyncPeriod + nsecsPerMs)) - 1,
+                                       fps);
+    if (config) {
+        ALOGD("%s: found display config for mode: %dx%d@%d:%d config=%d",
+             __func__, width, height, fps, vsyncRate, *config);
+        *outConfig = *config;
+        return HWC2_ERROR_NONE;
     }
 
     return HWC2_ERROR_BAD_CONFIG;
@@ -6556,122 +6896,47 @@ int ExynosDisplay::lookupDisplayConfigsRelaxed(const int32_t &width,
                                                const int32_t &height,
                                                const int32_t &fps,
                                                int32_t *outConfig) {
-    if (fps <= 1)
+    if (fps <= 1 || width <= 0 || height <= 0)
         return HWC2_ERROR_BAD_CONFIG;
 
     const auto vsyncPeriod = nsecsPerSec / fps;
-    const auto vsyncPeriodMin = nsecsPerSec / (fps + 1);
-    const auto vsyncPeriodMax = nsecsPerSec / (fps - 1);
+    const auto vsyncPeriodMin = static_cast<int64_t>(ceil(nsecsPerSec / (fps + 1)));
+    const auto vsyncPeriodMax = static_cast<int64_t>(floor(nsecsPerSec / (fps - 1)));
 
     // Search for exact match in resolution and vsync
-    for (auto const& [config, mode] : mDisplayConfigs) {
-        if (mode.width == width && mode.height == height && mode.vsyncPeriod == vsyncPeriod) {
-            ALOGD("%s: found exact match for mode %dx%d@%d -> config=%d",
-                 __func__, width, height, fps, config);
-            *outConfig = config;
-            return HWC2_ERROR_NONE;
-        }
+    std::optional<uint32_t> config;
+    if (vsyncPeriod == floor(vsyncPeriod))
+        config = mDisplayConfigIndex.lookup(width, height, static_cast<int64_t>(vsyncPeriod),
+                                            static_cast<int64_t>(vsyncPeriod));
+    if (config) {
+        ALOGD("%s: found exact match for mode %dx%d@%d -> config=%d",
+             __func__, width, height, fps, *config);
+        *outConfig = *config;
+        return HWC2_ERROR_NONE;
     }
 
     // Search for exact match in resolution, allow small variance in vsync
-    for (auto const& [config, mode] : mDisplayConfigs) {
-        if (mode.width == width && mode.height == height &&
-            mode.vsyncPeriod >= vsyncPeriodMin && mode.vsyncPeriod <= vsyncPeriodMax) {
-            ALOGD("%s: found close match for mode %dx%d@%d -> config=%d",
-                 __func__, width, height, fps, config);
-            *outConfig = config;
-            return HWC2_ERROR_NONE;
-        }
+    config = mDisplayConfigIndex.lookup(width, height, vsyncPeriodMin, vsyncPeriodMax);
+    if (config) {
+        ALOGD("%s: found close match for mode %dx%d@%d -> config=%d",
+             __func__, width, height, fps, *config);
+        *outConfig = *config;
+        return HWC2_ERROR_NONE;
     }
 
     // Search for smaller resolution, allow small variance in vsync
-    // mDisplayConfigs is sorted, so this will give the largest available option
-    for (auto const& [config, mode] : mDisplayConfigs) {
-        if (mode.width <= width && mode.height <= height &&
-            mode.vsyncPeriod >= vsyncPeriodMin && mode.vsyncPeriod <= vsyncPeriodMax) {
-            ALOGD("%s: found relaxed match for mode %dx%d@%d -> config=%d",
-                 __func__, width, height, fps, config);
-            *outConfig = config;
-            return HWC2_ERROR_NONE;
-        }
+    // This gives the lowest config id, as the scan over mDisplayConfigs did
+    config = mDisplayConfigIndex.lookupFitting(width, height, vsyncPeriodMin, vsyncPeriodMax);
+    if (config) {
+        ALOGD("%s: found relaxed match for mode %dx%d@%d -> config=%d",
+             __func__, width, height, fps, *config);
+        *outConfig = *config;
+        return HWC2_ERROR_NONE;
     }
 
     return HWC2_ERROR_BAD_CONFIG;
 }
 
-FILE *ExynosDisplay::RotatingLogFileWriter::openLogFile(const std::string &filename,
-                                                        const std::string &mode) {
-    FILE *file = nullptr;
-    auto fullpath = std::string(ERROR_LOG_PATH0) + "/" + filename;
-    file = fopen(fullpath.c_str(), mode.c_str());
-    if (file != nullptr) {
-        return file;
-    }
-    ALOGE("Fail to open file %s, error: %s", fullpath.c_str(), strerror(errno));
-    fullpath = std::string(ERROR_LOG_PATH1) + "/" + filename;
-    file = fopen(fullpath.c_str(), mode.c_str());
-    if (file == nullptr) {
-        ALOGE("Fail to open file %s, error: %s", fullpath.c_str(), strerror(errno));
-    }
-    return file;
-}
-
-std::optional<nsecs_t> ExynosDisplay::RotatingLogFileWriter::getLastModifiedTimestamp(
-        const std::string &filename) {
-    struct stat fileStat;
-    auto fullpath = std::string(ERROR_LOG_PATH0) + "/" + filename;
-    if (stat(fullpath.c_str(), &fileStat) == 0) {
-        return fileStat.st_mtim.tv_sec * nsecsPerSec + fileStat.st_mtim.tv_nsec;
-    }
-    fullpath = std::string(ERROR_LOG_PATH1) + "/" + filename;
-    if (stat(fullpath.c_str(), &fileStat) == 0) {
-        return fileStat.st_mtim.tv_sec * nsecsPerSec + fileStat.st_mtim.tv_nsec;
-    }
-    return std::nullopt;
-}
-
-bool ExynosDisplay::RotatingLogFileWriter::chooseOpenedFile() {
-    if (mLastFileIndex < 0) {
-        // HWC could be restarted, so choose to open new file or continue the last modified file
-        int chosenIndex = 0;
-        nsecs_t lastModifTimestamp = 0;
-        for (int i = 0; i < mMaxFileCount; ++i) {
-            auto timestamp = getLastModifiedTimestamp(mPrefixName + std::to_string(i) + mExtension);
-            if (!timestamp.has_value()) {
-                chosenIndex = i;
-                break;
-            }
-            if (i == 0 || lastModifTimestamp < *timestamp) {
-                chosenIndex = i;
-                lastModifTimestamp = *timestamp;
-            }
-        }
-        auto filename = mPrefixName + std::to_string(chosenIndex) + mExtension;
-        mFile = openLogFile(filename, "ab");
-        if (mFile == nullptr) {
-            ALOGE("Unable to open log file for %s", filename.c_str());
-            return false;
-        }
-        mLastFileIndex = chosenIndex;
-    }
-
-    // Choose to use the same last file or move on to the next file
-    for (int i = 0; i < 2; ++i) {
-        if (mFile == nullptr) {
-            mFile = openLogFile(mPrefixName + std::to_string(mLastFileIndex) + mExtension,
-                                (i == 0) ? "ab" : "wb");
-        }
-        if (mFile != nullptr) {
-            auto fileSize = ftell(mFile);
-            if (fileSize < mThresholdSizePerFile) return true;
-            fclose(mFile);
-            mFile = nullptr;
-        }
-        mLastFileIndex = (mLastFileIndex + 1) % mMaxFileCount;
-    }
-    return false;
-}
-
 void ExynosDisplay::invalidate() {
     mDevice->onRefresh(mDisplayId);
 }
@@ -6909,28 +7174,20 @@ uint32_t ExynosDisplay::getPeakRefreshRate() {
 }
 
 VsyncPeriodNanos ExynosDisplay::getVsyncPeriod(const int32_t config) {
-    const auto& it = mDisplayConfigs.find(config);
-    if (it == mDisplayConfigs.end()) return 0;
-    return it->second.vsyncPeriod;
+    const auto record = mDisplayConfigIndex.find(config);
+    if (!record) return 0;
+    return record->vsyncPeriod;
 }
 
 uint32_t ExynosDisplay::getRefreshRate(const int32_t config) {
-    const auto& it = mDisplayConfigs.find(config);
-    if (it == mDisplayConfigs.end()) return 0;
-    return it->second.refreshRate;
+    const auto record = mDisplayConfigIndex.find(config);
+    if (!record) return 0;
+    return record->refreshRate;
 }
 
 uint32_t ExynosDisplay::getConfigId(const int32_t refreshRate, const int32_t width,
                                     const int32_t height) {
-    for (auto entry : mDisplayConfigs) {
-        auto config = entry.first;
-        auto displayCfg = entry.second;
-        if (getRefreshRate(config) == refreshRate && displayCfg.width == width &&
-            displayCfg.height == height) {
-            return config;
-        }
-    }
-    return UINT_MAX;
+    return mDisplayConfigIndex.lookupRefreshRate(width, height, refreshRate).value_or(UINT_MAX);
 }
 
 void ExynosDisplay::resetColorMappingInfoForClientComp() {
@@ -26,9 +26,14 @@
 
 #include <atomic>
 #include <chrono>
+#include <list>
 #include <set>
+#include <unordered_map>
 
+#include "AsyncLogSink.h"
+#include "DamageTracker.h"
 #include "DeconHeader.h"
+#include "DisplayConfigIndex.h"
 #include "ExynosDisplayInterface.h"
 #include "ExynosHWC.h"
 #include "ExynosHWCDebug.h"
@@ -36,6 +41,7 @@
 #include "ExynosHwc3Types.h"
 #include "ExynosMPP.h"
 #include "ExynosResourceManager.h"
+#include "ReadbackEngine.h"
 #include "drmeventlistener.h"
 #include "worker.h"
 
@@ -191,6 +197,11 @@ struct exynos_readback_info
     int acq_fence = -1;
     /* Requested from HWCService */
     bool requested_from_service = false;
+    /* Size of the buffer if it is not the display size */
+    uint32_t width = 0;
+    uint32_t height = 0;
+    /* Keep the writeback connector attached to the CRTC without a buffer */
+    bool keep_connector = false;
 };
 
 struct exynos_win_config_data
@@ -339,6 +350,7 @@ class ExynosCompositionInfo : public ExynosMPPSource {
                 int32_t acquireFence, android_dataspace dataspace);
         void setCompressionType(uint32_t compressionType);
         void dump(String8& result) const;
+        void dump(hwclog::CompositionInfoRecord& record) const;
         String8 getTypeStr();
 };
 
@@ -440,6 +452,8 @@ struct DisplayControl {
     bool skipM2mProcessing = true;
     /** Enable multi-thread present **/
     bool multiThreadedPresent = false;
+    /** Check resource assignment with TEST_ONLY commit **/
+    bool preValidateAssignment = false;
 };
 
 class ExynosDisplay {
@@ -595,6 +609,21 @@ class ExynosDisplay {
 
         std::unique_ptr<DisplayTe2Manager> mDisplayTe2Manager;
 
+        /*
+         * Results of TEST_ONLY commits keyed by the signature of window configs.
+         * The most recently used result is at the front of the list, the least
+         * recently used one is evicted when the list is full.
+         */
+        struct PreValidationInfo {
+            static constexpr size_t kMaxResults = 64;
+            using ResultList = std::list<std::pair<uint64_t, bool>>;
+            ResultList results;
+            std::unordered_map<uint64_t, ResultList::iterator> resultIndex;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t fallbacks = 0;
+        } mPreValidation;
+
         /* For debugging */
         hwc_display_contents_1_t *mHWC1LayerList;
         int mBufferDumpCount = 0;
@@ -608,6 +637,10 @@ class ExynosDisplay {
         int32_t mDeviceYres;
         ResolutionInfo mResolutionInfo;
         std::map<uint32_t, displayConfigs_t> mDisplayConfigs;
+        // Lookup tables over mDisplayConfigs, rebuilt by updateDisplayConfigIndex()
+        DisplayConfigIndex mDisplayConfigIndex;
+        // Damage of the partial window update, carried over frames that were dropped
+        DamageTracker mDamageTracker;
 
         // WCG
         android_color_mode_t mColorMode;
@@ -693,6 +726,19 @@ class ExynosDisplay {
 
         virtual int deliverWinConfigData();
 
+        /*
+         * Checks the window configs of the layers that are directly assigned to
+         * otfMPPs with a TEST_ONLY commit. If they are rejected, @outRejected is
+         * set to the layer that should not use otfMPP.
+         */
+        int32_t testWinConfigData(ExynosLayer *&outRejected);
+        int32_t testWinConfigs(const std::vector<exynos_win_config_data> &configs);
+        /*
+         * Config of the client target for a TEST_ONLY commit. The target of this
+         * frame is not set yet, the last one stands in for it.
+         */
+        bool configureTestClientTarget(exynos_win_config_data &config);
+
         virtual int setReleaseFences();
 
         virtual bool checkFrameValidation();
@@ -1244,6 +1290,10 @@ class ExynosDisplay {
         int32_t getReadbackBufferFence(int32_t* outFence);
         /* This function is called by ExynosDisplayInterface class to set acquire fence*/
         int32_t setReadbackBufferAcqFence(int32_t acqFence);
+        /* Captures the following frames and passes them to consumer asynchronously */
+        int32_t startReadbackCapture(const ReadbackEngine::Config& config,
+                                     std::shared_ptr<ReadbackEngine::Consumer> consumer);
+        void stopReadbackCapture();
 
         int32_t uncacheLayerBuffers(ExynosLayer* layer, const std::vector<buffer_handle_t>& buffers,
                                     std::vector<buffer_handle_t>& outClearableBuffers);
@@ -1256,10 +1306,12 @@ class ExynosDisplay {
 
         void dumpConfig(const exynos_win_config_data &c);
         void dumpConfig(String8 &result, const exynos_win_config_data &c);
+        void dumpConfig(hwclog::WinConfigRecord &record, const exynos_win_config_data &c);
         void printConfig(exynos_win_config_data &c);
 
         unsigned int getLayerRegion(ExynosLayer *layer,
-                hwc_rect *rect_area, uint32_t regionType);
+                hwc_rect *rect_area, uint32_t regionType,
+                std::vector<hwc_rect_t> *outRects = nullptr);
 
         int handleWindowUpdate();
         bool windowUpdateExceptions();
@@ -1314,6 +1366,8 @@ class ExynosDisplay {
 
         virtual bool isLhbmSupported() { return false; }
         virtual int32_t setLhbmState(bool __unused enabled) { return NO_ERROR; }
+        // Prepares for setLhbmState(true) while the fingerprint sensor is active
+        virtual int32_t setLhbmArmed(bool __unused armed) { return NO_ERROR; }
         virtual bool getLhbmState() { return false; };
         virtual void setEarlyWakeupDisplay() {}
         virtual void setExpectedPresentTime(uint64_t __unused timestamp,
@@ -1401,6 +1455,8 @@ class ExynosDisplay {
          * interface type.
          */
         std::unique_ptr<ExynosDisplayInterface> mDisplayInterface;
+        /* Created by the first startReadbackCapture() */
+        std::unique_ptr<ReadbackEngine> mReadbackEngine;
         void requestLhbm(bool on);
 
         virtual int32_t setMinIdleRefreshRate(const int __unused fps,
@@ -1426,6 +1482,8 @@ class ExynosDisplay {
         VsyncPeriodNanos getVsyncPeriod(const int32_t config);
         uint32_t getRefreshRate(const int32_t config);
         uint32_t getConfigId(const int32_t refreshRate, const int32_t width, const int32_t height);
+        // Must be called whenever mDisplayConfigs is changed
+        void updateDisplayConfigIndex() { mDisplayConfigIndex.build(mDisplayConfigs); }
 
         // check if there are any dimmed layers
         bool isMixedComposition();
@@ -1677,50 +1735,8 @@ class ExynosDisplay {
         // Resource TDM (Time-Division Multiplexing)
         std::map<std::pair<int32_t, int32_t>, DisplayTDMInfo> mDisplayTDMInfo;
 
-        class RotatingLogFileWriter {
-        public:
-            RotatingLogFileWriter(uint32_t maxFileCount, uint32_t thresholdSizePerFile,
-                                  std::string extension = ".txt")
-                  : mMaxFileCount(maxFileCount),
-                    mThresholdSizePerFile(thresholdSizePerFile),
-                    mPrefixName(""),
-                    mExtension(extension),
-                    mLastFileIndex(-1),
-                    mFile(nullptr) {}
-
-            ~RotatingLogFileWriter() {
-                if (mFile) {
-                    fclose(mFile);
-                }
-            }
-
-            bool chooseOpenedFile();
-            void write(const String8& content) {
-                if (mFile) {
-                    fwrite(content.c_str(), 1, content.size(), mFile);
-                }
-            }
-            void flush() {
-                if (mFile) {
-                    fflush(mFile);
-                }
-            }
-            void setPrefixName(const std::string& prefixName) { mPrefixName = prefixName; }
-
-        private:
-            FILE* openLogFile(const std::string& filename, const std::string& mode);
-            std::optional<nsecs_t> getLastModifiedTimestamp(const std::string& filename);
-
-            uint32_t mMaxFileCount;
-            uint32_t mThresholdSizePerFile;
-            std::string mPrefixName;
-            std::string mExtension;
-            int32_t mLastFileIndex;
-            FILE* mFile;
-        };
-        mutable RotatingLogFileWriter mErrLogFileWriter;
-        RotatingLogFileWriter mDebugDumpFileWriter;
-        RotatingLogFileWriter mFenceFileWriter;
+        // Error, debug and fence logs, written to files by AsyncLogSink
+        std::shared_ptr<AsyncLogSink::Channel> mLogChannel;
 
     protected:
         class OperationRateManager {
@@ -71,7 +71,8 @@ ExynosLayer::ExynosLayer(ExynosDisplay* display)
         mLayerFlag(0x0),
         mIsHdrLayer(false),
         mBufferHasMetaParcel(false),
-        mMetaParcelFd(-1) {
+        mMetaParcelFd(-1),
+        mColorDataChanged(LAYER_COLOR_ALL_CHANGED) {
     memset(&mDisplayFrame, 0, sizeof(mDisplayFrame));
     memset(&mSourceCrop, 0, sizeof(mSourceCrop));
     mVisibleRegionScreen.numRects = 0;
@@ -161,6 +162,7 @@ float ExynosLayer::getFps() {
 int32_t ExynosLayer::doPreProcess()
 {
     overlay_priority priority = ePriorityLow;
+    bool wasHdrLayer = mIsHdrLayer;
     mIsHdrLayer = false;
     mBufferHasMetaParcel = false;
     mLayerFlag = 0x0;
@@ -221,8 +223,14 @@ int32_t ExynosLayer::doPreProcess()
                 if ((metaData->eType & VIDEO_INFO_TYPE_HDR_STATIC) ||
                         (metaData->eType & VIDEO_INFO_TYPE_HDR_DYNAMIC)) {
                     if (allocMetaParcel() == NO_ERROR) {
+                        if (mMetaParcel->eType != metaData->eType)
+                            setColorDataChanged(LAYER_COLOR_HDR_STATIC_CHANGED |
+                                                LAYER_COLOR_HDR_DYNAMIC_CHANGED);
                         mMetaParcel->eType = metaData->eType;
                         if (metaData->eType & VIDEO_INFO_TYPE_HDR_STATIC) {
+                            if (memcmp(&mMetaParcel->sHdrStaticInfo, &metaData->sHdrStaticInfo,
+                                       sizeof(metaData->sHdrStaticInfo)) != 0)
+                                setColorDataChanged(LAYER_COLOR_HDR_STATIC_CHANGED);
                             mMetaParcel->sHdrStaticInfo = metaData->sHdrStaticInfo;
                             HDEBUGLOGD(eDebugLayer, "HWC2: Static metadata min(%d), max(%d)",
                                     mMetaParcel->sHdrStaticInfo.sType1.mMinDisplayLuminance,
@@ -231,6 +239,9 @@ int32_t ExynosLayer::doPreProcess()
                         if (metaData->eType & VIDEO_INFO_TYPE_HDR_DYNAMIC) {
                             /* Reserved field for dynamic meta data */
                             /* Currently It's not be used not only HWC but also OMX */
+                            if (memcmp(&mMetaParcel->sHdrDynamicInfo, &metaData->sHdrDynamicInfo,
+                                       sizeof(metaData->sHdrDynamicInfo)) != 0)
+                                setColorDataChanged(LAYER_COLOR_HDR_DYNAMIC_CHANGED);
                             mMetaParcel->sHdrDynamicInfo = metaData->sHdrDynamicInfo;
                             HDEBUGLOGD(eDebugLayer, "HWC2: Layer has dynamic metadata");
                         }
@@ -274,6 +285,9 @@ int32_t ExynosLayer::doPreProcess()
 
     /* Set HDR Flag */
     if(hasHdrInfo(src_img)) mIsHdrLayer = true;
+    if (mIsHdrLayer != wasHdrLayer)
+        setColorDataChanged(LAYER_COLOR_HDR_STATIC_CHANGED | LAYER_COLOR_HDR_DYNAMIC_CHANGED |
+                            LAYER_COLOR_TRANSFORM_CHANGED);
 
     if (isFormatYUV(gmeta.format) && exynosMPPVG) {
         /*
@@ -499,6 +513,9 @@ int32_t ExynosLayer::setLayerBlendMode(int32_t /*hwc2_blend_mode_t*/ mode) {
 
 int32_t ExynosLayer::setLayerColor(hwc_color_t color) {
     /* TODO : Implementation here */
+    if ((color.r != mColor.r) || (color.g != mColor.g) || (color.b != mColor.b) ||
+        (color.a != mColor.a))
+        setColorDataChanged(LAYER_COLOR_SOLID_COLOR_CHANGED);
     mColor = color;
     return 0;
 }
@@ -518,6 +535,7 @@ int32_t ExynosLayer::setLayerCompositionType(int32_t /*hwc2_composition_t*/ type
 
     if (type != mCompositionType) {
         setGeometryChanged(GEOMETRY_LAYER_TYPE_CHANGED);
+        setColorDataChanged(LAYER_COLOR_SOLID_COLOR_CHANGED);
     }
 
     mCompositionType = type;
@@ -559,6 +577,8 @@ int32_t ExynosLayer::setLayerDataspace(int32_t /*android_dataspace_t*/ dataspace
 
     if (currentDataSpace != mDataSpace) {
         setGeometryChanged(GEOMETRY_LAYER_DATASPACE_CHANGED);
+        setColorDataChanged(LAYER_COLOR_DATASPACE_CHANGED | LAYER_COLOR_HDR_STATIC_CHANGED |
+                            LAYER_COLOR_HDR_DYNAMIC_CHANGED);
         // invalidate metadata if dataspace is changed. need metadata update
         // to be after dataspace update.
         if (mMetaParcel != nullptr) {
@@ -647,6 +667,8 @@ int32_t ExynosLayer::setLayerPerFrameMetadata(uint32_t numElements,
 {
     if (allocMetaParcel() != NO_ERROR)
         return -1;
+    ExynosHdrStaticInfo prevStaticInfo = mMetaParcel->sHdrStaticInfo;
+    ExynosVideoInfoType prevType = mMetaParcel->eType;
     unsigned int multipliedVal = 50000;
     mMetaParcel->eType =
         static_cast<ExynosVideoInfoType>(mMetaParcel->eType | VIDEO_INFO_TYPE_HDR_STATIC);
@@ -705,9 +727,13 @@ int32_t ExynosLayer::setLayerPerFrameMetadata(uint32_t numElements,
                     (unsigned int)(metadata[i]);
                 break;
             default:
+                setColorDataChanged(LAYER_COLOR_HDR_STATIC_CHANGED);
                 return HWC2_ERROR_UNSUPPORTED;
         }
     }
+    if ((prevType != mMetaParcel->eType) ||
+        (memcmp(&prevStaticInfo, &mMetaParcel->sHdrStaticInfo, sizeof(prevStaticInfo)) != 0))
+        setColorDataChanged(LAYER_COLOR_HDR_STATIC_CHANGED);
     return NO_ERROR;
 }
 
@@ -720,11 +746,16 @@ int32_t ExynosLayer::setLayerPerFrameMetadataBlobs(uint32_t numElements, const i
         switch (keys[i]) {
         case HWC2_HDR10_PLUS_SEI:
             if (allocMetaParcel() == NO_ERROR) {
+                if (!(mMetaParcel->eType & VIDEO_INFO_TYPE_HDR_DYNAMIC))
+                    setColorDataChanged(LAYER_COLOR_HDR_DYNAMIC_CHANGED);
                 mMetaParcel->eType =
                     static_cast<ExynosVideoInfoType>(mMetaParcel->eType | VIDEO_INFO_TYPE_HDR_DYNAMIC);
                 ExynosHdrDynamicInfo *info = &(mMetaParcel->sHdrDynamicInfo);
+                ExynosHdrDynamicInfo prevInfo = *info;
                 Exynos_parsing_user_data_registered_itu_t_t35(info, (void*)metadata_start,
                                                               sizes[i]);
+                if (memcmp(&prevInfo, info, sizeof(prevInfo)) != 0)
+                    setColorDataChanged(LAYER_COLOR_HDR_DYNAMIC_CHANGED);
             } else {
                 ALOGE("Layer has no metaParcel!");
                 return HWC2_ERROR_UNSUPPORTED;
@@ -740,6 +771,10 @@ int32_t ExynosLayer::setLayerPerFrameMetadataBlobs(uint32_t numElements, const i
 
 int32_t ExynosLayer::setLayerColorTransform(const float* matrix)
 {
+    if (!mLayerColorTransform.enable ||
+        !std::equal(mLayerColorTransform.mat.begin(), mLayerColorTransform.mat.end(), matrix))
+        setColorDataChanged(LAYER_COLOR_TRANSFORM_CHANGED);
+
     mLayerColorTransform.enable = true;
     for (uint32_t i = 0; i < TRANSFORM_MAT_SIZE; i++)
     {
@@ -774,6 +809,7 @@ int32_t ExynosLayer::setLayerBrightness(float brightness) {
     if (mBrightness != brightness) {
         // Trigger display validation in case client composition is needed.
         setGeometryChanged(GEOMETRY_LAYER_WHITEPOINT_CHANGED);
+        setColorDataChanged(LAYER_COLOR_DIM_CHANGED);
         mBrightness = brightness;
     }
     return HWC2_ERROR_NONE;
@@ -1122,6 +1158,51 @@ void ExynosLayer::dump(String8& result)
 
 }
 
+void ExynosLayer::dump(hwclog::LayerRecord& record)
+{
+    record = {};
+    record.format = HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED;
+    record.fd[0] = record.fd[1] = record.fd[2] = -1;
+    if (mLayerBuffer != NULL) {
+        VendorGraphicBufferMeta gmeta(mLayerBuffer);
+        record.format = gmeta.format;
+        record.fd[0] = gmeta.fd;
+        record.fd[1] = gmeta.fd1;
+        record.fd[2] = gmeta.fd2;
+        record.bufferId = gmeta.unique_id;
+    }
+
+    record.zOrder = mZOrder;
+    record.priority = mOverlayPriority;
+    record.color[0] = mColor.r;
+    record.color[1] = mColor.g;
+    record.color[2] = mColor.b;
+    record.color[3] = mColor.a;
+    record.handle = reinterpret_cast<uintptr_t>(mLayerBuffer);
+    record.compressionType = mCompressionInfo.type;
+    record.compressionModifier = mCompressionInfo.modifier;
+    record.dataSpace = mDataSpace;
+    record.colorTransform = mLayerColorTransform.enable;
+    record.blending = mBlending;
+    record.planeAlpha = mPlaneAlpha;
+    record.fps = mFps;
+    record.sourceCrop = {mPreprocessedInfo.sourceCrop.left, mPreprocessedInfo.sourceCrop.top,
+                         mPreprocessedInfo.sourceCrop.right, mPreprocessedInfo.sourceCrop.bottom};
+    record.displayFrame = {mPreprocessedInfo.displayFrame.left, mPreprocessedInfo.displayFrame.top,
+                           mPreprocessedInfo.displayFrame.right,
+                           mPreprocessedInfo.displayFrame.bottom};
+    record.blockingRect = {mBlockingRect.left, mBlockingRect.top, mBlockingRect.right,
+                           mBlockingRect.bottom};
+    record.transform = mTransform;
+    record.windowIndex = mWindowIndex;
+    record.compositionType = mCompositionType;
+    record.exynosCompositionType = mExynosCompositionType;
+    record.validateCompositionType = mValidateCompositionType;
+    record.overlayInfo = mOverlayInfo;
+    record.supportedMPPFlag = mSupportedMPPFlag;
+    record.sdrDimRatio = mPreprocessedInfo.sdrDimRatio;
+}
+
 void ExynosLayer::printLayer()
 {
     int format = HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED;
@@ -82,6 +82,17 @@ enum {
     HWC2_COMPOSITION_EXYNOS = 32,
 };
 
+/* Color data of a layer that changed since DisplaySceneInfo last read it */
+enum {
+    LAYER_COLOR_DATASPACE_CHANGED   = 1 << 0,
+    LAYER_COLOR_HDR_STATIC_CHANGED  = 1 << 1,
+    LAYER_COLOR_HDR_DYNAMIC_CHANGED = 1 << 2,
+    LAYER_COLOR_TRANSFORM_CHANGED   = 1 << 3,
+    LAYER_COLOR_SOLID_COLOR_CHANGED = 1 << 4,
+    LAYER_COLOR_DIM_CHANGED         = 1 << 5,
+    LAYER_COLOR_ALL_CHANGED         = (1 << 6) - 1,
+};
+
 class ExynosLayer : public ExynosMPPSource {
     public:
 
@@ -278,6 +289,12 @@ class ExynosLayer : public ExynosMPPSource {
             std::array<float, TRANSFORM_MAT_SIZE> mat;
         } mLayerColorTransform;
 
+        /**
+         * LAYER_COLOR_*_CHANGED bits, cleared when DisplaySceneInfo
+         * rebuilds the color data of the layer
+         */
+        uint32_t mColorDataChanged;
+
         /**
          * @param type
          */
@@ -476,6 +493,8 @@ class ExynosLayer : public ExynosMPPSource {
 
         void resetValidateData();
         virtual void dump(String8& result);
+        // What dump() prints of the layer, without the MPP details
+        void dump(hwclog::LayerRecord& record);
         void printLayer();
         int32_t setSrcExynosImage(exynos_image *src_img);
         int32_t setDstExynosImage(exynos_image *dst_img);
@@ -508,6 +527,8 @@ class ExynosLayer : public ExynosMPPSource {
         size_t getDisplayFrameArea() { return HEIGHT(mDisplayFrame) * WIDTH(mDisplayFrame); }
         void setGeometryChanged(uint64_t changedBit);
         void clearGeometryChanged() {mGeometryChanged = 0;};
+        void setColorDataChanged(uint32_t changedBit) { mColorDataChanged |= changedBit; };
+        void clearColorDataChanged() { mColorDataChanged = 0; };
         bool isDimLayer();
         const ExynosVideoMeta* getMetaParcel() { return mMetaParcel; };
 
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "HwcLogRecord.h"
+
+/*
+ * hwclog_decode <file>...
+ *
+ * Prints the HWC logs written by AsyncLogSink, e.g. the
+ * /data/vendor/log/hwc/<display>_hwc_error_log<N>.hwclog files pulled from a
+ * device.
+ */
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file>...\n", argv[0]);
+        return 1;
+    }
+
+    int ret = 0;
+    for (int i = 1; i < argc; i++) {
+        FILE* file = fopen(argv[i], "rb");
+        if (file == nullptr) {
+            fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+            ret = 1;
+            continue;
+        }
+
+        std::string text;
+        if (argc > 2) printf("==== %s ====\n", argv[i]);
+        if (!hwclog::decodeFile(file, text)) ret = 1;
+        fwrite(text.data(), 1, text.size(), stdout);
+        fclose(file);
+    }
+
+    return ret;
+}
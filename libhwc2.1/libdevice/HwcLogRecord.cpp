@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HwcLogRecord.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+namespace hwclog {
+
+namespace {
+
+__attribute__((format(printf, 2, 3))) void appendFormat(std::string& out, const char* fmt, ...) {
+    char buf[1024];
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    if (len > 0) out.append(buf, std::min(static_cast<size_t>(len), sizeof(buf) - 1));
+}
+
+// The format of getLocalTimeStr()
+void appendTime(std::string& out, int64_t timeNs) {
+    time_t sec = static_cast<time_t>(timeNs / 1000000000);
+    int64_t ms = (timeNs / 1000000) % 1000;
+    struct tm localTime;
+
+    localtime_r(&sec, &localTime);
+    appendFormat(out, "%02d-%02d %02d:%02d:%02d.%03" PRId64 "(%" PRId64 ")", localTime.tm_mon + 1,
+                 localTime.tm_mday, localTime.tm_hour, localTime.tm_min, localTime.tm_sec, ms,
+                 timeNs / 1000000);
+}
+
+// getCompressionStr() of ExynosHWCHelper.cpp, with the values of COMP_TYPE_*
+void appendCompression(std::string& out, uint32_t type, uint64_t modifier) {
+    switch (type) {
+        case 0x08000000:
+            out.append("None");
+            break;
+        case 0x00100000:
+            appendFormat(out, "AFBC(mod:0x%" PRIx64 ")", modifier);
+            break;
+        case 0x00200000:
+            appendFormat(out, "SBWC(mod:0x%" PRIx64 ")", modifier);
+            break;
+        default:
+            out.append("Unknown");
+            break;
+    }
+}
+
+void formatLayer(const LayerRecord& l, std::string& out) {
+    appendFormat(out, "%slayer[%u] zOrder: %u, priority: %u, ", l.ignored ? "ignored " : "",
+                 l.index, l.zOrder, l.priority);
+    appendFormat(out, "color: 0x%x, 0x%x, 0x%x, 0x%x, ", l.color[0], l.color[1], l.color[2],
+                 l.color[3]);
+    appendFormat(out, "handle: 0x%" PRIx64 ", fd: %d, %d, %d, compression: ", l.handle, l.fd[0],
+                 l.fd[1], l.fd[2]);
+    appendCompression(out, l.compressionType, l.compressionModifier);
+    out.append("\n");
+    appendFormat(out,
+                 "\tformat: 0x%x, dataSpace: 0x%x, colorTr: %u, blend: 0x%x, planeAlpha: %f, "
+                 "fps: %f\n",
+                 l.format, l.dataSpace, l.colorTransform, l.blending, l.planeAlpha, l.fps);
+    appendFormat(out, "\tsourceCrop: %f, %f, %f, %f, dispFrame: %d, %d, %d, %d, ",
+                 l.sourceCrop.left, l.sourceCrop.top, l.sourceCrop.right, l.sourceCrop.bottom,
+                 l.displayFrame.left, l.displayFrame.top, l.displayFrame.right,
+                 l.displayFrame.bottom);
+    appendFormat(out, "blockRect: %d, %d, %d, %d\n", l.blockingRect.left, l.blockingRect.top,
+                 l.blockingRect.right, l.blockingRect.bottom);
+    appendFormat(out,
+                 "\ttr: 0x%x, windowIndex: %u, type: %d, exynosType: %d, validateType: %d, "
+                 "overlayInfo: 0x%x, GrallocBufferId: %" PRIu64 "\n",
+                 l.transform, l.windowIndex, l.compositionType, l.exynosCompositionType,
+                 l.validateCompositionType, l.overlayInfo, l.bufferId);
+    appendFormat(out, "\tMPPFlag: 0x%" PRIx64 ", dim ratio: %f\n", l.supportedMPPFlag,
+                 l.sdrDimRatio);
+}
+
+void formatWinConfig(const WinConfigRecord& c, std::string& out) {
+    appendFormat(out, "config[%u]\n\tstate = %u\n", c.index, c.state);
+    // WIN_STATE_COLOR
+    if (c.state == 1) {
+        appendFormat(out,
+                     "\t\tx = %d, y = %d, width = %u, height = %u, color = %u, alpha = %f\n",
+                     c.dstFrame[2], c.dstFrame[3], c.dstFrame[4], c.dstFrame[5], c.color,
+                     c.planeAlpha);
+        return;
+    }
+
+    appendFormat(out,
+                 "\t\tfd = (%d, %d, %d), acq_fence = %d, rel_fence = %d "
+                 "src_f_w = %u, src_f_h = %u, src_x = %d, src_y = %d, src_w = %u, src_h = %u, "
+                 "dst_f_w = %u, dst_f_h = %u, dst_x = %d, dst_y = %d, dst_w = %u, dst_h = %u, ",
+                 c.fd[0], c.fd[1], c.fd[2], c.acqFence, c.relFence, c.srcFrame[0], c.srcFrame[1],
+                 static_cast<int32_t>(c.srcFrame[2]), static_cast<int32_t>(c.srcFrame[3]),
+                 c.srcFrame[4], c.srcFrame[5], c.dstFrame[0], c.dstFrame[1],
+                 static_cast<int32_t>(c.dstFrame[2]), static_cast<int32_t>(c.dstFrame[3]),
+                 c.dstFrame[4], c.dstFrame[5]);
+    appendFormat(out,
+                 "format = %u, pa = %f, transform = %d, dataspace = 0x%8x, hdr_enable = %d, "
+                 "blending = %u, protection = %u, compression = ",
+                 c.format, c.planeAlpha, c.transform, c.dataSpace, c.hdrEnable, c.blending,
+                 c.protection);
+    appendCompression(out, c.compressionType, c.compressionModifier);
+    appendFormat(out, ", compression_src = %d, ", c.compSrc);
+    appendFormat(out,
+                 "transparent(x:%d, y:%d, w:%u, h:%u), block(x:%d, y:%d, w:%u, h:%u), "
+                 "opaque(x:%d, y:%d, w:%u, h:%u)\n",
+                 c.transparentArea.x, c.transparentArea.y, c.transparentArea.w,
+                 c.transparentArea.h, c.blockArea.x, c.blockArea.y, c.blockArea.w, c.blockArea.h,
+                 c.opaqueArea.x, c.opaqueArea.y, c.opaqueArea.w, c.opaqueArea.h);
+}
+
+void formatCompositionInfo(const CompositionInfoRecord& c, std::string& out) {
+    appendFormat(out, "CompositionInfo (%u)\nmHasCompositionLayer(%u)\n", c.type,
+                 c.hasCompositionLayer);
+    if (c.hasCompositionLayer) {
+        appendFormat(out, "\tfirstIndex: %d, lastIndex: %d, dataSpace: 0x%8x, compression: ",
+                     c.firstIndex, c.lastIndex, c.dataSpace);
+        appendCompression(out, c.compressionType, c.compressionModifier);
+        appendFormat(out, ", windowIndex: %d\n", c.windowIndex);
+        appendFormat(out, "\thandle: 0x%" PRIx64 ", acquireFence: %d, releaseFence: %d, "
+                     "skipFlag: %u",
+                     c.handle, c.acquireFence, c.releaseFence, c.skipFlag);
+        if (!c.otfMPP[0] && !c.m2mMPP[0]) out.append("\tresource is not assigned\n");
+        if (c.otfMPP[0]) appendFormat(out, "\tassignedMPP: %.*s\n",
+                                      static_cast<int>(sizeof(c.otfMPP)), c.otfMPP);
+        if (c.m2mMPP[0]) appendFormat(out, "\t%.*s\n", static_cast<int>(sizeof(c.m2mMPP)),
+                                      c.m2mMPP);
+    }
+    if (c.handle) {
+        appendFormat(out, "\tinternal_format: 0x%" PRIx64 ", afbc: %u\n", c.internalFormat,
+                     c.afbc);
+    }
+    if (c.assignedSrcNum) appendFormat(out, "\tAssigned source num: %u\n", c.assignedSrcNum);
+    out.append("\n");
+}
+
+} // namespace
+
+void formatRecord(const RecordHeader& header, const void* payload, std::string& out) {
+    switch (header.type) {
+        case TYPE_TEXT:
+            out.append(static_cast<const char*>(payload), header.size);
+            break;
+        case TYPE_LAYER: {
+            LayerRecord layer = {};
+            memcpy(&layer, payload, std::min<size_t>(header.size, sizeof(layer)));
+            formatLayer(layer, out);
+            break;
+        }
+        case TYPE_WIN_CONFIG: {
+            WinConfigRecord config = {};
+            memcpy(&config, payload, std::min<size_t>(header.size, sizeof(config)));
+            formatWinConfig(config, out);
+            break;
+        }
+        case TYPE_COMPOSITION_INFO: {
+            CompositionInfoRecord info = {};
+            memcpy(&info, payload, std::min<size_t>(header.size, sizeof(info)));
+            formatCompositionInfo(info, out);
+            break;
+        }
+        case TYPE_FENCE: {
+            FenceRecord fence = {};
+            memcpy(&fence, payload, std::min<size_t>(header.size, sizeof(fence)));
+            appendFormat(out, "---- Fence FD : %d, Display(%u) ----\n", fence.fd,
+                         fence.displayId);
+            appendFormat(out, "usage: %d, dupFrom: %d, pendingAllowed: %u, leaking: %u\n",
+                         fence.usage, fence.dupFrom, fence.pendingAllowed, fence.leaking);
+            break;
+        }
+        case TYPE_FENCE_TRACE: {
+            FenceTraceRecord trace = {};
+            memcpy(&trace, payload, std::min<size_t>(header.size, sizeof(trace)));
+            appendFormat(out, "> dir: %u, type: %u, ip: %u, time:", trace.direction, trace.type,
+                         trace.ip);
+            appendTime(out, trace.timeUs * 1000);
+            out.append("\n");
+            break;
+        }
+        default:
+            appendFormat(out, "<unknown record type %u, %u bytes>\n", header.type, header.size);
+            break;
+    }
+}
+
+bool decodeFile(FILE* file, std::string& out) {
+    FileHeader fileHeader;
+    if ((fread(&fileHeader, sizeof(fileHeader), 1, file) != 1) ||
+        (memcmp(fileHeader.magic, kFileMagic, sizeof(kFileMagic)) != 0)) {
+        out.append("<not a HWC log file>\n");
+        return false;
+    }
+    if ((fileHeader.version != kVersion) || (fileHeader.headerSize != sizeof(RecordHeader))) {
+        appendFormat(out, "<unsupported version %u>\n", fileHeader.version);
+        return false;
+    }
+
+    bool continued = false;
+    RecordHeader header;
+    char payload[kMaxPayloadSize];
+
+    while (fread(&header, sizeof(header), 1, file) == 1) {
+        if ((header.sync != kRecordSync) || (header.size > sizeof(payload)) ||
+            (fread(payload, 1, header.size, file) != header.size)) {
+            out.append("<truncated record>\n");
+            return false;
+        }
+
+        if (header.dropped) {
+            if (continued) out.append("\n");
+            appendFormat(out, "<%u records dropped>\n", header.dropped);
+            continued = false;
+        }
+
+        if (!continued) {
+            out.append("[");
+            appendTime(out, header.timeNs);
+            out.append("] ");
+        }
+        formatRecord(header, payload, out);
+
+        continued = (header.type == TYPE_TEXT) && (header.flags & FLAG_CONTINUED);
+        if (!continued && (header.type == TYPE_TEXT) && (out.empty() || out.back() != '\n'))
+            out.append("\n");
+    }
+
+    return true;
+}
+
+} // namespace hwclog
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HWC_LOG_RECORD_H_
+#define _HWC_LOG_RECORD_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+/*
+ * Binary records of the HWC error, debug and fence logs.
+ *
+ * The composition thread copies what it logs into fixed size records and the
+ * log writer stores them as they are. Nothing is formatted before hwclog_decode
+ * turns a log file into text. A file starts with a FileHeader and holds
+ * RecordHeaders, each one followed by size bytes of payload.
+ *
+ * The layout only changes along with kVersion.
+ */
+namespace hwclog {
+
+constexpr char kFileMagic[8] = {'H', 'W', 'C', 'L', 'O', 'G', '\0', '\0'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kRecordSync = 0x48574352; // "HWCR"
+
+// Records are at most this large, including the header
+constexpr size_t kMaxRecordSize = 256;
+
+enum RecordType : uint16_t {
+    // Text formatted by the caller, split into several records if long
+    TYPE_TEXT = 1,
+    TYPE_LAYER = 2,
+    TYPE_WIN_CONFIG = 3,
+    TYPE_FENCE = 4,
+    TYPE_FENCE_TRACE = 5,
+    TYPE_COMPOSITION_INFO = 6,
+};
+
+enum Stream : uint8_t {
+    STREAM_ERROR = 0,
+    STREAM_DEBUG,
+    STREAM_FENCE,
+    STREAM_MAX,
+};
+
+// The text continues in the next record
+constexpr uint8_t FLAG_CONTINUED = 1 << 0;
+// First record of a dump, see AsyncLogSink::Channel::beginDump()
+constexpr uint8_t FLAG_DUMP_START = 1 << 1;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize; // sizeof(RecordHeader)
+};
+
+struct RecordHeader {
+    uint32_t sync;
+    uint16_t type;
+    uint8_t stream;
+    uint8_t flags;
+    uint16_t size;
+    // Records of the stream dropped by back-pressure right before this one
+    uint16_t dropped;
+    // Order of the records of a display
+    uint32_t seq;
+    // CLOCK_REALTIME
+    int64_t timeNs;
+};
+static_assert(sizeof(RecordHeader) == 24, "RecordHeader is part of the file format");
+
+constexpr size_t kMaxPayloadSize = kMaxRecordSize - sizeof(RecordHeader);
+
+struct Rect {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+struct FRect {
+    float left;
+    float top;
+    float right;
+    float bottom;
+};
+
+// What ExynosLayer::dump() prints
+struct LayerRecord {
+    uint32_t index;
+    uint32_t zOrder;
+    uint32_t priority;
+    uint8_t color[4];
+    uint64_t handle;
+    int32_t fd[3];
+    uint32_t compressionType;
+    uint64_t compressionModifier;
+    uint32_t format;
+    uint32_t dataSpace;
+    uint32_t colorTransform;
+    uint32_t blending;
+    float planeAlpha;
+    float fps;
+    FRect sourceCrop;
+    Rect displayFrame;
+    Rect blockingRect;
+    uint32_t transform;
+    uint32_t windowIndex;
+    int32_t compositionType;
+    int32_t exynosCompositionType;
+    int32_t validateCompositionType;
+    uint32_t overlayInfo;
+    uint64_t bufferId;
+    uint64_t supportedMPPFlag;
+    float sdrDimRatio;
+    // 1 for the ignored layers
+    uint32_t ignored;
+};
+static_assert(sizeof(LayerRecord) <= kMaxPayloadSize, "LayerRecord is too large");
+
+// What ExynosCompositionInfo::dump() prints
+struct CompositionInfoRecord {
+    uint32_t type;
+    uint32_t hasCompositionLayer;
+    int32_t firstIndex;
+    int32_t lastIndex;
+    uint32_t dataSpace;
+    int32_t windowIndex;
+    uint64_t handle;
+    int32_t acquireFence;
+    int32_t releaseFence;
+    uint32_t skipFlag;
+    uint32_t compressionType;
+    uint64_t compressionModifier;
+    uint64_t internalFormat;
+    uint32_t afbc;
+    uint32_t assignedSrcNum;
+    // Names of the assigned MPPs, empty if none
+    char otfMPP[32];
+    char m2mMPP[32];
+};
+static_assert(sizeof(CompositionInfoRecord) <= kMaxPayloadSize,
+              "CompositionInfoRecord is too large");
+
+struct WinRect {
+    int32_t x;
+    int32_t y;
+    uint32_t w;
+    uint32_t h;
+};
+
+// What ExynosDisplay::dumpConfig() prints
+struct WinConfigRecord {
+    uint32_t index;
+    uint32_t state;
+    uint32_t color;
+    int32_t fd[3];
+    int32_t acqFence;
+    int32_t relFence;
+    uint32_t srcFrame[6]; // f_w, f_h, x, y, w, h
+    uint32_t dstFrame[6];
+    int32_t format;
+    float planeAlpha;
+    uint32_t transform;
+    uint32_t dataSpace;
+    uint32_t hdrEnable;
+    int32_t blending;
+    uint32_t protection;
+    uint32_t compressionType;
+    uint64_t compressionModifier;
+    int32_t compSrc;
+    WinRect transparentArea;
+    WinRect blockArea;
+    WinRect opaqueArea;
+};
+static_assert(sizeof(WinConfigRecord) <= kMaxPayloadSize, "WinConfigRecord is too large");
+
+struct FenceRecord {
+    int32_t fd;
+    uint32_t displayId;
+    int32_t usage;
+    int32_t dupFrom;
+    uint32_t pendingAllowed;
+    uint32_t leaking;
+};
+
+struct FenceTraceRecord {
+    int32_t fd;
+    uint32_t direction;
+    uint32_t type;
+    uint32_t ip;
+    int64_t timeUs;
+};
+
+/*
+ * Turns a log file into text. Returns false if it is not a log file or is
+ * truncated, after decoding the records before the damage.
+ */
+bool decodeFile(FILE* file, std::string& out);
+
+// Appends the text of a record
+void formatRecord(const RecordHeader& header, const void* payload, std::string& out);
+
+} // namespace hwclog
+
+#endif // _HWC_LOG_RECORD_H_
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
+#include "ReadbackEngine.h"
+
+#include <log/log.h>
+#include <sync/sync.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "ExynosDisplay.h"
+#include "ExynosDisplayInterface.h"
+#include "VendorGraphicBuffer.h"
+
+using namespace vendor::graphics;
+
+ReadbackEngine::ReadbackEngine(ExynosDisplay* display) : mDisplay(display) {
+    mBufferStates.fill(BufferState::FREE);
+}
+
+ReadbackEngine::~ReadbackEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+        mActive = false;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& capture : mPending) {
+        close(capture.fence);
+    }
+    mPending.clear();
+    mBufferStates.fill(BufferState::FREE);
+    releaseBuffersLocked();
+}
+
+int32_t ReadbackEngine::start(const Config& config, std::shared_ptr<Consumer> consumer) {
+    if (consumer == nullptr) {
+        return HWC2_ERROR_BAD_PARAMETER;
+    }
+
+    int32_t format;
+    int32_t dataspace;
+    if (mDisplay->getReadbackBufferAttributes(&format, &dataspace) != HWC2_ERROR_NONE) {
+        return HWC2_ERROR_UNSUPPORTED;
+    }
+
+    const uint32_t displayWidth = mDisplay->mXres;
+    const uint32_t displayHeight = mDisplay->mYres;
+    const uint32_t width = config.width ? config.width : displayWidth;
+    const uint32_t height = config.height ? config.height : displayHeight;
+    if (width > displayWidth || height > displayHeight) {
+        ALOGE("%s: capture size %ux%u is larger than the display %ux%u", __func__, width, height,
+              displayWidth, displayHeight);
+        return HWC2_ERROR_BAD_PARAMETER;
+    }
+    if ((width != displayWidth || height != displayHeight) &&
+        !mDisplay->mDisplayInterface->isReadbackScalingSupported()) {
+        ALOGE("%s: writeback connector can't scale to %ux%u", __func__, width, height);
+        return HWC2_ERROR_UNSUPPORTED;
+    }
+
+    hwc_rect_t crop = config.crop;
+    if (crop.left == crop.right || crop.top == crop.bottom) {
+        crop = {0, 0, static_cast<int>(displayWidth), static_cast<int>(displayHeight)};
+    } else if (crop.left < 0 || crop.top < 0 || crop.left > crop.right ||
+               crop.top > crop.bottom || crop.right > static_cast<int>(displayWidth) ||
+               crop.bottom > static_cast<int>(displayHeight)) {
+        ALOGE("%s: invalid crop [%d, %d, %d, %d]", __func__, crop.left, crop.top, crop.right,
+              crop.bottom);
+        return HWC2_ERROR_BAD_PARAMETER;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mActive || mBuffers[0] != nullptr) {
+            ALOGE("%s: a capture is already running", __func__);
+            return HWC2_ERROR_NO_RESOURCES;
+        }
+    }
+
+    std::array<buffer_handle_t, kNumBuffers> buffers{};
+    VendorGraphicBufferAllocator& gAllocator(VendorGraphicBufferAllocator::get());
+    const uint64_t usage = static_cast<uint64_t>(GRALLOC1_CONSUMER_USAGE_HWCOMPOSER |
+                                                 GRALLOC1_CONSUMER_USAGE_CPU_READ_OFTEN);
+    for (auto& buffer : buffers) {
+        uint32_t stride = 0;
+        status_t error =
+                gAllocator.allocate(width, height, format, 1, usage, &buffer, &stride, "HWC");
+        if (error != NO_ERROR || buffer == nullptr) {
+            ALOGE("%s: failed to allocate readback buffer(%ux%u): %d", __func__, width, height,
+                  error);
+            VendorGraphicBufferMapper& gMapper(VendorGraphicBufferMapper::get());
+            for (auto& allocated : buffers) {
+                if (allocated != nullptr) gMapper.freeBuffer(allocated);
+            }
+            return HWC2_ERROR_NO_RESOURCES;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mActive || mBuffers[0] != nullptr) {
+        ALOGE("%s: a capture is already running", __func__);
+        VendorGraphicBufferMapper& gMapper(VendorGraphicBufferMapper::get());
+        for (auto& buffer : buffers) gMapper.freeBuffer(buffer);
+        return HWC2_ERROR_NO_RESOURCES;
+    }
+
+    mConfig = config;
+    mConfig.width = width;
+    mConfig.height = height;
+    mConfig.crop = crop;
+    mConsumer = std::move(consumer);
+    mDisplayWidth = displayWidth;
+    mDisplayHeight = displayHeight;
+    mFormat = format;
+    mDataspace = dataspace;
+    mBufferCrop = {static_cast<int>(crop.left * width / displayWidth),
+                   static_cast<int>(crop.top * height / displayHeight),
+                   static_cast<int>(crop.right * width / displayWidth),
+                   static_cast<int>(crop.bottom * height / displayHeight)};
+    mBuffers = buffers;
+    mBufferStates.fill(BufferState::FREE);
+    mCommitted = 0;
+    mActive = true;
+
+    if (!mThread.joinable()) {
+        mThread = std::thread(&ReadbackEngine::threadLoop, this);
+    }
+    ALOGI("%s: capture %u frames of %ux%u, format(0x%x)", __func__, config.frameCount, width,
+          height, format);
+    return HWC2_ERROR_NONE;
+}
+
+void ReadbackEngine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mActive) return;
+        mActive = false;
+    }
+    mCondition.notify_all();
+}
+
+bool ReadbackEngine::isActive() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mActive;
+}
+
+bool ReadbackEngine::prepareCapture(exynos_dpu_data& dpuData) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    // Keep the writeback connector on the CRTC between the frames of a capture
+    dpuData.readback_info.keep_connector = mActive;
+    if (!mActive) {
+        return false;
+    }
+
+    if (mDisplay->mXres != mDisplayWidth || mDisplay->mYres != mDisplayHeight) {
+        ALOGW("%s: display resolution changed to %dx%d, stop capture", __func__, mDisplay->mXres,
+              mDisplay->mYres);
+        mActive = false;
+        dpuData.readback_info.keep_connector = false;
+        mCondition.notify_all();
+        return false;
+    }
+
+    if (dpuData.enable_readback) {
+        mStats.preempted++;
+        return false;
+    }
+
+    size_t index = 0;
+    while (index < kNumBuffers && mBufferStates[index] != BufferState::FREE) index++;
+    if (index == kNumBuffers) {
+        mStats.busy++;
+        return false;
+    }
+
+    ATRACE_NAME("prepareReadbackCapture");
+    mBufferStates[index] = BufferState::ATTACHED;
+    mAttached = index;
+
+    dpuData.enable_readback = true;
+    dpuData.readback_info.handle = mBuffers[index];
+    dpuData.readback_info.requested_from_service = mConfig.withDqe;
+    dpuData.readback_info.width = mConfig.width;
+    dpuData.readback_info.height = mConfig.height;
+    return true;
+}
+
+void ReadbackEngine::onCommitted(exynos_dpu_data& dpuData, bool committed) {
+    const int fence = dpuData.readback_info.acq_fence;
+    dpuData.readback_info.acq_fence = -1;
+    dpuData.readback_info.width = 0;
+    dpuData.readback_info.height = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const size_t index = mAttached;
+        mAttached = kNumBuffers;
+        if (index == kNumBuffers) {
+            if (fence >= 0) close(fence);
+            return;
+        }
+
+        if (!committed || fence < 0) {
+            if (fence >= 0) close(fence);
+            mBufferStates[index] = BufferState::FREE;
+            mStats.failed++;
+            if (!committed && mActive) {
+                // Do not fail the following frames as well
+                ALOGE("%s: writeback commit failed, stop capture", __func__);
+                mActive = false;
+            }
+        } else {
+            mBufferStates[index] = BufferState::PENDING;
+            mPending.push_back(
+                    {index, mSequence++, systemTime(SYSTEM_TIME_MONOTONIC), fence});
+            mStats.captured++;
+            if (mConfig.frameCount && ++mCommitted >= mConfig.frameCount) {
+                mActive = false;
+            }
+        }
+    }
+    mCondition.notify_all();
+}
+
+bool ReadbackEngine::isIdleLocked() const {
+    for (auto state : mBufferStates) {
+        if (state != BufferState::FREE) return false;
+    }
+    return mPending.empty();
+}
+
+void ReadbackEngine::releaseBuffersLocked() {
+    VendorGraphicBufferMapper& gMapper(VendorGraphicBufferMapper::get());
+    for (auto& buffer : mBuffers) {
+        if (buffer != nullptr) gMapper.freeBuffer(buffer);
+        buffer = nullptr;
+    }
+}
+
+void ReadbackEngine::threadLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] {
+            return mExit || !mPending.empty() ||
+                    (!mActive && mConsumer != nullptr && isIdleLocked());
+        });
+        if (mExit) break;
+
+        if (!mPending.empty()) {
+            const Capture capture = mPending.front();
+            mPending.pop_front();
+            mBufferStates[capture.index] = BufferState::DELIVERING;
+            const Frame frame = {capture.sequence,
+                                 capture.commitTime,
+                                 mBuffers[capture.index],
+                                 mFormat,
+                                 mDataspace,
+                                 mConfig.width,
+                                 mConfig.height,
+                                 mBufferCrop};
+            auto consumer = mConsumer;
+            lock.unlock();
+
+            bool written;
+            {
+                ATRACE_NAME("waitReadbackFence");
+                written = sync_wait(capture.fence, kFenceTimeoutMs) == 0;
+            }
+            close(capture.fence);
+            const nsecs_t latency = systemTime(SYSTEM_TIME_MONOTONIC) - capture.commitTime;
+            if (written) {
+                ATRACE_NAME("deliverReadbackFrame");
+                consumer->onFrame(frame);
+            } else {
+                ALOGE("%s: readback fence of frame %" PRIu64 " is not signaled", __func__,
+                      capture.sequence);
+            }
+
+            lock.lock();
+            mBufferStates[capture.index] = BufferState::FREE;
+            if (written) {
+                mStats.delivered++;
+                mStats.maxLatency = std::max(mStats.maxLatency, latency);
+            } else {
+                mStats.failed++;
+            }
+            continue;
+        }
+
+        // The capture is done and no buffer is in flight any more
+        auto consumer = std::move(mConsumer);
+        releaseBuffersLocked();
+        lock.unlock();
+        consumer->onStopped();
+        lock.lock();
+    }
+}
+
+void ReadbackEngine::dump(android::String8& result) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mActive && mBuffers[0] == nullptr && mStats.captured == 0) return;
+
+    result.appendFormat("Readback capture: %s, %ux%u, crop [%d, %d, %d, %d], %u/%u frames\n",
+                        mActive ? "active" : (mBuffers[0] != nullptr ? "stopping" : "idle"),
+                        mConfig.width, mConfig.height, mConfig.crop.left, mConfig.crop.top,
+                        mConfig.crop.right, mConfig.crop.bottom, mCommitted, mConfig.frameCount);
+    result.appendFormat("\tcaptured %" PRIu64 ", delivered %" PRIu64 ", busy %" PRIu64
+                        ", preempted %" PRIu64 ", failed %" PRIu64 ", max latency %" PRId64
+                        " us\n",
+                        mStats.captured, mStats.delivered, mStats.busy, mStats.preempted,
+                        mStats.failed, ns2us(mStats.maxLatency));
+}
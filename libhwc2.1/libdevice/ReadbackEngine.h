@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _READBACK_ENGINE_H_
+#define _READBACK_ENGINE_H_
+
+#include <hardware/hwcomposer2.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class ExynosDisplay;
+struct exynos_dpu_data;
+
+/*
+ * Captures consecutive frames of a display through its writeback connector.
+ *
+ * The engine owns a small ring of writeback buffers. presentDisplay() attaches
+ * a free one to the commit and hands the writeback fence of the commit back to
+ * the engine, so composition never waits for a capture. A delivery thread waits
+ * for the fences and passes the frames to the consumer. A frame is skipped when
+ * every buffer is still in flight or the framework requested a readback of its
+ * own for the same commit.
+ */
+class ReadbackEngine {
+public:
+    struct Config {
+        // Size of the captured frames, 0 for the display size. Sizes other than
+        // the display size need a writeback connector that can scale.
+        uint32_t width = 0;
+        uint32_t height = 0;
+        // Region of the display the consumer wants, empty for the whole display
+        hwc_rect_t crop = {0, 0, 0, 0};
+        // Number of frames to capture, 0 to capture until stop()
+        uint32_t frameCount = 1;
+        // Capture the output of the display quality enhancer
+        bool withDqe = true;
+    };
+
+    struct Frame {
+        uint64_t sequence;
+        // Time the capture was committed
+        nsecs_t commitTime;
+        buffer_handle_t buffer;
+        int32_t format;
+        int32_t dataspace;
+        uint32_t width;
+        uint32_t height;
+        // Config::crop in buffer coordinates
+        hwc_rect_t crop;
+    };
+
+    class Consumer {
+    public:
+        virtual ~Consumer() = default;
+        // Called on the delivery thread. The buffer is reused once this returns.
+        virtual void onFrame(const Frame& frame) = 0;
+        // Called on the delivery thread after the last frame of a capture
+        virtual void onStopped() {}
+    };
+
+    explicit ReadbackEngine(ExynosDisplay* display);
+    ~ReadbackEngine();
+
+    int32_t start(const Config& config, std::shared_ptr<Consumer> consumer);
+    void stop();
+    bool isActive() const;
+
+    /*
+     * Called by presentDisplay() with the display mutex held, before and after
+     * the commit. prepareCapture() returns true when it attached a buffer to
+     * @dpuData, and only then has onCommitted() to be called.
+     */
+    bool prepareCapture(exynos_dpu_data& dpuData);
+    void onCommitted(exynos_dpu_data& dpuData, bool committed);
+
+    void dump(android::String8& result) const;
+
+private:
+    static constexpr size_t kNumBuffers = 3;
+    static constexpr int kFenceTimeoutMs = 1000;
+
+    enum class BufferState { FREE, ATTACHED, PENDING, DELIVERING };
+
+    struct Capture {
+        size_t index;
+        uint64_t sequence;
+        nsecs_t commitTime;
+        int fence;
+    };
+
+    void threadLoop();
+    // Frees the buffers once none of them is in flight
+    void releaseBuffersLocked();
+    bool isIdleLocked() const;
+
+    ExynosDisplay* mDisplay;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::thread mThread;
+    bool mExit = false;
+
+    // Capture requested by start(), cleared when it is done or stopped
+    bool mActive = false;
+    Config mConfig;
+    std::shared_ptr<Consumer> mConsumer;
+    uint32_t mDisplayWidth = 0;
+    uint32_t mDisplayHeight = 0;
+    int32_t mFormat = 0;
+    int32_t mDataspace = 0;
+    hwc_rect_t mBufferCrop = {0, 0, 0, 0};
+
+    std::array<buffer_handle_t, kNumBuffers> mBuffers{};
+    std::array<BufferState, kNumBuffers> mBufferStates{};
+    size_t mAttached = kNumBuffers;
+    std::deque<Capture> mPending;
+    uint64_t mSequence = 0;
+    uint32_t mCommitted = 0;
+
+    struct Stats {
+        uint64_t captured = 0;
+        uint64_t delivered = 0;
+        // Frames skipped because every buffer was in flight
+        uint64_t busy = 0;
+        // Frames skipped for a readback requested by the framework
+        uint64_t preempted = 0;
+        uint64_t failed = 0;
+        nsecs_t maxLatency = 0;
+    } mStats;
+};
+
+#endif // _READBACK_ENGINE_H_
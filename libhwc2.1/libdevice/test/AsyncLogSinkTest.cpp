@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "AsyncLogSink.h"
+
+namespace {
+
+struct Record {
+    hwclog::RecordHeader header;
+    std::string payload;
+};
+
+class AsyncLogSinkTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::string tmpl = ::testing::TempDir() + "/hwclog_XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(tmpl.data()));
+        mDir = tmpl;
+        mSink.setLogDirs({mDir});
+    }
+
+    void TearDown() override {
+        for (const auto& path : mFiles) unlink(path.c_str());
+        rmdir(mDir.c_str());
+    }
+
+    std::string path(const std::string& prefix, int index) {
+        std::string path = mDir + "/" + prefix + std::to_string(index) + ".hwclog";
+        mFiles.push_back(path);
+        return path;
+    }
+
+    std::vector<Record> readRecords(const std::string& path) {
+        std::vector<Record> records;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) return records;
+        hwclog::FileHeader fileHeader;
+        if (fread(&fileHeader, sizeof(fileHeader), 1, file) == 1) {
+            Record record;
+            while (fread(&record.header, sizeof(record.header), 1, file) == 1) {
+                record.payload.resize(record.header.size);
+                if (fread(record.payload.data(), 1, record.header.size, file) !=
+                    record.header.size)
+                    break;
+                records.push_back(record);
+            }
+        }
+        fclose(file);
+        return records;
+    }
+
+    std::string decode(const std::string& path, bool* ok = nullptr) {
+        std::string text;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) return text;
+        bool decoded = hwclog::decodeFile(file, text);
+        if (ok) *ok = decoded;
+        fclose(file);
+        return text;
+    }
+
+    // A file of hand made records
+    void writeFile(const std::string& path, const std::vector<Record>& records) {
+        FILE* file = fopen(path.c_str(), "wb");
+        ASSERT_NE(nullptr, file);
+        hwclog::FileHeader fileHeader = {{'H', 'W', 'C', 'L', 'O', 'G', '\0', '\0'},
+                                         hwclog::kVersion,
+                                         sizeof(hwclog::RecordHeader)};
+        fwrite(&fileHeader, sizeof(fileHeader), 1, file);
+        for (const auto& record : records) {
+            fwrite(&record.header, sizeof(record.header), 1, file);
+            fwrite(record.payload.data(), 1, record.payload.size(), file);
+        }
+        fclose(file);
+    }
+
+    static Record textRecord(const std::string& text, uint8_t flags = 0, uint16_t dropped = 0) {
+        Record record = {};
+        record.header.sync = hwclog::kRecordSync;
+        record.header.type = hwclog::TYPE_TEXT;
+        record.header.stream = hwclog::STREAM_ERROR;
+        record.header.flags = flags;
+        record.header.size = text.size();
+        record.header.dropped = dropped;
+        record.payload = text;
+        return record;
+    }
+
+    AsyncLogSink mSink;
+    std::string mDir;
+    std::vector<std::string> mFiles;
+};
+
+size_t countOf(const std::string& text, const std::string& pattern) {
+    size_t count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos;
+         pos = text.find(pattern, pos + pattern.size()))
+        count++;
+    return count;
+}
+
+TEST_F(AsyncLogSinkTest, RoundTrip) {
+    auto channel = mSink.createChannel();
+    channel->setPrefixName(hwclog::STREAM_ERROR, "error");
+    channel->setPrefixName(hwclog::STREAM_DEBUG, "debug");
+
+    channel->logText(hwclog::STREAM_ERROR, "first error\n");
+    hwclog::LayerRecord layer = {};
+    layer.index = 3;
+    layer.zOrder = 7;
+    EXPECT_TRUE(channel->log(hwclog::STREAM_DEBUG, hwclog::TYPE_LAYER, layer));
+    channel->logText(hwclog::STREAM_ERROR, "second error\n");
+    mSink.sync();
+
+    const std::string error = decode(path("error", 0));
+    EXPECT_EQ(1u, countOf(error, "first error\n"));
+    EXPECT_LT(error.find("first error"), error.find("second error"));
+    const std::string debug = decode(path("debug", 0));
+    EXPECT_NE(std::string::npos, debug.find("layer[3] zOrder: 7"));
+
+    const auto stats = channel->getStats();
+    EXPECT_EQ(3u, stats.records);
+    EXPECT_EQ(3u, stats.written);
+    EXPECT_EQ(0u, stats.dropped);
+}
+
+TEST_F(AsyncLogSinkTest, ContinuedTextIsJoined) {
+    auto channel = mSink.createChannel();
+    channel->setPrefixName(hwclog::STREAM_ERROR, "error");
+    std::string text;
+    for (int i = 0; text.size() < 3 * hwclog::kMaxPayloadSize; i++)
+        text += "line " + std::to_string(i) + ", ";
+    text += "end\n";
+    channel->logText(hwclog::STREAM_ERROR, text);
+    mSink.sync();
+
+    const auto records = readRecords(path("error", 0));
+    ASSERT_EQ(4u, records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        EXPECT_EQ((i + 1 < records.size()) ? hwclog::FLAG_CONTINUED : 0,
+                  records[i].header.flags & hwclog::FLAG_CONTINUED);
+    }
+    const std::string decoded = decode(path("error", 0));
+    // One timestamp, then the text in one piece
+    EXPECT_EQ(1u, countOf(decoded, "["));
+    EXPECT_NE(std::string::npos, decoded.find("] " + text));
+}
+
+TEST_F(AsyncLogSinkTest, DropsAreCountedAndReported) {
+    auto channel = mSink.createChannel(2);
+    channel->setPrefixName(hwclog::STREAM_FENCE, "fence");
+    hwclog::FenceTraceRecord trace = {};
+    uint64_t logged = 0;
+    uint64_t attempts = 0;
+    while (channel->getStats().dropped == 0 && attempts < 1000000) {
+        trace.fd = attempts++;
+        if (channel->log(hwclog::STREAM_FENCE, hwclog::TYPE_FENCE_TRACE, trace)) logged++;
+    }
+    mSink.sync();
+    // Carries the drops not reported yet
+    EXPECT_TRUE(channel->log(hwclog::STREAM_FENCE, hwclog::TYPE_FENCE_TRACE, trace, true));
+    logged++;
+    attempts++;
+    mSink.sync();
+
+    const auto stats = channel->getStats();
+    ASSERT_GT(stats.dropped, 0u);
+    EXPECT_EQ(logged, stats.records);
+    EXPECT_EQ(attempts, stats.records + stats.dropped);
+
+    const auto records = readRecords(path("fence", 0));
+    EXPECT_EQ(logged, records.size());
+    uint64_t dropped = 0;
+    for (const auto& record : records) dropped += record.header.dropped;
+    EXPECT_EQ(stats.dropped, dropped);
+    EXPECT_NE(std::string::npos, decode(path("fence", 0)).find(" records dropped>\n"));
+}
+
+TEST_F(AsyncLogSinkTest, WaitingNeverDrops) {
+    auto channel = mSink.createChannel(4);
+    channel->setPrefixName(hwclog::STREAM_FENCE, "fence");
+    constexpr int kRecords = 500;
+    hwclog::FenceRecord fence = {};
+    for (int i = 0; i < kRecords; i++) {
+        fence.fd = i;
+        EXPECT_TRUE(channel->log(hwclog::STREAM_FENCE, hwclog::TYPE_FENCE, fence, true));
+    }
+    mSink.sync();
+
+    const auto stats = channel->getStats();
+    EXPECT_EQ(0u, stats.dropped);
+    EXPECT_GT(stats.waits, 0u);
+    const auto records = readRecords(path("fence", 0));
+    ASSERT_EQ(static_cast<size_t>(kRecords), records.size());
+    for (int i = 0; i < kRecords; i++) {
+        hwclog::FenceRecord read;
+        memcpy(&read, records[i].payload.data(), sizeof(read));
+        EXPECT_EQ(i, read.fd);
+        EXPECT_EQ(0, records[i].header.dropped);
+    }
+}
+
+TEST_F(AsyncLogSinkTest, EveryDumpStartsAFile) {
+    auto channel = mSink.createChannel();
+    channel->setPrefixName(hwclog::STREAM_DEBUG, "debug");
+    channel->setDumpRotation(hwclog::STREAM_DEBUG, 3);
+
+    // Two dumps the writer takes in one cycle still go to two files
+    channel->beginDump(hwclog::STREAM_DEBUG);
+    channel->logText(hwclog::STREAM_DEBUG, "dump A\n");
+    channel->logText(hwclog::STREAM_DEBUG, std::string(1000, 'a') + "\n");
+    channel->beginDump(hwclog::STREAM_DEBUG);
+    channel->logText(hwclog::STREAM_DEBUG, "dump B\n");
+    mSink.sync();
+    channel->beginDump(hwclog::STREAM_DEBUG);
+    channel->logText(hwclog::STREAM_DEBUG, "dump C\n");
+    mSink.sync();
+    // The oldest file is reused
+    channel->beginDump(hwclog::STREAM_DEBUG);
+    channel->logText(hwclog::STREAM_DEBUG, "dump D\n");
+    mSink.sync();
+
+    const std::string first = decode(path("debug", 0));
+    EXPECT_EQ(std::string::npos, first.find("dump A"));
+    EXPECT_NE(std::string::npos, first.find("dump D"));
+    const std::string second = decode(path("debug", 1));
+    EXPECT_NE(std::string::npos, second.find("dump B"));
+    EXPECT_EQ(std::string::npos, second.find("dump A"));
+    const std::string third = decode(path("debug", 2));
+    EXPECT_NE(std::string::npos, third.find("dump C"));
+
+    const auto records = readRecords(path("debug", 1));
+    ASSERT_FALSE(records.empty());
+    EXPECT_TRUE(records[0].header.flags & hwclog::FLAG_DUMP_START);
+}
+
+TEST_F(AsyncLogSinkTest, DecodeReportsDrops) {
+    const std::string file = path("made", 0);
+    writeFile(file,
+              {textRecord("one, ", hwclog::FLAG_CONTINUED), textRecord("two\n", 0, 5),
+               textRecord("three\n")});
+    bool ok = false;
+    const std::string text = decode(file, &ok);
+    EXPECT_TRUE(ok);
+    // The drop cuts the continued text
+    EXPECT_NE(std::string::npos, text.find("one, \n<5 records dropped>\n["));
+    EXPECT_NE(std::string::npos, text.find("] two\n["));
+    EXPECT_NE(std::string::npos, text.find("] three\n"));
+}
+
+TEST_F(AsyncLogSinkTest, DecodeRejectsDamagedFiles) {
+    const std::string notLog = path("notlog", 0);
+    FILE* file = fopen(notLog.c_str(), "wb");
+    ASSERT_NE(nullptr, file);
+    fputs("plain text log\n", file);
+    fclose(file);
+    bool ok = true;
+    EXPECT_EQ("<not a HWC log file>\n", decode(notLog, &ok));
+    EXPECT_FALSE(ok);
+
+    const std::string truncated = path("truncated", 0);
+    writeFile(truncated, {textRecord("kept\n"), textRecord("cut short\n")});
+    ASSERT_EQ(0, truncate(truncated.c_str(), sizeof(hwclog::FileHeader) +
+                                                     2 * sizeof(hwclog::RecordHeader) + 5 + 3));
+    ok = true;
+    const std::string text = decode(truncated, &ok);
+    EXPECT_FALSE(ok);
+    EXPECT_NE(std::string::npos, text.find("] kept\n<truncated record>\n"));
+}
+
+} // namespace
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "DamageTracker.h"
+
+namespace {
+
+using Rect = DamageTracker::Rect;
+
+constexpr int32_t kWidth = 1080;
+constexpr int32_t kHeight = 2400;
+
+bool operator==(const Rect &a, const Rect &b) {
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+DamageTracker::Config makeConfig(int32_t alignX, int32_t alignY, uint32_t maxRects = 1) {
+    DamageTracker::Config config;
+    config.width = kWidth;
+    config.height = kHeight;
+    config.alignX = alignX;
+    config.alignY = alignY;
+    config.maxRects = maxRects;
+    return config;
+}
+
+// A tracker past the full update of its first frame
+DamageTracker makeTracker(const DamageTracker::Config &config) {
+    DamageTracker tracker;
+    tracker.configure(config);
+    tracker.beginFrame();
+    tracker.endFrame(true);
+    return tracker;
+}
+
+std::vector<Rect> computeFrame(DamageTracker &tracker, const std::vector<Rect> &damage,
+                               bool *partial = nullptr) {
+    std::vector<Rect> rects;
+    tracker.beginFrame();
+    for (const auto &rect : damage) tracker.addDamage(rect);
+    const bool ret = tracker.compute(rects);
+    if (partial) *partial = ret;
+    return rects;
+}
+
+int64_t totalArea(const std::vector<Rect> &rects) {
+    int64_t area = 0;
+    for (const auto &rect : rects) area += rect.area();
+    return area;
+}
+
+bool covers(const std::vector<Rect> &rects, const Rect &damage) {
+    for (int32_t y = damage.top; y < damage.bottom; y++) {
+        for (int32_t x = damage.left; x < damage.right; x++) {
+            bool covered = false;
+            for (const auto &rect : rects) {
+                if (x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom) {
+                    covered = true;
+                    break;
+                }
+            }
+            if (!covered) return false;
+        }
+    }
+    return true;
+}
+
+TEST(DamageTrackerTest, FirstFrameIsFull) {
+    DamageTracker tracker;
+    tracker.configure(makeConfig(1, 1));
+    bool partial = true;
+    computeFrame(tracker, {{10, 10, 20, 20}}, &partial);
+    EXPECT_FALSE(partial);
+}
+
+TEST(DamageTrackerTest, TilesFollowPanelAlignment) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1));
+    EXPECT_EQ(1, tracker.getConfig().tileWidth);
+    EXPECT_EQ(1, tracker.getConfig().tileHeight);
+    auto rects = computeFrame(tracker, {{13, 17, 29, 31}});
+    ASSERT_EQ(1u, rects.size());
+    EXPECT_TRUE((rects[0] == Rect{13, 17, 29, 31}));
+
+    tracker = makeTracker(makeConfig(540, 40));
+    EXPECT_EQ(540, tracker.getConfig().tileWidth);
+    EXPECT_EQ(40, tracker.getConfig().tileHeight);
+    rects = computeFrame(tracker, {{13, 17, 29, 31}});
+    ASSERT_EQ(1u, rects.size());
+    EXPECT_TRUE((rects[0] == Rect{0, 0, 540, 40}));
+}
+
+TEST(DamageTrackerTest, TileSizeIsRoundedToAlignment) {
+    DamageTracker::Config config = makeConfig(8, 4);
+    config.tileWidth = 20;
+    config.tileHeight = 1;
+    DamageTracker tracker = makeTracker(config);
+    EXPECT_EQ(24, tracker.getConfig().tileWidth);
+    EXPECT_EQ(4, tracker.getConfig().tileHeight);
+}
+
+TEST(DamageTrackerTest, RectsAreClippedToPanel) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1));
+    auto rects = computeFrame(tracker, {{-10, kHeight - 5, 10, kHeight + 20}});
+    ASSERT_EQ(1u, rects.size());
+    EXPECT_TRUE((rects[0] == Rect{0, kHeight - 5, 10, kHeight}));
+
+    rects = computeFrame(tracker, {{kWidth, 0, kWidth + 10, 10}});
+    EXPECT_TRUE(rects.empty());
+}
+
+TEST(DamageTrackerTest, NoDamageIsEmptyPartial) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1));
+    bool partial = false;
+    auto rects = computeFrame(tracker, {}, &partial);
+    EXPECT_TRUE(partial);
+    EXPECT_TRUE(rects.empty());
+}
+
+TEST(DamageTrackerTest, SingleRectIsBoundsOfDamage) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1));
+    auto rects = computeFrame(tracker, {{0, 0, 100, 50}, {900, 2300, 1000, 2400}});
+    ASSERT_EQ(1u, rects.size());
+    EXPECT_TRUE((rects[0] == Rect{0, 0, 1000, 2400}));
+}
+
+TEST(DamageTrackerTest, MergeKeepsDistantRectsApart) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1, 2));
+    const std::vector<Rect> damage = {{0, 0, 100, 50}, {900, 2300, 1000, 2400}};
+    auto rects = computeFrame(tracker, damage);
+    ASSERT_EQ(2u, rects.size());
+    EXPECT_EQ(100 * 50 + 100 * 100, totalArea(rects));
+    for (const auto &rect : damage) EXPECT_TRUE(covers(rects, rect));
+}
+
+TEST(DamageTrackerTest, MergeJoinsCheapestPair) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1, 2));
+    // The first two are adjacent and merge for free
+    const std::vector<Rect> damage = {{0, 0, 100, 50}, {100, 0, 200, 50}, {500, 1000, 600, 1100}};
+    auto rects = computeFrame(tracker, damage);
+    ASSERT_EQ(2u, rects.size());
+    EXPECT_EQ(200 * 50 + 100 * 100, totalArea(rects));
+    for (const auto &rect : damage) EXPECT_TRUE(covers(rects, rect));
+}
+
+TEST(DamageTrackerTest, ManyRunsStillCovered) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1, 4));
+    std::vector<Rect> damage;
+    for (int32_t i = 0; i < 100; i++) {
+        const int32_t x = (i * 7) % 1000;
+        damage.push_back({x, i * 20, x + 5, i * 20 + 3});
+    }
+    auto rects = computeFrame(tracker, damage);
+    ASSERT_LE(rects.size(), 4u);
+    ASSERT_FALSE(rects.empty());
+    for (const auto &rect : damage) EXPECT_TRUE(covers(rects, rect));
+}
+
+TEST(DamageTrackerTest, DamageOfDroppedFrameIsCarried) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1));
+    computeFrame(tracker, {{0, 0, 10, 10}});
+    tracker.endFrame(false);
+    EXPECT_EQ(1u, tracker.getCarriedCount());
+
+    auto rects = computeFrame(tracker, {{100, 100, 110, 110}});
+    ASSERT_EQ(1u, rects.size());
+    EXPECT_TRUE((rects[0] == Rect{0, 0, 110, 110}));
+    tracker.endFrame(true);
+
+    rects = computeFrame(tracker, {{100, 100, 110, 110}});
+    ASSERT_EQ(1u, rects.size());
+    EXPECT_TRUE((rects[0] == Rect{100, 100, 110, 110}));
+}
+
+TEST(DamageTrackerTest, RepeatedValidateStartsFromCarried) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1));
+    computeFrame(tracker, {{0, 0, 10, 10}});
+    // Validated again before it was presented: the first damage is gone
+    auto rects = computeFrame(tracker, {{100, 100, 110, 110}});
+    ASSERT_EQ(1u, rects.size());
+    EXPECT_TRUE((rects[0] == Rect{100, 100, 110, 110}));
+}
+
+TEST(DamageTrackerTest, FullFrameDroppedStaysFull) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1));
+    tracker.beginFrame();
+    tracker.addFull();
+    tracker.endFrame(false);
+
+    bool partial = true;
+    computeFrame(tracker, {{0, 0, 10, 10}}, &partial);
+    EXPECT_FALSE(partial);
+    tracker.endFrame(true);
+
+    computeFrame(tracker, {{0, 0, 10, 10}}, &partial);
+    EXPECT_TRUE(partial);
+}
+
+TEST(DamageTrackerTest, InvalidateForcesFullUpdate) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1));
+    tracker.invalidate();
+    bool partial = true;
+    computeFrame(tracker, {{0, 0, 10, 10}}, &partial);
+    EXPECT_FALSE(partial);
+    tracker.endFrame(true);
+
+    computeFrame(tracker, {{0, 0, 10, 10}}, &partial);
+    EXPECT_TRUE(partial);
+}
+
+TEST(DamageTrackerTest, ReconfigureResetsDamage) {
+    DamageTracker tracker = makeTracker(makeConfig(1, 1));
+    computeFrame(tracker, {{0, 0, 10, 10}});
+    tracker.endFrame(false);
+
+    tracker.configure(makeConfig(540, 40));
+    bool partial = true;
+    computeFrame(tracker, {}, &partial);
+    EXPECT_FALSE(partial);
+}
+
+} // namespace
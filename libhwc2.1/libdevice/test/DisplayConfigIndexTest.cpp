@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <climits>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include "DisplayConfigIndex.h"
+
+namespace {
+
+constexpr float nsecsPerSec = 1e9f;
+constexpr int64_t nsecsPerMs = 1000000;
+
+// The fields of displayConfigs_t used by the lookups
+struct Config {
+    uint32_t vsyncPeriod;
+    int32_t width;
+    int32_t height;
+    int32_t refreshRate;
+};
+using Configs = std::map<uint32_t, Config>;
+
+struct Mode {
+    int32_t width;
+    int32_t height;
+    int32_t fps;
+};
+
+/*
+ * Configs of a VRR panel: every resolution runs each frame rate on a 120Hz and
+ * a 240Hz TE, plus two NS modes. numResolutions of 1, 2 and 3 give 28, 56 and
+ * 84 configs.
+ */
+Configs makeVrrPanel(int numResolutions) {
+    static const Mode kResolutions[] = {{1344, 2992, 0}, {1008, 2244, 0}, {672, 1496, 0}};
+    static const int kFrameRates[] = {1, 5, 10, 24, 30, 48, 60, 72, 80, 90, 96, 120};
+
+    Configs configs;
+    uint32_t id = 0;
+    for (int r = 0; r < numResolutions; r++) {
+        for (int te : {120, 240}) {
+            for (int fps : kFrameRates) {
+                configs[id++] = {static_cast<uint32_t>(1e9 / te), kResolutions[r].width,
+                                 kResolutions[r].height, fps};
+            }
+            configs[id++] = {static_cast<uint32_t>(1e9 / te), kResolutions[r].width,
+                             kResolutions[r].height, te};
+        }
+        configs[id++] = {static_cast<uint32_t>(1e9 / 60), kResolutions[r].width,
+                         kResolutions[r].height, 60};
+        configs[id++] = {static_cast<uint32_t>(1e9 / 30), kResolutions[r].width,
+                         kResolutions[r].height, 30};
+    }
+    return configs;
+}
+
+// Modes of an external display, listed with the preferred mode first
+Configs makeExternalDisplay(uint32_t firstId, uint32_t idStep) {
+    static const Mode kModes[] = {{1920, 1080, 60}, {3840, 2160, 30}, {3840, 2160, 60},
+                                  {1920, 1080, 50}, {1280, 720, 60},  {1920, 1080, 24},
+                                  {720, 480, 60}};
+
+    Configs configs;
+    uint32_t id = firstId;
+    for (const auto& mode : kModes) {
+        configs[id] = {static_cast<uint32_t>(1e9 / mode.fps), mode.width, mode.height, mode.fps};
+        id += idStep;
+    }
+    return configs;
+}
+
+// The scans ExynosDisplay did over mDisplayConfigs before DisplayConfigIndex
+int scanLookup(const Configs& configs, int32_t width, int32_t height, int32_t fps,
+               int32_t vsyncRate) {
+    const auto vsyncPeriod = nsecsPerSec / vsyncRate;
+    for (auto const& [config, mode] : configs) {
+        long delta = std::abs(vsyncPeriod - mode.vsyncPeriod);
+        if ((width == 0 || width == mode.width) && (height == 0 || height == mode.height) &&
+            (delta < nsecsPerMs) && (fps == mode.refreshRate))
+            return config;
+    }
+    return -1;
+}
+
+int scanLookupRelaxed(const Configs& configs, int32_t width, int32_t height, int32_t fps) {
+    if (fps <= 1) return -1;
+    const auto vsyncPeriod = nsecsPerSec / fps;
+    const auto vsyncPeriodMin = nsecsPerSec / (fps + 1);
+    const auto vsyncPeriodMax = nsecsPerSec / (fps - 1);
+    for (auto const& [config, mode] : configs) {
+        if (mode.width == width && mode.height == height && mode.vsyncPeriod == vsyncPeriod)
+            return config;
+    }
+    for (auto const& [config, mode] : configs) {
+        if (mode.width == width && mode.height == height && mode.vsyncPeriod >= vsyncPeriodMin &&
+            mode.vsyncPeriod <= vsyncPeriodMax)
+            return config;
+    }
+    for (auto const& [config, mode] : configs) {
+        if (mode.width <= width && mode.height <= height && mode.vsyncPeriod >= vsyncPeriodMin &&
+            mode.vsyncPeriod <= vsyncPeriodMax)
+            return config;
+    }
+    return -1;
+}
+
+uint32_t scanGetConfigId(const Configs& configs, int32_t refreshRate, int32_t width,
+                         int32_t height) {
+    for (auto entry : configs) {
+        if (entry.second.refreshRate == refreshRate && entry.second.width == width &&
+            entry.second.height == height)
+            return entry.first;
+    }
+    return UINT_MAX;
+}
+
+// The lookups as ExynosDisplay does them with DisplayConfigIndex
+int indexLookup(const DisplayConfigIndex& index, int32_t width, int32_t height, int32_t fps,
+                int32_t vsyncRate) {
+    if (!fps || !vsyncRate) return -1;
+    const auto vsyncPeriod = nsecsPerSec / vsyncRate;
+    auto config = index.lookup(width, height,
+                               static_cast<int64_t>(floor(vsyncPeriod - nsecsPerMs)) + 1,
+                               static_cast<int64_t>(ceil(vsyncPeriod + nsecsPerMs)) - 1, fps);
+    return config ? static_cast<int>(*config) : -1;
+}
+
+int indexLookupRelaxed(const DisplayConfigIndex& index, int32_t width, int32_t height,
+                       int32_t fps) {
+    if (fps <= 1 || width <= 0 || height <= 0) return -1;
+    const auto vsyncPeriod = nsecsPerSec / fps;
+    const auto vsyncPeriodMin = static_cast<int64_t>(ceil(nsecsPerSec / (fps + 1)));
+    const auto vsyncPeriodMax = static_cast<int64_t>(floor(nsecsPerSec / (fps - 1)));
+    std::optional<uint32_t> config;
+    if (vsyncPeriod == floor(vsyncPeriod))
+        config = index.lookup(width, height, static_cast<int64_t>(vsyncPeriod),
+                              static_cast<int64_t>(vsyncPeriod));
+    if (!config) config = index.lookup(width, height, vsyncPeriodMin, vsyncPeriodMax);
+    if (!config) config = index.lookupFitting(width, height, vsyncPeriodMin, vsyncPeriodMax);
+    return config ? static_cast<int>(*config) : -1;
+}
+
+// Requests of setActiveConfig, boot config and external display paths
+std::vector<Mode> makeQueries() {
+    std::vector<Mode> queries;
+    for (int fps : {1, 10, 24, 30, 50, 60, 90, 120, 240, 144}) {
+        queries.push_back({1344, 2992, fps});
+        queries.push_back({1008, 2244, fps});
+        queries.push_back({0, 0, fps});
+        queries.push_back({1344, 0, fps});
+        queries.push_back({0, 2244, fps});
+        queries.push_back({1920, 1080, fps});
+        queries.push_back({3840, 2160, fps});
+        queries.push_back({2000, 3000, fps});
+    }
+    return queries;
+}
+
+class DisplayConfigIndexTest : public ::testing::Test {
+protected:
+    // The index is rebuilt from the configs, as getDisplayConfigs() does
+    void update(Configs configs) {
+        mConfigs = std::move(configs);
+        mIndex.build(mConfigs);
+    }
+
+    void expectExactLookupsMatchScan(const std::vector<Mode>& queries) {
+        for (const auto& q : queries) {
+            SCOPED_TRACE(::testing::Message() << q.width << "x" << q.height << "@" << q.fps);
+            EXPECT_EQ(scanLookup(mConfigs, q.width, q.height, q.fps, q.fps),
+                      indexLookup(mIndex, q.width, q.height, q.fps, q.fps));
+            for (int vsyncRate : {60, 120, 240}) {
+                EXPECT_EQ(scanLookup(mConfigs, q.width, q.height, q.fps, vsyncRate),
+                          indexLookup(mIndex, q.width, q.height, q.fps, vsyncRate));
+            }
+            EXPECT_EQ(scanGetConfigId(mConfigs, q.fps, q.width, q.height),
+                      mIndex.lookupRefreshRate(q.width, q.height, q.fps).value_or(UINT_MAX));
+        }
+    }
+
+    void expectRelaxedLookupsMatchScan(const std::vector<Mode>& queries) {
+        for (const auto& q : queries) {
+            SCOPED_TRACE(::testing::Message() << q.width << "x" << q.height << "@" << q.fps);
+            EXPECT_EQ(scanLookupRelaxed(mConfigs, q.width, q.height, q.fps),
+                      indexLookupRelaxed(mIndex, q.width, q.height, q.fps));
+        }
+    }
+
+    void expectRecordsMatchConfigs() {
+        EXPECT_EQ(mConfigs.size(), mIndex.size());
+        for (const auto& [config, mode] : mConfigs) {
+            const auto record = mIndex.find(config);
+            ASSERT_NE(nullptr, record) << config;
+            EXPECT_EQ(config, record->config);
+            EXPECT_EQ(mode.vsyncPeriod, record->vsyncPeriod);
+            EXPECT_EQ(static_cast<uint32_t>(mode.width), record->width);
+            EXPECT_EQ(static_cast<uint32_t>(mode.height), record->height);
+            EXPECT_EQ(mode.refreshRate, record->refreshRate);
+        }
+    }
+
+    Configs mConfigs;
+    DisplayConfigIndex mIndex;
+};
+
+TEST_F(DisplayConfigIndexTest, ExactLookupsMatchScan) {
+    for (int numResolutions = 1; numResolutions <= 3; numResolutions++) {
+        SCOPED_TRACE(numResolutions);
+        update(makeVrrPanel(numResolutions));
+        expectRecordsMatchConfigs();
+        expectExactLookupsMatchScan(makeQueries());
+    }
+}
+
+TEST_F(DisplayConfigIndexTest, ExactLookupOfMissingRate) {
+    update(makeVrrPanel(1));
+    EXPECT_EQ(-1, indexLookup(mIndex, 1344, 2992, 144, 144));
+    EXPECT_EQ(-1, indexLookup(mIndex, 1344, 2992, 60, 0));
+    EXPECT_EQ(-1, indexLookup(mIndex, 1344, 2992, 0, 120));
+    EXPECT_EQ(-1, indexLookup(mIndex, -1344, 2992, 60, 120));
+    EXPECT_EQ(nullptr, mIndex.find(mConfigs.size()));
+}
+
+TEST_F(DisplayConfigIndexTest, RelaxedLookupsMatchScan) {
+    for (int numResolutions = 1; numResolutions <= 3; numResolutions++) {
+        SCOPED_TRACE(numResolutions);
+        update(makeVrrPanel(numResolutions));
+        expectRelaxedLookupsMatchScan(makeQueries());
+    }
+}
+
+TEST_F(DisplayConfigIndexTest, RelaxedLookupOfEmptySize) {
+    update(makeVrrPanel(3));
+
+    std::vector<Mode> queries;
+    for (int fps : {0, 1, 2, 60, 120}) {
+        for (int size : {0, -1, INT_MIN}) {
+            queries.push_back({size, 2992, fps});
+            queries.push_back({1344, size, fps});
+            queries.push_back({size, size, fps});
+        }
+    }
+    expectRelaxedLookupsMatchScan(queries);
+    for (const auto& q : queries) {
+        EXPECT_EQ(-1, indexLookupRelaxed(mIndex, q.width, q.height, q.fps));
+    }
+
+    // Zero means any size to lookup() only, never to lookupFitting()
+    const int64_t period = static_cast<int64_t>(1e9 / 120);
+    EXPECT_TRUE(mIndex.lookup(0, 0, period, period).has_value());
+    EXPECT_FALSE(mIndex.lookupFitting(0, 2992, period, period).has_value());
+    EXPECT_FALSE(mIndex.lookupFitting(1344, 0, period, period).has_value());
+    EXPECT_FALSE(mIndex.lookupFitting(-1, -1, period, period).has_value());
+    EXPECT_FALSE(mIndex.lookup(-1, 2992, period, period).has_value());
+    EXPECT_FALSE(mIndex.lookupRefreshRate(0, 0, 120).has_value());
+}
+
+TEST_F(DisplayConfigIndexTest, RelaxedLookupFitsSmallerResolution) {
+    update(makeVrrPanel(3));
+
+    // No config runs near 144Hz, and 1100x2300 only fits the smaller resolutions
+    EXPECT_EQ(-1, indexLookupRelaxed(mIndex, 1344, 2992, 144));
+    const int config = indexLookupRelaxed(mIndex, 1100, 2300, 121);
+    ASSERT_NE(-1, config);
+    EXPECT_EQ(1008u, mIndex.find(config)->width);
+    EXPECT_EQ(scanLookupRelaxed(mConfigs, 1100, 2300, 121), config);
+}
+
+TEST_F(DisplayConfigIndexTest, RebuildAfterModeUpdate) {
+    update(makeVrrPanel(3));
+    const size_t panelConfigs = mConfigs.size();
+
+    // Hotplug of another display on the same connector: new mode ids, new sizes
+    update(makeExternalDisplay(panelConfigs, 1));
+    expectRecordsMatchConfigs();
+    for (uint32_t config = 0; config < panelConfigs; config++) {
+        EXPECT_EQ(nullptr, mIndex.find(config)) << config;
+    }
+    EXPECT_EQ(-1, indexLookup(mIndex, 1344, 2992, 120, 120));
+    EXPECT_FALSE(mIndex.lookupRefreshRate(1008, 2244, 60).has_value());
+    expectExactLookupsMatchScan(makeQueries());
+    expectRelaxedLookupsMatchScan(makeQueries());
+
+    // Sparse mode ids are found without the slot table
+    update(makeExternalDisplay(1000, 97));
+    expectRecordsMatchConfigs();
+    EXPECT_EQ(nullptr, mIndex.find(1001));
+    EXPECT_EQ(nullptr, mIndex.find(panelConfigs));
+    expectExactLookupsMatchScan(makeQueries());
+    expectRelaxedLookupsMatchScan(makeQueries());
+
+    // A connector without modes leaves nothing to find
+    update({});
+    EXPECT_EQ(0u, mIndex.size());
+    EXPECT_EQ(nullptr, mIndex.find(1000));
+    expectExactLookupsMatchScan(makeQueries());
+    expectRelaxedLookupsMatchScan(makeQueries());
+
+    update(makeVrrPanel(2));
+    expectRecordsMatchConfigs();
+    expectExactLookupsMatchScan(makeQueries());
+    expectRelaxedLookupsMatchScan(makeQueries());
+}
+
+TEST_F(DisplayConfigIndexTest, ClearDropsEverything) {
+    update(makeVrrPanel(1));
+    mIndex.clear();
+    EXPECT_EQ(0u, mIndex.size());
+    EXPECT_EQ(nullptr, mIndex.find(0));
+    EXPECT_EQ(-1, indexLookup(mIndex, 0, 0, 60, 60));
+    EXPECT_FALSE(mIndex.lookupRefreshRate(1344, 2992, 60).has_value());
+}
+
+} // namespace
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "DisplayTemperatureMonitor.h"
+
+using ScreenState = DisplayTemperatureMonitor::ScreenState;
+
+/*
+ * Drives the sampling logic of the monitor directly, and the sampling thread
+ * on a regular file standing in for the thermal node. A regular file never
+ * signals POLLPRI, so the thread falls back to its sampling period.
+ */
+class DisplayTemperatureMonitorTest : public ::testing::Test {
+protected:
+    static constexpr int32_t kIntervalSec = 1;
+    static constexpr int32_t kBasePeriodMs = kIntervalSec * 1000;
+
+    void SetUp() override {
+        char path[] = "/tmp/display_temperature_XXXXXX";
+        const int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        mNode = path;
+        mMonitor = create(mNode);
+    }
+
+    void TearDown() override {
+        mMonitor.reset();
+        unlink(mNode.c_str());
+    }
+
+    std::unique_ptr<DisplayTemperatureMonitor> create(const std::string& node) {
+        return std::make_unique<DisplayTemperatureMonitor>(node, kIntervalSec,
+                                                           [this](int32_t temperature) {
+                                                               std::lock_guard<std::mutex> lock(
+                                                                       mMutex);
+                                                               mPublished.push_back(temperature);
+                                                               mCondition.notify_all();
+                                                           });
+    }
+
+    void writeNode(const char* value) {
+        std::ofstream node(mNode, std::ios::trunc);
+        node << value;
+    }
+
+    /* Waits until the listener was called count times in total */
+    bool waitPublished(size_t count) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mCondition.wait_for(lock, std::chrono::seconds(5),
+                                   [&] { return mPublished.size() >= count; });
+    }
+
+    std::vector<int32_t> published() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mPublished;
+    }
+
+    void publish(int32_t milliCelsius) { mMonitor->publish(milliCelsius); }
+    void adaptPeriod(int32_t previous, int32_t sample) {
+        mMonitor->adaptPeriod(previous, sample);
+    }
+    int getWaitTimeoutMs(ScreenState state) const { return mMonitor->getWaitTimeoutMs(state); }
+    int32_t periodMs() const { return mMonitor->mPeriodMs.load(); }
+    int32_t minPeriodMs() const { return mMonitor->mMinPeriodMs; }
+    int32_t maxPeriodMs() const { return mMonitor->mMaxPeriodMs; }
+    void setNotifySupported() { mMonitor->mNotifySupported.store(true); }
+
+    std::string mNode;
+    std::unique_ptr<DisplayTemperatureMonitor> mMonitor;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<int32_t> mPublished;
+};
+
+TEST_F(DisplayTemperatureMonitorTest, PeriodBounds) {
+    EXPECT_EQ(kBasePeriodMs, periodMs());
+    EXPECT_EQ(kBasePeriodMs / 4, minPeriodMs());
+    EXPECT_EQ(kBasePeriodMs * 8, maxPeriodMs());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, FirstSampleIsPublishedRounded) {
+    EXPECT_EQ(DisplayTemperatureMonitor::kInvalidTemperature, mMonitor->getTemperature());
+
+    publish(34500);
+    EXPECT_EQ(35, mMonitor->getTemperature());
+    EXPECT_EQ(std::vector<int32_t>({35}), published());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, NegativeSampleIsRoundedAwayFromZero) {
+    publish(-1500);
+    EXPECT_EQ(-2, mMonitor->getTemperature());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, SamplesAreSmoothed) {
+    publish(30000);
+    // Each sample moves the smoothed value by a quarter of the distance
+    publish(38000);
+    EXPECT_EQ(32, mMonitor->getTemperature());
+    publish(38000);
+    EXPECT_EQ(34, mMonitor->getTemperature());
+    EXPECT_EQ(std::vector<int32_t>({30, 32, 34}), published());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, UnchangedTemperatureIsNotPublished) {
+    publish(30000);
+    publish(30400);
+    publish(29800);
+    EXPECT_EQ(30, mMonitor->getTemperature());
+    EXPECT_EQ(std::vector<int32_t>({30}), published());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, FirstSampleKeepsPeriod) {
+    adaptPeriod(DisplayTemperatureMonitor::kInvalidTemperature, 30000);
+    EXPECT_EQ(kBasePeriodMs, periodMs());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, SlowChangeBacksOffToMaximum) {
+    adaptPeriod(30000, 30100);
+    EXPECT_EQ(kBasePeriodMs * 2, periodMs());
+    adaptPeriod(30100, 30000);
+    EXPECT_EQ(kBasePeriodMs * 4, periodMs());
+    for (int i = 0; i < 4; i++) {
+        adaptPeriod(30000, 30000);
+    }
+    EXPECT_EQ(maxPeriodMs(), periodMs());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, FastChangeSpeedsUpToMinimum) {
+    adaptPeriod(30000, 31500);
+    EXPECT_EQ(kBasePeriodMs / 2, periodMs());
+    adaptPeriod(31500, 30000);
+    EXPECT_EQ(kBasePeriodMs / 4, periodMs());
+    adaptPeriod(30000, 35000);
+    EXPECT_EQ(minPeriodMs(), periodMs());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, ModerateChangeKeepsPeriod) {
+    adaptPeriod(30000, 30250);
+    EXPECT_EQ(kBasePeriodMs, periodMs());
+    adaptPeriod(30250, 29250);
+    EXPECT_EQ(kBasePeriodMs, periodMs());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, WaitTimeout) {
+    EXPECT_EQ(-1, getWaitTimeoutMs(ScreenState::OFF));
+    EXPECT_EQ(-1, getWaitTimeoutMs(ScreenState::DOZE));
+    EXPECT_EQ(kBasePeriodMs, getWaitTimeoutMs(ScreenState::ON));
+
+    adaptPeriod(30000, 32000);
+    EXPECT_EQ(kBasePeriodMs / 2, getWaitTimeoutMs(ScreenState::ON));
+
+    // Once the node notifies, the period only backs up missed notifications
+    setNotifySupported();
+    EXPECT_EQ(maxPeriodMs(), getWaitTimeoutMs(ScreenState::ON));
+    EXPECT_EQ(-1, getWaitTimeoutMs(ScreenState::DOZE));
+}
+
+TEST_F(DisplayTemperatureMonitorTest, ThreadPublishesNodeValue) {
+    writeNode("41200\n");
+    mMonitor->setScreenState(ScreenState::ON);
+    ASSERT_TRUE(waitPublished(1));
+    EXPECT_EQ(41, mMonitor->getTemperature());
+
+    // The next sample is smoothed into the first one
+    writeNode("49200\n");
+    ASSERT_TRUE(waitPublished(2));
+    EXPECT_EQ(43, mMonitor->getTemperature());
+
+    mMonitor->setScreenState(ScreenState::OFF);
+}
+
+TEST_F(DisplayTemperatureMonitorTest, ScreenOnRestartsSmoothing) {
+    writeNode("30000\n");
+    mMonitor->setScreenState(ScreenState::ON);
+    ASSERT_TRUE(waitPublished(1));
+    mMonitor->setScreenState(ScreenState::OFF);
+    // Let the woken thread see the screen off
+    usleep(50 * 1000);
+
+    // The first sample after the screen was off is taken as is
+    writeNode("50000\n");
+    mMonitor->setScreenState(ScreenState::DOZE);
+    ASSERT_TRUE(waitPublished(2));
+    EXPECT_EQ(50, mMonitor->getTemperature());
+}
+
+TEST_F(DisplayTemperatureMonitorTest, MissingNodeIsNotPublished) {
+    auto monitor = create(mNode + ".missing");
+    monitor->setScreenState(ScreenState::ON);
+    usleep(50 * 1000);
+    EXPECT_EQ(DisplayTemperatureMonitor::kInvalidTemperature, monitor->getTemperature());
+    EXPECT_TRUE(published().empty());
+
+    // Stopping the thread does not wait for the retry timeout
+    const auto start = std::chrono::steady_clock::now();
+    monitor.reset();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+TEST_F(DisplayTemperatureMonitorTest, OffScreenIsNotSampled) {
+    writeNode("30000\n");
+    mMonitor->setScreenState(ScreenState::OFF);
+    usleep(50 * 1000);
+    EXPECT_TRUE(published().empty());
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DrmCommittedState.h"
+
+#include <log/log.h>
+
+#include <cstring>
+#include <string>
+
+namespace {
+
+bool endsWith(const std::string &str, const char *suffix) {
+    const size_t len = strlen(suffix);
+    return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+} // namespace
+
+bool DrmCommittedState::isElidable(const android::DrmProperty &property) {
+    if (!property.id() || property.isBlob()) return false;
+
+    const std::string name = property.name();
+
+    // Only CRTC_ID is stable among object properties. FB ids are reused.
+    if (property.isObject()) return name == "CRTC_ID";
+
+    // Fences are created or consumed by every commit and expected present time is
+    // only valid for the commit that carries it.
+    if (endsWith(name, "_FD") || endsWith(name, "_fd") || endsWith(name, "_PTR")) return false;
+    if (name == "expected_present_time") return false;
+
+    return true;
+}
+
+void DrmCommittedState::setDeltaEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mDeltaEnabled = enabled;
+    mValues.clear();
+    mValid = false;
+}
+
+bool DrmCommittedState::isDeltaEnabled() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mDeltaEnabled;
+}
+
+int DrmCommittedState::commit(int fd, drmModeAtomicReqPtr pset, const std::vector<Item> &items,
+                              uint32_t flags, void *userData, CommitStats &stats) {
+    const bool testOnly = !!(flags & DRM_MODE_ATOMIC_TEST_ONLY);
+    const int count = drmModeAtomicGetCursor(pset);
+
+    /* The recorded items must describe pset exactly to build a delta from them */
+    const bool recorded = (static_cast<int>(items.size()) == count);
+    if (!recorded) ALOGW("%s: %zu items recorded for %d properties", __func__, items.size(), count);
+
+    stats = CommitStats();
+    drmModeAtomicReqPtr delta = nullptr;
+    uint64_t sequence;
+    bool overlapped;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        stats.full = !mDeltaEnabled || !mValid || !recorded || testOnly ||
+                !!(flags & DRM_MODE_ATOMIC_ALLOW_MODESET);
+        if (!stats.full && (delta = drmModeAtomicAlloc())) {
+            for (const auto &item : items) {
+                if (item.elidable) {
+                    const auto it = mValues.find(key(item.objectId, item.propertyId));
+                    if (it != mValues.end() && it->second == item.value) {
+                        stats.elided++;
+                        continue;
+                    }
+                }
+
+                if (drmModeAtomicAddProperty(delta, item.objectId, item.propertyId, item.value) <
+                    0) {
+                    ALOGW("%s: failed to build delta request, commit full state", __func__);
+                    drmModeAtomicFree(delta);
+                    delta = nullptr;
+                    stats.elided = 0;
+                    stats.full = true;
+                    break;
+                }
+            }
+        }
+
+        overlapped = (mInFlight++ > 0);
+        sequence = ++mStarted;
+    }
+    stats.sent = count - stats.elided;
+
+    /* Displays commit concurrently, the state is only locked to build and record the delta */
+    int ret = drmModeAtomicCommit(fd, delta ? delta : pset, flags, userData);
+    if (delta) drmModeAtomicFree(delta);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mInFlight--;
+    if (testOnly) return ret;
+
+    if (ret || !mDeltaEnabled || !recorded) {
+        mValues.clear();
+        mValid = false;
+        return ret;
+    }
+
+    /*
+     * Commits that ran at the same time may have reached the kernel in another
+     * order than they are recorded, so what they set is no longer known.
+     */
+    overlapped |= (mStarted != sequence);
+    for (const auto &item : items) {
+        if (!item.elidable) continue;
+        if (overlapped)
+            mValues.erase(key(item.objectId, item.propertyId));
+        else
+            mValues[key(item.objectId, item.propertyId)] = item.value;
+    }
+    mValid = true;
+
+    return ret;
+}
+
+void DrmCommittedState::invalidate() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mValues.clear();
+    mValid = false;
+}
+
+DrmCommittedState::CrtcPlanes DrmCommittedState::getCrtcPlanes(uint32_t crtcId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    const auto it = mCrtcs.find(crtcId);
+    return (it != mCrtcs.end()) ? it->second.planes : CrtcPlanes();
+}
+
+void DrmCommittedState::setCrtcPlanes(uint32_t crtcId, const std::vector<uint32_t> &planeIds) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // A plane is taken off its previous CRTC by the commit that enables it
+    for (auto &[id, crtc] : mCrtcs) {
+        if (id == crtcId) continue;
+        for (const auto planeId : planeIds) crtc.planes.ids.erase(planeId);
+    }
+
+    auto &planes = mCrtcs[crtcId].planes;
+    planes.known = true;
+    planes.ids.clear();
+    planes.ids.insert(planeIds.begin(), planeIds.end());
+}
+
+void DrmCommittedState::setCrtcCommitted(uint32_t crtcId, uint32_t connectorId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mCrtcs[crtcId].cleared = false;
+    mDetachedConnectors.erase(connectorId);
+}
+
+void DrmCommittedState::setCrtcCleared(uint32_t crtcId, uint32_t connectorId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mCrtcs[crtcId].cleared = true;
+    mDetachedConnectors.insert(connectorId);
+}
+
+bool DrmCommittedState::isCrtcCleared(uint32_t crtcId, uint32_t connectorId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    const auto it = mCrtcs.find(crtcId);
+    return (it != mCrtcs.end()) && it->second.cleared && mDetachedConnectors.count(connectorId);
+}
+
+void DrmCommittedState::resetCrtcs() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mCrtcs.clear();
+    mDetachedConnectors.clear();
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _DRMCOMMITTEDSTATE_H
+#define _DRMCOMMITTEDSTATE_H
+
+#include <xf86drmMode.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "drmproperty.h"
+
+/*
+ * DrmCommittedState keeps the property values of the last successful atomic
+ * commits on a DrmDevice. The kernel builds the new state of an object from its
+ * current state, so a property whose value is already committed can be left out
+ * of the atomic request without changing the result.
+ *
+ * Only properties that hold plain state are left out. Blobs, framebuffers and
+ * fences are always sent because their ids are reused or they are consumed by
+ * each commit. TEST_ONLY and modeset commits are sent in full, and the state
+ * is dropped after a failed commit or invalidate(). Displays only use the
+ * state when vendor.display.atomic_delta_commit is set.
+ *
+ * The state is shared by all displays on the device because planes move
+ * between CRTCs.
+ *
+ * It also tracks which planes each CRTC may still scan out and which CRTCs and
+ * connectors were cleared, so that a display leaving a CRTC only disables what
+ * it left on it. This survives invalidate() because it only changes with
+ * commits, and is forgotten with resetCrtcs() after a hotplug or TUI.
+ */
+class DrmCommittedState {
+    public:
+        // A property added to an atomic request, as recorded by its builder
+        struct Item {
+            uint32_t objectId;
+            uint32_t propertyId;
+            uint64_t value;
+            // Whether it can be left out if its value is already committed
+            bool elidable;
+        };
+
+        struct CommitStats {
+            uint32_t sent = 0;
+            uint32_t elided = 0;
+            bool full = true;
+        };
+
+        // Planes that may be enabled on a CRTC
+        struct CrtcPlanes {
+            // Any plane the CRTC supports may be enabled until a commit decides all of them
+            bool known = false;
+            std::unordered_set<uint32_t> ids;
+            bool mayContain(uint32_t planeId) const { return !known || ids.count(planeId); }
+        };
+
+        static bool isElidable(const android::DrmProperty &property);
+
+        void setDeltaEnabled(bool enabled);
+        bool isDeltaEnabled();
+
+        /*
+         * Commits @pset leaving out the elidable @items whose values are equal
+         * to the committed ones. @items lists the properties of @pset in the
+         * order they were added. The state is not locked while the commit
+         * is in the kernel.
+         */
+        int commit(int fd, drmModeAtomicReqPtr pset, const std::vector<Item> &items,
+                   uint32_t flags, void *userData, CommitStats &stats);
+        // Makes the next commit send every property
+        void invalidate();
+
+        CrtcPlanes getCrtcPlanes(uint32_t crtcId);
+        // Records the planes left on @crtcId by a successful commit
+        void setCrtcPlanes(uint32_t crtcId, const std::vector<uint32_t> &planeIds);
+        // Records a successful commit other than a clear that used @crtcId
+        void setCrtcCommitted(uint32_t crtcId, uint32_t connectorId);
+        // Records a successful commit that disabled @crtcId and detached @connectorId
+        void setCrtcCleared(uint32_t crtcId, uint32_t connectorId);
+        bool isCrtcCleared(uint32_t crtcId, uint32_t connectorId);
+        // Forgets the planes of every CRTC, e.g. after another world used them
+        void resetCrtcs();
+
+    private:
+        static uint64_t key(uint32_t objectId, uint32_t propertyId) {
+            return (static_cast<uint64_t>(objectId) << 32) | propertyId;
+        }
+
+        std::mutex mMutex;
+        bool mDeltaEnabled = false;
+        bool mValid = false;
+        std::unordered_map<uint64_t, uint64_t> mValues;
+        // Commits sent to the kernel and not completed yet
+        uint32_t mInFlight = 0;
+        // Commits started so far
+        uint64_t mStarted = 0;
+
+        struct CrtcState {
+            CrtcPlanes planes;
+            bool cleared = false;
+        };
+        std::unordered_map<uint32_t, CrtcState> mCrtcs;
+        std::unordered_set<uint32_t> mDetachedConnectors;
+};
+
+#endif // _DRMCOMMITTEDSTATE_H
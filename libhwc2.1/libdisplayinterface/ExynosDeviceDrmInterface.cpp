@@ -16,6 +16,7 @@
 
 #include "ExynosDeviceDrmInterface.h"
 
+#include <cutils/properties.h>
 #include <drm/drm_mode.h>
 #include <drm/samsung_drm.h>
 #include <hardware/hwcomposer_defs.h>
@@ -98,8 +99,10 @@ void ExynosDeviceDrmInterface::init(ExynosDevice *exynosDevice) {
 
     updateRestrictions();
 
+    mCommittedState.setDeltaEnabled(property_get_bool("vendor.display.atomic_delta_commit", false));
+
     if (mExynosDrmEventHandler) {
-        mExynosDrmEventHandler->init(mExynosDevice, mDrmDevice);
+        mExynosDrmEventHandler->init(mExynosDevice, mDrmDevice, &mCommittedState);
         mDrmDevice->event_listener()->RegisterHotplugHandler(
                 std::static_pointer_cast<DrmEventHandler>(mExynosDrmEventHandler));
         mDrmDevice->event_listener()->RegisterHistogramHandler(
@@ -132,6 +135,9 @@ int32_t ExynosDeviceDrmInterface::initDisplayInterface(
         std::unique_ptr<ExynosDisplayInterface> &dispInterface) {
     ExynosDisplayDrmInterface *displayInterface =
         static_cast<ExynosDisplayDrmInterface*>(dispInterface.get());
+    /* Commits go straight to the kernel unless atomic delta commits are enabled */
+    if (mCommittedState.isDeltaEnabled())
+        displayInterface->setCommittedState(&mCommittedState);
     return displayInterface->initDrmDevice(mDrmDevice);
 }
 
@@ -236,12 +242,17 @@ void ExynosDeviceDrmInterface::updateRestrictions() {
 }
 
 void ExynosDeviceDrmInterface::ExynosDrmEventHandler::init(ExynosDevice *exynosDevice,
-                                                           DrmDevice *drmDevice) {
+                                                           DrmDevice *drmDevice,
+                                                           DrmCommittedState *committedState) {
     mExynosDevice = exynosDevice;
     mDrmDevice = drmDevice;
+    mCommittedState = committedState;
 }
 
 void ExynosDeviceDrmInterface::ExynosDrmEventHandler::handleEvent(uint64_t timestamp_us) {
+    /* A connector or CRTC may be reset by the driver on hotplug */
+    mCommittedState->invalidate();
+    mCommittedState->resetCrtcs();
     mExynosDevice->handleHotplug();
 }
 
@@ -314,6 +325,10 @@ void ExynosDeviceDrmInterface::ExynosDrmEventHandler::handleContextHistogramEven
 #endif
 
 void ExynosDeviceDrmInterface::ExynosDrmEventHandler::handleTUIEvent() {
+    /* The secure world owns the planes while in TUI */
+    mCommittedState->invalidate();
+    mCommittedState->resetCrtcs();
+
     if (mDrmDevice->event_listener()->IsDrmInTUI()) {
         /* Received TUI Enter event */
         if (!mExynosDevice->isInTUI()) {
@@ -392,3 +407,7 @@ int32_t ExynosDeviceDrmInterface::registerSysfsEventHandler(
 int32_t ExynosDeviceDrmInterface::unregisterSysfsEventHandler(int sysfsFd) {
     return mDrmDevice->event_listener()->UnRegisterSysfsHandler(sysfsFd);
 }
+
+void ExynosDeviceDrmInterface::bumpHotplugEpoch() {
+    mDrmDevice->event_listener()->BumpHotplugEpoch();
+}
@@ -19,6 +19,7 @@
 
 #include "resourcemanager.h"
 #include "ExynosDeviceInterface.h"
+#include "DrmCommittedState.h"
 
 using namespace android;
 
@@ -35,6 +36,7 @@ class ExynosDeviceDrmInterface : public ExynosDeviceInterface {
         virtual int32_t registerSysfsEventHandler(
                 std::shared_ptr<DrmSysfsEventHandler> handler) override;
         virtual int32_t unregisterSysfsEventHandler(int sysfsFd) override;
+        virtual void bumpHotplugEpoch() override;
 
     protected:
         class ExynosDrmEventHandler : public DrmEventHandler,
@@ -52,14 +54,18 @@ class ExynosDeviceDrmInterface : public ExynosDeviceInterface {
             void handleTUIEvent() override;
             void handleIdleEnterEvent(char const *event) override;
             void handleDrmPropertyUpdate(unsigned connector_id, unsigned prop_id) override;
-            void init(ExynosDevice *exynosDevice, DrmDevice *drmDevice);
+            void init(ExynosDevice *exynosDevice, DrmDevice *drmDevice,
+                      DrmCommittedState *committedState);
 
         private:
             ExynosDevice *mExynosDevice;
             DrmDevice *mDrmDevice;
+            DrmCommittedState *mCommittedState;
         };
         ResourceManager mDrmResourceManager;
         DrmDevice *mDrmDevice;
+        /* Property values committed to mDrmDevice by all displays */
+        DrmCommittedState mCommittedState;
         std::shared_ptr<ExynosDrmEventHandler> mExynosDrmEventHandler;
 };
 
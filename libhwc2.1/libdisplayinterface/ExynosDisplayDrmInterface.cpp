@@ -175,6 +175,19 @@ void FramebufferManager::removeFBsThreadRoutine()
 }
 
 int32_t FramebufferManager::getBuffer(const exynos_win_config_data &config, uint32_t &fbId) {
+    bool added = false;
+    return getBufferInternal(config, fbId, false, added);
+}
+
+int32_t FramebufferManager::getTestBuffer(const exynos_win_config_data &config, uint32_t &fbId,
+                                          bool &outTemporary) {
+    outTemporary = false;
+    return getBufferInternal(config, fbId, true, outTemporary);
+}
+
+int32_t FramebufferManager::getBufferInternal(const exynos_win_config_data &config,
+                                              uint32_t &fbId, const bool testOnly,
+                                              bool &outAdded) {
     ATRACE_CALL();
     int ret = NO_ERROR;
     int drmFormat = DRM_FORMAT_UNDEFINED;
@@ -219,7 +232,8 @@ int32_t FramebufferManager::getBuffer(const exynos_win_config_data &config, uint
         fbId = findCachedFbId(config.layer, isSecureBuffer,
                               [bufferDesc = Framebuffer::BufferDesc{config.buffer_id, drmFormat,
                                                                     config.protection}](
-                                      auto& buffer) { return buffer->bufferDesc == bufferDesc; });
+                                      auto& buffer) { return buffer->bufferDesc == bufferDesc; },
+                              testOnly);
         if (fbId != 0) {
             return NO_ERROR;
         }
@@ -271,7 +285,8 @@ int32_t FramebufferManager::getBuffer(const exynos_win_config_data &config, uint
         pitches[0] = config.dst.w * bpp;
         fbId = findCachedFbId(config.layer, isSecureBuffer,
                               [colorDesc = Framebuffer::SolidColorDesc{bufWidth, bufHeight}](
-                                      auto& buffer) { return buffer->colorDesc == colorDesc; });
+                                      auto& buffer) { return buffer->colorDesc == colorDesc; },
+                              testOnly);
         if (fbId != 0) {
             return NO_ERROR;
         }
@@ -299,6 +314,10 @@ int32_t FramebufferManager::getBuffer(const exynos_win_config_data &config, uint
         return ret;
     }
 
+    outAdded = true;
+    /* Not cached, the caller removes it */
+    if (testOnly) return NO_ERROR;
+
     if (config.layer || config.buffer_id) {
         Mutex::Autolock lock(mMutex);
         auto& cachedBuffers = (!isSecureBuffer) ? mCachedLayerBuffers[config.layer]
@@ -306,6 +325,7 @@ int32_t FramebufferManager::getBuffer(const exynos_win_config_data &config, uint
         auto maxCachedBufferSize = (!isSecureBuffer) ? MAX_CACHED_BUFFERS_PER_LAYER
                                                      : MAX_CACHED_SECURE_BUFFERS_PER_LAYER;
         markInuseLayerLocked(config.layer, isSecureBuffer);
+        mAddedFbs++;
 
         if (cachedBuffers.size() > maxCachedBufferSize) {
             ALOGW("FBManager: cached buffers size %zu exceeds limitation(%zu) while adding fbId %d",
@@ -355,6 +375,16 @@ void FramebufferManager::releaseAll()
     mCleanBuffers.clear();
 }
 
+void FramebufferManager::dump(String8 &result)
+{
+    Mutex::Autolock lock(mMutex);
+    size_t cachedBuffers = 0;
+    for (const auto &[layer, bufferList] : mCachedLayerBuffers) cachedBuffers += bufferList.size();
+    result.appendFormat("FBManager: %zu cached layers with %zu fbIds, reused %" PRIu64
+                        ", added %" PRIu64 "\n",
+                        mCachedLayerBuffers.size(), cachedBuffers, mCachedFbHits, mAddedFbs);
+}
+
 void FramebufferManager::freeBufHandle(uint32_t handle) {
     if (handle == 0) {
         return;
@@ -944,6 +974,9 @@ int32_t ExynosDisplayDrmInterface::setLowPowerMode() {
         return HWC2_ERROR_UNSUPPORTED;
     }
 
+    /* The driver may reset the state of the pipeline on power transitions */
+    if (mCommittedState) mCommittedState->invalidate();
+
     uint32_t mm_width = mDrmConnector->mm_width();
     uint32_t mm_height = mDrmConnector->mm_height();
 
@@ -964,6 +997,10 @@ int32_t ExynosDisplayDrmInterface::setLowPowerMode() {
 int32_t ExynosDisplayDrmInterface::setPowerMode(int32_t mode)
 {
     int ret = 0;
+
+    /* The driver may reset the state of the pipeline on power transitions */
+    if (mCommittedState) mCommittedState->invalidate();
+
     uint64_t dpms_value = 0;
     if (mode == HWC_POWER_MODE_OFF) {
         dpms_value = DRM_MODE_DPMS_OFF;
@@ -1123,6 +1160,7 @@ int32_t ExynosDisplayDrmInterface::getDisplayConfigs(
                 ALOGE("%s: DRM_MODE_CONNECTED, but no modes available",
                       mExynosDisplay->mDisplayName.c_str());
                 mExynosDisplay->mDisplayConfigs.clear();
+                mExynosDisplay->updateDisplayConfigIndex();
                 mExynosDisplay->mPlugState = false;
                 *outNumConfigs = 0;
                 return HWC2_ERROR_BAD_DISPLAY;
@@ -1150,6 +1188,7 @@ int32_t ExynosDisplayDrmInterface::getDisplayConfigs(
             configs.vsyncPeriod = static_cast<int32_t>(mode.te_period());
             if (configs.vsyncPeriod <= 0.0f) {
                 ALOGE("%s:: invalid vsync period", __func__);
+                mExynosDisplay->updateDisplayConfigIndex();
                 return HWC2_ERROR_BAD_DISPLAY;
             }
             configs.isOperationRateToBts = mode.is_operation_rate_to_bts();
@@ -1172,6 +1211,7 @@ int32_t ExynosDisplayDrmInterface::getDisplayConfigs(
                 configs.vrrConfig = std::make_optional(vrrConfig);
                 if (mode.is_vrr_mode()) {
                     if (!isVrrSupported()) {
+                        mExynosDisplay->updateDisplayConfigIndex();
                         return HWC2_ERROR_BAD_DISPLAY;
                     }
                     configs.vrrConfig->isFullySupported = true;
@@ -1200,6 +1240,7 @@ int32_t ExynosDisplayDrmInterface::getDisplayConfigs(
                   configs.Xdpi, configs.Ydpi, mode.is_vrr_mode() ? "true" : "false",
                   mode.is_ns_mode() ? "true" : "false");
         }
+        mExynosDisplay->updateDisplayConfigIndex();
         mExynosDisplay->setPeakRefreshRate(peakRr);
     }
 
@@ -1685,7 +1726,8 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         const exynos_win_config_data &config,
         const uint32_t configIndex,
         const std::unique_ptr<DrmPlane> &plane,
-        uint32_t &fbId)
+        uint32_t &fbId,
+        const bool testOnly)
 {
     ATRACE_CALL();
     int ret = NO_ERROR;
@@ -1829,6 +1871,7 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
 
     if (config.state == config.WIN_STATE_RCD) {
         if (plane->block_property().id()) {
+            uint32_t blockBlobId = mBlockState.mBlobId;
             if (mBlockState != config.block_area) {
                 uint32_t blobId = 0;
                 ret = mDrmDevice->CreatePropertyBlob(&config.block_area, sizeof(config.block_area),
@@ -1839,15 +1882,21 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
                     return ret;
                 }
 
-                mBlockState.mRegion = config.block_area;
-                if (mBlockState.mBlobId) {
-                    drmReq.addOldBlob(mBlockState.mBlobId);
+                if (testOnly) {
+                    /* The blob of a TEST_ONLY commit goes away with the request */
+                    drmReq.addOldBlob(blobId);
+                } else {
+                    mBlockState.mRegion = config.block_area;
+                    if (mBlockState.mBlobId) {
+                        drmReq.addOldBlob(mBlockState.mBlobId);
+                    }
+                    mBlockState.mBlobId = blobId;
                 }
-                mBlockState.mBlobId = blobId;
+                blockBlobId = blobId;
             }
 
             if ((ret = drmReq.atomicAddProperty(plane->id(), plane->block_property(),
-                                                mBlockState.mBlobId)) < 0) {
+                                                blockBlobId)) < 0) {
                 HWC_LOGE(mExynosDisplay, "Failed to set blocking region property %d", ret);
                 return ret;
             }
@@ -1960,6 +2009,124 @@ int32_t ExynosDisplayDrmInterface::updateColorSettings(DrmModeAtomicReq &drmReq,
     return ret;
 }
 
+DrmCommittedState::CrtcPlanes ExynosDisplayDrmInterface::getCommittedCrtcPlanes()
+{
+    /* Without atomic delta commits every plane the CRTC supports is disabled */
+    if (mCommittedState == nullptr)
+        return DrmCommittedState::CrtcPlanes();
+
+    return mCommittedState->getCrtcPlanes(mDrmCrtc->id());
+}
+
+int32_t ExynosDisplayDrmInterface::disableUnusedPlanes(
+        DrmModeAtomicReq &drmReq, std::unordered_map<uint32_t, uint32_t> &planeEnableInfo,
+        std::vector<uint32_t> *crtcPlanes)
+{
+    int ret = NO_ERROR;
+    const auto committedPlanes = getCommittedCrtcPlanes();
+
+    for (auto &plane : mDrmDevice->planes()) {
+        if (planeEnableInfo[plane->id()] == 0) {
+            /* If this plane is not supported by the CRTC binded with ExynosDisplay,
+             * it should be disabled by this ExynosDisplay */
+            if (!plane->GetCrtcSupported(*mDrmCrtc))
+                continue;
+
+            /* Planes that are known to be off the CRTC need no update */
+            if (!committedPlanes.mayContain(plane->id()))
+                continue;
+
+            /* Don't disable planes that are reserved to other display */
+            ExynosMPP* exynosMPP = mExynosMPPsForPlane[plane->id()];
+            if (((exynosMPP != NULL) && (mExynosDisplay != NULL) &&
+                 (exynosMPP->mAssignedState & MPP_ASSIGN_STATE_RESERVED) &&
+                 (exynosMPP->mReservedDisplay != (int32_t)mExynosDisplay->mDisplayId)) ||
+                ((exynosMPP == NULL) && (mExynosDisplay->mType == HWC_DISPLAY_PRIMARY) &&
+                 (plane->id() != static_cast<ExynosPrimaryDisplay *>(mExynosDisplay)->mRcdId))) {
+                if (crtcPlanes) crtcPlanes->push_back(plane->id());
+                continue;
+            }
+
+            if ((ret = drmReq.atomicAddProperty(plane->id(),
+                    plane->crtc_property(), 0)) < 0)
+                return ret;
+
+            if ((ret = drmReq.atomicAddProperty(plane->id(),
+                    plane->fb_property(), 0)) < 0)
+                return ret;
+        } else if (crtcPlanes) {
+            crtcPlanes->push_back(plane->id());
+        }
+    }
+
+    return NO_ERROR;
+}
+
+int32_t ExynosDisplayDrmInterface::testWinConfigData(
+        const std::vector<exynos_win_config_data> &configs)
+{
+    ATRACE_CALL();
+    int ret = NO_ERROR;
+    DrmModeAtomicReq drmReq(this);
+    std::unordered_map<uint32_t, uint32_t> planeEnableInfo;
+    /* FBs that are not in mFBManager, the test leaves its cache as it is */
+    std::vector<uint32_t> testFbIds;
+
+    /* Plane configs can't be checked against the pending mode */
+    if (mDesiredModeState.needsModeSet() || mDrmDevice->event_listener()->IsDrmInTUI())
+        return -EAGAIN;
+
+    for (auto &plane : mDrmDevice->planes()) {
+        planeEnableInfo[plane->id()] = 0;
+    }
+
+    for (size_t i = 0; i < configs.size(); i++) {
+        exynos_win_config_data config = configs[i];
+        if ((config.state != config.WIN_STATE_BUFFER) &&
+            (config.state != config.WIN_STATE_COLOR))
+            continue;
+
+        int channelId = 0;
+        if ((channelId = getDeconChannel(config.assignedMPP)) < 0) {
+            HWC_LOGE(mExynosDisplay, "%s:: Failed to get channel id (%d)", __func__, channelId);
+            ret = -EINVAL;
+            break;
+        }
+        if (config.state == config.WIN_STATE_COLOR) {
+            config.src.w = config.dst.w;
+            config.src.h = config.dst.h;
+        }
+        auto &plane = mDrmDevice->planes().at(channelId);
+        uint32_t fbId = 0;
+        bool temporary = false;
+        ret = mFBManager.getTestBuffer(config, fbId, temporary);
+        if (temporary)
+            testFbIds.push_back(fbId);
+        if ((ret < 0) ||
+            ((ret = setupCommitFromDisplayConfig(drmReq, config, i, plane, fbId, true)) < 0)) {
+            /* The FB could not be created, the configs are not tested */
+            ret = (ret == -EINVAL) ? -EAGAIN : ret;
+            break;
+        }
+        planeEnableInfo[plane->id()] = 1;
+    }
+
+    if ((ret == NO_ERROR) && (disableUnusedPlanes(drmReq, planeEnableInfo) < 0))
+        ret = -EAGAIN;
+
+    if (ret == NO_ERROR) {
+        /* Commit without DrmModeAtomicReq::commit() that reports and dumps errors */
+        ret = drmModeAtomicCommit(mDrmDevice->fd(), drmReq.pset(), DRM_MODE_ATOMIC_TEST_ONLY,
+                                  mDrmDevice);
+        HDEBUGLOGD(eDebugResourceManager, "%s:: TEST_ONLY commit ret(%d)", __func__, ret);
+    }
+
+    for (auto fbId : testFbIds)
+        drmModeRmFB(mDrmDevice->fd(), fbId);
+
+    return ret;
+}
+
 int32_t ExynosDisplayDrmInterface::deliverWinConfigData()
 {
     int ret = NO_ERROR;
@@ -1991,12 +2158,17 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData()
         needModesetForReadback = true;
     } else {
         if (mReadbackInfo.mNeedClearReadbackCommit) {
-            if ((ret = clearWritebackCommit(drmReq)) < 0) {
+            /*
+             * Between the frames of a readback capture the connector stays on
+             * the CRTC, so that capturing the next frame doesn't need a modeset
+             */
+            const bool keepConnector = mExynosDisplay->mDpuData.readback_info.keep_connector;
+            if ((ret = clearWritebackCommit(drmReq, keepConnector)) < 0) {
                 HWC_LOGE(mExynosDisplay, "%s: Failed to clear writeback commit ret(%d)",
                          __func__, ret);
                 return ret;
             }
-            needModesetForReadback = true;
+            needModesetForReadback = !keepConnector;
         }
     }
 
@@ -2095,33 +2267,9 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData()
     }
 
     /* Disable unused plane */
-    for (auto &plane : mDrmDevice->planes()) {
-        if (planeEnableInfo[plane->id()] == 0) {
-            /* Don't disable planes that are reserved to other display */
-            ExynosMPP* exynosMPP = mExynosMPPsForPlane[plane->id()];
-            if ((exynosMPP != NULL) && (mExynosDisplay != NULL) &&
-                (exynosMPP->mAssignedState & MPP_ASSIGN_STATE_RESERVED) &&
-                (exynosMPP->mReservedDisplay != (int32_t)mExynosDisplay->mDisplayId))
-                continue;
-
-            if ((exynosMPP == NULL) && (mExynosDisplay->mType == HWC_DISPLAY_PRIMARY) &&
-                (plane->id() != static_cast<ExynosPrimaryDisplay *>(mExynosDisplay)->mRcdId))
-                continue;
-
-            /* If this plane is not supported by the CRTC binded with ExynosDisplay,
-             * it should be disabled by this ExynosDisplay */
-            if (!plane->GetCrtcSupported(*mDrmCrtc))
-                continue;
-
-            if ((ret = drmReq.atomicAddProperty(plane->id(),
-                    plane->crtc_property(), 0)) < 0)
-                return ret;
-
-            if ((ret = drmReq.atomicAddProperty(plane->id(),
-                    plane->fb_property(), 0)) < 0)
-                return ret;
-        }
-    }
+    std::vector<uint32_t> crtcPlanes;
+    if ((ret = disableUnusedPlanes(drmReq, planeEnableInfo, &crtcPlanes)) < 0)
+        return ret;
 
     if (ATRACE_ENABLED()) {
         mExynosDisplay->traceLayerTypes();
@@ -2223,6 +2371,8 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData()
         return ret;
     }
 
+    if (mCommittedState) mCommittedState->setCrtcPlanes(mDrmCrtc->id(), crtcPlanes);
+
     mExynosDisplay->mDpuData.retire_fence = (int)out_fences[mDrmCrtc->pipe()];
     /*
      * [HACK] dup retire_fence for each layer's release fence
@@ -2279,14 +2429,16 @@ int32_t ExynosDisplayDrmInterface::triggerClearDisplayPlanes()
 {
     ATRACE_CALL();
     DrmModeAtomicReq drmReq(this);
+    std::vector<uint32_t> crtcPlanes;
 
-    clearDisplayPlanes(drmReq);
+    clearDisplayPlanes(drmReq, &crtcPlanes);
     int ret = NO_ERROR;
     if ((ret = drmReq.commit(0, true))) {
         HWC_LOGE(mExynosDisplay, "%s:: Failed to commit pset ret=(%d)\n",
                 __func__, ret);
         return ret;
     }
+    if (mCommittedState) mCommittedState->setCrtcPlanes(mDrmCrtc->id(), crtcPlanes);
     return ret;
 }
 
@@ -2294,23 +2446,31 @@ void ExynosDisplayDrmInterface::setXrrSettings(const XrrSettings_t& settings) {
     mXrrSettings = settings;
 }
 
-int32_t ExynosDisplayDrmInterface::clearDisplayPlanes(DrmModeAtomicReq &drmReq)
+int32_t ExynosDisplayDrmInterface::clearDisplayPlanes(DrmModeAtomicReq &drmReq,
+                                                      std::vector<uint32_t> *crtcPlanes)
 {
     int ret = NO_ERROR;
+    const auto committedPlanes = getCommittedCrtcPlanes();
 
     /* Disable all planes */
     for (auto &plane : mDrmDevice->planes()) {
+        /* If this plane is not supported by the CRTC binded with ExynosDisplay,
+         * it should be disabled by this ExynosDisplay */
+        if (!plane->GetCrtcSupported(*mDrmCrtc))
+            continue;
+
+        /* Planes that are known to be off the CRTC need no update */
+        if (!committedPlanes.mayContain(plane->id()))
+            continue;
+
         /* Do not disable planes that are reserved to other dispaly */
         ExynosMPP* exynosMPP = mExynosMPPsForPlane[plane->id()];
         if ((exynosMPP != NULL) && (mExynosDisplay != NULL) &&
             (exynosMPP->mAssignedState & MPP_ASSIGN_STATE_RESERVED) &&
-            (exynosMPP->mReservedDisplay != (int32_t)mExynosDisplay->mDisplayId))
-            continue;
-
-        /* If this plane is not supported by the CRTC binded with ExynosDisplay,
-         * it should be disabled by this ExynosDisplay */
-        if (!plane->GetCrtcSupported(*mDrmCrtc))
+            (exynosMPP->mReservedDisplay != (int32_t)mExynosDisplay->mDisplayId)) {
+            if (crtcPlanes) crtcPlanes->push_back(plane->id());
             continue;
+        }
 
         if ((ret = drmReq.atomicAddProperty(plane->id(),
                                             plane->crtc_property(), 0)) < 0) {
@@ -2321,13 +2481,24 @@ int32_t ExynosDisplayDrmInterface::clearDisplayPlanes(DrmModeAtomicReq &drmReq)
                                             plane->fb_property(), 0)) < 0) {
             break;
         }
+        mTransitionStats.disabledPlanes++;
     }
 
     return ret;
 }
 
+void ExynosDisplayDrmInterface::updateTransitionStats(nsecs_t startTime)
+{
+    const nsecs_t duration = systemTime(SYSTEM_TIME_MONOTONIC) - startTime;
+    mTransitionStats.lastDuration = duration;
+    mTransitionStats.maxDuration = std::max(mTransitionStats.maxDuration, duration);
+    DISPLAY_ATRACE_INT64("Transition duration", duration);
+}
+
 int32_t ExynosDisplayDrmInterface::clearDisplay(bool needModeClear)
 {
+    DISPLAY_ATRACE_CALL();
+    const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
     ExynosDevice *exynosDevice = mExynosDisplay->mDevice;
     const bool isAsyncOff = needModeClear && exynosDevice->isDispOffAsyncSupported() &&
             !exynosDevice->hasOtherDisplayOn(mExynosDisplay) && !mIsFirstClean;
@@ -2337,8 +2508,9 @@ int32_t ExynosDisplayDrmInterface::clearDisplay(bool needModeClear)
     }
     int ret = NO_ERROR;
     DrmModeAtomicReq drmReq(this);
+    std::vector<uint32_t> crtcPlanes;
 
-    ret = clearDisplayPlanes(drmReq);
+    ret = clearDisplayPlanes(drmReq, &crtcPlanes);
     if (ret != NO_ERROR) {
         HWC_LOGE(mExynosDisplay, "%s: Failed to clear planes", __func__);
 
@@ -2354,25 +2526,41 @@ int32_t ExynosDisplayDrmInterface::clearDisplay(bool needModeClear)
         }
     }
 
+    /* The CRTC may already be disabled, e.g. right before swapCrtcs() */
+    const bool needClearMode = needModeClear &&
+            !(mCommittedState && mCommittedState->isCrtcCleared(mDrmCrtc->id(),
+                                                                 mDrmConnector->id()));
+
     /* Disable ModeSet */
-    if (needModeClear && !isAsyncOff) {
+    if (needClearMode && !isAsyncOff) {
         if ((ret = clearDisplayMode(drmReq)) < 0) {
             HWC_LOGE(mExynosDisplay, "%s: Failed to apply display mode", __func__);
             return ret;
         }
     }
 
-    ret = drmReq.commit(DRM_MODE_ATOMIC_ALLOW_MODESET, true);
-    if (ret) {
-        HWC_LOGE(mExynosDisplay, "%s:: Failed to commit pset ret=%d in clearDisplay()\n",
-                __func__, ret);
-        return ret;
+    mTransitionStats.clears++;
+    if (drmModeAtomicGetCursor(drmReq.pset()) == 0) {
+        /* Nothing is left on the CRTC, only the async mode clear below may be needed */
+        mTransitionStats.skippedClears++;
+    } else {
+        ret = drmReq.commit(DRM_MODE_ATOMIC_ALLOW_MODESET, true);
+        if (ret) {
+            HWC_LOGE(mExynosDisplay, "%s:: Failed to commit pset ret=%d in clearDisplay()\n",
+                    __func__, ret);
+            return ret;
+        }
+        if (mCommittedState) {
+            mCommittedState->setCrtcPlanes(mDrmCrtc->id(), crtcPlanes);
+            if (needClearMode && !isAsyncOff)
+                mCommittedState->setCrtcCleared(mDrmCrtc->id(), mDrmConnector->id());
+        }
     }
 
     /* During async off we're clearing planes within a single refresh cycle
      * and then offloading display off asynchronously.
      */
-    if (isAsyncOff) {
+    if (isAsyncOff && needClearMode) {
         if ((ret = clearDisplayMode(drmReq)) < 0) {
             HWC_LOGE(mExynosDisplay, "%s: Failed to apply display mode", __func__);
             return ret;
@@ -2384,9 +2572,12 @@ int32_t ExynosDisplayDrmInterface::clearDisplay(bool needModeClear)
                      __func__, ret);
             return ret;
         }
+        if (mCommittedState)
+            mCommittedState->setCrtcCleared(mDrmCrtc->id(), mDrmConnector->id());
     }
 
     if (needModeClear) mActiveModeState.forceModeSet();
+    updateTransitionStats(startTime);
 
     return NO_ERROR;
 }
@@ -2459,11 +2650,60 @@ int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty(
                     __func__, property.id(), property.name().c_str(), id, ret);
             return ret;
         }
+        if (mDrmDisplayInterface->mCommittedState)
+            mItems.push_back({id, property.id(), value,
+                              mDrmDisplayInterface->isElidableProperty(id, property)});
     }
 
     return NO_ERROR;
 }
 
+bool ExynosDisplayDrmInterface::isElidableProperty(uint32_t objectId, const DrmProperty &property)
+{
+    if (mCommittedState == nullptr)
+        return false;
+
+    /* Connector properties can be changed by the panel driver */
+    if ((objectId != mDrmCrtc->id()) && (mDrmDevice->GetPlane(objectId) == nullptr))
+        return false;
+
+    auto it = mElidableProperties.find(property.id());
+    if (it == mElidableProperties.end())
+        it = mElidableProperties
+                     .emplace(property.id(), DrmCommittedState::isElidable(property))
+                     .first;
+
+    return it->second;
+}
+
+void ExynosDisplayDrmInterface::dump(String8 &result)
+{
+    if (mDrmConnector) {
+        std::lock_guard<std::recursive_mutex> lock(mDrmConnector->modesLock());
+        const auto &connectorState = mDrmConnector->connector_state();
+        result.appendFormat("connector probes: %u, current state queries: %u\n",
+                            connectorState.probe_count(), connectorState.query_count());
+    }
+
+    mFBManager.dump(result);
+    const auto &transition = mTransitionStats;
+    result.appendFormat("transitions: clears %" PRIu64 " (skipped %" PRIu64
+                        "), planes disabled %" PRIu64 ", crtc swaps %" PRIu64 ", last %" PRId64
+                        " us, max %" PRId64 " us\n",
+                        transition.clears, transition.skippedClears, transition.disabledPlanes,
+                        transition.swaps, ns2us(transition.lastDuration),
+                        ns2us(transition.maxDuration));
+
+    if ((mCommittedState == nullptr) || !mCommittedState->isDeltaEnabled())
+        return;
+
+    const auto &stats = mAtomicDeltaStats;
+    result.appendFormat("atomic commits: %" PRIu64 " (full %" PRIu64 "), properties sent: %" PRIu64
+                        ", elided: %" PRIu64 ", last commit sent %u elided %u\n",
+                        stats.commits, stats.fullCommits, stats.sentProps, stats.elidedProps,
+                        stats.lastSentProps, stats.lastElidedProps);
+}
+
 String8& ExynosDisplayDrmInterface::DrmModeAtomicReq::dumpAtomicCommitInfo(
         String8 &result, bool debugPrint)
 {
@@ -2552,8 +2792,29 @@ int ExynosDisplayDrmInterface::DrmModeAtomicReq::commit(uint32_t flags, bool log
      * During kernel is in TUI, all atomic commits should be returned with error EPERM(-1).
      * To avoid handling atomic commit as fail, it needs to check TUI status.
      */
-    int ret = drmModeAtomicCommit(mDrmDisplayInterface->mDrmDevice->fd(),
-            mPset, flags, mDrmDisplayInterface->mDrmDevice);
+    int ret;
+    if (mDrmDisplayInterface->mCommittedState) {
+        DrmCommittedState::CommitStats stats;
+        ret = mDrmDisplayInterface->mCommittedState->commit(mDrmDisplayInterface->mDrmDevice->fd(),
+                                                            mPset, mItems, flags,
+                                                            mDrmDisplayInterface->mDrmDevice,
+                                                            stats);
+        if ((ret == 0) && !(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+            mDrmDisplayInterface->mCommittedState
+                    ->setCrtcCommitted(mDrmDisplayInterface->mDrmCrtc->id(),
+                                       mDrmDisplayInterface->mDrmConnector->id());
+            auto &deltaStats = mDrmDisplayInterface->mAtomicDeltaStats;
+            deltaStats.commits++;
+            if (stats.full) deltaStats.fullCommits++;
+            deltaStats.sentProps += stats.sent;
+            deltaStats.elidedProps += stats.elided;
+            deltaStats.lastSentProps = stats.sent;
+            deltaStats.lastElidedProps = stats.elided;
+        }
+    } else {
+        ret = drmModeAtomicCommit(mDrmDisplayInterface->mDrmDevice->fd(),
+                mPset, flags, mDrmDisplayInterface->mDrmDevice);
+    }
     if (loggingForDebug)
         dumpAtomicCommitInfo(result, true);
     if ((ret == -EPERM) && mDrmDisplayInterface->mDrmDevice->event_listener()->IsDrmInTUI()) {
@@ -2643,14 +2904,25 @@ int32_t ExynosDisplayDrmInterface::setupWritebackCommit(DrmModeAtomicReq &drmReq
 
     uint32_t writeback_fb_id = 0;
     exynos_win_config_data writeback_config;
-    VendorGraphicBufferMeta gmeta(mExynosDisplay->mDpuData.readback_info.handle);
+    const exynos_readback_info &readbackInfo = mExynosDisplay->mDpuData.readback_info;
+    VendorGraphicBufferMeta gmeta(readbackInfo.handle);
+    uint32_t width = mExynosDisplay->mXres;
+    uint32_t height = mExynosDisplay->mYres;
+    if (readbackInfo.width && readbackInfo.height) {
+        if ((readbackInfo.width != width || readbackInfo.height != height) &&
+            !mReadbackInfo.mScalingSupported) {
+            ALOGE("%s: writeback can't scale to %ux%u", __func__, readbackInfo.width,
+                  readbackInfo.height);
+            return -EINVAL;
+        }
+        width = readbackInfo.width;
+        height = readbackInfo.height;
+    }
 
     writeback_config.state = exynos_win_config_data::WIN_STATE_BUFFER;
     writeback_config.format = mReadbackInfo.mReadbackFormat;
-    writeback_config.src = {0, 0, mExynosDisplay->mXres, mExynosDisplay->mYres,
-                            gmeta.stride, gmeta.vstride};
-    writeback_config.dst = {0, 0, mExynosDisplay->mXres, mExynosDisplay->mYres,
-                            gmeta.stride, gmeta.vstride};
+    writeback_config.src = {0, 0, width, height, gmeta.stride, gmeta.vstride};
+    writeback_config.dst = {0, 0, width, height, gmeta.stride, gmeta.vstride};
     writeback_config.fd_idma[0] = gmeta.fd;
     writeback_config.fd_idma[1] = gmeta.fd1;
     writeback_config.fd_idma[2] = gmeta.fd2;
@@ -2679,7 +2951,8 @@ int32_t ExynosDisplayDrmInterface::setupWritebackCommit(DrmModeAtomicReq &drmReq
     return NO_ERROR;
 }
 
-int32_t ExynosDisplayDrmInterface::clearWritebackCommit(DrmModeAtomicReq &drmReq)
+int32_t ExynosDisplayDrmInterface::clearWritebackCommit(DrmModeAtomicReq &drmReq,
+                                                        bool keepConnector)
 {
     int ret;
 
@@ -2697,6 +2970,9 @@ int32_t ExynosDisplayDrmInterface::clearWritebackCommit(DrmModeAtomicReq &drmReq
             writeback_conn->writeback_out_fence(), 0)) < 0)
         return ret;
 
+    if (keepConnector)
+        return NO_ERROR;
+
     if ((ret = drmReq.atomicAddProperty(writeback_conn->id(),
             writeback_conn->crtc_id_property(), 0)) < 0)
         return ret;
@@ -2743,6 +3019,9 @@ void ExynosDisplayDrmInterface::DrmReadbackInfo::init(DrmDevice *drmDevice, uint
         }
         drmModeFreePropertyBlob(blob);
     }
+
+    /* Writeback connectors have no property to report it, the board does */
+    mScalingSupported = property_get_bool("ro.vendor.display.writeback_scaling", false);
 }
 
 void ExynosDisplayDrmInterface::DrmReadbackInfo::pickFormatDataspace()
@@ -3070,6 +3349,8 @@ ExynosDisplay* ExynosDisplayDrmInterface::borrowedCrtcFrom() {
 }
 
 int32_t ExynosDisplayDrmInterface::swapCrtcs(ExynosDisplay* anotherDisplay) {
+    DISPLAY_ATRACE_CALL();
+    const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
     if (!anotherDisplay) {
         HWC_LOGE(mExynosDisplay, "%s: failed, anotherDisplay is null", __func__);
         return -EINVAL;
@@ -3130,5 +3411,9 @@ int32_t ExynosDisplayDrmInterface::swapCrtcs(ExynosDisplay* anotherDisplay) {
     } else {
         mBorrowedCrtcFrom = anotherDisplay;
     }
+
+    mTransitionStats.swaps++;
+    updateTransitionStats(startTime);
+    ALOGD("%s: done in %" PRId64 " us", __func__, ns2us(mTransitionStats.lastDuration));
     return 0;
 }
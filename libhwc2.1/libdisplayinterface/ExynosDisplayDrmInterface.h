@@ -25,6 +25,7 @@
 #include <list>
 #include <unordered_map>
 
+#include "DrmCommittedState.h"
 #include "ExynosDisplay.h"
 #include "ExynosDisplayInterface.h"
 #include "ExynosHWC.h"
@@ -85,6 +86,12 @@ class FramebufferManager {
         // layer. Those fbIds will be cleaned up once the layer was destroyed.
         int32_t getBuffer(const exynos_win_config_data &config, uint32_t &fbId);
 
+        // get buffer for a TEST_ONLY commit without changing the cache. A cached buffer is only
+        // looked up, otherwise one is allocated and @outTemporary is set, the caller removes it
+        // with drmModeRmFB() after the commit.
+        int32_t getTestBuffer(const exynos_win_config_data &config, uint32_t &fbId,
+                              bool &outTemporary);
+
         void checkShrink();
 
         void cleanup(const ExynosLayer *layer);
@@ -102,6 +109,8 @@ class FramebufferManager {
         // off
         void releaseAll();
 
+        void dump(String8 &result);
+
     private:
         // this struct should contain elements that can be used to identify framebuffer more easily
         struct Framebuffer {
@@ -147,7 +156,9 @@ class FramebufferManager {
 
         template <class UnaryPredicate>
         uint32_t findCachedFbId(const ExynosLayer* layer, const bool isSecureBuffer,
-                                UnaryPredicate predicate);
+                                UnaryPredicate predicate, const bool testOnly = false);
+        int32_t getBufferInternal(const exynos_win_config_data &config, uint32_t &fbId,
+                                  const bool testOnly, bool &outAdded);
         int addFB2WithModifiers(uint32_t state, uint32_t width, uint32_t height, uint32_t drmFormat,
                                 const DrmArray<uint32_t> &handles,
                                 const DrmArray<uint32_t> &pitches,
@@ -189,6 +200,10 @@ class FramebufferManager {
         std::set<const ExynosLayer *> mCachedLayersInuse;
         std::set<const ExynosLayer*> mCachedSecureLayersInuse;
 
+        // fbIds found in the cache and added by getBuffer()
+        uint64_t mCachedFbHits = 0;
+        uint64_t mAddedFbs = 0;
+
         std::thread mRmFBThread;
         bool mRmFBThreadRunning = false;
         Condition mFlipDone;
@@ -202,13 +217,22 @@ class FramebufferManager {
 
 template <class UnaryPredicate>
 uint32_t FramebufferManager::findCachedFbId(const ExynosLayer* layer, const bool isSecureBuffer,
-                                            UnaryPredicate predicate) {
+                                            UnaryPredicate predicate, const bool testOnly) {
     Mutex::Autolock lock(mMutex);
+    auto& layerBuffers = (!isSecureBuffer) ? mCachedLayerBuffers : mCachedSecureLayerBuffers;
+    if (testOnly) {
+        // A lookup neither adds an entry nor keeps the layer from being shrunk
+        const auto layerIt = layerBuffers.find(layer);
+        if (layerIt == layerBuffers.end()) return 0;
+        const auto it = std::find_if(layerIt->second.begin(), layerIt->second.end(), predicate);
+        return (it == layerIt->second.end()) ? 0 : (*it)->fbId;
+    }
     markInuseLayerLocked(layer, isSecureBuffer);
-    const auto& cachedBuffers =
-            (!isSecureBuffer) ? mCachedLayerBuffers[layer] : mCachedSecureLayerBuffers[layer];
+    const auto& cachedBuffers = layerBuffers[layer];
     const auto it = std::find_if(cachedBuffers.begin(), cachedBuffers.end(), predicate);
-    return (it != cachedBuffers.end()) ? (*it)->fbId : 0;
+    if (it == cachedBuffers.end()) return 0;
+    mCachedFbHits++;
+    return (*it)->fbId;
 }
 
 class ExynosDisplayDrmInterface :
@@ -230,6 +254,7 @@ class ExynosDisplayDrmInterface :
                         drmModeAtomicFree(mSavedPset);
                     }
                     mSavedPset = drmModeAtomicDuplicate(mPset);
+                    mSavedItems = mItems;
                 }
                 void restorePset() {
                     if (mPset) {
@@ -237,6 +262,8 @@ class ExynosDisplayDrmInterface :
                     }
                     mPset = mSavedPset;
                     mSavedPset = NULL;
+                    mItems = std::move(mSavedItems);
+                    mSavedItems.clear();
                 }
 
                 void setError(int err) { mError = err; };
@@ -274,6 +301,9 @@ class ExynosDisplayDrmInterface :
                 ExynosDisplayDrmInterface *mDrmDisplayInterface = NULL;
                 /* Destroy old blobs after commit */
                 std::vector<uint32_t> mOldBlobs;
+                /* Properties added to mPset, for DrmCommittedState */
+                std::vector<DrmCommittedState::Item> mItems;
+                std::vector<DrmCommittedState::Item> mSavedItems;
                 int drmFd() const { return mDrmDisplayInterface->mDrmDevice->fd(); }
 
                 std::function<void()> mAckCallback;
@@ -323,6 +353,7 @@ class ExynosDisplayDrmInterface :
                 uint32_t* outNumConfigs,
                 hwc2_config_t* outConfigs);
         virtual void dumpDisplayConfigs();
+        virtual void dump(String8& result) override;
         virtual bool supportDataspace(int32_t dataspace);
         virtual int32_t getColorModes(uint32_t* outNumModes, int32_t* outModes);
         virtual int32_t setColorMode(int32_t mode);
@@ -330,15 +361,20 @@ class ExynosDisplayDrmInterface :
         virtual int32_t setCursorPositionAsync(uint32_t x_pos, uint32_t y_pos);
         virtual int32_t updateHdrCapabilities();
         virtual int32_t deliverWinConfigData();
+        virtual int32_t testWinConfigData(const std::vector<exynos_win_config_data>& configs);
         virtual int32_t clearDisplay(bool needModeClear = false);
         virtual int32_t disableSelfRefresh(uint32_t disable);
         virtual int32_t setForcePanic();
         virtual int getDisplayFd() { return mDrmDevice->fd(); };
         virtual int32_t initDrmDevice(DrmDevice *drmDevice);
+        void setCommittedState(DrmCommittedState *committedState) {
+            mCommittedState = committedState;
+        }
         virtual int getDrmDisplayId(uint32_t type, uint32_t index);
         virtual uint32_t getMaxWindowNum() { return mMaxWindowNum; };
         virtual int32_t getReadbackBufferAttributes(int32_t* /*android_pixel_format_t*/ outFormat,
                 int32_t* /*android_dataspace_t*/ outDataspace);
+        virtual bool isReadbackScalingSupported() { return mReadbackInfo.mScalingSupported; };
         virtual int32_t getDisplayIdentificationData(uint8_t* outPort,
                 uint32_t* outDataSize, uint8_t* outData);
         virtual bool needRefreshOnLP();
@@ -508,7 +544,13 @@ class ExynosDisplayDrmInterface :
         int32_t setDisplayMode(DrmModeAtomicReq& drmReq, const uint32_t& modeBlob,
                                const uint32_t& modeId);
         int32_t clearDisplayMode(DrmModeAtomicReq &drmReq);
-        int32_t clearDisplayPlanes(DrmModeAtomicReq &drmReq);
+        /*
+         * clearDisplayPlanes() and disableUnusedPlanes() only disable planes
+         * that may be on the CRTC. @crtcPlanes receives the planes that may
+         * still be on it after the request.
+         */
+        int32_t clearDisplayPlanes(DrmModeAtomicReq &drmReq,
+                                   std::vector<uint32_t> *crtcPlanes = nullptr);
         int32_t choosePreferredConfig();
         int getDeconChannel(ExynosMPP *otfMPP);
         /*
@@ -519,7 +561,12 @@ class ExynosDisplayDrmInterface :
                 const exynos_win_config_data &config,
                 const uint32_t configIndex,
                 const std::unique_ptr<DrmPlane> &plane,
-                uint32_t &fbId);
+                uint32_t &fbId,
+                const bool testOnly = false);
+        int32_t disableUnusedPlanes(DrmModeAtomicReq &drmReq,
+                std::unordered_map<uint32_t, uint32_t> &planeEnableInfo,
+                std::vector<uint32_t> *crtcPlanes = nullptr);
+        DrmCommittedState::CrtcPlanes getCommittedCrtcPlanes();
 
         int32_t setupPartialRegion(DrmModeAtomicReq &drmReq);
         void parseBlendEnums(const DrmProperty &property);
@@ -532,7 +579,8 @@ class ExynosDisplayDrmInterface :
         void parseRCDId(const DrmProperty &property);
 
         int32_t setupWritebackCommit(DrmModeAtomicReq &drmReq);
-        int32_t clearWritebackCommit(DrmModeAtomicReq &drmReq);
+        /* keepConnector only detaches the buffer from the writeback connector */
+        int32_t clearWritebackCommit(DrmModeAtomicReq &drmReq, bool keepConnector = false);
 
     private:
         int32_t updateColorSettings(DrmModeAtomicReq &drmReq, uint64_t dqeEnabled);
@@ -587,6 +635,8 @@ class ExynosDisplayDrmInterface :
                     HAL_PIXEL_FORMAT_RGBA_8888;
                 uint32_t mReadbackFormat = HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED;
                 bool mNeedClearReadbackCommit = false;
+                /* The writeback connector can write a buffer smaller than the mode */
+                bool mScalingSupported = false;
             private:
                 DrmDevice *mDrmDevice = NULL;
                 DrmConnector *mWritebackConnector = NULL;
@@ -621,6 +671,33 @@ class ExynosDisplayDrmInterface :
         nsecs_t mLastDumpDrmAtomicMessageTime;
         bool mIsResolutionSwitchInProgress = false;
 
+        /* Shared by the displays on mDrmDevice, NULL if delta commits are not used */
+        DrmCommittedState *mCommittedState = nullptr;
+        /* Cache of DrmCommittedState::isElidable() by property id */
+        std::unordered_map<uint32_t, bool> mElidableProperties;
+        bool isElidableProperty(uint32_t objectId, const DrmProperty &property);
+
+        struct AtomicDeltaStats {
+            uint64_t commits = 0;
+            uint64_t fullCommits = 0;
+            uint64_t sentProps = 0;
+            uint64_t elidedProps = 0;
+            uint32_t lastSentProps = 0;
+            uint32_t lastElidedProps = 0;
+        } mAtomicDeltaStats;
+
+        /* Display power transitions and CRTC swaps */
+        struct TransitionStats {
+            uint64_t clears = 0;
+            /* Clears that found nothing left on the CRTC */
+            uint64_t skippedClears = 0;
+            uint64_t disabledPlanes = 0;
+            uint64_t swaps = 0;
+            nsecs_t lastDuration = 0;
+            nsecs_t maxDuration = 0;
+        } mTransitionStats;
+        void updateTransitionStats(nsecs_t startTime);
+
     private:
         int32_t getDisplayFakeEdid(uint8_t &outPort, uint32_t &outDataSize, uint8_t *outData);
 
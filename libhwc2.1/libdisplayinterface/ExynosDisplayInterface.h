@@ -21,10 +21,13 @@
 #include <sys/types.h>
 #include <utils/Errors.h>
 
+#include <vector>
+
 #include "../libvrr/VariableRefreshRateVersion.h"
 #include "ExynosHWCHelper.h"
 
 class ExynosDisplay;
+struct exynos_win_config_data;
 
 struct XrrSettings;
 typedef struct XrrSettings XrrSettings_t;
@@ -44,6 +47,7 @@ class ExynosDisplayInterface {
                 uint32_t* outNumConfigs,
                 hwc2_config_t* outConfigs);
         virtual void dumpDisplayConfigs() {};
+        virtual void dump(String8& __unused result) {};
         virtual bool supportDataspace(int32_t __unused dataspace) { return true; };
         virtual int32_t getColorModes(uint32_t* outNumModes, int32_t* outModes);
         virtual int32_t setColorMode(int32_t __unused mode) {return NO_ERROR;};
@@ -58,6 +62,9 @@ class ExynosDisplayInterface {
                 uint32_t __unused y_pos) {return NO_ERROR;};
         virtual int32_t updateHdrCapabilities();
         virtual int32_t deliverWinConfigData() {return NO_ERROR;};
+        virtual int32_t testWinConfigData(
+                const std::vector<exynos_win_config_data>& __unused configs)
+        {return NO_ERROR;};
         virtual int32_t clearDisplay(bool __unused needModeClear = false) {return NO_ERROR;};
         virtual int32_t triggerClearDisplayPlanes() { return NO_ERROR; }
         virtual int32_t disableSelfRefresh(uint32_t __unused disable) {return NO_ERROR;};
@@ -71,6 +78,8 @@ class ExynosDisplayInterface {
         virtual int32_t setColorModeWithRenderIntent(int32_t __unused mode, int32_t __unused intent) {return 0;}
         virtual int32_t getReadbackBufferAttributes(int32_t* /*android_pixel_format_t*/ outFormat,
                 int32_t* /*android_dataspace_t*/ outDataspace);
+        /* Whether readback buffers can be smaller than the display */
+        virtual bool isReadbackScalingSupported() { return false; };
         /* HWC 2.3 APIs */
         virtual int32_t getDisplayIdentificationData(uint8_t* __unused outPort,
                 uint32_t* __unused outDataSize, uint8_t* __unused outData) {return 0;}
@@ -47,9 +47,7 @@ DrmConnector::DrmConnector(DrmDevice *drm, drmModeConnectorPtr c,
       display_(-1),
       type_(c->connector_type),
       type_id_(c->connector_type_id),
-      state_(c->connection),
-      mm_width_(c->mmWidth),
-      mm_height_(c->mmHeight),
+      conn_state_(c),
       possible_encoders_(possible_encoders) {
 }
 
@@ -261,64 +259,8 @@ std::string DrmConnector::name() const {
 int DrmConnector::UpdateModes(bool is_vrr_mode) {
   std::lock_guard<std::recursive_mutex> lock(modes_lock_);
 
-  int fd = drm_->fd();
-
-  drmModeConnectorPtr c = drmModeGetConnector(fd, id_);
-  if (!c) {
-    ALOGE("Failed to get connector %d", id_);
-    return -ENODEV;
-  }
-
-  if (state_ == DRM_MODE_CONNECTED &&
-      c->connection == DRM_MODE_CONNECTED && modes_.size() > 0) {
-    // no need to update modes
-    return 0;
-  }
-
-  if (state_ == DRM_MODE_DISCONNECTED &&
-      c->connection == DRM_MODE_DISCONNECTED && modes_.size() == 0) {
-    // no need to update modes
-    return 0;
-  }
-
-  state_ = c->connection;
-
-  // Update mm_width_ and mm_height_ for xdpi/ydpi calculations
-  mm_width_ = c->mmWidth;
-  mm_height_ = c->mmHeight;
-
-  bool preferred_mode_found = false;
-  std::vector<DrmMode> new_modes;
-  for (int i = 0; i < c->count_modes; ++i) {
-    bool exists = false;
-    for (const DrmMode &mode : modes_) {
-      if (mode == c->modes[i]) {
-        new_modes.push_back(mode);
-        exists = true;
-        break;
-      }
-    }
-    if (!exists) {
-      // Remove modes that mismatch with the VRR setting..
-      if (is_vrr_mode != ((c->modes[i].type & DRM_MODE_TYPE_VRR) != 0)) {
-        continue;
-      }
-      DrmMode m(&c->modes[i]);
-      m.set_id(drm_->next_mode_id());
-      new_modes.push_back(m);
-    }
-    // Use only the first DRM_MODE_TYPE_PREFERRED mode found
-    if (!preferred_mode_found &&
-        (new_modes.back().type() & DRM_MODE_TYPE_PREFERRED)) {
-      preferred_mode_id_ = new_modes.back().id();
-      preferred_mode_found = true;
-    }
-  }
-  modes_.swap(new_modes);
-  if (!preferred_mode_found && modes_.size() != 0) {
-    preferred_mode_id_ = modes_[0].id();
-  }
-  return 1;
+  return conn_state_.Update(drm_->fd(), id_, drm_->event_listener()->GetHotplugEpoch(),
+                            is_vrr_mode, [this]() { return drm_->next_mode_id(); });
 }
 
 int DrmConnector::UpdateEdidProperty() {
@@ -485,14 +427,14 @@ void DrmConnector::set_encoder(DrmEncoder *encoder) {
 }
 
 drmModeConnection DrmConnector::state() const {
-  return state_;
+  return conn_state_.state();
 }
 
 uint32_t DrmConnector::mm_width() const {
-  return mm_width_;
+  return conn_state_.mm_width();
 }
 
 uint32_t DrmConnector::mm_height() const {
-  return mm_height_;
+  return conn_state_.mm_height();
 }
 }  // namespace android
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "hwc-drm-connector-state"
+
+#include "drmconnectorstate.h"
+
+#include <errno.h>
+#include <log/log.h>
+
+namespace android {
+
+DrmConnectorState::DrmConnectorState(drmModeConnectorPtr c)
+    : state_(c->connection), mm_width_(c->mmWidth), mm_height_(c->mmHeight) {
+}
+
+size_t DrmConnectorState::HashModeInfo(const drmModeModeInfo &m) {
+  // Same fields as DrmMode::operator==
+  const uint32_t fields[] = {m.clock,       m.hdisplay,  m.hsync_start, m.hsync_end, m.htotal,
+                             m.hskew,       m.vdisplay,  m.vsync_start, m.vsync_end, m.vtotal,
+                             m.vscan,       m.flags,     m.type};
+  size_t hash = 0;
+  for (uint32_t field : fields)
+    hash ^= std::hash<uint32_t>{}(field) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  return hash;
+}
+
+int DrmConnectorState::Update(int fd, uint32_t connector_id, uint64_t hotplug_epoch,
+                              bool is_vrr_mode, const std::function<uint32_t()> &next_mode_id) {
+  const bool probe = !probed_ || (probed_epoch_ != hotplug_epoch);
+
+  drmModeConnectorPtr c = probe ? drmModeGetConnector(fd, connector_id)
+                                : drmModeGetConnectorCurrent(fd, connector_id);
+  if (!c) {
+    ALOGE("Failed to get connector %d", connector_id);
+    return -ENODEV;
+  }
+
+  if (probe) {
+    probed_ = true;
+    probed_epoch_ = hotplug_epoch;
+    probe_count_++;
+  } else {
+    query_count_++;
+  }
+
+  if (state_ == DRM_MODE_CONNECTED &&
+      c->connection == DRM_MODE_CONNECTED && modes_.size() > 0) {
+    // no need to update modes
+    drmModeFreeConnector(c);
+    return 0;
+  }
+
+  if (state_ == DRM_MODE_DISCONNECTED &&
+      c->connection == DRM_MODE_DISCONNECTED && modes_.size() == 0) {
+    // no need to update modes
+    drmModeFreeConnector(c);
+    return 0;
+  }
+
+  state_ = c->connection;
+
+  // Update mm_width_ and mm_height_ for xdpi/ydpi calculations
+  mm_width_ = c->mmWidth;
+  mm_height_ = c->mmHeight;
+
+  bool preferred_mode_found = false;
+  std::vector<DrmMode> new_modes;
+  std::unordered_multimap<size_t, size_t> new_index;
+  for (int i = 0; i < c->count_modes; ++i) {
+    const size_t hash = HashModeInfo(c->modes[i]);
+    const DrmMode *existing = nullptr;
+    auto range = mode_index_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (modes_[it->second] == c->modes[i]) {
+        existing = &modes_[it->second];
+        break;
+      }
+    }
+    if (existing) {
+      new_modes.push_back(*existing);
+    } else {
+      // Remove modes that mismatch with the VRR setting..
+      if (is_vrr_mode != ((c->modes[i].type & DRM_MODE_TYPE_VRR) != 0)) {
+        continue;
+      }
+      DrmMode m(&c->modes[i]);
+      m.set_id(next_mode_id());
+      new_modes.push_back(m);
+    }
+    new_index.emplace(hash, new_modes.size() - 1);
+    // Use only the first DRM_MODE_TYPE_PREFERRED mode found
+    if (!preferred_mode_found &&
+        (new_modes.back().type() & DRM_MODE_TYPE_PREFERRED)) {
+      preferred_mode_id_ = new_modes.back().id();
+      preferred_mode_found = true;
+    }
+  }
+  drmModeFreeConnector(c);
+
+  modes_.swap(new_modes);
+  mode_index_.swap(new_index);
+  if (!preferred_mode_found && modes_.size() != 0) {
+    preferred_mode_id_ = modes_[0].id();
+  }
+  return 1;
+}
+}  // namespace android
@@ -322,6 +322,7 @@ void DrmEventListener::UEventHandler() {
   }
 
   if (drm_event && hotplug_event) {
+    BumpHotplugEpoch();
     if (!hotplug_handler_)
       return;
 
@@ -15,9 +15,9 @@
  */
 
 #include "drmmode.h"
-#include "drmdevice.h"
 
 #include <stdint.h>
+#include <string.h>
 #include <xf86drmMode.h>
 #include <string>
 
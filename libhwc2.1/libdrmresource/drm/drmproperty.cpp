@@ -135,6 +135,14 @@ bool DrmProperty::isBitmask() const {
   return id_ && (flags_ & DRM_MODE_PROP_BITMASK);
 }
 
+bool DrmProperty::isBlob() const {
+  return type_ == DRM_PROPERTY_TYPE_BLOB;
+}
+
+bool DrmProperty::isObject() const {
+  return type_ == DRM_PROPERTY_TYPE_OBJECT;
+}
+
 std::tuple<int, uint64_t> DrmProperty::rangeMin() const {
   if (!isRange())
     return std::make_tuple(-EINVAL, 0);
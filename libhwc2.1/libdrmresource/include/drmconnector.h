@@ -17,6 +17,7 @@
 #ifndef ANDROID_DRM_CONNECTOR_H_
 #define ANDROID_DRM_CONNECTOR_H_
 
+#include "drmconnectorstate.h"
 #include "drmencoder.h"
 #include "drmmode.h"
 #include "drmproperty.h"
@@ -58,7 +59,7 @@ class DrmConnector {
   int UpdateLuminanceAndHdrProperties();
 
   const std::vector<DrmMode> &modes() const {
-    return modes_;
+    return conn_state_.modes();
   }
   std::recursive_mutex &modesLock() {
     return modes_lock_;
@@ -108,7 +109,11 @@ class DrmConnector {
   uint32_t mm_height() const;
 
   uint32_t get_preferred_mode_id() const {
-    return preferred_mode_id_;
+    return conn_state_.preferred_mode_id();
+  }
+
+  const DrmConnectorState &connector_state() const {
+    return conn_state_;
   }
 
  private:
@@ -120,13 +125,9 @@ class DrmConnector {
 
   uint32_t type_;
   uint32_t type_id_;
-  drmModeConnection state_;
-
-  uint32_t mm_width_;
-  uint32_t mm_height_;
 
   DrmMode active_mode_;
-  std::vector<DrmMode> modes_;
+  DrmConnectorState conn_state_;
   std::recursive_mutex modes_lock_;
   DrmMode lp_mode_;
 
@@ -157,8 +158,6 @@ class DrmConnector {
 
   std::vector<DrmEncoder *> possible_encoders_;
 
-  uint32_t preferred_mode_id_;
-
   int UpdateLpMode();
 };
 }  // namespace android
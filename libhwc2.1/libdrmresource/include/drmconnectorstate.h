@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_DRM_CONNECTOR_STATE_H_
+#define ANDROID_DRM_CONNECTOR_STATE_H_
+
+#include <stdint.h>
+#include <xf86drmMode.h>
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "drmmode.h"
+
+namespace android {
+
+// Connection state and modes of a connector.
+//
+// drmModeGetConnector() makes the kernel probe the connector, which may read
+// the EDID of an external display. The probe is done only for the first update
+// and when the hotplug epoch is changed. Other updates read the current state
+// with drmModeGetConnectorCurrent().
+class DrmConnectorState {
+ public:
+  DrmConnectorState(drmModeConnectorPtr c);
+
+  // Returns 1 if the modes are updated, 0 if nothing is changed or a negative
+  // error code.
+  int Update(int fd, uint32_t connector_id, uint64_t hotplug_epoch, bool is_vrr_mode,
+             const std::function<uint32_t()> &next_mode_id);
+
+  drmModeConnection state() const {
+    return state_;
+  }
+  uint32_t mm_width() const {
+    return mm_width_;
+  }
+  uint32_t mm_height() const {
+    return mm_height_;
+  }
+  const std::vector<DrmMode> &modes() const {
+    return modes_;
+  }
+  uint32_t preferred_mode_id() const {
+    return preferred_mode_id_;
+  }
+
+  uint32_t probe_count() const {
+    return probe_count_;
+  }
+  uint32_t query_count() const {
+    return query_count_;
+  }
+
+ private:
+  static size_t HashModeInfo(const drmModeModeInfo &m);
+
+  drmModeConnection state_;
+  uint32_t mm_width_;
+  uint32_t mm_height_;
+
+  std::vector<DrmMode> modes_;
+  // Hash of the mode info reported by the kernel to the index in modes_
+  std::unordered_multimap<size_t, size_t> mode_index_;
+  uint32_t preferred_mode_id_ = 0;
+
+  bool probed_ = false;
+  uint64_t probed_epoch_ = 0;
+  uint32_t probe_count_ = 0;
+  uint32_t query_count_ = 0;
+};
+}  // namespace android
+
+#endif  // ANDROID_DRM_CONNECTOR_STATE_H_
@@ -19,6 +19,7 @@
 
 #include <sys/epoll.h>
 
+#include <atomic>
 #include <map>
 
 #include "autofd.h"
@@ -133,6 +134,14 @@ class DrmEventListener : public Worker {
 
   bool IsDrmInTUI();
 
+  // Changed by every hotplug uevent. Connectors are probed again when it changes.
+  uint64_t GetHotplugEpoch() const {
+    return hotplug_epoch_;
+  }
+  void BumpHotplugEpoch() {
+    hotplug_epoch_++;
+  }
+
   static void FlipHandler(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec,
                           void *user_data);
 
@@ -159,6 +168,7 @@ class DrmEventListener : public Worker {
   std::shared_ptr<DrmPropertyUpdateHandler> drm_prop_update_handler_;
   std::mutex mutex_;
   std::map<int, std::shared_ptr<DrmSysfsEventHandler>> sysfs_handlers_;
+  std::atomic<uint64_t> hotplug_epoch_{0};
 };
 
 }  // namespace android
@@ -53,6 +53,8 @@ class DrmProperty {
   bool isRange() const;
   bool isSignedRange() const;
   bool isBitmask() const;
+  bool isBlob() const;
+  bool isObject() const;
 
   std::tuple<int, uint64_t> rangeMin() const;
   std::tuple<int, uint64_t> rangeMax() const;
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "drmconnectorstate.h"
+
+using android::DrmConnectorState;
+using android::DrmMode;
+
+namespace {
+
+constexpr uint32_t kConnectorId = 30;
+
+// Connector reported by the fake DRM device. The test overrides the libdrm
+// connector queries below.
+struct FakeConnector {
+    drmModeConnection connection = DRM_MODE_DISCONNECTED;
+    uint32_t mmWidth = 0;
+    uint32_t mmHeight = 0;
+    std::vector<drmModeModeInfo> modes;
+    // Modes reported by drmModeGetConnectorCurrent() until the next probe
+    std::vector<drmModeModeInfo> probedModes;
+    drmModeConnection probedConnection = DRM_MODE_DISCONNECTED;
+    bool fail = false;
+    int probes = 0;
+    int queries = 0;
+} gConnector;
+
+drmModeConnectorPtr makeConnector(drmModeConnection connection,
+                                  const std::vector<drmModeModeInfo> &modes) {
+    auto c = static_cast<drmModeConnectorPtr>(calloc(1, sizeof(drmModeConnector)));
+    c->connector_id = kConnectorId;
+    c->connection = connection;
+    c->mmWidth = gConnector.mmWidth;
+    c->mmHeight = gConnector.mmHeight;
+    c->count_modes = modes.size();
+    c->modes = static_cast<drmModeModeInfoPtr>(calloc(modes.size() + 1, sizeof(drmModeModeInfo)));
+    if (!modes.empty()) memcpy(c->modes, modes.data(), modes.size() * sizeof(drmModeModeInfo));
+    return c;
+}
+
+drmModeModeInfo makeMode(uint16_t width, uint16_t height, uint32_t refresh, uint32_t type = 0) {
+    drmModeModeInfo mode;
+    memset(&mode, 0, sizeof(mode));
+    mode.hdisplay = width;
+    mode.vdisplay = height;
+    mode.htotal = width + 100;
+    mode.vtotal = height + 20;
+    mode.vrefresh = refresh;
+    mode.clock = mode.htotal * mode.vtotal * refresh / 1000;
+    mode.type = type;
+    snprintf(mode.name, sizeof(mode.name), "%ux%u@%u", width, height, refresh);
+    return mode;
+}
+
+} // namespace
+
+extern "C" drmModeConnectorPtr drmModeGetConnector(int /*fd*/, uint32_t connectorId) {
+    if (gConnector.fail || connectorId != kConnectorId) return nullptr;
+    gConnector.probes++;
+    gConnector.probedModes = gConnector.modes;
+    gConnector.probedConnection = gConnector.connection;
+    return makeConnector(gConnector.connection, gConnector.modes);
+}
+
+extern "C" drmModeConnectorPtr drmModeGetConnectorCurrent(int /*fd*/, uint32_t connectorId) {
+    if (gConnector.fail || connectorId != kConnectorId) return nullptr;
+    gConnector.queries++;
+    return makeConnector(gConnector.probedConnection, gConnector.probedModes);
+}
+
+extern "C" void drmModeFreeConnector(drmModeConnectorPtr ptr) {
+    if (!ptr) return;
+    free(ptr->modes);
+    free(ptr);
+}
+
+class DrmConnectorStateTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        gConnector = FakeConnector();
+        gConnector.mmWidth = 70;
+        gConnector.mmHeight = 150;
+        drmModeConnectorPtr c = makeConnector(DRM_MODE_DISCONNECTED, {});
+        mState = std::make_unique<DrmConnectorState>(c);
+        drmModeFreeConnector(c);
+    }
+
+    int update(bool isVrr = false) {
+        return mState->Update(-1, kConnectorId, mEpoch, isVrr, [this]() { return ++mModeId; });
+    }
+
+    std::unique_ptr<DrmConnectorState> mState;
+    uint64_t mEpoch = 0;
+    uint32_t mModeId = 0;
+};
+
+TEST_F(DrmConnectorStateTest, ProbesOnlyOnEpochChange) {
+    gConnector.connection = DRM_MODE_CONNECTED;
+    gConnector.modes = {makeMode(1920, 1080, 60, DRM_MODE_TYPE_PREFERRED)};
+
+    EXPECT_EQ(1, update());
+    for (int i = 0; i < 10; i++) EXPECT_EQ(0, update());
+
+    EXPECT_EQ(1, gConnector.probes);
+    EXPECT_EQ(10, gConnector.queries);
+    EXPECT_EQ(1u, mState->probe_count());
+    EXPECT_EQ(10u, mState->query_count());
+
+    mEpoch++;
+    EXPECT_EQ(0, update());
+    EXPECT_EQ(2, gConnector.probes);
+}
+
+TEST_F(DrmConnectorStateTest, UpdatesModesOnHotplug) {
+    gConnector.connection = DRM_MODE_CONNECTED;
+    gConnector.modes = {makeMode(1920, 1080, 60), makeMode(1920, 1080, 30),
+                        makeMode(3840, 2160, 30, DRM_MODE_TYPE_PREFERRED)};
+
+    ASSERT_EQ(1, update());
+    ASSERT_EQ(3u, mState->modes().size());
+    EXPECT_EQ(DRM_MODE_CONNECTED, mState->state());
+    EXPECT_EQ(70u, mState->mm_width());
+    EXPECT_EQ(150u, mState->mm_height());
+    EXPECT_EQ(mState->modes()[2].id(), mState->preferred_mode_id());
+    const uint32_t firstId = mState->modes()[0].id();
+
+    // Unplug is not visible before the hotplug uevent
+    gConnector.connection = DRM_MODE_DISCONNECTED;
+    gConnector.modes.clear();
+    EXPECT_EQ(0, update());
+    EXPECT_EQ(3u, mState->modes().size());
+
+    mEpoch++;
+    ASSERT_EQ(1, update());
+    EXPECT_EQ(DRM_MODE_DISCONNECTED, mState->state());
+    EXPECT_TRUE(mState->modes().empty());
+
+    // Reconnection reports the modes of the new display
+    gConnector.connection = DRM_MODE_CONNECTED;
+    gConnector.modes = {makeMode(1280, 720, 60), makeMode(1920, 1080, 60)};
+    mEpoch++;
+    ASSERT_EQ(1, update());
+    ASSERT_EQ(2u, mState->modes().size());
+    EXPECT_EQ(1280u, mState->modes()[0].h_display());
+    EXPECT_EQ(1920u, mState->modes()[1].h_display());
+    EXPECT_NE(firstId, mState->modes()[0].id());
+    EXPECT_EQ(mState->modes()[0].id(), mState->preferred_mode_id());
+}
+
+TEST_F(DrmConnectorStateTest, FiltersVrrModes) {
+    gConnector.connection = DRM_MODE_CONNECTED;
+    gConnector.modes = {makeMode(1080, 2400, 120, DRM_MODE_TYPE_VRR), makeMode(1080, 2400, 60)};
+
+    ASSERT_EQ(1, update(true));
+    ASSERT_EQ(1u, mState->modes().size());
+    EXPECT_TRUE(mState->modes()[0].type() & DRM_MODE_TYPE_VRR);
+}
+
+TEST_F(DrmConnectorStateTest, ReportsFailure) {
+    gConnector.fail = true;
+    EXPECT_EQ(-ENODEV, update());
+    EXPECT_EQ(0u, mState->probe_count());
+
+    // The failed probe is retried
+    gConnector.fail = false;
+    gConnector.connection = DRM_MODE_CONNECTED;
+    gConnector.modes = {makeMode(1920, 1080, 60)};
+    EXPECT_EQ(1, update());
+    EXPECT_EQ(1, gConnector.probes);
+}
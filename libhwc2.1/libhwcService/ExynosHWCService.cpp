@@ -613,4 +613,16 @@ int32_t ExynosHWCService::setDisplayTemperature(uint32_t displayId, int32_t temp
     return NO_ERROR;
 }
 
+int32_t ExynosHWCService::setDisplayLhbmArmed(uint32_t displayId, bool armed) {
+    ALOGD("ExynosHWCService::%s() displayID(%u) armed(%d)", __func__, displayId, armed);
+
+    auto display = mHWCCtx->device->getDisplay(displayId);
+
+    if (display != nullptr) {
+        return display->setLhbmArmed(armed);
+    }
+
+    return -EINVAL;
+}
+
 } //namespace android
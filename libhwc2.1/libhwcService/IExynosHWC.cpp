@@ -83,6 +83,7 @@ enum {
     SET_PRESENT_TIMEOUT_CONTROLLER = 1017,
     SET_FIXED_TE2_RATE = 1018,
     SET_DISPLAY_TEMPERATURE = 1019,
+    SET_DISPLAY_LHBM_ARMED = 1020,
 };
 
 class BpExynosHWCService : public BpInterface<IExynosHWCService> {
@@ -594,6 +595,15 @@ public:
         if (result) ALOGE("SET_DISPLAY_TEMPERATURE transact error(%d)", result);
         return result;
     }
+    virtual int32_t setDisplayLhbmArmed(uint32_t displayId, bool armed) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IExynosHWCService::getInterfaceDescriptor());
+        data.writeUint32(displayId);
+        data.writeBool(armed);
+        int result = remote()->transact(SET_DISPLAY_LHBM_ARMED, data, &reply);
+        if (result) ALOGE("SET_DISPLAY_LHBM_ARMED transact error(%d)", result);
+        return result;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(ExynosHWCService, "android.hal.ExynosHWCService");
@@ -942,6 +952,13 @@ status_t BnExynosHWCService::onTransact(
             return setDisplayTemperature(displayId, temperature);
         } break;
 
+        case SET_DISPLAY_LHBM_ARMED: {
+            CHECK_INTERFACE(IExynosHWCService, data, reply);
+            uint32_t displayId = data.readUint32();
+            bool armed = data.readBool();
+            return setDisplayLhbmArmed(displayId, armed);
+        } break;
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
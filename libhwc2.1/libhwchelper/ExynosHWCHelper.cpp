@@ -1113,31 +1113,31 @@ bool FenceTracker::validateFences(ExynosDisplay *display) {
 
 int32_t FenceTracker::saveFenceTraceLocked(ExynosDisplay *display) {
     int32_t ret = NO_ERROR;
-    auto &fileWriter = display->mFenceFileWriter;
-
-    if (!fileWriter.chooseOpenedFile()) {
-        return -1;
-    }
-
-    String8 saveString;
+    auto &channel = display->mLogChannel;
 
     struct timeval tv;
     gettimeofday(&tv, NULL);
+    String8 saveString;
     saveString.appendFormat("\n====== Fences at time:%s ======\n", getLocalTimeStr(tv).c_str());
+    // MAX_FENCE_THRESHOLD fences take more records than a ring holds, so this
+    // cold path waits for the writer instead of dropping them
+    channel->logText(hwclog::STREAM_FENCE, std::string_view(saveString.c_str(), saveString.size()),
+                     true);
 
     for (const auto &[fd, info] : mFenceInfos) {
-        saveString.appendFormat("---- Fence FD : %d, Display(%d) ----\n", fd, info.displayId);
-        saveString.appendFormat("usage: %d, dupFrom: %d, pendingAllowed: %d, leaking: %d\n",
-                                info.usage, info.dupFrom, info.pendingAllowed, info.leaking);
+        hwclog::FenceRecord fence = {fd,           info.displayId,      info.usage,
+                                     info.dupFrom, info.pendingAllowed, info.leaking};
+        channel->log(hwclog::STREAM_FENCE, hwclog::TYPE_FENCE, fence, true);
 
         for (const auto &trace : info.traces) {
-            saveString.appendFormat("> dir: %d, type: %d, ip: %d, time:%s\n", trace.direction,
-                                    trace.type, trace.ip, getLocalTimeStr(trace.time).c_str());
+            hwclog::FenceTraceRecord record = {fd, static_cast<uint32_t>(trace.direction),
+                                               static_cast<uint32_t>(trace.type),
+                                               static_cast<uint32_t>(trace.ip),
+                                               trace.time.tv_sec * 1000000LL + trace.time.tv_usec};
+            channel->log(hwclog::STREAM_FENCE, hwclog::TYPE_FENCE_TRACE, record, true);
         }
     }
 
-    fileWriter.write(saveString);
-    fileWriter.flush();
     return ret;
 }
 
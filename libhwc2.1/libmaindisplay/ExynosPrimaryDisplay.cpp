@@ -21,6 +21,7 @@
 
 #include <android-base/properties.h>
 
+#include <fcntl.h>
 #include <linux/fb.h>
 #include <poll.h>
 
@@ -244,7 +245,7 @@ ExynosPrimaryDisplay::ExynosPrimaryDisplay(uint32_t index, ExynosDevice* device,
                 ALOGI("%s(): refresh control is not supported", __func__);
             }
         }
-        mIsDisplayTempMonitorSupported = initDisplayTempMonitor(displayTypeIdentifier);
+        initDisplayTempMonitor(displayTypeIdentifier);
     }
 
     // Allow to enable dynamic recomposition after every power on
@@ -309,13 +310,8 @@ ExynosPrimaryDisplay::~ExynosPrimaryDisplay()
         mDisplayNeedHandleIdleExitOfs.close();
     }
 
-    if (mIsDisplayTempMonitorSupported) {
-        mTMLoopStatus.store(false, std::memory_order_relaxed);
-        mTMCondition.notify_one();
-        if (mTMThread.joinable()) {
-            mTMThread.join();
-        }
-    }
+    // Stop the monitor thread before the members its listener writes go away
+    mDisplayTempMonitor.reset();
 }
 
 void ExynosPrimaryDisplay::setDDIScalerEnable(int width, int height) {
@@ -475,7 +471,7 @@ int32_t ExynosPrimaryDisplay::setPowerOn() {
     int ret = NO_ERROR;
     if (mDisplayId != 0 || !mFirstPowerOn) {
         if (mDevice->hasOtherDisplayOn(this)) {
-            mResourceManager->prepareResources(mDisplayId);
+            mResourceManager->prepareResourcesForPowerOn(this);
             // TODO: This is useful for cmd mode, and b/282094671 tries to handles video mode
             mDisplayInterface->triggerClearDisplayPlanes();
         }
@@ -678,7 +674,8 @@ int32_t ExynosPrimaryDisplay::setPowerMode(int32_t mode) {
         }
     }
 
-    checkTemperatureMonitorThread(mPowerModeState.has_value() && mode == HWC2_POWER_MODE_ON);
+    updateDisplayTempMonitor(mPowerModeState.has_value() ? static_cast<hwc2_power_mode_t>(mode)
+                                                        : HWC2_POWER_MODE_OFF);
 
     return res;
 }
@@ -900,16 +897,17 @@ int32_t ExynosPrimaryDisplay::setRefreshRateChangedCallbackDebugEnabled(bool ena
     return NO_ERROR;
 }
 
-int32_t ExynosPrimaryDisplay::setLhbmDisplayConfigLocked(uint32_t peakRate) {
+int32_t ExynosPrimaryDisplay::setLhbmDisplayConfigLocked(uint32_t peakRate, bool* configChanged) {
     auto hwConfig = mDisplayInterface->getActiveModeId();
-    auto config = getConfigId(peakRate, mDisplayConfigs[hwConfig].width,
-                              mDisplayConfigs[hwConfig].height);
+    const auto hwRecord = mDisplayConfigIndex.find(hwConfig);
+    auto config = hwRecord ? getConfigId(peakRate, hwRecord->width, hwRecord->height) : UINT_MAX;
     if (config == UINT_MAX) {
         DISPLAY_LOGE("%s: failed to get config for rate=%d", __func__, peakRate);
         return -EINVAL;
     }
 
     if (mPendingConfig == UINT_MAX && mActiveConfig != config) mPendingConfig = mActiveConfig;
+    if (configChanged) *configChanged = config != hwConfig;
     if (config != hwConfig) {
         if (ExynosDisplay::setActiveConfigInternal(config, true) == HWC2_ERROR_NONE) {
             DISPLAY_LOGI("%s: succeeded to set config=%d rate=%d", __func__, config, peakRate);
@@ -950,6 +948,12 @@ int32_t ExynosPrimaryDisplay::setLhbmState(bool enabled) {
     // to when new code is added.
     DISPLAY_ATRACE_CALL();
     DISPLAY_LOGI("%s: enabled=%d", __func__, enabled);
+    std::shared_ptr<const LhbmArmedState> armedState;
+    {
+        std::lock_guard<std::mutex> armLock(mLhbmArmMutex);
+        armedState = mLhbmArmedState;
+    }
+    const int64_t lhbmStartNanos = systemTime(SYSTEM_TIME_MONOTONIC);
     {
         ATRACE_NAME("wait_for_power_on");
         std::unique_lock<std::mutex> lock(mPowerModeMutex);
@@ -964,13 +968,14 @@ int32_t ExynosPrimaryDisplay::setLhbmState(bool enabled) {
             }
         }
     }
+    const int64_t lhbmPowerOnNanos = systemTime(SYSTEM_TIME_MONOTONIC);
 
     auto lhbmSysfs = mBrightnessController->GetPanelSysfileByIndex(
             BrightnessController::kLocalHbmModeFileNode);
-    ret = mBrightnessController->checkSysfsStatus(lhbmSysfs,
-                                         {std::to_string(static_cast<int>(
-                                                 BrightnessController::LhbmMode::DISABLED))},
-                                         0);
+    ret = checkLhbmSysfsStatus(armedState->modeFd, lhbmSysfs,
+                               {std::to_string(static_cast<int>(
+                                       BrightnessController::LhbmMode::DISABLED))},
+                               0);
     bool wasDisabled = ret == OK;
     if (!enabled && wasDisabled) {
         DISPLAY_LOGW("%s: lhbm is at DISABLED state, skip disabling", __func__);
@@ -990,8 +995,8 @@ int32_t ExynosPrimaryDisplay::setLhbmState(bool enabled) {
             ATRACE_NAME("wait_for_lhbm_off_cmd");
             checkingValue = {
                     std::to_string(static_cast<int>(BrightnessController::LhbmMode::DISABLED))};
-            ret = mBrightnessController->checkSysfsStatus(lhbmSysfs, checkingValue,
-                                                          ms2ns(kSysfsCheckTimeoutMs));
+            ret = checkLhbmSysfsStatus(armedState->modeFd, lhbmSysfs, checkingValue,
+                                       ms2ns(kSysfsCheckTimeoutMs));
             if (ret != OK) {
                 DISPLAY_LOGW("%s: failed to send lhbm-off cmd", __func__);
             }
@@ -1006,9 +1011,11 @@ int32_t ExynosPrimaryDisplay::setLhbmState(bool enabled) {
     }
 
     ATRACE_NAME("enable_lhbm");
-    int64_t lhbmWaitForRrNanos, lhbmEnablingNanos, lhbmEnablingDoneNanos;
+    int64_t lhbmWaitForRrNanos, lhbmEnablingNanos, lhbmEnablingDoneNanos, settledSinceNanos;
     bool enablingStateSupported = !mFramesToReachLhbmPeakBrightness;
     uint32_t peakRate = 0;
+    bool configChanged = true;
+    bool settledAtPeakRate = false;
     auto rrSysfs = mBrightnessController->GetPanelRefreshRateSysfile();
     lhbmWaitForRrNanos = systemTime(SYSTEM_TIME_MONOTONIC);
     {
@@ -1018,18 +1025,27 @@ int32_t ExynosPrimaryDisplay::setLhbmState(bool enabled) {
             DISPLAY_LOGE("%s: invalid peak rate=%d", __func__, peakRate);
             return -EINVAL;
         }
-        ret = setLhbmDisplayConfigLocked(peakRate);
+        ret = setLhbmDisplayConfigLocked(peakRate, &configChanged);
         if (ret != OK) return ret;
     }
 
-    if (mBrightnessController->fileExists(rrSysfs)) {
+    // The panel has run at the peak refresh rate since LHBM was armed or the
+    // last refresh rate change
+    settledSinceNanos = std::max(armedState->armedNanos, mLastRefreshRateAppliedNanos.load());
+    settledAtPeakRate = armedState->armed && !configChanged && peakRate == armedState->peakRate &&
+            lhbmWaitForRrNanos - settledSinceNanos >
+                    kLhbmArmedSettleFrames * nsecsPerSec / peakRate;
+
+    if (armedState->rrFd.get() >= 0 || mBrightnessController->fileExists(rrSysfs)) {
         ATRACE_NAME("wait_for_peak_rate_cmd");
-        ret = mBrightnessController->checkSysfsStatus(rrSysfs, {std::to_string(peakRate)},
-                                                      ms2ns(kLhbmWaitForPeakRefreshRateMs));
+        ret = checkLhbmSysfsStatus(armedState->rrFd, rrSysfs, {std::to_string(peakRate)},
+                                   ms2ns(kLhbmWaitForPeakRefreshRateMs));
         if (ret != OK) {
             DISPLAY_LOGW("%s: failed to poll peak refresh rate=%d, ret=%d", __func__, peakRate,
                          ret);
         }
+    } else if (settledAtPeakRate) {
+        ATRACE_NAME("armed_at_peak_rate");
     } else {
         ATRACE_NAME("wait_for_peak_rate_blindly");
         DISPLAY_LOGW("%s: missing refresh rate path: %s", __func__, rrSysfs.c_str());
@@ -1052,8 +1068,8 @@ int32_t ExynosPrimaryDisplay::setLhbmState(bool enabled) {
     requestLhbm(true);
     {
         ATRACE_NAME("wait_for_lhbm_on_cmd");
-        ret = mBrightnessController->checkSysfsStatus(lhbmSysfs, checkingValue,
-                                                      ms2ns(kSysfsCheckTimeoutMs));
+        ret = checkLhbmSysfsStatus(armedState->modeFd, lhbmSysfs, checkingValue,
+                                   ms2ns(kSysfsCheckTimeoutMs));
         if (ret != OK) {
             DISPLAY_LOGE("%s: failed to enable lhbm", __func__);
             setLHBMRefreshRateThrottle(0);
@@ -1065,10 +1081,10 @@ int32_t ExynosPrimaryDisplay::setLhbmState(bool enabled) {
     {
         ATRACE_NAME("wait_for_peak_brightness");
         if (enablingStateSupported) {
-            ret = mBrightnessController->checkSysfsStatus(lhbmSysfs,
-                                            {std::to_string(static_cast<int>(
-                                                    BrightnessController::LhbmMode::ENABLED))},
-                                            ms2ns(kSysfsCheckTimeoutMs));
+            ret = checkLhbmSysfsStatus(armedState->modeFd, lhbmSysfs,
+                                       {std::to_string(static_cast<int>(
+                                               BrightnessController::LhbmMode::ENABLED))},
+                                       ms2ns(kSysfsCheckTimeoutMs));
             if (ret != OK) {
                 DISPLAY_LOGE("%s: failed to wait for lhbm becoming effective", __func__);
                 goto enable_err;
@@ -1084,12 +1100,22 @@ int32_t ExynosPrimaryDisplay::setLhbmState(bool enabled) {
             }
         }
     }
-    DISPLAY_LOGI("%s: latency: %04d = %03d|rr@%03d + %03d|en + %03d|boost@%s", __func__,
+    DISPLAY_LOGI("%s: latency: %04d = %03d|rr@%03d + %03d|en + %03d|boost@%s%s", __func__,
                  getTimestampDeltaMs(0, lhbmWaitForRrNanos),
                  getTimestampDeltaMs(lhbmEnablingNanos, lhbmWaitForRrNanos), peakRate,
                  getTimestampDeltaMs(lhbmEnablingDoneNanos, lhbmEnablingNanos),
                  getTimestampDeltaMs(0, lhbmEnablingDoneNanos),
-                 enablingStateSupported ? "polling" : "fixed");
+                 enablingStateSupported ? "polling" : "fixed", armedState->armed ? " (armed)" : "");
+    {
+        const int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        std::lock_guard<std::mutex> lock(mLhbmStatsMutex);
+        mLhbmStats.stages[LhbmStats::POWER_WAIT].add(lhbmPowerOnNanos - lhbmStartNanos);
+        mLhbmStats.stages[LhbmStats::CONFIG_SWITCH].add(lhbmEnablingNanos - lhbmWaitForRrNanos);
+        mLhbmStats.stages[LhbmStats::COMMAND].add(lhbmEnablingDoneNanos - lhbmEnablingNanos);
+        mLhbmStats.stages[LhbmStats::PANEL_ACK].add(now - lhbmEnablingDoneNanos);
+        mLhbmStats.stages[LhbmStats::TOTAL].add(now - lhbmStartNanos);
+        if (armedState->armed) mLhbmStats.armedCount++;
+    }
 
     mLhbmOn = true;
     if (!mPowerModeState.has_value() || (*mPowerModeState == HWC2_POWER_MODE_OFF && mLhbmOn)) {
@@ -1099,6 +1125,10 @@ int32_t ExynosPrimaryDisplay::setLhbmState(bool enabled) {
     }
     return NO_ERROR;
 enable_err:
+    {
+        std::lock_guard<std::mutex> lock(mLhbmStatsMutex);
+        mLhbmStats.failures++;
+    }
     {
         // We may receive LHBM request during the power off sequence due to the
         // race condition between display and sensor. If the failure happens
@@ -1120,6 +1150,98 @@ bool ExynosPrimaryDisplay::getLhbmState() {
     return mLhbmOn;
 }
 
+// This function should be called by other threads (e.g. sensor HAL) while the
+// fingerprint sensor is active.
+int32_t ExynosPrimaryDisplay::setLhbmArmed(bool armed) {
+    if (!isLhbmSupported()) return HWC2_ERROR_UNSUPPORTED;
+
+    std::lock_guard<std::mutex> lock(mLhbmArmMutex);
+    if (armed == mLhbmArmed) return NO_ERROR;
+    DISPLAY_LOGI("%s: armed=%d", __func__, armed);
+
+    if (!armed) {
+        // The files are closed once no setLhbmState() waits on them
+        mLhbmArmedState = std::make_shared<const LhbmArmedState>();
+        mLhbmArmed = false;
+        setMinIdleRefreshRate(0, RrThrottleRequester::LHBM);
+        return NO_ERROR;
+    }
+
+    uint32_t peakRate;
+    {
+        Mutex::Autolock lock(mDisplayMutex);
+        peakRate = getPeakRefreshRate();
+    }
+    if (peakRate < 60) {
+        DISPLAY_LOGE("%s: invalid peak rate=%d", __func__, peakRate);
+        return -EINVAL;
+    }
+
+    // Keep the files open so that the notifications are waited on without
+    // opening them again
+    auto state = std::make_shared<LhbmArmedState>();
+    auto lhbmSysfs = mBrightnessController->GetPanelSysfileByIndex(
+            BrightnessController::kLocalHbmModeFileNode);
+    state->modeFd = UniqueFd(open(lhbmSysfs.c_str(), O_RDONLY));
+    if (state->modeFd.get() < 0)
+        DISPLAY_LOGW("%s: failed to open %s: %s", __func__, lhbmSysfs.c_str(), strerror(errno));
+    auto rrSysfs = mBrightnessController->GetPanelRefreshRateSysfile();
+    if (mBrightnessController->fileExists(rrSysfs))
+        state->rrFd = UniqueFd(open(rrSysfs.c_str(), O_RDONLY));
+
+    // Keep the panel from idling below the peak refresh rate, so that
+    // setLhbmState() does not have to wait for the panel to leave idle
+    setMinIdleRefreshRate(peakRate, RrThrottleRequester::LHBM);
+
+    state->armed = true;
+    state->peakRate = peakRate;
+    state->armedNanos = systemTime(SYSTEM_TIME_MONOTONIC);
+    mLhbmArmedState = std::move(state);
+    mLhbmArmed = true;
+    return NO_ERROR;
+}
+
+int ExynosPrimaryDisplay::checkLhbmSysfsStatus(const UniqueFd& fd, const std::string& file,
+                                               const std::vector<std::string>& expectedValue,
+                                               const nsecs_t timeoutNs) {
+    if (fd.get() >= 0)
+        return mBrightnessController->checkSysfsStatus(fd.get(), file, expectedValue, timeoutNs);
+    return mBrightnessController->checkSysfsStatus(file, expectedValue, timeoutNs);
+}
+
+void ExynosPrimaryDisplay::LhbmStats::Histogram::add(int64_t ns) {
+    uint32_t bucket = 0;
+    for (int64_t ms = ns / 1000000; ms > 0 && bucket < kNumBuckets - 1; ms >>= 1) bucket++;
+    buckets[bucket]++;
+    count++;
+    sumNs += ns;
+    maxNs = std::max(maxNs, ns);
+}
+
+void ExynosPrimaryDisplay::dumpLhbmStats(String8& result) {
+    std::lock_guard<std::mutex> lock(mLhbmStatsMutex);
+    result.appendFormat("LHBM enabling latency: armed %d, %u enabled while armed, %u failures\n",
+                        mLhbmArmed.load(), mLhbmStats.armedCount, mLhbmStats.failures);
+    result.appendFormat("\t%-14s %6s %8s %8s |", "stage", "count", "avg(ms)", "max(ms)");
+    for (uint32_t i = 0; i < LhbmStats::kNumBuckets; i++) {
+        if (i == LhbmStats::kNumBuckets - 1)
+            result.appendFormat(" >=%-4u", 1u << (i - 1));
+        else
+            result.appendFormat(" <%-5u", 1u << i);
+    }
+    result.appendFormat("\n");
+    for (uint32_t stage = 0; stage < LhbmStats::MAX; stage++) {
+        const auto& histogram = mLhbmStats.stages[stage];
+        result.appendFormat("\t%-14s %6u %8.2f %8.2f |", LhbmStats::kStageNames[stage],
+                            histogram.count,
+                            histogram.count ? histogram.sumNs / 1e6 / histogram.count : 0.0,
+                            histogram.maxNs / 1e6);
+        for (uint32_t i = 0; i < LhbmStats::kNumBuckets; i++)
+            result.appendFormat(" %-6u", histogram.buckets[i]);
+        result.appendFormat("\n");
+    }
+}
+
 void ExynosPrimaryDisplay::setLHBMRefreshRateThrottle(const uint32_t delayMs) {
     ATRACE_CALL();
 
@@ -1361,13 +1483,13 @@ int32_t ExynosPrimaryDisplay::setMinIdleRefreshRate(const int targetFps,
                       "to %d",
                       __func__, std::get<0>(res.value()), it->second);
                 fps = std::max(fps, it->second);
-                if (mDisplayConfigs.count(mActiveConfig)) {
-                    if (fps > mDisplayConfigs[mActiveConfig].refreshRate) {
+                if (const auto record = mDisplayConfigIndex.find(mActiveConfig)) {
+                    if (fps > record->refreshRate) {
                         ALOGI("%s() The brightness blocking zone votes for the FPS = %d, which is "
                               "higher than the maximum refresh rate of the current configuration = "
                               "%d",
-                              __func__, fps, mDisplayConfigs[mActiveConfig].refreshRate);
-                        fps = mDisplayConfigs[mActiveConfig].refreshRate;
+                              __func__, fps, record->refreshRate);
+                        fps = record->refreshRate;
                     }
                 }
             }
@@ -1529,8 +1651,12 @@ void ExynosPrimaryDisplay::dump(String8 &result) {
     for (uint32_t i = 0; i < toUnderlying(RrThrottleRequester::MAX); i++) {
         result.appendFormat("\t[%u] vote to %" PRId64 " ns\n", i, mRrThrottleNanos[i]);
     }
-    if (mIsDisplayTempMonitorSupported) {
-        result.appendFormat("Temperature : %d°C\n", mDisplayTemperature);
+    if (mDisplayTempMonitor) {
+        result.appendFormat("Temperature : %d°C\n", mDisplayTemperature.load());
+        mDisplayTempMonitor->dump(result);
+    }
+    if (isLhbmSupported()) {
+        dumpLhbmStats(result);
     }
     result.appendFormat("\n");
 }
@@ -1556,8 +1682,7 @@ void ExynosPrimaryDisplay::calculateTimelineLocked(
         std::lock_guard<std::mutex> lock(mIdleRefreshRateThrottleMutex);
         threshold = mRefreshRateDelayNanos;
         mRrUseDelayNanos = 0;
-        mIsRrNeedCheckDelay =
-                mDisplayConfigs[mActiveConfig].vsyncPeriod < mDisplayConfigs[config].vsyncPeriod;
+        mIsRrNeedCheckDelay = getVsyncPeriod(mActiveConfig) < getVsyncPeriod(config);
         if (threshold != 0 && mLastRefreshRateAppliedNanos != 0 && mIsRrNeedCheckDelay) {
             lastUpdateDelta = desiredUpdateTimeNanos - mLastRefreshRateAppliedNanos;
             if (lastUpdateDelta < threshold) {
@@ -1582,8 +1707,8 @@ void ExynosPrimaryDisplay::calculateTimelineLocked(
                                  ", newVsyncAppliedTimeNanos : %" PRId64
                                  ", refreshTimeNanos:%" PRId64
                                  ", mLastRefreshRateAppliedNanos:%" PRId64,
-                                 mActiveConfig, mDisplayConfigs[mActiveConfig].vsyncPeriod, config,
-                                 mDisplayConfigs[config].vsyncPeriod, isDelayed,
+                                 mActiveConfig, getVsyncPeriod(mActiveConfig), config,
+                                 getVsyncPeriod(config), isDelayed,
                                  ns2ms(lastUpdateDelta), ns2ms(threshold - lastUpdateDelta),
                                  ns2ms(threshold), ns2ms(now), ns2ms(origDesiredUpdateTimeNanos),
                                  ns2ms(mVsyncPeriodChangeConstraints.desiredTimeNanos),
@@ -1639,7 +1764,8 @@ void ExynosPrimaryDisplay::updateAppliedActiveConfig(const hwc2_config_t newConf
         DISPLAY_LOGD(eDebugDisplayConfig,
                      "%s mAppliedActiveConfig(%d->%d), mLastRefreshRateAppliedNanos(%" PRIu64
                      " -> %" PRIu64 ")",
-                     __func__, mAppliedActiveConfig, newConfig, mLastRefreshRateAppliedNanos, ts);
+                     __func__, mAppliedActiveConfig, newConfig,
+                     mLastRefreshRateAppliedNanos.load(), ts);
         mLastRefreshRateAppliedNanos = ts;
         DISPLAY_ATRACE_INT64("LastRefreshRateAppliedMs", ns2ms(mLastRefreshRateAppliedNanos));
     }
@@ -1736,13 +1862,12 @@ int32_t ExynosPrimaryDisplay::registerRefreshRateChangeListener(
     }
 }
 
-// TODO(b/355579338): to create a dedicated class DisplayTemperatureMonitor
-bool ExynosPrimaryDisplay::initDisplayTempMonitor(const std::string& display) {
-    mDisplayTempInterval = property_get_int32(kDisplayTempIntervalSec, 0);
+void ExynosPrimaryDisplay::initDisplayTempMonitor(const std::string& display) {
+    const int32_t interval = property_get_int32(kDisplayTempIntervalSec, 0);
 
-    if (mDisplayTempInterval <= 0) {
-        ALOGD("%s: Invalid display temperature interval: %d", __func__, mDisplayTempInterval);
-        return false;
+    if (interval <= 0) {
+        ALOGD("%s: Invalid display temperature interval: %d", __func__, interval);
+        return;
     }
 
     auto propertyName = getPropertyDisplayTemperatureStr(display);
@@ -1752,94 +1877,30 @@ bool ExynosPrimaryDisplay::initDisplayTempMonitor(const std::string& display) {
 
     if (ret <= 0) {
         ALOGD("%s: Display temperature property values is empty", __func__);
-        return false;
-    }
-
-    mDisplayTempSysfsNode = String8(value);
-    return true;
-}
-
-int32_t ExynosPrimaryDisplay::getDisplayTemperature() {
-    DISPLAY_ATRACE_CALL();
-
-    if (mDisplayTempSysfsNode.empty()) {
-        ALOGE("%s: Display temp sysfs node string is empty", __func__);
-        return UINT_MAX;
-    }
-
-    int32_t temperature;
-    std::ifstream ifs(mDisplayTempSysfsNode.c_str());
-
-    if (!ifs.is_open()) {
-        ALOGE("%s: Unable to open node '%s', error = %s", __func__, mDisplayTempSysfsNode.c_str(),
-              strerror(errno));
-        return UINT_MAX;
-    }
-
-    if (!(ifs >> temperature) || !ifs.good()) {
-        ALOGE("%s: Unable to read node '%s', error = %s", __func__, mDisplayTempSysfsNode.c_str(),
-              strerror(errno));
+        return;
     }
 
-    ifs.close();
-    return temperature / 1000;
-}
-
-bool ExynosPrimaryDisplay::isTemperatureMonitorThreadRunning() {
-    android_atomic_acquire_load(&mTMThreadStatus);
-    return (mTMThreadStatus > 0);
+    mDisplayTempMonitor =
+            std::make_unique<DisplayTemperatureMonitor>(value, interval, [this](int32_t temp) {
+                mDisplayTemperature = static_cast<uint32_t>(temp);
+            });
 }
 
-void ExynosPrimaryDisplay::checkTemperatureMonitorThread(bool shouldRun) {
-    ATRACE_CALL();
-    if (!mIsDisplayTempMonitorSupported) {
+void ExynosPrimaryDisplay::updateDisplayTempMonitor(hwc2_power_mode_t mode) {
+    if (!mDisplayTempMonitor) {
         return;
     }
 
-    // If thread was destroyed, create thread and run.
-    if (!isTemperatureMonitorThreadRunning()) {
-        if (shouldRun) {
-            temperatureMonitorThreadCreate();
-            return;
-        }
-    } else {
-        // if screen state changed make the thread suspend/resume.
-        {
-            std::lock_guard<std::mutex> lock(mThreadMutex);
-            if (mTMLoopStatus != shouldRun) {
-                mTMLoopStatus = shouldRun;
-                mTMCondition.notify_one();
-            }
-        }
-    }
-}
-
-void ExynosPrimaryDisplay::temperatureMonitorThreadCreate() {
-    mTMLoopStatus.store(false, std::memory_order_relaxed);
-
-    ALOGI("Creating monitor display temperature thread");
-    mTMLoopStatus.store(true, std::memory_order_relaxed);
-    mTMThread = std::thread(&ExynosPrimaryDisplay::temperatureMonitorThreadLoop, this);
-    mTMCondition.notify_one();
-}
-
-void* ExynosPrimaryDisplay::temperatureMonitorThreadLoop() {
-    android_atomic_inc(&mTMThreadStatus);
-    while (true) {
-        std::unique_lock<std::mutex> lock(mThreadMutex);
-        mTMCondition.wait(lock, [this] { return mTMLoopStatus.load(std::memory_order_relaxed); });
-
-        mDisplayTemperature = getDisplayTemperature();
-        if (mDisplayTemperature == UINT_MAX) {
-            ALOGE("%s: Failed to get display temperature", LOG_TAG);
-        } else {
-            ALOGI("Display Temperature : %d°C", mDisplayTemperature);
-        }
-
-        // Wait for the specified interval or until the thread is suspended
-        mTMCondition.wait_for(lock, std::chrono::seconds(mDisplayTempInterval),
-                              [this] { return !mTMLoopStatus.load(std::memory_order_relaxed); });
+    switch (mode) {
+        case HWC2_POWER_MODE_ON:
+            mDisplayTempMonitor->setScreenState(DisplayTemperatureMonitor::ScreenState::ON);
+            break;
+        case HWC2_POWER_MODE_DOZE:
+        case HWC2_POWER_MODE_DOZE_SUSPEND:
+            mDisplayTempMonitor->setScreenState(DisplayTemperatureMonitor::ScreenState::DOZE);
+            break;
+        default:
+            mDisplayTempMonitor->setScreenState(DisplayTemperatureMonitor::ScreenState::OFF);
+            break;
     }
-    android_atomic_dec(&mTMThreadStatus);
-    return NULL;
 }
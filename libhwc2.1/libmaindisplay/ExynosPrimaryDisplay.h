@@ -18,6 +18,7 @@
 
 #include <map>
 
+#include "../libdevice/DisplayTemperatureMonitor.h"
 #include "../libdevice/ExynosDisplay.h"
 #include "../libvrr/VariableRefreshRateController.h"
 #include <cutils/properties.h>
@@ -42,6 +43,7 @@ class ExynosPrimaryDisplay : public ExynosDisplay {
 
         virtual bool isLhbmSupported();
         virtual int32_t setLhbmState(bool enabled);
+        virtual int32_t setLhbmArmed(bool armed) override;
 
         virtual bool getLhbmState();
         virtual void setEarlyWakeupDisplay();
@@ -123,7 +125,7 @@ class ExynosPrimaryDisplay : public ExynosDisplay {
         virtual bool isVrrSupported() const override { return mXrrSettings.versionInfo.isVrr(); }
 
         uint32_t mRcdId = -1;
-        uint32_t getDisplayTemperatue() { return mDisplayTemperature; };
+        uint32_t getDisplayTemperatue() { return mDisplayTemperature.load(); };
 
     private:
         static constexpr const char* kDisplayCalFilePath = "/mnt/vendor/persist/display/";
@@ -134,6 +136,11 @@ class ExynosPrimaryDisplay : public ExynosDisplay {
 
         bool checkLhbmMode(bool status, nsecs_t timoutNs);
         void setLHBMRefreshRateThrottle(const uint32_t delayMs);
+        // Checks @file through @fd if it is kept open while LHBM is armed
+        int checkLhbmSysfsStatus(const UniqueFd& fd, const std::string& file,
+                                 const std::vector<std::string>& expectedValue,
+                                 const nsecs_t timeoutNs);
+        void dumpLhbmStats(String8& result);
 
         bool mFirstPowerOn = true;
         bool mNotifyPowerOn = false;
@@ -151,25 +158,14 @@ class ExynosPrimaryDisplay : public ExynosDisplay {
         int32_t setDisplayIdleDelayNanos(int32_t delayNanos,
                                          const DispIdleTimerRequester requester);
         void initDisplayHandleIdleExit();
-        int32_t setLhbmDisplayConfigLocked(uint32_t peakRate);
+        int32_t setLhbmDisplayConfigLocked(uint32_t peakRate, bool* configChanged = nullptr);
         void restoreLhbmDisplayConfigLocked();
 
 
         // monitor display thermal temperature
-        int32_t getDisplayTemperature();
-        bool initDisplayTempMonitor(const std::string& display);
-        bool isTemperatureMonitorThreadRunning();
-        void checkTemperatureMonitorThread(bool shouldRun);
-        void temperatureMonitorThreadCreate();
-        void* temperatureMonitorThreadLoop();
-        bool mIsDisplayTempMonitorSupported = false;
-        volatile int32_t mTMThreadStatus;
-        std::atomic<bool> mTMLoopStatus;
-        std::condition_variable mTMCondition;
-        std::thread mTMThread;
-        std::mutex mThreadMutex;
-        int32_t mDisplayTempInterval;
-        String8 mDisplayTempSysfsNode;
+        void initDisplayTempMonitor(const std::string& display);
+        void updateDisplayTempMonitor(hwc2_power_mode_t mode);
+        std::unique_ptr<DisplayTemperatureMonitor> mDisplayTempMonitor;
         std::string getPropertyDisplayTemperatureStr(const std::string& display) {
             return "ro.vendor." + display + "." + getPanelName() + ".temperature_path";
         }
@@ -180,11 +176,56 @@ class ExynosPrimaryDisplay : public ExynosDisplay {
         FILE* mLhbmFd;
         std::atomic<bool> mLhbmOn;
         int32_t mFramesToReachLhbmPeakBrightness;
+        // Set by setLhbmArmed(). setLhbmState() waits on the files of the state it
+        // took, so that setLhbmArmed() does not wait for it.
+        struct LhbmArmedState {
+            bool armed = false;
+            uint32_t peakRate = 0;
+            int64_t armedNanos = 0;
+            UniqueFd modeFd;
+            UniqueFd rrFd;
+        };
+        // Protects mLhbmArmedState
+        std::mutex mLhbmArmMutex;
+        std::atomic<bool> mLhbmArmed = false;
+        std::shared_ptr<const LhbmArmedState> mLhbmArmedState =
+                std::make_shared<const LhbmArmedState>();
+
+        // Latency of enabling LHBM
+        struct LhbmStats {
+            enum Stage : uint32_t {
+                POWER_WAIT = 0,
+                CONFIG_SWITCH,
+                COMMAND,
+                PANEL_ACK,
+                TOTAL,
+                MAX,
+            };
+            static constexpr const char* kStageNames[MAX] = {"power wait", "config switch",
+                                                             "command", "panel ack", "total"};
+            // Bucket 0 counts latencies below 1ms and bucket i counts [2^(i-1), 2^i) ms.
+            // The last bucket counts everything above.
+            static constexpr uint32_t kNumBuckets = 10;
+            struct Histogram {
+                uint32_t buckets[kNumBuckets] = {};
+                uint32_t count = 0;
+                int64_t sumNs = 0;
+                int64_t maxNs = 0;
+                void add(int64_t ns);
+            };
+            Histogram stages[MAX];
+            uint32_t armedCount = 0;
+            uint32_t failures = 0;
+        };
+        std::mutex mLhbmStatsMutex;
+        LhbmStats mLhbmStats;
         bool mConfigSettingDisabled = false;
         int64_t mConfigSettingDisabledTimestamp = 0;
         // timeout value of waiting for peak refresh rate
         static constexpr uint32_t kLhbmWaitForPeakRefreshRateMs = 100U;
         static constexpr uint32_t kLhbmRefreshRateThrottleMs = 1000U;
+        // frames at the peak refresh rate after arming before the panel is considered settled
+        static constexpr uint32_t kLhbmArmedSettleFrames = 4U;
         static constexpr uint32_t kConfigDisablingMaxDurationMs = 1000U;
         static constexpr uint32_t kSysfsCheckTimeoutMs = 500U;
 
@@ -216,7 +257,7 @@ class ExynosPrimaryDisplay : public ExynosDisplay {
         int64_t mRrThrottleNanos[toUnderlying(RrThrottleRequester::MAX)];
         int64_t mRefreshRateDelayNanos;
         int64_t mRrUseDelayNanos;
-        int64_t mLastRefreshRateAppliedNanos;
+        std::atomic<int64_t> mLastRefreshRateAppliedNanos;
         bool mIsRrNeedCheckDelay;
         hwc2_config_t mAppliedActiveConfig;
 
@@ -233,7 +274,8 @@ class ExynosPrimaryDisplay : public ExynosDisplay {
 
         XrrSettings_t mXrrSettings;
         std::shared_ptr<VariableRefreshRateController> mVariableRefreshRateController;
-        uint32_t mDisplayTemperature = UINT_MAX;
+        // Written by setDisplayTemperature() and the temperature monitor
+        std::atomic<uint32_t> mDisplayTemperature = UINT_MAX;
 };
 
 #endif
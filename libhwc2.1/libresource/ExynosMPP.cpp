@@ -2921,6 +2921,22 @@ void ExynosMPP::dump(String8& result)
     result.appendFormat("\tassinedSourceNum(%zu), Capacity(%f), CapaUsed(%f), mCurrentDstBuf(%d)\n",
             mAssignedSources.size(), mCapacity, mUsedCapacity, mCurrentDstBuf);
 
+    AcrylicPerformanceStats stats;
+    if ((mAcrylicHandle != NULL) && mAcrylicHandle->getPerformanceStats(&stats)) {
+        uint64_t measured = std::max<uint64_t>(stats.mTaskCount, 1);
+        result.appendFormat("\tQoS: tasks(%" PRIu64 "), late(%" PRIu64 "), avg queue(%" PRIu64
+                            "us), avg exec(%" PRIu64 "us), avg error(%" PRId64
+                            "us), avg abs error(%" PRIu64 "us), max late(%uus)\n",
+                stats.mTaskCount, stats.mLateTaskCount, stats.mQueueTimeUSec / measured,
+                stats.mExecTimeUSec / measured, stats.mErrorUSec / static_cast<int64_t>(measured),
+                stats.mAbsErrorUSec / measured, stats.mMaxLateUSec);
+        result.appendFormat("\tQoS: deadline(%uus), correction(%u/1024), bandwidth(model %u, "
+                            "requested %u KB/s), requests(%" PRIu64 "), adjusted(%" PRIu64
+                            "), scenes(%u)\n",
+                stats.mDeadlineUSec, stats.mCorrection, stats.mModelBandwidth,
+                stats.mRequestedBandwidth, stats.mRequestCount, stats.mAdjustCount,
+                stats.mSceneCount);
+    }
 }
 
 void ExynosMPP::closeFences()
@@ -162,6 +162,13 @@ ExynosResourceManager::ExynosResourceManager(ExynosDevice *device)
     mMinimumSdrDimRatio = property_get("debug.hwc.min_sdr_dimming", value, nullptr) > 0
                           ? std::atof(value) : 0.0f;
     updateSupportWCG();
+
+    if (property_get_bool("ro.vendor.display.mpp_partition", false)) {
+        std::vector<uint32_t> slotPools(mOtfMPPs.size(), MPP_TYPE_OTF);
+        slotPools.insert(slotPools.end(), mM2mMPPs.size(), MPP_TYPE_M2M);
+        mPartition = std::make_unique<ResourcePartition>(std::move(slotPools));
+        ALOGI("MPP partition is enabled");
+    }
 }
 
 ExynosResourceManager::~ExynosResourceManager()
@@ -263,7 +270,7 @@ void ExynosResourceManager::DstBufMgrThread::reallocDstBufs(uint32_t Xres, uint3
     }
 
     if (needRealloc) {
-        Mutex::Autolock lock(mStateMutex);
+        std::unique_lock<std::shared_mutex> lock(mStateMutex);
         if (mExynosResourceManager->mForceReallocState == DST_REALLOC_DONE) {
             mExynosResourceManager->mForceReallocState = DST_REALLOC_START;
             android::Mutex::Autolock lock(mMutex);
@@ -300,7 +307,7 @@ bool ExynosResourceManager::DstBufMgrThread::threadLoop()
         } while (mBufXres != display->mXres || mBufYres != display->mYres);
 
         {
-            Mutex::Autolock lock(mStateMutex);
+            std::unique_lock<std::shared_mutex> lock(mStateMutex);
             mExynosResourceManager->mForceReallocState = DST_REALLOC_DONE;
             HDEBUGLOGD(eDebugBuf, "M2M dst alloc %d, %d, %d, %d : Realloc On Done ----------",
                     mBufXres, display->mXres, mBufYres, display->mYres);
@@ -377,10 +384,11 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display)
     if ((mDevice == NULL) || (display == NULL))
         return -EINVAL;
 
+    uint64_t geometryChanged = getGeometryChanged(display);
     HDEBUGLOGD(eDebugResourceManager|eDebugSkipResourceAssign, "mGeometryChanged(0x%" PRIx64 "), display(%d)",
-            mDevice->mGeometryChanged, display->mType);
+            geometryChanged, display->mType);
 
-    if (mDevice->mGeometryChanged == 0) {
+    if (geometryChanged == 0) {
         return NO_ERROR;
     }
 
@@ -407,7 +415,8 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display)
         calculateHWResourceAmount(display, display->mLayers[i]);
     }
 
-    if (mDevice->isFirstValidate()) {
+    /* A partitioned display prepared its resources when it rebalanced */
+    if ((mPartition == nullptr) && mDevice->isFirstValidate()) {
         HDEBUGLOGD(eDebugResourceManager, "This is first validate");
         if (exynosHWCControl.displayMode < DISPLAY_MODE_NUM)
             mDevice->mDisplayMode = exynosHWCControl.displayMode;
@@ -439,6 +448,13 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display)
         return ret;
     }
 
+    if ((display->mDisplayControl.preValidateAssignment) &&
+        ((ret = preValidateAssignment(display)) != NO_ERROR)) {
+        HWC_LOGE(display, "%s:: preValidateAssignment() error (%d)",
+                __func__, ret);
+        return ret;
+    }
+
     if (hwcCheckDebugMessages(eDebugResourceManager)) {
         HDEBUGLOGD(eDebugResourceManager, "AssignResource result");
         String8 result;
@@ -455,7 +471,16 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display)
         }
     }
 
-    if (mDevice->isLastValidate(display)) {
+    if (mPartition) {
+        if ((ret = updateResourceState(display)) != NO_ERROR) {
+            HWC_LOGE(display, "%s:: updateResourceState() error (%d)",
+                    __func__, ret);
+            return ret;
+        }
+        updatePartitionDemand(display);
+        mPartition->clearStale(display->mDisplayId);
+        mPartition->clearChanges(display->mDisplayId);
+    } else if (mDevice->isLastValidate(display)) {
         if ((ret = finishAssignResourceWork()) != NO_ERROR) {
             HWC_LOGE(display, "%s:: finishAssignResourceWork() error (%d)",
                     __func__, ret);
@@ -482,6 +507,60 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display)
     return NO_ERROR;
 }
 
+/**
+ * Checks the assignment with a TEST_ONLY commit. Layers rejected by the kernel
+ * don't use otfMPP directly and resources are assigned again, so they fall
+ * back to m2mMPP or client composition in this validate instead of failing
+ * in presentDisplay().
+ * @param * display
+ * @return int
+ */
+int32_t ExynosResourceManager::preValidateAssignment(ExynosDisplay *display)
+{
+    ATRACE_CALL();
+    int32_t ret = NO_ERROR;
+
+    if (!display->mUseDpu || display->isPowerModeOff() || !display->isEnabled())
+        return NO_ERROR;
+
+    uint32_t otfMPPTypes = 0;
+    for (auto otfMPP : mOtfMPPs)
+        otfMPPTypes |= otfMPP->mLogicalType;
+
+    std::map<ExynosLayer *, uint32_t> maskedLayers;
+    for (uint32_t retry = 0; retry < display->mLayers.size(); retry++) {
+        ExynosLayer *rejected = nullptr;
+        if ((display->testWinConfigData(rejected) != -EINVAL) || (rejected == nullptr))
+            break;
+
+        HDEBUGLOGD(eDebugResourceManager, "%s:: layer(%p) is rejected by TEST_ONLY commit",
+                   __func__, rejected);
+        display->mPreValidation.fallbacks++;
+        maskedLayers.emplace(rejected, rejected->mSupportedMPPFlag);
+        rejected->mSupportedMPPFlag &= ~otfMPPTypes;
+
+        for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+            display->mLayers[i]->resetValidateData();
+        }
+        display->initializeValidateInfos();
+
+        if ((ret = assignResourceInternal(display)) != NO_ERROR) {
+            HWC_LOGE(display, "%s:: assignResourceInternal() error (%d)", __func__, ret);
+            break;
+        }
+        if ((ret = assignWindow(display)) != NO_ERROR) {
+            HWC_LOGE(display, "%s:: assignWindow() error (%d)", __func__, ret);
+            break;
+        }
+    }
+
+    /* Rejected configs are memoized, the next assignment is checked without a commit */
+    for (auto &[layer, flag] : maskedLayers)
+        layer->mSupportedMPPFlag = flag;
+
+    return ret;
+}
+
 int32_t ExynosResourceManager::setResourcePriority(ExynosDisplay *display)
 {
     int ret = NO_ERROR;
@@ -553,7 +632,17 @@ int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display)
     int ret = NO_ERROR;
     int retry_count = 0;
 
-    Mutex::Autolock lock(mDstBufMgrThread->mStateMutex);
+    /*
+     * Partitioned displays only touch their own MPPs and just need the realloc
+     * state to hold still. Otherwise assignment is serialized between displays.
+     */
+    std::shared_lock<std::shared_mutex> sharedLock(mDstBufMgrThread->mStateMutex,
+                                                   std::defer_lock);
+    std::unique_lock<std::shared_mutex> lock(mDstBufMgrThread->mStateMutex, std::defer_lock);
+    if (mPartition)
+        sharedLock.lock();
+    else
+        lock.lock();
 
     /*
      * First add layers that SF requested HWC2_COMPOSITION_CLIENT type
@@ -2186,14 +2275,23 @@ ExynosMPP* ExynosResourceManager::getExynosMPP(uint32_t physicalType, uint32_t p
     return NULL;
 }
 
-int32_t ExynosResourceManager::updateResourceState()
+/*
+ * display is set when a partitioned display only updates the MPPs it owns
+ */
+int32_t ExynosResourceManager::updateResourceState(ExynosDisplay *display)
 {
     for (uint32_t i = 0; i < mOtfMPPs.size(); i++) {
+        if ((display != nullptr) &&
+            (mOtfMPPs[i]->mReservedDisplay != (int32_t)display->mDisplayId))
+            continue;
         if (mOtfMPPs[i]->mAssignedSources.size() == 0)
             mOtfMPPs[i]->requestHWStateChange(MPP_HW_STATE_IDLE);
         mOtfMPPs[i]->mPrevAssignedState = mOtfMPPs[i]->mAssignedState;
     }
     for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
+        if ((display != nullptr) &&
+            (mM2mMPPs[i]->mReservedDisplay != (int32_t)display->mDisplayId))
+            continue;
         if (mM2mMPPs[i]->mAssignedSources.size() == 0)
             mM2mMPPs[i]->requestHWStateChange(MPP_HW_STATE_IDLE);
         mM2mMPPs[i]->mPrevAssignedState = mM2mMPPs[i]->mAssignedState;
@@ -2216,6 +2314,48 @@ void ExynosResourceManager::setFrameRateForPerformance(ExynosMPP &mpp,
     frame->setFrameRate(fps);
 }
 
+bool ExynosResourceManager::setPerformanceFrame(ExynosMPP &mpp,
+                                                AcrylicPerformanceRequestFrame *frame)
+{
+    if (frame->reset(mpp.mAssignedSources.size()) == false)
+        return false;
+    setFrameRateForPerformance(mpp, frame);
+
+    for (uint32_t j = 0; j < mpp.mAssignedSources.size(); j++) {
+        ExynosMPPSource* mppSource = mpp.mAssignedSources[j];
+        frame->setSourceDimension(j,
+                mppSource->mSrcImg.w, mppSource->mSrcImg.h,
+                mppSource->mSrcImg.format);
+
+        if (mppSource->mSrcImg.compressionInfo.type == COMP_TYPE_AFBC)
+            frame->setAttribute(j, AcrylicCanvas::ATTR_COMPRESSED);
+
+        hwc_rect_t src_area;
+        src_area.left = mppSource->mSrcImg.x;
+        src_area.top = mppSource->mSrcImg.y;
+        src_area.right = mppSource->mSrcImg.x + mppSource->mSrcImg.w;
+        src_area.bottom = mppSource->mSrcImg.y + mppSource->mSrcImg.h;
+
+        hwc_rect_t out_area;
+        out_area.left = mppSource->mMidImg.x;
+        out_area.top = mppSource->mMidImg.y;
+        out_area.right = mppSource->mMidImg.x + mppSource->mMidImg.w;
+        out_area.bottom = mppSource->mMidImg.y + mppSource->mMidImg.h;
+
+        frame->setTransfer(j, src_area, out_area, mppSource->mSrcImg.transform);
+    }
+    uint32_t format = mpp.mAssignedSources[0]->mMidImg.format;
+    bool hasSolidColorLayer = false;
+    if (mpp.mNeedSolidColorLayer) {
+        format = DEFAULT_MPP_DST_FORMAT;
+        hasSolidColorLayer = true;
+    }
+
+    frame->setTargetDimension(mpp.mAssignedDisplay->mXres,
+            mpp.mAssignedDisplay->mYres, format, hasSolidColorLayer);
+    return true;
+}
+
 int32_t ExynosResourceManager::deliverPerformanceInfo()
 {
     int ret = NO_ERROR;
@@ -2274,44 +2414,10 @@ int32_t ExynosResourceManager::deliverPerformanceInfo()
                     break;
                 }
                 AcrylicPerformanceRequestFrame *frame = request.getFrame(assignedInstanceIndex);
-                if(frame->reset(mpp->mAssignedSources.size()) == false) {
+                if (setPerformanceFrame(*mpp, frame) == false) {
                     HWC_LOGE(NULL,"%d frame reset fail (%zu)", assignedInstanceIndex, mpp->mAssignedSources.size());
                     break;
                 }
-                setFrameRateForPerformance(*mpp, frame);
-
-                for (uint32_t j = 0; j < mpp->mAssignedSources.size(); j++) {
-                    ExynosMPPSource* mppSource = mpp->mAssignedSources[j];
-                    frame->setSourceDimension(j,
-                            mppSource->mSrcImg.w, mppSource->mSrcImg.h,
-                            mppSource->mSrcImg.format);
-
-                    if (mppSource->mSrcImg.compressionInfo.type == COMP_TYPE_AFBC)
-                        frame->setAttribute(j, AcrylicCanvas::ATTR_COMPRESSED);
-
-                    hwc_rect_t src_area;
-                    src_area.left = mppSource->mSrcImg.x;
-                    src_area.top = mppSource->mSrcImg.y;
-                    src_area.right = mppSource->mSrcImg.x + mppSource->mSrcImg.w;
-                    src_area.bottom = mppSource->mSrcImg.y + mppSource->mSrcImg.h;
-
-                    hwc_rect_t out_area;
-                    out_area.left = mppSource->mMidImg.x;
-                    out_area.top = mppSource->mMidImg.y;
-                    out_area.right = mppSource->mMidImg.x + mppSource->mMidImg.w;
-                    out_area.bottom = mppSource->mMidImg.y + mppSource->mMidImg.h;
-
-                    frame->setTransfer(j, src_area, out_area, mppSource->mSrcImg.transform);
-                }
-                uint32_t format = mpp->mAssignedSources[0]->mMidImg.format;
-                bool hasSolidColorLayer = false;
-                if (mpp->mNeedSolidColorLayer) {
-                    format = DEFAULT_MPP_DST_FORMAT;
-                    hasSolidColorLayer = true;
-                }
-
-                frame->setTargetDimension(mpp->mAssignedDisplay->mXres,
-                        mpp->mAssignedDisplay->mYres, format, hasSolidColorLayer);
 
                 assignedInstanceIndex++;
             }
@@ -2324,6 +2430,73 @@ int32_t ExynosResourceManager::deliverPerformanceInfo()
     return ret;
 }
 
+int32_t ExynosResourceManager::deliverPerformanceInfo(ExynosDisplay *display)
+{
+    if (mPartition == nullptr)
+        return deliverPerformanceInfo();
+
+    /*
+     * One G2D request covers every display, but a partitioned display only
+     * reads its own MPPs. It publishes its frames and sends the merged request.
+     */
+    std::vector<std::unique_ptr<AcrylicPerformanceRequestFrame>> frames;
+    bool canSkipSetting = true;
+    for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
+        ExynosMPP *mpp = mM2mMPPs[i];
+        if ((mpp->mPhysicalType != MPP_G2D) ||
+            (mpp->mReservedDisplay != (int32_t)display->mDisplayId))
+            continue;
+        if ((mpp->mPrevAssignedState & MPP_ASSIGN_STATE_ASSIGNED) ||
+            (mpp->mAssignedState & MPP_ASSIGN_STATE_ASSIGNED))
+            canSkipSetting = false;
+        if (mpp->canSkipProcessing() || (mpp->mAssignedDisplay != display) ||
+            (mpp->mAssignedSources.size() == 0))
+            continue;
+
+        auto frame = std::make_unique<AcrylicPerformanceRequestFrame>();
+        if (setPerformanceFrame(*mpp, frame.get()) == false) {
+            HWC_LOGE(display, "%s frame reset fail (%zu)", mpp->mName.c_str(),
+                     mpp->mAssignedSources.size());
+            continue;
+        }
+        frames.push_back(std::move(frame));
+    }
+
+    std::lock_guard<std::mutex> lock(mPerformanceMutex);
+    mPerformanceFrames[display->mDisplayId] = std::move(frames);
+    if (canSkipSetting)
+        return NO_ERROR;
+
+    int frameCount = 0;
+    for (const auto &[id, displayFrames] : mPerformanceFrames)
+        frameCount += displayFrames.size();
+
+    AcrylicPerformanceRequest request;
+    request.reset(frameCount);
+    int index = 0;
+    for (const auto &[id, displayFrames] : mPerformanceFrames) {
+        for (const auto &src : displayFrames) {
+            AcrylicPerformanceRequestFrame *dst = request.getFrame(index++);
+            if ((dst == NULL) || (dst->reset(src->mNumLayers) == false)) {
+                HWC_LOGE(display, "%s:: merged frame reset fail (%d)", __func__, index);
+                return -ENOMEM;
+            }
+            std::copy(src->mLayers, src->mLayers + src->mNumLayers, dst->mLayers);
+            dst->setFrameRate(src->mFrameRate);
+            dst->setTargetDimension(src->mTargetDimension.hori, src->mTargetDimension.vert,
+                                    src->mTargetPixFormat, src->mHasBackgroundLayer);
+        }
+    }
+
+    ExynosMPP *mpp = getExynosMPP(MPP_LOGICAL_G2D_RGB);
+    if (mpp == NULL) {
+        HWC_LOGE(display, "getExynosMPP(MPP_LOGICAL_G2D_RGB) failed");
+        return -EINVAL;
+    }
+    mpp->mAcrylicHandle->requestPerformanceQoS(&request);
+    return NO_ERROR;
+}
+
 /*
  * Get used capacity of the resource that abstracts same HW resource
  * but it is different instance with mpp
@@ -2437,6 +2610,29 @@ int32_t ExynosResourceManager::prepareResources(const int32_t willOnDispId) {
     return ret;
 }
 
+/*
+ * A display turns on while another one is on. The other displays of a
+ * partition may be presenting, so only the MPPs the display owns are reset,
+ * under the rebalance lock, and the rest waits for the next rebalance.
+ */
+int32_t ExynosResourceManager::prepareResourcesForPowerOn(ExynosDisplay *display)
+{
+    if (mPartition == nullptr)
+        return prepareResources(display->mDisplayId);
+
+    auto lock = mPartition->lockForRebalance();
+    for (size_t i = 0; i < mPartition->getSlotCount(); i++) {
+        if (mPartition->isPinned(i) || (mPartition->getOwner(i) != display->mDisplayId))
+            continue;
+        ExynosMPP *mpp = getPartitionMPP(i);
+        mpp->resetMPP();
+        mpp->requestHWStateChange(MPP_HW_STATE_IDLE);
+        mpp->reserveMPP(display->mDisplayId);
+    }
+    mPendingPrepare |= GEOMETRY_DISPLAY_POWER_ON;
+    return NO_ERROR;
+}
+
 int32_t ExynosResourceManager::finishAssignResourceWork()
 {
 	int ret = NO_ERROR;
@@ -2471,6 +2667,189 @@ int32_t ExynosResourceManager::initResourcesState(ExynosDisplay *display)
     return NO_ERROR;
 }
 
+/* Device level geometry changes, which are rebalancing points of the MPP partition */
+static constexpr uint64_t kPartitionGeometry = GEOMETRY_DISPLAY_POWER_ON |
+        GEOMETRY_DISPLAY_POWER_OFF | GEOMETRY_DEVICE_DISPLAY_ADDED |
+        GEOMETRY_DEVICE_DISPLAY_REMOVED | GEOMETRY_DEVICE_CONFIG_CHANGED |
+        GEOMETRY_DEVICE_DISP_MODE_CHAGED | GEOMETRY_DEVICE_SCENARIO_CHANGED;
+
+ExynosMPP *ExynosResourceManager::getPartitionMPP(size_t slot) const
+{
+    if (slot < mOtfMPPs.size())
+        return mOtfMPPs[slot];
+    return mM2mMPPs[slot - mOtfMPPs.size()];
+}
+
+/* Same displays as the ones isFirstValidate() waits for */
+bool ExynosResourceManager::isPartitionActive(ExynosDisplay *display) const
+{
+    if (display->mPlugState == false)
+        return false;
+    return (display->mType == HWC_DISPLAY_VIRTUAL) ||
+            (display->mPowerModeState.has_value() &&
+             (display->mPowerModeState.value() != (hwc2_power_mode_t)HWC_POWER_MODE_OFF));
+}
+
+/*
+ * Power, hotplug and device level changes are rebalancing points, as is a
+ * display that wants more MPPs than it owns while another one has some to
+ * spare. Resources are prepared from scratch only when no other display has a
+ * frame in flight, like on the first validate of a frame. Otherwise the MPPs
+ * that are not in use move and the prepare stays pending.
+ *
+ * The device level bits are taken off the device by the first rebalance that
+ * sees them. Every display then reassigns once for them and clears its copy,
+ * so a pending prepare doesn't make the displays reassign on every frame.
+ */
+int32_t ExynosResourceManager::rebalancePartition(ExynosDisplay *display)
+{
+    const int32_t displayId = display->mDisplayId;
+
+    if (((mDevice->mGeometryChanged & kPartitionGeometry) == 0) && (mPendingPrepare == 0) &&
+        (mPartition->needsRebalance(displayId) == false))
+        return NO_ERROR;
+
+    ATRACE_CALL();
+    auto lock = mPartition->lockForRebalance();
+    int32_t ret = NO_ERROR;
+
+    const uint64_t changes = mDevice->mGeometryChanged & kPartitionGeometry;
+    if (changes) {
+        std::vector<int32_t> displayIds;
+        for (uint32_t i = 0; i < mDisplays.size(); i++)
+            displayIds.push_back(mDisplays[i]->mDisplayId);
+        mPartition->addChanges(displayIds, changes);
+        mPendingPrepare |= changes;
+        mDevice->mGeometryChanged &= ~changes;
+    }
+
+    if (mPendingPrepare && (mPartition->hasFrameInFlight(displayId) == false)) {
+        HDEBUGLOGD(eDebugResourceManager, "%s:: prepare resources, display(%d)",
+                __func__, displayId);
+        if (exynosHWCControl.displayMode < DISPLAY_MODE_NUM)
+            mDevice->mDisplayMode = exynosHWCControl.displayMode;
+
+        /* prepareResources() looks for the changes on the device */
+        const uint64_t prepared = mPendingPrepare;
+        mDevice->mGeometryChanged |= prepared;
+        ret = prepareResources();
+        /* Like clearGeometryChanged(), but keeps the changes made meanwhile */
+        mDevice->mGeometryChanged &= kPartitionGeometry & ~prepared;
+        if (ret != NO_ERROR) {
+            HWC_LOGE(display, "%s:: prepareResources() error (%d)",
+                    __func__, ret);
+            return ret;
+        }
+        preAssignWindows(display);
+
+        mPartition->reset();
+        for (size_t i = 0; i < mPartition->getSlotCount(); i++) {
+            ExynosMPP *mpp = getPartitionMPP(i);
+            if (mpp->mAssignedState & MPP_ASSIGN_STATE_RESERVED)
+                mPartition->setPinned(i, mpp->mReservedDisplay);
+        }
+        mPendingPrepare = 0;
+    }
+
+    std::vector<int32_t> active;
+    for (uint32_t i = 0; i < mDisplays.size(); i++) {
+        if ((mDisplays[i] == display) || isPartitionActive(mDisplays[i]))
+            active.push_back(mDisplays[i]->mDisplayId);
+    }
+    std::vector<int32_t> users;
+    for (size_t i = 0; i < mPartition->getSlotCount(); i++) {
+        ExynosMPP *mpp = getPartitionMPP(i);
+        users.push_back((mpp->mAssignedDisplay != NULL) ? (int32_t)mpp->mAssignedDisplay->mDisplayId
+                                                        : ResourcePartition::kNoDisplay);
+    }
+    std::vector<size_t> moved = mPartition->rebalance(displayId, active, users);
+
+    /*
+     * Reserve every MPP for its owner. MPPs without an owner are reserved for
+     * no display, so a display can't pick up an MPP outside of its partition.
+     */
+    for (size_t i = 0; i < mPartition->getSlotCount(); i++) {
+        if (mPartition->isPinned(i))
+            continue;
+        ExynosMPP *mpp = getPartitionMPP(i);
+        int32_t owner = mPartition->getOwner(i);
+        if ((mpp->mAssignedState & MPP_ASSIGN_STATE_RESERVED) && (mpp->mReservedDisplay == owner))
+            continue;
+        mpp->resetMPP();
+        mpp->requestHWStateChange(MPP_HW_STATE_IDLE);
+        mpp->reserveMPP(owner);
+    }
+    HDEBUGLOGD(eDebugResourceManager, "%s:: display(%d) moved %zu MPPs", __func__, displayId,
+            moved.size());
+    return NO_ERROR;
+}
+
+/*
+ * Layers that could use an MPP of each pool: every layer SF did not ask to
+ * be composed by the client, plus the client target, and the layers that
+ * went through or lacked an M2M MPP.
+ */
+void ExynosResourceManager::updatePartitionDemand(ExynosDisplay *display)
+{
+    uint32_t otfDemand = 0;
+    uint32_t m2mDemand = 0;
+    bool hasClientLayer = false;
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        if (layer->mCompositionType == HWC2_COMPOSITION_CLIENT)
+            hasClientLayer = true;
+        else
+            otfDemand++;
+        if ((layer->mM2mMPP != NULL) || (layer->mOverlayInfo & eInsufficientMPP))
+            m2mDemand++;
+    }
+    if (hasClientLayer)
+        otfDemand++;
+
+    mPartition->setDemand(display->mDisplayId, MPP_TYPE_OTF, otfDemand);
+    mPartition->setDemand(display->mDisplayId, MPP_TYPE_M2M, m2mDemand);
+}
+
+ResourcePartition::Lease ExynosResourceManager::acquirePartitionLease(ExynosDisplay *display,
+                                                                      bool newFrame)
+{
+    if (mPartition == nullptr)
+        return ResourcePartition::Lease();
+
+    if (newFrame) {
+        int32_t ret = rebalancePartition(display);
+        if (ret != NO_ERROR)
+            HWC_LOGE(display, "%s:: rebalancePartition() error (%d)", __func__, ret);
+    }
+    ResourcePartition::Lease lease = mPartition->acquireLease();
+    if (newFrame)
+        mPartition->beginFrame(display->mDisplayId);
+    return lease;
+}
+
+void ExynosResourceManager::finishPartitionFrame(ExynosDisplay *display)
+{
+    if (mPartition)
+        mPartition->endFrame(display->mDisplayId);
+}
+
+/*
+ * A partitioned display only reassigns for its own changes, the device level
+ * ones and when its partition changed.
+ */
+uint64_t ExynosResourceManager::getGeometryChanged(ExynosDisplay *display)
+{
+    if (mPartition == nullptr)
+        return mDevice->mGeometryChanged;
+
+    uint64_t geometryChanged = display->mGeometryChanged |
+            (mDevice->mGeometryChanged & kPartitionGeometry) |
+            mPartition->getChanges(display->mDisplayId);
+    if (mPartition->isStale(display->mDisplayId))
+        geometryChanged |= GEOMETRY_DEVICE_CONFIG_CHANGED;
+    return geometryChanged;
+}
+
 void ExynosResourceManager::makeSizeRestrictions(uint32_t mppId, const restriction_size_t &size,
                                                  restriction_classification_t format) {
     mSizeRestrictions[format][mSizeRestrictionCnt[format]].key.hwType = static_cast<mpp_phycal_type_t>(mppId);
@@ -2718,6 +3097,17 @@ void ExynosResourceManager::dump(String8 &result) const {
     for (auto mpp : mM2mMPPs) {
         mpp->dump(result);
     }
+
+    if (mPartition) {
+        result.appendFormat("[MPP Partition] rebalances(%" PRIu64 "), moved(%" PRIu64
+                            "), deferred(%" PRIu64 ")\n",
+                            mPartition->getRebalanceCount(), mPartition->getMovedCount(),
+                            mPartition->getDeferredCount());
+        for (size_t i = 0; i < mPartition->getSlotCount(); i++) {
+            result.appendFormat("\t%s: owner(%d)%s\n", getPartitionMPP(i)->mName.c_str(),
+                                mPartition->getOwner(i), mPartition->isPinned(i) ? ", pinned" : "");
+        }
+    }
 }
 
 void ExynosResourceManager::dump(const restriction_classification_t classification,
@@ -21,12 +21,18 @@
 #ifndef _EXYNOSRESOURCEMANAGER_H
 #define _EXYNOSRESOURCEMANAGER_H
 
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include "ExynosDevice.h"
 #include "ExynosDisplay.h"
 #include "ExynosHWCHelper.h"
 #include "ExynosMPPModule.h"
 #include "ExynosResourceRestriction.h"
+#include "ResourcePartition.h"
 
 using namespace android;
 
@@ -88,7 +94,7 @@ class ExynosResourceManager {
         public:
             bool mRunning;
             Mutex mMutex;
-            Mutex mStateMutex;
+            std::shared_mutex mStateMutex;
             Mutex mResInfoMutex;
             uint32_t mBufXres;
             uint32_t mBufYres;
@@ -102,8 +108,8 @@ class ExynosResourceManager {
     public:
         uint32_t mForceReallocState;
         ExynosDevice *mDevice;
-        bool hasHdrLayer;
-        bool hasDrmLayer;
+        std::atomic<bool> hasHdrLayer;
+        std::atomic<bool> hasDrmLayer;
         bool isHdrExternal;
 
         uint32_t mFormatRestrictionCnt;
@@ -123,6 +129,7 @@ class ExynosResourceManager {
         int32_t doAllocDstBufs(uint32_t mXres, uint32_t mYres);
         int32_t assignResource(ExynosDisplay *display);
         int32_t assignResourceInternal(ExynosDisplay *display);
+        int32_t preValidateAssignment(ExynosDisplay *display);
         static ExynosMPP* getExynosMPP(uint32_t type);
         static ExynosMPP* getExynosMPP(uint32_t physicalType, uint32_t physicalIndex);
         static void enableMPP(uint32_t physicalType, uint32_t physicalIndex, uint32_t logicalIndex, uint32_t enable);
@@ -148,7 +155,7 @@ class ExynosResourceManager {
                 exynos_image &m2m_out_img, ExynosMPP **m2mMPP, ExynosMPP **otfMPP, uint32_t &overlayInfo);
         virtual int32_t assignWindow(ExynosDisplay *display);
         virtual int32_t checkScenario(ExynosDisplay *display);
-        int32_t updateResourceState();
+        int32_t updateResourceState(ExynosDisplay *display = nullptr);
         static float getResourceUsedCapa(ExynosMPP &mpp);
         int32_t updateExynosComposition(ExynosDisplay *display);
         int32_t updateClientComposition(ExynosDisplay *display);
@@ -156,7 +163,9 @@ class ExynosResourceManager {
                 ExynosLayer *layer, std::vector<exynos_image> &image_lists);
         int32_t setResourcePriority(ExynosDisplay *display);
         int32_t deliverPerformanceInfo();
+        int32_t deliverPerformanceInfo(ExynosDisplay *display);
         int32_t prepareResources(const int32_t willOnDispId = -1);
+        int32_t prepareResourcesForPowerOn(ExynosDisplay *display);
         int32_t finishAssignResourceWork();
         int32_t initResourcesState(ExynosDisplay *display);
 
@@ -181,6 +190,19 @@ class ExynosResourceManager {
         virtual bool hasHDR10PlusMPP();
         float getAssignedCapacity(uint32_t physicalType);
 
+        /*
+         * With ro.vendor.display.mpp_partition every display owns a partition
+         * of the MPPs between rebalancing points, see ResourcePartition.h.
+         * Resource assignment, performance info and MPP processing of a
+         * display then run under a lease instead of serializing with the
+         * other displays. Modules with cross display TDM accounting should
+         * keep it off.
+         */
+        bool isPartitioned() const { return mPartition != nullptr; }
+        ResourcePartition::Lease acquirePartitionLease(ExynosDisplay *display, bool newFrame);
+        void finishPartitionFrame(ExynosDisplay *display);
+        uint64_t getGeometryChanged(ExynosDisplay *display);
+
         void dump(String8 &result) const;
         void setM2MCapa(uint32_t physicalType, uint32_t capa);
         virtual bool isAssignable(ExynosMPP* candidateMPP, ExynosDisplay* display,
@@ -192,9 +214,22 @@ class ExynosResourceManager {
                                               uint32_t layer_index, const exynos_image& m2m_out_img,
                                               ExynosMPP* m2mMPP, ExynosMPP* otfMPP);
         void dump(const restriction_classification_t, String8 &result) const;
+        bool setPerformanceFrame(ExynosMPP &mpp, AcrylicPerformanceRequestFrame *frame);
+
+        ExynosMPP *getPartitionMPP(size_t slot) const;
+        bool isPartitionActive(ExynosDisplay *display) const;
+        int32_t rebalancePartition(ExynosDisplay *display);
+        void updatePartitionDemand(ExynosDisplay *display);
 
         sp<DstBufMgrThread> mDstBufMgrThread;
 
+        std::unique_ptr<ResourcePartition> mPartition;
+        /* Device changes whose prepareResources() waits for the frames in flight */
+        std::atomic<uint64_t> mPendingPrepare = 0;
+        std::mutex mPerformanceMutex;
+        std::map<uint32_t, std::vector<std::unique_ptr<AcrylicPerformanceRequestFrame>>>
+                mPerformanceFrames;
+
     protected:
         virtual void setFrameRateForPerformance(ExynosMPP &mpp, AcrylicPerformanceRequestFrame *frame);
         void getCandidateScalingM2mMPPOutImages(const ExynosDisplay *display,
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ResourcePartition.h"
+
+#include <algorithm>
+
+ResourcePartition::ResourcePartition(std::vector<uint32_t> slotPools) {
+    for (auto pool : slotPools) {
+        mSlots.push_back({.pool = pool});
+        mPools.insert(pool);
+    }
+}
+
+void ResourcePartition::beginFrame(int32_t displayId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mInFlight.insert(displayId);
+}
+
+void ResourcePartition::endFrame(int32_t displayId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mInFlight.erase(displayId);
+}
+
+bool ResourcePartition::hasFrameInFlight(int32_t exceptDisplayId) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto id : mInFlight) {
+        if (id != exceptDisplayId) return true;
+    }
+    return false;
+}
+
+void ResourcePartition::setDemand(int32_t displayId, uint32_t pool, uint32_t demand) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mDemand[{displayId, pool}] = demand;
+}
+
+uint32_t ResourcePartition::getDemand(int32_t displayId, uint32_t pool) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mDemand.find({displayId, pool});
+    return (it == mDemand.end()) ? 0 : it->second;
+}
+
+/* Every active display wants at least one slot of each pool */
+uint32_t ResourcePartition::getWantLocked(int32_t displayId, uint32_t pool) const {
+    auto it = mDemand.find({displayId, pool});
+    return (it == mDemand.end()) ? 1 : std::max(it->second, 1u);
+}
+
+bool ResourcePartition::needsRebalance(int32_t displayId) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mActive.count(displayId) == 0) return true;
+
+    for (auto pool : mPools) {
+        auto ownedIt = mOwned.find({displayId, pool});
+        uint32_t owned = (ownedIt == mOwned.end()) ? 0 : ownedIt->second;
+        if (owned >= getWantLocked(displayId, pool)) continue;
+
+        /* Is there a slot another display can give up? */
+        std::map<int32_t, uint32_t> pinned;
+        for (const auto &slot : mSlots) {
+            if (slot.pool != pool) continue;
+            if (slot.pinned != kNoDisplay) {
+                pinned[slot.pinned]++;
+            } else if ((slot.owner == kNoDisplay) || (mActive.count(slot.owner) == 0)) {
+                return true;
+            }
+        }
+        for (const auto &[key, count] : mOwned) {
+            if ((key.second != pool) || (key.first == displayId)) continue;
+            uint32_t floor = std::max(getWantLocked(key.first, pool), pinned[key.first]);
+            if (count > floor) return true;
+        }
+    }
+    return false;
+}
+
+bool ResourcePartition::isStale(int32_t displayId) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mStale.count(displayId)) return true;
+    auto it = mAssignedGeneration.find(displayId);
+    return (it == mAssignedGeneration.end()) || (it->second != mGeneration);
+}
+
+void ResourcePartition::clearStale(int32_t displayId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStale.erase(displayId);
+    mAssignedGeneration[displayId] = mGeneration;
+}
+
+void ResourcePartition::addChanges(const std::vector<int32_t> &displayIds, uint64_t changes) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto displayId : displayIds) mChanges[displayId] |= changes;
+}
+
+uint64_t ResourcePartition::getChanges(int32_t displayId) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mChanges.find(displayId);
+    return (it == mChanges.end()) ? 0 : it->second;
+}
+
+void ResourcePartition::clearChanges(int32_t displayId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mChanges.erase(displayId);
+}
+
+void ResourcePartition::setPinned(size_t slot, int32_t displayId) {
+    if (slot >= mSlots.size()) return;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSlots[slot].pinned = displayId;
+    if (mSlots[slot].owner != displayId) {
+        if (mSlots[slot].owner != kNoDisplay) mStale.insert(mSlots[slot].owner);
+        if (displayId != kNoDisplay) mStale.insert(displayId);
+        mSlots[slot].owner = displayId;
+    }
+    updateOwnedLocked();
+}
+
+void ResourcePartition::reset() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto &slot : mSlots) {
+        slot.pinned = kNoDisplay;
+        slot.owner = kNoDisplay;
+    }
+    mGeneration++;
+    updateOwnedLocked();
+}
+
+/*
+ * Movable slots each active display should own: one for every display
+ * without a pinned slot, then the unmet demand, scaled down by the largest
+ * remainder method if the pool is short. Anything left over goes to the
+ * display with the largest demand.
+ */
+std::map<int32_t, uint32_t> ResourcePartition::computeTargetsLocked(
+        uint32_t pool, const std::vector<int32_t> &active) const {
+    std::map<int32_t, uint32_t> targets;
+    std::map<int32_t, uint32_t> pinned;
+    uint32_t remaining = 0;
+    for (const auto &slot : mSlots) {
+        if (slot.pool != pool) continue;
+        if (slot.pinned != kNoDisplay)
+            pinned[slot.pinned]++;
+        else
+            remaining++;
+    }
+
+    for (auto id : active) {
+        targets[id] = 0;
+        if ((pinned[id] == 0) && (remaining > 0)) {
+            targets[id] = 1;
+            remaining--;
+        }
+    }
+
+    std::map<int32_t, uint32_t> wants;
+    uint32_t totalWant = 0;
+    for (auto id : active) {
+        uint32_t have = pinned[id] + targets[id];
+        uint32_t want = getWantLocked(id, pool);
+        wants[id] = (want > have) ? (want - have) : 0;
+        totalWant += wants[id];
+    }
+
+    if (totalWant <= remaining) {
+        for (auto id : active) targets[id] += wants[id];
+        remaining -= totalWant;
+    } else if (totalWant > 0) {
+        std::vector<std::pair<uint64_t, int32_t>> remainders;
+        uint32_t given = 0;
+        for (auto id : active) {
+            uint64_t scaled = static_cast<uint64_t>(wants[id]) * remaining;
+            targets[id] += scaled / totalWant;
+            given += scaled / totalWant;
+            remainders.push_back({scaled % totalWant, id});
+        }
+        std::stable_sort(remainders.begin(), remainders.end(),
+                         [](const auto &a, const auto &b) { return a.first > b.first; });
+        remaining -= given;
+        for (size_t i = 0; (i < remainders.size()) && (remaining > 0); i++, remaining--)
+            targets[remainders[i].second]++;
+    }
+
+    if ((remaining > 0) && !active.empty()) {
+        int32_t largest = active[0];
+        for (auto id : active) {
+            if (getWantLocked(id, pool) > getWantLocked(largest, pool)) largest = id;
+        }
+        targets[largest] += remaining;
+    }
+    return targets;
+}
+
+std::vector<size_t> ResourcePartition::rebalance(int32_t displayId,
+                                                 const std::vector<int32_t> &active,
+                                                 const std::vector<int32_t> &users) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<size_t> changed;
+
+    mActive = std::set<int32_t>(active.begin(), active.end());
+    for (auto it = mInFlight.begin(); it != mInFlight.end();) {
+        if (mActive.count(*it) == 0)
+            it = mInFlight.erase(it);
+        else
+            it++;
+    }
+
+    for (auto pool : mPools) {
+        std::map<int32_t, uint32_t> targets = computeTargetsLocked(pool, active);
+        std::map<int32_t, uint32_t> kept;
+        std::vector<size_t> freeSlots;
+
+        for (size_t i = 0; i < mSlots.size(); i++) {
+            Slot &slot = mSlots[i];
+            if ((slot.pool != pool) || (slot.pinned != kNoDisplay)) continue;
+
+            /* The frame of another display is still using it */
+            bool busy = (slot.owner != kNoDisplay) && (slot.owner != displayId) &&
+                    (i < users.size()) && (users[i] == slot.owner) &&
+                    mInFlight.count(slot.owner);
+            auto target = targets.find(slot.owner);
+            if (busy || ((target != targets.end()) && (kept[slot.owner] < target->second))) {
+                kept[slot.owner]++;
+                continue;
+            }
+            freeSlots.push_back(i);
+        }
+
+        for (auto i : freeSlots) {
+            int32_t owner = kNoDisplay;
+            uint32_t deficit = 0;
+            /* Largest deficit first, the first active display on ties */
+            for (auto id : active) {
+                uint32_t missing = (targets[id] > kept[id]) ? (targets[id] - kept[id]) : 0;
+                if (missing > deficit) {
+                    deficit = missing;
+                    owner = id;
+                }
+            }
+            if (owner != kNoDisplay) kept[owner]++;
+
+            Slot &slot = mSlots[i];
+            if (slot.owner == owner) continue;
+            if (slot.owner != kNoDisplay) mStale.insert(slot.owner);
+            if (owner != kNoDisplay) mStale.insert(owner);
+            slot.owner = owner;
+            changed.push_back(i);
+        }
+
+        for (auto id : active) {
+            if (targets[id] > kept[id]) mDeferredCount += targets[id] - kept[id];
+        }
+    }
+
+    mRebalanceCount++;
+    mMovedCount += changed.size();
+    updateOwnedLocked();
+    return changed;
+}
+
+uint32_t ResourcePartition::getOwnedCount(int32_t displayId, uint32_t pool) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mOwned.find({displayId, pool});
+    return (it == mOwned.end()) ? 0 : it->second;
+}
+
+void ResourcePartition::updateOwnedLocked() {
+    mOwned.clear();
+    for (const auto &slot : mSlots) {
+        if (slot.owner != kNoDisplay) mOwned[{slot.owner, slot.pool}]++;
+    }
+}
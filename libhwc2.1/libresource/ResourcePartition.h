@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESOURCE_PARTITION_H_
+#define _RESOURCE_PARTITION_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <vector>
+
+/*
+ * Ownership of the MPPs between resource rebalancing points.
+ *
+ * Every slot (one per MPP) is owned by at most one display. A display only
+ * assigns the slots it owns, so displays can run resource assignment and
+ * present in parallel while holding a shared lease. Rebalancing takes the
+ * lease exclusively and is the only place where ownership changes.
+ *
+ * Slots are grouped in pools (OTF and M2M) and shared out per pool in
+ * proportion to the demand each display reported, with at least one slot for
+ * every active display. Pinned slots (pre-assigned MPPs) never move. A slot
+ * that is used by the frame another display is presenting keeps its owner
+ * until that frame is done.
+ */
+class ResourcePartition {
+public:
+    static constexpr int32_t kNoDisplay = -1;
+
+    using Lease = std::shared_lock<std::shared_mutex>;
+    using RebalanceLock = std::unique_lock<std::shared_mutex>;
+
+    explicit ResourcePartition(std::vector<uint32_t> slotPools);
+
+    Lease acquireLease() { return Lease(mGate); }
+    RebalanceLock lockForRebalance() { return RebalanceLock(mGate); }
+
+    /* A frame is in flight from its resource assignment until its present */
+    void beginFrame(int32_t displayId);
+    void endFrame(int32_t displayId);
+    bool hasFrameInFlight(int32_t exceptDisplayId) const;
+
+    void setDemand(int32_t displayId, uint32_t pool, uint32_t demand);
+    uint32_t getDemand(int32_t displayId, uint32_t pool) const;
+    /*
+     * Whether the display should rebalance before its next assignment: it
+     * owns nothing in a pool, or it wants more slots than it owns while
+     * another display owns more than it wants.
+     */
+    bool needsRebalance(int32_t displayId) const;
+
+    /* The slots of the display changed since its last assignment */
+    bool isStale(int32_t displayId) const;
+    void clearStale(int32_t displayId);
+
+    /*
+     * Device level changes a display has not assigned for yet. A rebalance
+     * hands them to every display, and each display clears its own once it
+     * has assigned, independently of the others.
+     */
+    void addChanges(const std::vector<int32_t> &displayIds, uint64_t changes);
+    uint64_t getChanges(int32_t displayId) const;
+    void clearChanges(int32_t displayId);
+
+    /* The calls below need the RebalanceLock */
+    void setPinned(size_t slot, int32_t displayId);
+    /* Drops every owner and pin, after the MPPs were reset */
+    void reset();
+    /*
+     * Shares the slots out between the active displays. users[i] is the
+     * display whose assignment currently uses slot i, or kNoDisplay.
+     * Returns the slots whose owner changed.
+     */
+    std::vector<size_t> rebalance(int32_t displayId, const std::vector<int32_t> &active,
+                                  const std::vector<int32_t> &users);
+
+    /* Owners are only written under the RebalanceLock, reads need a lease */
+    size_t getSlotCount() const { return mSlots.size(); }
+    uint32_t getPool(size_t slot) const { return mSlots[slot].pool; }
+    int32_t getOwner(size_t slot) const { return mSlots[slot].owner; }
+    bool isPinned(size_t slot) const { return mSlots[slot].pinned != kNoDisplay; }
+    uint32_t getOwnedCount(int32_t displayId, uint32_t pool) const;
+
+    uint64_t getRebalanceCount() const { return mRebalanceCount; }
+    uint64_t getMovedCount() const { return mMovedCount; }
+    uint64_t getDeferredCount() const { return mDeferredCount; }
+
+private:
+    struct Slot {
+        uint32_t pool;
+        int32_t pinned = kNoDisplay;
+        int32_t owner = kNoDisplay;
+    };
+
+    uint32_t getWantLocked(int32_t displayId, uint32_t pool) const;
+    std::map<int32_t, uint32_t> computeTargetsLocked(uint32_t pool,
+                                                     const std::vector<int32_t> &active) const;
+    void updateOwnedLocked();
+
+    std::shared_mutex mGate;
+    std::vector<Slot> mSlots;
+    std::set<uint32_t> mPools;
+
+    /* Guards the per display state below, which changes under a shared lease */
+    mutable std::mutex mMutex;
+    std::set<int32_t> mInFlight;
+    std::set<int32_t> mActive;
+    std::set<int32_t> mStale;
+    std::map<int32_t, uint64_t> mChanges;
+    uint64_t mGeneration = 0;
+    std::map<int32_t, uint64_t> mAssignedGeneration;
+    std::map<std::pair<int32_t, uint32_t>, uint32_t> mDemand;
+    std::map<std::pair<int32_t, uint32_t>, uint32_t> mOwned;
+
+    uint64_t mRebalanceCount = 0;
+    uint64_t mMovedCount = 0;
+    uint64_t mDeferredCount = 0;
+};
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ExynosDeviceModule.h"
+#include "ExynosDisplay.h"
+#include "ExynosLayer.h"
+#include "ExynosResourceManager.h"
+
+using namespace android;
+using namespace SOC_VERSION;
+
+namespace {
+
+/*
+ * Runs the partitioned MPP assignment of ExynosResourceManager on the displays
+ * of a real ExynosDevice, the way validateDisplay() and presentDisplay() call
+ * it. It needs ro.vendor.display.mpp_partition and the composer service
+ * stopped, as it opens the displays itself.
+ */
+class ResourceManagerPartitionTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t kLayers = 3;
+
+    void SetUp() override {
+        mDevice = std::make_unique<ExynosDeviceModule>(false);
+        mResourceManager = mDevice->mResourceManager;
+        if (!mResourceManager->isPartitioned())
+            GTEST_SKIP() << "ro.vendor.display.mpp_partition is not set";
+
+        for (size_t i = 0; i < mDevice->mDisplays.size(); i++) {
+            ExynosDisplay *display = mDevice->mDisplays[i];
+            if ((display->mType == HWC_DISPLAY_VIRTUAL) || (mDisplays.size() == 2))
+                continue;
+            display->mPlugState = true;
+            display->mPowerModeState = HWC2_POWER_MODE_ON;
+            addLayers(display);
+            mDisplays.push_back(display);
+        }
+        if (mDisplays.size() < 2) GTEST_SKIP() << "needs two physical displays";
+    }
+
+    void TearDown() override {
+        for (auto *display : mDisplays) {
+            for (auto layer : mLayers[display]) display->destroyLayer(layer);
+            display->mPowerModeState = HWC2_POWER_MODE_OFF;
+        }
+    }
+
+    /* Layers without a buffer, so the client target needs an OTF MPP */
+    void addLayers(ExynosDisplay *display) {
+        for (uint32_t i = 0; i < kLayers; i++) {
+            hwc2_layer_t id;
+            ASSERT_EQ(HWC2_ERROR_NONE, display->createLayer(&id));
+            ExynosLayer *layer = display->checkLayer(id);
+            ASSERT_NE(nullptr, layer);
+            layer->setLayerCompositionType(HWC2_COMPOSITION_DEVICE);
+            layer->setLayerZOrder(i);
+            layer->setLayerDisplayFrame({0, 0, static_cast<int>(display->mXres),
+                                         static_cast<int>(display->mYres)});
+            layer->setLayerSourceCrop({0.0f, 0.0f, static_cast<float>(display->mXres),
+                                       static_cast<float>(display->mYres)});
+            mLayers[display].push_back(id);
+        }
+    }
+
+    /* Every MPP the display assigned is one it owns */
+    int countForeignMPPs(ExynosDisplay *display) {
+        int foreign = 0;
+        auto check = [&](ExynosMPP *mpp) {
+            if ((mpp->mAssignedDisplay == display) &&
+                (mpp->mReservedDisplay != static_cast<int32_t>(display->mDisplayId)))
+                foreign++;
+        };
+        for (uint32_t i = 0; i < mResourceManager->getOtfMPPSize(); i++)
+            check(mResourceManager->getOtfMPP(i));
+        for (uint32_t i = 0; i < mResourceManager->getM2mMPPSize(); i++)
+            check(mResourceManager->getM2mMPP(i));
+        return foreign;
+    }
+
+    /* What validateDisplay() does for the resources, the frame stays in flight */
+    int32_t validate(ExynosDisplay *display) {
+        Mutex::Autolock lock(display->getDisplayMutex());
+        auto lease = mResourceManager->acquirePartitionLease(display, true);
+        int32_t ret = mResourceManager->assignResource(display);
+        mForeign += countForeignMPPs(display);
+        display->clearGeometryChanged();
+        return ret;
+    }
+
+    /* What presentDisplay() does for the resources */
+    void present(ExynosDisplay *display) {
+        Mutex::Autolock lock(display->getDisplayMutex());
+        auto lease = mResourceManager->acquirePartitionLease(display, false);
+        mForeign += countForeignMPPs(display);
+        if (display->mClientCompositionInfo.mHasCompositionLayer &&
+            (display->mClientCompositionInfo.mOtfMPP == nullptr))
+            mMissingTarget++;
+        mResourceManager->finishPartitionFrame(display);
+    }
+
+    std::unique_ptr<ExynosDevice> mDevice;
+    ExynosResourceManager *mResourceManager = nullptr;
+    std::vector<ExynosDisplay *> mDisplays;
+    std::map<ExynosDisplay *, std::vector<hwc2_layer_t>> mLayers;
+    std::atomic<int> mForeign = 0;
+    std::atomic<int> mMissingTarget = 0;
+};
+
+TEST_F(ResourceManagerPartitionTest, ParallelDisplaysUseTheirOwnMPPs) {
+    constexpr int kFrames = 2000;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < mDisplays.size(); i++) {
+        threads.emplace_back([this, i] {
+            ExynosDisplay *display = mDisplays[i];
+            std::mt19937 random(i);
+            for (int frame = 0; frame < kFrames; frame++) {
+                display->setGeometryChanged(GEOMETRY_LAYER_DISPLAYFRAME_CHANGED);
+                if ((random() % 100) == 0)
+                    mDevice->setGeometryChanged(GEOMETRY_DEVICE_CONFIG_CHANGED);
+                EXPECT_EQ(NO_ERROR, validate(display));
+                std::this_thread::yield();
+                present(display);
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    EXPECT_EQ(0, mForeign);
+    EXPECT_EQ(0, mMissingTarget);
+}
+
+TEST_F(ResourceManagerPartitionTest, DeviceChangeIsClearedPerDisplay) {
+    ExynosDisplay *first = mDisplays[0];
+    ExynosDisplay *second = mDisplays[1];
+    /* Until the partition settled and neither display needs to reassign */
+    for (auto *display : mDisplays)
+        display->setGeometryChanged(GEOMETRY_LAYER_DISPLAYFRAME_CHANGED);
+    bool settled = false;
+    for (int round = 0; (round < 10) && !settled; round++) {
+        for (auto *display : mDisplays) {
+            ASSERT_EQ(NO_ERROR, validate(display));
+            present(display);
+        }
+        settled = (mResourceManager->getGeometryChanged(first) == 0) &&
+                (mResourceManager->getGeometryChanged(second) == 0);
+    }
+    ASSERT_TRUE(settled);
+
+    /* The second display has a frame in flight, resources can't be prepared */
+    ASSERT_EQ(NO_ERROR, validate(second));
+    mDevice->setGeometryChanged(GEOMETRY_DEVICE_CONFIG_CHANGED);
+    EXPECT_NE(0u, mResourceManager->getGeometryChanged(first));
+
+    /* The first display reassigns once, not on every frame */
+    ASSERT_EQ(NO_ERROR, validate(first));
+    present(first);
+    EXPECT_EQ(0u, mResourceManager->getGeometryChanged(first));
+    EXPECT_NE(0u, mResourceManager->getGeometryChanged(second));
+    for (int frame = 0; frame < 3; frame++) {
+        ASSERT_EQ(NO_ERROR, validate(first));
+        present(first);
+        EXPECT_EQ(0u, mResourceManager->getGeometryChanged(first));
+    }
+
+    /* Once the second display presented, the pending prepare runs */
+    present(second);
+    ASSERT_EQ(NO_ERROR, validate(first));
+    present(first);
+    EXPECT_EQ(0u, mResourceManager->getGeometryChanged(first));
+    EXPECT_NE(0u, mResourceManager->getGeometryChanged(second));
+    ASSERT_EQ(NO_ERROR, validate(second));
+    present(second);
+    EXPECT_EQ(0u, mResourceManager->getGeometryChanged(second));
+    EXPECT_EQ(0, mForeign);
+}
+
+} // namespace
@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "ResourcePartition.h"
+
+namespace {
+
+constexpr uint32_t kOtfPool = 0;
+constexpr uint32_t kM2mPool = 1;
+constexpr int32_t kNone = ResourcePartition::kNoDisplay;
+
+std::vector<uint32_t> makePools(size_t otf, size_t m2m) {
+    std::vector<uint32_t> pools(otf, kOtfPool);
+    pools.insert(pools.end(), m2m, kM2mPool);
+    return pools;
+}
+
+uint32_t countOwned(ResourcePartition &partition, int32_t displayId, uint32_t pool) {
+    uint32_t count = 0;
+    for (size_t i = 0; i < partition.getSlotCount(); i++) {
+        if ((partition.getPool(i) == pool) && (partition.getOwner(i) == displayId)) count++;
+    }
+    EXPECT_EQ(count, partition.getOwnedCount(displayId, pool));
+    return count;
+}
+
+TEST(ResourcePartitionTest, SharesSlotsByDemand) {
+    ResourcePartition partition(makePools(8, 0));
+    partition.setDemand(0, kOtfPool, 6);
+    partition.setDemand(1, kOtfPool, 2);
+
+    auto lock = partition.lockForRebalance();
+    partition.rebalance(0, {0, 1}, std::vector<int32_t>(8, kNone));
+    EXPECT_EQ(6u, countOwned(partition, 0, kOtfPool));
+    EXPECT_EQ(2u, countOwned(partition, 1, kOtfPool));
+}
+
+TEST(ResourcePartitionTest, ScalesDownWhenShort) {
+    ResourcePartition partition(makePools(6, 0));
+    partition.setDemand(0, kOtfPool, 9);
+    partition.setDemand(1, kOtfPool, 3);
+
+    auto lock = partition.lockForRebalance();
+    partition.rebalance(0, {0, 1}, std::vector<int32_t>(6, kNone));
+    /* One each, then the other four split 8:2 by the largest remainder */
+    EXPECT_EQ(4u, countOwned(partition, 0, kOtfPool));
+    EXPECT_EQ(2u, countOwned(partition, 1, kOtfPool));
+}
+
+TEST(ResourcePartitionTest, EveryActiveDisplayGetsASlot) {
+    ResourcePartition partition(makePools(4, 0));
+    partition.setDemand(0, kOtfPool, 10);
+
+    auto lock = partition.lockForRebalance();
+    partition.rebalance(0, {0, 1, 2}, std::vector<int32_t>(4, kNone));
+    EXPECT_EQ(2u, countOwned(partition, 0, kOtfPool));
+    EXPECT_EQ(1u, countOwned(partition, 1, kOtfPool));
+    EXPECT_EQ(1u, countOwned(partition, 2, kOtfPool));
+}
+
+TEST(ResourcePartitionTest, PinnedSlotsNeverMove) {
+    ResourcePartition partition(makePools(4, 2));
+    auto lock = partition.lockForRebalance();
+    partition.setPinned(4, 1);
+    partition.setDemand(0, kM2mPool, 4);
+    partition.rebalance(0, {0, 1}, std::vector<int32_t>(6, kNone));
+
+    EXPECT_EQ(1, partition.getOwner(4));
+    EXPECT_TRUE(partition.isPinned(4));
+    /* Display 1 has its pinned slot, so the movable one goes to display 0 */
+    EXPECT_EQ(0, partition.getOwner(5));
+}
+
+TEST(ResourcePartitionTest, KeepsSlotsOfFramesInFlight) {
+    ResourcePartition partition(makePools(4, 0));
+    {
+        auto lock = partition.lockForRebalance();
+        partition.setDemand(0, kOtfPool, 3);
+        partition.setDemand(1, kOtfPool, 1);
+        partition.rebalance(0, {0, 1}, std::vector<int32_t>(4, kNone));
+    }
+    ASSERT_EQ(3u, countOwned(partition, 0, kOtfPool));
+
+    /* Display 0 is presenting with all of its slots when display 1 wants more */
+    std::vector<int32_t> users(4, kNone);
+    for (size_t i = 0; i < 4; i++) {
+        if (partition.getOwner(i) == 0) users[i] = 0;
+    }
+    partition.beginFrame(0);
+    partition.setDemand(0, kOtfPool, 1);
+    partition.setDemand(1, kOtfPool, 3);
+    EXPECT_TRUE(partition.needsRebalance(1));
+    {
+        auto lock = partition.lockForRebalance();
+        EXPECT_TRUE(partition.rebalance(1, {0, 1}, users).empty());
+    }
+    EXPECT_EQ(3u, countOwned(partition, 0, kOtfPool));
+    EXPECT_EQ(2u, partition.getDeferredCount());
+
+    partition.endFrame(0);
+    EXPECT_TRUE(partition.needsRebalance(1));
+    {
+        auto lock = partition.lockForRebalance();
+        EXPECT_EQ(2u, partition.rebalance(1, {0, 1}, users).size());
+    }
+    EXPECT_EQ(1u, countOwned(partition, 0, kOtfPool));
+    EXPECT_EQ(3u, countOwned(partition, 1, kOtfPool));
+    EXPECT_FALSE(partition.needsRebalance(1));
+}
+
+TEST(ResourcePartitionTest, NeedsRebalanceOnlyWhenSlotsCanMove) {
+    ResourcePartition partition(makePools(2, 0));
+    partition.setDemand(0, kOtfPool, 5);
+    partition.setDemand(1, kOtfPool, 5);
+    EXPECT_TRUE(partition.needsRebalance(0));
+    {
+        auto lock = partition.lockForRebalance();
+        partition.rebalance(0, {0, 1}, std::vector<int32_t>(2, kNone));
+    }
+    /* Both want more, but neither has a slot to spare */
+    EXPECT_FALSE(partition.needsRebalance(0));
+    EXPECT_FALSE(partition.needsRebalance(1));
+    /* A display that was not active when the slots were shared out */
+    EXPECT_TRUE(partition.needsRebalance(2));
+}
+
+TEST(ResourcePartitionTest, StaleUntilAssigned) {
+    ResourcePartition partition(makePools(2, 0));
+    EXPECT_TRUE(partition.isStale(0));
+    {
+        auto lock = partition.lockForRebalance();
+        partition.rebalance(0, {0}, std::vector<int32_t>(2, kNone));
+    }
+    partition.clearStale(0);
+    EXPECT_FALSE(partition.isStale(0));
+
+    {
+        auto lock = partition.lockForRebalance();
+        partition.rebalance(1, {0, 1}, std::vector<int32_t>(2, kNone));
+    }
+    EXPECT_TRUE(partition.isStale(0));
+    EXPECT_TRUE(partition.isStale(1));
+    partition.clearStale(0);
+
+    {
+        auto lock = partition.lockForRebalance();
+        partition.reset();
+    }
+    EXPECT_TRUE(partition.isStale(0));
+}
+
+TEST(ResourcePartitionTest, ChangesAreClearedPerDisplay) {
+    ResourcePartition partition(makePools(2, 0));
+    partition.addChanges({0, 1}, 0x4);
+    partition.addChanges({0}, 0x10);
+    EXPECT_EQ(0x14u, partition.getChanges(0));
+    EXPECT_EQ(0x4u, partition.getChanges(1));
+
+    partition.clearChanges(0);
+    EXPECT_EQ(0u, partition.getChanges(0));
+    EXPECT_EQ(0x4u, partition.getChanges(1));
+    EXPECT_EQ(0u, partition.getChanges(2));
+}
+
+/*
+ * Fake display interface. It follows the protocol of the resource manager:
+ * rebalance when needed, assign its own slots under a lease, then present
+ * them under a lease, and checks that no other display touches its slots in
+ * between.
+ */
+class FakeDisplay {
+public:
+    FakeDisplay(int32_t id, ResourcePartition &partition, std::vector<std::atomic<int32_t>> &mpps,
+                std::vector<std::atomic<bool>> &power)
+          : mId(id), mPartition(partition), mMpps(mpps), mPower(power), mRandom(id) {}
+
+    void run(int frames) {
+        for (int frame = 0; frame < frames; frame++) {
+            if ((mId != 0) && ((mRandom() % 50) == 0)) {
+                /* Power cycle. The slots of a display that is off can move any time */
+                mPower[mId] = false;
+                std::this_thread::yield();
+                mPower[mId] = true;
+            }
+            if ((mRandom() % 8) == 0) {
+                mPartition.setDemand(mId, kOtfPool, mRandom() % 7);
+                mPartition.setDemand(mId, kM2mPool, mRandom() % 3);
+            }
+            validate();
+            std::this_thread::yield();
+            present();
+        }
+    }
+
+    int errors() const { return mErrors; }
+    int frames() const { return mFrames; }
+
+private:
+    std::vector<int32_t> activeDisplays() {
+        std::vector<int32_t> active;
+        for (size_t i = 0; i < mPower.size(); i++) {
+            if (mPower[i] || (static_cast<int32_t>(i) == mId)) active.push_back(i);
+        }
+        return active;
+    }
+
+    void validate() {
+        if (mPartition.needsRebalance(mId)) {
+            auto lock = mPartition.lockForRebalance();
+            std::vector<int32_t> users;
+            for (auto &mpp : mMpps) users.push_back(mpp.load());
+            for (auto slot : mPartition.rebalance(mId, activeDisplays(), users)) {
+                /* Like resetMPP(). It must never hit a frame that is in flight */
+                int32_t user = mMpps[slot].exchange(kNone);
+                if ((user != kNone) && (user != mId) && mPower[user]) {
+                    std::lock_guard<std::mutex> inFlightLock(sInFlightMutex);
+                    if (sInFlight.count(user)) mErrors++;
+                }
+            }
+        }
+
+        auto lease = mPartition.acquireLease();
+        mPartition.beginFrame(mId);
+        {
+            std::lock_guard<std::mutex> inFlightLock(sInFlightMutex);
+            sInFlight.insert(mId);
+        }
+        mAssigned.clear();
+        for (size_t i = 0; i < mMpps.size(); i++) {
+            if (mMpps[i] == mId) mMpps[i] = kNone;
+        }
+        for (size_t i = 0; i < mMpps.size(); i++) {
+            if (mPartition.getOwner(i) != mId) continue;
+            int32_t expected = kNone;
+            if (!mMpps[i].compare_exchange_strong(expected, mId)) {
+                /* Another display assigned a slot this display owns */
+                mErrors++;
+                continue;
+            }
+            mAssigned.push_back(i);
+        }
+        mPartition.clearStale(mId);
+    }
+
+    void present() {
+        auto lease = mPartition.acquireLease();
+        for (auto slot : mAssigned) {
+            if ((mPartition.getOwner(slot) != mId) || (mMpps[slot] != mId)) mErrors++;
+        }
+        mFrames++;
+        {
+            std::lock_guard<std::mutex> inFlightLock(sInFlightMutex);
+            sInFlight.erase(mId);
+        }
+        mPartition.endFrame(mId);
+    }
+
+    const int32_t mId;
+    ResourcePartition &mPartition;
+    std::vector<std::atomic<int32_t>> &mMpps;
+    std::vector<std::atomic<bool>> &mPower;
+    std::mt19937 mRandom;
+    std::vector<size_t> mAssigned;
+    int mErrors = 0;
+    int mFrames = 0;
+
+    static std::mutex sInFlightMutex;
+    static std::set<int32_t> sInFlight;
+};
+
+std::mutex FakeDisplay::sInFlightMutex;
+std::set<int32_t> FakeDisplay::sInFlight;
+
+TEST(ResourcePartitionTest, StressParallelDisplays) {
+    constexpr int kDisplays = 3;
+    constexpr int kFrames = 20000;
+    std::vector<uint32_t> pools = makePools(8, 3);
+    ResourcePartition partition(pools);
+    std::vector<std::atomic<int32_t>> mpps(pools.size());
+    for (auto &mpp : mpps) mpp = kNone;
+    std::vector<std::atomic<bool>> power(kDisplays);
+    for (auto &on : power) on = true;
+
+    {
+        auto lock = partition.lockForRebalance();
+        /* The first M2M slot is pre-assigned to the primary display */
+        partition.setPinned(8, 0);
+    }
+
+    std::vector<std::unique_ptr<FakeDisplay>> displays;
+    for (int i = 0; i < kDisplays; i++)
+        displays.push_back(std::make_unique<FakeDisplay>(i, partition, mpps, power));
+
+    std::vector<std::thread> threads;
+    for (auto &display : displays)
+        threads.emplace_back([&display] { display->run(kFrames); });
+    for (auto &thread : threads) thread.join();
+
+    for (auto &display : displays) {
+        EXPECT_EQ(0, display->errors());
+        EXPECT_EQ(kFrames, display->frames());
+    }
+    EXPECT_EQ(0, partition.getOwner(8));
+    EXPECT_GT(partition.getRebalanceCount(), 0u);
+}
+
+} // namespace
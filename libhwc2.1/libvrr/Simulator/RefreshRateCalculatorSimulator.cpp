@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RefreshRateCalculatorSimulator.h"
+
+#include <hardware/hwcomposer_defs.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <sstream>
+
+namespace android::hardware::graphics::composer {
+
+namespace {
+
+int64_t getThreadCpuTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * std::nano::den + ts.tv_nsec;
+}
+
+} // namespace
+
+double SimulationReport::getAccuracy() const {
+    if (mScoredDurationNs == 0) {
+        return 0;
+    }
+    return static_cast<double>(mAccurateDurationNs) / mScoredDurationNs;
+}
+
+double SimulationReport::getMeanAbsoluteErrorHz() const {
+    if (mScoredDurationNs == 0) {
+        return 0;
+    }
+    return mAbsoluteErrorIntegral / mScoredDurationNs;
+}
+
+int64_t SimulationReport::getReactionLatencyPercentileNs(int percentile) const {
+    if (mReactionLatenciesNs.empty()) {
+        return -1;
+    }
+    auto latencies = mReactionLatenciesNs;
+    std::sort(latencies.begin(), latencies.end());
+    size_t index = (latencies.size() - 1) * std::clamp(percentile, 0, 100) / 100;
+    return latencies[index];
+}
+
+double SimulationReport::getCpuTimePerEventNs() const {
+    int64_t numEvents = mNumPresents + mNumTimers + mNumPowerModeChanges;
+    if (numEvents == 0) {
+        return 0;
+    }
+    return static_cast<double>(mPresentCpuTimeNs + mTimerCpuTimeNs + mPowerModeCpuTimeNs) /
+            numEvents;
+}
+
+std::string SimulationReport::toString() const {
+    auto perEvent = [](int64_t cpuTimeNs, int64_t count) {
+        return count ? (cpuTimeNs / count) : 0;
+    };
+    std::ostringstream os;
+    os << mCalculatorName << ":\n";
+    os << "\tsimulated = " << mSimulatedDurationNs / kMillisecondToNanoSecond << " ms, scored = "
+       << mScoredDurationNs / kMillisecondToNanoSecond << " ms\n";
+    os << "\taccuracy = " << getAccuracy() * 100 << "%, mean abs error = "
+       << getMeanAbsoluteErrorHz() << " Hz, refresh rate changes = " << mNumRefreshRateChanges
+       << "\n";
+    os << "\treaction latency: count = " << mReactionLatenciesNs.size()
+       << ", missed = " << mNumMissedReactions
+       << ", p50 = " << getReactionLatencyPercentileNs(50) / kMillisecondToNanoSecond
+       << " ms, p90 = " << getReactionLatencyPercentileNs(90) / kMillisecondToNanoSecond
+       << " ms, max = " << getReactionLatencyPercentileNs(100) / kMillisecondToNanoSecond
+       << " ms\n";
+    os << "\tcpu: present = " << perEvent(mPresentCpuTimeNs, mNumPresents) << " ns x "
+       << mNumPresents << ", timer = " << perEvent(mTimerCpuTimeNs, mNumTimers) << " ns x "
+       << mNumTimers << ", power = " << perEvent(mPowerModeCpuTimeNs, mNumPowerModeChanges)
+       << " ns x " << mNumPowerModeChanges << ", average = " << getCpuTimePerEventNs()
+       << " ns/event\n";
+    return os.str();
+}
+
+struct RefreshRateCalculatorSimulator::RunState {
+    VirtualClock mClock;
+    EventQueue mEventQueue;
+    std::shared_ptr<RefreshRateCalculator> mCalculator;
+    SimulationReport mReport;
+
+    int mPowerMode = HWC_POWER_MODE_NORMAL;
+    int mExpectedRefreshRate = kDefaultInvalidRefreshRate;
+    int mReportedRefreshRate = kDefaultInvalidRefreshRate;
+    int64_t mLastAccumulateTimeNs = 0;
+    // Start time of the expectation change the calculator has not caught up with yet.
+    std::optional<int64_t> mPendingReactionSinceNs;
+};
+
+SimulationReport RefreshRateCalculatorSimulator::run(const CalculatorBuilder& builder,
+                                                     const SimulationTrace& trace) {
+    RunState state;
+    state.mCalculator = builder(&state.mEventQueue);
+    if (!state.mCalculator) {
+        return state.mReport;
+    }
+    state.mReport.mCalculatorName = state.mCalculator->getName();
+    state.mCalculator->registerRefreshRateChangeCallback(
+            [&state](int) { ++state.mReport.mNumRefreshRateChanges; });
+
+    // The composer starts the calculators when the display turns on.
+    int64_t startCpuTimeNs = getThreadCpuTimeNs();
+    state.mCalculator->onPowerStateChange(HWC_POWER_MODE_OFF, HWC_POWER_MODE_NORMAL);
+    state.mReport.mPowerModeCpuTimeNs += getThreadCpuTimeNs() - startCpuTimeNs;
+    ++state.mReport.mNumPowerModeChanges;
+
+    for (const auto& event : trace.getEvents()) {
+        advanceTo(state, event.mTimeNs);
+        handleEvent(state, event);
+        updateReportedRefreshRate(state);
+    }
+    advanceTo(state, trace.getEndTimeNs());
+
+    if (state.mPendingReactionSinceNs) {
+        ++state.mReport.mNumMissedReactions;
+    }
+    state.mReport.mSimulatedDurationNs = state.mClock.now();
+    return state.mReport;
+}
+
+void RefreshRateCalculatorSimulator::advanceTo(RunState& state, int64_t timeNs) {
+    auto& queue = state.mEventQueue.mPriorityQueue;
+    while (!queue.empty() && queue.top().mWhenNs <= timeNs) {
+        auto event = queue.top();
+        queue.pop();
+        accumulate(state, event.mWhenNs);
+        state.mClock.advanceTo(event.mWhenNs);
+        // Only callback events are posted by the calculators; anything else belongs to the
+        // controller state machine, which is not simulated.
+        if ((static_cast<int>(event.mEventType) &
+             static_cast<int>(VrrControllerEventType::kCallbackEventMask)) &&
+            event.mFunctor) {
+            int64_t startCpuTimeNs = getThreadCpuTimeNs();
+            event.mFunctor();
+            state.mReport.mTimerCpuTimeNs += getThreadCpuTimeNs() - startCpuTimeNs;
+            ++state.mReport.mNumTimers;
+        }
+        updateReportedRefreshRate(state);
+    }
+    accumulate(state, timeNs);
+    state.mClock.advanceTo(timeNs);
+}
+
+void RefreshRateCalculatorSimulator::accumulate(RunState& state, int64_t untilNs) {
+    int64_t durationNs = untilNs - state.mLastAccumulateTimeNs;
+    if (durationNs <= 0) {
+        return;
+    }
+    state.mLastAccumulateTimeNs = untilNs;
+    if (state.mExpectedRefreshRate == kDefaultInvalidRefreshRate) {
+        return;
+    }
+    auto& report = state.mReport;
+    report.mScoredDurationNs += durationNs;
+    if (isAccurate(state.mReportedRefreshRate, state.mExpectedRefreshRate)) {
+        report.mAccurateDurationNs += durationNs;
+    }
+    int reported = std::max(state.mReportedRefreshRate, 0);
+    report.mAbsoluteErrorIntegral +=
+            static_cast<double>(std::abs(reported - state.mExpectedRefreshRate)) * durationNs;
+}
+
+void RefreshRateCalculatorSimulator::updateReportedRefreshRate(RunState& state) {
+    state.mReportedRefreshRate = state.mCalculator->getRefreshRate();
+    if (state.mPendingReactionSinceNs &&
+        isAccurate(state.mReportedRefreshRate, state.mExpectedRefreshRate)) {
+        state.mReport.mReactionLatenciesNs.push_back(state.mClock.now() -
+                                                     state.mPendingReactionSinceNs.value());
+        state.mPendingReactionSinceNs.reset();
+    }
+}
+
+void RefreshRateCalculatorSimulator::handleEvent(RunState& state, const SimulationEvent& event) {
+    auto& report = state.mReport;
+    switch (event.mType) {
+        case SimulationEventType::kPresent: {
+            int64_t startCpuTimeNs = getThreadCpuTimeNs();
+            state.mCalculator->onPresent(event.mTimeNs, event.mValue);
+            report.mPresentCpuTimeNs += getThreadCpuTimeNs() - startCpuTimeNs;
+            ++report.mNumPresents;
+            break;
+        }
+        case SimulationEventType::kPowerMode: {
+            if (event.mValue == state.mPowerMode) {
+                break;
+            }
+            int64_t startCpuTimeNs = getThreadCpuTimeNs();
+            state.mCalculator->onPowerStateChange(state.mPowerMode, event.mValue);
+            report.mPowerModeCpuTimeNs += getThreadCpuTimeNs() - startCpuTimeNs;
+            ++report.mNumPowerModeChanges;
+            state.mPowerMode = event.mValue;
+            break;
+        }
+        case SimulationEventType::kConfig: {
+            state.mCalculator->setVrrConfigAttributes(event.mVsyncPeriodNs,
+                                                      event.mMinFrameIntervalNs);
+            break;
+        }
+        case SimulationEventType::kExpect: {
+            if (event.mValue == state.mExpectedRefreshRate) {
+                break;
+            }
+            if (state.mPendingReactionSinceNs) {
+                ++report.mNumMissedReactions;
+                state.mPendingReactionSinceNs.reset();
+            }
+            state.mExpectedRefreshRate = event.mValue;
+            if (state.mExpectedRefreshRate != kDefaultInvalidRefreshRate) {
+                state.mPendingReactionSinceNs = event.mTimeNs;
+            }
+            break;
+        }
+        case SimulationEventType::kTe:
+        case SimulationEventType::kEnd:
+            // Advancing the clock is all these events do.
+            break;
+    }
+}
+
+bool RefreshRateCalculatorSimulator::isAccurate(int reported, int expected) const {
+    return (reported != kDefaultInvalidRefreshRate) && (std::abs(reported - expected) <= mToleranceHz);
+}
+
+} // namespace android::hardware::graphics::composer
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../EventQueue.h"
+#include "../RefreshRateCalculator/RefreshRateCalculator.h"
+#include "SimulationTrace.h"
+#include "VirtualClock.h"
+
+namespace android::hardware::graphics::composer {
+
+struct SimulationReport {
+    std::string mCalculatorName;
+
+    int64_t mSimulatedDurationNs = 0;
+    // Time during which an expected refresh rate was defined by the trace.
+    int64_t mScoredDurationNs = 0;
+    // Part of |mScoredDurationNs| where the reported refresh rate was within tolerance.
+    int64_t mAccurateDurationNs = 0;
+    // Time-weighted sum of |reported - expected| over |mScoredDurationNs|, in Hz * ns. Invalid
+    // reports count as an error equal to the expected refresh rate.
+    double mAbsoluteErrorIntegral = 0;
+
+    // Delay between a change of the expected refresh rate and the calculator first reporting it.
+    std::vector<int64_t> mReactionLatenciesNs;
+    // Expectation changes the calculator never caught up with before the next change.
+    int mNumMissedReactions = 0;
+    int mNumRefreshRateChanges = 0;
+
+    // CPU cost, measured with the thread CPU clock around each calculator invocation.
+    int64_t mNumPresents = 0;
+    int64_t mPresentCpuTimeNs = 0;
+    int64_t mNumTimers = 0;
+    int64_t mTimerCpuTimeNs = 0;
+    int64_t mNumPowerModeChanges = 0;
+    int64_t mPowerModeCpuTimeNs = 0;
+
+    double getAccuracy() const;
+    double getMeanAbsoluteErrorHz() const;
+    int64_t getReactionLatencyPercentileNs(int percentile) const;
+    double getCpuTimePerEventNs() const;
+
+    std::string toString() const;
+};
+
+// Drives a refresh rate calculator with a scripted trace on a virtual clock, outside of
+// VariableRefreshRateController.
+class RefreshRateCalculatorSimulator {
+public:
+    // Invoked once per run, after the virtual clock has been installed, to build the calculator
+    // under test on the simulator's event queue (typically through RefreshRateCalculatorFactory).
+    using CalculatorBuilder =
+            std::function<std::shared_ptr<RefreshRateCalculator>(EventQueue* eventQueue)>;
+
+    explicit RefreshRateCalculatorSimulator(int toleranceHz = 1) : mToleranceHz(toleranceHz) {}
+
+    SimulationReport run(const CalculatorBuilder& builder, const SimulationTrace& trace);
+
+private:
+    struct RunState;
+
+    void advanceTo(RunState& state, int64_t timeNs);
+    void accumulate(RunState& state, int64_t untilNs);
+    void updateReportedRefreshRate(RunState& state);
+    void handleEvent(RunState& state, const SimulationEvent& event);
+
+    bool isAccurate(int reported, int expected) const;
+
+    const int mToleranceHz;
+};
+
+} // namespace android::hardware::graphics::composer
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SimulationTrace.h"
+
+#include <hardware/hwcomposer_defs.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "../RefreshRateCalculator/RefreshRateCalculator.h"
+#include "../Utils.h"
+
+namespace android::hardware::graphics::composer {
+
+namespace {
+
+bool parseTimeNs(const std::string& token, int64_t* timeNs) {
+    size_t unitPos = token.find_first_not_of("0123456789.");
+    std::string number = token.substr(0, unitPos);
+    std::string unit = (unitPos == std::string::npos) ? "ns" : token.substr(unitPos);
+    if (number.empty()) {
+        return false;
+    }
+    long double scale;
+    if (unit == "ns") {
+        scale = 1;
+    } else if (unit == "us") {
+        scale = std::nano::den / std::micro::den;
+    } else if (unit == "ms") {
+        scale = kMillisecondToNanoSecond;
+    } else if (unit == "s") {
+        scale = std::nano::den;
+    } else {
+        return false;
+    }
+    char* end = nullptr;
+    long double value = std::strtold(number.c_str(), &end);
+    if (*end != '\0' || value < 0) {
+        return false;
+    }
+    *timeNs = std::llround(value * scale);
+    return true;
+}
+
+bool parseRate(const std::string& token, double* rate) {
+    char* end = nullptr;
+    *rate = std::strtod(token.c_str(), &end);
+    return (*end == '\0') && (*rate > 0);
+}
+
+bool parseFrameFlag(const std::string& token, int* flag) {
+    if (token == "yuv") {
+        *flag |= static_cast<int>(PresentFrameFlag::kIsYuv);
+    } else if (token == "doze") {
+        *flag |= static_cast<int>(PresentFrameFlag::kPresentingWhenDoze);
+    } else if (token == "rri") {
+        *flag |= static_cast<int>(PresentFrameFlag::kUpdateRefreshRateIndicatorLayerOnly);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parsePowerMode(const std::string& token, int* powerMode) {
+    if (token == "off") {
+        *powerMode = HWC_POWER_MODE_OFF;
+    } else if (token == "doze") {
+        *powerMode = HWC_POWER_MODE_DOZE;
+    } else if (token == "on") {
+        *powerMode = HWC_POWER_MODE_NORMAL;
+    } else if (token == "doze_suspend") {
+        *powerMode = HWC_POWER_MODE_DOZE_SUSPEND;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::optional<SimulationTrace> SimulationTrace::parse(std::istream& in, std::string* error) {
+    SimulationTrace trace;
+    std::string line;
+    int lineNumber = 0;
+
+    auto fail = [&](const std::string& reason) {
+        if (error) {
+            *error = "line " + std::to_string(lineNumber) + ": " + reason + " [" + line + "]";
+        }
+        return std::nullopt;
+    };
+
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        auto commentPos = line.find('#');
+        std::istringstream tokenizer(line.substr(0, commentPos));
+        std::vector<std::string> tokens;
+        for (std::string token; tokenizer >> token;) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+        const std::string& command = tokens[0];
+        int64_t timeNs;
+        if (tokens.size() < 2 || !parseTimeNs(tokens[1], &timeNs)) {
+            return fail("missing or invalid time");
+        }
+
+        SimulationEvent event;
+        event.mTimeNs = timeNs;
+        if (command == "present") {
+            event.mType = SimulationEventType::kPresent;
+            for (size_t i = 2; i < tokens.size(); ++i) {
+                if (!parseFrameFlag(tokens[i], &event.mValue)) {
+                    return fail("unknown frame flag " + tokens[i]);
+                }
+            }
+            trace.addEvent(event);
+        } else if (command == "te" || command == "end") {
+            if (tokens.size() != 2) {
+                return fail("unexpected arguments");
+            }
+            event.mType = (command == "te") ? SimulationEventType::kTe : SimulationEventType::kEnd;
+            trace.addEvent(event);
+        } else if (command == "power") {
+            event.mType = SimulationEventType::kPowerMode;
+            if (tokens.size() != 3 || !parsePowerMode(tokens[2], &event.mValue)) {
+                return fail("invalid power mode");
+            }
+            trace.addEvent(event);
+        } else if (command == "config") {
+            event.mType = SimulationEventType::kConfig;
+            if (tokens.size() != 4 || !parseTimeNs(tokens[2], &event.mVsyncPeriodNs) ||
+                !parseTimeNs(tokens[3], &event.mMinFrameIntervalNs) ||
+                event.mVsyncPeriodNs <= 0 || event.mMinFrameIntervalNs < event.mVsyncPeriodNs) {
+                return fail("invalid config");
+            }
+            trace.addEvent(event);
+        } else if (command == "expect") {
+            event.mType = SimulationEventType::kExpect;
+            double rate;
+            if (tokens.size() != 3) {
+                return fail("missing expected refresh rate");
+            }
+            if (tokens[2] == "none") {
+                event.mValue = kDefaultInvalidRefreshRate;
+            } else if (parseRate(tokens[2], &rate)) {
+                event.mValue = static_cast<int>(std::lround(rate));
+            } else {
+                return fail("invalid expected refresh rate");
+            }
+            trace.addEvent(event);
+        } else if (command == "frames" || command == "video") {
+            double rate;
+            int64_t durationNs;
+            if (tokens.size() < 4 || !parseRate(tokens[2], &rate) ||
+                !parseTimeNs(tokens[3], &durationNs)) {
+                return fail("usage: " + command + " <time> <rate> <duration>");
+            }
+            int flag = (command == "video") ? static_cast<int>(PresentFrameFlag::kIsYuv) : 0;
+            for (size_t i = 4; i < tokens.size(); ++i) {
+                if (!parseFrameFlag(tokens[i], &flag)) {
+                    return fail("unknown frame flag " + tokens[i]);
+                }
+            }
+            SimulationEvent expect{.mType = SimulationEventType::kExpect,
+                                   .mTimeNs = timeNs,
+                                   .mValue = static_cast<int>(std::lround(rate))};
+            trace.addEvent(expect);
+            for (int64_t i = 0;; ++i) {
+                int64_t offsetNs = std::llround(i * std::nano::den / rate);
+                if (offsetNs >= durationNs) {
+                    break;
+                }
+                SimulationEvent present{.mType = SimulationEventType::kPresent,
+                                        .mTimeNs = timeNs + offsetNs,
+                                        .mValue = flag};
+                trace.addEvent(present);
+            }
+            expect.mTimeNs = timeNs + durationNs;
+            expect.mValue = kDefaultInvalidRefreshRate;
+            trace.addEvent(expect);
+        } else {
+            return fail("unknown command " + command);
+        }
+    }
+
+    // Generated frames may interleave with later lines; keep the script order for equal times.
+    std::stable_sort(trace.mEvents.begin(), trace.mEvents.end(),
+                     [](const SimulationEvent& a, const SimulationEvent& b) {
+                         return a.mTimeNs < b.mTimeNs;
+                     });
+    return trace;
+}
+
+std::optional<SimulationTrace> SimulationTrace::load(const std::string& path, std::string* error) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        if (error) {
+            *error = "cannot open " + path;
+        }
+        return std::nullopt;
+    }
+    return parse(in, error);
+}
+
+int64_t SimulationTrace::getEndTimeNs() const {
+    for (auto it = mEvents.rbegin(); it != mEvents.rend(); ++it) {
+        if (it->mType == SimulationEventType::kEnd) {
+            return it->mTimeNs;
+        }
+    }
+    return mEvents.empty() ? 0 : mEvents.back().mTimeNs;
+}
+
+size_t SimulationTrace::getNumberOfPresents() const {
+    return std::count_if(mEvents.begin(), mEvents.end(), [](const SimulationEvent& event) {
+        return event.mType == SimulationEventType::kPresent;
+    });
+}
+
+void SimulationTrace::addEvent(const SimulationEvent& event) {
+    mEvents.push_back(event);
+}
+
+} // namespace android::hardware::graphics::composer
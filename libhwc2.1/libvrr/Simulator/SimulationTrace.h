@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace android::hardware::graphics::composer {
+
+enum class SimulationEventType {
+    kPresent = 0,
+    kTe,
+    kPowerMode,
+    kConfig,
+    kExpect,
+    kEnd,
+};
+
+struct SimulationEvent {
+    SimulationEventType mType;
+    int64_t mTimeNs = 0;
+    // kPresent: present frame flags; kPowerMode: HWC power mode; kExpect: expected refresh rate
+    // (kDefaultInvalidRefreshRate stops scoring).
+    int mValue = 0;
+    // kConfig only.
+    int64_t mVsyncPeriodNs = 0;
+    int64_t mMinFrameIntervalNs = 0;
+};
+
+// A scripted sequence of display events used to drive a refresh rate calculator.
+//
+// The trace is a line-oriented text format; '#' starts a comment. Each line is
+// "<command> <time> [arguments...]", where durations and times take an optional unit suffix
+// (ns, us, ms, s; nanoseconds by default):
+//
+//   config  <time> <vsync period> <min frame interval>
+//   present <time> [yuv] [doze] [rri]
+//   te      <time>
+//   power   <time> <off|doze|on|doze_suspend>
+//   expect  <time> <refresh rate|none>
+//   frames  <time> <rate> <duration> [yuv] [doze]
+//   video   <time> <frame rate> <duration>
+//   end     <time>
+//
+// |frames| and |video| expand into periodic presents and set the expected refresh rate for their
+// duration; |video| marks the frames as YUV. |te| only advances the clock, dispatching any timer
+// that is due, as a panel TE wakeup would.
+class SimulationTrace {
+public:
+    static std::optional<SimulationTrace> parse(std::istream& in, std::string* error);
+    static std::optional<SimulationTrace> load(const std::string& path, std::string* error);
+
+    const std::vector<SimulationEvent>& getEvents() const { return mEvents; }
+
+    int64_t getEndTimeNs() const;
+
+    size_t getNumberOfPresents() const;
+
+private:
+    void addEvent(const SimulationEvent& event);
+
+    std::vector<SimulationEvent> mEvents;
+};
+
+} // namespace android::hardware::graphics::composer
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "../Utils.h"
+
+namespace android::hardware::graphics::composer {
+
+// A manually advanced clock. While alive, it replaces the steady clock seen by the VRR components
+// so that their timers and timestamps are fully deterministic.
+class VirtualClock {
+public:
+    explicit VirtualClock(int64_t startTimeNs = 0) : mNowNs(startTimeNs) {
+        setSteadyClockSource([this]() { return mNowNs; });
+    }
+
+    ~VirtualClock() { setSteadyClockSource(nullptr); }
+
+    VirtualClock(const VirtualClock&) = delete;
+    VirtualClock& operator=(const VirtualClock&) = delete;
+
+    int64_t now() const { return mNowNs; }
+
+    // Time never goes backwards; requests to move into the past are ignored.
+    void advanceTo(int64_t timeNs) {
+        if (timeNs > mNowNs) {
+            mNowNs = timeNs;
+        }
+    }
+
+private:
+    int64_t mNowNs;
+};
+
+} // namespace android::hardware::graphics::composer
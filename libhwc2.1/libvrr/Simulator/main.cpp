@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../RefreshRateCalculator/RefreshRateCalculatorFactory.h"
+#include "RefreshRateCalculatorSimulator.h"
+#include "SimulationTrace.h"
+
+using namespace android::hardware::graphics::composer;
+
+namespace {
+
+struct SimulatorOptions {
+    std::vector<std::string> mCalculators;
+    std::vector<std::string> mTraces;
+    int mToleranceHz = 1;
+    int mIterations = 1;
+    PeriodRefreshRateCalculatorParameters mPeriodParams;
+    VideoFrameRateCalculatorParameters mVideoParams;
+    ExitIdleRefreshRateCalculatorParameters mExitIdleParams;
+};
+
+const std::vector<std::string> kAllCalculators = {"aod",   "instant",  "exitidle", "period",
+                                                  "video", "combined", "vrr"};
+
+void usage(const char* program) {
+    std::cerr << "usage: " << program << " [options] <trace>...\n"
+              << "  --calculator <name>        aod, instant, exitidle, period, video, combined or\n"
+              << "                             vrr (the controller's calculator); repeatable,\n"
+              << "                             all of them by default\n"
+              << "  --tolerance <hz>           accepted refresh rate error (default 1)\n"
+              << "  --iterations <n>           repeat each run to average the CPU cost\n"
+              << "  --period-type <t>          average or major\n"
+              << "  --period-measure-ms <ms>   measure period of the period calculator\n"
+              << "  --period-confidence <pct>  confidence percentage of the period calculator\n"
+              << "  --video-delta <hz>         stable run delta of the video calculator\n"
+              << "  --video-window <n>         history window of the video calculator\n"
+              << "  --video-stable-runs <n>    minimum stable runs of the video calculator\n"
+              << "  --idle-criteria-ms <ms>    idle criteria of the exit idle calculator\n";
+}
+
+bool parseOptions(int argc, char** argv, SimulatorOptions* options) {
+    enum {
+        kCalculator = 1,
+        kTolerance,
+        kIterations,
+        kPeriodType,
+        kPeriodMeasure,
+        kPeriodConfidence,
+        kVideoDelta,
+        kVideoWindow,
+        kVideoStableRuns,
+        kIdleCriteria,
+    };
+    static const struct option kOptions[] = {
+            {"calculator", required_argument, nullptr, kCalculator},
+            {"tolerance", required_argument, nullptr, kTolerance},
+            {"iterations", required_argument, nullptr, kIterations},
+            {"period-type", required_argument, nullptr, kPeriodType},
+            {"period-measure-ms", required_argument, nullptr, kPeriodMeasure},
+            {"period-confidence", required_argument, nullptr, kPeriodConfidence},
+            {"video-delta", required_argument, nullptr, kVideoDelta},
+            {"video-window", required_argument, nullptr, kVideoWindow},
+            {"video-stable-runs", required_argument, nullptr, kVideoStableRuns},
+            {"idle-criteria-ms", required_argument, nullptr, kIdleCriteria},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", kOptions, nullptr)) != -1) {
+        switch (opt) {
+            case kCalculator:
+                options->mCalculators.push_back(optarg);
+                break;
+            case kTolerance:
+                options->mToleranceHz = std::stoi(optarg);
+                break;
+            case kIterations:
+                options->mIterations = std::max(1, std::stoi(optarg));
+                break;
+            case kPeriodType:
+                options->mPeriodParams.mType = (std::string(optarg) == "major")
+                        ? PeriodRefreshRateCalculatorType::kMajor
+                        : PeriodRefreshRateCalculatorType::kAverage;
+                break;
+            case kPeriodMeasure:
+                options->mPeriodParams.mMeasurePeriodNs =
+                        std::stoll(optarg) * kMillisecondToNanoSecond;
+                break;
+            case kPeriodConfidence:
+                options->mPeriodParams.mConfidencePercentage = std::stoi(optarg);
+                break;
+            case kVideoDelta:
+                options->mVideoParams.mDelta = std::stoi(optarg);
+                break;
+            case kVideoWindow:
+                options->mVideoParams.mWindowSize = std::stoi(optarg);
+                break;
+            case kVideoStableRuns:
+                options->mVideoParams.mMinStableRuns = std::stoi(optarg);
+                break;
+            case kIdleCriteria:
+                options->mExitIdleParams.mIdleCriteriaTimeNs =
+                        std::stoll(optarg) * kMillisecondToNanoSecond;
+                break;
+            default:
+                return false;
+        }
+    }
+    for (int i = optind; i < argc; ++i) {
+        options->mTraces.push_back(argv[i]);
+    }
+    if (options->mCalculators.empty()) {
+        options->mCalculators = kAllCalculators;
+    }
+    return !options->mTraces.empty();
+}
+
+RefreshRateCalculatorSimulator::CalculatorBuilder getBuilder(const std::string& name,
+                                                             const SimulatorOptions& options) {
+    return [name, &options](EventQueue* eventQueue) -> std::shared_ptr<RefreshRateCalculator> {
+        RefreshRateCalculatorFactory factory;
+        if (name == "aod") {
+            return factory.BuildRefreshRateCalculator(eventQueue, RefreshRateCalculatorType::kAod);
+        } else if (name == "instant") {
+            return factory.BuildRefreshRateCalculator(eventQueue,
+                                                      RefreshRateCalculatorType::kInstant);
+        } else if (name == "exitidle") {
+            return factory.BuildRefreshRateCalculator(eventQueue, options.mExitIdleParams);
+        } else if (name == "period") {
+            return factory.BuildRefreshRateCalculator(eventQueue, options.mPeriodParams);
+        } else if (name == "video") {
+            return factory.BuildRefreshRateCalculator(eventQueue, options.mVideoParams);
+        } else if (name == "combined") {
+            return factory.BuildRefreshRateCalculator(eventQueue,
+                                                      RefreshRateCalculatorType::kCombined);
+        } else if (name == "vrr") {
+            // Mirrors the calculator VariableRefreshRateController builds.
+            std::vector<std::shared_ptr<RefreshRateCalculator>> calculators;
+            calculators.emplace_back(
+                    factory.BuildRefreshRateCalculator(eventQueue,
+                                                       RefreshRateCalculatorType::kAod));
+            calculators.emplace_back(
+                    factory.BuildRefreshRateCalculator(eventQueue, options.mExitIdleParams));
+            calculators.emplace_back(
+                    factory.BuildRefreshRateCalculator(eventQueue, options.mVideoParams));
+            PeriodRefreshRateCalculatorParameters periodParams = options.mPeriodParams;
+            periodParams.mConfidencePercentage = 0;
+            calculators.emplace_back(factory.BuildRefreshRateCalculator(eventQueue, periodParams));
+            return factory.BuildRefreshRateCalculator(std::move(calculators));
+        }
+        return nullptr;
+    };
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    SimulatorOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    RefreshRateCalculatorSimulator simulator(options.mToleranceHz);
+    for (const auto& tracePath : options.mTraces) {
+        std::string error;
+        auto trace = SimulationTrace::load(tracePath, &error);
+        if (!trace) {
+            std::cerr << tracePath << ": " << error << "\n";
+            return 1;
+        }
+        std::cout << "trace " << tracePath << " (" << trace->getNumberOfPresents()
+                  << " presents)\n";
+        for (const auto& name : options.mCalculators) {
+            auto builder = getBuilder(name, options);
+            SimulationReport report;
+            int64_t presentCpuTimeNs = 0, timerCpuTimeNs = 0, powerModeCpuTimeNs = 0;
+            for (int i = 0; i < options.mIterations; ++i) {
+                report = simulator.run(builder, trace.value());
+                presentCpuTimeNs += report.mPresentCpuTimeNs;
+                timerCpuTimeNs += report.mTimerCpuTimeNs;
+                powerModeCpuTimeNs += report.mPowerModeCpuTimeNs;
+            }
+            if (report.mCalculatorName.empty()) {
+                std::cerr << "unknown calculator " << name << "\n";
+                return 1;
+            }
+            // Runs are deterministic except for the CPU cost, which is averaged.
+            report.mPresentCpuTimeNs = presentCpuTimeNs / options.mIterations;
+            report.mTimerCpuTimeNs = timerCpuTimeNs / options.mIterations;
+            report.mPowerModeCpuTimeNs = powerModeCpuTimeNs / options.mIterations;
+            std::cout << "[" << name << "] " << report.toString();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <hardware/hwcomposer_defs.h>
+
+#include <sstream>
+
+#include "../../RefreshRateCalculator/RefreshRateCalculatorFactory.h"
+#include "../RefreshRateCalculatorSimulator.h"
+#include "../SimulationTrace.h"
+
+namespace android::hardware::graphics::composer {
+
+namespace {
+
+constexpr int64_t kMs = kMillisecondToNanoSecond;
+
+SimulationTrace parseTrace(const std::string& text) {
+    std::istringstream in(text);
+    std::string error;
+    auto trace = SimulationTrace::parse(in, &error);
+    EXPECT_TRUE(trace.has_value()) << error;
+    return trace.value_or(SimulationTrace());
+}
+
+std::string parseError(const std::string& text) {
+    std::istringstream in(text);
+    std::string error;
+    EXPECT_FALSE(SimulationTrace::parse(in, &error).has_value());
+    return error;
+}
+
+// Reports the rate of the last two presents until a timer, armed on the steady clock, expires
+// 100 ms after the last present.
+class IntervalRefreshRateCalculator : public RefreshRateCalculator {
+public:
+    explicit IntervalRefreshRateCalculator(EventQueue* eventQueue) : mEventQueue(eventQueue) {
+        setName("interval");
+        mTimeoutEvent.mEventType = VrrControllerEventType::kInstantRefreshRateCalculatorUpdate;
+        mTimeoutEvent.mFunctor = [this]() {
+            mRefreshRate = kDefaultInvalidRefreshRate;
+            return 0;
+        };
+    }
+
+    int getRefreshRate() const override { return mRefreshRate; }
+
+    void onPresentInternal(int64_t presentTimeNs, int) override {
+        if (mLastPresentTimeNs != kDefaultInvalidPresentTimeNs) {
+            mRefreshRate = durationNsToFreq(presentTimeNs - mLastPresentTimeNs);
+        }
+        mLastPresentTimeNs = presentTimeNs;
+        mEventQueue->dropEvent(VrrControllerEventType::kInstantRefreshRateCalculatorUpdate);
+        mTimeoutEvent.mWhenNs = getSteadyClockTimeNs() + 100 * kMs;
+        mEventQueue->mPriorityQueue.emplace(mTimeoutEvent);
+    }
+
+    void reset() override { mRefreshRate = kDefaultInvalidRefreshRate; }
+
+private:
+    EventQueue* mEventQueue;
+    VrrControllerEvent mTimeoutEvent;
+    int64_t mLastPresentTimeNs = kDefaultInvalidPresentTimeNs;
+    int mRefreshRate = kDefaultInvalidRefreshRate;
+};
+
+RefreshRateCalculatorSimulator::CalculatorBuilder intervalBuilder() {
+    return [](EventQueue* eventQueue) {
+        return std::make_shared<IntervalRefreshRateCalculator>(eventQueue);
+    };
+}
+
+} // namespace
+
+TEST(SimulationTraceTest, ParsesCommandsAndUnits) {
+    auto trace = parseTrace(
+            "# comment\n"
+            "config 0 8333333 16.666ms\n"
+            "present 1ms yuv doze   # trailing comment\n"
+            "\n"
+            "te 1500us\n"
+            "power 2s doze_suspend\n"
+            "expect 3s none\n"
+            "end 4s\n");
+    const auto& events = trace.getEvents();
+    ASSERT_EQ(6u, events.size());
+
+    EXPECT_EQ(SimulationEventType::kConfig, events[0].mType);
+    EXPECT_EQ(8333333, events[0].mVsyncPeriodNs);
+    EXPECT_EQ(16666000, events[0].mMinFrameIntervalNs);
+
+    EXPECT_EQ(SimulationEventType::kPresent, events[1].mType);
+    EXPECT_EQ(1 * kMs, events[1].mTimeNs);
+    EXPECT_TRUE(hasPresentFrameFlag(events[1].mValue, PresentFrameFlag::kIsYuv));
+    EXPECT_TRUE(hasPresentFrameFlag(events[1].mValue, PresentFrameFlag::kPresentingWhenDoze));
+
+    EXPECT_EQ(SimulationEventType::kTe, events[2].mType);
+    EXPECT_EQ(1500000, events[2].mTimeNs);
+
+    EXPECT_EQ(SimulationEventType::kPowerMode, events[3].mType);
+    EXPECT_EQ(HWC_POWER_MODE_DOZE_SUSPEND, events[3].mValue);
+
+    EXPECT_EQ(SimulationEventType::kExpect, events[4].mType);
+    EXPECT_EQ(kDefaultInvalidRefreshRate, events[4].mValue);
+
+    EXPECT_EQ(4000 * kMs, trace.getEndTimeNs());
+    EXPECT_EQ(1u, trace.getNumberOfPresents());
+}
+
+TEST(SimulationTraceTest, FramesExpandIntoPresents) {
+    auto trace = parseTrace(
+            "video 1s 24 1s\n"
+            "present 1010ms\n");
+    const auto& events = trace.getEvents();
+    EXPECT_EQ(25u, trace.getNumberOfPresents());
+
+    ASSERT_EQ(SimulationEventType::kExpect, events.front().mType);
+    EXPECT_EQ(1000 * kMs, events.front().mTimeNs);
+    EXPECT_EQ(24, events.front().mValue);
+    ASSERT_EQ(SimulationEventType::kExpect, events.back().mType);
+    EXPECT_EQ(2000 * kMs, events.back().mTimeNs);
+    EXPECT_EQ(kDefaultInvalidRefreshRate, events.back().mValue);
+
+    // Events are sorted by time, the scripted present comes right after the first frame
+    EXPECT_EQ(1000 * kMs, events[1].mTimeNs);
+    EXPECT_TRUE(hasPresentFrameFlag(events[1].mValue, PresentFrameFlag::kIsYuv));
+    EXPECT_EQ(1010 * kMs, events[2].mTimeNs);
+    EXPECT_EQ(0, events[2].mValue);
+    for (size_t i = 1; i < events.size(); ++i) {
+        EXPECT_LE(events[i - 1].mTimeNs, events[i].mTimeNs);
+    }
+}
+
+TEST(SimulationTraceTest, ErrorsNameTheLineAndCommand) {
+    EXPECT_EQ("line 2: unknown command flip [flip 1s]", parseError("te 0\nflip 1s\n"));
+    EXPECT_EQ("line 1: missing or invalid time [present 1h]", parseError("present 1h\n"));
+    EXPECT_EQ("line 1: usage: frames <time> <rate> <duration> [frames 0 60]",
+              parseError("frames 0 60\n"));
+    EXPECT_EQ("line 1: usage: video <time> <rate> <duration> [video 0 0 1s]",
+              parseError("video 0 0 1s\n"));
+    EXPECT_EQ("line 1: invalid config [config 0 16ms 8ms]", parseError("config 0 16ms 8ms\n"));
+    EXPECT_EQ("line 1: invalid power mode [power 0 sleep]", parseError("power 0 sleep\n"));
+    EXPECT_EQ("line 1: unknown frame flag hdr [present 0 hdr]", parseError("present 0 hdr\n"));
+}
+
+TEST(VirtualClockTest, ReplacesSteadyClock) {
+    {
+        VirtualClock clock(5 * kMs);
+        EXPECT_EQ(5 * kMs, getSteadyClockTimeNs());
+        EXPECT_EQ(5, getSteadyClockTimeMs());
+
+        clock.advanceTo(7 * kMs);
+        EXPECT_EQ(7 * kMs, getSteadyClockTimeNs());
+
+        // Time never goes backwards
+        clock.advanceTo(6 * kMs);
+        EXPECT_EQ(7 * kMs, clock.now());
+    }
+    // The system clock is back once the virtual clock is gone
+    const int64_t before = getSteadyClockTimeNs();
+    EXPECT_GT(before, 7 * kMs);
+    EXPECT_GE(getSteadyClockTimeNs(), before);
+}
+
+TEST(RefreshRateCalculatorSimulatorTest, ScoresAccuracyAndReaction) {
+    auto trace = parseTrace(
+            "frames 0 60 1s\n"
+            "end 2s\n");
+    RefreshRateCalculatorSimulator simulator;
+    auto report = simulator.run(intervalBuilder(), trace);
+
+    EXPECT_EQ("interval", report.mCalculatorName);
+    EXPECT_EQ(2000 * kMs, report.mSimulatedDurationNs);
+    EXPECT_EQ(1000 * kMs, report.mScoredDurationNs);
+    EXPECT_EQ(60, report.mNumPresents);
+
+    // The rate is known from the second frame on
+    ASSERT_EQ(1u, report.mReactionLatenciesNs.size());
+    const int64_t frameNs = freqToDurationNs(60);
+    EXPECT_NEAR(frameNs, report.mReactionLatenciesNs[0], 1);
+    EXPECT_EQ(0, report.mNumMissedReactions);
+    EXPECT_NEAR(1000 * kMs - frameNs, report.mAccurateDurationNs, 1);
+    EXPECT_NEAR(1.0 - frameNs / (1000.0 * kMs), report.getAccuracy(), 1e-6);
+
+    // Only the timer armed by the last present expires, on the virtual clock
+    EXPECT_EQ(1, report.mNumTimers);
+}
+
+TEST(RefreshRateCalculatorSimulatorTest, CountsMissedReactions) {
+    auto trace = parseTrace(
+            "present 0\n"
+            "expect 0 90\n"
+            "expect 500ms 30\n"
+            "end 1s\n");
+    RefreshRateCalculatorSimulator simulator;
+    auto report = simulator.run(intervalBuilder(), trace);
+
+    EXPECT_TRUE(report.mReactionLatenciesNs.empty());
+    EXPECT_EQ(2, report.mNumMissedReactions);
+    EXPECT_EQ(0, report.mAccurateDurationNs);
+    // Invalid reports count as an error equal to the expected rate
+    EXPECT_DOUBLE_EQ(60.0, report.getMeanAbsoluteErrorHz());
+}
+
+TEST(RefreshRateCalculatorSimulatorTest, PowerModeChangesReachCalculator) {
+    auto trace = parseTrace(
+            "power 1s doze\n"
+            "power 1s doze\n"
+            "power 2s on\n"
+            "end 3s\n");
+    RefreshRateCalculatorSimulator simulator;
+    auto report = simulator.run(intervalBuilder(), trace);
+
+    // The initial power on and the two changes, repeated modes are dropped
+    EXPECT_EQ(3, report.mNumPowerModeChanges);
+}
+
+TEST(RefreshRateCalculatorSimulatorTest, RunsFactoryCalculators) {
+    auto trace = parseTrace(
+            "config 0 8333333 8333333\n"
+            "frames 0 120 1s\n"
+            "end 1s\n");
+    RefreshRateCalculatorSimulator simulator;
+    RefreshRateCalculatorFactory factory;
+    auto report = simulator.run(
+            [&](EventQueue* eventQueue) {
+                return factory.BuildRefreshRateCalculator(eventQueue,
+                                                          RefreshRateCalculatorType::kInstant);
+            },
+            trace);
+
+    EXPECT_EQ(120, report.mNumPresents);
+    EXPECT_EQ(1000 * kMs, report.mScoredDurationNs);
+    EXPECT_GT(report.getAccuracy(), 0.9);
+}
+
+} // namespace android::hardware::graphics::composer
@@ -24,13 +24,35 @@
 
 namespace android::hardware::graphics::composer {
 
+#ifdef VRR_VIRTUAL_STEADY_CLOCK
+namespace {
+
+std::function<int64_t()> gSteadyClockSource;
+
+} // namespace
+
+void setSteadyClockSource(std::function<int64_t()> source) {
+    gSteadyClockSource = std::move(source);
+}
+#endif
+
 int64_t getSteadyClockTimeMs() {
+#ifdef VRR_VIRTUAL_STEADY_CLOCK
+    if (gSteadyClockSource) {
+        return gSteadyClockSource() / kMillisecondToNanoSecond;
+    }
+#endif
     return std::chrono::duration_cast<std::chrono::milliseconds>(
                    std::chrono::steady_clock::now().time_since_epoch())
             .count();
 }
 
 int64_t getSteadyClockTimeNs() {
+#ifdef VRR_VIRTUAL_STEADY_CLOCK
+    if (gSteadyClockSource) {
+        return gSteadyClockSource();
+    }
+#endif
     return std::chrono::duration_cast<std::chrono::nanoseconds>(
                    std::chrono::steady_clock::now().time_since_epoch())
             .count();
@@ -19,6 +19,7 @@
 #include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <functional>
 #include "interface/Event.h"
 
 inline void clearBit(uint32_t& data, uint32_t bit) {
@@ -95,6 +96,14 @@ T freqToDurationNs(T freq) {
 int64_t getSteadyClockTimeMs();
 int64_t getSteadyClockTimeNs();
 
+#ifdef VRR_VIRTUAL_STEADY_CLOCK
+// Replaces the steady clock observed by the VRR components, so they can be driven by a virtual
+// clock outside of the composer (e.g. by the refresh rate calculator simulator). Passing an empty
+// function restores the system steady clock. Only built into the host tools, the composer reads
+// the system steady clock directly.
+void setSteadyClockSource(std::function<int64_t()> source);
+#endif
+
 int64_t getBootClockTimeMs();
 int64_t getBootClockTimeNs();
 
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "DisplaySceneInfo.h"
+#include "ExynosLayer.h"
+
+namespace {
+
+/*
+ * Runs the color setting of frames the way the display module does, on layers
+ * without a display. Only the layer setters that do not reach the display are
+ * used, the others are replaced by writing the field and the dirty bit.
+ */
+class DisplaySceneInfoTest : public ::testing::Test {
+protected:
+    DisplaySceneInfoTest() : mFirst(nullptr), mSecond(nullptr) {}
+
+    /* One frame with the layers in the given slots, returns needDisplayColorSetting() */
+    bool frame(const std::vector<ExynosLayer*>& layers, float dimSdrRatio = 1.0f) {
+        mRebuilt = mInfo.updateStats.layersRebuilt;
+        mSkipped = mInfo.updateStats.layersSkipped;
+        mInfo.reset();
+        for (uint32_t i = 0; i < layers.size(); i++) {
+            LayerColorData& data = mInfo.getLayerColorDataInstance(i);
+            EXPECT_EQ(NO_ERROR, mInfo.setLayerDataMappingInfo(layers[i], i));
+            EXPECT_EQ(NO_ERROR, mInfo.setLayerColorData(data, layers[i], dimSdrRatio));
+        }
+        return mInfo.needDisplayColorSetting();
+    }
+
+    /* The last frame rebuilt and skipped that many layers */
+    void expectLayers(uint64_t rebuilt, uint64_t skipped) {
+        EXPECT_EQ(rebuilt, mInfo.updateStats.layersRebuilt - mRebuilt);
+        EXPECT_EQ(skipped, mInfo.updateStats.layersSkipped - mSkipped);
+    }
+
+    static hwc_color_t color(uint8_t r, uint8_t g, uint8_t b, uint8_t a) { return {r, g, b, a}; }
+
+    DisplaySceneInfo mInfo;
+    ExynosLayer mFirst;
+    ExynosLayer mSecond;
+    uint64_t mRebuilt = 0;
+    uint64_t mSkipped = 0;
+};
+
+TEST_F(DisplaySceneInfoTest, UnchangedLayerIsSkipped) {
+    EXPECT_TRUE(frame({&mFirst}));
+    expectLayers(1, 0);
+    EXPECT_EQ(0u, mFirst.mColorDataChanged);
+
+    for (int i = 0; i < 3; i++) {
+        EXPECT_FALSE(frame({&mFirst}));
+        expectLayers(0, 1);
+    }
+    EXPECT_EQ(4u, mInfo.updateStats.frames);
+    EXPECT_EQ(3u, mInfo.updateStats.skippedFrames);
+}
+
+TEST_F(DisplaySceneInfoTest, DirtyLayerIsRebuilt) {
+    EXPECT_TRUE(frame({&mFirst}));
+
+    mFirst.setLayerColor(color(10, 20, 30, 255));
+    EXPECT_TRUE(frame({&mFirst}));
+    expectLayers(1, 0);
+    const LayerColorData& data = mInfo.displayScene.layer_data[0];
+    EXPECT_EQ(10, data.solid_color.r);
+    EXPECT_EQ(30, data.solid_color.b);
+
+    const float matrix[TRANSFORM_MAT_SIZE] = {0.5f, 0, 0, 0, 0, 0.5f, 0, 0,
+                                              0, 0, 0.5f, 0, 0, 0, 0, 1.0f};
+    mFirst.setLayerColorTransform(matrix);
+    EXPECT_TRUE(frame({&mFirst}));
+    expectLayers(1, 0);
+    EXPECT_EQ(0.5f, mInfo.displayScene.layer_data[0].matrix[0]);
+
+    // The same matrix again does not dirty the layer
+    mFirst.setLayerColorTransform(matrix);
+    EXPECT_FALSE(frame({&mFirst}));
+    expectLayers(0, 1);
+}
+
+TEST_F(DisplaySceneInfoTest, DirtyLayerWithSameDataNeedsNoSetting) {
+    EXPECT_TRUE(frame({&mFirst}));
+
+    // Rebuilt, but the color data comes out the same
+    mFirst.setColorDataChanged(LAYER_COLOR_DATASPACE_CHANGED);
+    EXPECT_FALSE(frame({&mFirst}));
+    expectLayers(1, 0);
+
+    mFirst.mDataSpace = HAL_DATASPACE_DISPLAY_P3;
+    mFirst.setColorDataChanged(LAYER_COLOR_DATASPACE_CHANGED);
+    EXPECT_TRUE(frame({&mFirst}));
+    EXPECT_EQ(static_cast<hwc::Dataspace>(HAL_DATASPACE_DISPLAY_P3),
+              mInfo.displayScene.layer_data[0].dataspace);
+}
+
+TEST_F(DisplaySceneInfoTest, ReusedSlotIsRebuilt) {
+    mFirst.setLayerColor(color(255, 0, 0, 255));
+    mSecond.setLayerColor(color(0, 0, 255, 255));
+    EXPECT_TRUE(frame({&mFirst, &mSecond}));
+    expectLayers(2, 0);
+
+    // Neither layer is dirty, but each slot now holds the data of the other one
+    EXPECT_TRUE(frame({&mSecond, &mFirst}));
+    expectLayers(2, 0);
+    EXPECT_EQ(0, mInfo.displayScene.layer_data[0].solid_color.r);
+    EXPECT_EQ(255, mInfo.displayScene.layer_data[1].solid_color.r);
+
+    EXPECT_FALSE(frame({&mSecond, &mFirst}));
+    expectLayers(0, 2);
+
+    // A slot dropped by the caller is rebuilt when it comes back
+    mInfo.displayScene.layer_data.resize(1);
+    EXPECT_TRUE(frame({&mSecond, &mFirst}));
+    expectLayers(1, 1);
+    EXPECT_EQ(255, mInfo.displayScene.layer_data[1].solid_color.r);
+}
+
+TEST_F(DisplaySceneInfoTest, DimRatioChangeIsRebuilt) {
+    EXPECT_TRUE(frame({&mFirst}));
+
+    EXPECT_TRUE(frame({&mFirst}, 0.5f));
+    expectLayers(1, 0);
+    EXPECT_EQ(0.5f, mInfo.displayScene.layer_data[0].matrix[0]);
+
+    EXPECT_FALSE(frame({&mFirst}, 0.5f));
+    expectLayers(0, 1);
+}
+
+TEST_F(DisplaySceneInfoTest, DirectlyWrittenFieldsAreCompared) {
+    EXPECT_TRUE(frame({&mFirst}));
+    EXPECT_FALSE(frame({&mFirst}));
+
+    mInfo.displayScene.dbv = 1000;
+    EXPECT_TRUE(frame({&mFirst}));
+    EXPECT_FALSE(frame({&mFirst}));
+
+    mInfo.displayScene.refresh_rate = 90.0f;
+    mInfo.displayScene.hdr_layer_state = HdrLayerState::kHdrLarge;
+    EXPECT_TRUE(frame({&mFirst}));
+    EXPECT_FALSE(frame({&mFirst}));
+
+    mInfo.displayScene.layer_data[0].enabled = false;
+    EXPECT_TRUE(frame({&mFirst}));
+    EXPECT_FALSE(frame({&mFirst}));
+
+    // Writing the same value back is no change
+    mInfo.displayScene.dbv = 1000;
+    EXPECT_FALSE(frame({&mFirst}));
+}
+
+TEST_F(DisplaySceneInfoTest, InvalidatedSettingIsApplied) {
+    EXPECT_TRUE(frame({&mFirst}));
+    EXPECT_FALSE(frame({&mFirst}));
+
+    mInfo.invalidateColorSetting();
+    EXPECT_TRUE(frame({&mFirst}));
+    EXPECT_FALSE(frame({&mFirst}));
+
+    // The first frame after clear() rebuilds everything
+    mInfo.clear();
+    EXPECT_TRUE(frame({&mFirst}));
+    expectLayers(1, 0);
+}
+
+} // namespace
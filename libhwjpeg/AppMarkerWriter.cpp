@@ -43,11 +43,20 @@ CEndianessChecker::CEndianessChecker() {
 }
 
 CAppMarkerWriter::CAppMarkerWriter()
-      : m_pAppBase(NULL), m_pApp1End(NULL), m_pExif(NULL), m_pExtra(NULL) {
+      : m_pAppBase(NULL),
+        m_pApp1End(NULL),
+        m_pExif(NULL),
+        m_pExtra(NULL),
+        m_szThumbSizeOffset(0),
+        m_bUseExifTemplate(true) {
+    memset(&m_ExifLayout, 0, sizeof(m_ExifLayout));
     Init();
 }
 
-CAppMarkerWriter::CAppMarkerWriter(char *base, exif_attribute_t *exif, debug_attribute_t *debug) {
+CAppMarkerWriter::CAppMarkerWriter(char *base, exif_attribute_t *exif, debug_attribute_t *debug)
+      : m_szThumbSizeOffset(0), m_bUseExifTemplate(false) {
+    memset(&m_ExifLayout, 0, sizeof(m_ExifLayout));
+
     extra_appinfo_t extraInfo;
     app_info_t appInfo[15];
 
@@ -316,9 +325,67 @@ char *CAppMarkerWriter::WriteAPPX(char *current, bool just_reserve) {
     return current;
 }
 
+void CAppMarkerWriter::GetExifLayout(ExifLayout *layout, bool reserve_thumbnail_space) {
+    // memcmp() compares the padding too
+    memset(layout, 0, sizeof(*layout));
+
+    layout->szApp1 = m_szApp1;
+    layout->n0thIFDFields = m_n0thIFDFields;
+    layout->n1stIFDFields = m_n1stIFDFields;
+    layout->nExifIFDFields = m_nExifIFDFields;
+    layout->nGPSIFDFields = m_nGPSIFDFields;
+    layout->szMake = m_szMake;
+    layout->szSoftware = m_szSoftware;
+    layout->szModel = m_szModel;
+    layout->szUniqueID = m_szUniqueID;
+    layout->szMakerNote = m_pExif->maker_note_size;
+    layout->szUserComment = m_pExif->user_comment_size;
+    if (m_pExif->enableGps) layout->szGPSProcessingMethod = strlen(m_pExif->gps_processing_method);
+    layout->reserveThumbnailSpace = reserve_thumbnail_space;
+}
+
+/*
+ * Writes APP1 from the template if the layout is the same as that of the
+ * previous image: only the values that changed are patched into the template
+ * which is then copied to base. Otherwise APP1 is written from scratch and
+ * kept as the template for the next images.
+ */
+char *CAppMarkerWriter::WriteExif(char *base, bool reserve_thumbnail_space) {
+    if (!m_pExif) return base;
+
+    if (!m_bUseExifTemplate) return WriteAPP1(base, reserve_thumbnail_space);
+
+    // As WriteAPP1() reserves it
+    const size_t thumbspace = (reserve_thumbnail_space && m_pExif->enableThumb)
+            ? m_szMaxThumbSize + JPEG_APP1_OEM_RESERVED
+            : 0;
+    ExifLayout layout;
+    GetExifLayout(&layout, reserve_thumbnail_space);
+
+    if ((m_ExifTemplate.GetSize() > 0) && !memcmp(&layout, &m_ExifLayout, sizeof(layout))) {
+        WriteAPP1(m_ExifTemplate.BeginPatching(), reserve_thumbnail_space);
+        m_ExifTemplate.EndPatching();
+
+        memcpy(base, m_ExifTemplate.GetData(), m_ExifTemplate.GetSize());
+        m_pThumbSizePlaceholder = m_pExif->enableThumb ? base + m_szThumbSizeOffset : NULL;
+        return base + m_ExifTemplate.GetSize() + thumbspace;
+    }
+
+    m_ExifTemplate.BeginRecording(base);
+    char *end = WriteAPP1(base, reserve_thumbnail_space);
+    m_ExifTemplate.EndRecording(PTR_DIFF(base, end) - thumbspace);
+
+    m_ExifLayout = layout;
+    m_szThumbSizeOffset = m_pThumbSizePlaceholder ? PTR_DIFF(base, m_pThumbSizePlaceholder) : 0;
+
+    return end;
+}
+
 char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, bool updating) {
     if (!m_pExif) return current;
 
+    char *app1 = current;
+
     // APP1 Marker
     *current++ = 0xFF;
     *current++ = 0xE1;
@@ -338,7 +405,7 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
     char *tiffheader = current;
     for (size_t i = 0; i < ARRSIZE(TiffHeader); i++) *current++ = TiffHeader[i];
 
-    CIFDWriter writer(tiffheader, current, m_n0thIFDFields);
+    CIFDWriter writer(tiffheader, current, m_n0thIFDFields, &m_ExifTemplate);
 
     writer.WriteShort(EXIF_TAG_ORIENTATION, 1, &m_pExif->orientation);
     writer.WriteShort(EXIF_TAG_YCBCR_POSITIONING, 1, &m_pExif->ycbcr_positioning);
@@ -352,7 +419,7 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
 
     char *pSubIFDBase = writer.BeginSubIFD(EXIF_TAG_EXIF_IFD_POINTER);
     if (pSubIFDBase) { // This should be always true!!
-        CIFDWriter exifwriter(tiffheader, pSubIFDBase, m_nExifIFDFields);
+        CIFDWriter exifwriter(tiffheader, pSubIFDBase, m_nExifIFDFields, &m_ExifTemplate);
         exifwriter.WriteRational(EXIF_TAG_EXPOSURE_TIME, 1, &m_pExif->exposure_time);
         exifwriter.WriteRational(EXIF_TAG_FNUMBER, 1, &m_pExif->fnumber);
         exifwriter.WriteShort(EXIF_TAG_EXPOSURE_PROGRAM, 1, &m_pExif->exposure_program);
@@ -402,7 +469,7 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
             exifwriter.WriteASCII(EXIF_TAG_IMAGE_UNIQUE_ID, m_szUniqueID + 1, m_pExif->unique_id);
         pSubIFDBase = exifwriter.BeginSubIFD(EXIF_TAG_INTEROPERABILITY);
         if (pSubIFDBase) {
-            CIFDWriter interopwriter(tiffheader, pSubIFDBase, 2);
+            CIFDWriter interopwriter(tiffheader, pSubIFDBase, 2, &m_ExifTemplate);
             interopwriter.WriteASCII(EXIF_TAG_INTEROPERABILITY_INDEX, 4,
                                      m_pExif->interoperability_index ? "THM" : "R98");
             interopwriter.WriteUndef(EXIF_TAG_INTEROPERABILITY_VERSION, 4,
@@ -421,7 +488,7 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
     if (m_pExif->enableGps) {
         pSubIFDBase = writer.BeginSubIFD(EXIF_TAG_GPS_IFD_POINTER);
         if (pSubIFDBase) { // This should be always true!!
-            CIFDWriter gpswriter(tiffheader, pSubIFDBase, m_nGPSIFDFields);
+            CIFDWriter gpswriter(tiffheader, pSubIFDBase, m_nGPSIFDFields, &m_ExifTemplate);
             gpswriter.WriteByte(EXIF_TAG_GPS_VERSION_ID, 4, m_pExif->gps_version_id);
             gpswriter.WriteASCII(EXIF_TAG_GPS_LATITUDE_REF, 2, m_pExif->gps_latitude_ref);
             gpswriter.WriteRational(EXIF_TAG_GPS_LATITUDE, 3, m_pExif->gps_latitude);
@@ -457,14 +524,15 @@ char *CAppMarkerWriter::WriteAPP1(char *current, bool reserve_thumbnail_space, b
     if (m_pExif->enableThumb) {
         writer.Finish(false);
 
-        CIFDWriter thumbwriter(tiffheader, writer.GetNextIFDBase(), m_n1stIFDFields);
+        CIFDWriter thumbwriter(tiffheader, writer.GetNextIFDBase(), m_n1stIFDFields,
+                               &m_ExifTemplate);
         thumbwriter.WriteLong(EXIF_TAG_IMAGE_WIDTH, 1, &m_pExif->widthThumb);
         thumbwriter.WriteLong(EXIF_TAG_IMAGE_HEIGHT, 1, &m_pExif->heightThumb);
         thumbwriter.WriteShort(EXIF_TAG_COMPRESSION_SCHEME, 1, &m_pExif->compression_scheme);
         thumbwriter.WriteShort(EXIF_TAG_ORIENTATION, 1, &m_pExif->orientation);
 
-        ALOG_ASSERT(thumbwriter.GetNextIFDBase() != m_pThumbBase);
-        uint32_t offset = thumbwriter.Offset(m_pThumbBase);
+        // Not thumbwriter.Offset(m_pThumbBase), current may be the template
+        uint32_t offset = PTR_DIFF(m_pAppBase, m_pThumbBase) - PTR_DIFF(app1, tiffheader);
         thumbwriter.WriteLong(EXIF_TAG_JPEG_INTERCHANGE_FORMAT, 1, &offset);
         offset = 0; // temporarilly 0 byte
         thumbwriter.WriteLong(EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LEN, 1, &offset);
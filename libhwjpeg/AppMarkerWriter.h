@@ -46,7 +46,27 @@
 #define EXIF_DATETIME_LENGTH 20
 #define EXIF_GPSDATESTAMP_LENGTH 11
 
+#include "IFDWriter.h"
+
 class CAppMarkerWriter {
+    // Everything the layout of APP1 depends on. The Exif template is reused
+    // while it does not change.
+    struct ExifLayout {
+        uint16_t szApp1;
+        uint16_t n0thIFDFields;
+        uint16_t n1stIFDFields;
+        uint16_t nExifIFDFields;
+        uint16_t nGPSIFDFields;
+        uint32_t szMake;
+        uint32_t szSoftware;
+        uint32_t szModel;
+        uint32_t szUniqueID;
+        uint32_t szMakerNote;
+        uint32_t szUserComment;
+        uint32_t szGPSProcessingMethod;
+        bool reserveThumbnailSpace;
+    };
+
     char *m_pAppBase;
     char *m_pApp1End;
     size_t m_szMaxThumbSize; // Maximum available thumbnail stream size minus JPEG_MARKER_SIZE
@@ -72,8 +92,18 @@ class CAppMarkerWriter {
     // Note that the address may not be aligned by 32-bit.
     char *m_pThumbSizePlaceholder;
 
+    // APP1 segment of the last layout, which the fields of the next images
+    // with the same layout are patched into.
+    CIFDTemplate m_ExifTemplate;
+    ExifLayout m_ExifLayout;
+    // Offset of m_pThumbSizePlaceholder in the template
+    size_t m_szThumbSizeOffset;
+    bool m_bUseExifTemplate;
+
     void Init();
 
+    void GetExifLayout(ExifLayout *layout, bool reserve_thumbnail_space);
+    char *WriteExif(char *base, bool reserve_thumbnail_space);
     char *WriteAPP1(char *base, bool reserve_thumbnail_space, bool updating = false);
     char *WriteAPPX(char *base, bool just_reserve);
     char *WriteAPP11(char *current, size_t dummy, size_t align);
@@ -120,7 +150,7 @@ public:
 
     void Write(bool reserve_thumbnail_space, size_t dummy, size_t align,
                bool reserve_debug = false) {
-        m_pApp1End = WriteAPP1(m_pAppBase, reserve_thumbnail_space);
+        m_pApp1End = WriteExif(m_pAppBase, reserve_thumbnail_space);
         char *appXend = WriteAPPX(m_pApp1End, reserve_debug);
         char *app11end = WriteAPP11(appXend, dummy, align);
         m_szApp11 = PTR_DIFF(appXend, app11end);
@@ -129,6 +159,15 @@ public:
 
     void Update() { WriteAPP1(m_pAppBase, false, true); }
 
+    // Writes APP1 from scratch for every image if disabled
+    void UseExifTemplate(bool use) {
+        m_bUseExifTemplate = use;
+        if (!use) m_ExifTemplate.Reset();
+    }
+    // The number of fields that changed from the previous image, valid after
+    // Write() if the template was reused.
+    size_t GetPatchedFieldCount() { return m_ExifTemplate.GetPatchedCount(); }
+
     bool IsThumbSpaceReserved() {
         return PTR_DIFF(m_pAppBase, m_pApp1End) ==
                 (m_szApp1 + m_szMaxThumbSize + JPEG_APP1_OEM_RESERVED + JPEG_MARKER_SIZE);
@@ -74,7 +74,11 @@ ExynosJpegEncoderForCamera::ExynosJpegEncoderForCamera(bool bBTBComp)
         m_nThumbHeight(0),
         m_nThumbQuality(0),
         m_pStreamBase(NULL),
-        m_fThumbBufferType(0) {
+        m_fThumbBufferType(0),
+        m_bWorkerStarted(false),
+        m_bWorkerExit(false),
+        m_iThumbJob(THUMB_JOB_NONE),
+        m_szThumbJobResult(0) {
     m_pAppWriter = new CAppMarkerWriter();
     if (!m_pAppWriter) {
         ALOGE("Failed to allocated an instance of CAppMarkerWriter");
@@ -112,6 +116,8 @@ ExynosJpegEncoderForCamera::ExynosJpegEncoderForCamera(bool bBTBComp)
 }
 
 ExynosJpegEncoderForCamera::~ExynosJpegEncoderForCamera() {
+    StopThumbnailWorker();
+
     GetCompressor().Release();
 
     delete m_pAppWriter;
@@ -212,8 +218,76 @@ size_t ExynosJpegEncoderForCamera::RemoveTrailingDummies(char* base, size_t len)
 void* ExynosJpegEncoderForCamera::tCompressThumbnail(void* p) {
     ExynosJpegEncoderForCamera* encoder = reinterpret_cast<ExynosJpegEncoderForCamera*>(p);
 
-    size_t thumblen = encoder->CompressThumbnail();
-    return reinterpret_cast<void*>(thumblen);
+    encoder->ThumbnailWorkerLoop();
+    return NULL;
+}
+
+void ExynosJpegEncoderForCamera::ThumbnailWorkerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutexWorker);
+
+    for (;;) {
+        m_condWorker.wait(lock, [this] { return m_bWorkerExit || m_iThumbJob == THUMB_JOB_QUEUED; });
+        if (m_bWorkerExit) break;
+
+        lock.unlock();
+        size_t thumblen = CompressThumbnail();
+        lock.lock();
+
+        m_szThumbJobResult = thumblen;
+        m_iThumbJob = THUMB_JOB_DONE;
+        m_condWorker.notify_all();
+    }
+}
+
+bool ExynosJpegEncoderForCamera::QueueThumbnailJob() {
+    std::unique_lock<std::mutex> lock(m_mutexWorker);
+
+    if (!m_bWorkerStarted) {
+        if (pthread_create(&m_threadWorker, NULL, tCompressThumbnail,
+                           reinterpret_cast<void*>(this)) != 0) {
+            ALOGERR("Failed to create thumbnail generation thread");
+            return false;
+        }
+        m_bWorkerStarted = true;
+    }
+
+    // A previous capture may have failed before collecting its thumbnail.
+    m_condWorker.wait(lock, [this] { return m_iThumbJob != THUMB_JOB_QUEUED; });
+
+    m_iThumbJob = THUMB_JOB_QUEUED;
+    m_condWorker.notify_all();
+
+    return true;
+}
+
+size_t ExynosJpegEncoderForCamera::WaitForThumbnailJob() {
+    std::unique_lock<std::mutex> lock(m_mutexWorker);
+
+    m_condWorker.wait(lock, [this] { return m_iThumbJob != THUMB_JOB_QUEUED; });
+    if (m_iThumbJob == THUMB_JOB_NONE) {
+        ALOGE("No thumbnail generation has been requested");
+        return 0;
+    }
+
+    m_iThumbJob = THUMB_JOB_NONE;
+
+    return m_szThumbJobResult;
+}
+
+void ExynosJpegEncoderForCamera::StopThumbnailWorker() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutexWorker);
+
+        if (!m_bWorkerStarted) return;
+
+        m_bWorkerExit = true;
+        m_condWorker.notify_all();
+    }
+
+    int ret = pthread_join(m_threadWorker, NULL);
+    if (ret != 0) ALOGERR("Failed to wait thumbnail thread(%d)", ret);
+
+    m_bWorkerStarted = false;
 }
 
 bool ExynosJpegEncoderForCamera::ProcessExif(char* base, size_t limit, exif_attribute_t* exifInfo,
@@ -283,11 +357,7 @@ bool ExynosJpegEncoderForCamera::PrepareCompression(bool thumbnail) {
     if (!thumbnail) return true;
 
     if (IsThumbGenerationNeeded()) {
-        if (pthread_create(&m_threadWorker, NULL, tCompressThumbnail,
-                           reinterpret_cast<void*>(this)) != 0) {
-            ALOGERR("Failed to create thumbnail generation thread");
-            return false;
-        }
+        if (!QueueThumbnailJob()) return false;
     } else {
         // allocate temporary thumbnail stream buffer
         // to prevent overflow of the compressed stream
@@ -457,17 +527,9 @@ ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thu
 
     if (thumbbase) {
         if (IsThumbGenerationNeeded()) {
-            void* len;
-            int ret = pthread_join(m_threadWorker, &len);
-            if (ret != 0) {
-                ALOGERR("Failed to wait thumbnail thread(%d)", ret);
-                return -1;
-            }
-
-            if (len == NULL)
+            thumblen = WaitForThumbnailJob();
+            if (thumblen == 0)
                 ALOGE("Error occurred during thumbnail creation: no thumbnail is embedded");
-
-            thumblen = reinterpret_cast<size_t>(len);
         } else if (TestState(STATE_NO_BTBCOMP) || !IsBTBCompressionSupported()) {
             thumblen = CompressThumbnailOnly(m_pAppWriter->GetMaxThumbnailSize(), m_nThumbQuality,
                                              getColorFormat(), checkInBufType());
@@ -17,6 +17,8 @@
 #ifndef __HARDWARE_SAMSUNG_SLSI_EXYNOS_IFDWRITER_H__
 #define __HARDWARE_SAMSUNG_SLSI_EXYNOS_IFDWRITER_H__
 
+#include <vector>
+
 #include "hwjpeg-internal.h"
 
 class CEndianessChecker {
@@ -72,11 +74,107 @@ char *WriteData(char *p, T val) {
     return p;
 }
 
+/*
+ * A compiled IFD structure: the bytes CIFDWriter wrote for a layout of the
+ * fields and where the value of each field is in them.
+ *
+ * While recording, CIFDWriter writes as usual and notes where the values go.
+ * While patching, it writes nothing but the values, in the same order, and
+ * only the values that differ from the ones in the template are copied.
+ */
+class CIFDTemplate {
+    enum { IDLE, RECORDING, PATCHING } m_state;
+    char *m_pBase;
+    // Offset from m_pBase and length of the value of each field
+    std::vector<std::pair<uint32_t, uint32_t>> m_slots;
+    std::vector<char> m_data;
+    size_t m_nextSlot;
+    size_t m_nPatched;
+
+public:
+    CIFDTemplate() : m_state(IDLE), m_pBase(NULL), m_nextSlot(0), m_nPatched(0) {}
+
+    void BeginRecording(char *base) {
+        m_state = RECORDING;
+        m_pBase = base;
+        m_slots.clear();
+        m_data.clear();
+    }
+
+    // Keeps size bytes from the base given to BeginRecording() as the template
+    void EndRecording(size_t size) {
+        m_data.assign(m_pBase, m_pBase + size);
+        m_state = IDLE;
+        m_pBase = NULL;
+    }
+
+    // Returns the bytes of the template to write the fields over
+    char *BeginPatching() {
+        m_state = PATCHING;
+        m_pBase = m_data.data();
+        m_nextSlot = 0;
+        m_nPatched = 0;
+        return m_pBase;
+    }
+
+    void EndPatching() {
+        ALOG_ASSERT(m_nextSlot == m_slots.size());
+        m_state = IDLE;
+        m_pBase = NULL;
+    }
+
+    void Reset() {
+        m_state = IDLE;
+        m_slots.clear();
+        m_data.clear();
+    }
+
+    bool IsPatching() const { return m_state == PATCHING; }
+    const char *GetData() const { return m_data.data(); }
+    size_t GetSize() const { return m_data.size(); }
+    // The number of fields that differed at the last patching
+    size_t GetPatchedCount() const { return m_nPatched; }
+
+    void Record(const char *value, uint32_t size) {
+        if (m_state == RECORDING)
+            m_slots.emplace_back(static_cast<uint32_t>(PTR_DIFF(m_pBase, value)), size);
+    }
+
+    void Patch(const void *value, uint32_t size) {
+        char *target = NextSlot(size);
+        if (memcmp(target, value, size) != 0) {
+            memcpy(target, value, size);
+            m_nPatched++;
+        }
+    }
+
+    // ASCII values of count bytes, terminated by '\0' at the last byte or,
+    // if cstring, at the end of the string
+    void PatchString(const char *string, uint32_t count, bool cstring) {
+        char *target = NextSlot(count);
+        const uint32_t len = cstring ? strnlen(string, count - 1) : count - 1;
+        bool same = memcmp(target, string, len) == 0;
+        for (uint32_t i = len; same && (i < count); i++) same = target[i] == '\0';
+        if (same) return;
+
+        memcpy(target, string, len);
+        memset(target + len, 0, count - len);
+        m_nPatched++;
+    }
+
+private:
+    char *NextSlot(uint32_t size __UNUSED__) {
+        ALOG_ASSERT(m_nextSlot < m_slots.size() && m_slots[m_nextSlot].second == size);
+        return m_pBase + m_slots[m_nextSlot++].first;
+    }
+};
+
 class CIFDWriter {
     char *m_pBase;
     char *m_pIFDBase;
     char *m_pValue;
     unsigned int m_nTags;
+    CIFDTemplate *m_pTemplate;
 
     char *WriteOffset(char *target, char *addr) {
         uint32_t val = Offset(addr);
@@ -106,13 +204,23 @@ class CIFDWriter {
         m_nTags--;
     }
 
+    bool IsPatching() { return m_pTemplate && m_pTemplate->IsPatching(); }
+
+    void RecordValue(const char *value, uint32_t size) {
+        if (m_pTemplate) m_pTemplate->Record(value, size);
+    }
+
 public:
-    CIFDWriter(char *offset_base, char *ifdbase, uint16_t tagcount) {
+    CIFDWriter(char *offset_base, char *ifdbase, uint16_t tagcount,
+               CIFDTemplate *tmpl = NULL) {
         m_nTags = tagcount;
         m_pBase = offset_base;
         m_pIFDBase = ifdbase;
         m_pValue = m_pIFDBase + IFD_FIELDCOUNT_SIZE + IFD_FIELD_SIZE * tagcount +
                 IFD_NEXTIFDOFFSET_SIZE;
+        m_pTemplate = tmpl;
+
+        if (IsPatching()) return;
 
         // COUNT field of IFD
         const char *pval = reinterpret_cast<char *>(&m_nTags);
@@ -127,14 +235,21 @@ public:
     void WriteByte(uint16_t tag, uint32_t count, const uint8_t value[]) {
         ALOG_ASSERT(m_nTags == 0);
 
+        if (IsPatching()) {
+            m_pTemplate->Patch(value, count);
+            return;
+        }
+
         WriteTagTypeCount(tag, EXIF_TYPE_BYTE, count);
 
         if (count > IFD_VALOFF_SIZE) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            RecordValue(m_pValue, count);
             for (uint32_t i = 0; i < count; i++) {
                 *m_pValue++ = static_cast<char>(value[i]);
             }
         } else {
+            RecordValue(m_pIFDBase, count);
             for (uint32_t i = 0; i < count; i++) *m_pIFDBase++ = static_cast<char>(value[i]);
             m_pIFDBase += IFD_VALOFF_SIZE - count;
         }
@@ -143,17 +258,24 @@ public:
     void WriteShort(uint16_t tag, uint32_t count, const uint16_t value[]) {
         ALOG_ASSERT(m_nTags == 0);
 
+        if (IsPatching()) {
+            m_pTemplate->Patch(value, count * sizeof(value[0]));
+            return;
+        }
+
         WriteTagTypeCount(tag, EXIF_TYPE_SHORT, count);
 
         const char *p = reinterpret_cast<const char *>(&value[0]);
 
         if (count > (IFD_VALOFF_SIZE / sizeof(value[0]))) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            RecordValue(m_pValue, count * sizeof(value[0]));
             for (uint32_t i = 0; i < count; i++) {
                 *m_pValue++ = *p++;
                 *m_pValue++ = *p++;
             }
         } else {
+            RecordValue(m_pIFDBase, count * sizeof(value[0]));
             for (uint32_t i = 0; i < count; i++) {
                 *m_pIFDBase++ = *p++;
                 *m_pIFDBase++ = *p++;
@@ -165,13 +287,22 @@ public:
     void WriteLong(uint16_t tag, uint32_t count, const uint32_t value[]) {
         ALOG_ASSERT(m_nTags == 0);
 
+        // Only the first byte of more than one value is written
+        const bool inline_value = count <= (IFD_VALOFF_SIZE / sizeof(value[0]));
+        if (IsPatching()) {
+            m_pTemplate->Patch(value, inline_value ? sizeof(value[0]) : 1);
+            return;
+        }
+
         WriteTagTypeCount(tag, EXIF_TYPE_LONG, count);
 
         const char *p = reinterpret_cast<const char *>(&value[0]);
-        if (count > (IFD_VALOFF_SIZE / sizeof(value[0]))) {
+        if (!inline_value) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            RecordValue(m_pValue, 1);
             *m_pValue++ = *p++;
         } else {
+            RecordValue(m_pIFDBase, sizeof(value[0]));
             *m_pIFDBase++ = *p++;
             *m_pIFDBase++ = *p++;
             *m_pIFDBase++ = *p++;
@@ -182,14 +313,21 @@ public:
     void WriteASCII(uint16_t tag, uint32_t count, const char *value) {
         ALOG_ASSERT(m_nTags == 0);
 
+        if (IsPatching()) {
+            m_pTemplate->PatchString(value, count, false);
+            return;
+        }
+
         WriteTagTypeCount(tag, EXIF_TYPE_ASCII, count);
 
         if (count > IFD_VALOFF_SIZE) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            RecordValue(m_pValue, count);
             memcpy(m_pValue, value, count);
             m_pValue[count - 1] = '\0';
             m_pValue += count;
         } else {
+            RecordValue(m_pIFDBase, count);
             for (uint32_t i = 0; i < count; i++) *m_pIFDBase++ = value[i];
             *(m_pIFDBase - 1) = '\0';
             m_pIFDBase += IFD_VALOFF_SIZE - count;
@@ -199,16 +337,24 @@ public:
     void WriteCString(uint16_t tag, uint32_t count, const char *string) {
         ALOG_ASSERT(m_nTags == 0);
 
+        if (IsPatching()) {
+            m_pTemplate->PatchString(string, count, true);
+            return;
+        }
+
         WriteTagTypeCount(tag, EXIF_TYPE_ASCII, count);
 
         if (count > IFD_VALOFF_SIZE) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            RecordValue(m_pValue, count);
             strncpy(m_pValue, string, count);
             m_pValue[count - 1] = '\0';
             m_pValue += count;
         } else {
             uint32_t i;
 
+            RecordValue(m_pIFDBase, count);
+
             for (i = 0; (i < (count - 1)) && (string[i] != '\0'); i++) *m_pIFDBase++ = string[i];
 
             while (i++ < count) *m_pIFDBase++ = '\0';
@@ -220,8 +366,15 @@ public:
     void WriteRational(uint16_t tag, uint32_t count, const rational_t value[]) {
         ALOG_ASSERT(m_nTags == 0);
 
+        // The numerators and the denominators are written as they are in value
+        if (IsPatching()) {
+            m_pTemplate->Patch(value, sizeof(rational_t) * count);
+            return;
+        }
+
         WriteTagTypeCount(tag, EXIF_TYPE_RATIONAL, count);
         m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+        RecordValue(m_pValue, sizeof(rational_t) * count);
 
         for (uint32_t i = 0; i < count; i++) {
             const char *pt;
@@ -241,8 +394,14 @@ public:
     void WriteSRational(uint16_t tag, uint32_t count, const srational_t value[]) {
         ALOG_ASSERT(m_nTags == 0);
 
+        if (IsPatching()) {
+            m_pTemplate->Patch(value, sizeof(srational_t) * count);
+            return;
+        }
+
         WriteTagTypeCount(tag, EXIF_TYPE_SRATIONAL, count);
         m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+        RecordValue(m_pValue, sizeof(srational_t) * count);
 
         const char *pt = reinterpret_cast<const char *>(value);
         for (uint32_t i = 0; i < sizeof(srational_t) * count; i++) *m_pValue++ = *pt++;
@@ -251,12 +410,19 @@ public:
     void WriteUndef(uint16_t tag, uint32_t count, const unsigned char *value) {
         ALOG_ASSERT(m_nTags == 0);
 
+        if (IsPatching()) {
+            m_pTemplate->Patch(value, count);
+            return;
+        }
+
         WriteTagTypeCount(tag, EXIF_TYPE_UNDEFINED, count);
         if (count > IFD_VALOFF_SIZE) {
             m_pIFDBase = WriteOffset(m_pIFDBase, m_pValue);
+            RecordValue(m_pValue, count);
             memcpy(m_pValue, value, count);
             m_pValue += count;
         } else {
+            RecordValue(m_pIFDBase, count);
             for (uint32_t i = 0; i < count; i++) *m_pIFDBase++ = static_cast<char>(value[i]);
             m_pIFDBase += IFD_VALOFF_SIZE - count;
         }
@@ -265,6 +431,9 @@ public:
     char *BeginSubIFD(uint16_t tag) {
         ALOG_ASSERT(m_nTags == 0);
 
+        // The offsets to the sub IFDs are a part of the layout
+        if (IsPatching()) return m_pValue;
+
         WriteTagTypeCount(tag, EXIF_TYPE_LONG, 1);
 
         uint32_t offset = Offset(m_pValue);
@@ -283,6 +452,8 @@ public:
     void Finish(bool last) {
         ALOG_ASSERT(m_nTags > 0);
 
+        if (IsPatching()) return;
+
         uint32_t offset = last ? 0 : Offset(m_pValue);
         const char *pv = reinterpret_cast<char *>(&offset);
         *m_pIFDBase++ = *pv++;
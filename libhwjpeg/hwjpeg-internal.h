@@ -86,6 +86,9 @@ public:
     unsigned long GetElapsedUpdate();
 };
 
+// Converts chroma subsampling factors to V4L2_JPEG_CHROMA_SUBSAMPLING_*
+bool GetV4L2ChromaSubsampling(unsigned int horizontal, unsigned int vertical, int *value);
+
 bool WriteToFile(const char *path, const char *data, size_t len);
 bool WriteToFile(const char *path, int dmabuf, size_t len);
 #endif //__HWJPEG_INTERNAL_H__
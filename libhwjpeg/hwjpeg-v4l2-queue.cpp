@@ -0,0 +1,499 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <exynos-hwjpeg.h>
+#include <linux/v4l2-controls.h>
+#include <linux/videodev2.h>
+
+#include "hwjpeg-internal.h"
+
+static unsigned long ElapsedUsec(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                 since)
+            .count();
+}
+
+CHWJpegV4L2EncodeQueue::CHWJpegV4L2EncodeQueue(unsigned int depth, const char *path)
+      : CHWJpegBase(path),
+        m_uiDepth(depth > 0 ? depth : 1),
+        m_lNextJobId(0),
+        m_bConfigured(false),
+        m_uiNumPlanes(0),
+        m_bStreaming(false),
+        m_bReqBufs(false),
+        m_bLocked(false),
+        m_uiQueued(0),
+        m_uiNextSlot(0),
+        m_bExit(false),
+        file_lock_(GetDeviceFD()) {
+    memset(&m_stats, 0, sizeof(m_stats));
+    memset(&m_current, 0, sizeof(m_current));
+    memset(m_uiPlaneSizes, 0, sizeof(m_uiPlaneSizes));
+
+    m_slots.resize(m_uiDepth);
+
+    ALOGD("CHWJpegV4L2EncodeQueue Created: %p, FD %d, depth %u", this, GetDeviceFD(), m_uiDepth);
+}
+
+CHWJpegV4L2EncodeQueue::~CHWJpegV4L2EncodeQueue() {
+    Stop();
+
+    ALOGD("CHWJpegV4L2EncodeQueue Destroyed: %p, FD %d", this, GetDeviceFD());
+}
+
+int CHWJpegV4L2EncodeQueue::DeviceIoctl(unsigned long request, void *arg) {
+    return ioctl(GetDeviceFD(), request, arg);
+}
+
+long CHWJpegV4L2EncodeQueue::QueueJob(const hwjpeg_encode_job &job, Callback callback) {
+    if (!Okay()) {
+        ALOGE("Unable to queue a job to the unopened device");
+        return -1;
+    }
+
+    if (job.num_buffers < 1 || job.num_buffers > ARRSIZE(job.buffers)) {
+        ALOGE("Invalid number of image buffers %u", job.num_buffers);
+        return -1;
+    }
+
+    std::unique_ptr<Job> entry(new Job);
+    entry->params = job;
+    entry->callback = std::move(callback);
+    entry->submitted = std::chrono::steady_clock::now();
+    entry->wait_time = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_worker.joinable()) m_worker = std::thread(&CHWJpegV4L2EncodeQueue::Worker, this);
+
+    long id = m_lNextJobId++;
+    entry->id = id;
+    m_pending.push_back(std::move(entry));
+    m_stats.submitted++;
+
+    m_condJob.notify_all();
+
+    return id;
+}
+
+void CHWJpegV4L2EncodeQueue::Flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_condIdle.wait(lock, [this] {
+        return m_stats.submitted == m_stats.completed + m_stats.failed;
+    });
+}
+
+void CHWJpegV4L2EncodeQueue::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_worker.joinable()) return;
+
+        m_bExit = true;
+        m_condJob.notify_all();
+    }
+
+    // The worker completes the submitted jobs before it exits
+    m_worker.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_bExit = false;
+    ResetStream();
+}
+
+CHWJpegV4L2EncodeQueue::Stats CHWJpegV4L2EncodeQueue::GetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_stats;
+}
+
+bool CHWJpegV4L2EncodeQueue::IsCompatible(const hwjpeg_encode_job &params) {
+    return m_bConfigured && (m_current.v4l2_fmt == params.v4l2_fmt) &&
+            (m_current.width == params.width) && (m_current.height == params.height) &&
+            (m_current.quality == params.quality) && (m_current.chroma_h == params.chroma_h) &&
+            (m_current.chroma_v == params.chroma_v);
+}
+
+bool CHWJpegV4L2EncodeQueue::ReqBufs(unsigned int count) {
+    v4l2_requestbuffers reqbufs;
+
+    memset(&reqbufs, 0, sizeof(reqbufs));
+    reqbufs.count = count;
+    reqbufs.memory = V4L2_MEMORY_DMABUF;
+    reqbufs.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    if (DeviceIoctl(VIDIOC_REQBUFS, &reqbufs) < 0) {
+        ALOGERR("Failed to REQBUFS(%u) of the source image", count);
+        return false;
+    }
+
+    memset(&reqbufs, 0, sizeof(reqbufs));
+    reqbufs.count = count;
+    reqbufs.memory = V4L2_MEMORY_DMABUF;
+    reqbufs.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    if (DeviceIoctl(VIDIOC_REQBUFS, &reqbufs) < 0) {
+        ALOGERR("Failed to REQBUFS(%u) of the JPEG stream", count);
+        reqbufs.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        reqbufs.count = 0;
+        DeviceIoctl(VIDIOC_REQBUFS, &reqbufs); // don't care if it fails
+        return false;
+    }
+
+    m_bReqBufs = count > 0;
+
+    return true;
+}
+
+void CHWJpegV4L2EncodeQueue::ResetStream() {
+    if (m_bStreaming) {
+        // error during stream off do not need further handling because of nothing to do
+        int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        if (DeviceIoctl(VIDIOC_STREAMOFF, &type) < 0)
+            ALOGERR("Failed to STREAMOFF for the source image");
+
+        type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        if (DeviceIoctl(VIDIOC_STREAMOFF, &type) < 0)
+            ALOGERR("Failed to STREAMOFF for the JPEG stream");
+
+        m_bStreaming = false;
+    }
+
+    // Stream off dequeues all queued buffers
+    if (m_bReqBufs) ReqBufs(0);
+
+    m_bConfigured = false;
+    m_uiNextSlot = 0;
+}
+
+bool CHWJpegV4L2EncodeQueue::Configure(const hwjpeg_encode_job &params) {
+    if (!m_bConfigured || (m_current.v4l2_fmt != params.v4l2_fmt) ||
+        (m_current.width != params.width) || (m_current.height != params.height)) {
+        ResetStream();
+
+        v4l2_format format;
+        memset(&format, 0, sizeof(format));
+        format.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        format.fmt.pix_mp.pixelformat = params.v4l2_fmt;
+        format.fmt.pix_mp.width = TO_IMAGE_SIZE(params.width, 0);
+        format.fmt.pix_mp.height = TO_IMAGE_SIZE(params.height, 0);
+        if (DeviceIoctl(VIDIOC_S_FMT, &format) < 0) {
+            ALOGERR("Failed to S_FMT for image to compress");
+            return false;
+        }
+
+        if (format.fmt.pix_mp.num_planes > ARRSIZE(m_uiPlaneSizes)) {
+            ALOGE("Unsupported number of planes %u", format.fmt.pix_mp.num_planes);
+            return false;
+        }
+
+        m_uiNumPlanes = format.fmt.pix_mp.num_planes;
+        for (unsigned int i = 0; i < m_uiNumPlanes; i++)
+            m_uiPlaneSizes[i] = format.fmt.pix_mp.plane_fmt[i].sizeimage;
+
+        v4l2_format v4l2JpegFormat;
+        memset(&v4l2JpegFormat, 0, sizeof(v4l2JpegFormat));
+        v4l2JpegFormat.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        v4l2JpegFormat.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_JPEG;
+        v4l2JpegFormat.fmt.pix_mp.width = format.fmt.pix_mp.width;
+        v4l2JpegFormat.fmt.pix_mp.height = format.fmt.pix_mp.height;
+        if (DeviceIoctl(VIDIOC_S_FMT, &v4l2JpegFormat) < 0) {
+            ALOGERR("Failed to S_FMT for JPEG stream to capture");
+            return false;
+        }
+
+        if (!ReqBufs(m_uiDepth)) return false;
+
+        int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        if (DeviceIoctl(VIDIOC_STREAMON, &type) < 0) {
+            ALOGERR("Failed to STREAMON for the source image");
+            ReqBufs(0);
+            return false;
+        }
+
+        type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        if (DeviceIoctl(VIDIOC_STREAMON, &type) < 0) {
+            ALOGERR("Failed to STREAMON for the JPEG stream");
+            type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+            DeviceIoctl(VIDIOC_STREAMOFF, &type);
+            ReqBufs(0);
+            return false;
+        }
+
+        m_bStreaming = true;
+        m_stats.format_changes++;
+        // force the controls to be configured on the new stream
+        m_current.quality = 0;
+    }
+
+    if ((m_current.quality != params.quality) || (m_current.chroma_h != params.chroma_h) ||
+        (m_current.chroma_v != params.chroma_v)) {
+        v4l2_ext_controls ctrls;
+        v4l2_ext_control ctrl[2];
+
+        memset(&ctrls, 0, sizeof(ctrls));
+        memset(&ctrl, 0, sizeof(ctrl));
+
+        int chroma;
+        if (!GetV4L2ChromaSubsampling(params.chroma_h, params.chroma_v, &chroma)) return false;
+
+        if (params.quality < 1 || params.quality > 100) {
+            ALOGE("Unsupported quality factor %u", params.quality);
+            return false;
+        }
+
+        ctrl[0].id = V4L2_CID_JPEG_CHROMA_SUBSAMPLING;
+        ctrl[0].value = chroma;
+        ctrl[1].id = V4L2_CID_JPEG_COMPRESSION_QUALITY;
+        ctrl[1].value = static_cast<__s32>(params.quality);
+
+        ctrls.ctrl_class = V4L2_CTRL_CLASS_JPEG;
+        ctrls.controls = ctrl;
+        ctrls.count = 2;
+
+        if (DeviceIoctl(VIDIOC_S_EXT_CTRLS, &ctrls) < 0) {
+            ALOGERR("Failed to configure %u controls", ctrls.count);
+            return false;
+        }
+
+        m_stats.control_updates++;
+    }
+
+    m_current = params;
+    m_bConfigured = true;
+
+    return true;
+}
+
+bool CHWJpegV4L2EncodeQueue::QBuf(unsigned int index, const hwjpeg_encode_job &params) {
+    if (params.num_buffers < m_uiNumPlanes) {
+        ALOGE("The number of buffers %u is smaller than the required %u", params.num_buffers,
+              m_uiNumPlanes);
+        return false;
+    }
+
+    v4l2_buffer buffer_src, buffer_dst;
+    v4l2_plane planes_src[ARRSIZE(m_uiPlaneSizes)], planes_dst[1];
+
+    memset(&buffer_src, 0, sizeof(buffer_src));
+    memset(&buffer_dst, 0, sizeof(buffer_dst));
+    memset(&planes_src, 0, sizeof(planes_src));
+    memset(&planes_dst, 0, sizeof(planes_dst));
+
+    for (unsigned int i = 0; i < m_uiNumPlanes; i++) {
+        if (params.len_buffers[i] < m_uiPlaneSizes[i]) {
+            ALOGE("The size of the buffer[%u] %zu is smaller than required %u", i,
+                  params.len_buffers[i], m_uiPlaneSizes[i]);
+            return false;
+        }
+        planes_src[i].m.fd = params.buffers[i];
+        planes_src[i].bytesused = m_uiPlaneSizes[i];
+        planes_src[i].length = params.len_buffers[i];
+    }
+
+    buffer_src.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    buffer_src.memory = V4L2_MEMORY_DMABUF;
+    buffer_src.index = index;
+    buffer_src.length = m_uiNumPlanes;
+    buffer_src.m.planes = planes_src;
+
+    planes_dst[0].m.fd = params.jpeg_buffer;
+    planes_dst[0].length = params.len_jpeg_buffer;
+
+    buffer_dst.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    buffer_dst.memory = V4L2_MEMORY_DMABUF;
+    buffer_dst.index = index;
+    buffer_dst.length = 1;
+    buffer_dst.m.planes = planes_dst;
+
+    if (DeviceIoctl(VIDIOC_QBUF, &buffer_src) < 0) {
+        ALOGERR("QBuf of the source buffers is failed (index %u)", index);
+        return false;
+    }
+
+    if (DeviceIoctl(VIDIOC_QBUF, &buffer_dst) < 0) {
+        ALOGERR("QBuf of the JPEG buffers is failed (index %u)", index);
+        // Reqbufs(0) is the only way to cancel the previous queued buffer
+        ResetStream();
+        return false;
+    }
+
+    return true;
+}
+
+bool CHWJpegV4L2EncodeQueue::DQBuf(unsigned int *index, ssize_t *stream_size,
+                                   unsigned int *hw_delay) {
+    v4l2_buffer buffer_src, buffer_dst;
+    v4l2_plane planes_src[ARRSIZE(m_uiPlaneSizes)], planes_dst[1];
+
+    memset(&buffer_src, 0, sizeof(buffer_src));
+    memset(&buffer_dst, 0, sizeof(buffer_dst));
+    memset(&planes_src, 0, sizeof(planes_src));
+    memset(&planes_dst, 0, sizeof(planes_dst));
+
+    buffer_src.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    buffer_src.memory = V4L2_MEMORY_DMABUF;
+    buffer_src.length = m_uiNumPlanes;
+    buffer_src.m.planes = planes_src;
+
+    buffer_dst.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    buffer_dst.memory = V4L2_MEMORY_DMABUF;
+    buffer_dst.length = 1;
+    buffer_dst.m.planes = planes_dst;
+
+    if (DeviceIoctl(VIDIOC_DQBUF, &buffer_src) < 0) {
+        ALOGERR("Failed to DQBUF of the image buffer");
+        return false;
+    }
+
+    if (DeviceIoctl(VIDIOC_DQBUF, &buffer_dst) < 0) {
+        ALOGERR("Failed to DQBUF of the JPEG stream buffer");
+        return false;
+    }
+
+    if (buffer_src.index != buffer_dst.index) {
+        ALOGE("Mismatched buffer index: image %u, JPEG stream %u", buffer_src.index,
+              buffer_dst.index);
+        return false;
+    }
+
+    *index = buffer_dst.index;
+    // The driver stores the delay in usec. of JPEG compression by H/W
+    // to v4l2_buffer.reserved2.
+    *hw_delay = buffer_dst.reserved2;
+
+    if (!!((buffer_src.flags | buffer_dst.flags) & V4L2_BUF_FLAG_ERROR)) {
+        ALOGE("Error occurred during compression of buffer %u", *index);
+        *stream_size = -1;
+    } else {
+        *stream_size = static_cast<ssize_t>(buffer_dst.m.planes[0].bytesused);
+    }
+
+    return true;
+}
+
+void CHWJpegV4L2EncodeQueue::Worker() {
+    std::vector<std::pair<std::unique_ptr<Job>, hwjpeg_encode_result>> done;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto complete = [&done](std::unique_ptr<Job> job, ssize_t stream_size, unsigned int hw_delay) {
+        hwjpeg_encode_result result;
+
+        result.job_id = job->id;
+        result.stream_size = stream_size;
+        result.hw_delay = hw_delay;
+        result.wait_time = job->wait_time;
+        result.total_time = ElapsedUsec(job->submitted);
+
+        done.emplace_back(std::move(job), result);
+    };
+
+    auto fail_queued = [this, &complete] {
+        for (auto &slot : m_slots)
+            if (slot) complete(std::move(slot), -1, 0);
+        m_uiQueued = 0;
+    };
+
+    for (;;) {
+        m_condJob.wait(lock, [this] { return m_bExit || !m_pending.empty() || (m_uiQueued > 0); });
+        if (m_pending.empty() && (m_uiQueued == 0)) break; // m_bExit
+
+        if ((m_uiQueued == 0) && !m_bLocked) {
+            lock.unlock();
+            file_lock_.lock();
+            lock.lock();
+            m_bLocked = true;
+        }
+
+        // Feed the driver with the jobs that share the parameters of the queued jobs
+        while (!m_pending.empty() && (m_uiQueued < m_uiDepth)) {
+            if (!IsCompatible(m_pending.front()->params)) {
+                if (m_uiQueued > 0) break;
+
+                if (!Configure(m_pending.front()->params)) {
+                    ResetStream();
+                    complete(std::move(m_pending.front()), -1, 0);
+                    m_pending.pop_front();
+                    continue;
+                }
+            }
+
+            std::unique_ptr<Job> job = std::move(m_pending.front());
+            m_pending.pop_front();
+
+            // M2M device completes the jobs in order. Thus the slot next to the last queued
+            // one is always free while the number of queued jobs is less than the depth.
+            unsigned int index = m_uiNextSlot;
+            job->wait_time = ElapsedUsec(job->submitted);
+
+            if (!QBuf(index, job->params)) {
+                complete(std::move(job), -1, 0);
+                if (!m_bStreaming) fail_queued();
+                continue;
+            }
+
+            m_slots[index] = std::move(job);
+            m_uiNextSlot = (index + 1) % m_uiDepth;
+            m_uiQueued++;
+            if (m_uiQueued > m_stats.max_queued) m_stats.max_queued = m_uiQueued;
+        }
+
+        if (m_uiQueued > 0) {
+            unsigned int index = 0;
+            ssize_t stream_size = -1;
+            unsigned int hw_delay = 0;
+
+            lock.unlock();
+            bool okay = DQBuf(&index, &stream_size, &hw_delay);
+            lock.lock();
+
+            if (okay && (index < m_uiDepth) && m_slots[index]) {
+                complete(std::move(m_slots[index]), stream_size, hw_delay);
+                m_uiQueued--;
+            } else {
+                ResetStream();
+                fail_queued();
+            }
+        }
+
+        if ((m_uiQueued == 0) && m_bLocked) {
+            file_lock_.unlock();
+            m_bLocked = false;
+        }
+
+        if (done.empty()) continue;
+
+        lock.unlock();
+        for (auto &entry : done)
+            if (entry.first->callback) entry.first->callback(entry.second);
+        lock.lock();
+
+        for (auto &entry : done) {
+            if (entry.second.stream_size < 0)
+                m_stats.failed++;
+            else
+                m_stats.completed++;
+        }
+        done.clear();
+
+        m_condIdle.notify_all();
+    }
+
+    if (m_bLocked) {
+        file_lock_.unlock();
+        m_bLocked = false;
+    }
+}
@@ -80,23 +80,22 @@ int CHWJpegV4L2Compressor::unlock() {
     return file_lock_.unlock();
 }
 
-bool CHWJpegV4L2Compressor::SetChromaSampFactor(unsigned int horizontal, unsigned int vertical) {
-    __s32 value;
+bool GetV4L2ChromaSubsampling(unsigned int horizontal, unsigned int vertical, int *value) {
     switch ((horizontal << 4) | vertical) {
         case 0x00:
-            value = V4L2_JPEG_CHROMA_SUBSAMPLING_GRAY;
+            *value = V4L2_JPEG_CHROMA_SUBSAMPLING_GRAY;
             break;
         case 0x11:
-            value = V4L2_JPEG_CHROMA_SUBSAMPLING_444;
+            *value = V4L2_JPEG_CHROMA_SUBSAMPLING_444;
             break;
         case 0x21:
-            value = V4L2_JPEG_CHROMA_SUBSAMPLING_422;
+            *value = V4L2_JPEG_CHROMA_SUBSAMPLING_422;
             break;
         case 0x22:
-            value = V4L2_JPEG_CHROMA_SUBSAMPLING_420;
+            *value = V4L2_JPEG_CHROMA_SUBSAMPLING_420;
             break;
         case 0x41:
-            value = V4L2_JPEG_CHROMA_SUBSAMPLING_411;
+            *value = V4L2_JPEG_CHROMA_SUBSAMPLING_411;
             break;
         case 0x12:
         default:
@@ -104,6 +103,13 @@ bool CHWJpegV4L2Compressor::SetChromaSampFactor(unsigned int horizontal, unsigne
             return false;
     }
 
+    return true;
+}
+
+bool CHWJpegV4L2Compressor::SetChromaSampFactor(unsigned int horizontal, unsigned int vertical) {
+    int value;
+    if (!GetV4L2ChromaSubsampling(horizontal, vertical, &value)) return false;
+
     m_v4l2Controls[HWJPEG_CTRL_CHROMFACTOR].id = V4L2_CID_JPEG_CHROMA_SUBSAMPLING;
     m_v4l2Controls[HWJPEG_CTRL_CHROMFACTOR].value = value;
     m_uiControlsToSet |= 1 << HWJPEG_CTRL_CHROMFACTOR;
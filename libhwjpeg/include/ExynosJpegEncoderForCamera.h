@@ -22,7 +22,9 @@
 #include <hardware/exynos/ExynosExif.h>
 #include <pthread.h>
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
 #include "ExynosJpegApi.h"
 
@@ -70,7 +72,26 @@ class ExynosJpegEncoderForCamera : public ExynosJpegEncoder {
 
     CAppMarkerWriter* m_pAppWriter;
 
+    /*
+     * The thumbnail worker lives as long as the encoder. It is started by the first capture that
+     * needs a thumbnail generated from the main image and then waits for one job per capture,
+     * so that scaling and compressing the thumbnail overlaps the main image compression without
+     * creating a thread per shot. The thumbnail buffers and the scaler configuration it uses are
+     * kept across captures and only rebuilt when the thumbnail size or format grows.
+     */
+    enum {
+        THUMB_JOB_NONE,
+        THUMB_JOB_QUEUED, // also while the worker is processing it
+        THUMB_JOB_DONE,
+    };
+
     pthread_t m_threadWorker;
+    bool m_bWorkerStarted;
+    bool m_bWorkerExit;
+    int m_iThumbJob;
+    size_t m_szThumbJobResult;
+    std::mutex m_mutexWorker;
+    std::condition_variable m_condWorker;
 
     extra_appinfo_t m_extraInfo;
     app_info_t m_appInfo[15];
@@ -85,6 +106,10 @@ class ExynosJpegEncoderForCamera : public ExynosJpegEncoder {
     ssize_t FinishCompression(size_t mainlen, size_t thumblen);
     bool ProcessExif(char* base, size_t limit, exif_attribute_t* exifInfo, extra_appinfo_t* extra);
     static void* tCompressThumbnail(void* p);
+    void ThumbnailWorkerLoop();
+    bool QueueThumbnailJob();
+    size_t WaitForThumbnailJob();
+    void StopThumbnailWorker();
     bool PrepareCompression(bool thumbnail);
 
     // IsThumbGenerationNeeded - true if thumbnail image needed to be generated from the main image
@@ -20,7 +20,15 @@
 
 #include <linux/videodev2.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <cstddef> // size_t
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #if VIDEO_MAX_PLANES < 6
 #error VIDEO_MAX_PLANES should not be smaller than 6
@@ -648,6 +656,140 @@ public:
     virtual void Release();
 };
 
+/*
+ * hwjpeg_encode_job - A compression job submitted to CHWJpegV4L2EncodeQueue
+ * @v4l2_fmt       : Image pixel format defined in <linux/videodev2.h>
+ * @width, @height : Size of the image in the number of pixels
+ * @quality        : JPEG compression quality factor between 1 and 100
+ * @chroma_h/v     : Chroma subsampling factors of the JPEG stream (e.g. 2x2 for YUV420)
+ * @buffers        : dma-buf file descriptors of the image planes
+ * @len_buffers    : sizes of @buffers
+ * @num_buffers    : the number of elements of @buffers and @len_buffers
+ * @jpeg_buffer    : dma-buf file descriptor of the JPEG stream buffer
+ * @len_jpeg_buffer: size of @jpeg_buffer
+ *
+ * The buffers should stay valid until the completion callback of the job is invoked.
+ */
+struct hwjpeg_encode_job {
+    unsigned int v4l2_fmt;
+    unsigned int width;
+    unsigned int height;
+    unsigned int quality;
+    unsigned int chroma_h;
+    unsigned int chroma_v;
+    int buffers[3];
+    size_t len_buffers[3];
+    unsigned int num_buffers;
+    int jpeg_buffer;
+    size_t len_jpeg_buffer;
+};
+
+/*
+ * hwjpeg_encode_result - The completion report of a hwjpeg_encode_job
+ * @job_id      : The value returned by CHWJpegV4L2EncodeQueue::QueueJob()
+ * @stream_size : The size of the compressed JPEG stream. Negative value on error.
+ * @hw_delay    : H/W delay of the compression in usec. reported by the driver
+ * @wait_time   : usec. from QueueJob() until the job is queued to the driver
+ * @total_time  : usec. from QueueJob() until the job is completed
+ */
+struct hwjpeg_encode_result {
+    long job_id;
+    ssize_t stream_size;
+    unsigned int hw_delay;
+    unsigned long wait_time;
+    unsigned long total_time;
+};
+
+/*
+ * CHWJpegV4L2EncodeQueue - Queue of JPEG compression jobs on a dedicated V4L2 context
+ *
+ * CHWJpegV4L2Compressor serves one compression at a time. CHWJpegV4L2EncodeQueue
+ * accepts jobs from multiple threads and keeps up to @depth jobs queued to the
+ * driver at once. The negotiated formats, the requested buffers and the stream
+ * stay as they are between jobs while the image format and the size are not
+ * changed. The controls are configured only when the quality factor or the chroma
+ * subsampling factors are changed. Jobs with different parameters from the jobs
+ * queued to the driver wait until the driver finishes the queued jobs.
+ * The completion callbacks are invoked by the internal worker thread in the order
+ * of submission. Back-to-back compression and HWFC are not supported.
+ */
+class CHWJpegV4L2EncodeQueue : public CHWJpegBase {
+public:
+    typedef std::function<void(const hwjpeg_encode_result &)> Callback;
+
+    struct Stats {
+        unsigned long submitted;
+        unsigned long completed;
+        unsigned long failed;
+        unsigned long format_changes;  // S_FMT with stream restart
+        unsigned long control_updates; // S_EXT_CTRLS
+        unsigned long max_queued;      // maximum number of jobs queued to the driver at once
+    };
+
+    CHWJpegV4L2EncodeQueue(unsigned int depth = 2, const char *path = "/dev/video12");
+    virtual ~CHWJpegV4L2EncodeQueue();
+
+    /*
+     * QueueJob - Submit a compression job
+     * @job[in]      : The job description. It is copied.
+     * @callback[in] : Invoked by the worker thread when the job is completed or failed
+     * @return       : The job id that is reported to @callback. Negative value on error.
+     */
+    long QueueJob(const hwjpeg_encode_job &job, Callback callback);
+    // Waits until all submitted jobs are completed
+    void Flush();
+    // Completes all submitted jobs, stops the worker thread and the stream.
+    // The queue accepts jobs again after Stop().
+    void Stop();
+    Stats GetStats();
+
+protected:
+    // All V4L2 requests to the device are issued through DeviceIoctl()
+    virtual int DeviceIoctl(unsigned long request, void *arg);
+
+private:
+    struct Job {
+        long id;
+        hwjpeg_encode_job params;
+        Callback callback;
+        std::chrono::steady_clock::time_point submitted;
+        unsigned long wait_time;
+    };
+
+    unsigned int m_uiDepth;
+    long m_lNextJobId;
+    Stats m_stats;
+
+    // The state of the V4L2 context. It is only accessed by the worker thread.
+    bool m_bConfigured;
+    hwjpeg_encode_job m_current; // parameters of the jobs queued to the driver
+    unsigned int m_uiNumPlanes;
+    unsigned int m_uiPlaneSizes[3];
+    bool m_bStreaming;
+    bool m_bReqBufs;
+    bool m_bLocked; // file_lock_ is held while jobs are queued to the driver
+
+    std::mutex m_mutex;
+    std::condition_variable m_condJob;
+    std::condition_variable m_condIdle;
+    std::deque<std::unique_ptr<Job>> m_pending;
+    std::vector<std::unique_ptr<Job>> m_slots; // jobs queued to the driver by buffer index
+    unsigned int m_uiQueued;
+    unsigned int m_uiNextSlot;
+    bool m_bExit;
+    std::thread m_worker;
+
+    FileLock file_lock_;
+
+    void Worker() NO_THREAD_SAFETY_ANALYSIS;
+    bool IsCompatible(const hwjpeg_encode_job &params);
+    bool Configure(const hwjpeg_encode_job &params);
+    bool ReqBufs(unsigned int count);
+    void ResetStream();
+    bool QBuf(unsigned int index, const hwjpeg_encode_job &params);
+    bool DQBuf(unsigned int *index, ssize_t *stream_size, unsigned int *hw_delay);
+};
+
 class CHWJpegV4L2Decompressor : public CHWJpegDecompressor, private CHWJpegFlagManager {
     enum {
         HWJPEG_FLAG_OUTPUT_READY = 0x10,  /* the output stream is ready */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "AppMarkerWriter.h"
+
+namespace {
+
+// Room for APP1 with the thumbnail space reserved, as ProcessExif() does
+constexpr size_t kStreamSize = JPEG_MAX_SEGMENT_SIZE * 11;
+
+// The attributes of a burst: the same camera configuration for every shot
+class BurstExif {
+public:
+    explicit BurstExif(size_t makerNoteSize) : mMakerNote(makerNoteSize) {
+        memset(&mExif, 0, sizeof(mExif));
+        mExif.enableGps = true;
+        mExif.enableThumb = true;
+        strcpy(mExif.maker, "Google");
+        strcpy(mExif.model, "Pixel");
+        strcpy(mExif.software, "HDR+ 1.0.0");
+        memcpy(mExif.exif_version, "0220", 4);
+        strcpy(mExif.unique_id, "0123456789abcdef0123456789abcdef");
+        mExif.width = 4000;
+        mExif.height = 3000;
+        mExif.widthThumb = 320;
+        mExif.heightThumb = 240;
+        mExif.orientation = 1;
+        mExif.fnumber = {18, 10};
+        mExif.focal_length = {690, 100};
+        strcpy(mExif.gps_latitude_ref, "N");
+        strcpy(mExif.gps_longitude_ref, "W");
+        strcpy(mExif.gps_processing_method, "GPS");
+        mExif.maker_note = mMakerNote.data();
+        mExif.maker_note_size = mMakerNote.size();
+    }
+
+    // What changes from a shot to the next
+    exif_attribute_t *next(uint32_t shot) {
+        snprintf(mExif.date_time, sizeof(mExif.date_time), "2024:01:01 10:%02u:%02u",
+                 (shot / 60) % 60, shot % 60);
+        snprintf(mExif.sec_time, sizeof(mExif.sec_time), "%03u", shot % 1000);
+        mExif.exposure_time = {1, 100 + shot % 20};
+        mExif.iso_speed_rating = 100 + shot % 8;
+        mExif.brightness = {static_cast<int32_t>(shot % 50), 10};
+        mExif.gps_timestamp[2] = {shot % 60, 1};
+        if (!mMakerNote.empty()) mMakerNote[shot % mMakerNote.size()]++;
+        return &mExif;
+    }
+
+private:
+    exif_attribute_t mExif;
+    std::vector<unsigned char> mMakerNote;
+};
+
+void WriteShot(CAppMarkerWriter &writer, char *base, exif_attribute_t *exif) {
+    writer.PrepareAppWriter(base, exif, NULL);
+    writer.Write(true, JPEG_MARKER_SIZE, 16);
+    writer.Finalize(8192);
+}
+
+void RunBurst(benchmark::State &state, bool useTemplate) {
+    std::vector<char> stream(kStreamSize);
+    std::vector<char> expected(kStreamSize);
+    BurstExif burst(state.range(0));
+    CAppMarkerWriter writer;
+    CAppMarkerWriter reference;
+    writer.UseExifTemplate(useTemplate);
+    reference.UseExifTemplate(false);
+
+    uint32_t shot = 0;
+    for (auto _ : state) {
+        WriteShot(writer, stream.data(), burst.next(shot++));
+        benchmark::DoNotOptimize(stream.data());
+    }
+
+    // The template should write the same bytes as the writer does from scratch
+    exif_attribute_t *exif = burst.next(shot);
+    WriteShot(writer, stream.data(), exif);
+    WriteShot(reference, expected.data(), exif);
+    if (memcmp(stream.data(), expected.data(), writer.CalculateAPPSize()) != 0)
+        state.SkipWithError("APP1 differs from the one written from scratch");
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// What ProcessExif() did for every shot: lay out and write the whole APP1
+void BM_AppMarkerWriter_Rebuild(benchmark::State &state) {
+    RunBurst(state, false);
+}
+
+// Patching the fields that changed into the template of the burst
+void BM_AppMarkerWriter_Template(benchmark::State &state) {
+    RunBurst(state, true);
+}
+
+// Without a maker note and with a typical and a large one
+BENCHMARK(BM_AppMarkerWriter_Rebuild)->Arg(0)->Arg(2048)->Arg(16384);
+BENCHMARK(BM_AppMarkerWriter_Template)->Arg(0)->Arg(2048)->Arg(16384);
+
+} // namespace
+
+BENCHMARK_MAIN();
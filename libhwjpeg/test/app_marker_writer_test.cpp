@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "AppMarkerWriter.h"
+
+// Room for APP1 with the thumbnail space reserved, as ProcessExif() does
+constexpr size_t kStreamSize = JPEG_MAX_SEGMENT_SIZE * 11;
+
+/*
+ * Writes every shot with a writer reusing its Exif template and with one
+ * writing APP1 from scratch, and expects the same bytes from both. A layout
+ * change the template missed shows up as a difference.
+ */
+class AppMarkerWriterTest : public ::testing::Test {
+protected:
+    AppMarkerWriterTest()
+          : mStream(kStreamSize), mExpected(kStreamSize), mMakerNote(2048) {
+        memset(&mExif, 0, sizeof(mExif));
+        mExif.enableGps = true;
+        mExif.enableThumb = true;
+        strcpy(mExif.maker, "Google");
+        strcpy(mExif.model, "Pixel");
+        strcpy(mExif.software, "HDR+ 1.0.0");
+        memcpy(mExif.exif_version, "0220", 4);
+        strcpy(mExif.unique_id, "0123456789abcdef0123456789abcdef");
+        mExif.width = 4000;
+        mExif.height = 3000;
+        mExif.widthThumb = 320;
+        mExif.heightThumb = 240;
+        mExif.orientation = 1;
+        mExif.fnumber = {18, 10};
+        mExif.focal_length = {690, 100};
+        strcpy(mExif.gps_latitude_ref, "N");
+        strcpy(mExif.gps_longitude_ref, "W");
+        strcpy(mExif.gps_processing_method, "GPS");
+        mExif.maker_note = mMakerNote.data();
+        mExif.maker_note_size = mMakerNote.size();
+
+        mWriter.UseExifTemplate(true);
+        mReference.UseExifTemplate(false);
+    }
+
+    // What changes from a shot to the next of a burst
+    void nextShot() {
+        mShot++;
+        snprintf(mExif.date_time, sizeof(mExif.date_time), "2024:01:01 10:%02u:%02u",
+                 (mShot / 60) % 60, mShot % 60);
+        snprintf(mExif.sec_time, sizeof(mExif.sec_time), "%03u", mShot % 1000);
+        mExif.exposure_time = {1, 100 + mShot % 20};
+        mExif.iso_speed_rating = 100 + mShot % 8;
+        mExif.gps_timestamp[2] = {mShot % 60, 1};
+        if (!mMakerNote.empty()) mMakerNote[mShot % mMakerNote.size()]++;
+    }
+
+    static void write(CAppMarkerWriter &writer, std::vector<char> &stream, exif_attribute_t *exif,
+                      bool reserveThumbnailSpace) {
+        // The reserved thumbnail space is not written
+        std::fill(stream.begin(), stream.end(), 0);
+        writer.PrepareAppWriter(stream.data(), exif, NULL);
+        writer.Write(reserveThumbnailSpace, JPEG_MARKER_SIZE, 16);
+    }
+
+    // Writes the next shot with both writers
+    void shot(bool reserveThumbnailSpace = true) {
+        nextShot();
+        write(mWriter, mStream, &mExif, reserveThumbnailSpace);
+        write(mReference, mExpected, &mExif, reserveThumbnailSpace);
+    }
+
+    void expectSameApp() {
+        const size_t size = mReference.CalculateAPPSize();
+        ASSERT_EQ(size, mWriter.CalculateAPPSize());
+        EXPECT_EQ(0, memcmp(mStream.data(), mExpected.data(), size));
+        EXPECT_EQ(mReference.IsThumbSpaceReserved(), mWriter.IsThumbSpaceReserved());
+        EXPECT_EQ(mReference.GetMainStreamBase() - mExpected.data(),
+                  mWriter.GetMainStreamBase() - mStream.data());
+    }
+
+    // Offset of JPEGInterchangeFormatLength in the stream of the reference
+    size_t thumbSizeOffset() {
+        char *placeholder = mReference.GetThumbStreamSizeAddr();
+        EXPECT_NE(nullptr, placeholder);
+        return placeholder - mExpected.data();
+    }
+
+    static uint32_t readThumbSize(const std::vector<char> &stream, size_t offset) {
+        uint32_t len;
+        memcpy(&len, stream.data() + offset, sizeof(len));
+        return len;
+    }
+
+    exif_attribute_t mExif;
+    std::vector<char> mStream;
+    std::vector<char> mExpected;
+    std::vector<unsigned char> mMakerNote;
+    CAppMarkerWriter mWriter;
+    CAppMarkerWriter mReference;
+    uint32_t mShot = 0;
+};
+
+TEST_F(AppMarkerWriterTest, BurstIsPatched) {
+    shot();
+    expectSameApp();
+    for (int i = 0; i < 5; i++) {
+        shot();
+        expectSameApp();
+        EXPECT_GT(mWriter.GetPatchedFieldCount(), 0u);
+    }
+
+    // Only the fields that changed are patched
+    write(mWriter, mStream, &mExif, true);
+    EXPECT_EQ(0u, mWriter.GetPatchedFieldCount());
+    expectSameApp();
+}
+
+TEST_F(AppMarkerWriterTest, ThumbnailOnOff) {
+    shot();
+    mExif.enableThumb = false;
+    shot();
+    expectSameApp();
+    EXPECT_EQ(nullptr, mWriter.GetThumbStreamSizeAddr());
+    shot();
+    expectSameApp();
+
+    mExif.enableThumb = true;
+    shot();
+    expectSameApp();
+    EXPECT_NE(nullptr, mWriter.GetThumbStreamSizeAddr());
+}
+
+TEST_F(AppMarkerWriterTest, GpsOnOff) {
+    shot();
+    mExif.enableGps = false;
+    shot();
+    expectSameApp();
+    shot();
+    expectSameApp();
+
+    mExif.enableGps = true;
+    shot();
+    expectSameApp();
+
+    // So does the length of the processing method
+    strcpy(mExif.gps_processing_method, "NETWORK");
+    shot();
+    expectSameApp();
+}
+
+TEST_F(AppMarkerWriterTest, MakerNoteSize) {
+    shot();
+    mMakerNote.resize(4096);
+    mExif.maker_note = mMakerNote.data();
+    mExif.maker_note_size = mMakerNote.size();
+    shot();
+    expectSameApp();
+
+    mMakerNote.resize(100);
+    mExif.maker_note_size = mMakerNote.size();
+    shot();
+    expectSameApp();
+
+    mMakerNote.clear();
+    mExif.maker_note = NULL;
+    mExif.maker_note_size = 0;
+    shot();
+    expectSameApp();
+}
+
+TEST_F(AppMarkerWriterTest, UniqueIdLength) {
+    shot();
+    strcpy(mExif.unique_id, "0123456789abcdef");
+    shot();
+    expectSameApp();
+
+    // Three characters and less fit in the value of the field
+    strcpy(mExif.unique_id, "012");
+    shot();
+    expectSameApp();
+
+    mExif.unique_id[0] = '\0';
+    shot();
+    expectSameApp();
+
+    strcpy(mExif.unique_id, "fedcba9876543210fedcba9876543210");
+    shot();
+    expectSameApp();
+}
+
+// Layout changes that keep the size of APP1 are caught as well
+TEST_F(AppMarkerWriterTest, SameSizeOtherLayout) {
+    // Values of up to four bytes are in the field
+    strcpy(mExif.unique_id, "0");
+    shot();
+    strcpy(mExif.unique_id, "012");
+    shot();
+    expectSameApp();
+
+    mMakerNote.resize(2);
+    mExif.maker_note = mMakerNote.data();
+    mExif.maker_note_size = mMakerNote.size();
+    shot();
+    mMakerNote.resize(4);
+    mExif.maker_note = mMakerNote.data();
+    mExif.maker_note_size = mMakerNote.size();
+    shot();
+    expectSameApp();
+
+    // The values moved from a field to another
+    strcpy(mExif.unique_id, "0123456789abcdef");
+    mMakerNote.resize(32);
+    mExif.maker_note = mMakerNote.data();
+    mExif.maker_note_size = mMakerNote.size();
+    shot();
+    strcpy(mExif.unique_id, "0123456789abcdef01234567");
+    mExif.maker_note_size = 24;
+    shot();
+    expectSameApp();
+
+    strcpy(mExif.gps_processing_method, "GPS+NETWORK");
+    mExif.maker_note_size = 16;
+    shot();
+    expectSameApp();
+}
+
+TEST_F(AppMarkerWriterTest, ReserveThumbnailSpace) {
+    shot(true);
+    EXPECT_TRUE(mWriter.IsThumbSpaceReserved());
+    shot(false);
+    expectSameApp();
+    EXPECT_FALSE(mWriter.IsThumbSpaceReserved());
+    shot(false);
+    expectSameApp();
+
+    shot(true);
+    expectSameApp();
+    EXPECT_TRUE(mWriter.IsThumbSpaceReserved());
+}
+
+TEST_F(AppMarkerWriterTest, FinalizeWritesThumbnailSizeToStream) {
+    shot();
+    mWriter.Finalize(1234);
+
+    shot();
+    ASSERT_GT(mWriter.GetPatchedFieldCount(), 0u);
+    const size_t offset = thumbSizeOffset();
+    // The size of the previous shot is not in the template
+    EXPECT_EQ(0, memcmp(mStream.data(), mExpected.data(), mReference.CalculateAPPSize()));
+    EXPECT_EQ(0u, readThumbSize(mStream, offset));
+
+    mWriter.Finalize(5678);
+    EXPECT_EQ(5678u, readThumbSize(mStream, offset));
+    // Finalizing twice does not write again
+    mWriter.Finalize(9999);
+    EXPECT_EQ(5678u, readThumbSize(mStream, offset));
+
+    shot();
+    EXPECT_EQ(0u, readThumbSize(mStream, offset));
+    mWriter.Finalize(4321);
+    EXPECT_EQ(4321u, readThumbSize(mStream, offset));
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <exynos-hwjpeg.h>
+#include <gtest/gtest.h>
+#include <linux/videodev2.h>
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
+
+// Emulates a V4L2 M2M JPEG encoder that completes the queued jobs in order.
+class FakeM2MEncodeQueue : public CHWJpegV4L2EncodeQueue {
+public:
+    FakeM2MEncodeQueue(unsigned int depth) : CHWJpegV4L2EncodeQueue(depth, "/dev/null") {}
+    ~FakeM2MEncodeQueue() { Stop(); }
+
+    unsigned int count(unsigned long request) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mIoctls[request];
+    }
+
+    // The next job queued to the fake device completes with V4L2_BUF_FLAG_ERROR
+    void failNextJob() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFailNext = true;
+    }
+
+protected:
+    int DeviceIoctl(unsigned long request, void *arg) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mIoctls[request]++;
+
+        switch (request) {
+            case VIDIOC_S_FMT: {
+                v4l2_format *fmt = static_cast<v4l2_format *>(arg);
+                if (fmt->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+                    fmt->fmt.pix_mp.num_planes = 1;
+                    fmt->fmt.pix_mp.plane_fmt[0].sizeimage =
+                            fmt->fmt.pix_mp.width * fmt->fmt.pix_mp.height * 3 / 2;
+                }
+                return 0;
+            }
+            case VIDIOC_REQBUFS:
+                return 0;
+            case VIDIOC_STREAMON:
+                mStreaming = true;
+                return 0;
+            case VIDIOC_STREAMOFF:
+                mStreaming = false;
+                mSrc.clear();
+                mDst.clear();
+                return 0;
+            case VIDIOC_S_EXT_CTRLS:
+                return 0;
+            case VIDIOC_QBUF: {
+                v4l2_buffer *buf = static_cast<v4l2_buffer *>(arg);
+                if (!mStreaming) return -EINVAL;
+                if (buf->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+                    mSrc.push_back(buf->index);
+                } else {
+                    mDst.push_back({buf->index, buf->m.planes[0].length / 4, mFailNext});
+                    mFailNext = false;
+                }
+                return 0;
+            }
+            case VIDIOC_DQBUF: {
+                v4l2_buffer *buf = static_cast<v4l2_buffer *>(arg);
+                if (buf->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+                    if (mSrc.empty()) return -EINVAL;
+                    buf->index = mSrc.front();
+                    mSrc.pop_front();
+                } else {
+                    if (mDst.empty()) return -EINVAL;
+                    buf->index = mDst.front().index;
+                    buf->m.planes[0].bytesused = mDst.front().bytesused;
+                    buf->flags = mDst.front().error ? V4L2_BUF_FLAG_ERROR : 0;
+                    buf->reserved2 = 100;
+                    mDst.pop_front();
+                }
+                return 0;
+            }
+        }
+
+        return -ENOTTY;
+    }
+
+private:
+    struct Dst {
+        unsigned int index;
+        unsigned int bytesused;
+        bool error;
+    };
+
+    std::mutex mMutex;
+    std::map<unsigned long, unsigned int> mIoctls;
+    std::deque<unsigned int> mSrc;
+    std::deque<Dst> mDst;
+    bool mStreaming = false;
+    bool mFailNext = false;
+};
+
+class EncodeQueueTest : public ::testing::Test {
+protected:
+    static hwjpeg_encode_job makeJob(unsigned int width, unsigned int height,
+                                     unsigned int quality = 95) {
+        hwjpeg_encode_job job;
+
+        memset(&job, 0, sizeof(job));
+        job.v4l2_fmt = V4L2_PIX_FMT_NV21;
+        job.width = width;
+        job.height = height;
+        job.quality = quality;
+        job.chroma_h = 2;
+        job.chroma_v = 2;
+        job.buffers[0] = 100;
+        job.len_buffers[0] = width * height * 3 / 2;
+        job.num_buffers = 1;
+        job.jpeg_buffer = 101;
+        job.len_jpeg_buffer = width * height;
+
+        return job;
+    }
+
+    long queue(FakeM2MEncodeQueue &queue, const hwjpeg_encode_job &job) {
+        return queue.QueueJob(job, [this](const hwjpeg_encode_result &result) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mResults.push_back(result);
+        });
+    }
+
+    std::mutex mMutex;
+    std::vector<hwjpeg_encode_result> mResults;
+};
+
+TEST_F(EncodeQueueTest, StreamsAcrossJobs) {
+    FakeM2MEncodeQueue encoder(3);
+
+    for (int i = 0; i < 8; i++) ASSERT_EQ(i, queue(encoder, makeJob(640, 480)));
+    encoder.Flush();
+
+    ASSERT_EQ(8u, mResults.size());
+    for (int i = 0; i < 8; i++) {
+        EXPECT_EQ(i, mResults[i].job_id);
+        EXPECT_EQ(640 * 480 / 4, mResults[i].stream_size);
+        EXPECT_EQ(100u, mResults[i].hw_delay);
+        EXPECT_LE(mResults[i].wait_time, mResults[i].total_time);
+    }
+
+    // The formats, the buffers and the stream are configured once for all jobs
+    EXPECT_EQ(2u, encoder.count(VIDIOC_S_FMT));
+    EXPECT_EQ(2u, encoder.count(VIDIOC_REQBUFS));
+    EXPECT_EQ(2u, encoder.count(VIDIOC_STREAMON));
+    EXPECT_EQ(0u, encoder.count(VIDIOC_STREAMOFF));
+    EXPECT_EQ(1u, encoder.count(VIDIOC_S_EXT_CTRLS));
+    EXPECT_EQ(16u, encoder.count(VIDIOC_QBUF));
+
+    CHWJpegV4L2EncodeQueue::Stats stats = encoder.GetStats();
+    EXPECT_EQ(8u, stats.submitted);
+    EXPECT_EQ(8u, stats.completed);
+    EXPECT_EQ(0u, stats.failed);
+    EXPECT_EQ(1u, stats.format_changes);
+    EXPECT_LE(stats.max_queued, 3u);
+}
+
+TEST_F(EncodeQueueTest, RestreamsOnlyOnFormatChange) {
+    FakeM2MEncodeQueue encoder(2);
+
+    queue(encoder, makeJob(640, 480));
+    queue(encoder, makeJob(640, 480, 80));
+    queue(encoder, makeJob(320, 240, 80));
+    queue(encoder, makeJob(320, 240, 80));
+    encoder.Flush();
+
+    ASSERT_EQ(4u, mResults.size());
+    for (auto &result : mResults) EXPECT_GT(result.stream_size, 0);
+
+    CHWJpegV4L2EncodeQueue::Stats stats = encoder.GetStats();
+    EXPECT_EQ(2u, stats.format_changes);
+    EXPECT_EQ(3u, stats.control_updates);
+    EXPECT_EQ(4u, encoder.count(VIDIOC_S_FMT));
+    EXPECT_EQ(2u, encoder.count(VIDIOC_STREAMOFF));
+}
+
+TEST_F(EncodeQueueTest, ReportsFailedJobs) {
+    FakeM2MEncodeQueue encoder(2);
+
+    hwjpeg_encode_job small = makeJob(640, 480);
+    small.len_buffers[0] = 16;
+
+    queue(encoder, small);
+    encoder.Flush();
+    encoder.failNextJob();
+    queue(encoder, makeJob(640, 480));
+    queue(encoder, makeJob(640, 480));
+    encoder.Flush();
+
+    ASSERT_EQ(3u, mResults.size());
+    EXPECT_LT(mResults[0].stream_size, 0);
+    EXPECT_LT(mResults[1].stream_size, 0);
+    EXPECT_GT(mResults[2].stream_size, 0);
+
+    CHWJpegV4L2EncodeQueue::Stats stats = encoder.GetStats();
+    EXPECT_EQ(1u, stats.completed);
+    EXPECT_EQ(2u, stats.failed);
+    EXPECT_EQ(1u, stats.format_changes);
+}
+
+TEST_F(EncodeQueueTest, AcceptsJobsAfterStop) {
+    FakeM2MEncodeQueue encoder(2);
+
+    queue(encoder, makeJob(640, 480));
+    encoder.Stop();
+    EXPECT_EQ(2u, encoder.count(VIDIOC_STREAMOFF));
+
+    queue(encoder, makeJob(640, 480));
+    encoder.Flush();
+
+    ASSERT_EQ(2u, mResults.size());
+    EXPECT_EQ(2u, encoder.GetStats().format_changes);
+}
@@ -65,6 +65,15 @@
 
 __BEGIN_DECLS
 
+struct exynos_ion_pool_stats {
+    unsigned long hits;             /* allocations served from the pool */
+    unsigned long misses;           /* allocations that went to the kernel while pooling */
+    unsigned long rejected;         /* releases that exceeded the budget on their own */
+    unsigned long trimmed;          /* pooled buffers closed by aging, eviction or disabling */
+    size_t retained_bytes;
+    unsigned long retained_buffers;
+};
+
 int exynos_ion_open(void);
 int exynos_ion_close(int fd);
 int exynos_ion_alloc(int ion_fd, size_t len,
@@ -76,6 +85,19 @@ int exynos_ion_sync_fd_partial(int ion_fd, int fd, off_t offset, size_t len);
 
 const char *exynos_ion_get_heap_name(unsigned int legacy_heap_id);
 
+/*
+ * Opt-in buffer recycling. While enabled, buffers from exynos_ion_alloc() that are released with
+ * exynos_ion_free() are retained, up to @budget_bytes in total and for at most @trim_ms, and
+ * reused for later allocations of the same heap, flags and size class. Recycled buffers are
+ * cleared unless ION_FLAG_NOZEROED is given or the heap is protected.
+ * exynos_ion_free() just closes the fd when the buffer is not retained.
+ */
+int exynos_ion_pool_enable(size_t budget_bytes, unsigned int trim_ms);
+void exynos_ion_pool_disable(void);
+void exynos_ion_pool_trim(void);
+void exynos_ion_pool_get_stats(struct exynos_ion_pool_stats *stats);
+int exynos_ion_free(int fd);
+
 int exynos_ion_sync_start(int ion_fd, int fd, int direction);
 int exynos_ion_sync_end(int ion_fd, int fd, int direction);
 
@@ -26,9 +26,16 @@
 #include <log/log.h>
 #include <stdatomic.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
 #include <mutex>
+#include <unordered_map>
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
 
@@ -73,22 +80,325 @@ BufferAllocator& exynos_ion_get_allocator(void) {
     return bufallocator;
 }
 
+static int exynos_ion_find_heap(unsigned int heap_mask, unsigned int heapflags) {
+    for (size_t i = 0; i < ARRAY_SIZE(heap_map_table); i++) {
+        if ((heap_mask == heap_map_table[i].legacy_ion_heap_mask) &&
+            (heapflags == heap_map_table[i].ion_heap_flags))
+            return static_cast<int>(i);
+    }
+
+    return -1;
+}
+
+/*
+ * Opt-in recycling pool of dma-bufs.
+ *
+ * Buffers released with exynos_ion_free() are kept on freelists keyed by heap, allocation flags
+ * and size class, and handed out again by exynos_ion_alloc() instead of asking the kernel for
+ * fresh pages. Retained bytes are bounded by a budget, and buffers idle for longer than the trim
+ * interval are closed on the next pool operation. A recycled buffer is cleared before reuse
+ * unless the caller passed ION_FLAG_NOZEROED or the heap is protected, since a fresh allocation
+ * from those heaps would not be zeroed either.
+ */
+namespace {
+
+using pool_clock = std::chrono::steady_clock;
+
+struct pool_key {
+    int heap_idx;
+    unsigned int flags;
+    size_t size_class;
+
+    bool operator<(const pool_key& other) const {
+        if (heap_idx != other.heap_idx)
+            return heap_idx < other.heap_idx;
+        if (flags != other.flags)
+            return flags < other.flags;
+        return size_class < other.size_class;
+    }
+};
+
+struct pool_entry {
+    int fd;
+    pool_clock::time_point released;
+};
+
+struct pool_owned {
+    ino_t ino;
+    pool_key key;
+};
+
+class ion_buffer_pool {
+public:
+    int enable(size_t budget, unsigned int trim_ms) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mEnabled = true;
+        mBudget = budget;
+        mTrimInterval = std::chrono::milliseconds(trim_ms);
+        trimLocked(pool_clock::now());
+        return 0;
+    }
+
+    void disable() {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mEnabled = false;
+        releaseAllLocked();
+        mOwned.clear();
+    }
+
+    /* returns -ENODEV when the pool is disabled and -ENOENT if it has no matching buffer */
+    int get(int heap_idx, size_t len, unsigned int flags) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (!mEnabled)
+            return -ENODEV;
+
+        auto now = pool_clock::now();
+        trimLocked(now);
+
+        pool_key key = {heap_idx, flags & ~ION_FLAG_NOZEROED, sizeClass(len)};
+        auto it = mFreeLists.find(key);
+        if (it == mFreeLists.end() || it->second.empty()) {
+            mStats.misses++;
+            return -ENOENT;
+        }
+
+        /* most recently released first: its pages are the most likely to be cache-hot */
+        int fd = it->second.back().fd;
+        it->second.pop_back();
+        mStats.hits++;
+        mStats.retained_bytes -= key.size_class;
+        mStats.retained_buffers--;
+
+        return fd;
+    }
+
+    /*
+     * records that @fd was handed out by the pool or allocated while the pool was enabled.
+     * A buffer of @buf_len below the size class of @len, allocated while the pool was still
+     * disabled, is not recycled since it could not serve every request of that class.
+     */
+    void track(int fd, int heap_idx, size_t len, size_t buf_len, unsigned int flags) {
+        struct stat st;
+
+        if (!mEnabled || buf_len < sizeClass(len) || fstat(fd, &st) < 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (mEnabled)
+            mOwned[fd] = {st.st_ino, {heap_idx, flags & ~ION_FLAG_NOZEROED, sizeClass(len)}};
+    }
+
+    /* returns true if @fd was taken over by the pool */
+    bool put(int fd) {
+        struct stat st;
+
+        /* disable() dropped every buffer the pool tracked */
+        if (!mEnabled || fstat(fd, &st) < 0)
+            return false;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto owned = mOwned.find(fd);
+        if (owned == mOwned.end())
+            return false;
+
+        pool_owned info = owned->second;
+        mOwned.erase(owned);
+
+        /* the fd number was recycled for another file since it was handed out */
+        if (info.ino != st.st_ino)
+            return false;
+
+        auto now = pool_clock::now();
+        trimLocked(now);
+
+        if (!mEnabled || info.key.size_class > mBudget) {
+            mStats.rejected++;
+            return false;
+        }
+
+        while (mStats.retained_bytes + info.key.size_class > mBudget)
+            evictOldestLocked();
+
+        mFreeLists[info.key].push_back({fd, now});
+        mStats.retained_bytes += info.key.size_class;
+        mStats.retained_buffers++;
+
+        return true;
+    }
+
+    void trim() {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        trimLocked(pool_clock::now());
+    }
+
+    void getStats(struct exynos_ion_pool_stats* stats) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        *stats = mStats;
+    }
+
+    static size_t sizeClass(size_t len) {
+        static const size_t page_size = static_cast<size_t>(getpagesize());
+        size_t granule = page_size;
+
+        /* an eighth of the enclosing power of two bounds the waste per buffer to 12.5% */
+        while (granule * 8 < len)
+            granule <<= 1;
+
+        return (len + granule - 1) & ~(granule - 1);
+    }
+
+private:
+    void trimLocked(pool_clock::time_point now) {
+        for (auto& [key, list] : mFreeLists) {
+            while (!list.empty() && (now - list.front().released) >= mTrimInterval) {
+                close(list.front().fd);
+                list.pop_front();
+                mStats.retained_bytes -= key.size_class;
+                mStats.retained_buffers--;
+                mStats.trimmed++;
+            }
+        }
+    }
+
+    void evictOldestLocked() {
+        std::list<pool_entry>* oldest = nullptr;
+        size_t oldest_size = 0;
+
+        for (auto& [key, list] : mFreeLists) {
+            if (!list.empty() && (!oldest || list.front().released < oldest->front().released)) {
+                oldest = &list;
+                oldest_size = key.size_class;
+            }
+        }
+
+        if (!oldest)
+            return;
+
+        close(oldest->front().fd);
+        oldest->pop_front();
+        mStats.retained_bytes -= oldest_size;
+        mStats.retained_buffers--;
+        mStats.trimmed++;
+    }
+
+    void releaseAllLocked() {
+        for (auto& [key, list] : mFreeLists) {
+            for (auto& entry : list)
+                close(entry.fd);
+            mStats.trimmed += list.size();
+        }
+        mFreeLists.clear();
+        mStats.retained_bytes = 0;
+        mStats.retained_buffers = 0;
+    }
+
+    std::mutex mMutex;
+    /* written with mMutex held, read without it to skip the disabled pool */
+    std::atomic<bool> mEnabled = false;
+    size_t mBudget = 0;
+    pool_clock::duration mTrimInterval;
+    std::map<pool_key, std::list<pool_entry>> mFreeLists;
+    std::unordered_map<int, pool_owned> mOwned;
+    struct exynos_ion_pool_stats mStats = {};
+};
+
+ion_buffer_pool& exynos_ion_get_pool(void) {
+    static ion_buffer_pool pool;
+
+    return pool;
+}
+
+int exynos_ion_clear_buffer(int fd, size_t len) {
+    auto& bufallocator = exynos_ion_get_allocator();
+
+    void* ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED)
+        return -errno;
+
+    bufallocator.CpuSyncStart(fd, kSyncWrite);
+    memset(ptr, 0, len);
+    bufallocator.CpuSyncEnd(fd, kSyncWrite);
+    munmap(ptr, len);
+
+    return 0;
+}
+
+} // namespace
+
 int exynos_ion_alloc(int /* ion_fd */, size_t len, unsigned int heap_mask, unsigned int flags) {
     unsigned int heapflags = flags & (ION_FLAG_PROTECTED | ION_FLAG_CACHED);
 
     auto& bufallocator = exynos_ion_get_allocator();
+    auto& pool = exynos_ion_get_pool();
 
-    for (const auto& it : heap_map_table) {
-        if ((heap_mask == it.legacy_ion_heap_mask) && (heapflags == it.ion_heap_flags)) {
-            int ret = bufallocator.Alloc(it.heap_name, len, flags);
-            if (ret < 0)
-                ALOGE("Failed to alloc %s, %zu %x (%d)", it.heap_name.c_str(), len, flags, ret);
+    int idx = exynos_ion_find_heap(heap_mask, heapflags);
+    if (idx < 0) {
+        ALOGE("%s: unable to find heaps of heap_mask %#x", __func__, heap_mask);
+        return -EINVAL;
+    }
 
+    const auto& heap = heap_map_table[idx];
+    int ret = pool.get(idx, len, flags);
+    if (ret >= 0) {
+        /* the whole buffer of the size class is mappable, not only @len of it */
+        if (!(flags & ION_FLAG_NOZEROED) && !(heapflags & ION_FLAG_PROTECTED) &&
+            exynos_ion_clear_buffer(ret, ion_buffer_pool::sizeClass(len)) < 0) {
+            ALOGE("Failed to clear recycled %s buffer, %zu %x", heap.heap_name.c_str(), len, flags);
+            close(ret);
+            ret = -ENOENT;
+        }
+    }
+
+    if (ret < 0) {
+        /* pooled buffers are sized by class so that they can serve any request of that class */
+        size_t alloc_len = len;
+        if (ret == -ENOENT)
+            alloc_len = ion_buffer_pool::sizeClass(len);
+
+        ret = bufallocator.Alloc(heap.heap_name, alloc_len, flags);
+        if (ret < 0) {
+            ALOGE("Failed to alloc %s, %zu %x (%d)", heap.heap_name.c_str(), len, flags, ret);
             return ret;
         }
+        pool.track(ret, idx, len, alloc_len, flags);
+    } else {
+        pool.track(ret, idx, len, ion_buffer_pool::sizeClass(len), flags);
     }
-    ALOGE("%s: unable to find heaps of heap_mask %#x", __func__, heap_mask);
-    return -EINVAL;
+
+    return ret;
+}
+
+int exynos_ion_free(int fd) {
+    if (fd < 0)
+        return -EINVAL;
+
+    if (!exynos_ion_get_pool().put(fd))
+        close(fd);
+
+    return 0;
+}
+
+int exynos_ion_pool_enable(size_t budget_bytes, unsigned int trim_ms) {
+    return exynos_ion_get_pool().enable(budget_bytes, trim_ms);
+}
+
+void exynos_ion_pool_disable(void) {
+    exynos_ion_get_pool().disable();
+}
+
+void exynos_ion_pool_trim(void) {
+    exynos_ion_get_pool().trim();
+}
+
+void exynos_ion_pool_get_stats(struct exynos_ion_pool_stats *stats) {
+    exynos_ion_get_pool().getStats(stats);
 }
 
 int exynos_ion_import_handle(int /* ion_fd */, int fd, int* handle) {
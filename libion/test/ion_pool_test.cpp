@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "ion_test_fixture.h"
+#include "ion_test_define.h"
+
+class PoolAPI : public IonAllocTest {
+protected:
+    virtual void SetUp() {
+        IonAllocTest::SetUp();
+        ASSERT_EQ(0, exynos_ion_pool_enable(mb(16), 60 * 1000));
+    }
+    virtual void TearDown() {
+        exynos_ion_pool_disable();
+        IonAllocTest::TearDown();
+    }
+
+    struct exynos_ion_pool_stats getStats() {
+        struct exynos_ion_pool_stats stats;
+
+        exynos_ion_pool_get_stats(&stats);
+        return stats;
+    }
+
+    bool fillAndCheckZero(int fd, size_t size, bool fill) {
+        unsigned char *p = reinterpret_cast<unsigned char *>(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        if (p == MAP_FAILED)
+            return false;
+
+        bool zero = true;
+        for (size_t i = 0; i < size; i++) {
+            if (p[i] != 0) {
+                zero = false;
+                break;
+            }
+        }
+        if (fill)
+            memset(p, 0xA5, size);
+
+        munmap(p, size);
+
+        return zero;
+    }
+};
+
+TEST_F(PoolAPI, Reuse)
+{
+    int fd;
+
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), mb(1), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    EXPECT_EQ(0, exynos_ion_free(fd));
+
+    struct exynos_ion_pool_stats stats = getStats();
+    EXPECT_EQ(1UL, stats.retained_buffers);
+    EXPECT_LE(static_cast<size_t>(mb(1)), stats.retained_bytes);
+
+    /* a slightly smaller request falls in the same size class */
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), mkb(1, -4), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    stats = getStats();
+    EXPECT_EQ(1UL, stats.hits);
+    EXPECT_EQ(0UL, stats.retained_buffers);
+    EXPECT_EQ(0, exynos_ion_free(fd));
+
+    /* different flags never share buffers */
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), mb(1), EXYNOS_ION_HEAP_SYSTEM_MASK, 0)) << ": " << strerror(errno);
+    EXPECT_EQ(1UL, getStats().hits);
+    EXPECT_EQ(0, exynos_ion_free(fd));
+}
+
+TEST_F(PoolAPI, ZeroRecycled)
+{
+    int fd;
+
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), kb(256), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    EXPECT_TRUE(fillAndCheckZero(fd, kb(256), true));
+    EXPECT_EQ(0, exynos_ion_free(fd));
+
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), kb(256), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    EXPECT_EQ(1UL, getStats().hits);
+    EXPECT_TRUE(fillAndCheckZero(fd, kb(256), true));
+    EXPECT_EQ(0, exynos_ion_free(fd));
+
+    /* a smaller request of the same class gets the whole buffer cleared, not only its length */
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), mb(1), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    off_t size = lseek(fd, 0, SEEK_END);
+    ASSERT_LE(static_cast<off_t>(mb(1)), size);
+    EXPECT_TRUE(fillAndCheckZero(fd, size, true));
+    EXPECT_EQ(0, exynos_ion_free(fd));
+
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), mkb(1, -4), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    EXPECT_EQ(2UL, getStats().hits);
+    EXPECT_EQ(size, lseek(fd, 0, SEEK_END));
+    EXPECT_TRUE(fillAndCheckZero(fd, size, true));
+    EXPECT_EQ(0, exynos_ion_free(fd));
+
+    /* ION_FLAG_NOZEROED hands the buffer back as it was left */
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), kb(256), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED | ION_FLAG_NOZEROED)) << ": " << strerror(errno);
+    EXPECT_EQ(3UL, getStats().hits);
+    EXPECT_FALSE(fillAndCheckZero(fd, kb(256), false));
+    EXPECT_EQ(0, exynos_ion_free(fd));
+}
+
+TEST_F(PoolAPI, Budget)
+{
+    int fd[3];
+
+    for (int i = 0; i < 3; i++)
+        ASSERT_LE(0, fd[i] = exynos_ion_alloc(getIonFd(), mb(6), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(0, exynos_ion_free(fd[i]));
+
+    struct exynos_ion_pool_stats stats = getStats();
+    EXPECT_GE(static_cast<size_t>(mb(16)), stats.retained_bytes);
+    EXPECT_EQ(2UL, stats.retained_buffers);
+    EXPECT_EQ(1UL, stats.trimmed);
+
+    /* a buffer larger than the whole budget is never retained */
+    ASSERT_LE(0, fd[0] = exynos_ion_alloc(getIonFd(), mb(17), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    EXPECT_EQ(0, exynos_ion_free(fd[0]));
+    EXPECT_EQ(1UL, getStats().rejected);
+}
+
+TEST_F(PoolAPI, Disable)
+{
+    int fd;
+
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), mb(1), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    EXPECT_EQ(0, exynos_ion_free(fd));
+
+    exynos_ion_pool_disable();
+    EXPECT_EQ(0UL, getStats().retained_bytes);
+
+    /* without the pool, exynos_ion_free() is a plain close() */
+    ASSERT_LE(0, fd = exynos_ion_alloc(getIonFd(), mb(1), EXYNOS_ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED)) << ": " << strerror(errno);
+    EXPECT_EQ(0, exynos_ion_free(fd));
+    EXPECT_EQ(-1, fcntl(fd, F_GETFD));
+    EXPECT_EQ(0UL, getStats().retained_buffers);
+}
@@ -43,3 +43,25 @@ ifeq ($(BOARD_USES_VENDORIMAGE), true)
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils
+LOCAL_HEADER_LIBRARIES := libcutils_headers libsystem_headers libhardware_headers google_hal_headers
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/include
+
+LOCAL_SRC_FILES := libscaler-v4l2.cpp libscaler-swscaler.cpp test/libscaler_session_test.cpp
+LOCAL_CFLAGS := -Wall -Werror
+
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE := libexynosscaler_session_test
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+
+ifeq ($(BOARD_USES_VENDORIMAGE), true)
+    LOCAL_PROPRIETARY_MODULE := true
+endif
+
+include $(BUILD_NATIVE_TEST)
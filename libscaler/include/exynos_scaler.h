@@ -88,6 +88,15 @@ typedef struct {
     uint32_t pre_multi;
 } exynos_sc_img;
 
+// a job of the batch api
+typedef struct {
+    exynos_sc_img src;
+    exynos_sc_img dst;
+    int      result;        // 0 if the job is queued successfully
+    int64_t  submit_ns;     // CLOCK_MONOTONIC when the job is queued
+    int64_t  complete_ns;   // when the job is done, 0 if not known yet
+} exynos_sc_job;
+
 enum colorspace {
     COLORSPACE_SMPTE170M,
     COLORSPACE_SMPTE240M,
@@ -200,6 +209,30 @@ int exynos_sc_destroy(void *handle);
  */
 int exynos_sc_convert(void *handle);
 
+/*!
+ * Runs a list of jobs with the handle of exynos_sc_create(). Each job has
+ * its own formats, crops and buffers; what a job shares with the previous
+ * one is not configured again.
+ *
+ * \ingroup exynos_scaler
+ *
+ * \param handle
+ *   libscaler handle[in]
+ *
+ * \param jobs
+ *   jobs to run; result, timing and release fences are returned[in/out]
+ *
+ * \param count
+ *   number of jobs[in]
+ *
+ * \return
+ *   number of failed jobs, -1 on an invalid handle
+ */
+int exynos_sc_run_batch(
+    void *handle,
+    exynos_sc_job *jobs,
+    unsigned int count);
+
 /*!
  * Convert color space with presetup color format
  *
@@ -461,6 +494,55 @@ int exynos_sc_wait_frame_done_exclusive
 int exynos_sc_stop_exclusive
 (void *handle);
 
+/*!
+ * Keeps the device streaming across the jobs of the handle (optional).
+ * Only the settings changed since the last job are applied to the device.
+ * Disabling the session stops the device.
+ *
+ * \ingroup exynos_scaler
+ *
+ * \param handle
+ *   libscaler handle[in]
+ *
+ * \param enable
+ *   nonzero to start the session, zero to stop it[in]
+ *
+ * \return
+ *   error code
+ */
+int exynos_sc_set_session_exclusive(
+    void *handle,
+    int enable);
+
+/*!
+ * Queues a list of jobs to the device of the handle of
+ * exynos_sc_create_exclusive(). Up to four jobs are in flight while the next
+ * ones are configured and queued. What a job shares with the previous one
+ * is not configured again.
+ *
+ * The release fences of every job are returned in the images of the job
+ * and must be closed by the caller. In a session, the last jobs may still
+ * be in flight when this returns: their complete_ns is 0.
+ *
+ * \ingroup exynos_scaler
+ *
+ * \param handle
+ *   libscaler handle[in]
+ *
+ * \param jobs
+ *   jobs to run; result, timing and release fences are returned[in/out]
+ *
+ * \param count
+ *   number of jobs[in]
+ *
+ * \return
+ *   number of failed jobs, -1 on an invalid handle
+ */
+int exynos_sc_run_batch_exclusive(
+    void *handle,
+    exynos_sc_job *jobs,
+    unsigned int count);
+
 int exynos_sc_free_and_close
 (void *handle);
 
@@ -47,6 +47,15 @@ public:
 
     bool Run();
 
+    // M2M1SHOT_IOC_PROCESS completes the job before returning: no fence
+    inline bool Queue(int *pfdSrcReleaseFence, int *pfdDstReleaseFence) {
+        *pfdSrcReleaseFence = -1;
+        *pfdDstReleaseFence = -1;
+        return Run();
+    }
+    inline bool BeginBatch() { return true; }
+    inline bool EndBatch() { return true; }
+
     inline bool Valid() { return m_iFD >= 0; }
 
     inline bool SetSrcFormat(unsigned int width, unsigned int height, unsigned int v4l2_fmt) {
@@ -33,6 +33,8 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 
+#include <cutils/properties.h>
+
 #include "libscaler-v4l2.h"
 #include "libscaler-swscaler.h"
 
@@ -63,6 +65,11 @@ CScalerV4L2::CScalerV4L2(int instance, int allow_drm)
     m_nRotDegree = 0;
     m_fStatus = 0;
     m_filter = 0;
+    m_filterApplied = 0;
+    m_colorspace = V4L2_COLORSPACE_DEFAULT;
+    m_bFmtNeedsNoBuffers = false;
+    m_bBatchSession = false;
+    m_bCtrlNeedsStreamOff = false;
 
     memset(&m_frmSrc, 0, sizeof(m_frmSrc));
     memset(&m_frmDst, 0, sizeof(m_frmDst));
@@ -76,10 +83,16 @@ CScalerV4L2::CScalerV4L2(int instance, int allow_drm)
     m_frmSrc.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
     m_frmDst.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
 
+    m_frmSrc.depth = 1;
+    m_frmDst.depth = 1;
+
     m_frameRate = 0;
 
     Initialize(instance);
 
+    if (property_get_bool("vendor.libscaler.session", false))
+        SetSession(true);
+
     if(Valid()) {
         if (allow_drm)
             SetFlag(m_fStatus, SCF_ALLOW_DRM);
@@ -96,6 +109,80 @@ CScalerV4L2::~CScalerV4L2()
     m_fdScaler = -1;
 }
 
+int CScalerV4L2::DevIoctl(unsigned long request, void *arg)
+{
+    return ioctl(m_fdScaler, request, arg);
+}
+
+bool CScalerV4L2::SetSession(bool enable)
+{
+    if (enable == InSession())
+        return true;
+
+    if (enable) {
+        SetFlag(m_fStatus, SCF_SESSION);
+        // Everything is applied once before the session skips what is unchanged
+        SetFlag(m_fStatus, SCF_ROTATION_FRESH);
+        SetFlag(m_fStatus, SCF_CSC_FRESH);
+        SetFlag(m_frmSrc.flags, SCFF_BUF_FRESH);
+        SetFlag(m_frmDst.flags, SCFF_BUF_FRESH);
+        m_filterApplied = 0;
+
+        SC_LOGD("Started a session on '%s'", m_cszNode);
+        return true;
+    }
+
+    ClearFlag(m_fStatus, SCF_SESSION);
+    SetFlag(m_frmSrc.flags, SCFF_BUF_FRESH);
+    SetFlag(m_frmDst.flags, SCFF_BUF_FRESH);
+
+    SC_LOGD("Stopped the session on '%s'", m_cszNode);
+
+    return Stop();
+}
+
+/*
+ * Prepares the device for new controls. A session only waits for the job in
+ * flight, otherwise the streaming stops. A driver that rejects controls while
+ * streaming has the streaming stopped in a session too, the buffers are kept.
+ */
+bool CScalerV4L2::Reconfigure()
+{
+    if (!InSession())
+        return Stop();
+
+    if (m_bCtrlNeedsStreamOff)
+        return StreamOff(m_frmSrc) && StreamOff(m_frmDst);
+
+    bool ret = DQBuf(m_frmSrc);
+
+    return DQBuf(m_frmDst) && ret;
+}
+
+/*
+ * S_CTRL of a control that the driver may only change while the queues are
+ * stopped. On EBUSY, the streaming restarts with the next job.
+ */
+int CScalerV4L2::DevSetCtrlValue(unsigned int id, int value)
+{
+    struct v4l2_control ctrl;
+
+    ctrl.id = id;
+    ctrl.value = value;
+
+    int ret = DevIoctl(VIDIOC_S_CTRL, &ctrl);
+    if ((ret < 0) && (errno == EBUSY) && InSession() &&
+            (TestFlag(m_frmSrc.flags, SCFF_STREAMING) || TestFlag(m_frmDst.flags, SCFF_STREAMING))) {
+        SC_LOGD("S_CTRL(%#x) needs the streaming stopped", id);
+        m_bCtrlNeedsStreamOff = true;
+        StreamOff(m_frmSrc);
+        StreamOff(m_frmDst);
+        ret = DevIoctl(VIDIOC_S_CTRL, &ctrl);
+    }
+
+    return ret;
+}
+
 bool CScalerV4L2::Stop()
 {
     if (!ResetDevice(m_frmSrc)) {
@@ -111,6 +198,81 @@ bool CScalerV4L2::Stop()
     return true;
 }
 
+bool CScalerV4L2::Queue(int *pfdSrcReleaseFence, int *pfdDstReleaseFence)
+{
+    *pfdSrcReleaseFence = -1;
+    *pfdDstReleaseFence = -1;
+
+    if (!DevSetCtrl())
+        return false;
+
+    if (!DevSetFormat())
+        return false;
+
+    if (!ReqBufs())
+        return false;
+
+    if (!QBuf(pfdSrcReleaseFence, pfdDstReleaseFence)) {
+        if (*pfdSrcReleaseFence >= 0)
+            close(*pfdSrcReleaseFence);
+        *pfdSrcReleaseFence = -1;
+        return false;
+    }
+
+    if (!StreamOn()) {
+        close(*pfdSrcReleaseFence);
+        close(*pfdDstReleaseFence);
+        *pfdSrcReleaseFence = -1;
+        *pfdDstReleaseFence = -1;
+        return false;
+    }
+
+    return true;
+}
+
+void CScalerV4L2::SetQueueDepth(unsigned int depth)
+{
+    if (depth < 1)
+        depth = 1;
+    else if (depth > SC_MAX_QUEUE_DEPTH)
+        depth = SC_MAX_QUEUE_DEPTH;
+
+    m_frmSrc.depth = depth;
+    m_frmDst.depth = depth;
+}
+
+bool CScalerV4L2::BeginBatch()
+{
+    m_bBatchSession = !InSession();
+    if (m_bBatchSession && !SetSession(true))
+        return false;
+
+    SetQueueDepth(SC_MAX_QUEUE_DEPTH);
+
+    return true;
+}
+
+/*
+ * A batch in a session leaves its last jobs in flight for the release
+ * fences to tell their completion. Otherwise the device stops after waiting
+ * for them since STREAMOFF cancels the jobs in flight.
+ */
+bool CScalerV4L2::EndBatch()
+{
+    bool ret = true;
+
+    if (m_bBatchSession) {
+        ret = DQBuf(m_frmSrc);
+        ret = DQBuf(m_frmDst) && ret;
+        ret = SetSession(false) && ret;
+    }
+
+    m_bBatchSession = false;
+    SetQueueDepth(1);
+
+    return ret;
+}
+
 bool CScalerV4L2::Run()
 {
     if (LibScaler::UnderOne16thScaling(
@@ -149,7 +311,7 @@ bool CScalerV4L2::SetCtrl()
 
         ctrl.id = V4L2_CID_CONTENT_PROTECTION;
         ctrl.value = TestFlag(m_fStatus, SCF_DRM);
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
             SC_LOGERR("Failed configure V4L2_CID_CONTENT_PROTECTION to %d", TestFlag(m_fStatus, SCF_DRM));
             return false;
         }
@@ -160,26 +322,20 @@ bool CScalerV4L2::SetCtrl()
     }
 
     if (TestFlag(m_fStatus, SCF_ROTATION_FRESH)) {
-        if (!Stop())
+        if (!Reconfigure())
             return false;
 
-        ctrl.id = V4L2_CID_ROTATE;
-        ctrl.value = m_nRotDegree;
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevSetCtrlValue(V4L2_CID_ROTATE, m_nRotDegree) < 0) {
             SC_LOGERR("Failed V4L2_CID_ROTATE with degree %d", m_nRotDegree);
             return false;
         }
 
-        ctrl.id = V4L2_CID_VFLIP;
-        ctrl.value = TestFlag(m_fStatus, SCF_HFLIP);
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevSetCtrlValue(V4L2_CID_VFLIP, TestFlag(m_fStatus, SCF_HFLIP)) < 0) {
             SC_LOGERR("Failed V4L2_CID_VFLIP - %d", TestFlag(m_fStatus, SCF_VFLIP));
             return false;
         }
 
-        ctrl.id = V4L2_CID_HFLIP;
-        ctrl.value = TestFlag(m_fStatus, SCF_VFLIP);
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevSetCtrlValue(V4L2_CID_HFLIP, TestFlag(m_fStatus, SCF_VFLIP)) < 0) {
             SC_LOGERR("Failed V4L2_CID_HFLIP - %d", TestFlag(m_fStatus, SCF_HFLIP));
             return false;
         }
@@ -191,32 +347,28 @@ bool CScalerV4L2::SetCtrl()
         SC_LOGD("Skipping rotation and flip setting due to no change");
     }
 
-    if (m_filter > 0) {
-        if (!Stop())
+    if (InSession() ? (m_filter != m_filterApplied) : (m_filter > 0)) {
+        if (!Reconfigure())
             return false;
 
-        ctrl.id = LIBSC_V4L2_CID_DNOISE_FT;
-        ctrl.value = m_filter;
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevSetCtrlValue(LIBSC_V4L2_CID_DNOISE_FT, m_filter) < 0) {
             SC_LOGERR("Failed LIBSC_V4L2_CID_DNOISE_FT to %d", m_filter);
             return false;
         }
+
+        m_filterApplied = m_filter;
     }
 
     if (TestFlag(m_fStatus, SCF_CSC_FRESH)) {
-        if (!Stop())
+        if (!Reconfigure())
             return false;
 
-        ctrl.id = V4L2_CID_CSC_RANGE;
-        ctrl.value = TestFlag(m_fStatus, SCF_CSC_WIDE) ? 1 : 0;
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevSetCtrlValue(V4L2_CID_CSC_RANGE, TestFlag(m_fStatus, SCF_CSC_WIDE) ? 1 : 0) < 0) {
             SC_LOGERR("Failed V4L2_CID_CSC_RANGE to %d", TestFlag(m_fStatus, SCF_CSC_WIDE));
             return false;
         }
 
-        ctrl.id = V4L2_CID_CSC_EQ;
-        ctrl.value = m_colorspace;
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevSetCtrlValue(V4L2_CID_CSC_EQ, m_colorspace) < 0) {
             SC_LOGERR("Failed V4L2_CID_CSC_EQ to %d", m_colorspace);
         }
         ClearFlag(m_fStatus, SCF_CSC_FRESH);
@@ -224,12 +376,10 @@ bool CScalerV4L2::SetCtrl()
 
     /* This is optional, so we don't return failure. */
     if (TestFlag(m_fStatus, SCF_FRAMERATE)) {
-        if (!Stop())
+        if (!Reconfigure())
             return false;
 
-        ctrl.id = SC_CID_FRAMERATE;
-        ctrl.value = m_frameRate;
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevSetCtrlValue(SC_CID_FRAMERATE, m_frameRate) < 0) {
             SC_LOGD("Failed SC_CID_FRAMERATE to %d", m_frameRate);
         }
         ClearFlag(m_fStatus, SCF_FRAMERATE);
@@ -243,29 +393,41 @@ bool CScalerV4L2::DevSetCtrl()
     return SetCtrl();
 }
 
-bool CScalerV4L2::ResetDevice(FrameInfo &frm)
+bool CScalerV4L2::StreamOff(FrameInfo &frm)
 {
     DQBuf(frm);
 
     if (TestFlag(frm.flags, SCFF_STREAMING)) {
-        if (ioctl(m_fdScaler, VIDIOC_STREAMOFF, &frm.type) < 0) {
+        if (DevIoctl(VIDIOC_STREAMOFF, &frm.type) < 0) {
             SC_LOGERR("Failed STREAMOFF for the %s", frm.name);
         }
         ClearFlag(frm.flags, SCFF_STREAMING);
     }
 
+    // STREAMOFF returns all queued buffers
+    frm.queued = 0;
+    frm.next_index = 0;
+    ClearFlag(frm.flags, SCFF_QBUF);
+
     SC_LOGD("VIDIC_STREAMOFF is successful for the %s", frm.name);
 
+    return true;
+}
+
+bool CScalerV4L2::ReleaseBufs(FrameInfo &frm)
+{
     if (TestFlag(frm.flags, SCFF_REQBUFS)) {
         v4l2_requestbuffers reqbufs;
         memset(&reqbufs, 0, sizeof(reqbufs));
         reqbufs.type = frm.type;
-        reqbufs.memory = frm.memory;
-        if (ioctl(m_fdScaler, VIDIOC_REQBUFS, &reqbufs) < 0 ) {
+        reqbufs.memory = frm.alloc_memory;
+        if (DevIoctl(VIDIOC_REQBUFS, &reqbufs) < 0 ) {
             SC_LOGERR("Failed to REQBUFS(0) for the %s", frm.name);
         }
 
         ClearFlag(frm.flags, SCFF_REQBUFS);
+        frm.req_count = 0;
+        frm.alloc_count = 0;
     }
 
     SC_LOGD("VIDIC_REQBUFS(0) is successful for the %s", frm.name);
@@ -273,8 +435,171 @@ bool CScalerV4L2::ResetDevice(FrameInfo &frm)
     return true;
 }
 
+bool CScalerV4L2::ResetDevice(FrameInfo &frm)
+{
+    StreamOff(frm);
+
+    return ReleaseBufs(frm);
+}
+
+CScalerV4L2::FormatCacheEntry *CScalerV4L2::FindFormat(FrameInfo &frm)
+{
+    bool premultiplied = TestFlag(frm.flags, SCFF_PREMULTIPLIED);
+
+    for (int i = 0; i < SC_FMT_CACHE_SIZE; i++) {
+        FormatCacheEntry &entry = frm.fmt_cache[i];
+
+        if ((entry.num_planes > 0) && (entry.color_format == frm.color_format) &&
+                (entry.width == frm.width) && (entry.height == frm.height) &&
+                (entry.premultiplied == premultiplied))
+            return &entry;
+    }
+
+    return NULL;
+}
+
+void CScalerV4L2::CacheFormat(FrameInfo &frm)
+{
+    FormatCacheEntry *entry = FindFormat(frm);
+
+    if (!entry) {
+        // Replaces the least recently negotiated format
+        entry = &frm.fmt_cache[0];
+        for (int i = 1; i < SC_FMT_CACHE_SIZE; i++) {
+            if (frm.fmt_cache[i].age < entry->age)
+                entry = &frm.fmt_cache[i];
+        }
+    }
+
+    entry->color_format = frm.color_format;
+    entry->width = frm.width;
+    entry->height = frm.height;
+    entry->premultiplied = TestFlag(frm.flags, SCFF_PREMULTIPLIED);
+    entry->num_planes = frm.out_num_planes;
+    for (int i = 0; i < frm.out_num_planes; i++)
+        entry->plane_size[i] = frm.out_plane_size[i];
+    entry->age = ++frm.fmt_cache_age;
+}
+
+bool CScalerV4L2::FitsBuffers(FrameInfo &frm, int num_planes, const unsigned long plane_size[])
+{
+    if (!TestFlag(frm.flags, SCFF_REQBUFS) || (frm.alloc_memory != frm.memory) ||
+            (frm.alloc_num_planes != num_planes))
+        return false;
+
+    for (int i = 0; i < num_planes; i++) {
+        if (plane_size[i] > frm.alloc_plane_size[i])
+            return false;
+    }
+
+    return true;
+}
+
+bool CScalerV4L2::DevSetCrop(FrameInfo &frm)
+{
+    if (!DQBuf(frm))
+        return false;
+
+    v4l2_crop crop;
+    crop.type = frm.type;
+    crop.c = frm.crop;
+
+    if (DevIoctl(VIDIOC_S_CROP, &crop) < 0) {
+        SC_LOGERR("Failed S_CROP(fmt: %d, l:%d, t:%d, w:%d, h:%d) for the %s",
+                crop.type, crop.c.left, crop.c.top, crop.c.width, crop.c.height,
+                frm.name);
+        return false;
+    }
+
+    ClearFlag(frm.flags, SCFF_CROP_FRESH);
+
+    SC_LOGD("Successfully S_CROP for the %s", frm.name);
+
+    return true;
+}
+
+/*
+ * S_FMT needs the queue to stop streaming but the buffers are released only
+ * if they are too small for the new format. The format cache tells that
+ * before S_FMT for the formats negotiated recently. A driver that rejects
+ * S_FMT while buffers are requested has them released before every S_FMT.
+ */
+bool CScalerV4L2::DevSetFormatSession(FrameInfo &frm)
+{
+    if (TestFlag(frm.flags, SCFF_BUF_FRESH)) {
+        FormatCacheEntry *entry = FindFormat(frm);
+
+        if (!StreamOff(frm))
+            return false;
+
+        if (m_bFmtNeedsNoBuffers ||
+                (entry && !FitsBuffers(frm, entry->num_planes, entry->plane_size)))
+            ReleaseBufs(frm);
+
+        v4l2_format fmt;
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.type = frm.type;
+        fmt.fmt.pix_mp.pixelformat = frm.color_format;
+        fmt.fmt.pix_mp.width  = frm.width;
+        fmt.fmt.pix_mp.height = frm.height;
+
+        if (TestFlag(frm.flags, SCFF_PREMULTIPLIED)) {
+#ifdef SCALER_USE_PREMUL_FMT
+            fmt.fmt.pix_mp.flags = V4L2_PIX_FMT_FLAG_PREMUL_ALPHA;
+#else
+            fmt.fmt.pix_mp.reserved[1] = SC_V4L2_FMT_PREMULTI_FLAG;
+#endif
+        }
+
+        int ret = DevIoctl(VIDIOC_S_FMT, &fmt);
+        if ((ret < 0) && (errno == EBUSY) && TestFlag(frm.flags, SCFF_REQBUFS)) {
+            SC_LOGD("S_FMT for the %s needs the buffers released", frm.name);
+            m_bFmtNeedsNoBuffers = true;
+            ReleaseBufs(frm);
+            ret = DevIoctl(VIDIOC_S_FMT, &fmt);
+        }
+
+        if (ret < 0) {
+            SC_LOGERR("Failed S_FMT(fmt: %d, w:%d, h:%d) for the %s",
+                    fmt.fmt.pix_mp.pixelformat, fmt.fmt.pix_mp.width, fmt.fmt.pix_mp.height,
+                    frm.name);
+            return false;
+        }
+
+        if (fmt.fmt.pix_mp.num_planes > SC_MAX_PLANES) {
+            SC_LOGE("Number of planes exceeds %d of %s", fmt.fmt.pix_mp.num_planes, frm.name);
+            return false;
+        }
+
+        frm.out_num_planes = fmt.fmt.pix_mp.num_planes;
+        for (int i = 0; i < frm.out_num_planes; i++)
+            frm.out_plane_size[i] = fmt.fmt.pix_mp.plane_fmt[i].sizeimage;
+
+        if (TestFlag(frm.flags, SCFF_REQBUFS) &&
+                !FitsBuffers(frm, frm.out_num_planes, frm.out_plane_size))
+            ReleaseBufs(frm);
+
+        CacheFormat(frm);
+
+        ClearFlag(frm.flags, SCFF_BUF_FRESH);
+        // The driver resets the crop on S_FMT
+        SetFlag(frm.flags, SCFF_CROP_FRESH);
+
+        SC_LOGD("Successfully S_FMT for the %s", frm.name);
+    }
+
+    if (TestFlag(frm.flags, SCFF_CROP_FRESH))
+        return DevSetCrop(frm);
+
+    SC_LOGD("Skipping S_FMT and S_CROP for the %s since nothing changed", frm.name);
+
+    return true;
+}
+
 bool CScalerV4L2::DevSetFormat(FrameInfo &frm)
 {
+    if (InSession())
+        return DevSetFormatSession(frm);
 
     if (!TestFlag(frm.flags, SCFF_BUF_FRESH)) {
         SC_LOGD("Skipping S_FMT for the %s since it is already done", frm.name);
@@ -301,7 +626,7 @@ bool CScalerV4L2::DevSetFormat(FrameInfo &frm)
 #endif
     }
 
-    if (ioctl(m_fdScaler, VIDIOC_S_FMT, &fmt) < 0) {
+    if (DevIoctl(VIDIOC_S_FMT, &fmt) < 0) {
         SC_LOGERR("Failed S_FMT(fmt: %d, w:%d, h:%d) for the %s",
                 fmt.fmt.pix_mp.pixelformat, fmt.fmt.pix_mp.width, fmt.fmt.pix_mp.height,
                 frm.name);
@@ -318,7 +643,7 @@ bool CScalerV4L2::DevSetFormat(FrameInfo &frm)
     crop.type = frm.type;
     crop.c = frm.crop;
 
-    if (ioctl(m_fdScaler, VIDIOC_S_CROP, &crop) < 0) {
+    if (DevIoctl(VIDIOC_S_CROP, &crop) < 0) {
         SC_LOGERR("Failed S_CROP(fmt: %d, l:%d, t:%d, w:%d, h:%d) for the %s",
                 crop.type, crop.c.left, crop.c.top, crop.c.width, crop.c.height,
                 frm.name);
@@ -331,6 +656,7 @@ bool CScalerV4L2::DevSetFormat(FrameInfo &frm)
     }
 
     ClearFlag(frm.flags, SCFF_BUF_FRESH);
+    ClearFlag(frm.flags, SCFF_CROP_FRESH);
 
     SC_LOGD("Successfully S_FMT and S_CROP for the %s", frm.name);
 
@@ -356,15 +682,21 @@ bool CScalerV4L2::QBuf(FrameInfo &frm, int *pfdReleaseFence)
         return false;
     }
 
-    if (!DQBuf(frm))
+    if (!InSession()) {
+        // Every job completes before the next one, however many buffers the driver allocated
+        if (!DQBuf(frm))
+            return false;
+    } else if ((frm.queued >= frm.alloc_count) && !DQBufOldest(frm)) {
+        // All buffers are in flight: wait for the oldest one
         return false;
+    }
 
     memset(&buffer, 0, sizeof(buffer));
     memset(&planes, 0, sizeof(planes));
 
     buffer.type   = frm.type;
     buffer.memory = frm.memory;
-    buffer.index  = 0;
+    buffer.index  = frm.next_index;
     buffer.length = frm.out_num_planes;
 
     if (pfdReleaseFence) {
@@ -384,12 +716,14 @@ bool CScalerV4L2::QBuf(FrameInfo &frm, int *pfdReleaseFence)
     }
 
 
-    if (ioctl(m_fdScaler, VIDIOC_QBUF, &buffer) < 0) {
+    if (DevIoctl(VIDIOC_QBUF, &buffer) < 0) {
         SC_LOGERR("Failed to QBUF for the %s", frm.name);
         return false;
     }
 
     SetFlag(frm.flags, SCFF_QBUF);
+    frm.queued++;
+    frm.next_index = (frm.next_index + 1) % frm.alloc_count;
 
     if (pfdReleaseFence) {
         if (frm.fdAcquireFence >= 0)
@@ -409,23 +743,42 @@ bool CScalerV4L2::ReqBufs(FrameInfo &frm)
     v4l2_requestbuffers reqbufs;
 
     if (TestFlag(frm.flags, SCFF_REQBUFS)) {
-        SC_LOGD("Skipping REQBUFS for the %s since it is already done", frm.name);
-        return true;
+        if ((frm.alloc_memory == frm.memory) && (frm.req_count >= frm.depth)) {
+            SC_LOGD("Skipping REQBUFS for the %s since it is already done", frm.name);
+            return true;
+        }
+
+        // A session may change the memory type or the depth of the queue
+        ResetDevice(frm);
     }
 
     memset(&reqbufs, 0, sizeof(reqbufs));
 
     reqbufs.type    = frm.type;
     reqbufs.memory  = frm.memory;
-    reqbufs.count   = 1;
+    reqbufs.count   = frm.depth;
 
-    if (ioctl(m_fdScaler, VIDIOC_REQBUFS, &reqbufs) < 0) {
+    if (DevIoctl(VIDIOC_REQBUFS, &reqbufs) < 0) {
         SC_LOGERR("Failed to REQBUFS for the %s", frm.name);
         return false;
     }
 
+    if (reqbufs.count == 0) {
+        SC_LOGE("No buffer is allocated by REQBUFS for the %s", frm.name);
+        return false;
+    }
+
     SetFlag(frm.flags, SCFF_REQBUFS);
 
+    // The driver may allocate fewer or more buffers than requested
+    frm.req_count = frm.depth;
+    frm.alloc_count = reqbufs.count;
+    frm.next_index = 0;
+    frm.alloc_memory = frm.memory;
+    frm.alloc_num_planes = frm.out_num_planes;
+    for (int i = 0; i < frm.out_num_planes; i++)
+        frm.alloc_plane_size[i] = frm.out_plane_size[i];
+
     SC_LOGD("Successfully REQBUFS for the %s", frm.name);
 
     return true;
@@ -438,6 +791,9 @@ bool CScalerV4L2::SetRotate(int rot, int flip_h, int flip_v)
         return false;
     }
 
+    bool fresh = !InSession() || (TestFlag(m_fStatus, SCF_VFLIP) != !!flip_h) ||
+                 (TestFlag(m_fStatus, SCF_HFLIP) != !!flip_v);
+
     SetRotDegree(rot);
 
     if (flip_h)
@@ -450,7 +806,8 @@ bool CScalerV4L2::SetRotate(int rot, int flip_h, int flip_v)
     else
         ClearFlag(m_fStatus, SCF_HFLIP);
 
-    SetFlag(m_fStatus, SCF_ROTATION_FRESH);
+    if (fresh)
+        SetFlag(m_fStatus, SCF_ROTATION_FRESH);
 
     return true;
 }
@@ -464,7 +821,7 @@ bool CScalerV4L2::StreamOn(FrameInfo &frm)
     }
 
     if (!TestFlag(frm.flags, SCFF_STREAMING)) {
-        if (ioctl(m_fdScaler, VIDIOC_STREAMON, &frm.type) < 0 ) {
+        if (DevIoctl(VIDIOC_STREAMON, &frm.type) < 0 ) {
             SC_LOGERR("Failed StreamOn for the %s", frm.name);
             return false;
         }
@@ -478,6 +835,18 @@ bool CScalerV4L2::StreamOn(FrameInfo &frm)
 }
 
 bool CScalerV4L2::DQBuf(FrameInfo &frm)
+{
+    bool ret = true;
+
+    while (frm.queued > 0) {
+        if (!DQBufOldest(frm))
+            ret = false;
+    }
+
+    return ret;
+}
+
+bool CScalerV4L2::DQBufOldest(FrameInfo &frm)
 {
     if (!TestFlag(frm.flags, SCFF_QBUF))
         return true;
@@ -497,9 +866,11 @@ bool CScalerV4L2::DQBuf(FrameInfo &frm)
         buffer.m.planes = plane;
     }
 
-    ClearFlag(frm.flags, SCFF_QBUF);
+    // A buffer failed to dequeue is not waited for again
+    if (--frm.queued == 0)
+        ClearFlag(frm.flags, SCFF_QBUF);
 
-    if (ioctl(m_fdScaler, VIDIOC_DQBUF, &buffer) < 0 ) {
+    if (DevIoctl(VIDIOC_DQBUF, &buffer) < 0 ) {
         SC_LOGERR("Failed to DQBuf the %s", frm.name);
         return false;
     }
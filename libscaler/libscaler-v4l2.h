@@ -63,6 +63,8 @@ public:
         SCFF_REQBUFS,
         SCFF_QBUF,
         SCFF_STREAMING,
+        // the crop changed but not the format
+        SCFF_CROP_FRESH,
     };
 
     enum SC_FLAG {
@@ -79,6 +81,21 @@ public:
         SCF_CSC_WIDE,
 	SCF_SRC_BLEND,
 	SCF_FRAMERATE,
+        // keep streaming across jobs
+        SCF_SESSION,
+    };
+
+    enum { SC_FMT_CACHE_SIZE = 4 };
+    enum { SC_MAX_QUEUE_DEPTH = 4 };
+
+    // The plane layout the driver negotiated for a format
+    struct FormatCacheEntry {
+        unsigned int color_format;
+        unsigned int width, height;
+        bool premultiplied;
+        int num_planes;
+        unsigned long plane_size[SC_MAX_PLANES];
+        unsigned int age;
     };
 
     struct FrameInfo {
@@ -93,6 +110,18 @@ public:
         int out_num_planes;
         unsigned long out_plane_size[SC_MAX_PLANES];
         unsigned long flags; // enum SC_FRAME_FLAG
+        // the layout the buffers were requested with by REQBUFS
+        enum v4l2_memory alloc_memory;
+        int alloc_num_planes;
+        unsigned long alloc_plane_size[SC_MAX_PLANES];
+        FormatCacheEntry fmt_cache[SC_FMT_CACHE_SIZE];
+        unsigned int fmt_cache_age;
+        // buffers to request and the ring of the requested buffers
+        unsigned int depth;
+        unsigned int req_count;
+        unsigned int alloc_count;
+        unsigned int queued;
+        unsigned int next_index;
     };
 
 private:
@@ -107,18 +136,36 @@ private:
     int m_fdValidate;
 
     unsigned int m_filter;
+    unsigned int m_filterApplied;
     unsigned int m_colorspace;
 
+    // The driver rejects S_FMT while buffers are requested, not only while streaming
+    bool m_bFmtNeedsNoBuffers;
+    // The session was started by BeginBatch()
+    bool m_bBatchSession;
+    // The driver rejects S_CTRL while streaming
+    bool m_bCtrlNeedsStreamOff;
+
     void Initialize(int instance);
     bool ResetDevice(FrameInfo &frm);
+    bool StreamOff(FrameInfo &frm);
+    bool ReleaseBufs(FrameInfo &frm);
+    bool Reconfigure();
+    int DevSetCtrlValue(unsigned int id, int value);
+    bool DevSetFormatSession(FrameInfo &frm);
+    bool DevSetCrop(FrameInfo &frm);
+    FormatCacheEntry *FindFormat(FrameInfo &frm);
+    void CacheFormat(FrameInfo &frm);
+    bool FitsBuffers(FrameInfo &frm, int num_planes, const unsigned long plane_size[]);
 
     inline void SetRotDegree(int rot) {
         rot = rot % 360;
         if (rot < 0)
             rot = 360 + rot;
 
+        if (!InSession() || (m_nRotDegree != static_cast<unsigned int>(rot)))
+            SetFlag(m_fStatus, SCF_ROTATION_FRESH);
         m_nRotDegree = rot;
-        SetFlag(m_fStatus, SCF_ROTATION_FRESH);
     }
 
     bool DevSetFormat(FrameInfo &frm);
@@ -126,27 +173,39 @@ private:
     bool QBuf(FrameInfo &frm, int *pfdReleaseFence);
     bool StreamOn(FrameInfo &frm);
     bool DQBuf(FrameInfo &frm);
+    bool DQBufOldest(FrameInfo &frm);
 
     inline bool SetFormat(FrameInfo &frm, unsigned int width, unsigned int height,
                    unsigned int v4l2_colorformat) {
+        if (!InSession() || (frm.color_format != v4l2_colorformat) ||
+                (frm.width != width) || (frm.height != height))
+            SetFlag(frm.flags, SCFF_BUF_FRESH);
         frm.color_format = v4l2_colorformat;
         frm.width = width;
         frm.height = height;
-        SetFlag(frm.flags, SCFF_BUF_FRESH);
         return true;
     }
 
     inline bool SetCrop(FrameInfo &frm, unsigned int left, unsigned int top,
                  unsigned int width, unsigned int height) {
+        // A session changes the crop without restarting the streaming
+        if (!InSession())
+            SetFlag(frm.flags, SCFF_BUF_FRESH);
+        else if ((frm.crop.left != static_cast<int>(left)) ||
+                 (frm.crop.top != static_cast<int>(top)) ||
+                 (frm.crop.width != width) || (frm.crop.height != height))
+            SetFlag(frm.flags, SCFF_CROP_FRESH);
         frm.crop.left = left;
         frm.crop.top = top;
         frm.crop.width = width;
         frm.crop.height = height;
-        SetFlag(frm.flags, SCFF_BUF_FRESH);
         return true;
     }
 
     inline void SetPremultiplied(FrameInfo &frm, unsigned int premultiplied) {
+        if (InSession() && (TestFlag(frm.flags, SCFF_PREMULTIPLIED) != !!premultiplied))
+            SetFlag(frm.flags, SCFF_BUF_FRESH);
+
         if (premultiplied)
             SetFlag(frm.flags, SCFF_PREMULTIPLIED);
         else
@@ -185,6 +244,11 @@ protected:
         return (flags & (1 << flag)) != 0;
     }
 
+    inline bool InSession() { return TestFlag(m_fStatus, SCF_SESSION); }
+
+    // All ioctls on the device go through here
+    virtual int DevIoctl(unsigned long request, void *arg);
+
 
 public:
     inline bool Valid() { return (m_fdScaler >= 0) && (m_fdScaler == -m_fdValidate); }
@@ -195,11 +259,27 @@ public:
     bool SetCtrl();
 
     inline bool IsDRMAllowed() { return TestFlag(m_fStatus, SCF_ALLOW_DRM); }
+    /*
+     * In a session both queues keep streaming across jobs. Only the settings
+     * that changed are applied: crop changes need no restart and a format
+     * change releases the buffers only if they are too small for it.
+     */
+    bool SetSession(bool enable);
     inline int GetScalerID() { return m_iInstance; }
 
     bool Stop();
     bool Run(); // Blocking mode
 
+    /*
+     * Queues the configured job without waiting for it. Up to the queue depth
+     * of jobs are in flight; queueing more waits for the oldest one.
+     */
+    bool Queue(int *pfdSrcReleaseFence, int *pfdDstReleaseFence);
+    // Jobs of a batch keep the device streaming and are queued up to SC_MAX_QUEUE_DEPTH
+    bool BeginBatch();
+    bool EndBatch();
+    void SetQueueDepth(unsigned int depth);
+
     // H/W Control
     virtual bool DevSetCtrl();
     bool DevSetFormat();
@@ -216,7 +296,8 @@ public:
             return false;
 
         if (!QBuf(m_frmDst, pfdDstReleaseFence)) {
-            ClearFlag(m_frmSrc.flags, SCFF_QBUF);
+            if (--m_frmSrc.queued == 0)
+                ClearFlag(m_frmSrc.flags, SCFF_QBUF);
             return false;
         }
         return true;
@@ -267,6 +348,9 @@ public:
     }
 
     inline void SetCSCWide(bool wide) {
+        if (InSession() && (TestFlag(m_fStatus, SCF_CSC_WIDE) == wide))
+            return;
+
         if (wide)
             SetFlag(m_fStatus, SCF_CSC_WIDE);
         else
@@ -277,9 +361,12 @@ public:
 
     inline void SetCSCEq(unsigned int v4l2_colorspace) {
         if (v4l2_colorspace == V4L2_COLORSPACE_SMPTE170M)
-            m_colorspace = V4L2_COLORSPACE_DEFAULT;
-        else
-            m_colorspace = v4l2_colorspace;
+            v4l2_colorspace = V4L2_COLORSPACE_DEFAULT;
+
+        if (InSession() && (m_colorspace == v4l2_colorspace))
+            return;
+
+        m_colorspace = v4l2_colorspace;
         SetFlag(m_fStatus, SCF_CSC_FRESH);
     }
 
@@ -317,6 +404,9 @@ public:
     }
 
     inline void SetFrameRate(int framerate) {
+        if (InSession() && (m_frameRate == static_cast<unsigned int>(framerate)))
+            return;
+
         m_frameRate = framerate;
         SetFlag(m_fStatus, SCF_FRAMERATE);
     }
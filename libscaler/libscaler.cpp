@@ -33,7 +33,9 @@
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
+#include <linux/sync_file.h>
 #include <system/graphics.h>
 
 #include "exynos_scaler.h"
@@ -516,6 +518,21 @@ int exynos_sc_stop_exclusive(void *handle)
     return 0;
 }
 
+int exynos_sc_set_session_exclusive(void *handle, int enable)
+{
+    CScalerV4L2 *sc = GetScaler(handle);
+    if (!sc)
+        return -1;
+
+    if (!sc->SetSession(!!enable)) {
+        SC_LOGE("Failed to %s the session of Scaler (handle %p)",
+                enable ? "start" : "stop", handle);
+        return -1;
+    }
+
+    return 0;
+}
+
 int exynos_sc_csc_exclusive(void *handle,
                 unsigned int range_full,
                 unsigned int v4l2_colorspace)
@@ -530,18 +547,24 @@ int exynos_sc_csc_exclusive(void *handle,
     return 0;
 }
 
-int exynos_sc_config_exclusive(
-    void *handle,
-    exynos_sc_img *src_img,
-    exynos_sc_img *dst_img)
+// Only the V4L2 scalers know their instance number
+static int GetScalerID(CScalerV4L2 *sc)
 {
-    CScalerV4L2 *sc = GetScaler(handle);
-    if (!sc)
-        return -1;
+    return sc->GetScalerID();
+}
 
-    if (src_img->drmMode && !sc->IsDRMAllowed()) {
+template <class T>
+static int GetScalerID(T *)
+{
+    return -1;
+}
+
+template <class T>
+static int ConfigScaler(T *sc, exynos_sc_img *src_img, exynos_sc_img *dst_img, bool allow_drm)
+{
+    if (src_img->drmMode && !allow_drm) {
         SC_LOGE("Invalid DRM state request for Scaler%d (s=%d d=%d)",
-                sc->GetScalerID(), src_img->drmMode, dst_img->drmMode);
+                GetScalerID(sc), src_img->drmMode, dst_img->drmMode);
         return -1;
     }
 
@@ -594,15 +617,8 @@ int exynos_sc_config_exclusive(
     return 0;
 }
 
-int exynos_sc_run_exclusive(
-    void *handle,
-    exynos_sc_img *src_img,
-    exynos_sc_img *dst_img)
+static void SetImageAddr(CScalerV4L2 *sc, exynos_sc_img *src_img, exynos_sc_img *dst_img)
 {
-    CScalerV4L2 *sc = GetScaler(handle);
-    if (!sc)
-        return -1;
-
     void *addr[SC_NUM_OF_PLANES];
 
     addr[0] = (void *)src_img->yaddr;
@@ -614,26 +630,149 @@ int exynos_sc_run_exclusive(
     addr[1] = (void *)dst_img->uaddr;
     addr[2] = (void *)dst_img->vaddr;
     sc->SetDstAddr(addr, dst_img->mem_type, dst_img->acquireFenceFd);
+}
 
-    if (!sc->DevSetCtrl())
-        return -1;
+// acquire fences are ignored by blocking mode
+static void SetImageAddr(CScalerM2M1SHOT *sc, exynos_sc_img *src_img, exynos_sc_img *dst_img)
+{
+    void *addr[SC_NUM_OF_PLANES];
+
+    addr[0] = (void *)src_img->yaddr;
+    addr[1] = (void *)src_img->uaddr;
+    addr[2] = (void *)src_img->vaddr;
+    sc->SetSrcAddr(addr, src_img->mem_type);
+
+    addr[0] = (void *)dst_img->yaddr;
+    addr[1] = (void *)dst_img->uaddr;
+    addr[2] = (void *)dst_img->vaddr;
+    sc->SetDstAddr(addr, dst_img->mem_type);
+}
+
+static int64_t GetMonotonicTime()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
-    if (!sc->DevSetFormat())
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Returns when the fence signaled, 0 if it is not signaled yet
+static int64_t GetFenceSignalTime(int fence)
+{
+    struct sync_fence_info info[SC_NUM_OF_PLANES];
+    struct sync_file_info file;
+
+    memset(&file, 0, sizeof(file));
+    file.num_fences = SC_NUM_OF_PLANES;
+    file.sync_fence_info = reinterpret_cast<uintptr_t>(info);
+
+    if ((ioctl(fence, SYNC_IOC_FILE_INFO, &file) < 0) || (file.status != 1))
+        return 0;
+
+    int64_t signal_ns = 0;
+    for (unsigned int i = 0; (i < file.num_fences) && (i < SC_NUM_OF_PLANES); i++) {
+        if (static_cast<int64_t>(info[i].timestamp_ns) > signal_ns)
+            signal_ns = info[i].timestamp_ns;
+    }
+
+    return signal_ns;
+}
+
+/*
+ * The jobs are configured one by one and the scaler applies only what
+ * changed since the previous job. Queue() of a device without fences
+ * returns when the job is done.
+ */
+template <class T>
+static int RunScalerBatch(T *sc, exynos_sc_job *jobs, unsigned int count, bool allow_drm)
+{
+    int failed = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+        jobs[i].result = -1;
+        jobs[i].submit_ns = 0;
+        jobs[i].complete_ns = 0;
+        jobs[i].src.releaseFenceFd = -1;
+        jobs[i].dst.releaseFenceFd = -1;
+    }
+
+    if (!sc->BeginBatch()) {
+        SC_LOGE("Failed to begin a batch of %u jobs", count);
+        return count;
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        exynos_sc_job &job = jobs[i];
+
+        if (ConfigScaler(sc, &job.src, &job.dst, allow_drm) < 0) {
+            SC_LOGE("Failed to configure job %u of the batch", i);
+            failed++;
+            continue;
+        }
+
+        SetImageAddr(sc, &job.src, &job.dst);
+
+        job.submit_ns = GetMonotonicTime();
+        if (!sc->Queue(&job.src.releaseFenceFd, &job.dst.releaseFenceFd)) {
+            SC_LOGE("Failed to queue job %u of the batch", i);
+            failed++;
+            continue;
+        }
+
+        if (job.dst.releaseFenceFd < 0)
+            job.complete_ns = GetMonotonicTime();
+
+        job.result = 0;
+    }
+
+    if (!sc->EndBatch())
+        SC_LOGE("Failed to end the batch of %u jobs", count);
+
+    for (unsigned int i = 0; i < count; i++) {
+        if ((jobs[i].result == 0) && (jobs[i].dst.releaseFenceFd >= 0))
+            jobs[i].complete_ns = GetFenceSignalTime(jobs[i].dst.releaseFenceFd);
+    }
+
+    return failed;
+}
+
+int exynos_sc_run_batch(void *handle, exynos_sc_job *jobs, unsigned int count)
+{
+    CScalerNonStream *sc = GetNonStreamScaler(handle);
+    if (!sc)
         return -1;
 
-    if (!sc->ReqBufs())
+    return RunScalerBatch(sc, jobs, count, true);
+}
+
+int exynos_sc_config_exclusive(
+    void *handle,
+    exynos_sc_img *src_img,
+    exynos_sc_img *dst_img)
+{
+    CScalerV4L2 *sc = GetScaler(handle);
+    if (!sc)
         return -1;
 
-    int fdSrcReleaseFence, fdDstReleaseFence;
+    return ConfigScaler(sc, src_img, dst_img, sc->IsDRMAllowed());
+}
 
-    if (!sc->QBuf(&fdSrcReleaseFence, &fdDstReleaseFence))
+int exynos_sc_run_exclusive(
+    void *handle,
+    exynos_sc_img *src_img,
+    exynos_sc_img *dst_img)
+{
+    CScalerV4L2 *sc = GetScaler(handle);
+    if (!sc)
         return -1;
 
-    if (!sc->StreamOn()) {
-        close(fdSrcReleaseFence);
-        close(fdDstReleaseFence);
+    SetImageAddr(sc, src_img, dst_img);
+
+    int fdSrcReleaseFence, fdDstReleaseFence;
+
+    if (!sc->Queue(&fdSrcReleaseFence, &fdDstReleaseFence))
         return -1;
-    }
 
     src_img->releaseFenceFd = fdSrcReleaseFence;
     dst_img->releaseFenceFd = fdDstReleaseFence;
@@ -641,6 +780,15 @@ int exynos_sc_run_exclusive(
     return 0;
 }
 
+int exynos_sc_run_batch_exclusive(void *handle, exynos_sc_job *jobs, unsigned int count)
+{
+    CScalerV4L2 *sc = GetScaler(handle);
+    if (!sc)
+        return -1;
+
+    return RunScalerBatch(sc, jobs, count, sc->IsDRMAllowed());
+}
+
 void *exynos_sc_create_blend_exclusive(
         int dev_num,
         int allow_drm
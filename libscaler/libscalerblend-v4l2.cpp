@@ -18,7 +18,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
     ctrl.id = V4L2_CID_2D_BLEND_OP;
     ctrl.value = m_SrcBlndCfg.blop;
-    if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+    if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
         SC_LOGERR("Failed S_CTRL V4L2_CID_2D_BLEND_OP");
         return false;
     }
@@ -26,14 +26,14 @@ bool CScalerBlendV4L2::DevSetCtrl()
     if (m_SrcBlndCfg.globalalpha.enable) {
         ctrl.id = V4L2_CID_GLOBAL_ALPHA;
         ctrl.value = m_SrcBlndCfg.globalalpha.val;
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
                SC_LOGERR("Failed S_CTRL V4L2_CID_GLOBAL_ALPHA");
                return false;
         }
     } else {
         ctrl.id = V4L2_CID_GLOBAL_ALPHA;
         ctrl.value = 0xff;
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
                 SC_LOGERR("Failed S_CTRL V4L2_CID_GLOBAL_ALPHA 0xff");
                 return false;
         }
@@ -44,7 +44,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
         ctrl.id = V4L2_CID_CSC_EQ;
         ctrl.value = is_bt709;
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
             SC_LOGERR("Failed S_CTRL V4L2_CID_CSC_EQ - %d",
                                                    m_SrcBlndCfg.cscspec.space);
             return false;
@@ -52,7 +52,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
         ctrl.id = V4L2_CID_CSC_RANGE;
         ctrl.value = m_SrcBlndCfg.cscspec.wide;
-        if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+        if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
             SC_LOGERR("Failed S_CTRL V4L2_CID_CSC_RANGE - %d",
                                                    m_SrcBlndCfg.cscspec.wide);
             return false;
@@ -61,7 +61,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
     ctrl.id = V4L2_CID_2D_SRC_BLEND_SET_FMT;
     ctrl.value = m_SrcBlndCfg.srcblendfmt;
-    if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+    if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
         SC_LOGERR("Failed V4L2_CID_2D_SRC_BLEND_SET_FMT - %d",
                                                   m_SrcBlndCfg.srcblendfmt);
         return false;
@@ -69,7 +69,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
     ctrl.id = V4L2_CID_2D_SRC_BLEND_FMT_PREMULTI;
     ctrl.value = m_SrcBlndCfg.srcblendpremulti;
-    if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+    if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
         SC_LOGERR("Failed V4L2_CID_2D_BLEND_FMT_PREMULTI - %d",
                                                    m_SrcBlndCfg.srcblendpremulti);
         return false;
@@ -77,7 +77,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
     ctrl.id = V4L2_CID_2D_SRC_BLEND_SET_STRIDE;
     ctrl.value = m_SrcBlndCfg.srcblendstride;
-    if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+    if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
         SC_LOGERR("Failed V4L2_CID_2D_SRC_BLEND_SET_STRIDE - %d",
                                                    m_SrcBlndCfg.srcblendstride);
         return false;
@@ -85,7 +85,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
     ctrl.id = V4L2_CID_2D_SRC_BLEND_SET_H_POS;
     ctrl.value = m_SrcBlndCfg.srcblendhpos;
-    if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+    if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
         SC_LOGERR("Failed V4L2_CID_2D_SRC_BLEND_SET_H_POS with degree %d",
                                                    m_SrcBlndCfg.srcblendhpos);
         return false;
@@ -93,7 +93,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
     ctrl.id = V4L2_CID_2D_SRC_BLEND_SET_V_POS;
     ctrl.value = m_SrcBlndCfg.srcblendvpos;
-    if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+    if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
         SC_LOGERR("Failed V4L2_CID_2D_SRC_BLEND_SET_V_POS - %d",
                                                    m_SrcBlndCfg.srcblendvpos);
         return false;
@@ -101,7 +101,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
     ctrl.id = V4L2_CID_2D_SRC_BLEND_SET_WIDTH;
     ctrl.value = m_SrcBlndCfg.srcblendwidth;
-    if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+    if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
         SC_LOGERR("Failed V4L2_CID_2D_SRC_BLEND_SET_WIDTH with degree %d",
                                                    m_SrcBlndCfg.srcblendwidth);
         return false;
@@ -109,7 +109,7 @@ bool CScalerBlendV4L2::DevSetCtrl()
 
     ctrl.id = V4L2_CID_2D_SRC_BLEND_SET_HEIGHT;
     ctrl.value = m_SrcBlndCfg.srcblendheight;
-    if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
+    if (DevIoctl(VIDIOC_S_CTRL, &ctrl) < 0) {
         SC_LOGERR("Failed V4L2_CID_2D_SRC_BLEND_SET_HEIGHT - %d",
                                                    m_SrcBlndCfg.srcblendheight);
         return false;
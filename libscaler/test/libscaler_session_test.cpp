@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+#include "libscaler-v4l2.h"
+
+namespace {
+
+/*
+ * A V4L2 M2M driver that enforces the rules of videobuf2: S_FMT fails with
+ * EBUSY while a queue streams (or has buffers if strict), QBUF fails on a
+ * buffer smaller than the format or already queued and STREAMON needs
+ * REQBUFS. Like most scaler drivers, S_CTRL fails with EBUSY while a queue
+ * streams unless allowed. The jobs complete in order when their buffers are
+ * dequeued.
+ */
+class FakeScaler : public CScalerV4L2 {
+public:
+    FakeScaler() : CScalerV4L2(0) {}
+
+    void setStrict(bool strict) { mStrict = strict; }
+    void setMaxBuffers(unsigned int max) { mMaxBuffers = max; }
+    void setMinBuffers(unsigned int min) { mMinBuffers = min; }
+    void setCtrlWhileStreaming(bool allow) { mCtrlWhileStreaming = allow; }
+    void clear() { mCount.clear(); }
+    unsigned int requested(int type) { return mQueue[type].count; }
+    unsigned int maxInFlight(int type) { return mQueue[type].max_in_flight; }
+    int count(unsigned long request) { return mCount[request]; }
+    int total() {
+        int sum = 0;
+        for (auto &[request, count] : mCount) sum += count;
+        return sum;
+    }
+
+protected:
+    int DevIoctl(unsigned long request, void *arg) override {
+        mCount[request]++;
+
+        switch (request) {
+            case VIDIOC_S_FMT: {
+                auto fmt = static_cast<v4l2_format *>(arg);
+                BufQueue &q = mQueue[fmt->type];
+                if (q.streaming || (mStrict && q.allocated)) return fail(EBUSY);
+                setLayout(fmt->fmt.pix_mp);
+                q.num_planes = fmt->fmt.pix_mp.num_planes;
+                for (int i = 0; i < q.num_planes; i++)
+                    q.size[i] = fmt->fmt.pix_mp.plane_fmt[i].sizeimage;
+                return 0;
+            }
+            case VIDIOC_REQBUFS: {
+                auto reqbufs = static_cast<v4l2_requestbuffers *>(arg);
+                BufQueue &q = mQueue[reqbufs->type];
+                if (q.streaming) return fail(EBUSY);
+                if (reqbufs->count > 0)
+                    reqbufs->count = std::max(std::min(reqbufs->count, mMaxBuffers), mMinBuffers);
+                q.count = reqbufs->count;
+                q.allocated = reqbufs->count > 0;
+                for (int i = 0; i < q.num_planes; i++) q.alloc[i] = q.allocated ? q.size[i] : 0;
+                return 0;
+            }
+            case VIDIOC_QBUF: {
+                auto buffer = static_cast<v4l2_buffer *>(arg);
+                BufQueue &q = mQueue[buffer->type];
+                if (!q.allocated || (buffer->length != static_cast<unsigned int>(q.num_planes)) ||
+                    (buffer->index >= q.count) ||
+                    (std::find(q.queued.begin(), q.queued.end(), buffer->index) != q.queued.end()))
+                    return fail(EINVAL);
+                for (int i = 0; i < q.num_planes; i++) {
+                    if ((buffer->m.planes[i].length < q.size[i]) || (q.alloc[i] < q.size[i]))
+                        return fail(EINVAL);
+                }
+                q.queued.push_back(buffer->index);
+                q.max_in_flight = std::max<unsigned int>(q.max_in_flight, q.queued.size());
+                // The release fence
+                if (buffer->flags & V4L2_BUF_FLAG_USE_SYNC)
+                    buffer->reserved = open("/dev/null", O_RDONLY);
+                return 0;
+            }
+            case VIDIOC_DQBUF: {
+                auto buffer = static_cast<v4l2_buffer *>(arg);
+                BufQueue &q = mQueue[buffer->type];
+                if (q.queued.empty() || !q.streaming) return fail(EINVAL);
+                buffer->index = q.queued.front();
+                q.queued.pop_front();
+                return 0;
+            }
+            case VIDIOC_STREAMON: {
+                BufQueue &q = mQueue[*static_cast<int *>(arg)];
+                if (!q.allocated) return fail(EINVAL);
+                q.streaming = true;
+                return 0;
+            }
+            case VIDIOC_STREAMOFF: {
+                BufQueue &q = mQueue[*static_cast<int *>(arg)];
+                q.streaming = false;
+                q.queued.clear();
+                return 0;
+            }
+            case VIDIOC_S_CTRL: {
+                if (!mCtrlWhileStreaming && (mQueue[kSrcType].streaming || mQueue[kDstType].streaming))
+                    return fail(EBUSY);
+                return 0;
+            }
+            default:
+                return 0;
+        }
+    }
+
+private:
+    struct BufQueue {
+        bool allocated = false;
+        bool streaming = false;
+        unsigned int count = 0;
+        std::deque<unsigned int> queued;
+        unsigned int max_in_flight = 0;
+        int num_planes = 0;
+        unsigned int size[SC_MAX_PLANES] = {};
+        unsigned int alloc[SC_MAX_PLANES] = {};
+    };
+
+    static constexpr int kSrcType = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    static constexpr int kDstType = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+
+    static int fail(int err) {
+        errno = err;
+        return -1;
+    }
+
+    static void setLayout(v4l2_pix_format_mplane &pix) {
+        unsigned int pixels = pix.width * pix.height;
+        if (pix.pixelformat == V4L2_PIX_FMT_NV12M) {
+            pix.num_planes = 2;
+            pix.plane_fmt[0].sizeimage = pixels;
+            pix.plane_fmt[1].sizeimage = pixels / 2;
+        } else {
+            pix.num_planes = 1;
+            pix.plane_fmt[0].sizeimage = pixels * 4;
+        }
+    }
+
+    bool mStrict = false;
+    bool mCtrlWhileStreaming = false;
+    unsigned int mMaxBuffers = 32;
+    unsigned int mMinBuffers = 0;
+    std::map<unsigned long, int> mCount;
+    std::map<int, BufQueue> mQueue;
+};
+
+void *kAddr[SC_NUM_OF_PLANES] = {reinterpret_cast<void *>(0x1000), reinterpret_cast<void *>(0x2000),
+                                 reinterpret_cast<void *>(0x3000)};
+
+// What exynos_sc_config_exclusive() and exynos_sc_run_exclusive() do for a job
+bool runJob(FakeScaler &sc, unsigned int width, unsigned int height,
+            unsigned int format = V4L2_PIX_FMT_RGB32, unsigned int crop = 0) {
+    sc.SetRotate(0, 0, 0);
+    sc.SetCSCWide(false);
+    sc.SetSrcFormat(width, height, format);
+    sc.SetSrcCrop(0, 0, crop ? crop : width, crop ? crop : height);
+    sc.SetDstFormat(width, height, V4L2_PIX_FMT_RGB32);
+    sc.SetDstCrop(0, 0, width, height);
+    sc.SetSrcAddr(kAddr, V4L2_MEMORY_DMABUF);
+    sc.SetDstAddr(kAddr, V4L2_MEMORY_DMABUF);
+    return sc.Run();
+}
+
+// What exynos_sc_run_batch_exclusive() does for a job of a batch
+bool queueJob(FakeScaler &sc, unsigned int width, unsigned int height, unsigned int crop = 0) {
+    sc.SetRotate(0, 0, 0);
+    sc.SetCSCWide(false);
+    sc.SetSrcFormat(width, height, V4L2_PIX_FMT_RGB32);
+    sc.SetSrcCrop(0, 0, crop ? crop : width, crop ? crop : height);
+    sc.SetDstFormat(width, height, V4L2_PIX_FMT_RGB32);
+    sc.SetDstCrop(0, 0, width, height);
+    sc.SetSrcAddr(kAddr, V4L2_MEMORY_DMABUF);
+    sc.SetDstAddr(kAddr, V4L2_MEMORY_DMABUF);
+
+    int srcFence, dstFence;
+    if (!sc.Queue(&srcFence, &dstFence)) return false;
+    EXPECT_GE(srcFence, 0);
+    EXPECT_GE(dstFence, 0);
+    close(srcFence);
+    close(dstFence);
+    return true;
+}
+
+constexpr int kSrc = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+constexpr int kDst = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+
+TEST(LibScalerSessionTest, WithoutSessionEveryJobRestarts) {
+    FakeScaler sc;
+    ASSERT_TRUE(runJob(sc, 640, 480));
+
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 640, 480));
+    EXPECT_EQ(2, sc.count(VIDIOC_S_FMT));
+    EXPECT_EQ(2, sc.count(VIDIOC_S_CROP));
+    EXPECT_EQ(4, sc.count(VIDIOC_REQBUFS));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMOFF));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMON));
+}
+
+TEST(LibScalerSessionTest, WithoutSessionJobsDoNotOverlap) {
+    FakeScaler sc;
+    sc.setMinBuffers(4);
+    ASSERT_TRUE(queueJob(sc, 640, 480));
+    EXPECT_EQ(4u, sc.requested(kSrc));
+
+    // What exynos_sc_run_exclusive() does for the next job of the same configuration
+    sc.clear();
+    for (int i = 0; i < 3; i++) {
+        int srcFence, dstFence;
+        sc.SetSrcAddr(kAddr, V4L2_MEMORY_DMABUF);
+        sc.SetDstAddr(kAddr, V4L2_MEMORY_DMABUF);
+        ASSERT_TRUE(sc.Queue(&srcFence, &dstFence));
+        close(srcFence);
+        close(dstFence);
+    }
+    EXPECT_EQ(0, sc.count(VIDIOC_REQBUFS));
+    EXPECT_EQ(6, sc.count(VIDIOC_DQBUF));
+    EXPECT_EQ(1u, sc.maxInFlight(kSrc));
+    EXPECT_EQ(1u, sc.maxInFlight(kDst));
+}
+
+TEST(LibScalerSessionTest, UnchangedJobOnlyQueuesBuffers) {
+    FakeScaler sc;
+    ASSERT_TRUE(sc.SetSession(true));
+    ASSERT_TRUE(runJob(sc, 640, 480));
+
+    sc.clear();
+    for (int i = 0; i < 5; i++) ASSERT_TRUE(runJob(sc, 640, 480));
+    EXPECT_EQ(10, sc.count(VIDIOC_QBUF));
+    EXPECT_EQ(10, sc.count(VIDIOC_DQBUF));
+    EXPECT_EQ(20, sc.total());
+}
+
+TEST(LibScalerSessionTest, CropChangeKeepsStreaming) {
+    FakeScaler sc;
+    ASSERT_TRUE(sc.SetSession(true));
+    ASSERT_TRUE(runJob(sc, 640, 480));
+
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 640, 480, V4L2_PIX_FMT_RGB32, 320));
+    EXPECT_EQ(1, sc.count(VIDIOC_S_CROP));
+    EXPECT_EQ(0, sc.count(VIDIOC_STREAMOFF));
+    EXPECT_EQ(0, sc.count(VIDIOC_S_FMT));
+    EXPECT_EQ(5, sc.total());
+}
+
+TEST(LibScalerSessionTest, SmallerFormatKeepsBuffers) {
+    FakeScaler sc;
+    ASSERT_TRUE(sc.SetSession(true));
+    ASSERT_TRUE(runJob(sc, 640, 480));
+
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 320, 240));
+    EXPECT_EQ(2, sc.count(VIDIOC_S_FMT));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMOFF));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMON));
+    EXPECT_EQ(0, sc.count(VIDIOC_REQBUFS));
+
+    // The buffers are still as large as they were requested
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 640, 480));
+    EXPECT_EQ(0, sc.count(VIDIOC_REQBUFS));
+
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 800, 600));
+    EXPECT_EQ(4, sc.count(VIDIOC_REQBUFS));
+}
+
+TEST(LibScalerSessionTest, PlaneCountChangeRequestsBuffers) {
+    FakeScaler sc;
+    ASSERT_TRUE(sc.SetSession(true));
+    ASSERT_TRUE(runJob(sc, 640, 480));
+
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 640, 480, V4L2_PIX_FMT_NV12M));
+    EXPECT_EQ(1, sc.count(VIDIOC_S_FMT));
+    EXPECT_EQ(2, sc.count(VIDIOC_REQBUFS));
+
+    // The cached layout releases the buffers before S_FMT
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 640, 480));
+    EXPECT_EQ(2, sc.count(VIDIOC_REQBUFS));
+    EXPECT_EQ(1, sc.count(VIDIOC_S_FMT));
+}
+
+TEST(LibScalerSessionTest, StrictDriverReleasesBuffersForFormat) {
+    FakeScaler sc;
+    sc.setStrict(true);
+    ASSERT_TRUE(sc.SetSession(true));
+    ASSERT_TRUE(runJob(sc, 640, 480));
+
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 320, 240));
+    // The first S_FMT of each queue is retried until the driver is known
+    EXPECT_EQ(3, sc.count(VIDIOC_S_FMT));
+    EXPECT_EQ(4, sc.count(VIDIOC_REQBUFS));
+
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 640, 480));
+    EXPECT_EQ(2, sc.count(VIDIOC_S_FMT));
+}
+
+TEST(LibScalerSessionTest, ControlChangeKeepsStreaming) {
+    FakeScaler sc;
+    sc.setCtrlWhileStreaming(true);
+    ASSERT_TRUE(sc.SetSession(true));
+    ASSERT_TRUE(runJob(sc, 640, 480));
+
+    sc.clear();
+    sc.SetRotate(90, 0, 0);
+    sc.SetSrcAddr(kAddr, V4L2_MEMORY_DMABUF);
+    sc.SetDstAddr(kAddr, V4L2_MEMORY_DMABUF);
+    ASSERT_TRUE(sc.Run());
+    EXPECT_EQ(3, sc.count(VIDIOC_S_CTRL));
+    EXPECT_EQ(0, sc.count(VIDIOC_STREAMOFF));
+}
+
+TEST(LibScalerSessionTest, ControlChangeRestartsStreaming) {
+    FakeScaler sc;
+    ASSERT_TRUE(sc.SetSession(true));
+    ASSERT_TRUE(runJob(sc, 640, 480));
+
+    // The first S_CTRL fails while streaming, the retry succeeds on stopped queues
+    sc.clear();
+    sc.SetRotate(90, 0, 0);
+    sc.SetSrcAddr(kAddr, V4L2_MEMORY_DMABUF);
+    sc.SetDstAddr(kAddr, V4L2_MEMORY_DMABUF);
+    ASSERT_TRUE(sc.Run());
+    EXPECT_EQ(4, sc.count(VIDIOC_S_CTRL));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMOFF));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMON));
+    EXPECT_EQ(0, sc.count(VIDIOC_REQBUFS));
+
+    // The driver is known, the streaming stops before the controls
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 640, 480));
+    EXPECT_EQ(3, sc.count(VIDIOC_S_CTRL));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMOFF));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMON));
+    EXPECT_EQ(0, sc.count(VIDIOC_REQBUFS));
+
+    // Unchanged controls keep streaming
+    sc.clear();
+    ASSERT_TRUE(runJob(sc, 640, 480));
+    EXPECT_EQ(0, sc.count(VIDIOC_S_CTRL));
+    EXPECT_EQ(0, sc.count(VIDIOC_STREAMOFF));
+}
+
+TEST(LibScalerSessionTest, EndingSessionStops) {
+    FakeScaler sc;
+    ASSERT_TRUE(sc.SetSession(true));
+    ASSERT_TRUE(runJob(sc, 640, 480));
+
+    sc.clear();
+    ASSERT_TRUE(sc.SetSession(false));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMOFF));
+    EXPECT_EQ(2, sc.count(VIDIOC_REQBUFS));
+    ASSERT_TRUE(runJob(sc, 640, 480));
+}
+
+TEST(LibScalerSessionTest, BatchKeepsJobsInFlight) {
+    FakeScaler sc;
+    ASSERT_TRUE(sc.BeginBatch());
+    for (int i = 0; i < 8; i++) ASSERT_TRUE(queueJob(sc, 640, 480));
+    EXPECT_EQ(2, sc.count(VIDIOC_S_FMT));
+    EXPECT_EQ(2, sc.count(VIDIOC_REQBUFS));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMON));
+    EXPECT_EQ(16, sc.count(VIDIOC_QBUF));
+    // The fifth job waits for the first one
+    EXPECT_EQ(8, sc.count(VIDIOC_DQBUF));
+    EXPECT_EQ(4u, sc.requested(kSrc));
+    EXPECT_EQ(4u, sc.maxInFlight(kSrc));
+    EXPECT_EQ(4u, sc.maxInFlight(kDst));
+
+    // The batch started the session: the jobs in flight complete before it stops
+    sc.clear();
+    ASSERT_TRUE(sc.EndBatch());
+    EXPECT_EQ(8, sc.count(VIDIOC_DQBUF));
+    EXPECT_EQ(2, sc.count(VIDIOC_STREAMOFF));
+}
+
+TEST(LibScalerSessionTest, BatchCropChangeDrainsQueue) {
+    FakeScaler sc;
+    ASSERT_TRUE(sc.BeginBatch());
+    for (int i = 0; i < 3; i++) ASSERT_TRUE(queueJob(sc, 640, 480));
+
+    sc.clear();
+    ASSERT_TRUE(queueJob(sc, 640, 480, 320));
+    // The jobs using the previous crop of the source complete first
+    EXPECT_EQ(1, sc.count(VIDIOC_S_CROP));
+    EXPECT_EQ(3, sc.count(VIDIOC_DQBUF));
+    EXPECT_EQ(0, sc.count(VIDIOC_STREAMOFF));
+    EXPECT_EQ(2, sc.count(VIDIOC_QBUF));
+    ASSERT_TRUE(sc.EndBatch());
+}
+
+TEST(LibScalerSessionTest, BatchInSessionLeavesJobsInFlight) {
+    FakeScaler sc;
+    ASSERT_TRUE(sc.SetSession(true));
+    ASSERT_TRUE(sc.BeginBatch());
+    for (int i = 0; i < 2; i++) ASSERT_TRUE(queueJob(sc, 640, 480));
+
+    sc.clear();
+    ASSERT_TRUE(sc.EndBatch());
+    EXPECT_EQ(0, sc.total());
+
+    // A blocking job after the batch waits for all jobs and keeps the buffers
+    ASSERT_TRUE(runJob(sc, 640, 480));
+    EXPECT_EQ(6, sc.count(VIDIOC_DQBUF));
+    EXPECT_EQ(0, sc.count(VIDIOC_REQBUFS));
+}
+
+TEST(LibScalerSessionTest, BatchFollowsAllocatedBuffers) {
+    FakeScaler sc;
+    sc.setMaxBuffers(2);
+    ASSERT_TRUE(sc.BeginBatch());
+    for (int i = 0; i < 6; i++) ASSERT_TRUE(queueJob(sc, 640, 480));
+    EXPECT_EQ(2, sc.count(VIDIOC_REQBUFS));
+    EXPECT_EQ(2u, sc.maxInFlight(kSrc));
+    EXPECT_EQ(2u, sc.maxInFlight(kDst));
+    ASSERT_TRUE(sc.EndBatch());
+}
+
+} // namespace
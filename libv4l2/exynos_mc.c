@@ -43,6 +43,7 @@
 #include <unistd.h>
 
 #include "exynos_v4l2.h"
+#include "exynos_v4l2_devcache.h"
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "libexynosv4l2-mc"
@@ -95,14 +96,19 @@ static int __media_get_devname_sysfs(struct media_entity *entity)
     char *p;
     int ret;
 
-    snprintf(sysname, sizeof(sysname), "/sys/dev/char/%u:%u", entity->info.v4l.major,
-        entity->info.v4l.minor);
+    /* the V4L2 nodes are known to the device cache without reading the link */
+    if (exynos_v4l2_devcache_find_devnum(entity->info.v4l.major, entity->info.v4l.minor,
+                                         target, sizeof(target)) < 0) {
+        snprintf(sysname, sizeof(sysname), "/sys/dev/char/%u:%u", entity->info.v4l.major,
+            entity->info.v4l.minor);
 
-    ret = readlink(sysname, target, sizeof(target));
-    if (ret < 0 || ret >= (int)sizeof(target))
-        return -errno;
+        ret = readlink(sysname, target, sizeof(target));
+        if (ret < 0 || ret >= (int)sizeof(target))
+            return -errno;
+
+        target[ret] = '\0';
+    }
 
-    target[ret] = '\0';
     p = strrchr(target, '/');
     if (p == NULL)
         return -EINVAL;
@@ -38,14 +38,13 @@
 #include <sys/stat.h>
 
 #include "exynos_v4l2.h"
+#include "exynos_v4l2_devcache.h"
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "libexynosv4l2"
 #include <utils/Log.h>
 #include "Exynos_log.h"
 
-#define VIDEODEV_MAX 255
-
 //#define EXYNOS_V4L2_TRACE 0
 #ifdef EXYNOS_V4L2_TRACE
 #define Exynos_v4l2_In() Exynos_Log(EXYNOS_DEV_LOG_DEBUG, LOG_TAG, "%s In , Line: %d", __FUNCTION__, __LINE__)
@@ -107,72 +106,14 @@ int exynos_v4l2_open(const char *filename, int oflag, ...)
 
 int exynos_v4l2_open_devname(const char *devname, int oflag, ...)
 {
-    bool found = false;
-    int fd = -1;
-    struct stat s;
-    va_list ap;
-    FILE *stream_fd;
-    char filename[64], name[64];
-    int i = 0;
+    int fd;
 
     Exynos_v4l2_In();
 
-    do {
-        if (i > VIDEODEV_MAX)
-            break;
-
-        /* video device node */
-        snprintf(filename, sizeof(filename), "/dev/video%d", i);
-
-        /* if the node is video device */
-        if ((lstat(filename, &s) == 0) && S_ISCHR(s.st_mode) &&
-                ((int)((unsigned short)(s.st_rdev) >> 8) == 81)) {
-            ALOGD("try node: %s", filename);
-            /* open sysfs entry */
-            snprintf(filename, sizeof(filename), "/sys/class/video4linux/video%d/name", i);
-            if (S_ISLNK(s.st_mode)) {
-                ALOGE("symbolic link detected");
-                return -1;
-            }
-            stream_fd = fopen(filename, "r");
-            if (stream_fd == NULL) {
-                ALOGE("failed to open sysfs entry for videodev (%d - %s)", errno, strerror(errno));
-                i++;
-                continue;   /* try next */
-            }
-
-            /* read sysfs entry for device name */
-            char *p = fgets(name, sizeof(name), stream_fd);
-            fclose(stream_fd);
-
-            /* check read size */
-            if (p == NULL) {
-                ALOGE("failed to read sysfs entry for videodev");
-            } else {
-                /* matched */
-                if (strncmp(name, devname, strlen(devname)) == 0) {
-                    ALOGI("node found for device %s: /dev/video%d", devname, i);
-                    found = true;
-                    break;
-                }
-            }
-        }
-        i++;
-    } while (found == false);
-
-    if (found) {
-        snprintf(filename, sizeof(filename), "/dev/video%d", i);
-        va_start(ap, oflag);
-        fd = __v4l2_open(filename, oflag, ap);
-        va_end(ap);
-
-        if (fd > 0)
-            ALOGI("open video device %s", filename);
-        else
-            ALOGE("failed to open video device %s", filename);
-    } else {
-        ALOGE("no video device found");
-    }
+    /* the node of the device is looked up in the cache instead of probing /dev */
+    fd = exynos_v4l2_devcache_open(EXYNOS_V4L2_DEV_VIDEO, devname, oflag, NULL);
+    if (fd < 0)
+        ALOGE("failed to open video device %s", devname);
 
     Exynos_v4l2_Out();
 
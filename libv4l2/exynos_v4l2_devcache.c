@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*!
+ * \file      exynos_v4l2_devcache.c
+ * \brief     process-wide cache of the V4L2 device nodes
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+
+#include "exynos_v4l2_devcache.h"
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "libexynosv4l2-devcache"
+#include <log/log.h>
+
+#define V4L2_SYSFS_CLASS "/sys/class/video4linux"
+#define V4L2_MAJOR 81
+
+struct devcache_node {
+    enum exynos_v4l2_devkind kind;
+    int index;
+    unsigned int major;
+    unsigned int minor;
+    char name[64];              /* sysfs name without the trailing newline */
+};
+
+static const char *const devcache_prefix[] = {
+    [EXYNOS_V4L2_DEV_VIDEO] = "video",
+    [EXYNOS_V4L2_DEV_SUBDEV] = "v4l-subdev",
+};
+
+static struct {
+    pthread_mutex_t lock;
+    bool valid;
+    struct devcache_node *nodes;
+    unsigned int count;
+    char root[128];             /* see exynos_v4l2_devcache_set_root() */
+    struct exynos_v4l2_devcache_stats stats;
+} devcache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static ssize_t __devcache_read(const char *path, char *buf, size_t len)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    ssize_t ret = read(fd, buf, len - 1);
+    close(fd);
+    if (ret < 0)
+        return -1;
+
+    buf[ret] = '\0';
+    while ((ret > 0) && (buf[ret - 1] == '\n'))
+        buf[--ret] = '\0';
+
+    return ret;
+}
+
+static bool __devcache_parse_entry(const char *entry, struct devcache_node *node)
+{
+    for (int kind = 0; kind < (int)(sizeof(devcache_prefix) / sizeof(devcache_prefix[0])); kind++) {
+        size_t len = strlen(devcache_prefix[kind]);
+        char *end;
+
+        if (strncmp(entry, devcache_prefix[kind], len) != 0)
+            continue;
+
+        long index = strtol(entry + len, &end, 10);
+        if ((end == entry + len) || (*end != '\0') || (index < 0) || (index > INT_MAX))
+            return false;
+
+        node->kind = (enum exynos_v4l2_devkind)kind;
+        node->index = (int)index;
+        return true;
+    }
+
+    return false;
+}
+
+static int __devcache_compare(const void *a, const void *b)
+{
+    const struct devcache_node *x = (const struct devcache_node *)a;
+    const struct devcache_node *y = (const struct devcache_node *)b;
+
+    if (x->kind != y->kind)
+        return (x->kind < y->kind) ? -1 : 1;
+
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+/*
+ * Reads the name and the device number of every V4L2 device from sysfs.
+ * The nodes are sorted by their number so that the lookup prefers the lowest
+ * one like the probing of /dev did.
+ */
+static void __devcache_scan_locked(void)
+{
+    char path[PATH_MAX];
+    struct devcache_node *nodes = NULL;
+    unsigned int count = 0, capacity = 0;
+
+    free(devcache.nodes);
+    devcache.nodes = NULL;
+    devcache.count = 0;
+    devcache.valid = true;
+    devcache.stats.scans++;
+
+    snprintf(path, sizeof(path), "%s" V4L2_SYSFS_CLASS, devcache.root);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        ALOGE("failed to open %s (%d - %s)", path, errno, strerror(errno));
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        struct devcache_node node;
+        char buf[32];
+
+        memset(&node, 0, sizeof(node));
+        if (!__devcache_parse_entry(entry->d_name, &node))
+            continue;
+
+        snprintf(path, sizeof(path), "%s" V4L2_SYSFS_CLASS "/%s/name", devcache.root,
+                 entry->d_name);
+        if (__devcache_read(path, node.name, sizeof(node.name)) < 0) {
+            ALOGE("failed to read sysfs entry for %s (%d - %s)", entry->d_name, errno,
+                  strerror(errno));
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s" V4L2_SYSFS_CLASS "/%s/dev", devcache.root,
+                 entry->d_name);
+        if ((__devcache_read(path, buf, sizeof(buf)) < 0) ||
+                (sscanf(buf, "%u:%u", &node.major, &node.minor) != 2)) {
+            node.major = V4L2_MAJOR;
+            node.minor = 0;
+        }
+
+        if (count == capacity) {
+            unsigned int n = capacity ? capacity * 2 : 16;
+            struct devcache_node *p =
+                    (struct devcache_node *)realloc(nodes, n * sizeof(*nodes));
+            if (p == NULL) {
+                ALOGE("failed to allocate %u device nodes", n);
+                break;
+            }
+            nodes = p;
+            capacity = n;
+        }
+
+        nodes[count++] = node;
+    }
+
+    closedir(dir);
+
+    qsort(nodes, count, sizeof(*nodes), __devcache_compare);
+
+    devcache.nodes = nodes;
+    devcache.count = count;
+
+    ALOGD("found %u V4L2 device nodes", count);
+}
+
+static void __devcache_node_path(const struct devcache_node *node, char *path, size_t len)
+{
+    snprintf(path, len, "%s/dev/%s%d", devcache.root, devcache_prefix[node->kind], node->index);
+}
+
+static const struct devcache_node *__devcache_lookup_locked(enum exynos_v4l2_devkind kind,
+                                                            const char *devname)
+{
+    size_t len = strlen(devname);
+
+    for (unsigned int i = 0; i < devcache.count; i++) {
+        if ((devcache.nodes[i].kind == kind) &&
+                (strncmp(devcache.nodes[i].name, devname, len) == 0))
+            return &devcache.nodes[i];
+    }
+
+    return NULL;
+}
+
+/* Looks devname up, reading sysfs again if the device is not cached */
+static const struct devcache_node *__devcache_find_locked(enum exynos_v4l2_devkind kind,
+                                                          const char *devname)
+{
+    const struct devcache_node *node = NULL;
+    bool scanned = false;
+
+    if (!devcache.valid) {
+        __devcache_scan_locked();
+        scanned = true;
+    }
+
+    node = __devcache_lookup_locked(kind, devname);
+    if ((node == NULL) && !scanned) {
+        /* the device may have been added since the last scan */
+        __devcache_scan_locked();
+        node = __devcache_lookup_locked(kind, devname);
+    }
+
+    if (node)
+        devcache.stats.hits++;
+    else
+        devcache.stats.misses++;
+
+    return node;
+}
+
+int exynos_v4l2_devcache_find(enum exynos_v4l2_devkind kind, const char *devname,
+                              char *path, size_t len)
+{
+    int index = -1;
+
+    pthread_mutex_lock(&devcache.lock);
+
+    const struct devcache_node *node = __devcache_find_locked(kind, devname);
+    if (node) {
+        __devcache_node_path(node, path, len);
+        index = node->index;
+    }
+
+    pthread_mutex_unlock(&devcache.lock);
+
+    return index;
+}
+
+/*
+ * The node is opened without following links as the probing of /dev refused
+ * them. A node whose device number is not the cached one belongs to another
+ * device now. The nodes of a fake tree are regular files.
+ */
+static bool __devcache_check_node(int fd, const struct devcache_node *node)
+{
+    struct stat s;
+
+    if (fstat(fd, &s) < 0)
+        return false;
+
+    if (devcache.root[0] != '\0')
+        return S_ISREG(s.st_mode) || S_ISCHR(s.st_mode);
+
+    return S_ISCHR(s.st_mode) && (major(s.st_rdev) == node->major) &&
+           (minor(s.st_rdev) == node->minor);
+}
+
+int exynos_v4l2_devcache_open(enum exynos_v4l2_devkind kind, const char *devname,
+                              int oflag, int *index)
+{
+    char path[PATH_MAX];
+    int fd = -1;
+
+    pthread_mutex_lock(&devcache.lock);
+
+    for (int retry = 0; retry < 2; retry++) {
+        const struct devcache_node *node = __devcache_find_locked(kind, devname);
+        if (node == NULL) {
+            ALOGE("no %s device found for %s", devcache_prefix[kind], devname);
+            break;
+        }
+
+        __devcache_node_path(node, path, sizeof(path));
+        fd = open(path, oflag | O_NOFOLLOW);
+        if ((fd >= 0) && __devcache_check_node(fd, node)) {
+            ALOGI("node found for device %s: %s", devname, path);
+            if (index)
+                *index = node->index;
+            break;
+        }
+
+        if (fd < 0) {
+            int err = errno;
+            ALOGE("failed to open %s for %s (%d - %s)", path, devname, err, strerror(err));
+            /* the other errors are not about the node being stale */
+            if ((err != ENOENT) && (err != ENODEV) && (err != ENXIO) && (err != ELOOP))
+                break;
+        } else {
+            ALOGE("%s is not the node of %s anymore", path, devname);
+            close(fd);
+            fd = -1;
+        }
+
+        devcache.stats.stale++;
+        devcache.valid = false;
+    }
+
+    pthread_mutex_unlock(&devcache.lock);
+
+    return fd;
+}
+
+static const struct devcache_node *__devcache_lookup_devnum_locked(unsigned int major,
+                                                                   unsigned int minor)
+{
+    for (unsigned int i = 0; i < devcache.count; i++) {
+        if ((devcache.nodes[i].major == major) && (devcache.nodes[i].minor == minor))
+            return &devcache.nodes[i];
+    }
+
+    return NULL;
+}
+
+int exynos_v4l2_devcache_find_devnum(unsigned int major, unsigned int minor,
+                                     char *path, size_t len)
+{
+    const struct devcache_node *node = NULL;
+    bool scanned = false;
+
+    pthread_mutex_lock(&devcache.lock);
+
+    if (!devcache.valid) {
+        __devcache_scan_locked();
+        scanned = true;
+    }
+
+    node = __devcache_lookup_devnum_locked(major, minor);
+    if ((node == NULL) && !scanned) {
+        __devcache_scan_locked();
+        node = __devcache_lookup_devnum_locked(major, minor);
+    }
+
+    if (node) {
+        __devcache_node_path(node, path, len);
+        devcache.stats.hits++;
+    } else {
+        devcache.stats.misses++;
+    }
+
+    pthread_mutex_unlock(&devcache.lock);
+
+    return node ? 0 : -ENOENT;
+}
+
+void exynos_v4l2_devcache_invalidate(void)
+{
+    pthread_mutex_lock(&devcache.lock);
+    devcache.valid = false;
+    pthread_mutex_unlock(&devcache.lock);
+}
+
+void exynos_v4l2_devcache_set_root(const char *root)
+{
+    pthread_mutex_lock(&devcache.lock);
+    snprintf(devcache.root, sizeof(devcache.root), "%s", root ? root : "");
+    devcache.valid = false;
+    memset(&devcache.stats, 0, sizeof(devcache.stats));
+    pthread_mutex_unlock(&devcache.lock);
+}
+
+void exynos_v4l2_devcache_get_stats(struct exynos_v4l2_devcache_stats *stats)
+{
+    pthread_mutex_lock(&devcache.lock);
+    *stats = devcache.stats;
+    stats->nodes = devcache.count;
+    pthread_mutex_unlock(&devcache.lock);
+}
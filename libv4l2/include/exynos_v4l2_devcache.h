@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*!
+ * \file      exynos_v4l2_devcache.h
+ * \brief     process-wide cache of the V4L2 device nodes
+ *
+ * The names of the V4L2 devices in sysfs are read once per process instead
+ * of probing /dev/video0..255 on every open. A cached node that disappears
+ * or turns out to be another device on open drops the cache and it is
+ * built again, as does a lookup of a name that is not cached.
+ */
+
+#ifndef __EXYNOS_V4L2_DEVCACHE_H__
+#define __EXYNOS_V4L2_DEVCACHE_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum exynos_v4l2_devkind {
+    EXYNOS_V4L2_DEV_VIDEO,      /* /dev/videoN */
+    EXYNOS_V4L2_DEV_SUBDEV,     /* /dev/v4l-subdevN */
+};
+
+struct exynos_v4l2_devcache_stats {
+    unsigned int scans;         /* how many times sysfs was read */
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int stale;         /* cached nodes found stale on open */
+    unsigned int nodes;         /* nodes in the cache */
+};
+
+/*!
+ * Finds the node of the device of kind whose sysfs name starts with devname.
+ * Returns the node number and stores the node path to path, -1 if not found.
+ * \ingroup exynos_v4l2
+ */
+int exynos_v4l2_devcache_find(enum exynos_v4l2_devkind kind, const char *devname,
+                              char *path, size_t len);
+/*!
+ * Opens the device of kind named devname. Returns the file descriptor and
+ * stores the node number to index if not NULL, -1 on failure.
+ * \ingroup exynos_v4l2
+ */
+int exynos_v4l2_devcache_open(enum exynos_v4l2_devkind kind, const char *devname,
+                              int oflag, int *index);
+/*!
+ * Finds the node of a V4L2 device from its device number, as reported by
+ * the media controller for the entities. Returns 0 on success.
+ * \ingroup exynos_v4l2
+ */
+int exynos_v4l2_devcache_find_devnum(unsigned int major, unsigned int minor,
+                                     char *path, size_t len);
+/*!
+ * Drops the cache. Called by the owners of uevent listeners on device
+ * add and remove.
+ * \ingroup exynos_v4l2
+ */
+void exynos_v4l2_devcache_invalidate(void);
+/*!
+ * Places /sys and /dev under root, "" by default. For tests only.
+ * \ingroup exynos_v4l2
+ */
+void exynos_v4l2_devcache_set_root(const char *root);
+/*! \ingroup exynos_v4l2 */
+void exynos_v4l2_devcache_get_stats(struct exynos_v4l2_devcache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EXYNOS_V4L2_DEVCACHE_H__ */
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "exynos_v4l2_devcache.h"
+
+namespace {
+
+/*
+ * A fake /sys/class/video4linux and /dev under a temporary directory. The
+ * device nodes are regular files.
+ */
+class FakeDevTree {
+public:
+    FakeDevTree() {
+        char tmpl[] = "/tmp/v4l2_devcache_XXXXXX";
+        mRoot = mkdtemp(tmpl);
+        mkdir((mRoot + "/sys").c_str(), 0755);
+        mkdir((mRoot + "/sys/class").c_str(), 0755);
+        mkdir((mRoot + "/sys/class/video4linux").c_str(), 0755);
+        mkdir((mRoot + "/dev").c_str(), 0755);
+        exynos_v4l2_devcache_set_root(mRoot.c_str());
+    }
+
+    ~FakeDevTree() {
+        exynos_v4l2_devcache_set_root("");
+        std::string cmd = "rm -rf " + mRoot;
+        EXPECT_EQ(0, system(cmd.c_str()));
+    }
+
+    void add(const std::string &node, const std::string &name, int minor) {
+        std::string sysfs = mRoot + "/sys/class/video4linux/" + node;
+        mkdir(sysfs.c_str(), 0755);
+        write(sysfs + "/name", name + "\n");
+        write(sysfs + "/dev", "81:" + std::to_string(minor) + "\n");
+        write(mRoot + "/dev/" + node, "");
+    }
+
+    void remove(const std::string &node) {
+        std::string sysfs = mRoot + "/sys/class/video4linux/" + node;
+        unlink((sysfs + "/name").c_str());
+        unlink((sysfs + "/dev").c_str());
+        rmdir(sysfs.c_str());
+        unlink((mRoot + "/dev/" + node).c_str());
+    }
+
+    std::string path(const std::string &node) { return mRoot + "/dev/" + node; }
+
+private:
+    static void write(const std::string &path, const std::string &content) {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(static_cast<ssize_t>(content.size()), ::write(fd, content.data(), content.size()));
+        close(fd);
+    }
+
+    std::string mRoot;
+};
+
+exynos_v4l2_devcache_stats stats() {
+    exynos_v4l2_devcache_stats s;
+    exynos_v4l2_devcache_get_stats(&s);
+    return s;
+}
+
+TEST(ExynosV4l2DevcacheTest, FindsNodesWithOneScan) {
+    FakeDevTree tree;
+    tree.add("video23", "exynos-gsc.0.m2m", 23);
+    tree.add("video26", "exynos-gsc.1.m2m", 26);
+    tree.add("v4l-subdev3", "exynos-gsc-sd.1", 131);
+
+    char path[256];
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(26, exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.1", path,
+                                                sizeof(path)));
+        EXPECT_EQ(tree.path("video26"), path);
+        EXPECT_EQ(3, exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_SUBDEV, "exynos-gsc-sd.1", path,
+                                               sizeof(path)));
+        EXPECT_EQ(tree.path("v4l-subdev3"), path);
+    }
+
+    EXPECT_EQ(1u, stats().scans);
+    EXPECT_EQ(20u, stats().hits);
+    EXPECT_EQ(3u, stats().nodes);
+}
+
+TEST(ExynosV4l2DevcacheTest, PrefersLowestNode) {
+    FakeDevTree tree;
+    tree.add("video110", "scaler", 110);
+    tree.add("video9", "scaler", 9);
+    tree.add("video50", "scaler", 50);
+
+    char path[256];
+    EXPECT_EQ(9, exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_VIDEO, "scaler", path, sizeof(path)));
+}
+
+TEST(ExynosV4l2DevcacheTest, KindsDoNotMix) {
+    FakeDevTree tree;
+    tree.add("v4l-subdev0", "exynos-gsc.0", 128);
+
+    char path[256];
+    EXPECT_EQ(-1, exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.0", path,
+                                            sizeof(path)));
+    EXPECT_EQ(0, exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_SUBDEV, "exynos-gsc.0", path,
+                                           sizeof(path)));
+}
+
+TEST(ExynosV4l2DevcacheTest, AddedDeviceIsFoundOnMiss) {
+    FakeDevTree tree;
+    tree.add("video23", "exynos-gsc.0.m2m", 23);
+
+    char path[256];
+    EXPECT_EQ(23, exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.0", path,
+                                            sizeof(path)));
+    tree.add("video60", "exynos-scaler", 60);
+    EXPECT_EQ(60, exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_VIDEO, "exynos-scaler", path,
+                                            sizeof(path)));
+    EXPECT_EQ(2u, stats().scans);
+}
+
+TEST(ExynosV4l2DevcacheTest, RemovedNodeIsRescannedOnOpen) {
+    FakeDevTree tree;
+    tree.add("video23", "exynos-gsc.0.m2m", 23);
+
+    int index = -1;
+    int fd = exynos_v4l2_devcache_open(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.0", O_RDWR, &index);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(23, index);
+    close(fd);
+
+    // The device comes back on another node
+    tree.remove("video23");
+    tree.add("video24", "exynos-gsc.0.m2m", 24);
+
+    fd = exynos_v4l2_devcache_open(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.0", O_RDWR, &index);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(24, index);
+    close(fd);
+
+    EXPECT_EQ(1u, stats().stale);
+    EXPECT_EQ(2u, stats().scans);
+}
+
+TEST(ExynosV4l2DevcacheTest, RemovedDeviceFailsToOpen) {
+    FakeDevTree tree;
+    tree.add("video23", "exynos-gsc.0.m2m", 23);
+
+    char path[256];
+    EXPECT_EQ(23, exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.0", path,
+                                            sizeof(path)));
+    tree.remove("video23");
+    EXPECT_LT(exynos_v4l2_devcache_open(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.0", O_RDWR, nullptr),
+              0);
+}
+
+TEST(ExynosV4l2DevcacheTest, SymlinkIsRefused) {
+    FakeDevTree tree;
+    tree.add("video30", "exynos-gsc.2.m2m", 30);
+    std::string node = tree.path("video30");
+    ASSERT_EQ(0, rename(node.c_str(), (node + ".real").c_str()));
+    ASSERT_EQ(0, symlink((node + ".real").c_str(), node.c_str()));
+
+    EXPECT_LT(exynos_v4l2_devcache_open(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.2", O_RDWR, nullptr),
+              0);
+    unlink((node + ".real").c_str());
+}
+
+TEST(ExynosV4l2DevcacheTest, FindsNodeFromDeviceNumber) {
+    FakeDevTree tree;
+    tree.add("video23", "exynos-gsc.0.m2m", 23);
+    tree.add("v4l-subdev1", "exynos-gsc-sd.0", 129);
+
+    char path[256];
+    EXPECT_EQ(0, exynos_v4l2_devcache_find_devnum(81, 129, path, sizeof(path)));
+    EXPECT_EQ(tree.path("v4l-subdev1"), path);
+    EXPECT_NE(0, exynos_v4l2_devcache_find_devnum(81, 7, path, sizeof(path)));
+}
+
+TEST(ExynosV4l2DevcacheTest, InvalidateRescans) {
+    FakeDevTree tree;
+    tree.add("video23", "exynos-gsc.0.m2m", 23);
+
+    char path[256];
+    exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.0", path, sizeof(path));
+    exynos_v4l2_devcache_invalidate();
+    exynos_v4l2_devcache_find(EXYNOS_V4L2_DEV_VIDEO, "exynos-gsc.0", path, sizeof(path));
+    EXPECT_EQ(2u, stats().scans);
+}
+
+} // namespace
@@ -0,0 +1,108 @@
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "GpuSysfsSnapshotReader.h"
+#include "filesystem.h"
+
+using namespace GpuSysfsReader;
+
+namespace {
+
+// Synthetic mali sysfs device directory with |numContexts| kprcs entries.
+class SyntheticSysfs {
+public:
+    explicit SyntheticSysfs(int numContexts) {
+        char tmpl[] = "/data/local/tmp/memtrack_benchmark_XXXXXX";
+        root = mkdtemp(tmpl) ?: "";
+        writeNode(root, kTotalGpuMemNode, 64 << 20);
+        writeNode(root, kDmaBufGpuMemNode, 16 << 20);
+        mkdir((root + "/" + kProcessDir).c_str(), 0755);
+        for (int pid = 1; pid <= numContexts; pid++) {
+            std::string dir = root + "/" + kProcessDir + "/" + std::to_string(pid);
+            mkdir(dir.c_str(), 0755);
+            writeNode(dir, kTotalGpuMemNode, pid * 8192);
+            writeNode(dir, kDmaBufGpuMemNode, pid * 4096);
+        }
+    }
+
+    ~SyntheticSysfs() {
+        std::string cmd = "rm -rf " + root;
+        system(cmd.c_str());
+    }
+
+    std::string root;
+
+private:
+    static void writeNode(const std::string& dir, const char* node, uint64_t value) {
+        std::ofstream(dir + "/" + node) << value << "\n";
+    }
+};
+
+// The open/parse/close per pid and node sequence the HAL used before SnapshotReader.
+uint64_t readNodeDirect(const std::string& devicePath, const char* node, pid_t pid) {
+    std::stringstream ss;
+    if (pid)
+        ss << devicePath << "/" << kProcessDir << "/" << pid << "/" << node;
+    else
+        ss << devicePath << "/" << node;
+    const std::string path = ss.str();
+
+    if (!filesystem::exists(filesystem::path(path)))
+        return 0;
+
+    std::ifstream file(path.c_str());
+    if (!file.is_open())
+        return 0;
+
+    uint64_t out;
+    file >> out;
+    return out;
+}
+
+// One memtrack query window: GL and GRAPHICS for every pid, as dumpsys meminfo issues them.
+void BM_PerNodeOpen(benchmark::State& state) {
+    const int numContexts = state.range(0);
+    SyntheticSysfs sysfs(numContexts);
+    for (auto _ : state) {
+        for (pid_t pid = 1; pid <= numContexts; pid++) {
+            uint64_t total = readNodeDirect(sysfs.root, kTotalGpuMemNode, pid);
+            uint64_t dmaBuf = readNodeDirect(sysfs.root, kDmaBufGpuMemNode, pid);
+            benchmark::DoNotOptimize(total - dmaBuf);
+            benchmark::DoNotOptimize(readNodeDirect(sysfs.root, kDmaBufGpuMemNode, pid));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * numContexts);
+}
+BENCHMARK(BM_PerNodeOpen)->Arg(16)->Arg(128)->Arg(512);
+
+void BM_SnapshotReader(benchmark::State& state) {
+    const int numContexts = state.range(0);
+    SyntheticSysfs sysfs(numContexts);
+    SnapshotReader reader(sysfs.root, std::chrono::hours(1));
+    for (auto _ : state) {
+        // Every window pays for one fresh snapshot.
+        reader.invalidate();
+        for (pid_t pid = 1; pid <= numContexts; pid++) {
+            GpuMemUsage usage;
+            reader.getUsage(pid, &usage);
+            benchmark::DoNotOptimize(usage.totalGpuMem - usage.dmaBufGpuMem);
+            reader.getUsage(pid, &usage);
+            benchmark::DoNotOptimize(usage.dmaBufGpuMem);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * numContexts);
+    auto stats = reader.getStats();
+    state.counters["opens/snapshot"] = static_cast<double>(stats.nodeOpens) / stats.snapshots;
+    state.counters["reads/snapshot"] = static_cast<double>(stats.nodeReads) / stats.snapshots;
+}
+BENCHMARK(BM_SnapshotReader)->Arg(16)->Arg(128)->Arg(512);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,163 @@
+#include "GpuSysfsSnapshotReader.h"
+
+#include <fcntl.h>
+#include <log/log.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <unordered_set>
+
+#undef LOG_TAG
+#define LOG_TAG "memtrack-gpusysfsreader"
+
+using ::android::base::unique_fd;
+
+namespace GpuSysfsReader {
+
+SnapshotReader::SnapshotReader(const std::string& devicePath, std::chrono::milliseconds ttl,
+                               size_t maxCachedContexts)
+      : mDevicePath(devicePath), mTtl(ttl), mMaxCachedContexts(maxCachedContexts) {}
+
+bool SnapshotReader::getUsage(pid_t pid, GpuMemUsage* usage) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mStats.queries++;
+
+    auto now = std::chrono::steady_clock::now();
+    if (!mSnapshotValid || now - mSnapshotTime >= mTtl) {
+        refreshLocked();
+        mSnapshotTime = now;
+        mSnapshotValid = true;
+    }
+
+    auto it = mSnapshot.find(pid);
+    if (it == mSnapshot.end())
+        return false;
+
+    *usage = it->second;
+    return true;
+}
+
+void SnapshotReader::invalidate() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mSnapshotValid = false;
+}
+
+SnapshotReader::Stats SnapshotReader::getStats() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mStats;
+}
+
+void SnapshotReader::refreshLocked() {
+    mStats.snapshots++;
+    mSnapshot.clear();
+
+    if (mDeviceDirFd < 0) {
+        mDeviceDirFd.reset(open(mDevicePath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+        if (mDeviceDirFd < 0) {
+            ALOGV("Failed to open %s", mDevicePath.c_str());
+            return;
+        }
+    }
+
+    GpuMemUsage usage;
+    if (readNodesLocked(mDeviceDirFd, nullptr, &mDeviceNodes, &usage))
+        mSnapshot[0] = usage;
+
+    if (!mProcessDir) {
+        int fd = openat(mDeviceDirFd, kProcessDir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            ALOGV("Failed to open %s/%s", mDevicePath.c_str(), kProcessDir);
+            return;
+        }
+        mProcessDir.reset(fdopendir(fd));
+        if (!mProcessDir) {
+            close(fd);
+            return;
+        }
+    } else {
+        rewinddir(mProcessDir.get());
+    }
+
+    const int processDirFd = dirfd(mProcessDir.get());
+    std::unordered_set<pid_t> alive;
+    struct dirent* dent;
+    while ((dent = readdir(mProcessDir.get()))) {
+        char* end;
+        long pid = strtol(dent->d_name, &end, 10);
+        if (*end != '\0' || pid <= 0)
+            continue;
+        alive.insert(pid);
+
+        // Contexts past the cache limit have their nodes opened and closed by this snapshot
+        ContextNodes uncached;
+        auto it = mContextNodes.find(pid);
+        if (it == mContextNodes.end() && mContextNodes.size() < mMaxCachedContexts)
+            it = mContextNodes.emplace(pid, ContextNodes()).first;
+        ContextNodes& nodes = (it != mContextNodes.end()) ? it->second : uncached;
+
+        // The context was torn down and its pid reused since the nodes were opened
+        if (nodes.ino != dent->d_ino) {
+            nodes = ContextNodes();
+            nodes.ino = dent->d_ino;
+        }
+
+        if (readNodesLocked(processDirFd, dent->d_name, &nodes, &usage))
+            mSnapshot[pid] = usage;
+    }
+
+    for (auto it = mContextNodes.begin(); it != mContextNodes.end();) {
+        if (alive.count(it->first))
+            ++it;
+        else
+            it = mContextNodes.erase(it);
+    }
+}
+
+bool SnapshotReader::readNodesLocked(int dirFd, const char* dirName, ContextNodes* nodes,
+                                     GpuMemUsage* usage) {
+    *usage = GpuMemUsage();
+    const bool total =
+            readNodeLocked(dirFd, dirName, kTotalGpuMemNode, &nodes->totalFd, &usage->totalGpuMem);
+    const bool dmaBuf = readNodeLocked(dirFd, dirName, kDmaBufGpuMemNode, &nodes->dmaBufFd,
+                                       &usage->dmaBufGpuMem);
+    return total || dmaBuf;
+}
+
+bool SnapshotReader::readNodeLocked(int dirFd, const char* dirName, const char* node,
+                                    unique_fd* fd, uint64_t* value) {
+    // A cached fd that fails to read may belong to a removed node; reopen it once.
+    for (bool cached = (*fd >= 0);; cached = false) {
+        if (!cached) {
+            std::string path = dirName ? std::string(dirName) + "/" + node : node;
+            fd->reset(openat(dirFd, path.c_str(), O_RDONLY | O_CLOEXEC));
+            mStats.nodeOpens++;
+            if (*fd < 0) {
+                ALOGV("File not found: %s", path.c_str());
+                return false;
+            }
+        }
+
+        char buf[32];
+        mStats.nodeReads++;
+        ssize_t len = TEMP_FAILURE_RETRY(pread(*fd, buf, sizeof(buf) - 1, 0));
+        if (len > 0) {
+            buf[len] = '\0';
+            char* end;
+            *value = strtoull(buf, &end, 10);
+            if (end != buf)
+                return true;
+        }
+
+        *value = 0;
+        fd->reset();
+        if (!cached)
+            return false;
+    }
+}
+
+SnapshotReader& getSnapshotReader() {
+    static SnapshotReader reader;
+    return reader;
+}
+
+} // namespace GpuSysfsReader
@@ -0,0 +1,87 @@
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "GpuSysfsReader.h"
+
+namespace GpuSysfsReader {
+
+struct GpuMemUsage {
+    uint64_t totalGpuMem = 0;
+    uint64_t dmaBufGpuMem = 0;
+};
+
+// Reads the GPU kernel driver's per-context memory accounting in one pass and serves every pid
+// queried within |ttl| from that snapshot. Directory and node fds are kept open across snapshots
+// and re-read with pread(), so a snapshot costs one directory walk plus two reads per context
+// instead of an open/read/close sequence per pid and node. The node fds of at most
+// |maxCachedContexts| contexts are kept; the nodes of the others are opened for each snapshot.
+class SnapshotReader {
+public:
+    static constexpr std::chrono::milliseconds kDefaultTtl{200};
+    static constexpr size_t kDefaultMaxCachedContexts = 64;
+
+    explicit SnapshotReader(const std::string& devicePath = kSysfsDevicePath,
+                            std::chrono::milliseconds ttl = kDefaultTtl,
+                            size_t maxCachedContexts = kDefaultMaxCachedContexts);
+
+    // Returns false if |pid| has no GPU context. pid 0 returns the device totals. A node that
+    // cannot be read is reported as 0, as long as the other node of the context can be read.
+    bool getUsage(pid_t pid, GpuMemUsage* usage);
+
+    // Drops the current snapshot so the next query re-reads sysfs.
+    void invalidate();
+
+    struct Stats {
+        uint64_t snapshots = 0;
+        uint64_t queries = 0;
+        uint64_t nodeOpens = 0;
+        uint64_t nodeReads = 0;
+    };
+    Stats getStats();
+
+private:
+    struct ContextNodes {
+        // Inode of the context directory, which changes when a pid gets a new context
+        ino_t ino = 0;
+        ::android::base::unique_fd totalFd;
+        ::android::base::unique_fd dmaBufFd;
+    };
+
+    void refreshLocked();
+    // Returns false if none of the nodes in |dirName| can be read.
+    bool readNodesLocked(int dirFd, const char* dirName, ContextNodes* nodes,
+                         GpuMemUsage* usage);
+    bool readNodeLocked(int dirFd, const char* dirName, const char* node,
+                        ::android::base::unique_fd* fd, uint64_t* value);
+
+    const std::string mDevicePath;
+    const std::chrono::milliseconds mTtl;
+    const size_t mMaxCachedContexts;
+
+    // Serializes binder threads; everything below is protected by it.
+    std::mutex mLock;
+    ::android::base::unique_fd mDeviceDirFd;
+    std::unique_ptr<DIR, decltype(&closedir)> mProcessDir{nullptr, &closedir};
+    ContextNodes mDeviceNodes;
+    std::unordered_map<pid_t, ContextNodes> mContextNodes;
+    std::unordered_map<pid_t, GpuMemUsage> mSnapshot;
+    std::chrono::steady_clock::time_point mSnapshotTime;
+    bool mSnapshotValid = false;
+    Stats mStats;
+};
+
+// Process-wide reader on kSysfsDevicePath used by the memtrack HAL.
+SnapshotReader& getSnapshotReader();
+
+} // namespace GpuSysfsReader
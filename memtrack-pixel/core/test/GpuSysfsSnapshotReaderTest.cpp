@@ -0,0 +1,182 @@
+#include <dirent.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+#include "GpuSysfsSnapshotReader.h"
+
+using namespace GpuSysfsReader;
+
+namespace {
+
+// Synthetic mali sysfs device directory, removed with its contents at the end of the test.
+class GpuSysfsSnapshotReaderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::string tmpl = ::testing::TempDir() + "memtrack_test_XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(tmpl.data()));
+        mRoot = tmpl;
+        ASSERT_EQ(0, mkdir(processDir().c_str(), 0755));
+    }
+
+    void TearDown() override { removeTree(mRoot); }
+
+    std::string processDir() const { return mRoot + "/" + kProcessDir; }
+    std::string contextDir(pid_t pid) const { return processDir() + "/" + std::to_string(pid); }
+
+    void addContext(pid_t pid, uint64_t total, uint64_t dmaBuf) {
+        ASSERT_EQ(0, mkdir(contextDir(pid).c_str(), 0755));
+        writeNode(contextDir(pid), kTotalGpuMemNode, total);
+        writeNode(contextDir(pid), kDmaBufGpuMemNode, dmaBuf);
+    }
+
+    static void writeNode(const std::string& dir, const char* node, uint64_t value) {
+        std::ofstream(dir + "/" + node) << value << "\n";
+    }
+
+    static void removeTree(const std::string& path) {
+        if (DIR* dir = opendir(path.c_str())) {
+            while (struct dirent* dent = readdir(dir)) {
+                const std::string name = dent->d_name;
+                if (name != "." && name != "..")
+                    removeTree(path + "/" + name);
+            }
+            closedir(dir);
+            rmdir(path.c_str());
+        } else {
+            unlink(path.c_str());
+        }
+    }
+
+    static int countOpenFds() {
+        int count = 0;
+        if (DIR* dir = opendir("/proc/self/fd")) {
+            while (readdir(dir))
+                count++;
+            closedir(dir);
+        }
+        return count;
+    }
+
+    std::string mRoot;
+};
+
+TEST_F(GpuSysfsSnapshotReaderTest, ReadsDeviceTotalsAndContexts) {
+    writeNode(mRoot, kTotalGpuMemNode, 65536);
+    writeNode(mRoot, kDmaBufGpuMemNode, 16384);
+    addContext(100, 8192, 4096);
+
+    SnapshotReader reader(mRoot);
+    GpuMemUsage usage;
+    ASSERT_TRUE(reader.getUsage(0, &usage));
+    EXPECT_EQ(65536u, usage.totalGpuMem);
+    EXPECT_EQ(16384u, usage.dmaBufGpuMem);
+    ASSERT_TRUE(reader.getUsage(100, &usage));
+    EXPECT_EQ(8192u, usage.totalGpuMem);
+    EXPECT_EQ(4096u, usage.dmaBufGpuMem);
+    EXPECT_FALSE(reader.getUsage(101, &usage));
+
+    // Both queries were served by one snapshot
+    EXPECT_EQ(1u, reader.getStats().snapshots);
+}
+
+TEST_F(GpuSysfsSnapshotReaderTest, MissingDeviceNodeReadsAsZero) {
+    writeNode(mRoot, kTotalGpuMemNode, 65536);
+
+    SnapshotReader reader(mRoot);
+    GpuMemUsage usage;
+    ASSERT_TRUE(reader.getUsage(0, &usage));
+    EXPECT_EQ(65536u, usage.totalGpuMem);
+    EXPECT_EQ(0u, usage.dmaBufGpuMem);
+}
+
+TEST_F(GpuSysfsSnapshotReaderTest, MissingContextNodeReadsAsZero) {
+    ASSERT_EQ(0, mkdir(contextDir(200).c_str(), 0755));
+    writeNode(contextDir(200), kDmaBufGpuMemNode, 4096);
+    ASSERT_EQ(0, mkdir(contextDir(201).c_str(), 0755));
+    writeNode(contextDir(201), kTotalGpuMemNode, 8192);
+    ASSERT_EQ(0, mkdir(contextDir(202).c_str(), 0755));
+
+    SnapshotReader reader(mRoot);
+    GpuMemUsage usage;
+    ASSERT_TRUE(reader.getUsage(200, &usage));
+    EXPECT_EQ(0u, usage.totalGpuMem);
+    EXPECT_EQ(4096u, usage.dmaBufGpuMem);
+    ASSERT_TRUE(reader.getUsage(201, &usage));
+    EXPECT_EQ(8192u, usage.totalGpuMem);
+    EXPECT_EQ(0u, usage.dmaBufGpuMem);
+    EXPECT_FALSE(reader.getUsage(202, &usage));
+    EXPECT_FALSE(reader.getUsage(0, &usage));
+
+    // A node that shows up later is picked up by the next snapshot
+    writeNode(contextDir(200), kTotalGpuMemNode, 16384);
+    reader.invalidate();
+    ASSERT_TRUE(reader.getUsage(200, &usage));
+    EXPECT_EQ(16384u, usage.totalGpuMem);
+    EXPECT_EQ(4096u, usage.dmaBufGpuMem);
+}
+
+TEST_F(GpuSysfsSnapshotReaderTest, ReusedPidReadsNewContext) {
+    addContext(300, 8192, 4096);
+
+    SnapshotReader reader(mRoot);
+    GpuMemUsage usage;
+    ASSERT_TRUE(reader.getUsage(300, &usage));
+    EXPECT_EQ(8192u, usage.totalGpuMem);
+
+    // The old context lives on under another name while the pid gets a new one, so the cached
+    // fds still read the old values.
+    ASSERT_EQ(0, rename(contextDir(300).c_str(), (processDir() + "/stale").c_str()));
+    addContext(300, 32768, 2048);
+    reader.invalidate();
+    ASSERT_TRUE(reader.getUsage(300, &usage));
+    EXPECT_EQ(32768u, usage.totalGpuMem);
+    EXPECT_EQ(2048u, usage.dmaBufGpuMem);
+}
+
+TEST_F(GpuSysfsSnapshotReaderTest, ExitedPidIsDropped) {
+    addContext(400, 8192, 4096);
+
+    SnapshotReader reader(mRoot);
+    GpuMemUsage usage;
+    ASSERT_TRUE(reader.getUsage(400, &usage));
+
+    removeTree(contextDir(400));
+    reader.invalidate();
+    EXPECT_FALSE(reader.getUsage(400, &usage));
+}
+
+TEST_F(GpuSysfsSnapshotReaderTest, CachedFdsAreBounded) {
+    constexpr pid_t kContexts = 8;
+    writeNode(mRoot, kTotalGpuMemNode, 65536);
+    writeNode(mRoot, kDmaBufGpuMemNode, 16384);
+    for (pid_t pid = 1; pid <= kContexts; pid++)
+        addContext(pid, pid * 8192, pid * 4096);
+
+    const int fdsBefore = countOpenFds();
+    {
+        SnapshotReader reader(mRoot, SnapshotReader::kDefaultTtl, 2);
+        GpuMemUsage usage;
+        for (int snapshot = 0; snapshot < 3; snapshot++) {
+            reader.invalidate();
+            for (pid_t pid = 1; pid <= kContexts; pid++) {
+                ASSERT_TRUE(reader.getUsage(pid, &usage));
+                EXPECT_EQ(static_cast<uint64_t>(pid) * 8192, usage.totalGpuMem);
+                EXPECT_EQ(static_cast<uint64_t>(pid) * 4096, usage.dmaBufGpuMem);
+            }
+        }
+
+        // The device and kprcs directories plus two nodes for the device and for each of the
+        // two cached contexts
+        EXPECT_EQ(fdsBefore + 2 + 2 + 2 * 2, countOpenFds());
+        // Only the six uncached contexts reopen their two nodes in the later snapshots
+        EXPECT_EQ(2u + 2 * kContexts + 2 * (2 * (kContexts - 2)), reader.getStats().nodeOpens);
+    }
+    EXPECT_EQ(fdsBefore, countOpenFds());
+}
+
+} // namespace